@@ -1,11 +1,12 @@
 import React, { useState, useEffect } from 'react';
-import { Server, CheckCircle, AlertCircle, XCircle, Activity, Database, Shield, Globe } from 'lucide-react';
+import { Server, CheckCircle, AlertCircle, XCircle, Activity, Database, Shield, Globe, Cpu } from 'lucide-react';
 import { useApi } from '../context/ApiContext';
 
 const SystemHealth = () => {
-  const { getServiceHealth, getDatabaseStats } = useApi();
+  const { getServiceHealth, getDatabaseStats, getDataplaneStats } = useApi();
   const [services, setServices] = useState([]);
   const [databaseStats, setDatabaseStats] = useState(null);
+  const [dataplane, setDataplane] = useState(null);
   const [loading, setLoading] = useState(true);
 
   useEffect(() => {
@@ -45,6 +46,12 @@ const SystemHealth = () => {
 
       setServices(healthChecks);
 
+      try {
+        setDataplane(await getDataplaneStats());
+      } catch (error) {
+        setDataplane(null);
+      }
+
       const dbStats = await getDatabaseStats();
       setDatabaseStats(dbStats);
     } catch (error) {
@@ -101,6 +108,14 @@ const SystemHealth = () => {
     }
   };
 
+  const formatCount = (value) => (value || 0).toLocaleString();
+
+  const ringDrops = (worker) =>
+    worker.frame_ring_drops + worker.record_ring_drops + worker.flow_ring_drops;
+
+  const averageBatch = (worker) =>
+    worker.batches ? (worker.packets / worker.batches).toFixed(1) : '0';
+
   if (loading) {
     return (
       <div className="flex items-center justify-center h-64">
@@ -192,6 +207,97 @@ const SystemHealth = () => {
         </div>
       </div>
 
+      {/* Dataplane Telemetry */}
+      {dataplane && dataplane.status !== 'UNAVAILABLE' && (
+        <div className="bg-white rounded-lg shadow overflow-hidden">
+          <div className="px-6 py-4 border-b border-gray-200 flex items-center justify-between">
+            <div className="flex items-center">
+              <Cpu className="w-5 h-5 text-gray-600 mr-2" />
+              <h3 className="text-lg font-medium text-gray-900">Dataplane</h3>
+            </div>
+            <div className="flex items-center space-x-3">
+              {dataplane.capture && (
+                <span className="text-sm text-gray-600">Capture {dataplane.capture.state}</span>
+              )}
+              <span className={`px-3 py-1 rounded-full text-xs font-medium ${getStatusColor(dataplane.status)}`}>
+                {dataplane.status}
+              </span>
+            </div>
+          </div>
+          <div className="p-6">
+            {dataplane.capture && dataplane.capture.totals && (
+              <div className="grid grid-cols-1 md:grid-cols-2 lg:grid-cols-4 gap-4 mb-6">
+                <div className="text-center">
+                  <p className="text-2xl font-bold text-gray-900">{formatCount(dataplane.capture.totals.packets)}</p>
+                  <p className="text-sm text-gray-600">Packets Captured</p>
+                </div>
+                <div className="text-center">
+                  <p className="text-2xl font-bold text-gray-900">
+                    {(dataplane.capture.totals.bytes / 1024 / 1024).toFixed(1)} MB
+                  </p>
+                  <p className="text-sm text-gray-600">Bytes Captured</p>
+                </div>
+                <div className="text-center">
+                  <p className="text-2xl font-bold text-gray-900">{formatCount(dataplane.capture.totals.kernel_drops)}</p>
+                  <p className="text-sm text-gray-600">Kernel Drops</p>
+                </div>
+                <div className="text-center">
+                  <p className="text-2xl font-bold text-gray-900">{formatCount(ringDrops(dataplane.capture.totals))}</p>
+                  <p className="text-sm text-gray-600">Ring-Full Drops</p>
+                </div>
+              </div>
+            )}
+
+            {dataplane.capture && dataplane.capture.workers.length > 0 && (
+              <div className="overflow-x-auto mb-6">
+                <table className="min-w-full text-sm">
+                  <thead>
+                    <tr className="text-left text-gray-600 border-b border-gray-200">
+                      <th className="py-2 pr-4">Queue</th>
+                      <th className="py-2 pr-4">CPU</th>
+                      <th className="py-2 pr-4">Packets</th>
+                      <th className="py-2 pr-4">Kernel Drops</th>
+                      <th className="py-2 pr-4">Ring Drops</th>
+                      <th className="py-2 pr-4">Active Flows</th>
+                      <th className="py-2 pr-4">Evicted Flows</th>
+                      <th className="py-2 pr-4">Avg Batch</th>
+                    </tr>
+                  </thead>
+                  <tbody>
+                    {dataplane.capture.workers.map((worker) => (
+                      <tr key={worker.queue_id} className="border-b border-gray-100 text-gray-900">
+                        <td className="py-2 pr-4">{worker.queue_id}</td>
+                        <td className="py-2 pr-4">{worker.cpu >= 0 ? worker.cpu : 'any'}</td>
+                        <td className="py-2 pr-4">{formatCount(worker.packets)}</td>
+                        <td className="py-2 pr-4">{formatCount(worker.kernel_drops)}</td>
+                        <td className="py-2 pr-4">{formatCount(ringDrops(worker))}</td>
+                        <td className="py-2 pr-4">{formatCount(worker.flows_active)}</td>
+                        <td className="py-2 pr-4">{formatCount(worker.flows_evicted)}</td>
+                        <td className="py-2 pr-4">{averageBatch(worker)}</td>
+                      </tr>
+                    ))}
+                  </tbody>
+                </table>
+              </div>
+            )}
+
+            {dataplane.decisions && (
+              <div>
+                <h4 className="font-medium text-gray-900 mb-3">Enforcer Decisions</h4>
+                <div className="grid grid-cols-2 md:grid-cols-5 gap-4">
+                  {['pass', 'drop', 'reject', 'rate_limit', 'rate_limited'].map((action) => (
+                    <div key={action} className="p-3 bg-gray-50 rounded text-center">
+                      <p className="text-lg font-bold text-gray-900">{formatCount(dataplane.decisions[action])}</p>
+                      <p className="text-xs text-gray-600 uppercase">{action.replace('_', ' ')}</p>
+                    </div>
+                  ))}
+                </div>
+              </div>
+            )}
+          </div>
+        </div>
+      )}
+
       {/* Database Statistics */}
       {databaseStats && (
         <div className="bg-white rounded-lg shadow overflow-hidden">
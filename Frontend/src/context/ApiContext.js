@@ -91,6 +91,10 @@ export const ApiProvider = ({ children }) => {
     return apiRequest('/health');
   };
 
+  const getDataplaneStats = async () => {
+    return apiRequest('/api/v1/dataplane/stats');
+  };
+
   const getServiceHealth = async (service) => {
     const serviceUrls = {
       dashboard: 'http://localhost:8001',
@@ -124,7 +128,8 @@ export const ApiProvider = ({ children }) => {
     getDatabaseStats,
     // Health methods
     getSystemHealth,
-    getServiceHealth
+    getServiceHealth,
+    getDataplaneStats
   };
 
   return (
@@ -117,6 +117,26 @@ class MLDetectionModule:
             "confidence": float(confidence)
         }
 
+    def predict_batch(self, features: np.ndarray) -> tuple:
+        """
+        Classifies a whole [N x F] feature matrix with one model call.
+        :param features: Array of N feature rows (e.g. a native flow batch).
+        :return: (labels, confidences): a list of N labels and a float array of N confidences.
+        """
+        if not self.is_model_loaded or self.model is None:
+            raise RuntimeError(f"ML Model is not loaded. Status: {self.error_message}")
+        if len(features) == 0:
+            return [], np.zeros(0)
+
+        # One predict_proba for the batch; the argmax is the predicted class
+        probabilities = self.model.predict_proba(features)
+        best = probabilities.argmax(axis=1)
+        confidences = probabilities[np.arange(len(best)), best]
+        classes = getattr(self.model, 'classes_', np.arange(probabilities.shape[1]))
+
+        labels = [CLASS_LABELS.get(int(index), "Unknown") for index in classes[best]]
+        return labels, confidences
+
 # --- High-level AI Detector Wrapper ---
 class AIDetector:
     """
@@ -133,3 +153,10 @@ class AIDetector:
         :return: dict with 'classification' and 'confidence'
         """
         return self.detector.predict(feature_vector)
+
+    def analyze_flow_batch(self, features: np.ndarray) -> tuple:
+        """
+        Analyze a batch of flows (shape: N, F) with one vectorized prediction.
+        :return: (labels, confidences), one entry per row
+        """
+        return self.detector.predict_batch(features)
@@ -4,9 +4,47 @@ API Gateway Component - Routes requests between services according to DFD
 from fastapi import FastAPI, HTTPException, Request
 from fastapi.routing import APIRouter
 from fastapi.middleware.cors import CORSMiddleware
+from fastapi.responses import Response
 import httpx
-from typing import Dict, Any
+from typing import Dict, Any, List
 import asyncio
+import os
+
+# p99 budget per dataplane latency stage; a window above it raises a WARNING
+DATAPLANE_P99_BUDGET_NS = int(os.environ.get("DATAPLANE_P99_BUDGET_US", "10000")) * 1000
+
+OPENMETRICS_CONTENT_TYPE = "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+# FirewallAction values a reload may name as the enforcer's default action
+FIREWALL_ACTIONS = {"PASS": 0, "DROP": 1, "REJECT": 2, "RATE_LIMIT": 3}
+
+# PacketSniffer.reload_config() arguments a dataplane reload passes through
+DATAPLANE_RELOAD_KEYS = ("flow_window", "idle_timeout", "close_timeout", "sketch", "filter", "shed_rules")
+
+# Bucket layout of C_LatencyHistogram (backend/src/latency_histogram.h)
+LATENCY_SUB_BITS = 3
+LATENCY_SUB_BUCKETS = 1 << LATENCY_SUB_BITS
+
+def latency_bucket_upper(index: int) -> int:
+    """Largest latency (ns) that falls in bucket `index`"""
+    if index < 2 * LATENCY_SUB_BUCKETS:
+        return index
+    octave = index >> LATENCY_SUB_BITS
+    sub = index & (LATENCY_SUB_BUCKETS - 1)
+    return ((LATENCY_SUB_BUCKETS + sub) << (octave - 1)) + (1 << (octave - 1)) - 1
+
+def latency_quantile(buckets: List[int], q: float) -> int:
+    """Value at quantile q of a bucket list (the upper end of its bucket)"""
+    count = sum(buckets)
+    if count == 0:
+        return 0
+    rank = max(1, min(count, int(q * count + 0.5)))
+    seen = 0
+    for index, n in enumerate(buckets):
+        seen += n
+        if seen >= rank:
+            return latency_bucket_upper(index)
+    return latency_bucket_upper(len(buckets) - 1)
 
 class APIGateway:
     """
@@ -32,6 +70,12 @@ class APIGateway:
             "firewall": "http://localhost:8003",
             "current_network": "http://localhost:8004"
         }
+
+        # In-process dataplane (C++ capture engine / native enforcer), if any
+        self.sniffer = None
+        self.enforcer = None
+        self._last_drops = None
+        self._latency_marks = {}
         self.setup_routes()
     
     def setup_routes(self):
@@ -61,7 +105,120 @@ class APIGateway:
         async def health_check():
             """Gateway health check"""
             return {"status": "API Gateway Operational", "services": list(self.services.keys())}
+
+        @self.app.get("/api/v1/dataplane/stats")
+        async def dataplane_stats():
+            """Capture engine and enforcer telemetry (lock-free snapshots)"""
+            return self.dataplane_stats()
+
+        @self.app.get("/api/v1/dataplane/latency")
+        async def dataplane_latency():
+            """Per-stage dataplane latency percentiles with p99 budget alerts"""
+            return self.dataplane_latency()
+
+        @self.app.get("/metrics")
+        async def metrics():
+            """OpenMetrics scrape of the in-process capture engine and enforcer"""
+            return Response(content=self.metrics_text(), media_type=OPENMETRICS_CONTENT_TYPE)
+
+        @self.app.post("/api/v1/dataplane/config")
+        async def dataplane_config(request: Request):
+            """Live reload of flow timeouts, sketches, BPF filter, shed rules and the default action"""
+            return self.reload_dataplane(await request.json())
     
+    def attach_dataplane(self, sniffer=None, enforcer=None):
+        """Serves the telemetry of a PacketSniffer / FirewallEnforce running in this process"""
+        self.sniffer = sniffer
+        self.enforcer = enforcer
+        self._last_drops = None
+        self._latency_marks = {}
+
+    def dataplane_stats(self) -> Dict[str, Any]:
+        """Engine counters plus a status: UNHEALTHY when not capturing, WARNING when drops grew since the last call"""
+        if self.sniffer is None and self.enforcer is None:
+            return {"status": "UNAVAILABLE", "capture": None, "decisions": None}
+
+        capture = self.sniffer.engine_stats() if self.sniffer is not None else None
+        decisions = self.enforcer.decision_stats() if self.enforcer is not None else None
+
+        status = "HEALTHY"
+        if capture is not None:
+            totals = capture["totals"] or {}
+            drops = sum(totals.get(name, 0) for name in (
+                "kernel_drops", "frame_ring_drops", "record_ring_drops", "flow_ring_drops"))
+            if capture["state"] != "running":
+                status = "UNHEALTHY"
+            elif self._last_drops is not None and drops > self._last_drops:
+                status = "WARNING"
+            self._last_drops = drops
+        return {"status": status, "capture": capture, "decisions": decisions}
+    
+    def dataplane_latency(self) -> Dict[str, Any]:
+        """Latency of each stage, cumulative and over the window since the last call; WARNING when a window p99 exceeds the budget"""
+        stages = self.sniffer.latency_stats() if self.sniffer is not None else {}
+        decision = self.enforcer.decision_latency() if self.enforcer is not None else None
+        if decision is not None:
+            stages["capture_to_decision"] = decision
+        if not stages:
+            return {"status": "UNAVAILABLE", "budget_ns": DATAPLANE_P99_BUDGET_NS, "alerts": [], "stages": {}}
+
+        alerts = []
+        for name, stage in stages.items():
+            buckets = stage.pop("buckets")
+            previous = self._latency_marks.get(name)
+            self._latency_marks[name] = buckets
+            # A cold engine restart resets the histograms: then the window is all of them
+            if previous is None or any(now < before for now, before in zip(buckets, previous)):
+                window = buckets
+            else:
+                window = [now - before for now, before in zip(buckets, previous)]
+            stage["window_count"] = sum(window)
+            stage["window_p99_ns"] = min(latency_quantile(window, 0.99), stage["max_ns"])
+            if stage["window_p99_ns"] > DATAPLANE_P99_BUDGET_NS:
+                alerts.append(name)
+        return {
+            "status": "WARNING" if alerts else "HEALTHY",
+            "budget_ns": DATAPLANE_P99_BUDGET_NS,
+            "alerts": alerts,
+            "stages": stages,
+        }
+
+    def metrics_text(self) -> str:
+        """The sniffer's families (rendered by the engine), then the enforcer's, then # EOF"""
+        text = self.sniffer.metrics_text() if self.sniffer is not None else ""
+        if self.enforcer is not None:
+            text += self.enforcer.metrics_text()
+        return text + "# EOF\n"
+
+    def reload_dataplane(self, config: Dict[str, Any]) -> Dict[str, Any]:
+        """
+        Applies the parts of `config` given (DATAPLANE_RELOAD_KEYS, and
+        default_action: a FIREWALL_ACTIONS name or value) without restarting
+        capture; returns the engine's dataplane status.
+        """
+        unknown = set(config) - set(DATAPLANE_RELOAD_KEYS) - {"default_action"}
+        if unknown:
+            raise HTTPException(status_code=400, detail=f"unknown dataplane settings: {sorted(unknown)}")
+        action = config.get("default_action")
+        if action is not None:
+            action = FIREWALL_ACTIONS.get(action, action)
+            if self.enforcer is None or action not in FIREWALL_ACTIONS.values():
+                raise HTTPException(status_code=400, detail=f"cannot set default action {config['default_action']!r}")
+        changes = {key: config[key] for key in DATAPLANE_RELOAD_KEYS if key in config}
+        if changes:
+            if self.sniffer is None:
+                raise HTTPException(status_code=503, detail="no capture engine attached")
+            try:
+                self.sniffer.reload_config(**changes)
+            except (TypeError, ValueError) as e:
+                raise HTTPException(status_code=400, detail=str(e))
+        if action is not None and not self.enforcer.set_default_action(action):
+            raise HTTPException(status_code=503, detail="native rule engine unavailable")
+        return {
+            "dataplane": self.sniffer.dataplane_status() if self.sniffer is not None else None,
+            "default_action": action,
+        }
+
     async def proxy_request(self, service_name: str, request: Request):
         """Proxy request to appropriate service"""
         if service_name not in self.services:
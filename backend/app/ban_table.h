@@ -0,0 +1,426 @@
+#ifndef BAN_TABLE_H
+#define BAN_TABLE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// ====================================================================
+// A) Epoch-based reclamation for read-mostly data-plane structures
+// ====================================================================
+
+/**
+ * @brief Minimal epoch (EBR / userspace-RCU style) domain.
+ *
+ * Readers announce the global epoch in a per-thread, cache-line sized slot
+ * for the duration of a read section and clear it afterwards: two stores,
+ * no lock, no allocation. A writer that unpublished an object calls
+ * synchronize() and may free it once every reader that could still see it
+ * has left its read section.
+ *
+ * Threads claim a slot on first use (lock-free CAS) and release it at thread
+ * exit. If all slots are taken, readers fall back to a shared in-flight
+ * counter, which is correct but contended.
+ */
+class EpochDomain {
+public:
+    static constexpr size_t MAX_READERS = 128;
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};    // 0 = quiescent
+        std::atomic<bool> claimed{false};
+    };
+
+public:
+    static EpochDomain& instance() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    /**
+     * @brief RAII read-side critical section.
+     */
+    class ReadGuard {
+    public:
+        explicit ReadGuard(EpochDomain& domain) : domain_(domain), slot_(domain.reader_slot()) {
+            if (slot_ != nullptr) {
+                // seq_cst announce paired with seq_cst pointer loads/stores:
+                // either synchronize() sees this reader, or the reader sees the new pointer.
+                slot_->epoch.store(domain_.epoch_.load(std::memory_order_acquire), std::memory_order_seq_cst);
+            } else {
+                domain_.overflow_readers_.fetch_add(1, std::memory_order_seq_cst);
+            }
+        }
+        ~ReadGuard() {
+            if (slot_ != nullptr) {
+                slot_->epoch.store(0, std::memory_order_release);
+            } else {
+                domain_.overflow_readers_.fetch_sub(1, std::memory_order_release);
+            }
+        }
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+
+    private:
+        EpochDomain& domain_;
+        Slot* slot_;
+    };
+
+    /**
+     * @brief Waits until every read section that started before the call has
+     * finished (control plane only; readers never wait).
+     */
+    void synchronize() {
+        const uint64_t target = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        for (Slot& slot : slots_) {
+            for (;;) {
+                const uint64_t seen = slot.epoch.load(std::memory_order_seq_cst);
+                if (seen == 0 || seen >= target) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+        while (overflow_readers_.load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    // Releases the calling thread's slot when the thread exits.
+    struct ThreadSlot {
+        Slot* slot = nullptr;
+        ~ThreadSlot() {
+            if (slot != nullptr) {
+                slot->epoch.store(0, std::memory_order_release);
+                slot->claimed.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    EpochDomain() = default;
+
+    Slot* reader_slot() {
+        thread_local ThreadSlot mine;
+        if (mine.slot == nullptr) {
+            for (Slot& slot : slots_) {
+                bool expected = false;
+                if (!slot.claimed.load(std::memory_order_relaxed) &&
+                    slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    mine.slot = &slot;
+                    break;
+                }
+            }
+        }
+        return mine.slot;
+    }
+
+    std::atomic<uint64_t> epoch_{1};
+    Slot slots_[MAX_READERS];
+    alignas(64) std::atomic<uint64_t> overflow_readers_{0};
+};
+
+// ====================================================================
+// B) Concurrent ban table (FlowKey -> action)
+// ====================================================================
+
+/**
+ * @brief Read-optimized FlowKey -> Action hash table.
+ *
+ * - lookup() is wait-free for the reader: an epoch announce, one load of the
+ *   table pointer and a short linear probe of acquire loads. It never locks
+ *   or allocates, and is safe against concurrent updates.
+ * - Updates (control plane) are serialized by a mutex and done in place:
+ *   a new entry writes its action, then publishes its key with a release
+ *   store; removal leaves a tombstone action. Thousands per second are cheap.
+ * - When live entries plus tombstones pass 3/4 of the table, a compacted,
+ *   larger table is built and published RCU-style; the old one is freed
+ *   after an epoch grace period.
+ * - With set_limit(), the table is sized for the limit at once and never
+ *   grows past it: inserts of new keys beyond it are refused (and counted),
+ *   so a flood of bans cannot exhaust memory, and rebuilds only compact.
+ *
+ * Each entry also has a 64-bit state word (0 on insert) that the data path
+ * may update atomically, e.g. a token bucket for a RATE_LIMIT flow.
+ *
+ * Key 0 is reserved (empty slot); it is stored as key 1, the same
+ * convention as flow_key_of().
+ */
+template <typename Action>
+class ConcurrentBanTable {
+public:
+    explicit ConcurrentBanTable(size_t initial_capacity = 1024,
+                                EpochDomain& domain = EpochDomain::instance()) :
+        domain_(domain), table_(Table::create(capacity_for(initial_capacity))) {}
+
+    ~ConcurrentBanTable() {
+        // No readers may be active when the owner is destroyed.
+        Table::destroy(table_.load(std::memory_order_relaxed));
+    }
+
+    ConcurrentBanTable(const ConcurrentBanTable&) = delete;
+    ConcurrentBanTable& operator=(const ConcurrentBanTable&) = delete;
+
+    /**
+     * @brief Data-plane lookup.
+     * @return true and sets *action if key has an entry.
+     */
+    bool lookup(uint64_t key, Action* action) const {
+        EpochDomain::ReadGuard guard(domain_);
+        return lookup_unguarded(key, action);
+    }
+
+    /**
+     * @brief lookup() for callers that already hold a ReadGuard on this
+     * table's domain (e.g. once for a whole packet batch).
+     */
+    bool lookup_unguarded(uint64_t key, Action* action) const {
+        return lookup_unguarded(key, action, nullptr);
+    }
+
+    /**
+     * @brief lookup_unguarded() that also returns the entry's state word.
+     * The pointer is valid until the caller's read section ends.
+     */
+    bool lookup_unguarded(uint64_t key, Action* action, std::atomic<uint64_t>** state) const {
+        key = normalize(key);
+        // seq_cst, not acquire: see EpochDomain::ReadGuard (a plain load on x86).
+        const Table* table = table_.load(std::memory_order_seq_cst);
+        size_t slot = table->home(key);
+        for (;;) {
+            const uint64_t k = table->slots[slot].key.load(std::memory_order_acquire);
+            if (k == key) {
+                const uint8_t value = table->slots[slot].value.load(std::memory_order_acquire);
+                if (value == TOMBSTONE) {
+                    return false;
+                }
+                *action = static_cast<Action>(value);
+                if (state != nullptr) {
+                    *state = &table->slots[slot].state;
+                }
+                return true;
+            }
+            if (k == 0) {
+                return false;
+            }
+            slot = (slot + 1) & table->mask;
+        }
+    }
+
+    EpochDomain& domain() const { return domain_; }
+
+    /**
+     * @brief Caps the entries at max_entries (0 = no cap) and allocates the
+     * table for that many now (control plane). Entries already over a lower
+     * cap stay; only new keys are refused.
+     */
+    void set_limit(size_t max_entries) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        limit_ = max_entries;
+        if (limit_ != 0 && table_.load(std::memory_order_relaxed)->capacity() < capacity_for(limit_)) {
+            rebuild(capacity_for(limit_));
+        }
+    }
+
+    /**
+     * @brief Adds or replaces the entry for key (control plane).
+     * @return false if key is new and the table is at its limit.
+     */
+    bool insert(uint64_t key, Action action) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        key = normalize(key);
+        Table* table = table_.load(std::memory_order_relaxed);
+        bool found = false;
+        size_t slot = table->find(key, found);
+        if (found) {
+            if (table->slots[slot].value.load(std::memory_order_relaxed) == TOMBSTONE) {
+                --tombstones_;
+                ++size_;
+            }
+            table->slots[slot].state.store(0, std::memory_order_relaxed);
+            table->slots[slot].value.store(static_cast<uint8_t>(action), std::memory_order_release);
+            return true;
+        }
+        if (limit_ != 0 && size_ >= limit_) {
+            ++rejected_;
+            return false;
+        }
+        if ((size_ + tombstones_ + 1) * 4 > table->capacity() * 3) {
+            const size_t wanted = limit_ != 0 ? capacity_for(limit_) : capacity_for((size_ + 1) * 2);
+            table = rebuild(std::max(wanted, capacity_for(size_ + 1)));
+            slot = table->find(key, found);
+        }
+        table->slots[slot].value.store(static_cast<uint8_t>(action), std::memory_order_relaxed);
+        table->slots[slot].state.store(0, std::memory_order_relaxed);
+        table->slots[slot].key.store(key, std::memory_order_release);
+        ++size_;
+        return true;
+    }
+
+    /**
+     * @brief Removes the entry for key (control plane).
+     * @return true if there was one.
+     */
+    bool erase(uint64_t key) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        key = normalize(key);
+        Table* table = table_.load(std::memory_order_relaxed);
+        bool found = false;
+        const size_t slot = table->find(key, found);
+        if (!found || table->slots[slot].value.load(std::memory_order_relaxed) == TOMBSTONE) {
+            return false;
+        }
+        table->slots[slot].value.store(TOMBSTONE, std::memory_order_release);
+        --size_;
+        ++tombstones_;
+        return true;
+    }
+
+    /**
+     * @brief Removes every entry (control plane).
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        Table* old = table_.exchange(Table::create(capacity_for(limit_)), std::memory_order_seq_cst);
+        domain_.synchronize();
+        Table::destroy(old);
+        size_ = 0;
+        tombstones_ = 0;
+    }
+
+    /**
+     * @brief Calls fn(key, action) for every entry (control plane; updates
+     * wait until it returns).
+     */
+    template <typename Fn>
+    void for_each(Fn fn) const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        const Table* table = table_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i <= table->mask; ++i) {
+            const uint64_t key = table->slots[i].key.load(std::memory_order_relaxed);
+            const uint8_t value = table->slots[i].value.load(std::memory_order_relaxed);
+            if (key != 0 && value != TOMBSTONE) {
+                fn(key, static_cast<Action>(value));
+            }
+        }
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return size_;
+    }
+
+    /**
+     * @brief New keys refused because the table was at its limit.
+     */
+    uint64_t rejected() const {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        return rejected_;
+    }
+
+    size_t capacity() const {
+        EpochDomain::ReadGuard guard(domain_);
+        return table_.load(std::memory_order_acquire)->capacity();
+    }
+
+private:
+    static constexpr uint8_t TOMBSTONE = 0xFF;
+
+    struct Slot {
+        std::atomic<uint64_t> key;    // 0 = empty; never changes once set in a table
+        std::atomic<uint8_t> value;   // Action, or TOMBSTONE
+        std::atomic<uint64_t> state;  // Data-path state of the entry
+    };
+
+    struct Table {
+        size_t mask;
+        unsigned shift;
+        Slot* slots;
+
+        static Table* create(size_t capacity) {
+            Table* table = new Table;
+            table->mask = capacity - 1;
+            table->shift = 64 - static_cast<unsigned>(__builtin_ctzll(capacity));
+            table->slots = new Slot[capacity];
+            for (size_t i = 0; i < capacity; ++i) {
+                table->slots[i].key.store(0, std::memory_order_relaxed);
+                table->slots[i].value.store(TOMBSTONE, std::memory_order_relaxed);
+                table->slots[i].state.store(0, std::memory_order_relaxed);
+            }
+            return table;
+        }
+
+        static void destroy(Table* table) {
+            delete[] table->slots;
+            delete table;
+        }
+
+        size_t capacity() const { return mask + 1; }
+
+        // Fibonacci hashing: keys supplied by the control plane need not be well mixed.
+        size_t home(uint64_t key) const {
+            return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> shift) & mask;
+        }
+
+        // Writer-side probe: the key's slot, or the empty slot ending its chain.
+        size_t find(uint64_t key, bool& found) const {
+            size_t slot = home(key);
+            for (;;) {
+                const uint64_t k = slots[slot].key.load(std::memory_order_relaxed);
+                if (k == key || k == 0) {
+                    found = k == key;
+                    return slot;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+    };
+
+    static uint64_t normalize(uint64_t key) { return key != 0 ? key : 1; }
+
+    static size_t capacity_for(size_t entries) {
+        size_t capacity = 16;
+        while (capacity * 3 < entries * 4) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    // Copies live entries into a fresh table, publishes it and retires the old one.
+    Table* rebuild(size_t capacity) {
+        Table* old = table_.load(std::memory_order_relaxed);
+        Table* fresh = Table::create(capacity);
+        for (size_t i = 0; i <= old->mask; ++i) {
+            const uint64_t key = old->slots[i].key.load(std::memory_order_relaxed);
+            const uint8_t value = old->slots[i].value.load(std::memory_order_relaxed);
+            if (key != 0 && value != TOMBSTONE) {
+                bool found = false;
+                const size_t slot = fresh->find(key, found);
+                fresh->slots[slot].value.store(value, std::memory_order_relaxed);
+                // Updates racing with the copy may be lost; the state is advisory.
+                fresh->slots[slot].state.store(old->slots[i].state.load(std::memory_order_relaxed),
+                                               std::memory_order_relaxed);
+                fresh->slots[slot].key.store(key, std::memory_order_relaxed);
+            }
+        }
+        table_.store(fresh, std::memory_order_seq_cst);
+        domain_.synchronize();
+        Table::destroy(old);
+        tombstones_ = 0;
+        return fresh;
+    }
+
+    EpochDomain& domain_;
+    std::atomic<Table*> table_;
+    mutable std::mutex write_mutex_;
+    size_t size_ = 0;        // Guarded by write_mutex_
+    size_t tombstones_ = 0;  // Guarded by write_mutex_
+    size_t limit_ = 0;       // Guarded by write_mutex_; 0 = unbounded
+    uint64_t rejected_ = 0;  // Guarded by write_mutex_
+};
+
+#endif // BAN_TABLE_H
@@ -11,6 +11,17 @@ import json
 import os
 from collections import defaultdict
 
+try:
+    from backend.src.traffic_sniffer import FlowLogReader, SNIFFER_LOG_STREAMS
+except ImportError:
+    try:
+        from src.traffic_sniffer import FlowLogReader, SNIFFER_LOG_STREAMS
+    except ImportError:
+        FlowLogReader, SNIFFER_LOG_STREAMS = None, {}
+
+# Where the capture engine's columnar flow log lives (PacketSniffer.set_flow_log)
+FLOW_LOG_DIR = os.environ.get("SNIFFER_FLOW_LOG_DIR", "data/flow_log")
+
 class DatabaseEntry(BaseModel):
     """Generic database entry model"""
     collection: str = Field(..., description="Collection/table name")
@@ -27,7 +38,9 @@ class DatabaseService:
     """
     Database Service - Centralized data storage
     In production, this would connect to a real database (PostgreSQL, MongoDB, etc.)
-    For demo purposes, uses file-based storage
+    For demo purposes, uses file-based storage: one JSON-lines file per
+    collection, appended to per entry. The "flows" and "decisions"
+    collections are served from the capture engine's columnar flow log.
     """
     
     def __init__(self):
@@ -56,25 +69,55 @@ class DatabaseService:
         os.makedirs(self.data_dir, exist_ok=True)
     
     def _load_existing_data(self):
-        """Load existing data from files"""
+        """Load existing data from files (older whole-collection .json files first)"""
         try:
-            for filename in os.listdir(self.data_dir):
+            for filename in sorted(os.listdir(self.data_dir), key=lambda name: name.endswith(".jsonl")):
+                filepath = os.path.join(self.data_dir, filename)
                 if filename.endswith(".json"):
-                    collection_name = filename[:-5]  # Remove .json extension
-                    filepath = os.path.join(self.data_dir, filename)
                     with open(filepath, 'r') as f:
-                        self.collections[collection_name] = json.load(f)
+                        self.collections[filename[:-5]] = json.load(f)
+                elif filename.endswith(".jsonl"):
+                    with open(filepath, 'r') as f:
+                        self.collections[filename[:-6]].extend(json.loads(line) for line in f if line.strip())
         except Exception as e:
             print(f"Error loading existing data: {e}")
-    
+
+    def _append_entry(self, collection_name: str, entry: Dict[str, Any]):
+        """Append one entry to the collection's file"""
+        try:
+            filepath = os.path.join(self.data_dir, f"{collection_name}.jsonl")
+            with open(filepath, 'a') as f:
+                f.write(json.dumps(entry, default=str) + "\n")
+        except Exception as e:
+            print(f"Error saving collection {collection_name}: {e}")
+
     def _save_collection(self, collection_name: str):
-        """Save collection to file"""
+        """Rewrite the collection's file (only needed when entries are removed)"""
         try:
-            filepath = os.path.join(self.data_dir, f"{collection_name}.json")
+            filepath = os.path.join(self.data_dir, f"{collection_name}.jsonl")
             with open(filepath, 'w') as f:
-                json.dump(self.collections[collection_name], f, indent=2, default=str)
+                f.writelines(json.dumps(entry, default=str) + "\n" for entry in self.collections[collection_name])
+            legacy = os.path.join(self.data_dir, f"{collection_name}.json")
+            if os.path.exists(legacy):
+                os.remove(legacy)
         except Exception as e:
             print(f"Error saving collection {collection_name}: {e}")
+
+    def _query_flow_log(self, query: QueryRequest) -> Dict[str, Any]:
+        """
+        Query the flow log: filters "start" / "end" (epoch seconds) and
+        "flow_id" use its index, any other key must equal that column
+        (addresses as text)
+        """
+        filters = dict(query.filters or {})
+        start, end, flow_id = filters.pop("start", None), filters.pop("end", None), filters.pop("flow_id", None)
+        results = FlowLogReader(FLOW_LOG_DIR).rows(query.collection, start=start, end=end, flow_id=flow_id,
+                                                   where=filters, limit=query.limit or 100)
+        return {
+            "collection": query.collection,
+            "results": results,
+            "total_count": len(results)
+        }
     
     def setup_routes(self):
         """Setup database service endpoints"""
@@ -104,7 +147,7 @@ class DatabaseService:
                 self.collections[entry.collection].append(collection_entry)
                 
                 # Save to file
-                self._save_collection(entry.collection)
+                self._append_entry(entry.collection, collection_entry)
                 
                 return {
                     "status": "success",
@@ -123,6 +166,9 @@ class DatabaseService:
         async def query_data(query: QueryRequest):
             """Query data from collection"""
             try:
+                if query.collection in SNIFFER_LOG_STREAMS and FlowLogReader is not None:
+                    return self._query_flow_log(query)
+
                 collection = self.collections.get(query.collection, [])
                 
                 # Apply filters if provided
@@ -0,0 +1,342 @@
+// app/enforcer_api.cpp
+
+#include "enforcer_api.h"
+#include "rule_engine.h"
+#include "xdp_offload.h"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace {
+
+std::mutex g_cidr_mutex;
+// (ip_version, prefix length, masked address, direction) -> rule handle
+std::map<std::tuple<uint8_t, uint8_t, std::string, int>, uint32_t> g_cidr_rules;
+
+std::mutex g_xdp_mutex;
+std::unique_ptr<XdpOffload> g_xdp;
+
+bool valid_action(uint8_t action) {
+    return action <= static_cast<uint8_t>(FirewallAction::RATE_LIMIT);
+}
+
+// Parses "addr" or "addr/len" into the FlowTuple address layout.
+bool parse_cidr(const char* cidr, uint8_t& version, uint8_t addr[16], uint8_t& length) {
+    if (cidr == nullptr) {
+        return false;
+    }
+    std::string text(cidr);
+    long bits = -1;
+    const size_t slash = text.find('/');
+    if (slash != std::string::npos) {
+        const std::string digits = text.substr(slash + 1);
+        char* end = nullptr;
+        bits = std::strtol(digits.c_str(), &end, 10);
+        if (digits.empty() || *end != '\0') {
+            return false;
+        }
+        text.resize(slash);
+    }
+
+    std::memset(addr, 0, 16);
+    if (inet_pton(AF_INET, text.c_str(), addr + 12) == 1) {
+        version = 4;
+        addr[10] = addr[11] = 0xFF;
+        if (bits < 0) bits = 32;
+        if (bits < 1 || bits > 32) return false;
+        // Clear the host bits so equal networks compare equal.
+        for (int bit = static_cast<int>(bits); bit < 32; ++bit) {
+            addr[12 + bit / 8] &= static_cast<uint8_t>(~(0x80 >> (bit % 8)));
+        }
+    } else if (inet_pton(AF_INET6, text.c_str(), addr) == 1) {
+        version = 6;
+        if (bits < 0) bits = 128;
+        if (bits < 1 || bits > 128) return false;
+        for (int bit = static_cast<int>(bits); bit < 128; ++bit) {
+            addr[bit / 8] &= static_cast<uint8_t>(~(0x80 >> (bit % 8)));
+        }
+    } else {
+        return false;
+    }
+    length = static_cast<uint8_t>(bits);
+    return true;
+}
+
+RuleId intern_name(const char* rule_name, const char* fallback) {
+    const RuleId id = RuleRegistry::instance().intern(rule_name != nullptr ? rule_name : fallback);
+    return id != RuleRegistry::INVALID_RULE ? id : RULE_DEFAULT_POLICY;
+}
+
+} // namespace
+
+CompiledRuleEngine& enforcer_instance() {
+    static CompiledRuleEngine engine;
+    return engine;
+}
+
+int enforcer_add_rule(const C_FirewallRule* rule, const char* rule_name) {
+    if (rule == nullptr || !valid_action(rule->action)) {
+        return -1;
+    }
+    FirewallRule staged;
+    staged.priority = rule->priority;
+    staged.ip_version = rule->ip_version;
+    staged.protocol = rule->protocol;
+    staged.src_prefix = rule->src_prefix;
+    staged.dst_prefix = rule->dst_prefix;
+    std::memcpy(staged.src_addr, rule->src_addr, sizeof(staged.src_addr));
+    std::memcpy(staged.dst_addr, rule->dst_addr, sizeof(staged.dst_addr));
+    staged.src_port_lo = rule->src_port_lo;
+    staged.src_port_hi = rule->src_port_hi;
+    staged.dst_port_lo = rule->dst_port_lo;
+    staged.dst_port_hi = rule->dst_port_hi;
+    staged.action = static_cast<FirewallAction>(rule->action);
+    staged.rate.rate_pps = rule->rate_pps;
+    staged.rate.burst = rule->rate_burst;
+    staged.rule_id = intern_name(rule_name, "RULE");
+
+    const uint32_t handle = enforcer_instance().add_rule(staged);
+    return handle == UINT32_MAX ? -1 : static_cast<int>(handle);
+}
+
+int enforcer_remove_rule(uint32_t handle) {
+    return enforcer_instance().remove_rule(handle) ? 0 : -1;
+}
+
+int enforcer_block_cidr(const char* cidr, int direction, uint8_t action, const char* rule_name) {
+    FirewallRule rule;
+    uint8_t length = 0;
+    if (!valid_action(action) || (direction != 0 && direction != 1) ||
+        !parse_cidr(cidr, rule.ip_version, direction ? rule.dst_addr : rule.src_addr, length)) {
+        return -1;
+    }
+    (direction ? rule.dst_prefix : rule.src_prefix) = length;
+    rule.action = static_cast<FirewallAction>(action);
+    rule.rule_id = intern_name(rule_name, "BLOCK_IP");
+
+    const uint8_t* addr = direction ? rule.dst_addr : rule.src_addr;
+    const auto key = std::make_tuple(rule.ip_version, length,
+                                     std::string(reinterpret_cast<const char*>(addr), 16), direction);
+    std::lock_guard<std::mutex> lock(g_cidr_mutex);
+    CompiledRuleEngine& engine = enforcer_instance();
+    const uint32_t handle = engine.add_rule(rule);
+    if (handle == UINT32_MAX) {
+        return -1;
+    }
+    const auto it = g_cidr_rules.find(key);
+    if (it != g_cidr_rules.end()) {
+        engine.remove_rule(it->second);
+        it->second = handle;
+    } else {
+        g_cidr_rules.emplace(key, handle);
+    }
+    return static_cast<int>(handle);
+}
+
+int enforcer_unblock_cidr(const char* cidr, int direction) {
+    uint8_t version = 0;
+    uint8_t addr[16];
+    uint8_t length = 0;
+    if ((direction != 0 && direction != 1) || !parse_cidr(cidr, version, addr, length)) {
+        return -1;
+    }
+    const auto key = std::make_tuple(version, length, std::string(reinterpret_cast<const char*>(addr), 16), direction);
+    std::lock_guard<std::mutex> lock(g_cidr_mutex);
+    const auto it = g_cidr_rules.find(key);
+    if (it == g_cidr_rules.end()) {
+        return -1;
+    }
+    enforcer_instance().remove_rule(it->second);
+    g_cidr_rules.erase(it);
+    return 0;
+}
+
+int enforcer_commit() {
+    return enforcer_instance().compile();
+}
+
+int enforcer_enforce_flow(uint64_t flow_id, uint8_t action) {
+    if (!valid_action(action)) {
+        return -1;
+    }
+    enforcer_instance().enforce_flow_policy(flow_id, static_cast<FirewallAction>(action));
+    return 0;
+}
+
+void enforcer_sketch_alert(const C_SketchAlert* alert, void* engine) {
+    if (alert == nullptr || (alert->flags & C_ALERT_FLAG_ENFORCE) == 0 || alert->flow_id == 0 ||
+        !valid_action(alert->action)) {
+        return;
+    }
+    EnforcementEngine& target = engine != nullptr ? *static_cast<EnforcementEngine*>(engine)
+                                                  : static_cast<EnforcementEngine&>(enforcer_instance());
+    target.enforce_flow_policy(alert->flow_id, static_cast<FirewallAction>(alert->action));
+}
+
+int enforcer_set_flow_limit(uint32_t max_flows) {
+    enforcer_instance().set_flow_limit(max_flows);
+    return 0;
+}
+
+int enforcer_set_default_action(uint8_t action) {
+    if (!valid_action(action)) {
+        return -1;
+    }
+    enforcer_instance().set_default_action(static_cast<FirewallAction>(action));
+    return 0;
+}
+
+int enforcer_set_rate_limits(uint32_t flow_pps, uint32_t flow_burst,
+                             uint32_t source_pps, uint32_t source_burst) {
+    RateLimits limits;
+    limits.flow = {flow_pps, flow_burst};
+    limits.source = {source_pps, source_burst};
+    enforcer_instance().set_rate_limits(limits);
+    return 0;
+}
+
+int enforcer_classify(const uint8_t* frame, uint16_t len, uint16_t* rule_id) {
+    const PacketDecision decision = enforcer_instance().get_decision(frame, len);
+    if (rule_id != nullptr) {
+        *rule_id = decision.rule_id;
+    }
+    return static_cast<int>(decision.action);
+}
+
+int enforcer_classify_batch(const uint8_t* const* frames, const uint16_t* lens, const uint64_t* ts_ns,
+                            uint8_t* actions, uint16_t* rule_ids, uint32_t n) {
+    if (frames == nullptr || lens == nullptr || ts_ns == nullptr || actions == nullptr) {
+        return -1;
+    }
+    CompiledRuleEngine& engine = enforcer_instance();
+    PacketDecision decisions[256];
+    for (uint32_t done = 0; done < n;) {
+        const uint32_t chunk = std::min<uint32_t>(n - done, 256);
+        engine.get_decisions_at(frames + done, lens + done, ts_ns + done, decisions, chunk);
+        for (uint32_t i = 0; i < chunk; ++i) {
+            actions[done + i] = static_cast<uint8_t>(decisions[i].action);
+            if (rule_ids != nullptr) {
+                rule_ids[done + i] = decisions[i].rule_id;
+            }
+        }
+        done += chunk;
+    }
+    return static_cast<int>(n);
+}
+
+int enforcer_rule_name(uint16_t rule_id, char* buf, int len) {
+    const char* name = RuleRegistry::instance().name(rule_id);
+    const int length = static_cast<int>(std::strlen(name));
+    if (buf != nullptr && len > 0) {
+        const int copied = length < len - 1 ? length : len - 1;
+        std::memcpy(buf, name, static_cast<size_t>(copied));
+        buf[copied] = '\0';
+    }
+    return length;
+}
+
+int enforcer_get_stats(C_RuleEngineStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    const RuleEngineStats current = enforcer_instance().stats();
+    stats->generation = current.generation;
+    stats->staged_rules = current.staged_rules;
+    stats->rules = current.rules;
+    stats->prefix_rules = current.prefix_rules;
+    stats->general_rules = current.general_rules;
+    stats->memory_bytes = current.memory_bytes;
+    stats->compile_ns = current.compile_ns;
+    stats->flow_policies = current.flow_policies;
+    stats->flow_policies_rejected = current.flow_policies_rejected;
+    return 0;
+}
+
+int enforcer_get_decision_stats(C_DecisionStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    const DecisionStats current = enforcer_instance().decision_stats();
+    stats->pass = current.by_action[static_cast<uint8_t>(FirewallAction::PASS)];
+    stats->drop = current.by_action[static_cast<uint8_t>(FirewallAction::DROP)];
+    stats->reject = current.by_action[static_cast<uint8_t>(FirewallAction::REJECT)];
+    stats->rate_limit = current.by_action[static_cast<uint8_t>(FirewallAction::RATE_LIMIT)];
+    stats->rate_limited = current.rate_limited;
+    stats->default_policy = current.default_policy;
+    return 0;
+}
+
+int enforcer_get_decision_latency(C_LatencyHistogram* histogram) {
+    if (histogram == nullptr) {
+        return -1;
+    }
+    std::memset(histogram, 0, sizeof(*histogram));
+    enforcer_instance().decision_latency(*histogram);
+    finish_latency_snapshot(*histogram);
+    return 0;
+}
+
+int enforcer_xdp_attach(const char* ifname, uint32_t xdp_flags) {
+    std::lock_guard<std::mutex> lock(g_xdp_mutex);
+    if (g_xdp != nullptr) {
+        std::cerr << "[C++ Engine ERROR] XDP offload is already attached." << std::endl;
+        return -1;
+    }
+    std::unique_ptr<XdpOffload> offload(new XdpOffload);
+    if (offload->attach(ifname, xdp_flags) != 0) {
+        return -1;
+    }
+    g_xdp = std::move(offload);
+    return enforcer_instance().set_offload(g_xdp.get());
+}
+
+int enforcer_xdp_detach() {
+    std::lock_guard<std::mutex> lock(g_xdp_mutex);
+    if (g_xdp == nullptr) {
+        return -1;
+    }
+    enforcer_instance().set_offload(nullptr);
+    g_xdp.reset();
+    return 0;
+}
+
+int enforcer_xdp_get_stats(C_XdpStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    std::memset(stats, 0, sizeof(*stats));
+    std::lock_guard<std::mutex> lock(g_xdp_mutex);
+    if (g_xdp == nullptr) {
+        return 0;
+    }
+    const XdpOffloadStats current = g_xdp->stats();
+    stats->attached = current.attached ? 1 : 0;
+    stats->ifindex = current.ifindex;
+    stats->flow_entries = current.flow_entries;
+    stats->prefix_entries = current.prefix_entries;
+    stats->flow_drop_packets = current.flow_drops.packets;
+    stats->flow_drop_bytes = current.flow_drops.bytes;
+    stats->prefix_drop_packets = current.prefix_drops.packets;
+    stats->prefix_drop_bytes = current.prefix_drops.bytes;
+    return 0;
+}
+
+int enforcer_xdp_flow_hits(uint64_t flow_id, uint64_t* packets, uint64_t* bytes) {
+    std::lock_guard<std::mutex> lock(g_xdp_mutex);
+    XdpHitCounter hits;
+    if (g_xdp == nullptr || !g_xdp->flow_hits(flow_id, &hits)) {
+        return -1;
+    }
+    if (packets != nullptr) *packets = hits.packets;
+    if (bytes != nullptr) *bytes = hits.bytes;
+    return 0;
+}
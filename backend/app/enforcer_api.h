@@ -0,0 +1,216 @@
+#ifndef ENFORCER_API_H
+#define ENFORCER_API_H
+
+#include <cstdint>
+
+// C_LatencyHistogram and C_SketchAlert (shared with the capture engine)
+#include "../src/latency_histogram.h"
+#include "../src/packet_schema.h"
+
+// Required signatures for the enforcer library (libenforcer.so), used by
+// firewall_enforce.py. All functions act on one process-wide
+// CompiledRuleEngine (see enforcer_instance()).
+
+/**
+ * @brief C view of FirewallRule (rule_engine.h). Addresses use the
+ * FlowTuple layout: IPv4 is IPv4-mapped (::ffff:a.b.c.d).
+ */
+typedef struct C_FirewallRule {
+    uint32_t priority;      // Lower wins; ties go to the rule added first
+    uint8_t  ip_version;    // 4, 6, or 0 for both (wildcard addresses only)
+    uint8_t  protocol;      // 0 = any
+    uint8_t  src_prefix;    // 0 = any source
+    uint8_t  dst_prefix;    // 0 = any destination
+    uint8_t  src_addr[16];
+    uint8_t  dst_addr[16];
+    uint16_t src_port_lo;   // Inclusive; 0-65535 = any
+    uint16_t src_port_hi;
+    uint16_t dst_port_lo;
+    uint16_t dst_port_hi;
+    uint8_t  action;        // FirewallAction
+    uint8_t  reserved[3];
+    uint32_t rate_pps;      // RATE_LIMIT only: per-source packets/s (0 = the engine's source limit)
+    uint32_t rate_burst;    // ... and burst, in packets
+} C_FirewallRule;
+
+typedef struct C_RuleEngineStats {
+    uint64_t generation;     // Rule sets published so far
+    uint64_t staged_rules;   // Rules added and not removed
+    uint64_t rules;          // Rules in the published set
+    uint64_t prefix_rules;   // ... matched by the address fast path
+    uint64_t general_rules;  // ... matched by bitset classification
+    uint64_t memory_bytes;   // Size of the published lookup structures
+    uint64_t compile_ns;     // Time the last compile took
+    uint64_t flow_policies;           // Flows with an enforced policy (enforcer_enforce_flow)
+    uint64_t flow_policies_rejected;  // ... refused at the enforcer_set_flow_limit cap
+} C_RuleEngineStats;
+
+typedef struct C_DecisionStats {
+    uint64_t pass;            // Decisions by FirewallAction
+    uint64_t drop;
+    uint64_t reject;
+    uint64_t rate_limit;      // Within a RATE_LIMIT bucket (forwarded)
+    uint64_t rate_limited;    // ... of the drops, over a RATE_LIMIT bucket
+    uint64_t default_policy;  // Decided by the default action
+} C_DecisionStats;
+
+typedef struct C_XdpStats {
+    uint32_t attached;             // 1 while the XDP program is on an interface
+    uint32_t ifindex;
+    uint64_t flow_entries;         // Flow policies mirrored into the kernel
+    uint64_t prefix_entries;       // DROP prefixes mirrored into the kernel
+    uint64_t flow_drop_packets;    // Dropped in the driver by flow policy
+    uint64_t flow_drop_bytes;
+    uint64_t prefix_drop_packets;  // ... by prefix rule
+    uint64_t prefix_drop_bytes;
+} C_XdpStats;
+
+class CompiledRuleEngine;
+
+/**
+ * @brief The engine behind the C functions, for in-process C++ callers.
+ */
+CompiledRuleEngine& enforcer_instance();
+
+// =================================================================
+// C EXPOSED FUNCTIONS
+// =================================================================
+
+extern "C" {
+
+/**
+ * Stages a rule under the (interned) rule_name, reported in decisions.
+ * Returns the rule handle (>= 0) or -1 if the rule is malformed.
+ * Takes effect on enforcer_commit().
+ */
+int enforcer_add_rule(const C_FirewallRule* rule, const char* rule_name);
+
+/**
+ * Unstages a rule. Returns 0, or -1 for an unknown handle.
+ */
+int enforcer_remove_rule(uint32_t handle);
+
+/**
+ * Stages an address-only rule for "a.b.c.d", "a.b.c.d/len", an IPv6
+ * address or an IPv6 prefix, matching the source (direction 0) or the
+ * destination (direction 1). Returns the rule handle or -1 if cidr does
+ * not parse. Blocking the same cidr again replaces the earlier rule.
+ */
+int enforcer_block_cidr(const char* cidr, int direction, uint8_t action, const char* rule_name);
+
+/**
+ * Unstages the rule enforcer_block_cidr added for (cidr, direction).
+ * Returns 0, or -1 if there is none.
+ */
+int enforcer_unblock_cidr(const char* cidr, int direction);
+
+/**
+ * Compiles the staged rules and publishes them atomically; packets never
+ * wait for it. Returns 0, or -1 if the rule set is too large (the previous
+ * set stays in force).
+ */
+int enforcer_commit();
+
+/**
+ * Bans (or allows) one flow by FlowKey; effective immediately.
+ */
+int enforcer_enforce_flow(uint64_t flow_id, uint8_t action);
+
+/**
+ * Caps the flows enforcer_enforce_flow can hold (0 = no cap, the default)
+ * and allocates room for them now: enforcing then never allocates, and a
+ * flood of bans cannot grow the engine. New flows past the cap are refused
+ * (C_RuleEngineStats.flow_policies_rejected). Returns 0.
+ */
+int enforcer_set_flow_limit(uint32_t max_flows);
+
+/**
+ * The action for packets no rule matches (FirewallAction, PASS by default);
+ * the data path sees it from its next decision on. Returns 0, or -1 for an
+ * unknown action.
+ */
+int enforcer_set_default_action(uint8_t action);
+
+/**
+ * Token buckets (packets per second, burst in packets; rate 0 = unlimited)
+ * for flows enforced with RATE_LIMIT and for sources matching a RATE_LIMIT
+ * rule. Buckets are charged at the packets' capture timestamps; packets
+ * over the limit are decided DROP with rule "RATE_LIMITED".
+ */
+int enforcer_set_rate_limits(uint32_t flow_pps, uint32_t flow_burst,
+                             uint32_t source_pps, uint32_t source_burst);
+
+/**
+ * Decides the fate of one Ethernet frame. Returns the FirewallAction and
+ * stores the deciding rule's id in *rule_id (if non-null).
+ */
+int enforcer_classify(const uint8_t* frame, uint16_t len, uint16_t* rule_id);
+
+/**
+ * Decides n frames captured at ts_ns[i] (ns since the epoch, 0 = now):
+ * rate limits are charged at those times, and the capture -> decision
+ * latency is recorded (enforcer_get_decision_latency). Stores each
+ * FirewallAction in actions[i] and, if rule_ids is non-null, the deciding
+ * rule in rule_ids[i]. Returns n, or -1 on a null array.
+ */
+int enforcer_classify_batch(const uint8_t* const* frames, const uint16_t* lens, const uint64_t* ts_ns,
+                            uint8_t* actions, uint16_t* rule_ids, uint32_t n);
+
+/**
+ * Copies the name of rule_id into buf (NUL-terminated, truncated to len).
+ * Returns the full name length.
+ */
+int enforcer_rule_name(uint16_t rule_id, char* buf, int len);
+
+int enforcer_get_stats(C_RuleEngineStats* stats);
+
+/**
+ * Decisions handed out so far, by action. Lock-free; never stalls the data
+ * path. Returns 0, or -1 if stats is null.
+ */
+int enforcer_get_decision_stats(C_DecisionStats* stats);
+
+/**
+ * Histogram of capture timestamp -> decision for the packets decided with
+ * enforcer_classify_batch (same layout as get_latency_histogram in the
+ * capture engine, so the two merge). Returns 0, or -1 if histogram is null.
+ */
+int enforcer_get_decision_latency(C_LatencyHistogram* histogram);
+
+/**
+ * Alert sink for the capture engine's traffic sketches, with the signature
+ * of its sniffer_alert_callback: register it with
+ * set_sketch_alert_callback(enforcer_sketch_alert, engine) to ban flows
+ * natively, on the engine's alert dispatcher thread (so the XDP map
+ * update and ban table rebuilds stay off the capture threads). Alerts
+ * flagged C_ALERT_FLAG_ENFORCE apply alert->action to alert->flow_id through
+ * EnforcementEngine::enforce_flow_policy, on the EnforcementEngine* passed
+ * as engine (null = the engine behind these functions); the others are
+ * ignored.
+ */
+void enforcer_sketch_alert(const C_SketchAlert* alert, void* engine);
+
+/**
+ * Loads the XDP drop program, attaches it to ifname (xdp_flags: 0, or
+ * XDP_FLAGS_SKB_MODE / XDP_FLAGS_DRV_MODE from linux/if_link.h) and starts
+ * mirroring flow policies and offloadable DROP prefixes into it; commits
+ * the staged rules. Needs CAP_BPF and CAP_NET_ADMIN. Returns 0 or -1.
+ */
+int enforcer_xdp_attach(const char* ifname, uint32_t xdp_flags);
+
+/**
+ * Stops mirroring and removes the XDP program. Returns 0, or -1 if none.
+ */
+int enforcer_xdp_detach();
+
+int enforcer_xdp_get_stats(C_XdpStats* stats);
+
+/**
+ * Packets/bytes the XDP program matched for one mirrored flow policy.
+ * Returns 0, or -1 if the flow is not in the kernel map.
+ */
+int enforcer_xdp_flow_hits(uint64_t flow_id, uint64_t* packets, uint64_t* bytes);
+
+}
+
+#endif // ENFORCER_API_H
@@ -1,10 +1,17 @@
 #ifndef FIREWALL_ENFORCE_H
 #define FIREWALL_ENFORCE_H
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
 #include <atomic>
-#include <map>
+#include <mutex>
+#include <time.h>
+#include <type_traits>
+
+#include "ban_table.h"
+#include "rate_limiter.h"
+#include "../src/packet_parser.h"
 
 // ====================================================================
 // A) Enforcement Decision Structure (Data-Plane Action)
@@ -18,17 +25,106 @@ enum class FirewallAction : uint8_t {
     PASS = 0,    // Allow the packet/flow to proceed
     DROP = 1,    // Discard the packet immediately (silent)
     REJECT = 2,  // Discard and send an ICMP/TCP RST notification
-    RATE_LIMIT = 3 // Throttle the flow (Advanced)
+    RATE_LIMIT = 3 // Throttle the flow: forwarded within its token bucket; excess packets get DROP (RULE_RATE_LIMITED)
+};
+
+/**
+ * @brief Compact index of a rule name in the RuleRegistry.
+ */
+using RuleId = uint16_t;
+
+// Rules every engine can report; interned first, so their ids are fixed.
+constexpr RuleId RULE_DEFAULT_POLICY = 0;
+constexpr RuleId RULE_JUMBO_PACKET = 1;
+constexpr RuleId RULE_FLOW_POLICY = 2;
+constexpr RuleId RULE_RATE_LIMITED = 3;
+
+/**
+ * @brief Interned rule names. Decisions carry a RuleId; the name is only
+ * looked up when a decision is reported (logs, alerts, Python).
+ *
+ * intern() is for the control plane (serialized by a mutex); name() is
+ * lock-free. Names are never removed, so an id stays valid forever.
+ */
+class RuleRegistry {
+public:
+    static constexpr size_t MAX_RULES = 4096;
+    static constexpr RuleId INVALID_RULE = UINT16_MAX;
+
+    static RuleRegistry& instance() {
+        static RuleRegistry registry;
+        return registry;
+    }
+
+    /**
+     * @brief Returns the id of a rule name, adding it if it is new.
+     * @return The id, or INVALID_RULE if the registry is full.
+     */
+    RuleId intern(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const size_t count = count_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i) {
+            if (names_[i] == name) {
+                return static_cast<RuleId>(i);
+            }
+        }
+        if (count == MAX_RULES) {
+            return INVALID_RULE;
+        }
+        names_[count] = name;
+        count_.store(count + 1, std::memory_order_release);
+        return static_cast<RuleId>(count);
+    }
+
+    /**
+     * @brief The name of a rule id ("UNKNOWN_RULE" if it was never interned).
+     */
+    const char* name(RuleId id) const {
+        if (id >= count_.load(std::memory_order_acquire)) {
+            return "UNKNOWN_RULE";
+        }
+        return names_[id].c_str();
+    }
+
+    size_t size() const { return count_.load(std::memory_order_acquire); }
+
+private:
+    RuleRegistry() {
+        intern("DEFAULT_POLICY");
+        intern("JUMBO_PACKET");
+        intern("FLOW_POLICY");
+        intern("RATE_LIMITED");
+    }
+
+    std::mutex mutex_;
+    std::atomic<size_t> count_{0};
+    std::string names_[MAX_RULES];
 };
 
 /**
  * @brief Represents the decision made by the packet processing logic.
+ * Trivially copyable and 4 bytes wide: building one never allocates.
  */
 struct PacketDecision {
     FirewallAction action;
-    // Optional: a short string/ID indicating which policy triggered the action
-    std::string rule_id; 
+    uint8_t reserved;
+    // Which policy triggered the action (index into RuleRegistry)
+    RuleId rule_id;
+
+    const char* rule_name() const { return RuleRegistry::instance().name(rule_id); }
 };
+static_assert(std::is_trivially_copyable<PacketDecision>::value, "PacketDecision is copied per packet");
+static_assert(sizeof(PacketDecision) == 4, "PacketDecision should fit in a register");
+
+/**
+ * @brief Wall-clock time in ns: the time base of capture timestamps, used
+ * when the caller does not pass packet timestamps.
+ */
+inline uint64_t enforcement_clock_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
 
 
 // ====================================================================
@@ -36,9 +132,9 @@ struct PacketDecision {
 //    This would be the interface to update the fast-path rules.
 // ====================================================================
 
-// Define a simple Flow Identifier (e.g., source IP/port, dest IP/port, protocol)
-// For a real system, this would be more complex (e.g., a union or struct of 5-tuple).
-using FlowKey = uint64_t; // A simplified hash of the 5-tuple for lookup
+// Flow Identifier: the 64-bit hash of the directional 5-tuple, as computed by
+// flow_key_of() in src/packet_parser.h (the engine's flow_hash / flow_id).
+using FlowKey = uint64_t;
 
 /**
  * @brief Abstract class for the enforcement layer. 
@@ -55,6 +151,29 @@ public:
      * @return The determined action.
      */
     virtual PacketDecision get_decision(const uint8_t* packet_data, uint16_t len) = 0;
+
+    /**
+     * @brief Classifies a whole batch: out[i] = get_decision(pkts[i], lens[i]).
+     * Engines override it with a non-virtual loop; this fallback makes one
+     * virtual call per packet.
+     */
+    virtual void get_decisions(const uint8_t* const* pkts, const uint16_t* lens,
+                               PacketDecision* out, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = get_decision(pkts[i], lens[i]);
+        }
+    }
+
+    /**
+     * @brief get_decisions() with each packet's capture timestamp (ns since
+     * the epoch), which drives RATE_LIMIT token buckets. Engines without
+     * rate limits may ignore the timestamps (the default).
+     */
+    virtual void get_decisions_at(const uint8_t* const* pkts, const uint16_t* lens, const uint64_t* ts_ns,
+                                  PacketDecision* out, size_t n) {
+        (void)ts_ns;
+        get_decisions(pkts, lens, out, n);
+    }
     
     /**
      * @brief Adds a specific flow to a policy table (e.g., ban this malicious flow).
@@ -74,33 +193,102 @@ public:
 // C) Simple Implementation Example (In a separate .cpp file)
 // ====================================================================
 
-// A basic map to simulate flow tracking and banning.
-class SimpleFlowEnforcer : public EnforcementEngine {
+// Flow banning backed by a lock-free, epoch-published ban table: the data
+// path never locks or allocates, the control plane updates in place.
+class SimpleFlowEnforcer final : public EnforcementEngine {
 private:
     std::atomic<FirewallAction> default_action_{FirewallAction::PASS};
-    // Map to store banned flows (for simulation)
-    std::map<FlowKey, FirewallAction> enforced_flows_; 
+    std::atomic<RateLimit> flow_limit_{RateLimits().flow};
+    // Banned flows; a RATE_LIMIT flow keeps its token bucket in the entry's state word.
+    ConcurrentBanTable<FirewallAction> enforced_flows_;
+    std::atomic<uint64_t> flow_policies_set_{0};
+
+    // The per-packet policy, shared by all entry points. The caller holds
+    // a read guard on the ban table's epoch domain. ts_ns 0 = now (the clock
+    // is only read if a rate limit needs it).
+    PacketDecision decide(const uint8_t* packet_data, uint16_t len, FirewallAction default_action,
+                          const RateLimit& flow_limit, uint64_t ts_ns) {
+        // Example: Drop any packet over 1500 bytes (malformed/jumbo check)
+        if (len > 1500) {
+            return {FirewallAction::DROP, 0, RULE_JUMBO_PACKET};
+        }
+
+        // Parse the headers to get the FlowKey and look it up (lock-free).
+        const ParsedPacket parsed = parse_packet(packet_data, len);
+        FirewallAction action;
+        std::atomic<uint64_t>* bucket;
+        if (parsed.valid && enforced_flows_.lookup_unguarded(flow_key_of(parsed.tuple), &action, &bucket)) {
+            if (action == FirewallAction::RATE_LIMIT &&
+                !token_bucket::consume(*bucket, ts_ns ? ts_ns : enforcement_clock_ns(), flow_limit)) {
+                return {FirewallAction::DROP, 0, RULE_RATE_LIMITED};
+            }
+            return {action, 0, RULE_FLOW_POLICY};
+        }
+
+        return {default_action, 0, RULE_DEFAULT_POLICY};
+    }
 
 public:
     // This is where your libpcap/DPDK logic would call to check the fate of a packet.
     PacketDecision get_decision(const uint8_t* packet_data, uint16_t len) override {
-        // In a real system, you'd parse the headers here to get FlowKey.
-        // For simplicity, we'll just check the default action.
-        
-        // Example: Drop any packet over 1500 bytes (malformed/jumbo check)
-        if (len > 1500) {
-            return {FirewallAction::DROP, "JUMBO_PACKET"};
+        EpochDomain::ReadGuard guard(enforced_flows_.domain());
+        return decide(packet_data, len, default_action_.load(), flow_limit_.load(), 0);
+    }
+
+    // One read section and one load of the settings for the whole batch.
+    void get_decisions(const uint8_t* const* pkts, const uint16_t* lens,
+                       PacketDecision* out, size_t n) override {
+        EpochDomain::ReadGuard guard(enforced_flows_.domain());
+        const FirewallAction default_action = default_action_.load();
+        const RateLimit flow_limit = flow_limit_.load();
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = decide(pkts[i], lens[i], default_action, flow_limit, 0);
         }
+    }
 
-        // TODO: Look up FlowKey in enforced_flows_ map.
-        
-        return {default_action_.load(), "DEFAULT_POLICY"};
+    void get_decisions_at(const uint8_t* const* pkts, const uint16_t* lens, const uint64_t* ts_ns,
+                          PacketDecision* out, size_t n) override {
+        EpochDomain::ReadGuard guard(enforced_flows_.domain());
+        const FirewallAction default_action = default_action_.load();
+        const RateLimit flow_limit = flow_limit_.load();
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = decide(pkts[i], lens[i], default_action, flow_limit, ts_ns[i]);
+        }
     }
     
+    // Counted, not logged: a sketch alert burst can ban thousands of flows a second.
     void enforce_flow_policy(FlowKey flow_id, FirewallAction action) override {
-        enforced_flows_[flow_id] = action;
-        std::cout << "CONTROL-PLANE: Enforced action " << (int)action 
-                  << " on flow: " << flow_id << std::endl;
+        if (enforced_flows_.insert(flow_id, action)) {
+            flow_policies_set_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Policies enforce_flow_policy() set, and those refused at the ban table's limit
+    uint64_t flow_policies_set() const {
+        return flow_policies_set_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t flow_policies_rejected() const {
+        return enforced_flows_.rejected();
+    }
+
+    /**
+     * @brief Lifts the policy on a flow (control plane).
+     * @return true if the flow had one.
+     */
+    bool remove_flow_policy(FlowKey flow_id) {
+        return enforced_flows_.erase(flow_id);
+    }
+
+    /**
+     * @brief Lifts every flow policy (control plane).
+     */
+    void clear_flow_policies() {
+        enforced_flows_.clear();
+    }
+
+    size_t enforced_flow_count() const {
+        return enforced_flows_.size();
     }
 
     FirewallAction get_default_action() const override {
@@ -111,5 +299,11 @@ public:
     void set_default_action(FirewallAction action) {
         default_action_.store(action);
     }
+
+    // Token bucket for flows enforced with RATE_LIMIT (this engine has no source rules)
+    void set_rate_limits(const RateLimits& limits) {
+        flow_limit_.store(limits.flow);
+    }
 };
 
+#endif // FIREWALL_ENFORCE_H
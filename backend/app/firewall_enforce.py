@@ -3,11 +3,118 @@ Firewall Enforcement Module - Python implementation
 Handles firewall actions for detected threats
 """
 import os
+import ctypes
 import logging
-from typing import Dict, Any, Optional
+from typing import Dict, Any, Optional, List
 from datetime import datetime
 import json
 
+# ===================================================================
+# NATIVE RULE ENGINE (backend/app/enforcer_api.h)
+# ===================================================================
+
+# Optional: without the library the Python blocklist below still works, it
+# just is not enforced on the packet path.
+ENFORCER_LIB_PATH = os.environ.get("ENFORCER_LIB_PATH", "/usr/local/lib/libenforcer.so")
+
+# FirewallAction (firewall_enforce.h)
+FIREWALL_ACTION_PASS = 0
+FIREWALL_ACTION_DROP = 1
+FIREWALL_ACTION_REJECT = 2
+FIREWALL_ACTION_RATE_LIMIT = 3
+
+ENFORCER_DIRECTION_SRC = 0
+ENFORCER_DIRECTION_DST = 1
+
+# Optional XDP drop offload: set to an interface name to attach at startup
+ENFORCER_XDP_INTERFACE = os.environ.get("ENFORCER_XDP_INTERFACE", "")
+XDP_FLAGS_SKB_MODE = 1 << 1
+XDP_FLAGS_DRV_MODE = 1 << 2
+
+class C_RuleEngineStats(ctypes.Structure):
+    """Mirrors C_RuleEngineStats: state of the published rule set."""
+    _fields_ = [
+        ("generation", ctypes.c_uint64),
+        ("staged_rules", ctypes.c_uint64),
+        ("rules", ctypes.c_uint64),
+        ("prefix_rules", ctypes.c_uint64),
+        ("general_rules", ctypes.c_uint64),
+        ("memory_bytes", ctypes.c_uint64),
+        ("compile_ns", ctypes.c_uint64),
+        ("flow_policies", ctypes.c_uint64),
+        ("flow_policies_rejected", ctypes.c_uint64),
+    ]
+
+class C_DecisionStats(ctypes.Structure):
+    """Mirrors C_DecisionStats: data-path decisions by action."""
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "pass", "drop", "reject", "rate_limit", "rate_limited", "default_policy",
+    )]
+
+# C_LatencyHistogram (backend/src/latency_histogram.h)
+LATENCY_SUB_BITS = 3
+LATENCY_MAX_MSB = 42
+LATENCY_BUCKETS = (LATENCY_MAX_MSB - LATENCY_SUB_BITS + 2) << LATENCY_SUB_BITS
+
+class C_LatencyHistogram(ctypes.Structure):
+    """Mirrors C_LatencyHistogram: capture -> decision latencies in nanoseconds."""
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "count", "sum_ns", "min_ns", "max_ns", "p50_ns", "p90_ns", "p99_ns", "p999_ns",
+    )] + [
+        ("buckets", ctypes.c_uint64 * LATENCY_BUCKETS),
+    ]
+
+class C_XdpStats(ctypes.Structure):
+    """Mirrors C_XdpStats: what the XDP program holds and has dropped."""
+    _fields_ = [
+        ("attached", ctypes.c_uint32),
+        ("ifindex", ctypes.c_uint32),
+        ("flow_entries", ctypes.c_uint64),
+        ("prefix_entries", ctypes.c_uint64),
+        ("flow_drop_packets", ctypes.c_uint64),
+        ("flow_drop_bytes", ctypes.c_uint64),
+        ("prefix_drop_packets", ctypes.c_uint64),
+        ("prefix_drop_bytes", ctypes.c_uint64),
+    ]
+
+def load_rule_engine(path: str = ENFORCER_LIB_PATH) -> Optional[ctypes.CDLL]:
+    """Loads libenforcer.so, or returns None if it is not installed."""
+    if not os.path.exists(path):
+        print(f"[Firewall] Native rule engine not found at {path}; using the Python blocklist only")
+        return None
+    try:
+        lib = ctypes.CDLL(path)
+        lib.enforcer_block_cidr.argtypes = [ctypes.c_char_p, ctypes.c_int, ctypes.c_uint8, ctypes.c_char_p]
+        lib.enforcer_block_cidr.restype = ctypes.c_int
+        lib.enforcer_unblock_cidr.argtypes = [ctypes.c_char_p, ctypes.c_int]
+        lib.enforcer_unblock_cidr.restype = ctypes.c_int
+        lib.enforcer_commit.argtypes = []
+        lib.enforcer_commit.restype = ctypes.c_int
+        lib.enforcer_set_rate_limits.argtypes = [ctypes.c_uint32] * 4
+        lib.enforcer_set_rate_limits.restype = ctypes.c_int
+        lib.enforcer_set_flow_limit.argtypes = [ctypes.c_uint32]
+        lib.enforcer_set_flow_limit.restype = ctypes.c_int
+        lib.enforcer_set_default_action.argtypes = [ctypes.c_uint8]
+        lib.enforcer_set_default_action.restype = ctypes.c_int
+        lib.enforcer_get_stats.argtypes = [ctypes.POINTER(C_RuleEngineStats)]
+        lib.enforcer_get_stats.restype = ctypes.c_int
+        lib.enforcer_get_decision_stats.argtypes = [ctypes.POINTER(C_DecisionStats)]
+        lib.enforcer_get_decision_stats.restype = ctypes.c_int
+        lib.enforcer_get_decision_latency.argtypes = [ctypes.POINTER(C_LatencyHistogram)]
+        lib.enforcer_get_decision_latency.restype = ctypes.c_int
+        lib.enforcer_xdp_attach.argtypes = [ctypes.c_char_p, ctypes.c_uint32]
+        lib.enforcer_xdp_attach.restype = ctypes.c_int
+        lib.enforcer_xdp_detach.argtypes = []
+        lib.enforcer_xdp_detach.restype = ctypes.c_int
+        lib.enforcer_xdp_get_stats.argtypes = [ctypes.POINTER(C_XdpStats)]
+        lib.enforcer_xdp_get_stats.restype = ctypes.c_int
+        lib.enforcer_sketch_alert.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+        lib.enforcer_sketch_alert.restype = None
+        return lib
+    except (OSError, AttributeError) as e:
+        print(f"[Firewall] Failed to load native rule engine: {e}")
+        return None
+
 class FirewallEnforce:
     """
     Firewall enforcement class for implementing security actions
@@ -18,6 +125,10 @@ class FirewallEnforce:
         self.rate_limits = {}
         self.action_log = []
         self.logger = logging.getLogger(__name__)
+        self.rule_engine = load_rule_engine()
+        self.decision_log = None  # A PacketSniffer with a flow log (see log_decisions_to)
+        if ENFORCER_XDP_INTERFACE:
+            self.enable_xdp_offload(ENFORCER_XDP_INTERFACE)
         
         # Create data directory for logs
         os.makedirs("data/firewall_logs", exist_ok=True)
@@ -73,8 +184,8 @@ class FirewallEnforce:
         
         self.blocked_ips.add(ip_address)
         
-        # In a real implementation, this would add iptables rules
-        # For demo purposes, we'll just log it
+        # Compile the block into the native rule engine (drops on the packet path)
+        enforced = self._compile_blocks([ip_address], f"BLOCK_IP:{attack_type}")
         print(f"[Firewall] BLOCKED IP: {ip_address} (Attack: {attack_type})")
         
         return {
@@ -82,8 +193,38 @@ class FirewallEnforce:
             "action": "BLOCK_IP",
             "ip_address": ip_address,
             "attack_type": attack_type,
+            "enforced_natively": enforced,
             "blocked_at": datetime.now().isoformat()
         }
+
+    def block_ips(self, ip_addresses: List[str], attack_type: str) -> Dict[str, Any]:
+        """Block many IPs or CIDRs with a single rule-set compile"""
+        self.blocked_ips.update(ip_addresses)
+        enforced = self._compile_blocks(ip_addresses, f"BLOCK_IP:{attack_type}")
+        print(f"[Firewall] BLOCKED {len(ip_addresses)} IPs (Attack: {attack_type})")
+        return {
+            "status": "success",
+            "action": "BLOCK_IP",
+            "count": len(ip_addresses),
+            "attack_type": attack_type,
+            "enforced_natively": enforced,
+            "blocked_at": datetime.now().isoformat()
+        }
+
+    def _compile_blocks(self, ip_addresses: List[str], rule_name: str,
+                        action: int = FIREWALL_ACTION_DROP) -> bool:
+        """Stages source-address rules (DROP by default) and publishes them in one commit"""
+        if self.rule_engine is None:
+            return False
+        name = rule_name.encode()
+        for ip_address in ip_addresses:
+            if self.rule_engine.enforcer_block_cidr(ip_address.encode(), ENFORCER_DIRECTION_SRC,
+                                                    action, name) < 0:
+                print(f"[Firewall] Not a valid IP/CIDR for the rule engine: {ip_address}")
+        if self.rule_engine.enforcer_commit() != 0:
+            print("[Firewall] Rule engine rejected the rule set; previous rules stay in force")
+            return False
+        return True
     
     def _rate_limit(self, flow_id: str, attack_type: str) -> Dict[str, Any]:
         """Apply rate limiting to an IP"""
@@ -96,6 +237,8 @@ class FirewallEnforce:
             "reason": attack_type
         }
         
+        # Natively the source is held to the engine's per-source token bucket
+        enforced = self._compile_blocks([ip_address], f"RATE_LIMIT:{attack_type}", FIREWALL_ACTION_RATE_LIMIT)
         print(f"[Firewall] RATE LIMITED IP: {ip_address} (Attack: {attack_type})")
         
         return {
@@ -104,9 +247,28 @@ class FirewallEnforce:
             "ip_address": ip_address,
             "attack_type": attack_type,
             "limit": "10 requests/minute",
+            "enforced_natively": enforced,
             "limited_at": datetime.now().isoformat()
         }
+
+    def set_rate_limits(self, flow_pps: int, flow_burst: int, source_pps: int, source_burst: int) -> bool:
+        """Token buckets for rate-limited flows and sources (packets/s, burst; 0 pps = unlimited)"""
+        if self.rule_engine is None:
+            return False
+        return self.rule_engine.enforcer_set_rate_limits(flow_pps, flow_burst, source_pps, source_burst) == 0
     
+    def set_flow_limit(self, max_flows: int) -> bool:
+        """Caps (and preallocates) the native flow bans; bans past the cap are refused (0 = no cap)"""
+        if self.rule_engine is None:
+            return False
+        return self.rule_engine.enforcer_set_flow_limit(max_flows) == 0
+
+    def set_default_action(self, action: int) -> bool:
+        """What the native data path does with packets no rule matches (FirewallAction), effective at once"""
+        if self.rule_engine is None:
+            return False
+        return self.rule_engine.enforcer_set_default_action(action) == 0
+
     def _monitor(self, flow_id: str, attack_type: str) -> Dict[str, Any]:
         """Monitor a flow without blocking"""
         ip_address = flow_id.split(":")[0] if ":" in flow_id else flow_id
@@ -135,26 +297,35 @@ class FirewallEnforce:
         self.action_log.append(log_entry)
         print(f"[Firewall] ALLOWED: {flow_id} ({classification})")
     
+    def log_decisions_to(self, sniffer):
+        """
+        Records actions in the sniffer's columnar flow log (its decisions-ctl
+        stream, see PacketSniffer.set_flow_log) instead of the JSON files
+        """
+        self.decision_log = sniffer
+
     def _save_log(self, log_entry: Dict[str, Any]):
-        """Save log entry to file"""
+        """Save log entry: to the native flow log if attached, else appended to the day's JSON lines"""
+        if self.decision_log is not None and self._log_natively(log_entry):
+            return
         try:
-            log_file = f"data/firewall_logs/firewall_{datetime.now().strftime('%Y%m%d')}.json"
-            
-            # Read existing logs
-            logs = []
-            if os.path.exists(log_file):
-                with open(log_file, 'r') as f:
-                    logs = json.load(f)
-            
-            # Add new entry
-            logs.append(log_entry)
-            
-            # Save logs
-            with open(log_file, 'w') as f:
-                json.dump(logs, f, indent=2)
-                
+            log_file = f"data/firewall_logs/firewall_{datetime.now().strftime('%Y%m%d')}.jsonl"
+            with open(log_file, 'a') as f:
+                f.write(json.dumps(log_entry, default=str) + "\n")
         except Exception as e:
             print(f"[Firewall] Failed to save log: {e}")
+
+    def _log_natively(self, log_entry: Dict[str, Any]) -> bool:
+        actions = {"BLOCK_IP": FIREWALL_ACTION_DROP, "RATE_LIMIT": FIREWALL_ACTION_RATE_LIMIT,
+                   "MONITOR": FIREWALL_ACTION_PASS}
+        flow_id = log_entry["flow_id"]
+        address, _, port = flow_id.rpartition(":") if flow_id.count(":") == 1 else (flow_id, "", "")
+        try:
+            return self.decision_log.log_decision(
+                address, actions.get(log_entry["action"], FIREWALL_ACTION_PASS), log_entry["attack_type"],
+                port=int(port) if port.isdigit() else 0)
+        except ValueError:
+            return False  # Not an address: keep it in the JSON log
     
     def get_blocked_ips(self) -> list:
         """Get list of currently blocked IPs"""
@@ -168,11 +339,40 @@ class FirewallEnforce:
         """Remove IP from blocked list"""
         if ip_address in self.blocked_ips:
             self.blocked_ips.remove(ip_address)
+            if self.rule_engine is not None:
+                if self.rule_engine.enforcer_unblock_cidr(ip_address.encode(), ENFORCER_DIRECTION_SRC) == 0:
+                    self.rule_engine.enforcer_commit()
             print(f"[Firewall] UNBLOCKED IP: {ip_address}")
             return {"status": "success", "ip_address": ip_address, "action": "UNBLOCK"}
         else:
             return {"status": "error", "message": f"IP {ip_address} not found in blocked list"}
     
+    def enable_xdp_offload(self, interface: str, skb_mode: bool = False) -> bool:
+        """Drops blocked traffic in the driver (XDP) before it reaches capture"""
+        if self.rule_engine is None:
+            return False
+        flags = XDP_FLAGS_SKB_MODE if skb_mode else 0
+        if self.rule_engine.enforcer_xdp_attach(interface.encode(), flags) != 0:
+            print(f"[Firewall] XDP offload unavailable on {interface}; enforcing in user space only")
+            return False
+        print(f"[Firewall] XDP drop offload enabled on {interface}")
+        return True
+
+    def disable_xdp_offload(self) -> bool:
+        """Removes the XDP program; the native rule engine keeps enforcing"""
+        return self.rule_engine is not None and self.rule_engine.enforcer_xdp_detach() == 0
+
+    def enforce_sketch_alerts(self, sniffer) -> bool:
+        """
+        Bans the flows the sniffer's traffic sketches (see
+        TrafficSniffer.set_sketch_config) or its flow model (see
+        set_flow_model) flag natively, on its alert dispatcher thread
+        """
+        if self.rule_engine is None:
+            return False
+        sniffer.connect_enforcer(self.rule_engine)
+        return True
+
     def get_stats(self) -> Dict[str, Any]:
         """Get firewall statistics"""
         return {
@@ -180,5 +380,70 @@ class FirewallEnforce:
             "rate_limited_ips_count": len(self.rate_limits),
             "total_actions": len(self.action_log),
             "blocked_ips": list(self.blocked_ips),
-            "rate_limited_ips": list(self.rate_limits.keys())
+            "rate_limited_ips": list(self.rate_limits.keys()),
+            "native_rule_engine": self._rule_engine_stats(),
+            "decisions": self.decision_stats(),
+            "xdp_offload": self._xdp_stats()
         }
+
+    def _rule_engine_stats(self) -> Optional[Dict[str, int]]:
+        """Counters of the published native rule set (None without the library)"""
+        if self.rule_engine is None:
+            return None
+        stats = C_RuleEngineStats()
+        self.rule_engine.enforcer_get_stats(ctypes.byref(stats))
+        return {name: getattr(stats, name) for name, _ in C_RuleEngineStats._fields_}
+
+    def decision_stats(self) -> Optional[Dict[str, int]]:
+        """Native data-path decisions by action (None without the library)"""
+        if self.rule_engine is None:
+            return None
+        stats = C_DecisionStats()
+        self.rule_engine.enforcer_get_decision_stats(ctypes.byref(stats))
+        return {name: getattr(stats, name) for name, _ in C_DecisionStats._fields_}
+
+    def metrics_text(self) -> str:
+        """
+        The native enforcer's counters as OpenMetrics families (enforcer_*),
+        to follow the sniffer's in a scrape; empty without the library.
+        """
+        decisions = self.decision_stats()
+        rules = self._rule_engine_stats()
+        if decisions is None or rules is None:
+            return ""
+        lines = [
+            "# TYPE enforcer_decisions counter",
+            "# HELP enforcer_decisions Data-path decisions, by action",
+        ]
+        lines += [f'enforcer_decisions_total{{action="{name}"}} {value}' for name, value in decisions.items()]
+        for name, kind, help_text in (
+            ("rules", "gauge", "Rules in the published rule set"),
+            ("flow_policies", "gauge", "Flows banned or allowed one by one"),
+            ("flow_policies_rejected", "counter", "Flow bans refused at the flow limit"),
+            ("generation", "gauge", "Rule sets published"),
+        ):
+            suffix = "_total" if kind == "counter" else ""
+            lines += [
+                f"# TYPE enforcer_{name} {kind}",
+                f"# HELP enforcer_{name} {help_text}",
+                f"enforcer_{name}{suffix} {rules[name]}",
+            ]
+        return "\n".join(lines) + "\n"
+
+    def decision_latency(self) -> Optional[Dict[str, Any]]:
+        """Capture timestamp -> native decision latency: percentiles (ns) and raw buckets"""
+        if self.rule_engine is None:
+            return None
+        histogram = C_LatencyHistogram()
+        self.rule_engine.enforcer_get_decision_latency(ctypes.byref(histogram))
+        stats = {name: getattr(histogram, name) for name, _ in C_LatencyHistogram._fields_ if name != "buckets"}
+        stats["buckets"] = list(histogram.buckets)
+        return stats
+
+    def _xdp_stats(self) -> Optional[Dict[str, int]]:
+        """In-kernel drop counters (None without the library)"""
+        if self.rule_engine is None:
+            return None
+        stats = C_XdpStats()
+        self.rule_engine.enforcer_xdp_get_stats(ctypes.byref(stats))
+        return {name: getattr(stats, name) for name, _ in C_XdpStats._fields_}
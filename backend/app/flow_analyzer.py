@@ -205,4 +205,78 @@ class FlowAnalyzer:
         print("[Analyzer] Signal received to stop.")
         self._stop_event.set()
         if self.flusher_thread.is_alive():
-            self.flusher_thread.join(timeout=self.time_window * 2)
\ No newline at end of file
+            self.flusher_thread.join(timeout=self.time_window * 2)
+
+class NativeFlowAnalyzer:
+    """
+    Drop-in replacement for FlowAnalyzer when packets are captured by the C++
+    engine (backend/src/traffic_sniffer.py). Parsing, the 5-tuple flow table
+    and the timeout/FIN expiry all run natively; finished flows arrive as a
+    float32 feature matrix (same columns as FlowAnalyzer) with one FFI call
+    per batch.
+
+    With `on_batch`, each batch is handed over whole as
+    on_batch(features, flow_ids, analyzer): `features` is an [N x F] zero-copy
+    view meant for one vectorized predict, valid until the callback returns;
+    flow_key(i) names row i for the enforcer. Without it, every flow is put
+    on `output_queue` as the same (feature_vector, flow_id) item that
+    FlowAnalyzer produces.
+
+    With the model running in the engine (sniffer.set_flow_model()), the
+    verdicts are already enforced there; `on_alerts` gets them, with the
+    sketch alerts, as on_alerts(alerts, analyzer): a list of
+    C_SketchAlert.as_dict() entries, kind "model" for the verdicts.
+
+    The time window is the sniffer's `flow_window`.
+    """
+
+    def __init__(self, sniffer, output_queue: Queue = None, poll_interval: float = 0.05, on_batch=None,
+                 on_alerts=None):
+        self.sniffer = sniffer
+        self.output_queue = output_queue
+        self.poll_interval = poll_interval
+        self.on_batch = on_batch
+        self.on_alerts = on_alerts
+        self._stop_event = threading.Event()
+        print("[Analyzer] Initialized (native flow table). Flow aggregation window:",
+              sniffer.flow_window, "seconds.")
+
+    def flow_key(self, row: int) -> str:
+        """
+        FlowAnalyzer-style key of row `row` of the current batch, e.g. for enforcement.
+        """
+        record = self.sniffer.flow_buffer[row]
+        # Same format as FlowAnalyzer._get_flow_key so downstream consumers are unchanged
+        return str((record.src_ip, record.dst_ip, record.src_port, record.dst_port, record.protocol))
+
+    def start_analysis(self):
+        """
+        Main loop: drains finished flows from the engine one batch at a time.
+        """
+        print("[Analyzer] Native flow loop started.")
+        while not self._stop_event.is_set():
+            try:
+                if self.on_alerts is not None:
+                    alerts = self.sniffer.read_sketch_alerts()
+                    if alerts:
+                        self.on_alerts([alert.as_dict() for alert in self.sniffer.alert_buffer[:alerts]], self)
+                features, flow_ids, count = self.sniffer.read_flow_features()
+                if count == 0:
+                    time.sleep(self.poll_interval)
+                    continue
+
+                if self.on_batch is not None:
+                    self.on_batch(features, flow_ids, self)
+                else:
+                    for row in range(count):
+                        # Copy: the batch buffer is reused by the next read
+                        self.output_queue.put((features[row:row + 1].copy(), self.flow_key(row)))
+            except Exception as e:
+                print(f"[Analyzer ERROR] Failed to process flows: {e}")
+                time.sleep(1)
+
+        print("[Analyzer] Analysis loop finished.")
+
+    def stop_analysis(self):
+        print("[Analyzer] Signal received to stop.")
+        self._stop_event.set()
@@ -274,44 +274,56 @@ class SecurityClassifierTrainer:
             print(f"Failed to load models: {e}")
             return False
     
+    # Threat level per predicted class
+    THREAT_LEVELS = {
+        'Normal': 'LOW',
+        'Bot_Activity': 'MEDIUM',
+        'Brute_Force': 'MEDIUM',
+        'SQL_Injection': 'HIGH',
+        'XSS': 'HIGH',
+        'Command_Injection': 'HIGH',
+        'Path_Traversal': 'HIGH',
+        'DDoS_Attack': 'CRITICAL'
+    }
+
     def predict(self, text: str, model_name: str = 'random_forest') -> Dict[str, Any]:
         """Make prediction using specified model"""
         if model_name not in self.models:
             return {"error": f"Model {model_name} not available"}
+        return self.predict_batch([text], model_name)[0]
+
+    def predict_batch(self, texts: List[str], model_name: str = 'random_forest') -> List[Dict[str, Any]]:
+        """Predict a whole batch with one vectorizer pass and one model call"""
+        if model_name not in self.models:
+            return [{"error": f"Model {model_name} not available"} for _ in texts]
+        if not texts:
+            return []
         
         model = self.models[model_name]['model']
         
         # Vectorize input
-        X = self.vectorizer.transform([text])
+        X = self.vectorizer.transform(texts)
         
         # Predict
-        prediction = model.predict(X)[0]
-        probabilities = model.predict_proba(X)[0] if hasattr(model, 'predict_proba') else [1.0, 0.0]
+        predictions = model.predict(X)
+        if hasattr(model, 'predict_proba'):
+            probabilities = model.predict_proba(X)
+        else:
+            probabilities = np.tile([1.0, 0.0], (len(texts), 1))
         
         # Get confidence
-        confidence = max(probabilities)
-        
-        # Determine threat level
-        threat_levels = {
-            'Normal': 'LOW',
-            'Bot_Activity': 'MEDIUM',
-            'Brute_Force': 'MEDIUM',
-            'SQL_Injection': 'HIGH',
-            'XSS': 'HIGH',
-            'Command_Injection': 'HIGH',
-            'Path_Traversal': 'HIGH',
-            'DDoS_Attack': 'CRITICAL'
-        }
-        
-        threat_level = threat_levels.get(prediction, 'LOW')
+        confidences = probabilities.max(axis=1)
         
-        return {
-            'classification': prediction,
-            'confidence': float(confidence),
-            'threat_level': threat_level,
-            'model_used': model_name,
-            'probabilities': dict(zip(model.classes_, probabilities))
-        }
+        results = []
+        for prediction, confidence, row in zip(predictions, confidences, probabilities):
+            results.append({
+                'classification': prediction,
+                'confidence': float(confidence),
+                'threat_level': self.THREAT_LEVELS.get(prediction, 'LOW'),
+                'model_used': model_name,
+                'probabilities': dict(zip(model.classes_, row))
+            })
+        return results
 
 def main():
     """Main training pipeline"""
@@ -5,7 +5,7 @@ Uses locally trained models for threat classification
 import os
 import joblib
 import numpy as np
-from typing import Dict, Any, Optional
+from typing import Dict, Any, List, Optional
 from .local_classifier_trainer import SecurityClassifierTrainer
 
 class LocalSecurityDetector:
@@ -56,6 +56,38 @@ class LocalSecurityDetector:
                 "analysis_method": "local_model_error"
             }
     
+    async def analyze_requests(self, requests: List[Dict[str, Any]]) -> List[Dict[str, Any]]:
+        """Analyze a batch of requests with one vectorized model call"""
+        
+        if not self.enabled:
+            return [await self.analyze_request(request_data) for request_data in requests]
+        
+        try:
+            texts = [self._prepare_request_text(request_data) for request_data in requests]
+            results = self.trainer.predict_batch(texts, self.current_model)
+            
+            return [
+                {
+                    **self._enhance_with_rules(request_data, result),
+                    "analysis_method": "local_model",
+                    "model_used": self.current_model,
+                    "source": "local_trained_model"
+                }
+                for request_data, result in zip(requests, results)
+            ]
+            
+        except Exception as e:
+            return [
+                {
+                    "error": f"Local model analysis failed: {str(e)}",
+                    "classification": "Model_Error",
+                    "confidence": 0.0,
+                    "threat_level": "LOW",
+                    "analysis_method": "local_model_error"
+                }
+                for _ in requests
+            ]
+    
     def _prepare_request_text(self, request_data: Dict[str, Any]) -> str:
         """Prepare request data for analysis"""
         parts = []
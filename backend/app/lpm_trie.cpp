@@ -0,0 +1,110 @@
+// app/lpm_trie.cpp
+
+#include "lpm_trie.h"
+
+// ====================================================================
+// A) Builder
+// ====================================================================
+
+LpmTrieBuilder::LpmTrieBuilder() : root_(1u << 16) {}
+
+void LpmTrieBuilder::fill(Entry& entry, uint32_t value) {
+    if (entry.child < 0) {
+        entry.value = value;
+        return;
+    }
+    for (Entry& below : nodes_[entry.child].entries) {
+        fill(below, value);
+    }
+}
+
+int32_t LpmTrieBuilder::child_of(int32_t node, unsigned index) {
+    Entry& entry = node < 0 ? root_[index] : nodes_[node].entries[index];
+    if (entry.child >= 0) {
+        return entry.child;
+    }
+    // Leaf pushing: the new node starts out with the value it replaces.
+    Node fresh;
+    for (Entry& below : fresh.entries) {
+        below.value = entry.value;
+    }
+    nodes_.push_back(fresh);  // May move nodes_: re-resolve the parent entry
+    const int32_t child = static_cast<int32_t>(nodes_.size() - 1);
+    (node < 0 ? root_[index] : nodes_[node].entries[index]).child = child;
+    return child;
+}
+
+void LpmTrieBuilder::insert(LpmKey prefix, unsigned length, uint32_t value) {
+    prefix = lpm_prefix_of(prefix, length);
+    const uint32_t top = static_cast<uint32_t>(prefix >> 112);
+    if (length <= 16) {
+        const uint32_t count = 1u << (16 - length);
+        for (uint32_t i = 0; i < count; ++i) {
+            fill(root_[top + i], value);
+        }
+        return;
+    }
+
+    int32_t node = child_of(-1, top);
+    for (unsigned offset = 16;; offset += 6) {
+        const unsigned index = static_cast<unsigned>((prefix << offset) >> 122);
+        if (length <= offset + 6) {
+            const unsigned count = 1u << (offset + 6 - length);
+            for (unsigned i = 0; i < count; ++i) {
+                fill(nodes_[node].entries[index + i], value);
+            }
+            return;
+        }
+        node = child_of(node, index);
+    }
+}
+
+uint32_t LpmTrieBuilder::lookup(LpmKey key) const {
+    const Entry* entry = &root_[static_cast<uint32_t>(key >> 112)];
+    for (unsigned offset = 16; entry->child >= 0; offset += 6) {
+        entry = &nodes_[entry->child].entries[static_cast<unsigned>((key << offset) >> 122)];
+    }
+    return entry->value;
+}
+
+// ====================================================================
+// B) Compression into the read-only layout
+// ====================================================================
+
+LpmTrie::LpmTrie() : root_(1u << 16, NO_MATCH) {}
+
+LpmTrie::LpmTrie(const LpmTrieBuilder& builder) : root_(1u << 16) {
+    // Breadth-first, so the children of every node end up contiguous.
+    std::vector<int32_t> source;  // Builder node behind nodes_[i]
+    for (size_t i = 0; i < root_.size(); ++i) {
+        const LpmTrieBuilder::Entry& entry = builder.root_[i];
+        if (entry.child < 0) {
+            root_[i] = entry.value;
+        } else {
+            root_[i] = INTERNAL | static_cast<uint32_t>(nodes_.size());
+            nodes_.push_back(Node{});
+            source.push_back(entry.child);
+        }
+    }
+
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        const LpmTrieBuilder::Node& from = builder.nodes_[source[i]];
+        Node node{0, 0, static_cast<uint32_t>(leaves_.size()), static_cast<uint32_t>(nodes_.size())};
+        bool have_leaf = false;
+        uint32_t last = 0;
+        for (unsigned k = 0; k < 64; ++k) {
+            const LpmTrieBuilder::Entry& entry = from.entries[k];
+            if (entry.child >= 0) {
+                node.vector |= 1ull << k;
+                nodes_.push_back(Node{});
+                source.push_back(entry.child);
+            } else if (!have_leaf || entry.value != last) {
+                node.leafvec |= 1ull << k;
+                leaves_.push_back(entry.value);
+                last = entry.value;
+                have_leaf = true;
+            }
+        }
+        nodes_[i] = node;
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef LPM_TRIE_H
+#define LPM_TRIE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Keys are left-aligned in 128 bits: an IPv6 address as is, an IPv4
+// address in the top 32 bits (see lpm_key_v4 / lpm_key_v6).
+using LpmKey = unsigned __int128;
+
+inline LpmKey lpm_key_v4(const uint8_t addr[4]) {
+    const uint32_t v = (uint32_t(addr[0]) << 24) | (uint32_t(addr[1]) << 16) |
+                       (uint32_t(addr[2]) << 8) | uint32_t(addr[3]);
+    return LpmKey(v) << 96;
+}
+
+inline LpmKey lpm_key_v6(const uint8_t addr[16]) {
+    LpmKey key = 0;
+    for (int i = 0; i < 16; ++i) {
+        key = (key << 8) | addr[i];
+    }
+    return key;
+}
+
+// The first `length` bits of key, the rest zeroed.
+inline LpmKey lpm_prefix_of(LpmKey key, unsigned length) {
+    return length == 0 ? 0 : key & (~LpmKey(0) << (128 - length));
+}
+
+// ====================================================================
+// A) Mutable builder (control plane)
+// ====================================================================
+
+/**
+ * @brief Uncompressed multibit trie used to build an LpmTrie.
+ *
+ * Strides are 16 bits at the root, then 6 bits per level, with leaf
+ * pushing (every entry holds the value of its longest covering prefix).
+ * Prefixes must be inserted in order of increasing length; a longer
+ * prefix then simply overrides the entries it covers.
+ */
+class LpmTrieBuilder {
+public:
+    LpmTrieBuilder();
+
+    /**
+     * @brief Maps every key under (prefix, length) to value (non-zero, < 2^31).
+     */
+    void insert(LpmKey prefix, unsigned length, uint32_t value);
+
+    /**
+     * @brief Value of the longest inserted prefix covering key, or 0.
+     */
+    uint32_t lookup(LpmKey key) const;
+
+private:
+    friend class LpmTrie;
+
+    struct Entry {
+        uint32_t value = 0;
+        int32_t child = -1;  // Index into nodes_, or -1 for a leaf
+    };
+    struct Node {
+        Entry entries[64];
+    };
+
+    void fill(Entry& entry, uint32_t value);
+    int32_t child_of(int32_t node, unsigned index);  // node -1 = root
+
+    std::vector<Entry> root_;
+    std::vector<Node> nodes_;
+};
+
+// ====================================================================
+// B) Compressed, read-only trie (data plane)
+// ====================================================================
+
+/**
+ * @brief Poptrie-style longest-prefix-match table.
+ *
+ * A 2^16 direct-pointing root, then 64-way nodes whose children and leaves
+ * are stored contiguously and addressed by popcount over two bitmaps: one
+ * marks internal children, one marks where runs of equal leaves start. A
+ * node is 24 bytes regardless of fan-out, so an IPv4 lookup touches at
+ * most four cache lines whatever the number of prefixes.
+ */
+class LpmTrie {
+public:
+    static constexpr uint32_t NO_MATCH = 0;
+
+    LpmTrie();
+    explicit LpmTrie(const LpmTrieBuilder& builder);
+
+    /**
+     * @brief Value of the longest prefix covering key, or NO_MATCH.
+     */
+    uint32_t lookup(LpmKey key) const {
+        const uint32_t root = root_[static_cast<uint32_t>(key >> 112)];
+        if (!(root & INTERNAL)) {
+            return root;
+        }
+        const Node* node = &nodes_[root & ~INTERNAL];
+        for (unsigned offset = 16;; offset += 6) {
+            const unsigned index = static_cast<unsigned>((key << offset) >> 122);
+            const uint64_t upto = ((1ull << index) << 1) - 1;  // Bits 0..index (all ones for 63)
+            if (node->vector & (1ull << index)) {
+                node = &nodes_[node->base1 + __builtin_popcountll(node->vector & upto) - 1];
+                continue;
+            }
+            return leaves_[node->base0 + __builtin_popcountll(node->leafvec & upto) - 1];
+        }
+    }
+
+    size_t memory_bytes() const {
+        return root_.size() * sizeof(uint32_t) + nodes_.size() * sizeof(Node) +
+               leaves_.size() * sizeof(uint32_t);
+    }
+
+private:
+    static constexpr uint32_t INTERNAL = 0x80000000u;
+
+    struct Node {
+        uint64_t vector;   // Bit i: entry i is an internal node
+        uint64_t leafvec;  // Bit i: entry i is a leaf starting a new run of values
+        uint32_t base0;    // First leaf in leaves_
+        uint32_t base1;    // First child in nodes_
+    };
+
+    std::vector<uint32_t> root_;  // Leaf value, or INTERNAL | node index
+    std::vector<Node> nodes_;
+    std::vector<uint32_t> leaves_;
+};
+
+#endif // LPM_TRIE_H
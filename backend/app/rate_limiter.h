@@ -0,0 +1,171 @@
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "../src/packet_parser.h"
+
+// ====================================================================
+// A) Token bucket packed in one atomic word
+// ====================================================================
+
+/**
+ * @brief Token-bucket parameters: rate_pps packets per second sustained,
+ * with bursts of up to `burst` packets. rate_pps == 0 means unlimited.
+ */
+struct RateLimit {
+    uint32_t rate_pps = 0;
+    uint32_t burst = 0;
+};
+
+/**
+ * @brief The limits an engine applies to RATE_LIMIT flows and sources.
+ */
+struct RateLimits {
+    RateLimit flow{1000, 200};      // Per flow banned with RATE_LIMIT
+    RateLimit source{10000, 2000};  // Per source address matching a RATE_LIMIT rule
+};
+
+/**
+ * @brief Bucket state as one 64-bit word, so the data path can update it
+ * with a single CAS and no lock:
+ *   [63:40] tokens, in 1/256 packet (bursts up to 65535 packets)
+ *   [39:0]  time of the last refill, in 1024 ns units (wraps after ~13 days)
+ * State 0 is a bucket that has never been used (it starts full).
+ * Time comes from the packets' capture timestamps, not a clock read.
+ */
+namespace token_bucket {
+
+constexpr unsigned TIME_BITS = 40;
+constexpr unsigned TIME_SHIFT = 10;
+constexpr uint64_t TIME_MASK = (1ull << TIME_BITS) - 1;
+constexpr uint64_t TOKEN_ONE = 256;
+constexpr uint64_t MAX_TOKENS = (1ull << (64 - TIME_BITS)) - 1;
+
+inline uint64_t capacity_of(const RateLimit& limit) {
+    const uint64_t tokens = static_cast<uint64_t>(limit.burst ? limit.burst : 1) * TOKEN_ONE;
+    return tokens < MAX_TOKENS ? tokens : MAX_TOKENS;
+}
+
+/**
+ * @brief One packet at ts_ns against bucket `state`.
+ * @return true if it conforms; *next is the state to store either way.
+ */
+inline bool take(uint64_t state, uint64_t ts_ns, const RateLimit& limit, uint64_t* next) {
+    const uint64_t capacity = capacity_of(limit);
+    const uint64_t now = (ts_ns >> TIME_SHIFT) & TIME_MASK;
+    uint64_t tokens = capacity;
+    uint64_t stamp = now;
+    if (state != 0) {
+        tokens = state >> TIME_BITS;
+        stamp = state & TIME_MASK;
+        const uint64_t elapsed = (now - stamp) & TIME_MASK;
+        // A timestamp older than the bucket (reordering across capture
+        // workers) refills nothing rather than wrapping around.
+        if (elapsed < TIME_MASK / 2) {
+            const unsigned __int128 per_second = static_cast<unsigned __int128>(limit.rate_pps) * TOKEN_ONE;
+            const uint64_t refill = static_cast<uint64_t>(
+                (static_cast<unsigned __int128>(elapsed) * (1u << TIME_SHIFT) * per_second) / 1000000000u);
+            if (tokens + refill >= capacity) {
+                tokens = capacity;
+                stamp = now;
+            } else if (refill > 0) {
+                // Advance the stamp only by the time the whole tokens took,
+                // so the fractional remainder is carried, not rounded away.
+                tokens += refill;
+                stamp = (stamp + static_cast<uint64_t>((refill * 1000000000ull) /
+                                                       ((1u << TIME_SHIFT) * per_second))) & TIME_MASK;
+            }
+        }
+    }
+    const bool conforms = tokens >= TOKEN_ONE;
+    if (conforms) {
+        tokens -= TOKEN_ONE;
+    }
+    *next = (tokens << TIME_BITS) | stamp;
+    if (*next == 0) {
+        *next = 1;  // Keep "never used" distinct from an empty bucket at time 0
+    }
+    return conforms;
+}
+
+/**
+ * @brief take() on a shared word (lock-free CAS loop).
+ */
+inline bool consume(std::atomic<uint64_t>& word, uint64_t ts_ns, const RateLimit& limit) {
+    if (limit.rate_pps == 0) {
+        return true;
+    }
+    uint64_t current = word.load(std::memory_order_relaxed);
+    uint64_t next;
+    bool conforms;
+    do {
+        conforms = take(current, ts_ns, limit, &next);
+    } while (!word.compare_exchange_weak(current, next, std::memory_order_relaxed));
+    return conforms;
+}
+
+} // namespace token_bucket
+
+// ====================================================================
+// B) Per-source buckets
+// ====================================================================
+
+/**
+ * @brief Fixed-size, lock-free table of token buckets keyed by source
+ * address, shared by every thread calling the engine.
+ *
+ * Direct-mapped with a full 64-bit tag: a source that lands on a slot held
+ * by another takes it over with a fresh bucket. Only sources that matched
+ * a RATE_LIMIT rule get a slot, so with the default 64K slots collisions
+ * are rare, and one can only loosen a limit briefly, never tighten it.
+ */
+class SourceRateLimiter {
+public:
+    explicit SourceRateLimiter(size_t slots = 1u << 16) : mask_(round_up(slots) - 1),
+        slots_(new Slot[mask_ + 1]) {}
+
+    /**
+     * @brief Charges one packet from src_addr (FlowTuple layout) at ts_ns.
+     * @return true if it is within the limit.
+     */
+    bool consume(const uint8_t src_addr[16], uint64_t ts_ns, const RateLimit& limit) {
+        if (limit.rate_pps == 0) {
+            return true;
+        }
+        uint64_t words[2];
+        std::memcpy(words, src_addr, sizeof(words));
+        const uint64_t tag = flow_hash_finalize(words[0] * 0x9E3779B97F4A7C15ull + words[1]) | 1;
+        Slot& slot = slots_[tag & mask_];
+        uint64_t owner = slot.tag.load(std::memory_order_acquire);
+        if (owner != tag && slot.tag.compare_exchange_strong(owner, tag, std::memory_order_acq_rel)) {
+            slot.state.store(0, std::memory_order_relaxed);
+        }
+        return token_bucket::consume(slot.state, ts_ns, limit);
+    }
+
+    size_t slots() const { return mask_ + 1; }
+
+private:
+    struct alignas(16) Slot {
+        std::atomic<uint64_t> tag{0};
+        std::atomic<uint64_t> state{0};
+    };
+
+    static size_t round_up(size_t n) {
+        size_t size = 1;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+};
+
+#endif // RATE_LIMITER_H
@@ -0,0 +1,747 @@
+// app/rule_engine.cpp
+
+#include "rule_engine.h"
+#include "lpm_trie.h"
+#include "xdp_offload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t NO_RULE = UINT32_MAX;
+
+bool is_full_range(uint16_t lo, uint16_t hi) {
+    return lo == 0 && hi == 65535;
+}
+
+// A rule the address tries can answer alone: one prefix, nothing else.
+bool is_prefix_rule(const FirewallRule& rule) {
+    return rule.protocol == 0 &&
+           is_full_range(rule.src_port_lo, rule.src_port_hi) &&
+           is_full_range(rule.dst_port_lo, rule.dst_port_hi) &&
+           ((rule.src_prefix > 0) != (rule.dst_prefix > 0));
+}
+
+LpmKey key_of(const uint8_t addr[16], bool v6) {
+    return v6 ? lpm_key_v6(addr) : lpm_key_v4(addr + 12);
+}
+
+// Whether `other` can match a packet that prefix rule `rule` matches.
+bool may_overlap(const FirewallRule& other, const FirewallRule& rule) {
+    if (other.ip_version != 0 && other.ip_version != rule.ip_version) {
+        return false;
+    }
+    const bool dst = rule.dst_prefix > 0;
+    const uint8_t length = dst ? rule.dst_prefix : rule.src_prefix;
+    const uint8_t other_length = dst ? other.dst_prefix : other.src_prefix;
+    if (other_length == 0) {
+        return true;
+    }
+    const bool v6 = rule.ip_version == 6;
+    const uint8_t common = std::min(length, other_length);
+    return lpm_prefix_of(key_of(dst ? rule.dst_addr : rule.src_addr, v6), common) ==
+           lpm_prefix_of(key_of(dst ? other.dst_addr : other.src_addr, v6), common);
+}
+
+// DROP prefix rules (in priority order) that no earlier non-DROP rule can
+// pre-empt: dropping on those alone gives the engine's answer, flow
+// policies aside (both sides check those first).
+std::vector<XdpPrefix> offloadable_prefixes(const std::vector<FirewallRule>& rules) {
+    std::vector<const FirewallRule*> others;
+    std::vector<XdpPrefix> prefixes;
+    for (const FirewallRule& rule : rules) {
+        if (rule.action != FirewallAction::DROP) {
+            others.push_back(&rule);
+            continue;
+        }
+        if (!is_prefix_rule(rule) ||
+            std::any_of(others.begin(), others.end(), [&](const FirewallRule* other) {
+                return may_overlap(*other, rule);
+            })) {
+            continue;
+        }
+        XdpPrefix prefix;
+        prefix.ip_version = rule.ip_version;
+        prefix.dst = rule.dst_prefix > 0;
+        prefix.length = prefix.dst ? rule.dst_prefix : rule.src_prefix;
+        std::memcpy(prefix.addr, prefix.dst ? rule.dst_addr : rule.src_addr, sizeof(prefix.addr));
+        prefixes.push_back(prefix);
+    }
+    return prefixes;
+}
+
+// ====================================================================
+// A) Per-class rule bitsets of one field
+// ====================================================================
+
+/**
+ * @brief One row per equivalence class: `aggs` aggregate words (bit w set
+ * when rule word w is non-zero), then `words` rule words (bit g = general
+ * rule g can match).
+ */
+class ClassBitsets {
+public:
+    void reset(size_t rules) {
+        words_ = (rules + 63) / 64;
+        aggs_ = (words_ + 63) / 64;
+        stride_ = aggs_ + words_;
+        data_.clear();
+    }
+
+    size_t classes() const { return stride_ ? data_.size() / stride_ : 0; }
+    size_t aggs() const { return aggs_; }
+    size_t memory_bytes() const { return data_.size() * sizeof(uint64_t); }
+
+    // Appends a class whose rule words are a copy of class `from` (or empty).
+    uint32_t append(uint32_t from = UINT32_MAX) {
+        const size_t id = classes();
+        data_.resize(data_.size() + stride_, 0);
+        if (from != UINT32_MAX) {
+            std::copy_n(&data_[from * stride_ + aggs_], words_, &data_[id * stride_ + aggs_]);
+        }
+        return static_cast<uint32_t>(id);
+    }
+
+    void set(uint32_t cls, size_t rule) {
+        data_[cls * stride_ + aggs_ + rule / 64] |= 1ull << (rule % 64);
+    }
+
+    // Appends `words` as a class unless an identical one exists.
+    uint32_t intern(const std::vector<uint64_t>& words, std::map<std::vector<uint64_t>, uint32_t>& seen) {
+        const auto it = seen.find(words);
+        if (it != seen.end()) {
+            return it->second;
+        }
+        const uint32_t id = append();
+        std::copy(words.begin(), words.end(), &data_[id * stride_ + aggs_]);
+        seen.emplace(words, id);
+        return id;
+    }
+
+    // Fills in the aggregate words once all classes are final.
+    void finish() {
+        for (size_t cls = 0; cls < classes(); ++cls) {
+            uint64_t* row = &data_[cls * stride_];
+            for (size_t w = 0; w < words_; ++w) {
+                if (row[aggs_ + w] != 0) {
+                    row[w / 64] |= 1ull << (w % 64);
+                }
+            }
+        }
+    }
+
+    const uint64_t* row(uint32_t cls) const { return &data_[cls * stride_]; }
+
+private:
+    size_t words_ = 0;
+    size_t aggs_ = 0;
+    size_t stride_ = 0;
+    std::vector<uint64_t> data_;
+};
+
+// Source or destination prefixes of one address family.
+struct PrefixField {
+    LpmTrie trie;           // Key -> class (0 = no rule prefix covers it)
+    ClassBitsets classes;
+};
+
+} // namespace
+
+// ====================================================================
+// B) The compiled, immutable rule set
+// ====================================================================
+
+class CompiledRuleSet {
+public:
+    struct Rule {
+        FirewallAction action;
+        RuleId rule_id;
+        RateLimit rate;
+    };
+
+    /**
+     * @brief Builds the lookup structures for rules (already in priority order).
+     * @return false if the bitset tables would exceed max_bitset_bytes.
+     */
+    bool build(const std::vector<FirewallRule>& rules, size_t max_bitset_bytes);
+
+    /**
+     * @brief Index of the best matching rule, or NO_RULE.
+     */
+    uint32_t classify(const FlowTuple& tuple) const;
+
+    const Rule& rule(uint32_t index) const { return rules_[index]; }
+    size_t rule_count() const { return rules_.size(); }
+    size_t prefix_rule_count() const { return prefix_rules_; }
+    size_t general_rule_count() const { return general_.size(); }
+    size_t memory_bytes() const;
+
+private:
+    size_t bitset_bytes() const;
+
+    void build_prefix_tries(const std::vector<FirewallRule>& rules, const std::vector<uint32_t>& indices);
+    void build_prefix_field(const std::vector<FirewallRule>& rules, bool v6, bool src, PrefixField& out);
+    void build_port_field(const std::vector<FirewallRule>& rules, bool src,
+                          std::vector<uint16_t>& map, ClassBitsets& out);
+    void build_protocol_field(const std::vector<FirewallRule>& rules);
+
+    std::vector<Rule> rules_;
+    size_t prefix_rules_ = 0;
+
+    // Address-only rules: key -> best rule index + 1 (indexed [v6][dst])
+    LpmTrie prefix_tries_[2][2];
+
+    // Bitset classification of the other rules; bit g is rules_[general_[g]]
+    std::vector<uint32_t> general_;
+    PrefixField src_[2];
+    PrefixField dst_[2];
+    std::vector<uint16_t> src_port_class_;
+    std::vector<uint16_t> dst_port_class_;
+    uint16_t protocol_class_[256] = {};
+    ClassBitsets src_ports_;
+    ClassBitsets dst_ports_;
+    ClassBitsets protocols_;
+};
+
+bool CompiledRuleSet::build(const std::vector<FirewallRule>& rules, size_t max_bitset_bytes) {
+    rules_.reserve(rules.size());
+    std::vector<uint32_t> prefix_indices;
+    for (uint32_t i = 0; i < rules.size(); ++i) {
+        rules_.push_back({rules[i].action, rules[i].rule_id, rules[i].rate});
+        if (is_prefix_rule(rules[i])) {
+            prefix_indices.push_back(i);
+        } else {
+            general_.push_back(i);
+        }
+    }
+    prefix_rules_ = prefix_indices.size();
+    build_prefix_tries(rules, prefix_indices);
+    if (general_.empty()) {
+        return true;
+    }
+
+    // Bitset rows are one bit per general rule; the prefix fields dominate
+    // (one class per distinct prefix), so check them before building.
+    std::vector<FirewallRule> general;
+    general.reserve(general_.size());
+    for (uint32_t index : general_) {
+        general.push_back(rules[index]);
+    }
+    size_t prefix_classes = 4;
+    for (int v6 = 0; v6 < 2; ++v6) {
+        std::vector<std::tuple<uint8_t, LpmKey>> src, dst;
+        for (const FirewallRule& rule : general) {
+            if (rule.ip_version == (v6 ? 6 : 4)) {
+                src.emplace_back(rule.src_prefix, lpm_prefix_of(key_of(rule.src_addr, v6), rule.src_prefix));
+                dst.emplace_back(rule.dst_prefix, lpm_prefix_of(key_of(rule.dst_addr, v6), rule.dst_prefix));
+            }
+        }
+        for (auto* keys : {&src, &dst}) {
+            std::sort(keys->begin(), keys->end());
+            prefix_classes += std::unique(keys->begin(), keys->end()) - keys->begin();
+        }
+    }
+    const size_t words = (general.size() + 63) / 64;
+    const size_t row_bytes = (words + (words + 63) / 64) * sizeof(uint64_t);
+    if (prefix_classes * row_bytes > max_bitset_bytes) {
+        return false;
+    }
+
+    for (int v6 = 0; v6 < 2; ++v6) {
+        build_prefix_field(general, v6, true, src_[v6]);
+        build_prefix_field(general, v6, false, dst_[v6]);
+    }
+    build_port_field(general, true, src_port_class_, src_ports_);
+    build_port_field(general, false, dst_port_class_, dst_ports_);
+    build_protocol_field(general);
+    return bitset_bytes() <= max_bitset_bytes;
+}
+
+void CompiledRuleSet::build_prefix_tries(const std::vector<FirewallRule>& rules,
+                                         const std::vector<uint32_t>& indices) {
+    for (int v6 = 0; v6 < 2; ++v6) {
+        for (int dst = 0; dst < 2; ++dst) {
+            // (length, prefix, rule index) in increasing length, as the builder requires.
+            std::vector<std::tuple<uint8_t, LpmKey, uint32_t>> prefixes;
+            for (uint32_t index : indices) {
+                const FirewallRule& rule = rules[index];
+                const uint8_t length = dst ? rule.dst_prefix : rule.src_prefix;
+                if (rule.ip_version == (v6 ? 6 : 4) && length > 0) {
+                    const LpmKey key = key_of(dst ? rule.dst_addr : rule.src_addr, v6);
+                    prefixes.emplace_back(length, lpm_prefix_of(key, length), index);
+                }
+            }
+            if (prefixes.empty()) {
+                continue;
+            }
+            std::sort(prefixes.begin(), prefixes.end());
+
+            LpmTrieBuilder builder;
+            for (const auto& [length, prefix, index] : prefixes) {
+                // A covering prefix with a better rule still wins inside this one.
+                const uint32_t inherited = builder.lookup(prefix);
+                uint32_t value = index + 1;
+                if (inherited != LpmTrie::NO_MATCH && inherited < value) {
+                    value = inherited;
+                }
+                builder.insert(prefix, length, value);
+            }
+            prefix_tries_[v6][dst] = LpmTrie(builder);
+        }
+    }
+}
+
+void CompiledRuleSet::build_prefix_field(const std::vector<FirewallRule>& rules, bool v6, bool src,
+                                         PrefixField& out) {
+    const uint8_t family = v6 ? 6 : 4;
+    out.classes.reset(rules.size());
+
+    // Class 0: packets no rule prefix covers; only wildcard rules can match.
+    const uint32_t none = out.classes.append();
+    std::vector<std::tuple<uint8_t, LpmKey, uint32_t>> prefixes;
+    for (uint32_t g = 0; g < rules.size(); ++g) {
+        const FirewallRule& rule = rules[g];
+        if (rule.ip_version != 0 && rule.ip_version != family) {
+            continue;
+        }
+        const uint8_t length = src ? rule.src_prefix : rule.dst_prefix;
+        if (length == 0) {
+            out.classes.set(none, g);
+        } else {
+            const LpmKey key = key_of(src ? rule.src_addr : rule.dst_addr, v6);
+            prefixes.emplace_back(length, lpm_prefix_of(key, length), g);
+        }
+    }
+    std::sort(prefixes.begin(), prefixes.end());
+
+    // One class per distinct prefix: its parent's rules plus its own. Parents
+    // are shorter, so they are already in the builder when looked up.
+    LpmTrieBuilder builder;
+    for (size_t i = 0; i < prefixes.size();) {
+        const uint8_t length = std::get<0>(prefixes[i]);
+        const LpmKey prefix = std::get<1>(prefixes[i]);
+        const uint32_t cls = out.classes.append(builder.lookup(prefix));
+        for (; i < prefixes.size() && std::get<0>(prefixes[i]) == length && std::get<1>(prefixes[i]) == prefix; ++i) {
+            out.classes.set(cls, std::get<2>(prefixes[i]));
+        }
+        builder.insert(prefix, length, cls);
+    }
+    out.classes.finish();
+    out.trie = LpmTrie(builder);
+}
+
+void CompiledRuleSet::build_port_field(const std::vector<FirewallRule>& rules, bool src,
+                                       std::vector<uint16_t>& map, ClassBitsets& out) {
+    out.reset(rules.size());
+    map.assign(65536, 0);
+
+    // Sweep the elementary intervals between range endpoints.
+    std::map<uint32_t, std::vector<uint32_t>> starts, ends;
+    for (uint32_t g = 0; g < rules.size(); ++g) {
+        const uint32_t lo = src ? rules[g].src_port_lo : rules[g].dst_port_lo;
+        const uint32_t hi = src ? rules[g].src_port_hi : rules[g].dst_port_hi;
+        starts[lo].push_back(g);
+        ends[hi + 1].push_back(g);
+    }
+    std::vector<uint32_t> bounds{0};
+    for (const auto& entry : starts) bounds.push_back(entry.first);
+    for (const auto& entry : ends) bounds.push_back(entry.first);
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    std::vector<uint64_t> active((rules.size() + 63) / 64, 0);
+    std::map<std::vector<uint64_t>, uint32_t> seen;
+    for (size_t i = 0; i < bounds.size() && bounds[i] < 65536; ++i) {
+        const uint32_t port = bounds[i];
+        if (const auto it = ends.find(port); it != ends.end()) {
+            for (uint32_t g : it->second) active[g / 64] &= ~(1ull << (g % 64));
+        }
+        if (const auto it = starts.find(port); it != starts.end()) {
+            for (uint32_t g : it->second) active[g / 64] |= 1ull << (g % 64);
+        }
+        const uint32_t next = i + 1 < bounds.size() ? std::min<uint32_t>(bounds[i + 1], 65536) : 65536;
+        std::fill(map.begin() + port, map.begin() + next, static_cast<uint16_t>(out.intern(active, seen)));
+    }
+    out.finish();
+}
+
+void CompiledRuleSet::build_protocol_field(const std::vector<FirewallRule>& rules) {
+    protocols_.reset(rules.size());
+    std::vector<uint64_t> words((rules.size() + 63) / 64, 0);
+    std::map<std::vector<uint64_t>, uint32_t> seen;
+    for (unsigned protocol = 0; protocol < 256; ++protocol) {
+        std::fill(words.begin(), words.end(), 0);
+        for (uint32_t g = 0; g < rules.size(); ++g) {
+            if (rules[g].protocol == 0 || rules[g].protocol == protocol) {
+                words[g / 64] |= 1ull << (g % 64);
+            }
+        }
+        protocol_class_[protocol] = static_cast<uint16_t>(protocols_.intern(words, seen));
+    }
+    protocols_.finish();
+}
+
+uint32_t CompiledRuleSet::classify(const FlowTuple& tuple) const {
+    const int v6 = tuple.ip_version == 6;
+    const LpmKey src = key_of(tuple.src_addr, v6);
+    const LpmKey dst = key_of(tuple.dst_addr, v6);
+
+    uint32_t best = NO_RULE;
+    const uint32_t src_hit = prefix_tries_[v6][0].lookup(src);
+    const uint32_t dst_hit = prefix_tries_[v6][1].lookup(dst);
+    if (src_hit != LpmTrie::NO_MATCH) best = src_hit - 1;
+    if (dst_hit != LpmTrie::NO_MATCH) best = std::min(best, dst_hit - 1);
+    if (general_.empty()) {
+        return best;
+    }
+
+    const uint64_t* rows[5] = {
+        src_[v6].classes.row(src_[v6].trie.lookup(src)),
+        dst_[v6].classes.row(dst_[v6].trie.lookup(dst)),
+        src_ports_.row(src_port_class_[tuple.src_port]),
+        dst_ports_.row(dst_port_class_[tuple.dst_port]),
+        protocols_.row(protocol_class_[tuple.protocol]),
+    };
+    // Intersect the aggregates first; only words all five fields populate are read.
+    const size_t aggs = protocols_.aggs();
+    for (size_t a = 0; a < aggs; ++a) {
+        uint64_t agg = rows[0][a] & rows[1][a] & rows[2][a] & rows[3][a] & rows[4][a];
+        while (agg != 0) {
+            const size_t w = aggs + a * 64 + __builtin_ctzll(agg);
+            const uint64_t word = rows[0][w] & rows[1][w] & rows[2][w] & rows[3][w] & rows[4][w];
+            if (word != 0) {
+                // General rules are in priority order: the first hit is their best.
+                const uint32_t g = static_cast<uint32_t>((w - aggs) * 64 + __builtin_ctzll(word));
+                return std::min(best, general_[g]);
+            }
+            agg &= agg - 1;
+        }
+    }
+    return best;
+}
+
+size_t CompiledRuleSet::bitset_bytes() const {
+    size_t bytes = src_ports_.memory_bytes() + dst_ports_.memory_bytes() + protocols_.memory_bytes();
+    for (int v6 = 0; v6 < 2; ++v6) {
+        bytes += src_[v6].classes.memory_bytes() + dst_[v6].classes.memory_bytes();
+    }
+    return bytes;
+}
+
+size_t CompiledRuleSet::memory_bytes() const {
+    size_t bytes = bitset_bytes() + rules_.size() * sizeof(Rule) + general_.size() * sizeof(uint32_t) +
+                   (src_port_class_.size() + dst_port_class_.size()) * sizeof(uint16_t);
+    for (int v6 = 0; v6 < 2; ++v6) {
+        bytes += prefix_tries_[v6][0].memory_bytes() + prefix_tries_[v6][1].memory_bytes();
+        bytes += src_[v6].trie.memory_bytes() + dst_[v6].trie.memory_bytes();
+    }
+    return bytes;
+}
+
+// ====================================================================
+// C) CompiledRuleEngine
+// ====================================================================
+
+CompiledRuleEngine::CompiledRuleEngine() :
+    domain_(EpochDomain::instance()),
+    enforced_flows_(1024, domain_),
+    published_(new CompiledRuleSet) {}
+
+CompiledRuleEngine::~CompiledRuleEngine() {
+    delete published_.load(std::memory_order_relaxed);
+}
+
+CompiledRuleEngine::Settings CompiledRuleEngine::settings() const {
+    return {default_action_.load(), flow_limit_.load(), source_limit_.load()};
+}
+
+bool CompiledRuleEngine::match_unguarded(const FlowTuple& tuple, uint64_t ts_ns, const Settings& settings,
+                                         FirewallAction* action, RuleId* rule) {
+    std::atomic<uint64_t>* bucket;
+    if (enforced_flows_.lookup_unguarded(flow_key_of(tuple), action, &bucket)) {
+        *rule = RULE_FLOW_POLICY;
+        if (*action == FirewallAction::RATE_LIMIT &&
+            !token_bucket::consume(*bucket, ts_ns ? ts_ns : enforcement_clock_ns(), settings.flow_limit)) {
+            *action = FirewallAction::DROP;
+            *rule = RULE_RATE_LIMITED;
+        }
+        return true;
+    }
+
+    // seq_cst: see EpochDomain::ReadGuard.
+    const CompiledRuleSet* set = published_.load(std::memory_order_seq_cst);
+    const uint32_t index = set->classify(tuple);
+    if (index == NO_RULE) {
+        return false;
+    }
+    const CompiledRuleSet::Rule& matched = set->rule(index);
+    *action = matched.action;
+    *rule = matched.rule_id;
+    if (matched.action == FirewallAction::RATE_LIMIT) {
+        const RateLimit& limit = matched.rate.rate_pps != 0 ? matched.rate : settings.source_limit;
+        if (!sources_.consume(tuple.src_addr, ts_ns ? ts_ns : enforcement_clock_ns(), limit)) {
+            *action = FirewallAction::DROP;
+            *rule = RULE_RATE_LIMITED;
+        }
+    }
+    return true;
+}
+
+PacketDecision CompiledRuleEngine::decide(const uint8_t* packet_data, uint16_t len, uint64_t ts_ns,
+                                          const Settings& settings) {
+    const ParsedPacket parsed = parse_packet(packet_data, len);
+    FirewallAction action;
+    RuleId rule;
+    if (parsed.valid && match_unguarded(parsed.tuple, ts_ns, settings, &action, &rule)) {
+        return {action, 0, rule};
+    }
+    return {settings.default_action, 0, RULE_DEFAULT_POLICY};
+}
+
+PacketDecision CompiledRuleEngine::get_decision(const uint8_t* packet_data, uint16_t len) {
+    EpochDomain::ReadGuard guard(domain_);
+    const PacketDecision decision = decide(packet_data, len, 0, settings());
+    count_decisions(&decision, 1);
+    return decision;
+}
+
+void CompiledRuleEngine::get_decisions(const uint8_t* const* pkts, const uint16_t* lens,
+                                       PacketDecision* out, size_t n) {
+    EpochDomain::ReadGuard guard(domain_);
+    const Settings current = settings();
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = decide(pkts[i], lens[i], 0, current);
+    }
+    count_decisions(out, n);
+}
+
+void CompiledRuleEngine::get_decisions_at(const uint8_t* const* pkts, const uint16_t* lens, const uint64_t* ts_ns,
+                                          PacketDecision* out, size_t n) {
+    EpochDomain::ReadGuard guard(domain_);
+    const Settings current = settings();
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = decide(pkts[i], lens[i], ts_ns[i], current);
+    }
+    count_decisions(out, n);
+    time_decisions(ts_ns, n);
+}
+
+namespace {
+
+// Process-wide index of the calling thread, assigned on its first decision.
+std::atomic<uint32_t> g_next_thread_slot{0};
+thread_local uint32_t t_thread_slot = UINT32_MAX;
+
+uint32_t thread_slot() {
+    if (t_thread_slot == UINT32_MAX) {
+        t_thread_slot = g_next_thread_slot.fetch_add(1, std::memory_order_relaxed);
+    }
+    return t_thread_slot;
+}
+
+// Owned counter: only this thread writes it, so no locked add is needed.
+inline void add_owned(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+} // namespace
+
+void CompiledRuleEngine::count_decisions(const PacketDecision* decisions, size_t n) {
+    uint64_t by_action[4] = {};
+    uint64_t rate_limited = 0;
+    uint64_t default_policy = 0;
+    for (size_t i = 0; i < n; ++i) {
+        ++by_action[static_cast<uint8_t>(decisions[i].action) & 3];
+        rate_limited += decisions[i].rule_id == RULE_RATE_LIMITED;
+        default_policy += decisions[i].rule_id == RULE_DEFAULT_POLICY;
+    }
+
+    const uint32_t slot = thread_slot();
+    if (slot < DECISION_STRIPES - 1) {
+        DecisionStripe& stripe = decisions_[slot];
+        for (size_t a = 0; a < 4; ++a) {
+            if (by_action[a] != 0) {
+                add_owned(stripe.by_action[a], by_action[a]);
+            }
+        }
+        if (rate_limited != 0) {
+            add_owned(stripe.rate_limited, rate_limited);
+        }
+        if (default_policy != 0) {
+            add_owned(stripe.default_policy, default_policy);
+        }
+        return;
+    }
+    DecisionStripe& shared = decisions_[DECISION_STRIPES - 1];
+    for (size_t a = 0; a < 4; ++a) {
+        shared.by_action[a].fetch_add(by_action[a], std::memory_order_relaxed);
+    }
+    shared.rate_limited.fetch_add(rate_limited, std::memory_order_relaxed);
+    shared.default_policy.fetch_add(default_policy, std::memory_order_relaxed);
+}
+
+void CompiledRuleEngine::time_decisions(const uint64_t* ts_ns, size_t n) {
+    const uint32_t slot = thread_slot();
+    if (slot >= DECISION_STRIPES - 1 || n == 0) {
+        return;
+    }
+    LatencyHistogram& histogram = decision_latency_[slot];
+    const uint64_t now = enforcement_clock_ns();
+    for (size_t i = 0; i < n; ++i) {
+        if (ts_ns[i] != 0) {
+            histogram.record_span(ts_ns[i], now);
+        }
+    }
+}
+
+void CompiledRuleEngine::decision_latency(C_LatencyHistogram& into) const {
+    for (const LatencyHistogram& histogram : decision_latency_) {
+        histogram.merge_into(into);
+    }
+}
+
+DecisionStats CompiledRuleEngine::decision_stats() const {
+    DecisionStats stats;
+    for (const DecisionStripe& stripe : decisions_) {
+        for (size_t a = 0; a < 4; ++a) {
+            stats.by_action[a] += stripe.by_action[a].load(std::memory_order_relaxed);
+        }
+        stats.rate_limited += stripe.rate_limited.load(std::memory_order_relaxed);
+        stats.default_policy += stripe.default_policy.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+bool CompiledRuleEngine::match(const FlowTuple& tuple, uint64_t ts_ns, FirewallAction* action, RuleId* rule) {
+    EpochDomain::ReadGuard guard(domain_);
+    return match_unguarded(tuple, ts_ns, settings(), action, rule);
+}
+
+void CompiledRuleEngine::enforce_flow_policy(FlowKey flow_id, FirewallAction action) {
+    std::lock_guard<std::mutex> lock(offload_mutex_);
+    if (enforced_flows_.insert(flow_id, action) && offload_ != nullptr) {
+        offload_->set_flow(flow_id, action);
+    }
+}
+
+void CompiledRuleEngine::set_flow_limit(size_t max_flows) {
+    enforced_flows_.set_limit(max_flows);
+}
+
+bool CompiledRuleEngine::remove_flow_policy(FlowKey flow_id) {
+    std::lock_guard<std::mutex> lock(offload_mutex_);
+    if (offload_ != nullptr) {
+        offload_->remove_flow(flow_id);
+    }
+    return enforced_flows_.erase(flow_id);
+}
+
+FirewallAction CompiledRuleEngine::get_default_action() const {
+    return default_action_.load();
+}
+
+void CompiledRuleEngine::set_default_action(FirewallAction action) {
+    default_action_.store(action);
+}
+
+void CompiledRuleEngine::set_rate_limits(const RateLimits& limits) {
+    flow_limit_.store(limits.flow);
+    source_limit_.store(limits.source);
+}
+
+uint32_t CompiledRuleEngine::add_rule(const FirewallRule& rule) {
+    const unsigned max_prefix = rule.ip_version == 6 ? 128 : 32;
+    const bool malformed =
+        (rule.ip_version != 0 && rule.ip_version != 4 && rule.ip_version != 6) ||
+        (rule.ip_version == 0 && (rule.src_prefix != 0 || rule.dst_prefix != 0)) ||
+        rule.src_prefix > max_prefix || rule.dst_prefix > max_prefix ||
+        rule.src_port_lo > rule.src_port_hi || rule.dst_port_lo > rule.dst_port_hi;
+    if (malformed) {
+        return UINT32_MAX;
+    }
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    staged_.emplace(next_handle_, rule);
+    return next_handle_++;
+}
+
+bool CompiledRuleEngine::remove_rule(uint32_t handle) {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    return staged_.erase(handle) != 0;
+}
+
+int CompiledRuleEngine::compile() {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    return compile_locked();
+}
+
+int CompiledRuleEngine::compile_locked() {
+    const auto started = std::chrono::steady_clock::now();
+
+    std::vector<FirewallRule> rules;
+    rules.reserve(staged_.size());
+    for (const auto& entry : staged_) {
+        rules.push_back(entry.second);
+    }
+    std::stable_sort(rules.begin(), rules.end(), [](const FirewallRule& a, const FirewallRule& b) {
+        return a.priority < b.priority;
+    });
+
+    std::unique_ptr<CompiledRuleSet> set(new CompiledRuleSet);
+    if (!set->build(rules, MAX_BITSET_BYTES)) {
+        std::cerr << "[C++ Engine ERROR] Rule set of " << rules.size()
+                  << " rules exceeds the bitset memory limit; keeping the previous set." << std::endl;
+        return -1;
+    }
+
+    stats_.rules = set->rule_count();
+    stats_.prefix_rules = set->prefix_rule_count();
+    stats_.general_rules = set->general_rule_count();
+    stats_.memory_bytes = set->memory_bytes();
+
+    // Publish, then free the old set once no reader can still hold it.
+    const CompiledRuleSet* old = published_.exchange(set.release(), std::memory_order_seq_cst);
+    domain_.synchronize();
+    delete old;
+
+    {
+        std::lock_guard<std::mutex> offload_lock(offload_mutex_);
+        if (offload_ != nullptr) {
+            offload_->set_prefixes(offloadable_prefixes(rules));
+        }
+    }
+
+    ++stats_.generation;
+    stats_.compile_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - started).count());
+    return 0;
+}
+
+int CompiledRuleEngine::set_offload(XdpOffload* offload) {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    {
+        std::lock_guard<std::mutex> offload_lock(offload_mutex_);
+        offload_ = offload;
+        if (offload_ != nullptr) {
+            offload_->clear_flows();
+            enforced_flows_.for_each([offload](FlowKey flow_id, FirewallAction action) {
+                offload->set_flow(flow_id, action);
+            });
+        }
+    }
+    return compile_locked();
+}
+
+RuleEngineStats CompiledRuleEngine::stats() const {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    RuleEngineStats stats = stats_;
+    stats.staged_rules = staged_.size();
+    stats.flow_policies = enforced_flows_.size();
+    stats.flow_policies_rejected = enforced_flows_.rejected();
+    return stats;
+}
@@ -0,0 +1,237 @@
+#ifndef RULE_ENGINE_H
+#define RULE_ENGINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+#include "../src/latency_histogram.h"
+#include "ban_table.h"
+#include "firewall_enforce.h"
+#include "rate_limiter.h"
+
+// ====================================================================
+// A) Rules
+// ====================================================================
+
+/**
+ * @brief One 5-tuple firewall rule. Every field is a wildcard by default.
+ * Addresses use the FlowTuple layout (IPv4-mapped for IPv4); prefix
+ * lengths count bits of the family's own address (0..32 or 0..128).
+ */
+struct FirewallRule {
+    uint32_t priority = 0;        // Lower wins; ties go to the rule added first
+    uint8_t ip_version = 0;       // 4 or 6; 0 matches both (addresses must then be wildcards)
+    uint8_t protocol = 0;         // IP protocol, or 0 for any
+    uint8_t src_prefix = 0;       // 0 = any source
+    uint8_t dst_prefix = 0;       // 0 = any destination
+    uint8_t src_addr[16] = {};
+    uint8_t dst_addr[16] = {};
+    uint16_t src_port_lo = 0;     // Inclusive port ranges
+    uint16_t src_port_hi = 65535;
+    uint16_t dst_port_lo = 0;
+    uint16_t dst_port_hi = 65535;
+    FirewallAction action = FirewallAction::DROP;
+    RuleId rule_id = RULE_DEFAULT_POLICY;  // Reported in the decision
+    RateLimit rate;               // RATE_LIMIT only: per-source bucket (rate 0 = the engine's source limit)
+};
+
+/**
+ * @brief What the published rule set looks like (control plane).
+ */
+struct RuleEngineStats {
+    uint64_t generation = 0;      // Rule sets published so far
+    uint64_t staged_rules = 0;    // Rules added and not removed (compiled or not)
+    uint64_t rules = 0;           // Rules in the published set
+    uint64_t prefix_rules = 0;    // ... of which matched by the address fast path
+    uint64_t general_rules = 0;   // ... of which matched by bitset classification
+    uint64_t memory_bytes = 0;    // Size of the published lookup structures
+    uint64_t compile_ns = 0;      // Time the last compile took
+    uint64_t flow_policies = 0;   // Flows banned or allowed by enforce_flow_policy()
+    uint64_t flow_policies_rejected = 0;  // ... refused because the flow limit was reached
+};
+
+/**
+ * @brief Decisions the data path returned since the engine was created.
+ */
+struct DecisionStats {
+    uint64_t by_action[4] = {};   // Indexed by FirewallAction
+    uint64_t rate_limited = 0;    // ... of the DROPs, packets over a RATE_LIMIT bucket
+    uint64_t default_policy = 0;  // Decisions no flow ban or rule matched
+};
+
+class CompiledRuleSet;
+class XdpOffload;
+
+// ====================================================================
+// B) Compiled rule engine
+// ====================================================================
+
+/**
+ * @brief EnforcementEngine that matches packets against a compiled rule set.
+ *
+ * Rules are staged on the control plane and compiled by compile() into
+ * read-only lookup structures, which are swapped in atomically and freed
+ * after an epoch grace period; the data path never locks.
+ *
+ * - Address-only rules (one source or destination prefix, nothing else
+ *   set: the block-IP case) go into Poptrie LPM tries whose leaves hold
+ *   the best rule directly. Cost per packet: two trie lookups, independent
+ *   of the rule count (100K+ prefixes).
+ * - Every other rule is classified by bit vectors: each field (src prefix,
+ *   dst prefix, src port, dst port, protocol) maps the packet to an
+ *   equivalence class with the bitset of rules that can match it. The
+ *   five bitsets are intersected through an aggregate bitset (one bit per
+ *   64-rule word) and the lowest set bit is the winner. Bitset memory grows
+ *   with distinct field values times rules, so keep these in the tens of
+ *   thousands; compile() refuses sets beyond MAX_BITSET_BYTES.
+ *
+ * Exact FlowKey bans (enforce_flow_policy) are checked before the rules.
+ *
+ * RATE_LIMIT is enforced with token buckets charged at the packet's capture
+ * timestamp: a RATE_LIMIT flow ban keeps its bucket in the flow's entry in
+ * the ban table, and a RATE_LIMIT rule charges a bucket per source address
+ * (SourceRateLimiter). Packets over the limit get DROP / RULE_RATE_LIMITED.
+ *
+ * With an XdpOffload set, flow policies and the DROP prefix rules the kernel
+ * can decide alone are mirrored into its maps, so that traffic is dropped
+ * in the driver and never reaches this engine.
+ */
+class CompiledRuleEngine final : public EnforcementEngine {
+public:
+    static constexpr size_t MAX_BITSET_BYTES = size_t(512) << 20;
+
+    CompiledRuleEngine();
+    ~CompiledRuleEngine() override;
+
+    CompiledRuleEngine(const CompiledRuleEngine&) = delete;
+    CompiledRuleEngine& operator=(const CompiledRuleEngine&) = delete;
+
+    PacketDecision get_decision(const uint8_t* packet_data, uint16_t len) override;
+    void get_decisions(const uint8_t* const* pkts, const uint16_t* lens,
+                       PacketDecision* out, size_t n) override;
+    void get_decisions_at(const uint8_t* const* pkts, const uint16_t* lens, const uint64_t* ts_ns,
+                          PacketDecision* out, size_t n) override;
+
+    void enforce_flow_policy(FlowKey flow_id, FirewallAction action) override;
+    bool remove_flow_policy(FlowKey flow_id);
+
+    /**
+     * @brief Caps the flow policies at max_flows (0 = no cap) and allocates
+     * their table for that many now, so enforcing (e.g. from the capture
+     * engine's sketch alerts) never allocates and cannot grow without bound.
+     * Policies for new flows past the cap are refused.
+     */
+    void set_flow_limit(size_t max_flows);
+
+    FirewallAction get_default_action() const override;
+    void set_default_action(FirewallAction action);
+
+    /**
+     * @brief Token buckets for RATE_LIMIT flows and (by default) sources.
+     */
+    void set_rate_limits(const RateLimits& limits);
+
+    /**
+     * @brief Classifies an already parsed packet captured at ts_ns (0 = now).
+     * @return true and fills action/rule if a flow ban or rule matched.
+     */
+    bool match(const FlowTuple& tuple, uint64_t ts_ns, FirewallAction* action, RuleId* rule);
+
+    // ---- Control plane (serialized; changes take effect on compile()) ----
+
+    /**
+     * @brief Stages a rule.
+     * @return Its handle, or UINT32_MAX if the rule is malformed.
+     */
+    uint32_t add_rule(const FirewallRule& rule);
+
+    /**
+     * @brief Unstages a rule. @return true if the handle was live.
+     */
+    bool remove_rule(uint32_t handle);
+
+    /**
+     * @brief Compiles the staged rules and publishes them.
+     * @return 0 on success, -1 if the bitset tables would exceed MAX_BITSET_BYTES
+     * (the previous rule set stays in force).
+     */
+    int compile();
+
+    RuleEngineStats stats() const;
+
+    /**
+     * @brief Sums the decision counters (lock-free; the data path counts
+     * into per-thread stripes and never waits for this).
+     */
+    DecisionStats decision_stats() const;
+
+    /**
+     * @brief Merges into `into` the time from each packet's capture timestamp
+     * to its decision, as timed by get_decisions_at() (one clock read per
+     * batch). Only the first DECISION_STRIPES - 1 data-path threads are
+     * timed; call finish_latency_snapshot() afterwards.
+     */
+    void decision_latency(C_LatencyHistogram& into) const;
+
+    /**
+     * @brief Starts (or, with null, stops) mirroring into `offload`: every
+     * flow policy, and each DROP prefix rule no earlier non-DROP rule can
+     * pre-empt. Commits the staged rules so both sides agree. The caller
+     * keeps ownership and must stop mirroring before destroying it.
+     * @return compile()'s result.
+     */
+    int set_offload(XdpOffload* offload);
+
+private:
+    struct Settings {
+        FirewallAction default_action;
+        RateLimit flow_limit;
+        RateLimit source_limit;
+    };
+
+    Settings settings() const;
+    // The caller holds a read section on domain_. ts_ns 0 = now (the clock
+    // is only read if a rate limit needs it).
+    bool match_unguarded(const FlowTuple& tuple, uint64_t ts_ns, const Settings& settings,
+                         FirewallAction* action, RuleId* rule);
+    PacketDecision decide(const uint8_t* packet_data, uint16_t len, uint64_t ts_ns, const Settings& settings);
+    int compile_locked();
+    void count_decisions(const PacketDecision* decisions, size_t n);
+    void time_decisions(const uint64_t* ts_ns, size_t n);
+
+    EpochDomain& domain_;
+    ConcurrentBanTable<FirewallAction> enforced_flows_;
+    std::atomic<FirewallAction> default_action_{FirewallAction::PASS};
+    std::atomic<RateLimit> flow_limit_{RateLimits().flow};
+    std::atomic<RateLimit> source_limit_{RateLimits().source};
+    SourceRateLimiter sources_;
+    std::atomic<const CompiledRuleSet*> published_;
+
+    // Decision counters, one cache line per data-path thread so each is
+    // single-writer (plain stores, no locked add); threads beyond the first
+    // DECISION_STRIPES - 1 share the last line with atomic adds.
+    static constexpr size_t DECISION_STRIPES = 64;
+    struct alignas(64) DecisionStripe {
+        std::atomic<uint64_t> by_action[4] = {};
+        std::atomic<uint64_t> rate_limited{0};
+        std::atomic<uint64_t> default_policy{0};
+    };
+    DecisionStripe decisions_[DECISION_STRIPES];
+    // Capture -> decision latency, same per-thread slots (single writer each).
+    LatencyHistogram decision_latency_[DECISION_STRIPES - 1];
+
+    mutable std::mutex control_mutex_;
+    std::map<uint32_t, FirewallRule> staged_;  // By handle, i.e. in the order added
+    uint32_t next_handle_ = 0;
+    RuleEngineStats stats_;                     // Guarded by control_mutex_
+
+    // Taken after control_mutex_ when both are needed, so flow policies are
+    // not held up by a compile.
+    std::mutex offload_mutex_;
+    XdpOffload* offload_ = nullptr;             // Guarded by offload_mutex_
+};
+
+#endif // RULE_ENGINE_H
@@ -0,0 +1,797 @@
+// app/xdp_offload.cpp
+//
+// XDP DROP offload. The maps are created and the program is loaded with
+// raw bpf(2) calls; the program itself is emitted instruction by
+// instruction below, mirroring parse_packet() and flow_key_of().
+
+#include "xdp_offload.h"
+
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+
+namespace {
+
+// Map layouts shared by the program and the control plane.
+struct FlowValue {
+    uint64_t packets;
+    uint64_t bytes;
+    uint32_t action;    // FirewallAction
+    uint32_t reserved;
+};
+
+// LPM key: the IP version as a 32-bit tag, then the FlowTuple address, so
+// IPv4 rules only match IPv4 packets (as in the engine).
+struct PrefixKey {
+    uint32_t prefixlen;
+    uint32_t ip_version;
+    uint8_t addr[16];
+};
+
+constexpr uint32_t TOTAL_FLOW_DROPS = 0;
+constexpr uint32_t TOTAL_PREFIX_DROPS = 1;
+
+// Program stack frame (offsets from r10).
+constexpr int16_t STACK_TUPLE = -40;       // FlowTuple, 40 bytes
+constexpr int16_t STACK_FLOW_KEY = -48;    // FlowKey
+constexpr int16_t STACK_PREFIX_KEY = -72;  // PrefixKey, 24 bytes
+constexpr int16_t STACK_TOTALS_KEY = -76;  // uint32_t slot
+
+constexpr int16_t tuple_at(size_t offset) {
+    return static_cast<int16_t>(STACK_TUPLE + static_cast<int16_t>(offset));
+}
+
+constexpr int16_t prefix_key_at(size_t offset) {
+    return static_cast<int16_t>(STACK_PREFIX_KEY + static_cast<int16_t>(offset));
+}
+
+long sys_bpf(int cmd, union bpf_attr* attr) {
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+int fail(const char* step, int err) {
+    std::cerr << "[C++ XDP ERROR] " << step << " failed: " << std::strerror(err) << std::endl;
+    return -1;
+}
+
+int create_map(bpf_map_type type, uint32_t key_size, uint32_t value_size, uint32_t max_entries,
+               uint32_t flags, const char* name) {
+    union bpf_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.map_type = type;
+    attr.key_size = key_size;
+    attr.value_size = value_size;
+    attr.max_entries = max_entries;
+    attr.map_flags = flags;
+    std::strncpy(attr.map_name, name, sizeof(attr.map_name) - 1);
+    return static_cast<int>(sys_bpf(BPF_MAP_CREATE, &attr));
+}
+
+int map_lookup(int fd, const void* key, void* value) {
+    union bpf_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.map_fd = static_cast<uint32_t>(fd);
+    attr.key = reinterpret_cast<uint64_t>(key);
+    attr.value = reinterpret_cast<uint64_t>(value);
+    return static_cast<int>(sys_bpf(BPF_MAP_LOOKUP_ELEM, &attr));
+}
+
+int map_update(int fd, const void* key, const void* value) {
+    union bpf_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.map_fd = static_cast<uint32_t>(fd);
+    attr.key = reinterpret_cast<uint64_t>(key);
+    attr.value = reinterpret_cast<uint64_t>(value);
+    attr.flags = BPF_ANY;
+    return static_cast<int>(sys_bpf(BPF_MAP_UPDATE_ELEM, &attr));
+}
+
+int map_next_key(int fd, const void* key, void* next) {
+    union bpf_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.map_fd = static_cast<uint32_t>(fd);
+    attr.key = reinterpret_cast<uint64_t>(key);
+    attr.next_key = reinterpret_cast<uint64_t>(next);
+    return static_cast<int>(sys_bpf(BPF_MAP_GET_NEXT_KEY, &attr));
+}
+
+int map_delete(int fd, const void* key) {
+    union bpf_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.map_fd = static_cast<uint32_t>(fd);
+    attr.key = reinterpret_cast<uint64_t>(key);
+    return static_cast<int>(sys_bpf(BPF_MAP_DELETE_ELEM, &attr));
+}
+
+// Per-CPU map values come back one per possible CPU.
+unsigned count_possible_cpus() {
+    std::ifstream file("/sys/devices/system/cpu/possible");
+    std::string list;
+    unsigned count = 0;
+    if (std::getline(file, list)) {
+        std::stringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            unsigned lo = 0, hi = 0;
+            const int fields = std::sscanf(range.c_str(), "%u-%u", &lo, &hi);
+            count += fields == 2 && hi >= lo ? hi - lo + 1 : fields == 1 ? 1 : 0;
+        }
+    }
+    if (count == 0) {
+        const long online = sysconf(_SC_NPROCESSORS_CONF);
+        count = online > 0 ? static_cast<unsigned>(online) : 1;
+    }
+    return count;
+}
+
+// FlowTuple layout: IPv4 mapped, host bits cleared.
+XdpPrefix normalized(const XdpPrefix& prefix) {
+    XdpPrefix out = prefix;
+    const unsigned offset = prefix.ip_version == 6 ? 0 : 96;
+    if (prefix.ip_version != 6) {
+        std::memset(out.addr, 0, 10);
+        out.addr[10] = out.addr[11] = 0xFF;
+    }
+    for (unsigned bit = offset + prefix.length; bit < 128; ++bit) {
+        out.addr[bit / 8] &= static_cast<uint8_t>(~(0x80 >> (bit % 8)));
+    }
+    return out;
+}
+
+PrefixKey key_of(const XdpPrefix& prefix) {
+    PrefixKey key;
+    key.prefixlen = 32 + (prefix.ip_version == 6 ? 0 : 96) + prefix.length;
+    key.ip_version = prefix.ip_version;
+    std::memcpy(key.addr, prefix.addr, sizeof(key.addr));
+    return key;
+}
+
+// ====================================================================
+// A) A minimal BPF assembler (forward jumps by label)
+// ====================================================================
+
+class Assembler {
+public:
+    int label() {
+        targets_.push_back(-1);
+        return static_cast<int>(targets_.size() - 1);
+    }
+
+    void bind(int label) { targets_[label] = static_cast<int>(insns_.size()); }
+
+    void mov(uint8_t dst, int32_t imm) { emit(BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm); }
+    void mov_reg(uint8_t dst, uint8_t src) { emit(BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0); }
+    void alu64(uint8_t op, uint8_t dst, int32_t imm) { emit(BPF_ALU64 | op | BPF_K, dst, 0, 0, imm); }
+    void alu64_reg(uint8_t op, uint8_t dst, uint8_t src) { emit(BPF_ALU64 | op | BPF_X, dst, src, 0, 0); }
+    void alu32(uint8_t op, uint8_t dst, uint32_t imm) {
+        emit(BPF_ALU | op | BPF_K, dst, 0, 0, static_cast<int32_t>(imm));
+    }
+
+    // Network to host order of the low 16 bits (a no-op on big endian).
+    void be16(uint8_t dst) { emit(BPF_ALU | BPF_END | BPF_TO_BE, dst, 0, 0, 16); }
+
+    void load_imm64(uint8_t dst, uint64_t value) {
+        emit(BPF_LD | BPF_DW | BPF_IMM, dst, 0, 0, static_cast<int32_t>(value & 0xFFFFFFFFu));
+        emit(0, 0, 0, 0, static_cast<int32_t>(value >> 32));
+    }
+
+    void load_map(uint8_t dst, int map_fd) {
+        emit(BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, map_fd);
+        emit(0, 0, 0, 0, 0);
+    }
+
+    void ldx(uint8_t size, uint8_t dst, uint8_t src, int16_t off) {
+        emit(BPF_LDX | size | BPF_MEM, dst, src, off, 0);
+    }
+    void stx(uint8_t size, uint8_t dst, uint8_t src, int16_t off) {
+        emit(BPF_STX | size | BPF_MEM, dst, src, off, 0);
+    }
+    void st(uint8_t size, uint8_t dst, int16_t off, int32_t imm) {
+        emit(BPF_ST | size | BPF_MEM, dst, 0, off, imm);
+    }
+    void atomic_add64(uint8_t dst, uint8_t src, int16_t off) {
+        emit(BPF_STX | BPF_DW | BPF_ATOMIC, dst, src, off, BPF_ADD);
+    }
+
+    void jump(uint8_t op, uint8_t dst, int32_t imm, int label) {
+        fixups_.emplace_back(insns_.size(), label);
+        emit(BPF_JMP | op | BPF_K, dst, 0, 0, imm);
+    }
+    void jump_reg(uint8_t op, uint8_t dst, uint8_t src, int label) {
+        fixups_.emplace_back(insns_.size(), label);
+        emit(BPF_JMP | op | BPF_X, dst, src, 0, 0);
+    }
+    void go(int label) {
+        fixups_.emplace_back(insns_.size(), label);
+        emit(BPF_JMP | BPF_JA, 0, 0, 0, 0);
+    }
+
+    void call(int32_t helper) { emit(BPF_JMP | BPF_CALL, 0, 0, 0, helper); }
+    void exit_with(int32_t verdict) {
+        mov(BPF_REG_0, verdict);
+        emit(BPF_JMP | BPF_EXIT, 0, 0, 0, 0);
+    }
+
+    std::vector<bpf_insn> finish() {
+        for (const auto& [at, label] : fixups_) {
+            insns_[at].off = static_cast<int16_t>(targets_[label] - static_cast<int>(at) - 1);
+        }
+        return insns_;
+    }
+
+private:
+    void emit(uint8_t code, uint8_t dst, uint8_t src, int16_t off, int32_t imm) {
+        bpf_insn insn;
+        std::memset(&insn, 0, sizeof(insn));
+        insn.code = code;
+        insn.dst_reg = dst;
+        insn.src_reg = src;
+        insn.off = off;
+        insn.imm = imm;
+        insns_.push_back(insn);
+    }
+
+    std::vector<bpf_insn> insns_;
+    std::vector<int> targets_;
+    std::vector<std::pair<size_t, int>> fixups_;
+};
+
+// ====================================================================
+// B) The XDP program
+// ====================================================================
+
+// Registers: r6 ctx, r7 data, r8 data_end, r9 frame length (all survive
+// helper calls); r4 walks the headers; r1-r3, r5 are scratch.
+struct ProgramMaps {
+    int flows;
+    int prefixes[2];
+    int totals;
+};
+
+void emit_count_total(Assembler& a, int totals_map, uint32_t slot) {
+    const int skip = a.label();
+    a.st(BPF_W, BPF_REG_10, STACK_TOTALS_KEY, static_cast<int32_t>(slot));
+    a.load_map(BPF_REG_1, totals_map);
+    a.mov_reg(BPF_REG_2, BPF_REG_10);
+    a.alu64(BPF_ADD, BPF_REG_2, STACK_TOTALS_KEY);
+    a.call(BPF_FUNC_map_lookup_elem);
+    a.jump(BPF_JEQ, BPF_REG_0, 0, skip);
+    // Per-CPU slot: plain adds.
+    a.ldx(BPF_DW, BPF_REG_1, BPF_REG_0, 0);
+    a.alu64(BPF_ADD, BPF_REG_1, 1);
+    a.stx(BPF_DW, BPF_REG_0, BPF_REG_1, 0);
+    a.ldx(BPF_DW, BPF_REG_1, BPF_REG_0, 8);
+    a.alu64_reg(BPF_ADD, BPF_REG_1, BPF_REG_9);
+    a.stx(BPF_DW, BPF_REG_0, BPF_REG_1, 8);
+    a.bind(skip);
+}
+
+// Bumps the hit counters of the map value in r0 (shared across CPUs).
+void emit_count_hit(Assembler& a) {
+    a.mov(BPF_REG_1, 1);
+    a.atomic_add64(BPF_REG_0, BPF_REG_1, 0);
+    a.atomic_add64(BPF_REG_0, BPF_REG_9, 8);
+}
+
+// parse_packet(): fills the FlowTuple at STACK_TUPLE, jumping to `hash`
+// with a valid tuple or to `pass` for frames it does not understand.
+void emit_parse(Assembler& a, int pass, int hash) {
+    const int ipv4 = a.label();
+    const int ipv6 = a.label();
+    const int ports = a.label();
+
+    for (int16_t off = STACK_TUPLE; off < 0; off += 8) {
+        a.st(BPF_DW, BPF_REG_10, off, 0);
+    }
+
+    // Ethernet and up to two VLAN tags; r3 = ethertype, r4 = L3 header.
+    a.mov_reg(BPF_REG_4, BPF_REG_7);
+    a.alu64(BPF_ADD, BPF_REG_4, 14);
+    a.jump_reg(BPF_JGT, BPF_REG_4, BPF_REG_8, pass);
+    a.ldx(BPF_H, BPF_REG_3, BPF_REG_7, 12);
+    for (int tags = 0; tags < 2; ++tags) {
+        const int tagged = a.label();
+        const int untagged = a.label();
+        a.jump(BPF_JEQ, BPF_REG_3, htons(0x8100), tagged);
+        a.jump(BPF_JNE, BPF_REG_3, htons(0x88A8), untagged);
+        a.bind(tagged);
+        a.mov_reg(BPF_REG_2, BPF_REG_4);
+        a.alu64(BPF_ADD, BPF_REG_2, 4);
+        a.jump_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, pass);
+        a.ldx(BPF_H, BPF_REG_3, BPF_REG_4, 2);
+        a.alu64(BPF_ADD, BPF_REG_4, 4);
+        a.bind(untagged);
+    }
+    a.jump(BPF_JEQ, BPF_REG_3, htons(0x0800), ipv4);
+    a.jump(BPF_JEQ, BPF_REG_3, htons(0x86DD), ipv6);
+    a.go(pass);
+
+    // IPv4
+    a.bind(ipv4);
+    a.mov_reg(BPF_REG_2, BPF_REG_4);
+    a.alu64(BPF_ADD, BPF_REG_2, 20);
+    a.jump_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, pass);
+    a.ldx(BPF_B, BPF_REG_5, BPF_REG_4, 0);
+    a.mov_reg(BPF_REG_2, BPF_REG_5);
+    a.alu64(BPF_RSH, BPF_REG_2, 4);
+    a.jump(BPF_JNE, BPF_REG_2, 4, pass);
+    a.alu64(BPF_AND, BPF_REG_5, 0x0F);
+    a.alu64(BPF_LSH, BPF_REG_5, 2);
+    a.jump(BPF_JLT, BPF_REG_5, 20, pass);
+    a.mov_reg(BPF_REG_2, BPF_REG_4);
+    a.alu64_reg(BPF_ADD, BPF_REG_2, BPF_REG_5);
+    a.jump_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, pass);
+    a.st(BPF_B, BPF_REG_10, tuple_at(offsetof(FlowTuple, ip_version)), 4);
+    a.ldx(BPF_B, BPF_REG_1, BPF_REG_4, 9);
+    a.stx(BPF_B, BPF_REG_10, BPF_REG_1, tuple_at(offsetof(FlowTuple, protocol)));
+    a.st(BPF_H, BPF_REG_10, tuple_at(offsetof(FlowTuple, src_addr) + 10), 0xFFFF);
+    a.st(BPF_H, BPF_REG_10, tuple_at(offsetof(FlowTuple, dst_addr) + 10), 0xFFFF);
+    a.ldx(BPF_W, BPF_REG_1, BPF_REG_4, 12);
+    a.stx(BPF_W, BPF_REG_10, BPF_REG_1, tuple_at(offsetof(FlowTuple, src_addr) + 12));
+    a.ldx(BPF_W, BPF_REG_1, BPF_REG_4, 16);
+    a.stx(BPF_W, BPF_REG_10, BPF_REG_1, tuple_at(offsetof(FlowTuple, dst_addr) + 12));
+    // Only the first fragment carries the L4 header.
+    a.ldx(BPF_H, BPF_REG_1, BPF_REG_4, 6);
+    a.be16(BPF_REG_1);
+    a.alu64(BPF_AND, BPF_REG_1, 0x1FFF);
+    a.jump(BPF_JNE, BPF_REG_1, 0, hash);
+    a.mov_reg(BPF_REG_4, BPF_REG_2);
+    a.ldx(BPF_B, BPF_REG_1, BPF_REG_10, tuple_at(offsetof(FlowTuple, protocol)));
+    a.go(ports);
+
+    // IPv6; r5 = next header.
+    a.bind(ipv6);
+    a.mov_reg(BPF_REG_2, BPF_REG_4);
+    a.alu64(BPF_ADD, BPF_REG_2, 40);
+    a.jump_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, pass);
+    a.ldx(BPF_B, BPF_REG_5, BPF_REG_4, 0);
+    a.alu64(BPF_RSH, BPF_REG_5, 4);
+    a.jump(BPF_JNE, BPF_REG_5, 6, pass);
+    a.st(BPF_B, BPF_REG_10, tuple_at(offsetof(FlowTuple, ip_version)), 6);
+    for (size_t word = 0; word < 4; ++word) {
+        a.ldx(BPF_DW, BPF_REG_1, BPF_REG_4, static_cast<int16_t>(8 + 8 * word));
+        a.stx(BPF_DW, BPF_REG_10, BPF_REG_1, tuple_at(offsetof(FlowTuple, src_addr) + 8 * word));
+    }
+    a.ldx(BPF_B, BPF_REG_5, BPF_REG_4, 6);
+    a.alu64(BPF_ADD, BPF_REG_4, 40);
+    // Hop-by-hop, routing, destination options and fragment headers.
+    const int last_header = a.label();
+    for (int hops = 0; hops < 4; ++hops) {
+        const int extension = a.label();
+        const int fragment = a.label();
+        const int next = a.label();
+        a.jump(BPF_JEQ, BPF_REG_5, 0, extension);
+        a.jump(BPF_JEQ, BPF_REG_5, 43, extension);
+        a.jump(BPF_JEQ, BPF_REG_5, 60, extension);
+        a.jump(BPF_JEQ, BPF_REG_5, 44, fragment);
+        a.go(last_header);
+
+        a.bind(extension);
+        a.mov_reg(BPF_REG_2, BPF_REG_4);
+        a.alu64(BPF_ADD, BPF_REG_2, 8);
+        a.jump_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, last_header);
+        a.ldx(BPF_B, BPF_REG_5, BPF_REG_4, 0);
+        a.ldx(BPF_B, BPF_REG_1, BPF_REG_4, 1);
+        a.alu64(BPF_ADD, BPF_REG_1, 1);
+        a.alu64(BPF_LSH, BPF_REG_1, 3);
+        a.alu64_reg(BPF_ADD, BPF_REG_4, BPF_REG_1);
+        a.go(next);
+
+        a.bind(fragment);
+        a.mov_reg(BPF_REG_2, BPF_REG_4);
+        a.alu64(BPF_ADD, BPF_REG_2, 8);
+        a.jump_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, last_header);
+        a.ldx(BPF_H, BPF_REG_1, BPF_REG_4, 2);
+        a.be16(BPF_REG_1);
+        a.alu64(BPF_AND, BPF_REG_1, 0xFFF8);
+        a.ldx(BPF_B, BPF_REG_5, BPF_REG_4, 0);
+        a.alu64(BPF_ADD, BPF_REG_4, 8);
+        a.jump(BPF_JEQ, BPF_REG_1, 0, next);
+        a.stx(BPF_B, BPF_REG_10, BPF_REG_5, tuple_at(offsetof(FlowTuple, protocol)));
+        a.go(hash);
+
+        a.bind(next);
+    }
+    a.bind(last_header);
+    a.stx(BPF_B, BPF_REG_10, BPF_REG_5, tuple_at(offsetof(FlowTuple, protocol)));
+    a.mov_reg(BPF_REG_1, BPF_REG_5);
+
+    // TCP/UDP ports (host order); r4 = L4 header, r1 = protocol.
+    a.bind(ports);
+    const int has_ports = a.label();
+    a.jump(BPF_JEQ, BPF_REG_1, IPPROTO_TCP_NUM, has_ports);
+    a.jump(BPF_JNE, BPF_REG_1, IPPROTO_UDP_NUM, hash);
+    a.bind(has_ports);
+    a.mov_reg(BPF_REG_2, BPF_REG_4);
+    a.alu64(BPF_ADD, BPF_REG_2, 4);
+    a.jump_reg(BPF_JGT, BPF_REG_2, BPF_REG_8, hash);
+    a.ldx(BPF_H, BPF_REG_3, BPF_REG_4, 0);
+    a.be16(BPF_REG_3);
+    a.stx(BPF_H, BPF_REG_10, BPF_REG_3, tuple_at(offsetof(FlowTuple, src_port)));
+    a.ldx(BPF_H, BPF_REG_3, BPF_REG_4, 2);
+    a.be16(BPF_REG_3);
+    a.stx(BPF_H, BPF_REG_10, BPF_REG_3, tuple_at(offsetof(FlowTuple, dst_port)));
+}
+
+// flow_key_of() over the tuple, stored at STACK_FLOW_KEY.
+void emit_flow_key(Assembler& a) {
+    a.mov(BPF_REG_3, 0);
+    for (int i = 0; i < 10; i += 2) {
+        a.ldx(BPF_W, BPF_REG_1, BPF_REG_10, tuple_at(4 * i));
+        a.alu32(BPF_ADD, BPF_REG_1, FLOW_HASH_KEYS[i]);
+        a.ldx(BPF_W, BPF_REG_2, BPF_REG_10, tuple_at(4 * (i + 1)));
+        a.alu32(BPF_ADD, BPF_REG_2, FLOW_HASH_KEYS[i + 1]);
+        a.alu64_reg(BPF_MUL, BPF_REG_1, BPF_REG_2);
+        a.alu64_reg(BPF_ADD, BPF_REG_3, BPF_REG_1);
+    }
+    for (uint64_t multiplier : {0xFF51AFD7ED558CCDull, 0xC4CEB9FE1A85EC53ull}) {
+        a.mov_reg(BPF_REG_1, BPF_REG_3);
+        a.alu64(BPF_RSH, BPF_REG_1, 33);
+        a.alu64_reg(BPF_XOR, BPF_REG_3, BPF_REG_1);
+        a.load_imm64(BPF_REG_2, multiplier);
+        a.alu64_reg(BPF_MUL, BPF_REG_3, BPF_REG_2);
+    }
+    a.mov_reg(BPF_REG_1, BPF_REG_3);
+    a.alu64(BPF_RSH, BPF_REG_1, 33);
+    a.alu64_reg(BPF_XOR, BPF_REG_3, BPF_REG_1);
+    const int nonzero = a.label();
+    a.jump(BPF_JNE, BPF_REG_3, 0, nonzero);
+    a.mov(BPF_REG_3, 1);
+    a.bind(nonzero);
+    a.stx(BPF_DW, BPF_REG_10, BPF_REG_3, STACK_FLOW_KEY);
+}
+
+std::vector<bpf_insn> build_program(const ProgramMaps& maps) {
+    Assembler a;
+    const int pass = a.label();
+    const int hash = a.label();
+    const int prefixes = a.label();
+    const int prefix_hit = a.label();
+
+    a.mov_reg(BPF_REG_6, BPF_REG_1);
+    a.ldx(BPF_W, BPF_REG_7, BPF_REG_6, offsetof(xdp_md, data));
+    a.ldx(BPF_W, BPF_REG_8, BPF_REG_6, offsetof(xdp_md, data_end));
+    a.mov_reg(BPF_REG_9, BPF_REG_8);
+    a.alu64_reg(BPF_SUB, BPF_REG_9, BPF_REG_7);
+
+    emit_parse(a, pass, hash);
+    a.bind(hash);
+    emit_flow_key(a);
+
+    // 1. Flow policies: DROP drops, any other action is the engine's call.
+    const int flow_drop = a.label();
+    a.load_map(BPF_REG_1, maps.flows);
+    a.mov_reg(BPF_REG_2, BPF_REG_10);
+    a.alu64(BPF_ADD, BPF_REG_2, STACK_FLOW_KEY);
+    a.call(BPF_FUNC_map_lookup_elem);
+    a.jump(BPF_JEQ, BPF_REG_0, 0, prefixes);
+    emit_count_hit(a);
+    a.ldx(BPF_W, BPF_REG_1, BPF_REG_0, offsetof(FlowValue, action));
+    a.jump(BPF_JEQ, BPF_REG_1, static_cast<int32_t>(FirewallAction::DROP), flow_drop);
+    a.exit_with(XDP_PASS);
+    a.bind(flow_drop);
+    emit_count_total(a, maps.totals, TOTAL_FLOW_DROPS);
+    a.exit_with(XDP_DROP);
+
+    // 2. Source, then destination prefixes.
+    a.bind(prefixes);
+    for (int dst = 0; dst < 2; ++dst) {
+        const size_t addr = dst ? offsetof(FlowTuple, dst_addr) : offsetof(FlowTuple, src_addr);
+        // Full-length key: the longest prefix covering the address matches.
+        a.st(BPF_W, BPF_REG_10, prefix_key_at(offsetof(PrefixKey, prefixlen)), 32 + 128);
+        a.ldx(BPF_B, BPF_REG_1, BPF_REG_10, tuple_at(offsetof(FlowTuple, ip_version)));
+        a.stx(BPF_W, BPF_REG_10, BPF_REG_1, prefix_key_at(offsetof(PrefixKey, ip_version)));
+        for (size_t word = 0; word < 4; ++word) {
+            a.ldx(BPF_W, BPF_REG_1, BPF_REG_10, tuple_at(addr + 4 * word));
+            a.stx(BPF_W, BPF_REG_10, BPF_REG_1, prefix_key_at(offsetof(PrefixKey, addr) + 4 * word));
+        }
+        a.load_map(BPF_REG_1, maps.prefixes[dst]);
+        a.mov_reg(BPF_REG_2, BPF_REG_10);
+        a.alu64(BPF_ADD, BPF_REG_2, STACK_PREFIX_KEY);
+        a.call(BPF_FUNC_map_lookup_elem);
+        a.jump(BPF_JNE, BPF_REG_0, 0, prefix_hit);
+    }
+    a.bind(pass);
+    a.exit_with(XDP_PASS);
+
+    a.bind(prefix_hit);
+    emit_count_hit(a);
+    emit_count_total(a, maps.totals, TOTAL_PREFIX_DROPS);
+    a.exit_with(XDP_DROP);
+
+    return a.finish();
+}
+
+} // namespace
+
+// ====================================================================
+// C) XdpOffload
+// ====================================================================
+
+bool XdpPrefix::operator<(const XdpPrefix& other) const {
+    return std::tie(dst, ip_version, length) < std::tie(other.dst, other.ip_version, other.length) ||
+           (std::tie(dst, ip_version, length) == std::tie(other.dst, other.ip_version, other.length) &&
+            std::memcmp(addr, other.addr, sizeof(addr)) < 0);
+}
+
+XdpOffload::XdpOffload() : XdpOffload(Options()) {}
+
+XdpOffload::XdpOffload(const Options& options) : options_(options), possible_cpus_(count_possible_cpus()) {}
+
+XdpOffload::~XdpOffload() {
+    close_all();
+}
+
+int XdpOffload::load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (prog_fd_ >= 0) {
+        return 0;
+    }
+    if (create_maps() != 0 || load_program() != 0) {
+        close_all();
+        return -1;
+    }
+    return 0;
+}
+
+int XdpOffload::create_maps() {
+    flow_map_ = create_map(BPF_MAP_TYPE_HASH, sizeof(FlowKey), sizeof(FlowValue), options_.max_flows, 0,
+                           "enf_flows");
+    if (flow_map_ < 0) {
+        return fail("BPF_MAP_CREATE (flows)", errno);
+    }
+    for (int dst = 0; dst < 2; ++dst) {
+        prefix_maps_[dst] = create_map(BPF_MAP_TYPE_LPM_TRIE, sizeof(PrefixKey), sizeof(XdpHitCounter),
+                                       options_.max_prefixes, BPF_F_NO_PREALLOC, dst ? "enf_dst_pfx" : "enf_src_pfx");
+        if (prefix_maps_[dst] < 0) {
+            return fail("BPF_MAP_CREATE (prefixes)", errno);
+        }
+    }
+    totals_map_ = create_map(BPF_MAP_TYPE_PERCPU_ARRAY, sizeof(uint32_t), sizeof(XdpHitCounter), 2, 0,
+                             "enf_totals");
+    if (totals_map_ < 0) {
+        return fail("BPF_MAP_CREATE (totals)", errno);
+    }
+    return 0;
+}
+
+int XdpOffload::load_program() {
+    const std::vector<bpf_insn> insns = build_program({flow_map_, {prefix_maps_[0], prefix_maps_[1]}, totals_map_});
+    static const char license[] = "Dual BSD/GPL";
+    std::vector<char> log(1 << 16, '\0');
+
+    union bpf_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = reinterpret_cast<uint64_t>(insns.data());
+    attr.insn_cnt = static_cast<uint32_t>(insns.size());
+    attr.license = reinterpret_cast<uint64_t>(license);
+    attr.log_buf = reinterpret_cast<uint64_t>(log.data());
+    attr.log_size = static_cast<uint32_t>(log.size());
+    attr.log_level = 1;
+    std::strncpy(attr.prog_name, "enf_xdp_drop", sizeof(attr.prog_name) - 1);
+    prog_fd_ = static_cast<int>(sys_bpf(BPF_PROG_LOAD, &attr));
+    if (prog_fd_ < 0) {
+        const int err = errno;
+        std::cerr << "[C++ XDP ERROR] verifier log:\n" << log.data() << std::endl;
+        return fail("BPF_PROG_LOAD", err);
+    }
+    return 0;
+}
+
+int XdpOffload::attach(const char* ifname, uint32_t xdp_flags) {
+    if (load() != 0) {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (link_fd_ >= 0) {
+        std::cerr << "[C++ XDP ERROR] already attached to ifindex " << ifindex_ << std::endl;
+        return -1;
+    }
+    const unsigned ifindex = ifname != nullptr ? if_nametoindex(ifname) : 0;
+    if (ifindex == 0) {
+        return fail("if_nametoindex", errno ? errno : ENODEV);
+    }
+
+    union bpf_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = static_cast<uint32_t>(prog_fd_);
+    attr.link_create.target_ifindex = ifindex;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = xdp_flags & XDP_FLAGS_MODES;
+    link_fd_ = static_cast<int>(sys_bpf(BPF_LINK_CREATE, &attr));
+    if (link_fd_ < 0) {
+        return fail("BPF_LINK_CREATE (XDP)", errno);
+    }
+    ifindex_ = ifindex;
+    std::cout << "[C++ Engine] XDP drop offload attached to " << ifname << std::endl;
+    return 0;
+}
+
+void XdpOffload::detach() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (link_fd_ >= 0) {
+        ::close(link_fd_);   // The link (and the program on the interface) goes with its last fd.
+        link_fd_ = -1;
+        ifindex_ = 0;
+    }
+}
+
+void XdpOffload::close_all() {
+    for (int* fd : {&link_fd_, &prog_fd_, &flow_map_, &prefix_maps_[0], &prefix_maps_[1], &totals_map_}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    ifindex_ = 0;
+    flow_entries_ = 0;
+    prefixes_.clear();
+}
+
+bool XdpOffload::loaded() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return prog_fd_ >= 0;
+}
+
+bool XdpOffload::attached() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return link_fd_ >= 0;
+}
+
+int XdpOffload::set_flow(FlowKey flow_id, FirewallAction action) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (flow_map_ < 0) {
+        return -1;
+    }
+    flow_id = flow_id != 0 ? flow_id : 1;
+    FlowValue value;
+    const bool present = map_lookup(flow_map_, &flow_id, &value) == 0;
+    if (!present) {
+        std::memset(&value, 0, sizeof(value));
+    }
+    value.action = static_cast<uint32_t>(action);
+    if (map_update(flow_map_, &flow_id, &value) != 0) {
+        return fail("BPF_MAP_UPDATE_ELEM (flow)", errno);
+    }
+    flow_entries_ += present ? 0 : 1;
+    return 0;
+}
+
+int XdpOffload::remove_flow(FlowKey flow_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flow_id = flow_id != 0 ? flow_id : 1;
+    if (flow_map_ < 0 || map_delete(flow_map_, &flow_id) != 0) {
+        return -1;
+    }
+    --flow_entries_;
+    return 0;
+}
+
+int XdpOffload::clear_flows() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (flow_map_ < 0) {
+        return -1;
+    }
+    FlowKey flow_id;
+    while (map_next_key(flow_map_, nullptr, &flow_id) == 0) {
+        map_delete(flow_map_, &flow_id);
+    }
+    flow_entries_ = 0;
+    return 0;
+}
+
+int XdpOffload::prefix_map(const XdpPrefix& prefix) const {
+    return prefix_maps_[prefix.dst ? 1 : 0];
+}
+
+int XdpOffload::set_prefixes(const std::vector<XdpPrefix>& prefixes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (prefix_maps_[0] < 0) {
+        return -1;
+    }
+    std::set<XdpPrefix> wanted;
+    for (const XdpPrefix& prefix : prefixes) {
+        wanted.insert(normalized(prefix));
+    }
+
+    // Add first, so a prefix replaced by a covering one is never unprotected.
+    int result = 0;
+    const XdpHitCounter zero;
+    for (const XdpPrefix& prefix : wanted) {
+        if (prefixes_.count(prefix) != 0) {
+            continue;
+        }
+        const PrefixKey key = key_of(prefix);
+        if (map_update(prefix_map(prefix), &key, &zero) != 0) {
+            result = fail("BPF_MAP_UPDATE_ELEM (prefix)", errno);
+            continue;
+        }
+        prefixes_.insert(prefix);
+    }
+    for (auto it = prefixes_.begin(); it != prefixes_.end();) {
+        if (wanted.count(*it) != 0) {
+            ++it;
+            continue;
+        }
+        const PrefixKey key = key_of(*it);
+        map_delete(prefix_map(*it), &key);
+        it = prefixes_.erase(it);
+    }
+    return result;
+}
+
+bool XdpOffload::flow_hits(FlowKey flow_id, XdpHitCounter* hits) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flow_id = flow_id != 0 ? flow_id : 1;
+    FlowValue value;
+    if (flow_map_ < 0 || map_lookup(flow_map_, &flow_id, &value) != 0) {
+        return false;
+    }
+    hits->packets = value.packets;
+    hits->bytes = value.bytes;
+    return true;
+}
+
+bool XdpOffload::prefix_hits(const XdpPrefix& prefix, XdpHitCounter* hits) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const XdpPrefix entry = normalized(prefix);
+    const PrefixKey key = key_of(entry);
+    // An LPM lookup would return the covering prefix; only exact entries count.
+    return prefix_maps_[0] >= 0 && prefixes_.count(entry) != 0 && map_lookup(prefix_map(entry), &key, hits) == 0;
+}
+
+bool XdpOffload::totals(uint32_t slot, XdpHitCounter* sum) const {
+    std::vector<XdpHitCounter> per_cpu(possible_cpus_);
+    if (totals_map_ < 0 || map_lookup(totals_map_, &slot, per_cpu.data()) != 0) {
+        return false;
+    }
+    for (const XdpHitCounter& counter : per_cpu) {
+        sum->packets += counter.packets;
+        sum->bytes += counter.bytes;
+    }
+    return true;
+}
+
+XdpOffloadStats XdpOffload::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    XdpOffloadStats stats;
+    stats.attached = link_fd_ >= 0;
+    stats.ifindex = ifindex_;
+    stats.flow_entries = flow_entries_;
+    stats.prefix_entries = prefixes_.size();
+    totals(TOTAL_FLOW_DROPS, &stats.flow_drops);
+    totals(TOTAL_PREFIX_DROPS, &stats.prefix_drops);
+    return stats;
+}
+
+int XdpOffload::run_on(const uint8_t* frame, uint32_t len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (prog_fd_ < 0) {
+        return -1;
+    }
+    union bpf_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.test.prog_fd = static_cast<uint32_t>(prog_fd_);
+    attr.test.data_in = reinterpret_cast<uint64_t>(frame);
+    attr.test.data_size_in = len;
+    attr.test.repeat = 1;
+    if (sys_bpf(BPF_PROG_TEST_RUN, &attr) != 0) {
+        return fail("BPF_PROG_TEST_RUN", errno);
+    }
+    return static_cast<int>(attr.test.retval);
+}
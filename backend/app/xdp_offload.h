@@ -0,0 +1,154 @@
+#ifndef XDP_OFFLOAD_H
+#define XDP_OFFLOAD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "firewall_enforce.h"
+
+// ====================================================================
+// A) Offloaded entries and counters
+// ====================================================================
+
+/**
+ * @brief One DROP prefix mirrored into the kernel. The address uses the
+ * FlowTuple layout (IPv4-mapped for IPv4); length counts bits of the
+ * family's own address, as in FirewallRule.
+ */
+struct XdpPrefix {
+    uint8_t ip_version = 4;   // 4 or 6
+    uint8_t length = 0;       // 1..32 or 1..128
+    uint8_t dst = 0;          // 0 = match the source address, 1 = the destination
+    uint8_t addr[16] = {};
+
+    bool operator<(const XdpPrefix& other) const;
+};
+
+/**
+ * @brief Packets and bytes an offloaded entry (or the whole program) dropped.
+ */
+struct XdpHitCounter {
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+};
+
+struct XdpOffloadStats {
+    bool attached = false;
+    uint32_t ifindex = 0;
+    uint64_t flow_entries = 0;     // Flow policies mirrored (any action)
+    uint64_t prefix_entries = 0;   // DROP prefixes mirrored
+    XdpHitCounter flow_drops;      // Dropped by the flow map
+    XdpHitCounter prefix_drops;    // Dropped by the prefix maps
+};
+
+// ====================================================================
+// B) XDP program and its maps
+// ====================================================================
+
+/**
+ * @brief Drops banned traffic in the driver, before it reaches the capture
+ * rings, by mirroring the enforcer's DROP decisions into BPF maps read by
+ * an XDP program.
+ *
+ * The program parses frames exactly like parse_packet() (Ethernet, two VLAN
+ * tags, IPv4, IPv6 extension headers, TCP/UDP ports), computes the same
+ * FlowKey as flow_key_of() and then, in the engine's order:
+ *   1. flow map (hash, FlowKey -> action): DROP drops, anything else
+ *      (PASS, REJECT, RATE_LIMIT) goes up to user space untouched;
+ *   2. source and destination prefix maps (LPM tries): a hit drops.
+ * Every hit counts packets and bytes in its map entry; drops are also
+ * totalled in a per-CPU array.
+ *
+ * The program is generated as BPF instructions at load time, so it needs
+ * neither clang nor libbpf, just bpf(2) (CAP_BPF/CAP_NET_ADMIN) and, to
+ * attach, a kernel with BPF links for XDP (5.9+). The XDP program detaches
+ * when this object is destroyed.
+ *
+ * Calls are serialized internally; the engine mirrors into it from its
+ * control plane.
+ */
+class XdpOffload {
+public:
+    struct Options {
+        uint32_t max_flows = 1u << 20;
+        uint32_t max_prefixes = 1u << 18;   // Per direction
+    };
+
+    XdpOffload();
+    explicit XdpOffload(const Options& options);
+    ~XdpOffload();
+
+    XdpOffload(const XdpOffload&) = delete;
+    XdpOffload& operator=(const XdpOffload&) = delete;
+
+    /**
+     * @brief Creates the maps and loads the program (no interface yet).
+     * @return 0, or -1 (reason on stderr, e.g. missing privileges).
+     */
+    int load();
+
+    /**
+     * @brief Loads if needed and attaches to ifname. xdp_flags are
+     * XDP_FLAGS_SKB_MODE / XDP_FLAGS_DRV_MODE (0 = let the kernel pick).
+     * @return 0 or -1.
+     */
+    int attach(const char* ifname, uint32_t xdp_flags = 0);
+
+    /**
+     * @brief Detaches from the interface; the maps and counters stay.
+     */
+    void detach();
+
+    bool loaded() const;
+    bool attached() const;
+
+    /**
+     * @brief Mirrors enforce_flow_policy(). Keeps the entry's counters when
+     * the flow is already present. @return 0 or -1 (map full).
+     */
+    int set_flow(FlowKey flow_id, FirewallAction action);
+    int remove_flow(FlowKey flow_id);
+    int clear_flows();
+
+    /**
+     * @brief Makes the prefix maps hold exactly `prefixes`; entries that
+     * stay keep their counters. @return 0, or -1 if some did not fit.
+     */
+    int set_prefixes(const std::vector<XdpPrefix>& prefixes);
+
+    bool flow_hits(FlowKey flow_id, XdpHitCounter* hits) const;
+    bool prefix_hits(const XdpPrefix& prefix, XdpHitCounter* hits) const;
+    XdpOffloadStats stats() const;
+
+    /**
+     * @brief Runs the loaded program on one frame in the kernel
+     * (BPF_PROG_TEST_RUN), counters included.
+     * @return The XDP verdict (XDP_DROP, XDP_PASS), or -1.
+     */
+    int run_on(const uint8_t* frame, uint32_t len);
+
+private:
+    int create_maps();
+    int load_program();
+    void close_all();
+    int prefix_map(const XdpPrefix& prefix) const;
+    bool totals(uint32_t slot, XdpHitCounter* sum) const;
+
+    Options options_;
+    int flow_map_ = -1;
+    int prefix_maps_[2] = {-1, -1};   // Source, destination
+    int totals_map_ = -1;
+    int prog_fd_ = -1;
+    int link_fd_ = -1;
+    uint32_t ifindex_ = 0;
+    unsigned possible_cpus_ = 1;
+
+    mutable std::mutex mutex_;
+    size_t flow_entries_ = 0;
+    std::set<XdpPrefix> prefixes_;   // What the prefix maps hold
+};
+
+#endif // XDP_OFFLOAD_H
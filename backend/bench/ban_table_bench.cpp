@@ -0,0 +1,194 @@
+// bench/ban_table_bench.cpp
+//
+// Hit/miss cost of the enforcer's flow lookup (per packet and batched), and
+// control-plane churn.
+//
+// Build (Google Benchmark):
+//   g++ -std=c++17 -O2 -I../app -I../src ban_table_bench.cpp -o ban_table_bench -lbenchmark -lpthread
+//   ./ban_table_bench --benchmark_format=json
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "ban_table.h"
+#include "firewall_enforce.h"
+
+namespace {
+
+// Banned keys are even, probe misses are odd (flow keys are arbitrary 64-bit values).
+std::vector<uint64_t> make_keys(size_t n, uint64_t parity, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint64_t> keys(n);
+    for (uint64_t& key : keys) {
+        key = (rng() & ~1ull) | parity;
+    }
+    return keys;
+}
+
+std::unique_ptr<ConcurrentBanTable<FirewallAction>> make_table(const std::vector<uint64_t>& banned) {
+    auto table = std::make_unique<ConcurrentBanTable<FirewallAction>>(banned.size());
+    for (uint64_t key : banned) {
+        table->insert(key, FirewallAction::DROP);
+    }
+    return table;
+}
+
+// A minimal Ethernet/IPv4/UDP frame for the given source address/port.
+void make_frame(uint8_t* frame, uint32_t src, uint16_t sport) {
+    std::memset(frame, 0, 64);
+    frame[12] = 0x08;
+    frame[14] = 0x45;
+    frame[23] = IPPROTO_UDP_NUM;
+    std::memcpy(frame + 26, &src, 4);
+    frame[30] = 10;
+    frame[33] = 1;
+    frame[34] = static_cast<uint8_t>(sport >> 8);
+    frame[35] = static_cast<uint8_t>(sport);
+    frame[37] = 53;
+}
+
+} // namespace
+
+// ====================================================================
+// A) ConcurrentBanTable lookups
+// ====================================================================
+
+static void BM_LookupHit(benchmark::State& state) {
+    const auto banned = make_keys(static_cast<size_t>(state.range(0)), 0, 1);
+    const auto table = make_table(banned);
+    size_t i = 0;
+    FirewallAction action;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table->lookup(banned[i], &action));
+        i = (i + 1) % banned.size();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LookupHit)->Arg(1 << 10)->Arg(100000)->Arg(1 << 20);
+
+static void BM_LookupMiss(benchmark::State& state) {
+    const auto banned = make_keys(static_cast<size_t>(state.range(0)), 0, 1);
+    const auto probes = make_keys(1 << 16, 1, 2);
+    const auto table = make_table(banned);
+    size_t i = 0;
+    FirewallAction action;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table->lookup(probes[i], &action));
+        i = (i + 1) & (probes.size() - 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LookupMiss)->Arg(1 << 10)->Arg(100000)->Arg(1 << 20);
+
+// Misses while a writer bans and unbans keys as fast as it can.
+static void BM_LookupMissUnderChurn(benchmark::State& state) {
+    const auto banned = make_keys(100000, 0, 1);
+    const auto probes = make_keys(1 << 16, 1, 2);
+    const auto table = make_table(banned);
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> updates{0};
+    std::thread writer([&] {
+        const auto churn = make_keys(4096, 0, 3);
+        size_t j = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            table->insert(churn[j], FirewallAction::DROP);
+            table->erase(churn[(j + 2048) & 4095]);
+            j = (j + 1) & 4095;
+            updates.fetch_add(2, std::memory_order_relaxed);
+        }
+    });
+
+    size_t i = 0;
+    FirewallAction action;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table->lookup(probes[i], &action));
+        i = (i + 1) & (probes.size() - 1);
+    }
+    stop.store(true);
+    writer.join();
+    state.SetItemsProcessed(state.iterations());
+    state.counters["updates"] = static_cast<double>(updates.load());
+}
+BENCHMARK(BM_LookupMissUnderChurn)->UseRealTime();
+
+// ====================================================================
+// B) Control plane
+// ====================================================================
+
+static void BM_InsertErase(benchmark::State& state) {
+    const auto banned = make_keys(100000, 0, 1);
+    const auto churn = make_keys(4096, 1, 3);
+    const auto table = make_table(banned);
+    size_t i = 0;
+    for (auto _ : state) {
+        table->insert(churn[i], FirewallAction::DROP);
+        table->erase(churn[i]);
+        i = (i + 1) & 4095;
+    }
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_InsertErase);
+
+// ====================================================================
+// C) SimpleFlowEnforcer::get_decision (parse + hash + lookup)
+// ====================================================================
+
+constexpr size_t FRAMES = 1024;
+
+// FRAMES distinct UDP flows, all banned when hit is set.
+void make_frames(std::vector<uint8_t>& frames, SimpleFlowEnforcer& enforcer, bool hit) {
+    frames.assign(FRAMES * 64, 0);
+    for (size_t i = 0; i < FRAMES; ++i) {
+        uint8_t* frame = &frames[i * 64];
+        make_frame(frame, static_cast<uint32_t>(0x0A000000u + i), static_cast<uint16_t>(1024 + i));
+        if (hit) {
+            enforcer.enforce_flow_policy(flow_key_of(parse_packet(frame, 64).tuple), FirewallAction::DROP);
+        }
+    }
+}
+
+static void BM_GetDecision(benchmark::State& state) {
+    std::vector<uint8_t> frames;
+    SimpleFlowEnforcer enforcer;
+    make_frames(frames, enforcer, state.range(0) != 0);
+
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(enforcer.get_decision(&frames[i * 64], 64));
+        i = (i + 1) & (FRAMES - 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetDecision)->ArgName("hit")->Arg(0)->Arg(1);
+
+// The batch entry point, called through the base class as the capture loop would.
+static void BM_GetDecisionsBatch(benchmark::State& state) {
+    const size_t batch = static_cast<size_t>(state.range(1));
+    std::vector<uint8_t> frames;
+    SimpleFlowEnforcer enforcer;
+    make_frames(frames, enforcer, state.range(0) != 0);
+    std::vector<const uint8_t*> pkts(FRAMES);
+    std::vector<uint16_t> lens(FRAMES, 64);
+    for (size_t i = 0; i < FRAMES; ++i) {
+        pkts[i] = &frames[i * 64];
+    }
+    std::vector<PacketDecision> out(batch);
+    EnforcementEngine& engine = enforcer;
+
+    size_t i = 0;
+    for (auto _ : state) {
+        engine.get_decisions(&pkts[i], &lens[i], out.data(), batch);
+        benchmark::DoNotOptimize(out.data());
+        i = (i + batch) & (FRAMES - 1);
+    }
+    state.SetItemsProcessed(state.iterations() * batch);
+}
+BENCHMARK(BM_GetDecisionsBatch)->ArgNames({"hit", "batch"})->Args({0, 64})->Args({1, 64})->Args({1, 256});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,54 @@
+#!/usr/bin/env python3
+"""
+Compares two result directories written by run_benchmarks.sh (Google
+Benchmark JSON) and lists every benchmark whose time per iteration moved
+by more than the threshold. Exits 1 if anything got slower.
+
+Usage: compare_results.py results/<old> results/<new> [--threshold 0.05]
+"""
+import argparse
+import json
+import sys
+from pathlib import Path
+
+
+def load(directory: Path) -> dict:
+    """Benchmark name -> real time per iteration (ns), over every suite in the directory"""
+    times = {}
+    for path in sorted(directory.glob("*.json")):
+        if path.stat().st_size == 0:  # A filter matched nothing in that suite
+            continue
+        with open(path) as f:
+            report = json.load(f)
+        for bench in report.get("benchmarks", []):
+            if bench.get("run_type") == "aggregate" and bench.get("aggregate_name") != "median":
+                continue
+            scale = {"ns": 1, "us": 1e3, "ms": 1e6, "s": 1e9}[bench.get("time_unit", "ns")]
+            times[bench["name"]] = bench["real_time"] * scale
+    return times
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("old", type=Path)
+    parser.add_argument("new", type=Path)
+    parser.add_argument("--threshold", type=float, default=0.05, help="relative change to report (default 5%%)")
+    args = parser.parse_args()
+
+    old, new = load(args.old), load(args.new)
+    regressions = 0
+    for name in sorted(old.keys() & new.keys()):
+        change = (new[name] - old[name]) / old[name] if old[name] else 0.0
+        if abs(change) < args.threshold:
+            continue
+        verdict = "SLOWER" if change > 0 else "faster"
+        regressions += change > 0
+        print(f"{verdict:7} {change:+7.1%}  {name}  ({old[name]:.1f} -> {new[name]:.1f} ns)")
+    for name in sorted(new.keys() - old.keys()):
+        print(f"new              {name}")
+    print(f"{regressions} regression(s) over {args.threshold:.0%} in {len(old.keys() & new.keys())} benchmarks")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
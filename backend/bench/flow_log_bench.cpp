@@ -0,0 +1,183 @@
+// bench/flow_log_bench.cpp
+//
+// Cost the flow log adds to a capture worker: appending one finished flow
+// (or one sketch alert) to its columnar segment, with the index update and
+// the segment rotations that come with it, and the stall of a single
+// rotation (seal + create + map of the next segment).
+//
+// Segments go to $BENCH_LOG_DIR if set, otherwise a fresh directory under
+// /tmp (removed afterwards); each stream keeps two segments, so a long run
+// does not fill the disk.
+//
+// Build (Google Benchmark):
+//   g++ -std=c++17 -O2 -I../src flow_log_bench.cpp ../src/flow_log.cpp -o flow_log_bench -lbenchmark
+//   ./flow_log_bench --benchmark_format=json
+
+#include <benchmark/benchmark.h>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "flow_log.h"
+
+namespace {
+
+constexpr size_t RECORDS = size_t(1) << 16;  // Distinct rows cycled through
+
+std::string made_directory;  // Ours to remove, if we created it
+
+std::string log_directory() {
+    if (const char* directory = std::getenv("BENCH_LOG_DIR")) {
+        return directory;
+    }
+    std::string& made = made_directory;
+    if (made.empty()) {
+        char pattern[] = "/tmp/flow_log_bench.XXXXXX";
+        if (mkdtemp(pattern) == nullptr) {
+            return "/tmp";
+        }
+        made = pattern;
+    }
+    return made;
+}
+
+void remove_made_directory() {
+    if (made_directory.empty()) {
+        return;
+    }
+    if (DIR* dir = opendir(made_directory.c_str())) {
+        while (const dirent* entry = readdir(dir)) {
+            if (entry->d_name[0] != '.') {
+                unlink((made_directory + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(made_directory.c_str());
+}
+
+FlowLogSettings settings_for(uint32_t rows) {
+    FlowLogSettings settings;
+    settings.directory = log_directory();
+    settings.streams = SNIFFER_LOG_FLOWS | SNIFFER_LOG_DECISIONS;
+    settings.segment_rows = rows;
+    settings.retain_segments = 2;
+    return settings;
+}
+
+std::vector<C_FlowRecord> make_flows(uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<C_FlowRecord> flows(RECORDS);
+    double now = 1.7e9;
+    for (C_FlowRecord& flow : flows) {
+        std::memset(&flow, 0, sizeof(flow));
+        flow.flow_id = rng();
+        now += 1e-5;
+        flow.start_time = now - static_cast<double>(rng() % 5000) / 1000.0;
+        flow.last_time = now;
+        flow.packet_count = static_cast<uint32_t>(rng() % 1000 + 1);
+        flow.byte_count = flow.packet_count * 600ull;
+        flow.max_pkt_size = 1500;
+        flow.src_port = static_cast<uint16_t>(rng());
+        flow.dst_port = 443;
+        flow.protocol = 6;
+        flow.src_addr[10] = flow.src_addr[11] = 0xFF;
+        flow.dst_addr[10] = flow.dst_addr[11] = 0xFF;
+        const uint32_t src = static_cast<uint32_t>(rng());
+        std::memcpy(flow.src_addr + 12, &src, 4);
+        flow.dst_addr[12] = 192;
+        flow.dst_addr[13] = 168;
+    }
+    return flows;
+}
+
+} // namespace
+
+// ====================================================================
+// A) Append (what emit_flow / raise_alert pay per row)
+// ====================================================================
+
+static void BM_FlowLogAppend(benchmark::State& state) {
+    const uint32_t rows = static_cast<uint32_t>(state.range(0));
+    const std::vector<C_FlowRecord> flows = make_flows(42);
+    FlowLogWriter writer(settings_for(rows), SNIFFER_LOG_FLOWS, 0);
+    if (writer.open() != 0) {
+        state.SkipWithError("could not create a segment");
+        return;
+    }
+    size_t next = 0;
+    for (auto _ : state) {
+        writer.append_flow(flows[next]);
+        next = (next + 1) & (RECORDS - 1);
+    }
+    C_FlowLogStats stats{};
+    writer.add_stats(stats);
+    state.counters["segments"] = static_cast<double>(stats.segments);
+    state.counters["bytes_per_row"] = static_cast<double>(FlowLogWriter::segment_bytes(SNIFFER_LOG_FLOWS, rows)) /
+                                      static_cast<double>(rows);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_FlowLogAppend)->ArgName("segment_rows")->Arg(1 << 12)->Arg(1 << 16)->Arg(1 << 20);
+
+static void BM_DecisionLogAppend(benchmark::State& state) {
+    std::vector<C_SketchAlert> alerts(RECORDS);
+    std::mt19937_64 rng(7);
+    double now = 1.7e9;
+    for (C_SketchAlert& alert : alerts) {
+        std::memset(&alert, 0, sizeof(alert));
+        alert.flow_id = rng();
+        alert.timestamp = now += 1e-5;
+        alert.kind = 2;
+        alert.action = 1;
+        alert.estimate = alert.threshold = 1000;
+    }
+    FlowLogWriter writer(settings_for(SNIFFER_LOG_DEFAULT_ROWS), SNIFFER_LOG_DECISIONS, 0);
+    if (writer.open() != 0) {
+        state.SkipWithError("could not create a segment");
+        return;
+    }
+    size_t next = 0;
+    for (auto _ : state) {
+        writer.append_decision(alerts[next], nullptr);
+        next = (next + 1) & (RECORDS - 1);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_DecisionLogAppend);
+
+// ====================================================================
+// B) One rotation: seal the full segment, create and map the next
+// ====================================================================
+
+static void BM_FlowLogRotate(benchmark::State& state) {
+    const uint32_t rows = static_cast<uint32_t>(state.range(0));
+    const std::vector<C_FlowRecord> flows = make_flows(43);
+    FlowLogWriter writer(settings_for(rows), SNIFFER_LOG_FLOWS, 1);
+    if (writer.open() != 0) {
+        state.SkipWithError("could not create a segment");
+        return;
+    }
+    for (auto _ : state) {
+        writer.close();
+        writer.append_flow(flows[0]);  // Creates the next segment
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_FlowLogRotate)->ArgName("segment_rows")->Arg(1 << 12)->Arg(1 << 16)->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    remove_made_directory();
+    return 0;
+}
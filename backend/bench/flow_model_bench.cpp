@@ -0,0 +1,183 @@
+// bench/flow_model_bench.cpp
+//
+// What the in-engine classifier costs a capture worker per finished flow:
+// FlowModel::score() over full batches of feature rows, for a random forest
+// the size scikit-learn trains on the flow features (complete trees of
+// random splits) and for a multinomial linear model. Model images are
+// built here in the set_flow_model() format and go through parse().
+//
+// Build (Google Benchmark):
+//   g++ -std=c++17 -O2 -I../src flow_model_bench.cpp ../src/flow_model.cpp -o flow_model_bench -lbenchmark
+//   ./flow_model_bench --benchmark_format=json
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "flow_model.h"
+
+namespace {
+
+constexpr uint32_t CLASSES = 4;
+constexpr size_t ROWS = 4096;  // Distinct feature rows cycled through
+
+// Feature ranges of real flows: packets, bytes, seconds, max/avg size, FIN
+const float FEATURE_MAX[C_FLOW_FEATURE_COUNT] = {1000.0f, 1.5e6f, 10.0f, 1500.0f, 1500.0f, 1.0f};
+
+C_FlowModelHeader make_header(uint32_t kind) {
+    C_FlowModelHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = SNIFFER_MODEL_MAGIC;
+    header.version = SNIFFER_MODEL_VERSION;
+    header.kind = kind;
+    header.feature_count = C_FLOW_FEATURE_COUNT;
+    header.class_count = CLASSES;
+    for (int f = 0; f < C_FLOW_FEATURE_COUNT; ++f) {
+        header.feature_scale[f] = 1.0f;
+    }
+    for (uint32_t c = 1; c < CLASSES; ++c) {
+        header.class_actions[c] = 1;
+    }
+    return header;
+}
+
+template <typename T>
+void append(std::vector<uint8_t>& image, const T* values, size_t count) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values);
+    image.insert(image.end(), bytes, bytes + count * sizeof(T));
+}
+
+// trees complete trees of `depth` levels of random splits, leaves with random class scores.
+std::vector<uint8_t> forest_image(uint32_t trees, uint32_t depth) {
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const uint32_t internal = (1u << depth) - 1;   // Per tree, in heap order
+    std::vector<uint32_t> roots;
+    std::vector<C_FlowModelNode> nodes;
+    std::vector<float> values;
+    for (uint32_t t = 0; t < trees; ++t) {
+        const uint32_t base = static_cast<uint32_t>(nodes.size());
+        roots.push_back(base);
+        for (uint32_t n = 0; n < internal; ++n) {
+            C_FlowModelNode node;
+            node.feature = rng() % C_FLOW_FEATURE_COUNT;
+            node.threshold = unit(rng) * FEATURE_MAX[node.feature];
+            uint32_t* children[2] = {&node.left, &node.right};
+            for (uint32_t side = 0; side < 2; ++side) {
+                const uint32_t child = 2 * n + 1 + side;
+                if (child < internal) {
+                    *children[side] = base + child;
+                } else {
+                    *children[side] = SNIFFER_MODEL_LEAF | static_cast<uint32_t>(values.size());
+                    float sum = 0.0f;
+                    float scores[CLASSES];
+                    for (float& score : scores) {
+                        sum += score = unit(rng);
+                    }
+                    for (float score : scores) {
+                        values.push_back(score / sum);
+                    }
+                }
+            }
+            nodes.push_back(node);
+        }
+    }
+    C_FlowModelHeader header = make_header(SNIFFER_MODEL_TREES);
+    header.tree_count = trees;
+    header.node_count = static_cast<uint32_t>(nodes.size());
+    header.value_count = static_cast<uint32_t>(values.size());
+    std::vector<uint8_t> image;
+    append(image, &header, 1);
+    append(image, roots.data(), roots.size());
+    append(image, nodes.data(), nodes.size());
+    append(image, values.data(), values.size());
+    return image;
+}
+
+std::vector<uint8_t> linear_image() {
+    std::mt19937 rng(12);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    C_FlowModelHeader header = make_header(SNIFFER_MODEL_LINEAR);
+    header.value_count = CLASSES * (C_FLOW_FEATURE_COUNT + 1);
+    for (int f = 0; f < C_FLOW_FEATURE_COUNT; ++f) {
+        header.feature_offset[f] = FEATURE_MAX[f] / 2;
+        header.feature_scale[f] = 2.0f / FEATURE_MAX[f];
+    }
+    std::vector<float> values(header.value_count);
+    for (float& value : values) {
+        value = normal(rng);
+    }
+    std::vector<uint8_t> image;
+    append(image, &header, 1);
+    append(image, values.data(), values.size());
+    return image;
+}
+
+std::vector<float> make_rows() {
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<float> rows(ROWS * C_FLOW_FEATURE_COUNT);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        rows[i] = unit(rng) * FEATURE_MAX[i % C_FLOW_FEATURE_COUNT];
+    }
+    return rows;
+}
+
+void run_scoring(benchmark::State& state, const std::vector<uint8_t>& image) {
+    std::string error;
+    const std::shared_ptr<const FlowModel> model = FlowModel::parse(image.data(), image.size(), error);
+    if (!model) {
+        state.SkipWithError(error.c_str());
+        return;
+    }
+    const std::vector<float> rows = make_rows();
+    uint8_t classes[FlowModel::BATCH_MAX];
+    float confidence[FlowModel::BATCH_MAX];
+    size_t next = 0;
+    for (auto _ : state) {
+        model->score(rows.data() + next * C_FLOW_FEATURE_COUNT, FlowModel::BATCH_MAX, classes, confidence);
+        benchmark::DoNotOptimize(classes);
+        next = (next + FlowModel::BATCH_MAX) % ROWS;
+    }
+    state.counters["image_bytes"] = static_cast<double>(image.size());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * FlowModel::BATCH_MAX));
+}
+
+} // namespace
+
+// ====================================================================
+// A) Tree ensemble (trained_model.pkl is a RandomForestClassifier)
+// ====================================================================
+
+static void BM_ForestScore(benchmark::State& state) {
+    run_scoring(state, forest_image(static_cast<uint32_t>(state.range(0)), static_cast<uint32_t>(state.range(1))));
+}
+BENCHMARK(BM_ForestScore)->ArgNames({"trees", "depth"})->Args({10, 8})->Args({100, 8})->Args({100, 12});
+
+// ====================================================================
+// B) Linear model
+// ====================================================================
+
+static void BM_LinearScore(benchmark::State& state) {
+    run_scoring(state, linear_image());
+}
+BENCHMARK(BM_LinearScore);
+
+// ====================================================================
+// C) Parse (what set_flow_model() does before the workers switch)
+// ====================================================================
+
+static void BM_ForestParse(benchmark::State& state) {
+    const std::vector<uint8_t> image = forest_image(100, 8);
+    std::string error;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(FlowModel::parse(image.data(), image.size(), error));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * image.size()));
+}
+BENCHMARK(BM_ForestParse)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,240 @@
+// bench/flow_table_bench.cpp
+//
+// Per-packet cost of the capture worker's FlowTable: updates of existing
+// flows with uniform and Zipf-distributed flow popularity, and inserts of
+// new flows into a full table (each one evicts), and the capture worker's
+// batched path: flow keys for a PacketBatch per kernel, and hash + update
+// of a burst with and without the bucket/entry prefetch.
+//
+// Build (Google Benchmark):
+//   g++ -std=c++17 -O2 -I../src flow_table_bench.cpp ../src/flow_table.cpp ../src/memory_arena.cpp ../src/packet_batch.cpp -o flow_table_bench -lbenchmark
+//   ./flow_table_bench --benchmark_format=json
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "flow_table.h"
+#include "packet_batch.h"
+#include "sniffer_engine.h"
+
+namespace {
+
+// Long enough that nothing expires while a benchmark runs.
+constexpr FlowTimeouts NO_EXPIRY = {~0ull >> 2, ~0ull >> 2, ~0ull >> 2};
+
+constexpr size_t SEQUENCE = size_t(1) << 20;  // Packets per pass over a sequence
+constexpr uint64_t PACKET_GAP_NS = 100;
+
+enum Distribution { UNIFORM, ZIPF };
+
+// Flow i: a distinct IPv4/UDP tuple.
+ParsedPacket make_packet(uint64_t i) {
+    ParsedPacket packet;
+    std::memset(&packet, 0, sizeof(packet));
+    FlowTuple& tuple = packet.tuple;
+    tuple.src_addr[10] = tuple.src_addr[11] = 0xFF;
+    tuple.dst_addr[10] = tuple.dst_addr[11] = 0xFF;
+    tuple.src_addr[12] = 10;
+    tuple.src_addr[13] = static_cast<uint8_t>(i >> 16);
+    tuple.src_addr[14] = static_cast<uint8_t>(i >> 8);
+    tuple.src_addr[15] = static_cast<uint8_t>(i);
+    tuple.dst_addr[12] = 192;
+    tuple.dst_addr[13] = 168;
+    tuple.dst_addr[15] = 1;
+    tuple.src_port = static_cast<uint16_t>(1024 + (i >> 24));
+    tuple.dst_port = 53;
+    tuple.protocol = IPPROTO_UDP_NUM;
+    tuple.ip_version = 4;
+    packet.valid = true;
+    return packet;
+}
+
+// Flow index per packet: uniform, or Zipf(s = 1) over `flows` ranks (the
+// usual shape of real traffic: a few elephants, a long tail of mice).
+std::vector<uint32_t> make_sequence(size_t flows, Distribution distribution, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint32_t> sequence(SEQUENCE);
+    if (distribution == UNIFORM) {
+        std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(flows - 1));
+        for (uint32_t& index : sequence) {
+            index = pick(rng);
+        }
+        return sequence;
+    }
+    std::vector<double> cdf(flows);
+    double sum = 0;
+    for (size_t rank = 0; rank < flows; ++rank) {
+        sum += 1.0 / static_cast<double>(rank + 1);
+        cdf[rank] = sum;
+    }
+    std::uniform_real_distribution<double> pick(0, sum);
+    for (uint32_t& index : sequence) {
+        index = static_cast<uint32_t>(std::lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin());
+    }
+    // Spread the popular ranks over the table instead of the first flows built.
+    std::vector<uint32_t> shuffle(flows);
+    for (uint32_t i = 0; i < flows; ++i) {
+        shuffle[i] = i;
+    }
+    std::shuffle(shuffle.begin(), shuffle.end(), rng);
+    for (uint32_t& index : sequence) {
+        index = shuffle[index];
+    }
+    return sequence;
+}
+
+} // namespace
+
+// ====================================================================
+// A) Updates of tracked flows
+// ====================================================================
+
+static void BM_FlowUpdate(benchmark::State& state) {
+    const size_t flows = static_cast<size_t>(state.range(0));
+    const auto distribution = static_cast<Distribution>(state.range(1));
+    std::vector<ParsedPacket> packets(flows);
+    std::vector<FlowKey> keys(flows);
+    for (size_t i = 0; i < flows; ++i) {
+        packets[i] = make_packet(i);
+        keys[i] = flow_key_of(packets[i].tuple);
+    }
+    const auto sequence = make_sequence(flows, distribution, 1);
+
+    auto table = std::make_unique<FlowTable>(FLOW_TABLE_SLOTS);
+    uint64_t ts_ns = 1;
+    uint64_t evicted = 0;
+    auto on_evict = [&evicted](const FlowEntry&) { ++evicted; };
+    for (size_t i = 0; i < flows; ++i) {
+        table->update(keys[i], packets[i], 64, ts_ns += PACKET_GAP_NS, NO_EXPIRY, on_evict);
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        const uint32_t flow = sequence[i];
+        benchmark::DoNotOptimize(table->update(keys[flow], packets[flow], 64, ts_ns += PACKET_GAP_NS,
+                                               NO_EXPIRY, on_evict));
+        i = (i + 1) & (SEQUENCE - 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["flows"] = static_cast<double>(table->size());
+    state.counters["evicted"] = static_cast<double>(evicted);
+}
+BENCHMARK(BM_FlowUpdate)
+    ->ArgNames({"flows", "zipf"})
+    ->ArgsProduct({{1 << 10, 1 << 16, 150000}, {UNIFORM, ZIPF}});
+
+// ====================================================================
+// B) New flows into a full table (insert + pressure eviction)
+// ====================================================================
+
+static void BM_FlowInsert(benchmark::State& state) {
+    constexpr size_t FRESH = size_t(1) << 22;
+    std::vector<ParsedPacket> packets(FRESH);
+    std::vector<FlowKey> keys(FRESH);
+    for (size_t i = 0; i < FRESH; ++i) {
+        packets[i] = make_packet(i);
+        keys[i] = flow_key_of(packets[i].tuple);
+    }
+
+    auto table = std::make_unique<FlowTable>(FLOW_TABLE_SLOTS);
+    uint64_t ts_ns = 1;
+    uint64_t evicted = 0;
+    auto on_evict = [&evicted](const FlowEntry&) { ++evicted; };
+    size_t i = 0;
+    // Fill it first so every measured insert also evicts.
+    for (; i < table->max_flows(); ++i) {
+        table->update(keys[i], packets[i], 64, ts_ns += PACKET_GAP_NS, NO_EXPIRY, on_evict);
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table->update(keys[i], packets[i], 64, ts_ns += PACKET_GAP_NS,
+                                               NO_EXPIRY, on_evict));
+        i = (i + 1) & (FRESH - 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["evicted"] = static_cast<double>(evicted);
+}
+BENCHMARK(BM_FlowInsert);
+
+// ====================================================================
+// C) Batched path (PacketBatch bursts, as CaptureWorker::process_frames)
+// ====================================================================
+
+// Keys for one full batch of distinct tuples with the given kernel (a
+// kernel the CPU lacks is reported as skipped).
+static void BM_FlowKeys(benchmark::State& state) {
+    const auto kernel = static_cast<FlowKeyKernel>(state.range(0));
+    if (kernel > flow_key_kernel()) {
+        state.SkipWithError("kernel not supported on this CPU");
+        return;
+    }
+    PacketBatch batch;
+    for (size_t i = 0; i < PacketBatch::MAX; ++i) {
+        batch.set_tuple(i, make_packet(i).tuple);
+    }
+    batch.count = PacketBatch::MAX;
+    for (auto _ : state) {
+        flow_keys_batch(batch, kernel);
+        benchmark::DoNotOptimize(batch.keys);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * PacketBatch::MAX);
+    state.SetLabel(flow_key_kernel_name(kernel));
+}
+BENCHMARK(BM_FlowKeys)->ArgName("kernel")->DenseRange(0, 2);
+
+// Hash and account bursts of PacketBatch::MAX packets over uniform flows;
+// with prefetch, every bucket of the burst is prefetched before the first
+// update and each update prefetches the entry four packets ahead.
+static void BM_FlowUpdateBatch(benchmark::State& state) {
+    const size_t flows = static_cast<size_t>(state.range(0));
+    const bool prefetch = state.range(1) != 0;
+    std::vector<FlowTuple> tuples(flows);
+    for (size_t i = 0; i < flows; ++i) {
+        tuples[i] = make_packet(i).tuple;
+    }
+    const auto sequence = make_sequence(flows, UNIFORM, 1);
+
+    auto table = std::make_unique<FlowTable>(FLOW_TABLE_SLOTS);
+    uint64_t ts_ns = 1;
+    uint64_t evicted = 0;
+    auto on_evict = [&evicted](const FlowEntry&) { ++evicted; };
+    for (size_t i = 0; i < flows; ++i) {
+        table->update(flow_key_of(tuples[i]), tuples[i], 0, 64, ts_ns += PACKET_GAP_NS, NO_EXPIRY, on_evict);
+    }
+
+    PacketBatch batch;
+    batch.count = PacketBatch::MAX;
+    size_t next = 0;
+    for (auto _ : state) {
+        for (size_t i = 0; i < PacketBatch::MAX; ++i) {
+            batch.set_tuple(i, tuples[sequence[next]]);
+            next = (next + 1) & (SEQUENCE - 1);
+        }
+        flow_keys_batch(batch);
+        if (prefetch) {
+            for (size_t i = 0; i < PacketBatch::MAX; ++i) {
+                table->prefetch(batch.keys[i]);
+            }
+        }
+        for (size_t i = 0; i < PacketBatch::MAX; ++i) {
+            if (prefetch && i + 4 < PacketBatch::MAX) {
+                table->prefetch_entry(batch.keys[i + 4]);
+            }
+            benchmark::DoNotOptimize(table->update(batch.keys[i], batch.tuples[i], 0, 64,
+                                                   ts_ns += PACKET_GAP_NS, NO_EXPIRY, on_evict));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * PacketBatch::MAX);
+    state.counters["flows"] = static_cast<double>(table->size());
+}
+BENCHMARK(BM_FlowUpdateBatch)
+    ->ArgNames({"flows", "prefetch"})
+    ->ArgsProduct({{1 << 10, 1 << 16, 150000}, {0, 1}});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,355 @@
+// bench/replay_bench.cpp
+//
+// End-to-end capture throughput: a pcap trace replayed through a real
+// CaptureWorker (parse, flow table, record ring, flow export) while this
+// thread drains the rings the way read_batch/read_flows do. BM_PcapReplay
+// loops the trace from memory; BM_PcapFileReplay replays it from a file
+// through the "pcap:" backend at flat-out speed (the PGO training run).
+//
+// The trace is $BENCH_PCAP if set (classic pcap, Ethernet), otherwise a
+// synthetic one: 200K packets over 20K Zipf-distributed flows, 64-1500 bytes.
+//
+// Build (Google Benchmark):
+//   g++ -std=c++17 -O2 -I../src replay_bench.cpp ../src/capture_filter.cpp ../src/capture_worker.cpp
+//       ../src/flow_log.cpp ../src/flow_model.cpp ../src/flow_table.cpp ../src/memory_arena.cpp
+//       ../src/packet_batch.cpp ../src/pcap_backend.cpp ../src/traffic_sketch.cpp -o replay_bench -lbenchmark -lpthread
+//   ./replay_bench --benchmark_format=json
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "capture_backend.h"
+#include "capture_worker.h"
+
+namespace {
+
+// ====================================================================
+// A) Trace
+// ====================================================================
+
+constexpr uint32_t PCAP_MAGIC_US = 0xA1B2C3D4u;
+constexpr uint32_t PCAP_MAGIC_NS = 0xA1B23C4Du;
+constexpr size_t PCAP_FILE_HEADER = 24;
+constexpr size_t PCAP_RECORD_HEADER = 16;
+
+struct TraceFrame {
+    uint32_t offset;   // Of the frame data in Trace::bytes
+    uint32_t caplen;
+    uint32_t len;
+    uint64_t ts_ns;
+};
+
+struct Trace {
+    std::vector<uint8_t> bytes;
+    std::vector<TraceFrame> frames;
+    uint64_t wire_bytes = 0;
+    uint64_t duration_ns = 0;
+};
+
+uint32_t load_le32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+void put_le32(std::vector<uint8_t>& out, uint32_t value) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), p, p + sizeof(value));
+}
+
+// Indexes a little-endian pcap image; false if it is not one.
+bool index_pcap(Trace& trace) {
+    const std::vector<uint8_t>& bytes = trace.bytes;
+    if (bytes.size() < PCAP_FILE_HEADER) {
+        return false;
+    }
+    const uint32_t magic = load_le32(bytes.data());
+    if (magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS) {
+        return false;
+    }
+    const uint64_t frac_ns = magic == PCAP_MAGIC_NS ? 1 : 1000;
+    size_t at = PCAP_FILE_HEADER;
+    while (at + PCAP_RECORD_HEADER <= bytes.size()) {
+        const uint8_t* header = &bytes[at];
+        TraceFrame frame;
+        frame.ts_ns = load_le32(header) * 1000000000ull + load_le32(header + 4) * frac_ns;
+        frame.caplen = load_le32(header + 8);
+        frame.len = load_le32(header + 12);
+        frame.offset = static_cast<uint32_t>(at + PCAP_RECORD_HEADER);
+        if (frame.offset + frame.caplen > bytes.size()) {
+            break;
+        }
+        trace.frames.push_back(frame);
+        trace.wire_bytes += frame.len;
+        at = frame.offset + frame.caplen;
+    }
+    if (trace.frames.empty()) {
+        return false;
+    }
+    trace.duration_ns = trace.frames.back().ts_ns - trace.frames.front().ts_ns + 1;
+    return true;
+}
+
+// A pcap image of Ethernet/IPv4 TCP and UDP packets, 1 us apart.
+std::vector<uint8_t> synthesize_pcap(size_t packets, size_t flows) {
+    std::mt19937_64 rng(42);
+    std::vector<double> cdf(flows);
+    double sum = 0;
+    for (size_t rank = 0; rank < flows; ++rank) {
+        sum += 1.0 / static_cast<double>(rank + 1);
+        cdf[rank] = sum;
+    }
+    std::uniform_real_distribution<double> pick(0, sum);
+    std::uniform_int_distribution<uint32_t> size(64, 1500);
+
+    std::vector<uint8_t> out;
+    put_le32(out, PCAP_MAGIC_NS);
+    put_le32(out, 0x00040002u);    // Version 2.4
+    put_le32(out, 0);              // thiszone
+    put_le32(out, 0);              // sigfigs
+    put_le32(out, 65535);          // snaplen
+    put_le32(out, 1);              // LINKTYPE_ETHERNET
+    uint8_t frame[1500];
+    for (size_t i = 0; i < packets; ++i) {
+        const uint32_t flow = static_cast<uint32_t>(
+            std::lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin());
+        const uint32_t len = size(rng);
+        const bool tcp = flow % 4 != 0;
+        std::memset(frame, 0, 64);
+        frame[12] = 0x08;
+        frame[14] = 0x45;
+        frame[16] = static_cast<uint8_t>((len - 14) >> 8);
+        frame[17] = static_cast<uint8_t>(len - 14);
+        frame[22] = 64;
+        frame[23] = tcp ? IPPROTO_TCP_NUM : IPPROTO_UDP_NUM;
+        frame[26] = 10;
+        frame[27] = static_cast<uint8_t>(flow >> 16);
+        frame[28] = static_cast<uint8_t>(flow >> 8);
+        frame[29] = static_cast<uint8_t>(flow);
+        frame[30] = 192;
+        frame[31] = 168;
+        frame[33] = 1;
+        frame[34] = static_cast<uint8_t>((1024 + flow % 50000) >> 8);
+        frame[35] = static_cast<uint8_t>(1024 + flow % 50000);
+        frame[36] = tcp ? 1 : 0;       // 443 / 53
+        frame[37] = tcp ? 0xBB : 53;
+        if (tcp) {
+            frame[46] = 0x50;          // Data offset
+            frame[47] = 0x18;          // PSH|ACK
+        }
+        const uint64_t ts_ns = 1700000000ull * 1000000000ull + i * 1000;
+        put_le32(out, static_cast<uint32_t>(ts_ns / 1000000000ull));
+        put_le32(out, static_cast<uint32_t>(ts_ns % 1000000000ull));
+        put_le32(out, len);
+        put_le32(out, len);
+        out.insert(out.end(), frame, frame + len);
+    }
+    return out;
+}
+
+const Trace& trace() {
+    static const Trace loaded = [] {
+        Trace trace;
+        if (const char* path = std::getenv("BENCH_PCAP")) {
+            std::ifstream in(path, std::ios::binary);
+            trace.bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            if (!index_pcap(trace)) {
+                std::cerr << "replay_bench: " << path << " is not a little-endian pcap; using a synthetic trace"
+                          << std::endl;
+                trace = Trace();
+            }
+        }
+        if (trace.frames.empty()) {
+            trace.bytes = synthesize_pcap(200000, 20000);
+            index_pcap(trace);
+        }
+        return trace;
+    }();
+    return loaded;
+}
+
+// ====================================================================
+// B) Replay backend
+// ====================================================================
+
+/**
+ * @brief Replays the trace in a loop, as fast as the worker takes it.
+ * Each pass is shifted by the trace's duration so time keeps moving
+ * forward and flows expire the way they would live.
+ */
+class ReplayBackend final : public CaptureBackend {
+public:
+    static constexpr int BURST = 64;
+
+    explicit ReplayBackend(const Trace& trace) : trace_(trace) {}
+
+    const char* name() const override { return "replay"; }
+
+    int open(const std::string&, const CaptureOptions&) override { return 0; }
+
+    int poll(FrameSink& sink, int) override {
+        int delivered = 0;
+        for (; delivered < BURST; ++delivered) {
+            const TraceFrame& frame = trace_.frames[next_];
+            const FrameView view = {&trace_.bytes[frame.offset], frame.caplen, frame.len,
+                                    frame.ts_ns + shift_ns_, 0};
+            sink.on_frame(view);
+            if (++next_ == trace_.frames.size()) {
+                next_ = 0;
+                shift_ns_ += trace_.duration_ns;
+                passes_.fetch_add(1, std::memory_order_release);
+            }
+        }
+        return delivered;
+    }
+
+    void close() override {}
+
+    uint64_t passes() const { return passes_.load(std::memory_order_acquire); }
+
+private:
+    const Trace& trace_;
+    size_t next_ = 0;
+    uint64_t shift_ns_ = 0;
+    std::atomic<uint64_t> passes_{0};
+};
+
+} // namespace
+
+// ====================================================================
+// C) Benchmark: one iteration = one pass over the trace
+// ====================================================================
+
+static void BM_PcapReplay(benchmark::State& state) {
+    const Trace& replayed = trace();
+    EngineControl control;
+    auto backend = std::make_unique<ReplayBackend>(replayed);
+    ReplayBackend* source = backend.get();
+    std::cout.setstate(std::ios::failbit);  // Silence the worker's lifecycle lines
+    auto worker = std::make_shared<CaptureWorker>(0, -1, std::move(backend), "trace", CaptureOptions(),
+                                                  nullptr, control);
+    worker->start(worker).get();
+
+    std::vector<C_PacketData> records(1024);
+    std::vector<ExportedFlow> flows(256);
+    uint64_t read_records = 0;
+    uint64_t read_flows = 0;
+    auto drain = [&] {
+        const size_t r = worker->records().pop_bulk(records.data(), records.size());
+        const size_t f = worker->flows().pop_bulk(flows.data(), flows.size());
+        read_records += r;
+        read_flows += f;
+        if (r == 0 && f == 0) {
+            std::this_thread::yield();
+        }
+    };
+
+    // Warm up the flow table with one full pass.
+    const uint64_t first = source->passes() + 1;
+    while (source->passes() < first) {
+        drain();
+    }
+    C_WorkerStats before{};
+    worker->fill_stats(before);
+
+    for (auto _ : state) {
+        const uint64_t target = source->passes() + 1;
+        while (source->passes() < target) {
+            drain();
+        }
+    }
+
+    C_WorkerStats after{};
+    worker->fill_stats(after);
+    control.stop.store(true, std::memory_order_release);
+    worker->request_exit();
+    worker->wait_exited(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+    worker->join();
+    std::cout.clear();
+
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(replayed.frames.size()));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(replayed.wire_bytes));
+    state.counters["trace_packets"] = static_cast<double>(replayed.frames.size());
+    state.counters["record_ring_drops"] = static_cast<double>(after.record_ring_drops - before.record_ring_drops);
+    state.counters["flows_exported"] = static_cast<double>(read_flows);
+    benchmark::DoNotOptimize(read_records);
+}
+BENCHMARK(BM_PcapReplay)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// ====================================================================
+// D) Benchmark: one iteration = one "pcap:" replay of the trace file
+// ====================================================================
+
+static void BM_PcapFileReplay(benchmark::State& state) {
+    const Trace& replayed = trace();
+    char path[] = "/tmp/replay_bench_XXXXXX";
+    const int fd = mkstemp(path);
+    if (fd < 0 || write(fd, replayed.bytes.data(), replayed.bytes.size()) !=
+                      static_cast<ssize_t>(replayed.bytes.size())) {
+        state.SkipWithError("cannot write the trace file");
+        return;
+    }
+    ::close(fd);
+
+    std::vector<C_PacketData> records(1024);
+    std::vector<ExportedFlow> flows(256);
+    uint64_t ring_drops = 0;
+    uint64_t flow_drops = 0;
+    uint64_t read_flows = 0;
+    std::cout.setstate(std::ios::failbit);
+    for (auto _ : state) {
+        state.PauseTiming();
+        EngineControl control;
+        auto worker = std::make_shared<CaptureWorker>(0, -1, make_pcap_backend(), std::string(path) + "@0",
+                                                      CaptureOptions(), nullptr, control);
+        const bool opened = worker->start(worker).get() == 0;
+        state.ResumeTiming();
+
+        // Replayed, and every flow flushed out by the end-of-file jump.
+        ReplayProgress progress;
+        C_WorkerStats stats{};
+        while (opened && worker->replay_progress(progress)) {
+            worker->records().pop_bulk(records.data(), records.size());
+            read_flows += worker->flows().pop_bulk(flows.data(), flows.size());
+            if (progress.finished_ns != 0) {
+                worker->fill_stats(stats);
+                if (stats.flows_active == 0 && worker->flows().size_approx() == 0) {
+                    break;
+                }
+            }
+        }
+
+        state.PauseTiming();
+        ring_drops += stats.record_ring_drops;
+        flow_drops += stats.flow_ring_drops;
+        control.stop.store(true, std::memory_order_release);
+        worker->request_exit();
+        worker->wait_exited(std::chrono::steady_clock::now() + std::chrono::seconds(5));
+        worker->join();
+        state.ResumeTiming();
+    }
+    std::cout.clear();
+    unlink(path);
+
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(replayed.frames.size()));
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(replayed.wire_bytes));
+    state.counters["trace_packets"] = static_cast<double>(replayed.frames.size());
+    state.counters["record_ring_drops"] = static_cast<double>(ring_drops);
+    state.counters["flows_exported"] = static_cast<double>(read_flows + flow_drops);
+}
+BENCHMARK(BM_PcapFileReplay)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,142 @@
+// bench/ring_buffer_bench.cpp
+//
+// ConcurrentRingBuffer (SPSC) with 64-byte and 1500-byte frames: the cost of
+// a push/pop pair, producer -> consumer throughput across two threads, and
+// one-way hand-off latency (half a ping-pong round trip).
+//
+// Build (Google Benchmark):
+//   g++ -std=c++17 -O2 -I../src ring_buffer_bench.cpp -o ring_buffer_bench -lbenchmark -lpthread
+//   ./ring_buffer_bench --benchmark_format=json
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.h"
+
+namespace {
+
+// A frame-sized ring slot; seq lets the consumer check what it got.
+template <size_t Size>
+struct Frame {
+    uint64_t seq;
+    uint8_t data[Size - sizeof(uint64_t)];
+};
+
+constexpr size_t RING_SLOTS = 4096;
+constexpr size_t POP_BATCH = 64;
+
+// Spins briefly, then gives the CPU away (the two threads may share one).
+inline void backoff(unsigned& spins) {
+    if (++spins > 64) {
+        std::this_thread::yield();
+        spins = 0;
+    }
+}
+
+} // namespace
+
+// ====================================================================
+// A) One thread: push then pop (cache-hot cost of the ring itself)
+// ====================================================================
+
+template <size_t Size>
+static void BM_SpscPushPop(benchmark::State& state) {
+    ConcurrentRingBuffer<Frame<Size>> ring(RING_SLOTS);
+    Frame<Size> in{};
+    Frame<Size> out{};
+    for (auto _ : state) {
+        ++in.seq;
+        ring.push(in);
+        ring.pop(out);
+        benchmark::DoNotOptimize(out.seq);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(Size));
+}
+BENCHMARK_TEMPLATE(BM_SpscPushPop, 64);
+BENCHMARK_TEMPLATE(BM_SpscPushPop, 1500);
+
+// ====================================================================
+// B) Two threads: throughput (producer pushes, consumer pops in bulk)
+// ====================================================================
+
+template <size_t Size>
+static void BM_SpscThroughput(benchmark::State& state) {
+    ConcurrentRingBuffer<Frame<Size>> ring(RING_SLOTS);
+    std::atomic<bool> stop{false};
+    std::thread producer([&] {
+        Frame<Size> frame{};
+        unsigned spins = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (ring.push(frame)) {
+                ++frame.seq;
+            } else {
+                backoff(spins);
+            }
+        }
+    });
+
+    std::vector<Frame<Size>> batch(POP_BATCH);
+    uint64_t items = 0;
+    unsigned spins = 0;
+    for (auto _ : state) {
+        const size_t n = ring.pop_bulk(batch.data(), batch.size());
+        if (n == 0) {
+            backoff(spins);
+        }
+        items += n;
+        benchmark::DoNotOptimize(batch.data());
+    }
+    stop.store(true);
+    producer.join();
+    state.SetItemsProcessed(static_cast<int64_t>(items));
+    state.SetBytesProcessed(static_cast<int64_t>(items * Size));
+}
+BENCHMARK_TEMPLATE(BM_SpscThroughput, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SpscThroughput, 1500)->UseRealTime();
+
+// ====================================================================
+// C) Two threads: latency (one frame in flight, echoed back)
+// ====================================================================
+
+template <size_t Size>
+static void BM_SpscLatency(benchmark::State& state) {
+    ConcurrentRingBuffer<Frame<Size>> ping(RING_SLOTS);
+    ConcurrentRingBuffer<Frame<Size>> pong(RING_SLOTS);
+    std::atomic<bool> stop{false};
+    std::thread echo([&] {
+        Frame<Size> frame;
+        unsigned spins = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (ping.pop(frame)) {
+                pong.push(frame);
+            } else {
+                backoff(spins);
+            }
+        }
+    });
+
+    Frame<Size> frame{};
+    for (auto _ : state) {
+        ++frame.seq;
+        ping.push(frame);
+        unsigned spins = 0;
+        while (!pong.pop(frame)) {
+            backoff(spins);
+        }
+    }
+    stop.store(true);
+    echo.join();
+    // Time per iteration is a round trip; one hand-off (seconds) is half of it.
+    state.counters["one_way"] = benchmark::Counter(
+        static_cast<double>(state.iterations()) * 2, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK_TEMPLATE(BM_SpscLatency, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_SpscLatency, 1500)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,47 @@
+#!/bin/sh
+# Builds and runs every benchmark in this directory and writes one Google
+# Benchmark JSON file per suite to results/<version>/, where <version> is
+# `git describe` (or $BENCH_VERSION). Compare two versions with
+#   python3 compare_results.py results/<old> results/<new>
+#
+# Extra arguments go to every benchmark (e.g. --benchmark_filter=Spsc).
+# With $BENCH_BIN_DIR set (the CMake run_benchmarks target does), the
+# binaries there are run instead of being built here.
+set -e
+
+cd "$(dirname "$0")"
+VERSION=${BENCH_VERSION:-$(git describe --always --dirty 2>/dev/null || echo unversioned)}
+BUILD=${BENCH_BUILD_DIR:-build}
+OUT=results/$VERSION
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:--std=c++17 -O2}
+mkdir -p "$OUT"
+
+build() {
+    name=$1
+    shift
+    # shellcheck disable=SC2086
+    $CXX $CXXFLAGS -I../app -I../src "$name.cpp" "$@" -o "$BUILD/$name" -lbenchmark -lpthread
+}
+
+if [ -n "$BENCH_BIN_DIR" ]; then
+    BUILD=$BENCH_BIN_DIR
+else
+    mkdir -p "$BUILD"
+    build ban_table_bench
+    build ring_buffer_bench
+    build flow_table_bench ../src/flow_table.cpp ../src/memory_arena.cpp ../src/packet_batch.cpp
+    build rule_engine_bench ../app/rule_engine.cpp ../app/lpm_trie.cpp ../app/xdp_offload.cpp
+    build traffic_sketch_bench ../src/traffic_sketch.cpp ../app/enforcer_api.cpp ../app/rule_engine.cpp ../app/lpm_trie.cpp ../app/xdp_offload.cpp
+    build flow_log_bench ../src/flow_log.cpp
+    build flow_model_bench ../src/flow_model.cpp
+    build config_slot_bench ../src/metrics_text.cpp
+    build replay_bench ../src/capture_filter.cpp ../src/capture_worker.cpp ../src/flow_log.cpp ../src/flow_model.cpp ../src/flow_table.cpp ../src/memory_arena.cpp ../src/packet_batch.cpp ../src/pcap_backend.cpp ../src/traffic_sketch.cpp
+fi
+
+for name in ban_table_bench ring_buffer_bench flow_table_bench rule_engine_bench traffic_sketch_bench flow_log_bench flow_model_bench config_slot_bench replay_bench; do
+    echo "== $name"
+    "$BUILD/$name" --benchmark_out="$OUT/$name.json" --benchmark_out_format=json \
+        --benchmark_context=version="$VERSION" "$@"
+done
+echo "Results in $OUT"
@@ -0,0 +1,154 @@
+// bench/traffic_sketch_bench.cpp
+//
+// Per-packet cost of the capture worker's TrafficSketch (Count-Min, top-K
+// and HyperLogLog updates) over uniform and Zipf-distributed sources, and
+// the time from the packet that crosses a threshold to its flow being
+// banned in the rule engine through enforcer_sketch_alert.
+//
+// Build (Google Benchmark):
+//   g++ -std=c++17 -O2 -I../src -I../app traffic_sketch_bench.cpp ../src/traffic_sketch.cpp ../app/enforcer_api.cpp ../app/rule_engine.cpp ../app/lpm_trie.cpp ../app/xdp_offload.cpp -o traffic_sketch_bench -lbenchmark -lpthread
+//   ./traffic_sketch_bench --benchmark_format=json
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "enforcer_api.h"
+#include "rule_engine.h"
+#include "traffic_sketch.h"
+
+namespace {
+
+constexpr size_t SEQUENCE = size_t(1) << 20;  // Packets per pass over a sequence
+constexpr uint64_t PACKET_GAP_NS = 100;
+
+enum Distribution { UNIFORM, ZIPF };
+
+// Source i: 10.x.y.z, with one flow to 192.168.0.(i % 8) port 53.
+FlowTuple make_tuple(uint64_t i) {
+    FlowTuple tuple;
+    std::memset(&tuple, 0, sizeof(tuple));
+    tuple.src_addr[10] = tuple.src_addr[11] = 0xFF;
+    tuple.dst_addr[10] = tuple.dst_addr[11] = 0xFF;
+    tuple.src_addr[12] = 10;
+    tuple.src_addr[13] = static_cast<uint8_t>(i >> 16);
+    tuple.src_addr[14] = static_cast<uint8_t>(i >> 8);
+    tuple.src_addr[15] = static_cast<uint8_t>(i);
+    tuple.dst_addr[12] = 192;
+    tuple.dst_addr[13] = 168;
+    tuple.dst_addr[15] = static_cast<uint8_t>(i % 8);
+    tuple.src_port = static_cast<uint16_t>(1024 + (i >> 24));
+    tuple.dst_port = 53;
+    tuple.protocol = IPPROTO_UDP_NUM;
+    tuple.ip_version = 4;
+    return tuple;
+}
+
+// Source index per packet: uniform, or Zipf(s = 1) over `sources` ranks.
+std::vector<uint32_t> make_sequence(size_t sources, Distribution distribution, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint32_t> sequence(SEQUENCE);
+    if (distribution == UNIFORM) {
+        std::uniform_int_distribution<uint32_t> pick(0, static_cast<uint32_t>(sources - 1));
+        for (uint32_t& source : sequence) {
+            source = pick(rng);
+        }
+        return sequence;
+    }
+    std::vector<double> cdf(sources);
+    double sum = 0.0;
+    for (size_t rank = 0; rank < sources; ++rank) {
+        sum += 1.0 / static_cast<double>(rank + 1);
+        cdf[rank] = sum;
+    }
+    std::uniform_real_distribution<double> pick(0.0, sum);
+    for (uint32_t& source : sequence) {
+        source = static_cast<uint32_t>(std::lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin());
+    }
+    return sequence;
+}
+
+} // namespace
+
+// ====================================================================
+// A) TrafficSketch::add (no threshold reached)
+// ====================================================================
+
+static void BM_SketchAdd(benchmark::State& state) {
+    const size_t sources = static_cast<size_t>(state.range(0));
+    const Distribution distribution = static_cast<Distribution>(state.range(1));
+    std::vector<FlowTuple> tuples(sources);
+    std::vector<FlowKey> keys(sources);
+    for (size_t i = 0; i < sources; ++i) {
+        tuples[i] = make_tuple(i);
+        keys[i] = flow_key_of(tuples[i]);
+    }
+    const std::vector<uint32_t> sequence = make_sequence(sources, distribution, 42);
+
+    std::unique_ptr<TrafficSketch> sketch(new TrafficSketch);
+    SketchSettings settings;
+    settings.window_ns = ~0ull >> 2;  // One window for the whole run
+    settings.src_packets = ~0ull >> 2;
+    settings.dst_packets = ~0ull >> 2;
+    settings.dst_sources = ~0ull >> 2;
+    uint64_t alerts = 0;
+    uint64_t ts_ns = 1;
+    size_t next = 0;
+    for (auto _ : state) {
+        const uint32_t source = sequence[next];
+        uint8_t marks = 0;
+        alerts += sketch->add(tuples[source], keys[source], 64, ts_ns, &marks, settings,
+                              [](C_SketchAlert) {});
+        ts_ns += PACKET_GAP_NS;
+        next = (next + 1) & (SEQUENCE - 1);
+    }
+    benchmark::DoNotOptimize(alerts);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_SketchAdd)
+    ->ArgNames({"sources", "zipf"})
+    ->Args({1 << 10, UNIFORM})
+    ->Args({1 << 20, UNIFORM})
+    ->Args({1 << 20, ZIPF});
+
+// ====================================================================
+// B) Threshold crossing -> flow banned (add + enforcer_sketch_alert)
+// ====================================================================
+
+// Every packet is a new flow of a source over the threshold, so each one
+// raises an enforcement alert the rule engine applies before add() returns.
+static void BM_AlertToBan(benchmark::State& state) {
+    constexpr size_t FLOWS = size_t(1) << 16;
+    std::vector<FlowTuple> tuples(FLOWS);
+    std::vector<FlowKey> keys(FLOWS);
+    for (size_t i = 0; i < FLOWS; ++i) {
+        tuples[i] = make_tuple(1);
+        tuples[i].src_port = static_cast<uint16_t>(i);
+        keys[i] = flow_key_of(tuples[i]);
+    }
+
+    CompiledRuleEngine engine;
+    std::unique_ptr<TrafficSketch> sketch(new TrafficSketch);
+    SketchSettings settings;
+    settings.window_ns = ~0ull >> 2;
+    settings.src_packets = 1;
+    settings.flags = SNIFFER_SKETCH_ENFORCE_SRC;
+    settings.action = static_cast<uint8_t>(FirewallAction::DROP);
+    uint64_t ts_ns = 1;
+    size_t next = 0;
+    for (auto _ : state) {
+        uint8_t marks = 0;
+        sketch->add(tuples[next], keys[next], 64, ts_ns, &marks, settings,
+                    [&engine](C_SketchAlert alert) { enforcer_sketch_alert(&alert, &engine); });
+        ts_ns += PACKET_GAP_NS;
+        next = (next + 1) & (FLOWS - 1);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_AlertToBan);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,63 @@
+#!/bin/sh
+# Builds the production libsniffer.so / libenforcer.so two ways, a Release
+# build (-O3, -march, LTO) and the same plus PGO trained on the pcap replay
+# benchmark, measures both on BM_PcapFileReplay and copies the faster one's
+# libraries to $DIST_DIR (default build/dist). Install those, not an ad-hoc
+# build.
+#
+# Environment: BUILD_ROOT (default build), DIST_DIR, SNIFFER_MARCH (default
+# native; set e.g. x86-64-v3 for images that run on other hosts), JOBS.
+set -e
+
+cd "$(dirname "$0")"
+mkdir -p "${BUILD_ROOT:-build}"
+ROOT=$(cd "${BUILD_ROOT:-build}" && pwd)
+DIST=${DIST_DIR:-$ROOT/dist}
+MARCH=${SNIFFER_MARCH:-native}
+JOBS=${JOBS:-$(nproc)}
+PROFILE=$ROOT/pgo-profile
+
+configure() {
+    dir=$1
+    shift
+    cmake -S . -B "$dir" -DCMAKE_BUILD_TYPE=Release -DSNIFFER_MARCH="$MARCH" -DSNIFFER_PGO_DIR="$PROFILE" "$@"
+}
+
+# Aggregate items_per_second of the file replay (median of 5 runs).
+measure() {
+    "$1/bench/replay_bench" --benchmark_filter=BM_PcapFileReplay --benchmark_repetitions=5 \
+        --benchmark_report_aggregates_only=true --benchmark_format=json 2>/dev/null |
+        python3 -c 'import json, sys
+runs = json.load(sys.stdin)["benchmarks"]
+print(next(r["items_per_second"] for r in runs if r.get("aggregate_name") == "median"))'
+}
+
+echo "== Release"
+configure "$ROOT/release" -DSNIFFER_PGO=OFF
+cmake --build "$ROOT/release" -j"$JOBS"
+
+echo "== PGO: instrumented build and training run"
+rm -rf "$PROFILE"
+configure "$ROOT/pgo-generate" -DSNIFFER_PGO=GENERATE
+cmake --build "$ROOT/pgo-generate" -j"$JOBS"
+cmake --build "$ROOT/pgo-generate" --target pgo-train
+if command -v llvm-profdata >/dev/null 2>&1 && ls "$PROFILE"/*.profraw >/dev/null 2>&1; then
+    llvm-profdata merge -o "$PROFILE/default.profdata" "$PROFILE"/*.profraw
+fi
+
+echo "== PGO: optimized build"
+configure "$ROOT/pgo" -DSNIFFER_PGO=USE
+cmake --build "$ROOT/pgo" -j"$JOBS"
+
+release_pps=$(measure "$ROOT/release")
+pgo_pps=$(measure "$ROOT/pgo")
+echo "Release: $release_pps pps, PGO: $pgo_pps pps"
+if python3 -c "import sys; sys.exit(0 if $pgo_pps > $release_pps else 1)"; then
+    winner=pgo
+else
+    winner=release
+fi
+
+mkdir -p "$DIST"
+cp "$ROOT/$winner/libsniffer.so" "$ROOT/$winner/libenforcer.so" "$DIST/"
+echo "Shipping the $winner build: $DIST/libsniffer.so, $DIST/libenforcer.so"
@@ -0,0 +1,252 @@
+// src/af_packet_backend.cpp
+//
+// AF_PACKET capture using a memory-mapped TPACKET_V3 block ring.
+// The kernel fills whole blocks of frames and flips the block status;
+// we walk every frame of a block in place, stage its captured bytes in the
+// capture ring and hand the block back, so there is no per-packet syscall.
+
+#include "capture_backend.h"
+
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+class AfPacketBackend : public CaptureBackend {
+public:
+    // Ring geometry: 64 blocks of 1 MB. A block is retired to user space
+    // when it is full or after BLOCK_TIMEOUT_MS, whichever comes first.
+    static constexpr unsigned BLOCK_SIZE = 1u << 20;
+    static constexpr unsigned BLOCK_COUNT = 64;
+    static constexpr unsigned FRAME_SIZE = 2048;
+    static constexpr unsigned BLOCK_TIMEOUT_MS = 10;
+
+    ~AfPacketBackend() override { close(); }
+
+    const char* name() const override { return "afpacket"; }
+
+    int open(const std::string& source, const CaptureOptions& options) override {
+        unsigned ifindex = if_nametoindex(source.c_str());
+        if (ifindex == 0) {
+            return fail("if_nametoindex", errno);
+        }
+
+        fd_ = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+        if (fd_ < 0) {
+            return fail("socket", errno);
+        }
+
+        // Before the ring and the bind, so no unfiltered frame gets queued.
+        if (options.filter && options.filter->has_bpf()) {
+            if (!attach_filter(*options.filter)) {
+                return fail("SO_ATTACH_FILTER", errno);
+            }
+            kernel_filter_ = true;
+        }
+
+        int version = TPACKET_V3;
+        if (setsockopt(fd_, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+            return fail("PACKET_VERSION", errno);
+        }
+
+        tpacket_req3 req{};
+        req.tp_block_size = BLOCK_SIZE;
+        req.tp_block_nr = BLOCK_COUNT;
+        req.tp_frame_size = FRAME_SIZE;
+        req.tp_frame_nr = (BLOCK_SIZE / FRAME_SIZE) * BLOCK_COUNT;
+        req.tp_retire_blk_tov = BLOCK_TIMEOUT_MS;
+        req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+        if (setsockopt(fd_, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+            return fail("PACKET_RX_RING", errno);
+        }
+
+        map_size_ = static_cast<size_t>(BLOCK_SIZE) * BLOCK_COUNT;
+        void* map = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd_, 0);
+        if (map == MAP_FAILED) {
+            map_size_ = 0;
+            return fail("mmap", errno);
+        }
+        map_ = static_cast<uint8_t*>(map);
+
+        sockaddr_ll addr{};
+        addr.sll_family = AF_PACKET;
+        addr.sll_protocol = htons(ETH_P_ALL);
+        addr.sll_ifindex = static_cast<int>(ifindex);
+        if (bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            return fail("bind", errno);
+        }
+
+        // Several workers: join one fanout group so the kernel spreads packets
+        // across our sockets, keeping every flow on the same socket.
+        if (options.queue_count > 1) {
+            int fanout = options.fanout_group | (fanout_type(options.fanout_mode) << 16);
+            if (setsockopt(fd_, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) < 0) {
+                return fail("PACKET_FANOUT", errno);
+            }
+        }
+
+        current_block_ = 0;
+        return 0;
+    }
+
+    int poll(FrameSink& sink, int timeout_ms) override {
+        tpacket_block_desc* block = block_at(current_block_);
+
+        if (!block_ready(block)) {
+            pollfd pfd{fd_, POLLIN | POLLERR, 0};
+            int rc = ::poll(&pfd, 1, timeout_ms);
+            if (rc < 0) {
+                return errno == EINTR ? 0 : -1;
+            }
+            if (pfd.revents & POLLERR) {
+                return -1;
+            }
+            if (!block_ready(block)) {
+                return 0;
+            }
+        }
+
+        return consume_block(block, sink);
+    }
+
+    int drain(FrameSink& sink) override {
+        tpacket_block_desc* block = block_at(current_block_);
+        return block_ready(block) ? consume_block(block, sink) : 0;
+    }
+
+    uint64_t take_drops() override {
+        // The kernel resets its counters on every read.
+        tpacket_stats_v3 stats{};
+        socklen_t len = sizeof(stats);
+        if (fd_ < 0 || getsockopt(fd_, SOL_PACKET, PACKET_STATISTICS, &stats, &len) < 0) {
+            return 0;
+        }
+        return stats.tp_drops;
+    }
+
+    bool filters_in_kernel() const override { return kernel_filter_; }
+
+    bool set_filter(const CaptureFilter* filter) override {
+        if (fd_ < 0) {
+            return false;
+        }
+        // SO_ATTACH_FILTER swaps the program atomically for the socket, so
+        // no frame is filtered by neither; a failed swap falls back to the
+        // worker, without the old program left in place.
+        if (filter != nullptr && filter->has_bpf() && attach_filter(*filter)) {
+            kernel_filter_ = true;
+            return true;
+        }
+        if (filter != nullptr && filter->has_bpf()) {
+            std::cerr << "[C++ AF_PACKET ERROR] SO_ATTACH_FILTER failed: " << std::strerror(errno)
+                      << "; the worker filters instead." << std::endl;
+        }
+        if (kernel_filter_) {
+            int unused = 0;
+            setsockopt(fd_, SOL_SOCKET, SO_DETACH_FILTER, &unused, sizeof(unused));
+            kernel_filter_ = false;
+        }
+        return false;
+    }
+
+    void close() override {
+        if (map_) {
+            munmap(map_, map_size_);
+            map_ = nullptr;
+            map_size_ = 0;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+private:
+    tpacket_block_desc* block_at(unsigned index) const {
+        return reinterpret_cast<tpacket_block_desc*>(map_ + static_cast<size_t>(index) * BLOCK_SIZE);
+    }
+
+    static int fanout_type(uint32_t mode) {
+        switch (mode) {
+            case SNIFFER_FANOUT_CPU:
+                return PACKET_FANOUT_CPU;
+            case SNIFFER_FANOUT_QM:
+                // By NIC RX queue: pairs with RSS and IRQ affinity set to the worker CPUs.
+                return PACKET_FANOUT_QM;
+            default:
+                // By flow hash; defragment first so fragments follow their flow.
+                return PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+        }
+    }
+
+    int consume_block(tpacket_block_desc* block, FrameSink& sink) {
+        const int delivered = walk_block(block, sink);
+
+        // Hand the block back to the kernel only after we are done with it.
+        __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        current_block_ = (current_block_ + 1) % BLOCK_COUNT;
+        return delivered;
+    }
+
+    static bool block_ready(const tpacket_block_desc* block) {
+        // Acquire: frame contents must not be read before the status flip is observed.
+        return (__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) != 0;
+    }
+
+    static int walk_block(tpacket_block_desc* block, FrameSink& sink) {
+        const uint32_t count = block->hdr.bh1.num_pkts;
+        auto* hdr = reinterpret_cast<tpacket3_hdr*>(
+            reinterpret_cast<uint8_t*>(block) + block->hdr.bh1.offset_to_first_pkt);
+
+        for (uint32_t i = 0; i < count; ++i) {
+            FrameView frame;
+            frame.data = reinterpret_cast<const uint8_t*>(hdr) + hdr->tp_mac;
+            frame.caplen = hdr->tp_snaplen;
+            frame.len = hdr->tp_len;
+            frame.ts_ns = static_cast<uint64_t>(hdr->tp_sec) * 1000000000ull + hdr->tp_nsec;
+            frame.rxhash = hdr->hv1.tp_rxhash;
+            // Copies caplen bytes into the capture ring so the block can go back right away.
+            sink.on_frame(frame);
+
+            hdr = reinterpret_cast<tpacket3_hdr*>(reinterpret_cast<uint8_t*>(hdr) + hdr->tp_next_offset);
+        }
+        return static_cast<int>(count);
+    }
+
+    bool attach_filter(const CaptureFilter& filter) {
+        sock_fprog program{};
+        program.len = static_cast<unsigned short>(filter.bpf().size());
+        program.filter = reinterpret_cast<sock_filter*>(const_cast<C_BpfInsn*>(filter.bpf().data()));
+        return setsockopt(fd_, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program)) == 0;
+    }
+
+    int fail(const char* step, int err) {
+        std::cerr << "[C++ AF_PACKET ERROR] " << step << " failed: " << std::strerror(err) << std::endl;
+        close();
+        return -err;
+    }
+
+    int fd_ = -1;
+    uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+    unsigned current_block_ = 0;
+    bool kernel_filter_ = false;  // A BPF program (options.filter's, or set_filter()'s) is attached to fd_
+};
+
+} // namespace
+
+std::unique_ptr<CaptureBackend> make_af_packet_backend() {
+    return std::unique_ptr<CaptureBackend>(new AfPacketBackend());
+}
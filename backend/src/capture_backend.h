@@ -0,0 +1,207 @@
+#ifndef CAPTURE_BACKEND_H
+#define CAPTURE_BACKEND_H
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "capture_filter.h"
+#include "sniffer_engine.h"
+
+// ====================================================================
+// A) Frame hand-off between a capture backend and the engine
+// ====================================================================
+
+/**
+ * @brief A frame that lives outside the engine's rings.
+ * For AF_PACKET it points straight into the kernel's mmap'd block and is
+ * only valid for the duration of the FrameSink::on_frame() call.
+ */
+struct FrameView {
+    const uint8_t* data;
+    uint32_t caplen;   // Bytes available at data
+    uint32_t len;      // Original length on the wire
+    uint64_t ts_ns;    // Capture timestamp, nanoseconds since the epoch
+    uint32_t rxhash;   // Kernel/NIC flow hash (0 if the source has none)
+};
+
+/**
+ * @brief Where a backend puts the frames it produces during poll().
+ * Frames go straight into slots of the capture ring: sources that build
+ * frames themselves fill a claimed slot in place, sources whose frames live
+ * elsewhere copy exactly caplen bytes with on_frame(). A full ring drops the
+ * frame (the ring counts it).
+ */
+class FrameSink {
+public:
+    explicit FrameSink(ConcurrentRingBuffer<CapturedPacket>& ring) : ring_(ring) {}
+
+    /**
+     * @brief Next free slot to build a frame in, or nullptr if the ring is full.
+     */
+    CapturedPacket* claim() { return ring_.claim(); }
+
+    /**
+     * @brief Adds the claimed slot; it is published at the end of the poll.
+     */
+    void commit() { ring_.commit(); }
+
+    /**
+     * @brief Copies a frame into the next slot (caplen bytes of data only).
+     * @return false if the ring was full and the frame was dropped.
+     */
+    bool on_frame(const FrameView& frame) {
+        CapturedPacket* slot = ring_.claim();
+        if (slot == nullptr) {
+            return false;
+        }
+        const uint32_t caplen = frame.caplen < CapturedPacket::MAX_SNAPLEN
+                                    ? frame.caplen : CapturedPacket::MAX_SNAPLEN;
+        slot->header.caplen = caplen;
+        slot->header.len = frame.len;
+        slot->header.ts_sec = static_cast<uint32_t>(frame.ts_ns / 1000000000ull);
+        slot->header.ts_nsec = static_cast<uint32_t>(frame.ts_ns % 1000000000ull);
+        slot->rxhash = frame.rxhash;
+        slot->flags = 0;
+        std::memcpy(slot->data, frame.data, caplen);
+        ring_.commit();
+        return true;
+    }
+
+private:
+    ConcurrentRingBuffer<CapturedPacket>& ring_;
+};
+
+
+// ====================================================================
+// B) Capture backend interface
+// ====================================================================
+
+/**
+ * @brief Per-worker settings a backend needs to share one source between
+ * several capture workers (AF_PACKET fanout, simulator flow partitioning).
+ */
+struct CaptureOptions {
+    unsigned queue_index = 0;   // This worker
+    unsigned queue_count = 1;   // Workers sharing the source
+    uint16_t fanout_group = 0;  // AF_PACKET fanout group id (all workers use the same one)
+    uint32_t fanout_mode = 0;   // SNIFFER_FANOUT_*
+    std::shared_ptr<const CaptureFilter> filter;  // Shedding at open (later: set_filter()), or null
+    size_t flow_table_slots = FLOW_TABLE_SLOTS;    // Worker's flow table index (from the memory budget)
+};
+
+/**
+ * @brief How far a finite source (file replay) has got. Written by the
+ * capture thread, readable from any thread.
+ */
+struct ReplayProgress {
+    uint64_t frames = 0;       // Frames handed to the engine
+    uint64_t bytes = 0;        // ... their length on the wire
+    uint64_t skipped = 0;      // Records of a link type the engine cannot parse
+    uint64_t file_bytes = 0;   // Size of the file
+    uint64_t file_offset = 0;  // Bytes of it consumed so far
+    uint64_t started_ns = 0;   // Wall clock when the first frame went out (0 = not yet)
+    uint64_t finished_ns = 0;  // Wall clock at the end of the file (0 = still replaying)
+    double speed = 1.0;        // Multiple of the recorded rate; 0 = as fast as the engine takes it
+};
+
+/**
+ * @brief Abstract packet source driven by one capture worker thread.
+ * open(), poll() and close() all run on that thread; start_capture_engine
+ * waits for open() so errors are still reported synchronously.
+ */
+class CaptureBackend {
+public:
+    virtual ~CaptureBackend() = default;
+
+    /**
+     * @brief Short backend name used in log lines ("afpacket", "sim", ...).
+     */
+    virtual const char* name() const = 0;
+
+    /**
+     * @brief Opens the source (interface name, file path, rate, ...).
+     * Called on the (already pinned) capture thread, so kernel and user
+     * buffers are allocated on that thread's NUMA node.
+     * @return 0 on success, a negative errno value on failure.
+     */
+    virtual int open(const std::string& source, const CaptureOptions& options) = 0;
+
+    /**
+     * @brief Delivers the next batch of ready frames (at most one kernel
+     * block, or one burst), waiting at most timeout_ms for it. The caller
+     * drains the ring between polls.
+     * @return Number of frames delivered, or -1 on a fatal error.
+     */
+    virtual int poll(FrameSink& sink, int timeout_ms) = 0;
+
+    /**
+     * @brief After a stop: delivers one more batch the source has already
+     * captured, without waiting. Called until it returns 0, so sources that
+     * generate frames on demand keep the default.
+     * @return Number of frames delivered.
+     */
+    virtual int drain(FrameSink& sink) {
+        (void)sink;
+        return 0;
+    }
+
+    /**
+     * @brief Frames the source itself dropped since the last call (e.g. a
+     * full kernel ring). Called on the capture thread every few polls.
+     */
+    virtual uint64_t take_drops() { return 0; }
+
+    /**
+     * @brief True if open() attached CaptureOptions::filter's BPF program
+     * to the source, so the worker does not run it again.
+     */
+    virtual bool filters_in_kernel() const { return false; }
+
+    /**
+     * @brief Replaces the BPF program the source runs on a live capture
+     * (from the capture thread, after a reload); null or a filter without
+     * one detaches it.
+     * @return true if the source now runs filter's program, false if the
+     * worker has to (nothing stays attached then).
+     */
+    virtual bool set_filter(const CaptureFilter* filter) {
+        (void)filter;
+        return false;
+    }
+
+    /**
+     * @brief The source's notion of "now" for flow expiry, given the wall
+     * clock. Live sources are the wall clock; a replay runs on the trace's
+     * own timeline.
+     */
+    virtual uint64_t clock_ns(uint64_t wall_ns) const { return wall_ns; }
+
+    /**
+     * @brief Fills *progress for a finite source. Called from any thread.
+     * @return false for live sources.
+     */
+    virtual bool replay_progress(ReplayProgress& progress) const {
+        (void)progress;
+        return false;
+    }
+
+    virtual void close() = 0;
+};
+
+/**
+ * @brief Creates the backend named by a "backend:source" spec.
+ * A spec without a known prefix is treated as an AF_PACKET interface name.
+ * @param spec The string passed to start_capture_engine.
+ * @param source Receives the part of the spec handed to open().
+ * @return The backend, or nullptr if the backend name is unknown.
+ */
+std::unique_ptr<CaptureBackend> make_capture_backend(const std::string& spec,
+                                                     std::string& source);
+
+std::unique_ptr<CaptureBackend> make_af_packet_backend();
+std::unique_ptr<CaptureBackend> make_simulator_backend();
+std::unique_ptr<CaptureBackend> make_pcap_backend();
+
+#endif // CAPTURE_BACKEND_H
@@ -0,0 +1,485 @@
+// src/capture_engine.cpp
+
+#include "capture_engine.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+
+namespace {
+
+std::chrono::steady_clock::time_point deadline_after(uint32_t timeout_ms) {
+    return std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+}
+
+unsigned queue_count(const C_CaptureConfig& config) {
+    return config.queues == 0 ? 1 : config.queues;
+}
+
+} // namespace
+
+// =================================================================
+// A) START
+// =================================================================
+
+int CaptureEngine::start(const char* spec, C_PacketData* buffer, const C_CaptureConfig& config, bool* warm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (warm) {
+        *warm = false;
+    }
+
+    for (const auto& worker : workers_) {
+        if (worker->running()) {
+            std::cerr << "[C++ Engine ERROR] Capture already running." << std::endl;
+            return 1; // Already running (or a previous run is still draining)
+        }
+    }
+
+    if (can_resume(spec, buffer, config)) {
+        const int rc = resume(config);
+        if (warm) {
+            *warm = rc == 0;
+        }
+        return rc;
+    }
+
+    // Whatever is left of the previous run (parked or exited) goes first.
+    if (!workers_.empty() && shutdown(deadline_after(DEFAULT_STOP_TIMEOUT_MS)) != 0) {
+        std::cerr << "[C++ Engine ERROR] Previous capture did not shut down." << std::endl;
+        return 1;
+    }
+    return cold_start(spec, buffer, config);
+}
+
+bool CaptureEngine::can_resume(const std::string& spec, C_PacketData* buffer, const C_CaptureConfig& config) const {
+    const unsigned queues = queue_count(config);
+    if (spec != spec_ || buffer != buffer_ || queues != queue_count(config_) ||
+        config.fanout_mode != config_.fanout_mode || config.memory_budget_mb != config_.memory_budget_mb ||
+        workers_.size() != queues) {
+        return false;
+    }
+    return std::equal(config.cpus, config.cpus + queues, config_.cpus) &&
+           flow_log_ == started_flow_log_ && parked();
+}
+
+bool CaptureEngine::parked() const {
+    return !workers_.empty() &&
+           std::all_of(workers_.begin(), workers_.end(),
+                       [](const auto& worker) { return worker->phase() == CaptureWorker::PARKED; });
+}
+
+void CaptureEngine::apply_timeouts(const C_CaptureConfig& config) {
+    update_dataplane([&config](DataplaneConfig& dataplane) {
+        dataplane.flow_timeouts.active_ns = config.flow_active_timeout_ms * 1000000ull;
+        dataplane.flow_timeouts.idle_ns = config.flow_idle_timeout_ms * 1000000ull;
+        dataplane.flow_timeouts.close_ns = config.flow_close_timeout_ms * 1000000ull;
+    });
+}
+
+/**
+ * Warm restart: the parked workers go back to their open sources and rings.
+ * Nothing is allocated or opened, so this cannot fail.
+ */
+int CaptureEngine::resume(const C_CaptureConfig& config) {
+    apply_timeouts(config);
+    config_ = config;
+    control_.keep_warm.store(false, std::memory_order_relaxed);
+    control_.stop.store(false, std::memory_order_release);
+    for (auto& worker : workers_) {
+        worker->resume();
+    }
+    std::cout << "[C++ Engine] Resumed capture on " << workers_.size() << " queue(s) (warm)." << std::endl;
+    return 0;
+}
+
+int CaptureEngine::cold_start(const std::string& spec, C_PacketData* buffer, const C_CaptureConfig& config) {
+    const unsigned queues = queue_count(config);
+
+    // Reset state
+    control_.stop.store(false, std::memory_order_relaxed);
+    control_.keep_warm.store(false, std::memory_order_relaxed);
+    apply_timeouts(config);
+    workers_.clear();
+    publish_workers();
+    if (prepare_shared_ring(queues) != 0) {
+        return 5; // Shared ring could not be created
+    }
+    std::vector<FlowLogLanes> log_lanes;
+    if (open_flow_log(queues, log_lanes) != 0) {
+        return 7; // Flow log could not be opened
+    }
+    spec_ = spec;
+    buffer_ = buffer;
+    config_ = config;
+
+    // One fanout group per engine instance; every worker joins the same one.
+    CaptureOptions options;
+    options.queue_count = queues;
+    options.fanout_group = static_cast<uint16_t>(getpid() & 0xFFFF);
+    options.fanout_mode = config.fanout_mode;
+    options.filter = filter();
+    options.flow_table_slots = config.memory_budget_mb != 0
+                                   ? CaptureWorker::flow_table_slots_for(uint64_t(config.memory_budget_mb) << 20)
+                                   : FLOW_TABLE_SLOTS;
+
+    std::vector<std::future<int>> opened;
+    try {
+        start_alert_dispatch();
+        for (unsigned i = 0; i < queues; ++i) {
+            std::string source;
+            std::unique_ptr<CaptureBackend> backend = make_capture_backend(spec, source);
+            options.queue_index = i;
+            // Worker 0 writes into the caller's buffer; the others own node-local rings.
+            SharedRingWriter shared_lane = shared_ring_ ? SharedRingWriter(*shared_ring_, i) : SharedRingWriter();
+            auto worker = std::make_shared<CaptureWorker>(i, config.cpus[i], std::move(backend), source,
+                                                          options, i == 0 ? buffer : nullptr, control_,
+                                                          shared_lane, std::move(log_lanes[i]));
+            opened.push_back(worker->start(worker));
+            workers_.push_back(worker);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[C++ Engine ERROR] Failed to create thread: " << e.what() << std::endl;
+        publish_workers();
+        shutdown(deadline_after(DEFAULT_STOP_TIMEOUT_MS));
+        return 2; // Thread creation failed
+    }
+    publish_workers();
+
+    // Each worker opens its backend on its own (pinned) thread; wait for all of
+    // them so a bad interface is still reported to the caller.
+    int result = 0;
+    for (size_t i = 0; i < opened.size(); ++i) {
+        const int rc = opened[i].get();
+        if (rc == CaptureWorker::NO_MEMORY) {
+            result = 6; // Memory budget could not be reserved
+        } else if (rc != 0) {
+            std::cerr << "[C++ Engine ERROR] Could not open " << workers_[i]->backend_name()
+                      << " source for queue " << i << " ('" << spec << "')." << std::endl;
+            result = result != 0 ? result : 3; // Backend failed to open
+        }
+    }
+    if (result != 0) {
+        shutdown(deadline_after(DEFAULT_STOP_TIMEOUT_MS));
+        return result;
+    }
+
+    // The threads run the capture loops in the background.
+    // The C++ engine is NON-BLOCKING to the Python caller.
+    std::cout << "[C++ Engine] Started NON-BLOCKING capture loop on " << queues << " queue(s)." << std::endl;
+    return 0;
+}
+
+/**
+ * Keeps the segment when its settings still match (consumers stay attached
+ * and the writers continue where the last run stopped); otherwise replaces it.
+ */
+int CaptureEngine::prepare_shared_ring(unsigned queues) {
+    if (shared_name_.empty()) {
+        shared_ring_.reset();
+        return 0;
+    }
+    if (shared_ring_ && shared_ring_->matches(shared_name_, queues, shared_slots_, shared_flags_)) {
+        return 0;
+    }
+    shared_ring_.reset();
+    return SharedRingSegment::create(shared_name_, queues, shared_slots_, shared_flags_, shared_ring_);
+}
+
+/**
+ * Each worker gets fresh segments in its own streams; the control plane's
+ * decisions stream is reopened too, so every stream restarts on one boundary.
+ */
+int CaptureEngine::open_flow_log(unsigned queues, std::vector<FlowLogLanes>& lanes) {
+    started_flow_log_ = flow_log_;
+    lanes.clear();
+    lanes.resize(queues);
+    {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        control_log_.reset();
+        if (!flow_log_.enabled()) {
+            return 0;
+        }
+        if ((flow_log_.streams & SNIFFER_LOG_DECISIONS) != 0) {
+            control_log_.reset(new FlowLogWriter(flow_log_, SNIFFER_LOG_DECISIONS, SNIFFER_LOG_CONTROL_LANE));
+            if (control_log_->open() != 0) {
+                control_log_.reset();
+                return -1;
+            }
+        }
+    }
+    for (unsigned i = 0; i < queues; ++i) {
+        for (uint32_t kind : {SNIFFER_LOG_FLOWS, SNIFFER_LOG_DECISIONS}) {
+            if ((flow_log_.streams & kind) == 0) {
+                continue;
+            }
+            std::unique_ptr<FlowLogWriter> writer(new FlowLogWriter(flow_log_, kind, i));
+            if (writer->open() != 0) {
+                lanes.clear();
+                return -1;
+            }
+            (kind == SNIFFER_LOG_FLOWS ? lanes[i].flows : lanes[i].decisions) = std::move(writer);
+        }
+    }
+    return 0;
+}
+
+// =================================================================
+// B) STOP
+// =================================================================
+
+int CaptureEngine::stop(uint32_t timeout_ms, bool keep_warm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto deadline = deadline_after(timeout_ms);
+
+    if (!keep_warm) {
+        return shutdown(deadline);
+    }
+    if (parked()) {
+        return 0;
+    }
+
+    // One store reaches every capture loop; none of them waits on it.
+    control_.keep_warm.store(true, std::memory_order_relaxed);
+    control_.stop.store(true, std::memory_order_release);
+    if (!wait_stopped(deadline)) {
+        std::cerr << "[C++ Engine ERROR] Capture still draining after " << timeout_ms << " ms." << std::endl;
+        return -1;
+    }
+
+    // A worker whose source failed exits rather than parks; then a warm
+    // restart is impossible and the rest are shut down too.
+    if (!parked()) {
+        return shutdown(deadline);
+    }
+    std::cout << "[C++ Engine] Capture parked (warm)." << std::endl;
+    return 0;
+}
+
+/**
+ * Stops every worker for good: they drain, close their sources and exit,
+ * and their threads are joined. The workers (and their rings) stay until
+ * the next cold start so readers can collect what was drained.
+ */
+int CaptureEngine::shutdown(std::chrono::steady_clock::time_point deadline) {
+    control_.keep_warm.store(false, std::memory_order_relaxed);
+    control_.stop.store(true, std::memory_order_release);
+
+    int result = 0;
+    for (auto& worker : workers_) {
+        worker->request_exit();
+        if (!worker->wait_exited(deadline)) {
+            result = -1;
+            continue;
+        }
+        worker->join();
+    }
+    if (result != 0) {
+        std::cerr << "[C++ Engine ERROR] Capture threads did not exit in time." << std::endl;
+        return result;   // The dispatcher keeps draining what is left running
+    }
+    stop_alert_dispatch();
+    return 0;
+}
+
+bool CaptureEngine::wait_stopped(std::chrono::steady_clock::time_point deadline) {
+    bool stopped = true;
+    for (auto& worker : workers_) {
+        stopped = worker->wait_stopped(deadline) && stopped;
+    }
+    return stopped;
+}
+
+int CaptureEngine::state() const {
+    return state(workers());
+}
+
+// From the published list, so it never waits for a start or stop in progress.
+int CaptureEngine::state(const WorkerSnapshot& workers) const {
+    const bool running = std::any_of(workers.begin(), workers.end(),
+                                     [](const auto& worker) { return worker->running(); });
+    if (running) {
+        return control_.stop.load(std::memory_order_acquire) ? SNIFFER_STATE_STOPPING : SNIFFER_STATE_RUNNING;
+    }
+    const bool parked = !workers.empty() && std::all_of(workers.begin(), workers.end(), [](const auto& worker) {
+        return worker->phase() == CaptureWorker::PARKED;
+    });
+    return parked ? SNIFFER_STATE_PARKED : SNIFFER_STATE_STOPPED;
+}
+
+WorkerSnapshot CaptureEngine::workers() const {
+    static const std::shared_ptr<const WorkerSnapshot::List> none = std::make_shared<const WorkerSnapshot::List>();
+    std::shared_ptr<const WorkerSnapshot::List> list = published_workers_.get(nullptr);
+    return WorkerSnapshot(list ? std::move(list) : none);
+}
+
+// Hands the readers a copy of workers_ (under mutex_). The list it replaces
+// goes when its last reader lets go, and its workers with it.
+void CaptureEngine::publish_workers() {
+    published_workers_.set(std::make_shared<const WorkerSnapshot::List>(workers_));
+}
+
+// =================================================================
+// C) SHARED RING
+// =================================================================
+
+void CaptureEngine::set_shared_ring(const std::string& name, uint32_t slots, uint32_t flags) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shared_name_ = slots == 0 ? std::string() : name;
+    shared_slots_ = slots;
+    shared_flags_ = flags;
+}
+
+bool CaptureEngine::shared_ring_info(C_SharedRingInfo& info) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!shared_ring_) {
+        return false;
+    }
+    shared_ring_->fill_info(info);
+    return true;
+}
+
+// =================================================================
+// D) LIVE DATAPLANE CONFIG AND SHEDDING
+// =================================================================
+
+void CaptureEngine::update_dataplane(const std::function<void(DataplaneConfig&)>& edit) {
+    std::lock_guard<std::mutex> lock(dataplane_mutex_);
+    std::shared_ptr<DataplaneConfig> next = std::make_shared<DataplaneConfig>(*dataplane());
+    edit(*next);
+    control_.dataplane.set(std::move(next));
+}
+
+std::shared_ptr<const DataplaneConfig> CaptureEngine::dataplane() const {
+    std::shared_ptr<const DataplaneConfig> current = control_.dataplane.get(nullptr);
+    return current ? current : std::make_shared<const DataplaneConfig>();
+}
+
+std::shared_ptr<const CaptureFilter> CaptureEngine::filter() const {
+    return dataplane()->filter;
+}
+
+void CaptureEngine::set_capture_filter(std::vector<C_BpfInsn> program) {
+    update_dataplane([&program](DataplaneConfig& dataplane) {
+        std::vector<CompiledShedRule> rules =
+            dataplane.filter ? dataplane.filter->rules() : std::vector<CompiledShedRule>();
+        dataplane.filter = std::make_shared<const CaptureFilter>(std::move(program), std::move(rules));
+    });
+}
+
+void CaptureEngine::set_shed_rules(std::vector<CompiledShedRule> rules) {
+    update_dataplane([&rules](DataplaneConfig& dataplane) {
+        std::vector<C_BpfInsn> program = dataplane.filter ? dataplane.filter->bpf() : std::vector<C_BpfInsn>();
+        dataplane.filter = std::make_shared<const CaptureFilter>(std::move(program), std::move(rules));
+    });
+}
+
+// =================================================================
+// E) FLOW LOG
+// =================================================================
+
+void CaptureEngine::set_flow_log(const FlowLogSettings& settings) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flow_log_ = settings.enabled() ? settings : FlowLogSettings();
+}
+
+bool CaptureEngine::log_decision(const C_SketchAlert& decision, const char* reason) {
+    std::lock_guard<std::mutex> lock(log_mutex_);
+    if (!control_log_) {
+        return false;
+    }
+    control_log_->append_decision(decision, reason);
+    return true;
+}
+
+void CaptureEngine::flow_log_stats(C_FlowLogStats& stats) const {
+    {
+        std::lock_guard<std::mutex> lock(log_mutex_);
+        if (control_log_) {
+            control_log_->add_stats(stats);
+        }
+    }
+    for (const auto& worker : workers()) {
+        worker->add_flow_log_stats(stats);
+    }
+}
+
+// =================================================================
+// F) ALERT DISPATCH
+// =================================================================
+
+CaptureEngine::~CaptureEngine() {
+    stop_alert_dispatch();
+}
+
+void CaptureEngine::start_alert_dispatch() {
+    if (alert_thread_.joinable()) {
+        return;
+    }
+    alert_exit_.store(false, std::memory_order_relaxed);
+    alert_thread_ = std::thread([this] { dispatch_alerts(); });
+}
+
+// Once the workers have exited: the dispatcher delivers what they queued, then leaves.
+void CaptureEngine::stop_alert_dispatch() {
+    if (!alert_thread_.joinable()) {
+        return;
+    }
+    alert_exit_.store(true, std::memory_order_release);
+    control_.alert_sink.wakeup().signal();
+    alert_thread_.join();
+}
+
+/**
+ * The dispatcher loop: one pass over the published workers' callback
+ * queues after another while they deliver anything. When a pass finds
+ * them empty it arms the wakeup and makes one more pass (the workers
+ * notify() after queueing, so an alert queued meanwhile is either seen or
+ * signalled) before it sleeps.
+ */
+void CaptureEngine::dispatch_alerts() {
+    ConsumerWakeup& wakeup = control_.alert_sink.wakeup();
+    bool armed = false;
+    for (;;) {
+        const bool exiting = alert_exit_.load(std::memory_order_acquire);
+        const size_t delivered = drain_callback_alerts();
+        if (exiting) {
+            break;
+        }
+        if (delivered != 0) {
+            if (armed) {
+                wakeup.disarm();
+                armed = false;
+            }
+        } else if (!armed) {
+            wakeup.arm();
+            armed = true;
+        } else {
+            wakeup.wait(-1);
+            wakeup.disarm();
+            armed = false;
+        }
+    }
+    if (armed) {
+        wakeup.disarm();
+    }
+}
+
+size_t CaptureEngine::drain_callback_alerts() {
+    constexpr size_t BATCH = 64;
+    C_SketchAlert alerts[BATCH];
+    size_t delivered = 0;
+    for (const auto& worker : workers()) {
+        if (!worker->ready()) {
+            continue;
+        }
+        size_t count;
+        while ((count = worker->callback_alerts().pop_bulk(alerts, BATCH)) != 0) {
+            control_.alert_sink.deliver(alerts, count);
+            delivered += count;
+        }
+    }
+    return delivered;
+}
@@ -0,0 +1,200 @@
+#ifndef CAPTURE_ENGINE_H
+#define CAPTURE_ENGINE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture_filter.h"
+#include "capture_worker.h"
+#include "config_slot.h"
+#include "flow_log.h"
+#include "shared_ring.h"
+#include "sniffer_engine.h"
+
+/**
+ * @brief The capture workers of one start, as the readers see them: an
+ * immutable list that keeps every worker in it (and its rings) alive for as
+ * long as the snapshot is held, however the engine restarts meanwhile.
+ * Iterable, so `for (auto& worker : engine.workers())` holds the snapshot for
+ * the whole loop.
+ */
+class WorkerSnapshot {
+public:
+    using List = std::vector<std::shared_ptr<CaptureWorker>>;
+
+    explicit WorkerSnapshot(std::shared_ptr<const List> list) : list_(std::move(list)) {}
+
+    List::const_iterator begin() const { return list_->begin(); }
+    List::const_iterator end() const { return list_->end(); }
+    size_t size() const { return list_->size(); }
+    bool empty() const { return list_->empty(); }
+    const std::shared_ptr<CaptureWorker>& operator[](size_t i) const { return (*list_)[i]; }
+
+private:
+    std::shared_ptr<const List> list_;   // Never null
+};
+
+/**
+ * @brief The capture engine behind start/stop_capture_engine: its workers,
+ * their joinable threads, and what they were started with.
+ *
+ * stop() signals every worker with one atomic store (the capture loops never
+ * block on it), then waits, bounded, for each to drain what its source had
+ * already captured and park or exit; exited threads are joined, so once
+ * stop() returns 0 nothing writes the caller's buffer any more.
+ *
+ * A keep-warm stop parks the workers with their sockets, kernel rings, user
+ * rings and flow tables intact. A following start() with the same source,
+ * buffer, queue count, CPUs and fanout resumes them in place (new flow
+ * timeouts apply, as does anything reloaded while they were parked);
+ * packets the kernel queued meanwhile are still delivered, and the flow log
+ * carries on in the segments it has open.
+ * Anything else shuts the parked workers down and cold-starts.
+ *
+ * start() and stop() are serialized; readers (read_batch & co.) may keep
+ * draining the rings while the engine is stopping or parked. They never take
+ * the engine's lock: each start publishes its worker list (see workers()).
+ *
+ * Alongside the workers runs one alert dispatcher thread, from the cold
+ * start until their shutdown: it drains every worker's callback queue into
+ * the alert callback (see AlertSink).
+ */
+class CaptureEngine {
+public:
+    static constexpr uint32_t DEFAULT_STOP_TIMEOUT_MS = 2000;
+
+    CaptureEngine() = default;
+    ~CaptureEngine();
+
+    CaptureEngine(const CaptureEngine&) = delete;
+    CaptureEngine& operator=(const CaptureEngine&) = delete;
+
+    /**
+     * @brief Starts (or warm-resumes) capture. Return codes are those of
+     * start_capture_engine_ex; *warm (if non-null) tells which it was.
+     */
+    int start(const char* spec, C_PacketData* buffer, const C_CaptureConfig& config, bool* warm);
+
+    /**
+     * @brief Stops capture, waiting up to timeout_ms for the workers.
+     * @return 0, or -1 if a worker was still draining at the deadline (call
+     * again to finish; the buffer stays in use until then).
+     */
+    int stop(uint32_t timeout_ms, bool keep_warm);
+
+    /**
+     * @brief SNIFFER_STATE_*, lock-free: of the workers in the published
+     * list (or in `workers`, a snapshot the caller holds).
+     */
+    int state() const;
+    int state(const WorkerSnapshot& workers) const;
+
+    /**
+     * @brief Shared-memory ring settings for the next cold start (see set_shared_ring()).
+     */
+    void set_shared_ring(const std::string& name, uint32_t slots, uint32_t flags);
+
+    /**
+     * @brief Fills *info for the current segment; false if there is none.
+     */
+    bool shared_ring_info(C_SharedRingInfo& info) const;
+
+    /**
+     * @brief Publishes the dataplane config `edit` makes of the current one
+     * (see reload_dataplane_config()). Running workers switch to it at their
+     * next poll and later starts begin with it; nothing waits for them.
+     * Edits are serialized, so concurrent ones never lose each other.
+     */
+    void update_dataplane(const std::function<void(DataplaneConfig&)>& edit);
+
+    /**
+     * @brief The dataplane config last published, never null.
+     */
+    std::shared_ptr<const DataplaneConfig> dataplane() const;
+
+    /**
+     * @brief BPF program / shed rules, applied live (see set_capture_filter()
+     * and set_shed_rules()); each call keeps the other half.
+     */
+    void set_capture_filter(std::vector<C_BpfInsn> program);
+    void set_shed_rules(std::vector<CompiledShedRule> rules);
+
+    /**
+     * @brief Flow log for the next cold start (see set_flow_log()).
+     */
+    void set_flow_log(const FlowLogSettings& settings);
+
+    /**
+     * @brief Appends to the control-plane decisions stream; false if it is not open.
+     */
+    bool log_decision(const C_SketchAlert& decision, const char* reason);
+
+    /**
+     * @brief Sums the workers' and the control plane's flow log writers.
+     */
+    void flow_log_stats(C_FlowLogStats& stats) const;
+
+    EngineControl& control() { return control_; }
+
+    /**
+     * @brief The workers of the last cold start (empty before the first),
+     * lock-free: a start replaces the list, never the one a reader holds.
+     */
+    WorkerSnapshot workers() const;
+
+private:
+    bool can_resume(const std::string& spec, C_PacketData* buffer, const C_CaptureConfig& config) const;
+    bool parked() const;   // Every worker is parked (keep-warm stop completed)
+    void apply_timeouts(const C_CaptureConfig& config);
+    std::shared_ptr<const CaptureFilter> filter() const;
+    int resume(const C_CaptureConfig& config);
+    int cold_start(const std::string& spec, C_PacketData* buffer, const C_CaptureConfig& config);
+    void publish_workers();
+    int prepare_shared_ring(unsigned queues);
+    int open_flow_log(unsigned queues, std::vector<FlowLogLanes>& lanes);
+    int shutdown(std::chrono::steady_clock::time_point deadline);
+    bool wait_stopped(std::chrono::steady_clock::time_point deadline);
+    void start_alert_dispatch();
+    void stop_alert_dispatch();
+    void dispatch_alerts();
+    size_t drain_callback_alerts();
+
+    mutable std::mutex mutex_;
+    EngineControl control_;
+    WorkerSnapshot::List workers_;              // Under mutex_
+    ConfigSlot<WorkerSnapshot::List> published_workers_;   // Its copy for the readers
+    std::string spec_;
+    C_PacketData* buffer_ = nullptr;
+    C_CaptureConfig config_{};
+
+    // Shared-memory ring: what the next cold start should have, and the
+    // segment the workers write (kept across stops for its consumers).
+    std::string shared_name_;
+    uint32_t shared_slots_ = 0;
+    uint32_t shared_flags_ = 0;
+    std::unique_ptr<SharedRingSegment> shared_ring_;
+
+    // Alert dispatcher (started and stopped under mutex_)
+    std::thread alert_thread_;
+    std::atomic<bool> alert_exit_{false};
+
+    // Serializes update_dataplane() (never held by a worker)
+    std::mutex dataplane_mutex_;
+
+    // Flow log for the next start, what the current workers write, and the
+    // control plane's decisions stream (log_decision(), under its own lock
+    // so it never waits for a start or stop)
+    FlowLogSettings flow_log_;
+    FlowLogSettings started_flow_log_;
+    mutable std::mutex log_mutex_;
+    std::unique_ptr<FlowLogWriter> control_log_;
+};
+
+#endif // CAPTURE_ENGINE_H
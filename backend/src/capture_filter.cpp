@@ -0,0 +1,291 @@
+// src/capture_filter.cpp
+
+#include "capture_filter.h"
+
+#include <linux/filter.h>
+
+#include <cstddef>
+
+static_assert(sizeof(C_BpfInsn) == sizeof(sock_filter) && offsetof(C_BpfInsn, k) == offsetof(sock_filter, k),
+              "C_BpfInsn must match struct sock_filter");
+
+namespace {
+
+// Loads a big-endian word of `size` bytes at offset, as BPF does.
+bool load(const uint8_t* data, uint32_t caplen, uint64_t offset, uint32_t size, uint32_t& out) {
+    if (offset + size > caplen) {
+        return false;  // Also every SKF_AD_* / SKF_NET_OFF offset: they wrap to huge values
+    }
+    const uint8_t* p = data + offset;
+    switch (size) {
+    case 4:
+        out = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        break;
+    case 2:
+        out = (uint32_t(p[0]) << 8) | p[1];
+        break;
+    default:
+        out = p[0];
+        break;
+    }
+    return true;
+}
+
+uint32_t load_size(uint16_t code) {
+    switch (BPF_SIZE(code)) {
+    case BPF_W: return 4;
+    case BPF_H: return 2;
+    default: return 1;
+    }
+}
+
+} // namespace
+
+// =================================================================
+// A) VALIDATION
+// =================================================================
+
+bool CaptureFilter::validate_bpf(const C_BpfInsn* program, uint32_t length) {
+    if (program == nullptr || length == 0 || length > BPF_MAXINSNS) {
+        return false;
+    }
+    for (uint32_t pc = 0; pc < length; ++pc) {
+        const C_BpfInsn& insn = program[pc];
+        const uint16_t code = insn.code;
+        switch (BPF_CLASS(code)) {
+        case BPF_LD:
+        case BPF_LDX:
+            switch (BPF_MODE(code)) {
+            case BPF_IMM:
+            case BPF_LEN:
+                break;
+            case BPF_ABS:
+            case BPF_IND:
+                if (BPF_CLASS(code) == BPF_LDX || BPF_SIZE(code) > BPF_B) {
+                    return false;
+                }
+                break;
+            case BPF_MSH:
+                if (code != (BPF_LDX | BPF_B | BPF_MSH)) {
+                    return false;
+                }
+                break;
+            case BPF_MEM:
+                if (insn.k >= BPF_MEMWORDS) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+            }
+            break;
+        case BPF_ST:
+        case BPF_STX:
+            if (insn.k >= BPF_MEMWORDS) {
+                return false;
+            }
+            break;
+        case BPF_ALU:
+            switch (BPF_OP(code)) {
+            case BPF_ADD: case BPF_SUB: case BPF_MUL: case BPF_OR: case BPF_AND:
+            case BPF_LSH: case BPF_RSH: case BPF_XOR: case BPF_NEG:
+                break;
+            case BPF_DIV:
+            case BPF_MOD:
+                if (BPF_SRC(code) == BPF_K && insn.k == 0) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+            }
+            break;
+        case BPF_JMP:
+            if (BPF_OP(code) == BPF_JA) {
+                if (insn.k >= length - pc - 1) {
+                    return false;
+                }
+            } else if (BPF_OP(code) == BPF_JEQ || BPF_OP(code) == BPF_JGT || BPF_OP(code) == BPF_JGE ||
+                       BPF_OP(code) == BPF_JSET) {
+                if (pc + 1u + insn.jt >= length || pc + 1u + insn.jf >= length) {
+                    return false;
+                }
+            } else {
+                return false;
+            }
+            break;
+        case BPF_RET:
+            if (BPF_RVAL(code) != BPF_K && BPF_RVAL(code) != BPF_A) {
+                return false;
+            }
+            break;
+        case BPF_MISC:
+            if (BPF_MISCOP(code) != BPF_TAX && BPF_MISCOP(code) != BPF_TXA) {
+                return false;
+            }
+            break;
+        }
+    }
+    return BPF_CLASS(program[length - 1].code) == BPF_RET;
+}
+
+bool CaptureFilter::compile_rule(const C_ShedRule& rule, CompiledShedRule& out) {
+    constexpr uint8_t sides = SNIFFER_SHED_ADDR_SRC | SNIFFER_SHED_ADDR_DST | SNIFFER_SHED_PORT_SRC |
+                              SNIFFER_SHED_PORT_DST;
+    if (rule.prefix_len > 128 || rule.port_min > rule.port_max || (rule.flags & ~sides) != 0) {
+        return false;
+    }
+    out = CompiledShedRule{};
+    out.protocol = rule.protocol;
+    out.flags = rule.flags;
+    out.port_min = rule.port_min;
+    out.port_max = rule.port_max;
+    out.any_port = rule.port_min == 0 && rule.port_max == 0;
+    out.any_addr = rule.prefix_len == 0;
+
+    // The mask in address byte order, so it applies to the raw words.
+    uint8_t mask[16] = {};
+    for (unsigned bit = 0; bit < rule.prefix_len; ++bit) {
+        mask[bit / 8] |= static_cast<uint8_t>(0x80u >> (bit % 8));
+    }
+    uint8_t addr[16];
+    for (int i = 0; i < 16; ++i) {
+        addr[i] = rule.addr[i] & mask[i];
+    }
+    std::memcpy(out.mask, mask, sizeof(out.mask));
+    std::memcpy(out.addr, addr, sizeof(out.addr));
+    return true;
+}
+
+// =================================================================
+// B) SHEDDING
+// =================================================================
+
+void CaptureFilter::shed(const CapturedPacket* const* frames, PacketBatch& batch, bool run_bpf,
+                         ShedCounters& counters) const {
+    for (size_t i = 0; i < batch.count; ++i) {
+        const CapturedPacket& packet = *frames[i];
+        if (run_bpf && !accepts(packet.data, packet.header.caplen, packet.header.len)) {
+            batch.state[i] = PacketBatch::SHED;
+            ++counters.filter_packets;
+            counters.filter_bytes += packet.header.len;
+            continue;
+        }
+        if (batch.state[i] != PacketBatch::IP) {
+            continue;
+        }
+        const int rule = shed_rule(batch.tuples[i]);
+        if (rule >= 0) {
+            batch.state[i] = PacketBatch::SHED;
+            ++counters.rule_packets;
+            counters.rule_bytes += packet.header.len;
+            ++counters.rule_hits[rule];
+        }
+    }
+}
+
+// =================================================================
+// C) INTERPRETER (backends without a kernel filter)
+// =================================================================
+
+bool CaptureFilter::accepts(const uint8_t* data, uint32_t caplen, uint32_t len) const {
+    uint32_t a = 0;
+    uint32_t x = 0;
+    uint32_t mem[BPF_MEMWORDS] = {};
+    const C_BpfInsn* program = bpf_.data();
+    uint32_t value;
+
+    for (size_t pc = 0;; ++pc) {
+        const C_BpfInsn& insn = program[pc];
+        const uint16_t code = insn.code;
+        switch (BPF_CLASS(code)) {
+        case BPF_LD:
+            switch (BPF_MODE(code)) {
+            case BPF_IMM: a = insn.k; break;
+            case BPF_LEN: a = len; break;
+            case BPF_MEM: a = mem[insn.k]; break;
+            case BPF_ABS:
+            case BPF_IND: {
+                const uint64_t offset = static_cast<uint64_t>(insn.k) + (BPF_MODE(code) == BPF_IND ? x : 0);
+                if (static_cast<int32_t>(insn.k) < 0 || !load(data, caplen, offset, load_size(code), value)) {
+                    return false;
+                }
+                a = value;
+                break;
+            }
+            }
+            break;
+        case BPF_LDX:
+            switch (BPF_MODE(code)) {
+            case BPF_IMM: x = insn.k; break;
+            case BPF_LEN: x = len; break;
+            case BPF_MEM: x = mem[insn.k]; break;
+            case BPF_MSH:
+                if (!load(data, caplen, insn.k, 1, value)) {
+                    return false;
+                }
+                x = (value & 0xF) << 2;
+                break;
+            }
+            break;
+        case BPF_ST:
+            mem[insn.k] = a;
+            break;
+        case BPF_STX:
+            mem[insn.k] = x;
+            break;
+        case BPF_ALU: {
+            const uint32_t operand = BPF_SRC(code) == BPF_X ? x : insn.k;
+            switch (BPF_OP(code)) {
+            case BPF_ADD: a += operand; break;
+            case BPF_SUB: a -= operand; break;
+            case BPF_MUL: a *= operand; break;
+            case BPF_DIV:
+                if (operand == 0) {
+                    return false;
+                }
+                a /= operand;
+                break;
+            case BPF_MOD:
+                if (operand == 0) {
+                    return false;
+                }
+                a %= operand;
+                break;
+            case BPF_OR: a |= operand; break;
+            case BPF_AND: a &= operand; break;
+            case BPF_XOR: a ^= operand; break;
+            case BPF_LSH: a = operand < 32 ? a << operand : 0; break;
+            case BPF_RSH: a = operand < 32 ? a >> operand : 0; break;
+            case BPF_NEG: a = 0u - a; break;
+            }
+            break;
+        }
+        case BPF_JMP: {
+            if (BPF_OP(code) == BPF_JA) {
+                pc += insn.k;
+                break;
+            }
+            const uint32_t operand = BPF_SRC(code) == BPF_X ? x : insn.k;
+            bool taken = false;
+            switch (BPF_OP(code)) {
+            case BPF_JEQ: taken = a == operand; break;
+            case BPF_JGT: taken = a > operand; break;
+            case BPF_JGE: taken = a >= operand; break;
+            case BPF_JSET: taken = (a & operand) != 0; break;
+            }
+            pc += taken ? insn.jt : insn.jf;
+            break;
+        }
+        case BPF_RET:
+            return (BPF_RVAL(code) == BPF_A ? a : insn.k) != 0;
+        case BPF_MISC:
+            if (BPF_MISCOP(code) == BPF_TAX) {
+                x = a;
+            } else {
+                a = x;
+            }
+            break;
+        }
+    }
+}
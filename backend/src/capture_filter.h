@@ -0,0 +1,139 @@
+#ifndef CAPTURE_FILTER_H
+#define CAPTURE_FILTER_H
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "packet_batch.h"
+#include "packet_parser.h"
+#include "sniffer_engine.h"
+
+/**
+ * @brief A shed rule compiled for matching: the CIDR as two masked 64-bit
+ * words, so a check is a handful of compares on the parsed tuple.
+ */
+struct CompiledShedRule {
+    uint64_t addr[2];
+    uint64_t mask[2];
+    uint16_t port_min;
+    uint16_t port_max;
+    uint8_t protocol;   // 0 = any
+    uint8_t flags;      // SNIFFER_SHED_* sides
+    bool any_addr;
+    bool any_port;
+};
+
+/**
+ * @brief What CaptureFilter::shed() dropped, by cause; one per capture
+ * worker, plain counters (the worker publishes them).
+ */
+struct ShedCounters {
+    uint64_t filter_packets = 0;
+    uint64_t filter_bytes = 0;
+    uint64_t rule_packets = 0;
+    uint64_t rule_bytes = 0;
+    uint64_t rule_hits[SNIFFER_MAX_SHED_RULES] = {};
+};
+
+/**
+ * @brief What start_capture_engine sheds before a frame costs a record slot:
+ * a classic BPF program (frames it rejects are dropped) and shed rules for
+ * known-good bulk traffic (frames they match are dropped).
+ *
+ * Immutable once built; the capture workers of a run share one instance.
+ * AF_PACKET attaches the BPF program to its socket so the kernel filters;
+ * for every other backend the worker runs it with accepts().
+ */
+class CaptureFilter {
+public:
+    /**
+     * @brief Checks a program the way the kernel does (forward jumps in
+     * range, scratch slots < BPF_MEMWORDS, no division by a zero constant,
+     * ends in a return).
+     * @return false if it is not a valid classic BPF program.
+     */
+    static bool validate_bpf(const C_BpfInsn* program, uint32_t length);
+
+    /**
+     * @brief False if a rule's prefix, port range or flags are invalid.
+     */
+    static bool compile_rule(const C_ShedRule& rule, CompiledShedRule& out);
+
+    CaptureFilter() = default;
+    CaptureFilter(std::vector<C_BpfInsn> bpf, std::vector<CompiledShedRule> rules) :
+        bpf_(std::move(bpf)), rules_(std::move(rules)) {}
+
+    bool has_bpf() const { return !bpf_.empty(); }
+    const std::vector<C_BpfInsn>& bpf() const { return bpf_; }
+    const std::vector<CompiledShedRule>& rules() const { return rules_; }
+    bool empty() const { return bpf_.empty() && rules_.empty(); }
+
+    /**
+     * @brief Runs the BPF program over a frame (caplen bytes at data, len on
+     * the wire). Kernel-only ancillary loads (SKF_AD_*) fail, which rejects.
+     * @return true if the frame is kept.
+     */
+    bool accepts(const uint8_t* data, uint32_t caplen, uint32_t len) const;
+
+    /**
+     * @brief The shedding pass over a parsed batch (frames[i] is entry i):
+     * entries the BPF program rejects (run_bpf: unless the kernel already
+     * ran it) and IP entries a rule matches become PacketBatch::SHED, and
+     * are counted with their length on the wire.
+     */
+    void shed(const CapturedPacket* const* frames, PacketBatch& batch, bool run_bpf,
+              ShedCounters& counters) const;
+
+    /**
+     * @brief Index of the first rule the packet matches, or -1.
+     */
+    int shed_rule(const FlowTuple& tuple) const {
+        for (size_t i = 0; i < rules_.size(); ++i) {
+            if (matches(rules_[i], tuple)) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+
+private:
+    static bool addr_matches(const CompiledShedRule& rule, const uint8_t* addr);
+    static bool matches(const CompiledShedRule& rule, const FlowTuple& tuple);
+
+    std::vector<C_BpfInsn> bpf_;
+    std::vector<CompiledShedRule> rules_;
+};
+
+inline bool CaptureFilter::addr_matches(const CompiledShedRule& rule, const uint8_t* addr) {
+    uint64_t words[2];
+    std::memcpy(words, addr, sizeof(words));
+    return (words[0] & rule.mask[0]) == rule.addr[0] && (words[1] & rule.mask[1]) == rule.addr[1];
+}
+
+inline bool CaptureFilter::matches(const CompiledShedRule& rule, const FlowTuple& tuple) {
+    if (rule.protocol != 0 && rule.protocol != tuple.protocol) {
+        return false;
+    }
+    if (!rule.any_port) {
+        const bool src = (rule.flags & SNIFFER_SHED_PORT_SRC) != 0;
+        const bool dst = (rule.flags & SNIFFER_SHED_PORT_DST) != 0;
+        const bool src_in = tuple.src_port >= rule.port_min && tuple.src_port <= rule.port_max;
+        const bool dst_in = tuple.dst_port >= rule.port_min && tuple.dst_port <= rule.port_max;
+        if (!((src_in && (src || !dst)) || (dst_in && (dst || !src)))) {
+            return false;
+        }
+    }
+    if (!rule.any_addr) {
+        const bool src = (rule.flags & SNIFFER_SHED_ADDR_SRC) != 0;
+        const bool dst = (rule.flags & SNIFFER_SHED_ADDR_DST) != 0;
+        if (!((addr_matches(rule, tuple.src_addr) && (src || !dst)) ||
+              (addr_matches(rule, tuple.dst_addr) && (dst || !src)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif // CAPTURE_FILTER_H
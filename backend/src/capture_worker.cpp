@@ -0,0 +1,753 @@
+// src/capture_worker.cpp
+
+#include "capture_worker.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "flow_features.h"
+
+// The producer publishes after this many records (or at the end of a poll).
+static constexpr uint32_t PUBLISH_BATCH = CaptureWorker::PUBLISH_BATCH_MAX;
+
+// One flow table update in this many is timed (two clock reads).
+static constexpr uint64_t FLOW_UPDATE_SAMPLE = 64;
+
+// While frame i of a batch is accounted, the flow entry of frame i + this
+// is prefetched (its bucket was prefetched for the whole batch up front).
+static constexpr size_t ENTRY_PREFETCH_DISTANCE = 4;
+
+// Polls between two reads of the backend's own drop counter (a syscall
+// for AF_PACKET).
+static constexpr uint64_t SOURCE_DROPS_POLLS = 64;
+
+// Batches drained after a stop at most: one AF_PACKET ring's worth, so a
+// busy link cannot keep a stop from completing.
+static constexpr int MAX_DRAIN_BATCHES = 64;
+
+CaptureWorker::CaptureWorker(unsigned index, int cpu, std::unique_ptr<CaptureBackend> backend,
+                             std::string source, const CaptureOptions& options,
+                             C_PacketData* record_storage, const EngineControl& control,
+                             SharedRingWriter shared_lane, FlowLogLanes flow_log) :
+    index_(index), cpu_(cpu), backend_(std::move(backend)), source_(std::move(source)),
+    options_(options), record_storage_(record_storage), control_(control), shared_lane_(shared_lane),
+    flow_log_(std::move(flow_log)) {}
+
+std::future<int> CaptureWorker::start(const std::shared_ptr<CaptureWorker>& self) {
+    std::promise<int> opened;
+    std::future<int> result = opened.get_future();
+    // The thread keeps the worker alive for as long as it runs.
+    set_phase(STARTING);
+    try {
+        thread_ = std::thread([self, promise = std::move(opened)]() mutable {
+            self->run(std::move(promise));
+        });
+    } catch (...) {
+        set_phase(EXITED);
+        throw;
+    }
+    return result;
+}
+
+void CaptureWorker::run(std::promise<int> opened) {
+    pin_to_cpu();
+    if (!allocate_rings()) {
+        std::cerr << "[C++ Worker " << index_ << " ERROR] Could not reserve "
+                  << memory_bytes(options_.flow_table_slots) << " bytes of memory." << std::endl;
+        opened.set_value(NO_MEMORY);
+        flow_log_.close();
+        set_phase(EXITED);
+        return;
+    }
+
+    const int rc = backend_->open(source_, options_);
+    if (rc == 0) {
+        if (backend_->filters_in_kernel()) {
+            kernel_program_ = options_.filter;
+        }
+        refresh_dataplane();
+    }
+    opened.set_value(rc);
+    if (rc != 0) {
+        flow_log_.close();
+        set_phase(EXITED);
+        return;
+    }
+
+    std::cout << "[C++ Worker " << index_ << "] Capture thread started on backend " << backend_->name()
+              << (cpu_ >= 0 ? " (cpu " + std::to_string(cpu_) + ")" : std::string()) << std::endl;
+
+    set_phase(CAPTURING);
+    capture();
+    while (park()) {
+        std::cout << "[C++ Worker " << index_ << "] Capture resumed (warm)." << std::endl;
+        capture();
+    }
+
+    std::cout << "[C++ Worker " << index_ << "] Capture thread shutting down." << std::endl;
+    backend_->close();
+    flow_log_.close();
+    set_phase(EXITED);
+}
+
+void CaptureWorker::capture() {
+    FrameSink sink(*frames_);
+    while (!control_.stop.load(std::memory_order_acquire)) {
+        // Bounded wait so the stop flag is observed within ~100 ms.
+        const int delivered = backend_->poll(sink, 100);
+        if (delivered < 0) {
+            std::cerr << "[C++ Worker " << index_ << " ERROR] Backend " << backend_->name()
+                      << " failed; stopping capture." << std::endl;
+            request_exit();
+            break;
+        }
+        account_poll(delivered);
+        frames_->flush();
+        process_frames();
+        expire_flows();
+        wake_consumer();
+    }
+    drain();
+}
+
+/**
+ * Hands on what the source had already captured when the stop came, so a
+ * stop (or a warm restart) loses nothing the kernel accepted.
+ */
+void CaptureWorker::drain() {
+    FrameSink sink(*frames_);
+    for (int batch = 0; batch < MAX_DRAIN_BATCHES; ++batch) {
+        const int delivered = backend_->drain(sink);
+        account_poll(delivered);
+        frames_->flush();
+        process_frames();
+        if (delivered <= 0) {
+            break;
+        }
+    }
+    counters_.kernel_drops += backend_->take_drops();
+    expire_flows();
+    wake_consumer();
+}
+
+// Parks after a keep-warm stop; false when the worker should exit instead.
+bool CaptureWorker::park() {
+    std::unique_lock<std::mutex> lock(phase_mutex_);
+    if (exit_requested_ || !control_.keep_warm.load(std::memory_order_acquire)) {
+        return false;
+    }
+    phase_.store(PARKED, std::memory_order_release);
+    phase_cv_.notify_all();
+    phase_cv_.wait(lock, [this] { return resume_requested_ || exit_requested_; });
+    if (exit_requested_) {
+        return false;
+    }
+    resume_requested_ = false;
+    return true;
+}
+
+void CaptureWorker::set_phase(Phase phase) {
+    std::lock_guard<std::mutex> lock(phase_mutex_);
+    phase_.store(phase, std::memory_order_release);
+    phase_cv_.notify_all();
+}
+
+bool CaptureWorker::wait_stopped(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(phase_mutex_);
+    return phase_cv_.wait_until(lock, deadline, [this] {
+        const int current = phase_.load(std::memory_order_acquire);
+        return current == PARKED || current == EXITED;
+    });
+}
+
+bool CaptureWorker::wait_exited(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(phase_mutex_);
+    return phase_cv_.wait_until(lock, deadline, [this] {
+        return phase_.load(std::memory_order_acquire) == EXITED;
+    });
+}
+
+void CaptureWorker::resume() {
+    std::lock_guard<std::mutex> lock(phase_mutex_);
+    resume_requested_ = true;
+    // Capturing from here on, so a stop right after this waits for the next park.
+    phase_.store(CAPTURING, std::memory_order_release);
+    phase_cv_.notify_all();
+}
+
+void CaptureWorker::request_exit() {
+    std::lock_guard<std::mutex> lock(phase_mutex_);
+    exit_requested_ = true;
+    phase_cv_.notify_all();
+}
+
+void CaptureWorker::join() {
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void CaptureWorker::pin_to_cpu() {
+    if (cpu_ < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu_, &set);
+    const int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+        std::cerr << "[C++ Worker " << index_ << " ERROR] Could not pin to cpu " << cpu_
+                  << ": " << std::strerror(rc) << std::endl;
+    }
+}
+
+size_t CaptureWorker::memory_bytes(size_t flow_table_slots) {
+    return MemoryArena::bytes_for<CapturedPacket>(FRAME_RING_SLOTS) +
+           MemoryArena::bytes_for<C_PacketData>(MAX_BUFFER_SLOTS) +
+           MemoryArena::bytes_for<C_PayloadSnapshot>(PAYLOAD_RING_SLOTS) +
+           MemoryArena::bytes_for<ExportedFlow>(FLOW_RING_SLOTS) +
+           MemoryArena::bytes_for<C_SketchAlert>(SKETCH_ALERT_RING_SLOTS) +
+           MemoryArena::bytes_for<C_SketchAlert>(SKETCH_CALLBACK_RING_SLOTS) +
+           MemoryArena::bytes_for<TrafficSketch>(1) + FlowTable::bytes_for(flow_table_slots);
+}
+
+size_t CaptureWorker::flow_table_slots_for(uint64_t budget_bytes) {
+    if (memory_bytes(MIN_FLOW_TABLE_SLOTS) > budget_bytes) {
+        return 0;
+    }
+    size_t slots = MIN_FLOW_TABLE_SLOTS;
+    while (slots < MAX_FLOW_TABLE_SLOTS && memory_bytes(slots * 2) <= budget_bytes) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+// The rings mask their indices, and the reader side (Python included) indexes
+// the record slots the same way.
+static_assert(is_ring_capacity(FRAME_RING_SLOTS) && is_ring_capacity(MAX_BUFFER_SLOTS) &&
+                  is_ring_capacity(PAYLOAD_RING_SLOTS) && is_ring_capacity(FLOW_RING_SLOTS) &&
+                  is_ring_capacity(SKETCH_ALERT_RING_SLOTS) && is_ring_capacity(SKETCH_CALLBACK_RING_SLOTS),
+              "ring slot counts must be powers of two");
+
+bool CaptureWorker::allocate_rings() {
+    // One reservation for everything; its pages are faulted in here, on
+    // this pinned thread, so they sit on the local node.
+    const size_t slots = ring_capacity_for(options_.flow_table_slots);
+    if (!arena_.reserve(memory_bytes(slots))) {
+        return false;
+    }
+    frames_.reset(new ConcurrentRingBuffer<CapturedPacket>(arena_.allocate<CapturedPacket>(FRAME_RING_SLOTS),
+                                                           FRAME_RING_SLOTS));
+    C_PacketData* records = arena_.allocate<C_PacketData>(MAX_BUFFER_SLOTS);
+    records_.reset(new ConcurrentRingBuffer<C_PacketData>(record_storage_ ? record_storage_ : records,
+                                                          MAX_BUFFER_SLOTS));
+    payloads_.reset(new ConcurrentRingBuffer<C_PayloadSnapshot>(
+        arena_.allocate<C_PayloadSnapshot>(PAYLOAD_RING_SLOTS), PAYLOAD_RING_SLOTS));
+    flows_.reset(new ConcurrentRingBuffer<ExportedFlow>(arena_.allocate<ExportedFlow>(FLOW_RING_SLOTS),
+                                                        FLOW_RING_SLOTS));
+    alerts_.reset(new ConcurrentRingBuffer<C_SketchAlert>(
+        arena_.allocate<C_SketchAlert>(SKETCH_ALERT_RING_SLOTS), SKETCH_ALERT_RING_SLOTS));
+    callback_alerts_.reset(new ConcurrentRingBuffer<C_SketchAlert>(
+        arena_.allocate<C_SketchAlert>(SKETCH_CALLBACK_RING_SLOTS), SKETCH_CALLBACK_RING_SLOTS));
+    sketch_ = arena_.create<TrafficSketch>();
+    flow_table_.reset(new FlowTable(slots, arena_));
+    ready_.store(true, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Works through the frames staged by the last poll a PacketBatch at a time:
+ * parse and shed the burst, hash all of its tuples in one flow_keys_batch()
+ * call, prefetch every flow's bucket, then account and publish frame by
+ * frame. Records are published in batches: one release store per
+ * PUBLISH_BATCH records (or per poll) instead of one per packet.
+ */
+void CaptureWorker::process_frames() {
+    const CapturedPacket* frames[PacketBatch::MAX];
+    size_t count;
+    refresh_dataplane();
+    refresh_model();
+    while ((count = frames_->peek_bulk(frames, PacketBatch::MAX)) != 0) {
+        parse_batch(frames, count, batch_);
+        if (filter_ != nullptr) {
+            filter_->shed(frames, batch_, user_bpf_, shed_counters_);
+        }
+        flow_keys_batch(batch_);
+        for (size_t i = 0; i < count; ++i) {
+            if (batch_.state[i] == PacketBatch::IP) {
+                flow_table_->prefetch(batch_.keys[i]);
+            }
+        }
+        for (size_t i = 0; i < count; ++i) {
+            const size_t ahead = i + ENTRY_PREFETCH_DISTANCE;
+            if (ahead < count && batch_.state[ahead] == PacketBatch::IP) {
+                flow_table_->prefetch_entry(batch_.keys[ahead]);
+            }
+            if (batch_.state[i] != PacketBatch::SHED) {
+                publish_record(*frames[i], i);
+            }
+        }
+        frames_->release(count);
+    }
+    flush_records();
+}
+
+// Accounts and publishes entry i of batch_; packet is its frame.
+void CaptureWorker::publish_record(const CapturedPacket& packet, size_t i) {
+    const uint64_t ts_ns = packet.timestamp_ns();
+    const uint32_t length = batch_.lengths[i];
+    ++counters_.packets;
+    counters_.bytes += length;
+    FlowEntry* flow = nullptr;
+
+    C_PacketData record;
+    record.timestamp = ts_ns / 1e9;
+    record.length = length;
+    record.caplen = static_cast<uint16_t>(std::min<uint32_t>(packet.header.caplen, UINT16_MAX));
+    if (batch_.state[i] == PacketBatch::IP) {
+        const FlowTuple& tuple = batch_.tuples[i];
+        record.flow_hash = batch_.keys[i];
+        record.protocol = tuple.protocol;
+        const bool timed = ++flow_updates_ % FLOW_UPDATE_SAMPLE == 0;
+        const auto started = timed ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+        flow = flow_table_->update(record.flow_hash, tuple, batch_.tcp_flags[i], length, ts_ns, flow_timeouts_,
+                            [this, ts_ns](const FlowEntry& evicted) { emit_flow(evicted, ts_ns); });
+        if (timed) {
+            flow_update_latency_.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - started).count()));
+        }
+    } else {
+        // Not IP: keep the kernel's hash so the record can still be grouped.
+        record.flow_hash = packet.rxhash;
+        record.protocol = 0;
+    }
+    record.flags = static_cast<uint8_t>(packet.flags & C_PKT_FLAG_ALERT);
+    if (batch_.state[i] == PacketBatch::IP && sketch_settings_.window_ns != 0 && update_sketch(i, flow, ts_ns)) {
+        record.flags |= C_PKT_FLAG_ALERT;
+    }
+    record.payload_ref = C_PAYLOAD_NONE;
+    record.queue_id = static_cast<uint16_t>(index_);
+    record.reserved = 0;
+
+    // The record's slot first (a full ring drops the record and counts it):
+    // a payload snapshot is only taken for a record that carries its
+    // payload_ref, and only a snapshot taken counts against the flow's cap.
+    C_PacketData* slot = records_->claim();
+    if (slot != nullptr && wants_payload(record, flow) && snapshot_payload(packet, record) && flow != nullptr &&
+        flow->payload_snaps != UINT16_MAX) {
+        ++flow->payload_snaps;
+    }
+
+    // Other processes get every record; they keep up or notice they did not.
+    if (shared_lane_.attached()) {
+        shared_lane_.stage(record);
+    }
+
+    if (slot != nullptr) {
+        *slot = record;
+        records_->commit();
+        ++record_seq_;
+        unpublished_ts_[unpublished_] = ts_ns;
+        if (++unpublished_ >= PUBLISH_BATCH) {
+            flush_records();
+        }
+    }
+}
+
+// The payload policy (set_payload_policy()) for one frame; flow is its
+// entry, already accounted, or nullptr if it has none.
+bool CaptureWorker::wants_payload(const C_PacketData& record, FlowEntry* flow) const {
+    const int mode = control_.payload_mode.load(std::memory_order_relaxed);
+    if (mode == SNIFFER_PAYLOAD_OFF) {
+        return false;
+    }
+    if (mode == SNIFFER_PAYLOAD_ALL) {
+        return true;
+    }
+    const uint32_t cap = control_.payload_packets.load(std::memory_order_relaxed);
+    if (mode == SNIFFER_PAYLOAD_FIRST) {
+        return flow != nullptr && flow->packets <= cap;
+    }
+    // SNIFFER_PAYLOAD_FLAGGED
+    if (flow == nullptr) {
+        return (record.flags & C_PKT_FLAG_ALERT) != 0;
+    }
+    if (cap != 0 && flow->payload_snaps >= cap) {
+        return false;
+    }
+    return (record.flags & C_PKT_FLAG_ALERT) != 0 || control_.payload_flows.contains(flow->key);
+}
+
+bool CaptureWorker::snapshot_payload(const CapturedPacket& packet, C_PacketData& record) {
+    C_PayloadSnapshot* snap = payloads_->claim();
+    if (snap == nullptr) {
+        return false;
+    }
+    const uint32_t bytes = std::min<uint32_t>(packet.header.caplen,
+                                              control_.payload_bytes.load(std::memory_order_relaxed));
+    snap->record_seq = record_seq_;
+    snap->flow_hash = record.flow_hash;
+    snap->timestamp = record.timestamp;
+    snap->length = packet.header.len;
+    snap->caplen = static_cast<uint16_t>(bytes);
+    snap->queue_id = static_cast<uint16_t>(index_);
+    std::memcpy(snap->data, packet.data, bytes);
+    payloads_->commit();
+
+    record.payload_ref = static_cast<uint32_t>(payload_seq_++);
+    record.flags |= C_PKT_FLAG_PAYLOAD;
+    return true;
+}
+
+// Counts entry i of batch_ into the traffic sketch; true if it raised an alert.
+bool CaptureWorker::update_sketch(size_t i, FlowEntry* flow, uint64_t ts_ns) {
+    const uint64_t windows = sketch_->windows();
+    const unsigned raised = sketch_->add(batch_.tuples[i], batch_.keys[i], batch_.lengths[i], ts_ns,
+                                         flow != nullptr ? &flow->sketch_alerts : nullptr, sketch_settings_,
+                                         [this, ts_ns](C_SketchAlert alert) {
+                                             ++sketch_alerts_;
+                                             raise_alert(alert, ts_ns);
+                                         });
+    if (sketch_->windows() != windows) {
+        std::lock_guard<std::mutex> lock(window_mutex_);
+        if (!published_window_) {
+            published_window_.reset(new SketchWindow);
+        }
+        *published_window_ = sketch_->last_window();
+    }
+    return raised != 0;
+}
+
+// An alert goes out at once: published to the alert ring on its own and,
+// with a callback set, queued for the dispatcher (a full ring or queue
+// drops and counts it). Nothing here waits for the callback.
+void CaptureWorker::raise_alert(C_SketchAlert& alert, uint64_t ts_ns) {
+    alert.timestamp = ts_ns / 1e9;
+    alert.queue_id = static_cast<uint16_t>(index_);
+    if (alerts_->enqueue(alert)) {
+        alerts_->flush();
+    }
+    if (flow_log_.decisions) {
+        flow_log_.decisions->append_decision(alert, nullptr);
+    }
+    if (control_.alert_sink.armed() && callback_alerts_->enqueue(alert)) {
+        callback_alerts_->flush();
+        control_.alert_sink.wakeup().notify();
+    }
+}
+
+/**
+ * Atomically publishes every record written so far (Producer logic).
+ * This 'releases' the data to the Python reader thread.
+ */
+void CaptureWorker::flush_records() {
+    // Payloads first, so a reader that sees a record can also find its snapshot.
+    payloads_->flush();
+    records_->flush();
+    if (shared_lane_.attached()) {
+        shared_lane_.publish();
+    }
+    if (unpublished_ != 0) {
+        const uint64_t now = latency_clock_ns();
+        for (uint32_t i = 0; i < unpublished_; ++i) {
+            publish_latency_.record_span(unpublished_ts_[i], now);
+        }
+    }
+    unpublished_ = 0;
+}
+
+/**
+ * Moves the flows that are due from the table to the flow ring. The timer
+ * wheel makes this O(expired flows), so it runs after every poll.
+ */
+void CaptureWorker::expire_flows() {
+    // Flows expire on the source's timeline (a replay's trace time); the
+    // export is stamped with the wall clock either way.
+    const uint64_t now = latency_clock_ns();
+    flow_table_->advance(backend_->clock_ns(now), flow_timeouts_,
+                         [this, now](const FlowEntry& entry) { emit_flow(entry, now); });
+    flows_->flush();
+    score_flows();
+    publish_stats();
+}
+
+// Once per poll, and only if it published records or flows: a fence, plus
+// a syscall when the reader is parked.
+void CaptureWorker::wake_consumer() {
+    const uint64_t published = record_seq_ + flows_->tail_position() + alerts_->tail_position();
+    if (published != woken_at_) {
+        woken_at_ = published;
+        control_.wakeup.notify();
+    }
+}
+
+// A full flow ring drops (and counts) the record; the flow log and the
+// flow model still get it.
+void CaptureWorker::emit_flow(const FlowEntry& entry, uint64_t now_ns) {
+    ExportedFlow* slot = flows_->claim();
+    if (slot == nullptr && !flow_log_.flows && !model_) {
+        return;
+    }
+    C_FlowRecord unpublished;
+    C_FlowRecord& record = slot != nullptr ? slot->record : unpublished;
+    fill_flow_record(record, entry, static_cast<uint16_t>(index_));
+    if (flow_log_.flows) {
+        flow_log_.flows->append_flow(record);
+    }
+    if (model_) {
+        model_pending_[model_pending_count_] = record;
+        if (++model_pending_count_ == FlowModel::BATCH_MAX) {
+            score_flows();
+        }
+    }
+    if (slot != nullptr) {
+        slot->export_ns = now_ns;
+        flows_->commit();
+    }
+}
+
+/**
+ * Once per poll: a reload (see reload_dataplane_config()) takes over between
+ * two polls, all of it at once. Unchanged, this is one atomic load; a new
+ * config is a lock-free copy out of EngineControl::dataplane. Flows already
+ * tracked meet new timeouts when they are next updated or due.
+ */
+void CaptureWorker::refresh_dataplane() {
+    if (dataplane_ && control_.dataplane.generation() == dataplane_generation_) {
+        return;
+    }
+    // The previous config stays alive until it has been compared against.
+    const std::shared_ptr<const DataplaneConfig> previous = std::move(dataplane_);
+    dataplane_ = control_.dataplane.get(&dataplane_generation_);
+    static const DataplaneConfig defaults;
+    const DataplaneConfig& config = dataplane_ ? *dataplane_ : defaults;
+    flow_timeouts_ = config.flow_timeouts;
+    sketch_settings_ = config.sketch;
+    if (!previous || previous->filter != config.filter) {
+        apply_filter(config.filter);
+    }
+    config_generation_.store(dataplane_generation_, std::memory_order_release);
+}
+
+// Switches shedding to `filter` (null = none). The source is asked to run
+// its BPF program (AF_PACKET swaps the socket's in one call); if it cannot,
+// this thread does. Rule hits restart, since rule i may be a new rule.
+void CaptureWorker::apply_filter(const std::shared_ptr<const CaptureFilter>& filter) {
+    const bool bpf = filter && filter->has_bpf();
+    if (!bpf) {
+        if (kernel_program_) {
+            backend_->set_filter(nullptr);
+            kernel_program_.reset();
+        }
+    } else if (kernel_program_ != filter) {
+        kernel_program_ = backend_->set_filter(filter.get()) ? filter : nullptr;
+    }
+    filter_ = filter && !filter->empty() ? filter.get() : nullptr;
+    user_bpf_ = bpf && !kernel_program_;
+    kernel_filter_.store(bpf && kernel_program_ != nullptr, std::memory_order_relaxed);
+    std::fill(std::begin(shed_counters_.rule_hits), std::end(shed_counters_.rule_hits), 0);
+    for (auto& hits : shed_stats_.rule_hits) {
+        hits.store(0, std::memory_order_relaxed);
+    }
+    shed_stats_.rule_count.store(filter_ != nullptr ? static_cast<uint32_t>(filter_->rules().size()) : 0,
+                                 std::memory_order_relaxed);
+}
+
+// Once per poll: a new set_flow_model() takes over once the flows staged
+// under the old one are scored.
+void CaptureWorker::refresh_model() {
+    if (control_.flow_model.generation() == model_generation_) {
+        return;
+    }
+    score_flows();
+    model_ = control_.flow_model.get(&model_generation_);
+}
+
+/**
+ * Scores the staged flows in one FlowModel::score() call and raises a
+ * C_ALERT_MODEL alert, flagged for enforcement, for each flow whose class
+ * has an action: the enforcer callback applies it to the flow's id before
+ * Python has read the flow.
+ */
+void CaptureWorker::score_flows() {
+    const size_t count = model_pending_count_;
+    if (count == 0) {
+        return;
+    }
+    model_pending_count_ = 0;
+    // A duration, so the monotonic clock (latency_clock_ns() follows the wall clock's steps).
+    const auto started = std::chrono::steady_clock::now();
+    float features[FlowModel::BATCH_MAX * C_FLOW_FEATURE_COUNT];
+    uint8_t classes[FlowModel::BATCH_MAX];
+    float confidence[FlowModel::BATCH_MAX];
+    compute_flow_features(model_pending_, count, features, nullptr);
+    model_->score(features, count, classes, confidence);
+    model_counters_.score_ns += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count());
+    model_counters_.flows += count;
+    ++model_counters_.batches;
+
+    for (size_t i = 0; i < count; ++i) {
+        ++model_counters_.class_counts[classes[i]];
+        const uint8_t action = model_->action(classes[i]);
+        if (action == 0 || confidence[i] < model_->min_confidence()) {
+            continue;
+        }
+        const C_FlowRecord& flow = model_pending_[i];
+        C_SketchAlert alert = {};
+        alert.flow_id = flow.flow_id;
+        alert.estimate = classes[i];
+        alert.threshold = static_cast<uint64_t>(std::lround(confidence[i] * 1e6f));
+        alert.kind = C_ALERT_MODEL;
+        alert.action = action;
+        alert.flags = C_ALERT_FLAG_ENFORCE;
+        alert.protocol = flow.protocol;
+        alert.port = flow.dst_port;
+        std::memcpy(alert.addr, flow.src_addr, sizeof(alert.addr));
+        ++model_counters_.flagged;
+        raise_alert(alert, static_cast<uint64_t>(flow.last_time * 1e9));
+    }
+}
+
+void CaptureWorker::account_poll(int delivered) {
+    ++counters_.polls;
+    if (delivered > 0) {
+        ++counters_.batches;
+        const int bucket = 31 - __builtin_clz(static_cast<unsigned>(delivered));
+        ++counters_.batch_sizes[std::min(bucket, SNIFFER_BATCH_BUCKETS - 1)];
+    }
+    if (counters_.polls % SOURCE_DROPS_POLLS == 0) {
+        counters_.kernel_drops += backend_->take_drops();
+    }
+}
+
+/**
+ * Publishes this poll's counters: relaxed stores to lines only this thread
+ * writes, so a stats reader never costs the capture path a cache miss.
+ */
+void CaptureWorker::publish_stats() {
+    capture_stats_.packets.store(counters_.packets, std::memory_order_relaxed);
+    capture_stats_.bytes.store(counters_.bytes, std::memory_order_relaxed);
+    capture_stats_.kernel_drops.store(counters_.kernel_drops, std::memory_order_relaxed);
+    capture_stats_.polls.store(counters_.polls, std::memory_order_relaxed);
+    capture_stats_.batches.store(counters_.batches, std::memory_order_relaxed);
+    for (int b = 0; b < SNIFFER_BATCH_BUCKETS; ++b) {
+        capture_stats_.batch_sizes[b].store(counters_.batch_sizes[b], std::memory_order_relaxed);
+    }
+
+    if (filter_ != nullptr) {
+        shed_stats_.filter_packets.store(shed_counters_.filter_packets, std::memory_order_relaxed);
+        shed_stats_.filter_bytes.store(shed_counters_.filter_bytes, std::memory_order_relaxed);
+        shed_stats_.rule_packets.store(shed_counters_.rule_packets, std::memory_order_relaxed);
+        shed_stats_.rule_bytes.store(shed_counters_.rule_bytes, std::memory_order_relaxed);
+        for (size_t r = 0; r < filter_->rules().size(); ++r) {
+            shed_stats_.rule_hits[r].store(shed_counters_.rule_hits[r], std::memory_order_relaxed);
+        }
+    }
+
+    sketch_stats_.packets.store(sketch_->packets(), std::memory_order_relaxed);
+    sketch_stats_.windows.store(sketch_->windows(), std::memory_order_relaxed);
+    sketch_stats_.alerts.store(sketch_alerts_, std::memory_order_relaxed);
+
+    model_stats_.flows.store(model_counters_.flows, std::memory_order_relaxed);
+    model_stats_.flagged.store(model_counters_.flagged, std::memory_order_relaxed);
+    model_stats_.batches.store(model_counters_.batches, std::memory_order_relaxed);
+    model_stats_.score_ns.store(model_counters_.score_ns, std::memory_order_relaxed);
+    for (int c = 0; c < SNIFFER_MODEL_MAX_CLASSES; ++c) {
+        model_stats_.class_counts[c].store(model_counters_.class_counts[c], std::memory_order_relaxed);
+    }
+
+    const FlowTableCounters& counters = flow_table_->counters();
+    flow_stats_.active.store(flow_table_->size(), std::memory_order_relaxed);
+    flow_stats_.rejected.store(counters.rejected, std::memory_order_relaxed);
+    flow_stats_.expired_active.store(counters.expired_active, std::memory_order_relaxed);
+    flow_stats_.expired_idle.store(counters.expired_idle, std::memory_order_relaxed);
+    flow_stats_.closed.store(counters.closed, std::memory_order_relaxed);
+    flow_stats_.evicted.store(counters.evicted, std::memory_order_relaxed);
+}
+
+void CaptureWorker::add_flow_stats(C_FlowTableStats& stats) const {
+    stats.capacity += flow_table_->max_flows();
+    stats.active_flows += flow_stats_.active.load(std::memory_order_relaxed);
+    stats.rejected += flow_stats_.rejected.load(std::memory_order_relaxed);
+    stats.expired_active += flow_stats_.expired_active.load(std::memory_order_relaxed);
+    stats.expired_idle += flow_stats_.expired_idle.load(std::memory_order_relaxed);
+    stats.closed += flow_stats_.closed.load(std::memory_order_relaxed);
+    stats.evicted += flow_stats_.evicted.load(std::memory_order_relaxed);
+}
+
+void CaptureWorker::add_flow_log_stats(C_FlowLogStats& stats) const {
+    flow_log_.add_stats(stats);
+}
+
+void CaptureWorker::add_model_stats(C_FlowModelStats& stats) const {
+    stats.flows += model_stats_.flows.load(std::memory_order_relaxed);
+    stats.flagged += model_stats_.flagged.load(std::memory_order_relaxed);
+    stats.batches += model_stats_.batches.load(std::memory_order_relaxed);
+    stats.score_ns += model_stats_.score_ns.load(std::memory_order_relaxed);
+    for (int c = 0; c < SNIFFER_MODEL_MAX_CLASSES; ++c) {
+        stats.class_counts[c] += model_stats_.class_counts[c].load(std::memory_order_relaxed);
+    }
+}
+
+bool CaptureWorker::sketch_snapshot(C_SketchStats& stats, SketchWindow& window) const {
+    stats.windows += sketch_stats_.windows.load(std::memory_order_relaxed);
+    stats.packets += sketch_stats_.packets.load(std::memory_order_relaxed);
+    stats.alerts += sketch_stats_.alerts.load(std::memory_order_relaxed);
+    stats.alerts_dropped += alerts_->dropped();
+    stats.callback_dropped += callback_alerts_->dropped();
+    std::lock_guard<std::mutex> lock(window_mutex_);
+    if (!published_window_) {
+        return false;
+    }
+    window = *published_window_;
+    return true;
+}
+
+void CaptureWorker::add_shed_stats(C_ShedStats& stats) const {
+    stats.filter_packets += shed_stats_.filter_packets.load(std::memory_order_relaxed);
+    stats.filter_bytes += shed_stats_.filter_bytes.load(std::memory_order_relaxed);
+    stats.rule_packets += shed_stats_.rule_packets.load(std::memory_order_relaxed);
+    stats.rule_bytes += shed_stats_.rule_bytes.load(std::memory_order_relaxed);
+    for (int r = 0; r < SNIFFER_MAX_SHED_RULES; ++r) {
+        stats.rule_hits[r] += shed_stats_.rule_hits[r].load(std::memory_order_relaxed);
+    }
+    if (kernel_filter_.load(std::memory_order_relaxed)) {
+        stats.kernel_filter = 1;
+    }
+    stats.rule_count = std::max(stats.rule_count, shed_stats_.rule_count.load(std::memory_order_relaxed));
+}
+
+void CaptureWorker::fill_stats(C_WorkerStats& stats) const {
+    stats = C_WorkerStats{};
+    stats.queue_id = index_;
+    stats.cpu = cpu_;
+    stats.packets = capture_stats_.packets.load(std::memory_order_relaxed);
+    stats.bytes = capture_stats_.bytes.load(std::memory_order_relaxed);
+    stats.kernel_drops = capture_stats_.kernel_drops.load(std::memory_order_relaxed);
+    stats.frame_ring_drops = frames_->dropped();
+    stats.record_ring_drops = records_->dropped();
+    stats.payload_ring_drops = payloads_->dropped();
+    stats.flow_ring_drops = flows_->dropped();
+    stats.flows_active = flow_stats_.active.load(std::memory_order_relaxed);
+    stats.flows_evicted = flow_stats_.evicted.load(std::memory_order_relaxed);
+    stats.polls = capture_stats_.polls.load(std::memory_order_relaxed);
+    stats.batches = capture_stats_.batches.load(std::memory_order_relaxed);
+    for (int b = 0; b < SNIFFER_BATCH_BUCKETS; ++b) {
+        stats.batch_sizes[b] = capture_stats_.batch_sizes[b].load(std::memory_order_relaxed);
+    }
+}
+
+void CaptureWorker::merge_latency(int stage, C_LatencyHistogram& into) const {
+    if (stage == SNIFFER_LAT_CAPTURE_TO_PUBLISH) {
+        publish_latency_.merge_into(into);
+    } else if (stage == SNIFFER_LAT_FLOW_UPDATE) {
+        flow_update_latency_.merge_into(into);
+    }
+}
@@ -0,0 +1,453 @@
+#ifndef CAPTURE_WORKER_H
+#define CAPTURE_WORKER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "capture_backend.h"
+#include "config_slot.h"
+#include "consumer_wakeup.h"
+#include "flow_flag_set.h"
+#include "flow_log.h"
+#include "flow_model.h"
+#include "flow_table.h"
+#include "latency_histogram.h"
+#include "memory_arena.h"
+#include "packet_batch.h"
+#include "shared_ring.h"
+#include "sniffer_engine.h"
+#include "traffic_sketch.h"
+
+/**
+ * @brief The set_sketch_alert_callback() target. Capture workers never call
+ * it: they queue alerts on their own SPSC lane (CaptureWorker::
+ * callback_alerts()) and notify(); one engine thread drains the lanes and
+ * runs the callback (see CaptureEngine::dispatch_alerts()), so whatever
+ * the callback does (bans, syscalls, table rebuilds) never stalls capture.
+ * set() waits out a call that is running.
+ */
+class AlertSink {
+public:
+    void set(sniffer_alert_callback callback, void* context) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        callback_ = callback;
+        context_ = context;
+        armed_.store(callback != nullptr, std::memory_order_relaxed);
+    }
+
+    // Workers only queue alerts while a callback is set.
+    bool armed() const { return armed_.load(std::memory_order_relaxed); }
+
+    // Dispatcher side: the callback for each of alerts[0, count).
+    void deliver(const C_SketchAlert* alerts, size_t count) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; callback_ != nullptr && i < count; ++i) {
+            callback_(&alerts[i], context_);
+        }
+    }
+
+    // Wakes the dispatcher when it sleeps (workers: after queueing).
+    ConsumerWakeup& wakeup() const { return wakeup_; }
+
+private:
+    std::mutex mutex_;   // Only set() and the dispatcher take it
+    std::atomic<bool> armed_{false};
+    sniffer_alert_callback callback_ = nullptr;
+    void* context_ = nullptr;
+    mutable ConsumerWakeup wakeup_;
+};
+
+/**
+ * @brief What a reload swaps in as one piece (see reload_dataplane_config()):
+ * published whole through EngineControl::dataplane and immutable after, so
+ * a worker never runs with half of one config and half of the next.
+ */
+struct DataplaneConfig {
+    // Flow expiry, same meaning as FlowAnalyzer's time_window rules
+    FlowTimeouts flow_timeouts{5000000000ull, 10000000000ull, 1000000000ull};
+    // Traffic sketches, see set_sketch_config() (window 0 = off)
+    SketchSettings sketch;
+    // Shedding, see set_capture_filter() / set_shed_rules() (null = none)
+    std::shared_ptr<const CaptureFilter> filter;
+};
+
+/**
+ * @brief Engine-wide switches read by every capture worker.
+ */
+struct EngineControl {
+    std::atomic<bool> stop{false};             // Signals the capture loops to leave (drain, then park or exit)
+    std::atomic<bool> keep_warm{false};        // On stop: park with the source and rings kept, instead of exiting
+    // Payload sampling, see set_payload_policy()
+    std::atomic<int> payload_mode{SNIFFER_PAYLOAD_OFF};
+    std::atomic<uint32_t> payload_bytes{C_PAYLOAD_SNAPSHOT_BYTES};  // Snapshot at most this much of a frame
+    std::atomic<uint32_t> payload_packets{0};                       // Per flow; 0 = no limit
+    FlowFlagSet payload_flows;                                      // Flows flag_flow_payload() asked for
+    // Flow timeouts, sketches and shedding; workers switch at their next poll
+    ConfigSlot<DataplaneConfig> dataplane;
+    mutable AlertSink alert_sink;
+    // Classifier of finished flows, see set_flow_model() (none by default)
+    FlowModelSlot flow_model;
+    // Wakes the reader parked in wait_for_data(); the workers signal it too.
+    mutable ConsumerWakeup wakeup;
+};
+
+/**
+ * @brief Flow ring slot: the exported record plus when the table exported it
+ * (for the export-to-read latency; readers only copy out the record).
+ */
+struct ExportedFlow {
+    C_FlowRecord record;
+    uint64_t export_ns;   // latency_clock_ns() at export
+};
+
+/**
+ * @brief One capture thread with its own backend instance and rings.
+ *
+ * The thread pins itself to its CPU before it opens the backend or
+ * allocates anything, so the kernel ring, the user rings and the flow table are
+ * first-touched (and therefore placed) on that CPU's NUMA node. A flow's
+ * packets stay on this core from the kernel ring to the record ring.
+ *
+ * Frames are parsed in place, a PacketBatch at a time, and accounted to
+ * their flows in the worker's own FlowTable (fanout keeps a flow on one
+ * worker, so no locking); finished flows are published to the flow ring as
+ * C_FlowRecords and, with a flow model set, scored on this thread once per
+ * poll, the flagged ones raising C_ALERT_MODEL alerts.
+ *
+ * The rings are single-producer (this thread) / single-consumer (the
+ * engine's read_batch / read_flows caller).
+ *
+ * Everything the worker owns that is sized by traffic (rings, flow table,
+ * sketches) is carved out of one MemoryArena of memory_bytes() reserved
+ * when the thread starts, so its footprint is fixed for the whole run.
+ *
+ * Lifecycle: STARTING -> CAPTURING until EngineControl::stop, then the
+ * worker drains what its source has already captured and either EXITs
+ * (closing the source) or, with keep_warm, PARKs with the source open and
+ * the rings and flow table intact until resume() or request_exit().
+ */
+class CaptureWorker {
+public:
+    // Records published with one release store, at most (see flush_records()).
+    static constexpr uint32_t PUBLISH_BATCH_MAX = PacketBatch::MAX;
+
+    // Bounds of the flow table a memory budget can buy.
+    static constexpr size_t MIN_FLOW_TABLE_SLOTS = 1024;
+    static constexpr size_t MAX_FLOW_TABLE_SLOTS = size_t(1) << 26;
+
+    // Result of start()'s future when the worker's memory could not be reserved.
+    static constexpr int NO_MEMORY = -12;
+
+    /**
+     * @brief Bytes a worker reserves with a flow table of flow_table_slots
+     * (the rings and sketches are fixed).
+     */
+    static size_t memory_bytes(size_t flow_table_slots);
+
+    /**
+     * @brief The largest flow table that fits in budget_bytes along with
+     * the fixed structures, or 0 if not even the smallest one does.
+     */
+    static size_t flow_table_slots_for(uint64_t budget_bytes);
+
+    /**
+     * @param record_storage Caller-owned record slots (MAX_BUFFER_SLOTS), or
+     *        nullptr to allocate them on the worker's node.
+     * @param shared_lane Where every record is also published for other
+     *        processes (see set_shared_ring()); detached by default.
+     * @param flow_log Opened writers of the streams this worker logs (see
+     *        set_flow_log()); sealed when the thread exits.
+     */
+    CaptureWorker(unsigned index, int cpu, std::unique_ptr<CaptureBackend> backend,
+                  std::string source, const CaptureOptions& options,
+                  C_PacketData* record_storage, const EngineControl& control,
+                  SharedRingWriter shared_lane = SharedRingWriter(),
+                  FlowLogLanes flow_log = FlowLogLanes());
+
+    enum Phase : int { STARTING, CAPTURING, PARKED, EXITED };
+
+    /**
+     * @brief Starts the thread; the future resolves with the backend's open() result.
+     */
+    std::future<int> start(const std::shared_ptr<CaptureWorker>& self);
+
+    Phase phase() const { return static_cast<Phase>(phase_.load(std::memory_order_acquire)); }
+
+    /**
+     * @brief Waits until the worker has parked or exited after a stop.
+     * @return false if it was still capturing/draining at the deadline.
+     */
+    bool wait_stopped(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @brief Waits until the thread has left run() (see request_exit()).
+     */
+    bool wait_exited(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @brief Sends a parked worker back to capturing (clear the stop flag first).
+     */
+    void resume();
+
+    /**
+     * @brief Makes a parked worker (or one about to park) exit instead.
+     */
+    void request_exit();
+
+    /**
+     * @brief Joins the thread once the worker has exited.
+     */
+    void join();
+
+    unsigned index() const { return index_; }
+    const char* backend_name() const { return backend_->name(); }
+
+    /**
+     * @brief True once the rings exist (set before the open result is reported).
+     */
+    bool ready() const { return ready_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief True from start() until the capture thread has parked or exited.
+     */
+    bool running() const {
+        const Phase current = phase();
+        return current == STARTING || current == CAPTURING;
+    }
+
+    // Bytes the worker reserved / carved out of them (valid once ready()).
+    size_t memory_budget() const { return arena_.capacity(); }
+    size_t memory_used() const { return arena_.used(); }
+
+    // Valid once ready(); owned by this worker.
+    ConcurrentRingBuffer<C_PacketData>& records() { return *records_; }
+    ConcurrentRingBuffer<C_PayloadSnapshot>& payloads() { return *payloads_; }
+    ConcurrentRingBuffer<CapturedPacket>& frames() { return *frames_; }
+    ConcurrentRingBuffer<ExportedFlow>& flows() { return *flows_; }
+    ConcurrentRingBuffer<C_SketchAlert>& alerts() { return *alerts_; }
+    ConcurrentRingBuffer<C_SketchAlert>& callback_alerts() { return *callback_alerts_; }
+
+    /**
+     * @brief Adds this worker's flow table occupancy and counters to *stats.
+     * Published by the capture thread on every poll; approximate when read elsewhere.
+     */
+    void add_flow_stats(C_FlowTableStats& stats) const;
+
+    /**
+     * @brief Adds what this worker's flow log writers appended to *stats.
+     */
+    void add_flow_log_stats(C_FlowLogStats& stats) const;
+
+    /**
+     * @brief Generation of the EngineControl::dataplane config this worker
+     * runs with (0 until its first poll).
+     */
+    uint64_t config_generation() const { return config_generation_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Adds this worker's flow model counters to *stats.
+     */
+    void add_model_stats(C_FlowModelStats& stats) const;
+
+    /**
+     * @brief Adds what this worker shed (see set_capture_filter / set_shed_rules) to *stats.
+     */
+    void add_shed_stats(C_ShedStats& stats) const;
+
+    /**
+     * @brief Adds this worker's sketch counters to *stats and copies out the
+     * sketch window it finished last; false if it has not finished one.
+     */
+    bool sketch_snapshot(C_SketchStats& stats, SketchWindow& window) const;
+
+    /**
+     * @brief Fills *stats with this worker's telemetry (see C_WorkerStats);
+     * reads only what the capture thread last published.
+     */
+    void fill_stats(C_WorkerStats& stats) const;
+
+    /**
+     * @brief Adds this worker's histogram of stage SNIFFER_LAT_CAPTURE_TO_PUBLISH
+     * or SNIFFER_LAT_FLOW_UPDATE to `into`; other stages are not recorded here.
+     */
+    void merge_latency(int stage, C_LatencyHistogram& into) const;
+
+    /**
+     * @brief The backend's replay progress (see CaptureBackend::replay_progress()).
+     * @return false if the source is live.
+     */
+    bool replay_progress(ReplayProgress& progress) const { return backend_->replay_progress(progress); }
+
+private:
+    void run(std::promise<int> opened);
+    void capture();
+    void drain();
+    bool park();
+    void set_phase(Phase phase);
+    void pin_to_cpu();
+    bool allocate_rings();
+    void process_frames();
+    void publish_record(const CapturedPacket& packet, size_t i);
+    bool wants_payload(const C_PacketData& record, FlowEntry* flow) const;
+    bool snapshot_payload(const CapturedPacket& packet, C_PacketData& record);  // false: payload ring full
+    void flush_records();
+    void expire_flows();
+    void wake_consumer();
+    bool update_sketch(size_t i, FlowEntry* flow, uint64_t ts_ns);
+    void raise_alert(C_SketchAlert& alert, uint64_t ts_ns);
+    void emit_flow(const FlowEntry& entry, uint64_t now_ns);
+    void refresh_dataplane();
+    void apply_filter(const std::shared_ptr<const CaptureFilter>& filter);
+    void refresh_model();
+    void score_flows();
+    void account_poll(int delivered);
+    void publish_stats();
+
+    const unsigned index_;
+    const int cpu_;
+    std::unique_ptr<CaptureBackend> backend_;
+    const std::string source_;
+    const CaptureOptions options_;
+    C_PacketData* const record_storage_;
+    const EngineControl& control_;
+
+    // Backs the rings, flow table and sketches below, so it goes last.
+    MemoryArena arena_;
+    std::unique_ptr<ConcurrentRingBuffer<CapturedPacket>> frames_;
+    std::unique_ptr<ConcurrentRingBuffer<C_PacketData>> records_;
+    std::unique_ptr<ConcurrentRingBuffer<C_PayloadSnapshot>> payloads_;
+    std::unique_ptr<ConcurrentRingBuffer<ExportedFlow>> flows_;
+    std::unique_ptr<ConcurrentRingBuffer<C_SketchAlert>> alerts_;
+    std::unique_ptr<ConcurrentRingBuffer<C_SketchAlert>> callback_alerts_;   // Drained by the alert dispatcher
+    std::unique_ptr<FlowTable> flow_table_;
+    SharedRingWriter shared_lane_;
+    FlowLogLanes flow_log_;
+    std::atomic<bool> ready_{false};
+    std::atomic<int> phase_{EXITED};
+    std::thread thread_;
+
+    // Phase changes and park/resume hand-off (control plane only)
+    std::mutex phase_mutex_;
+    std::condition_variable phase_cv_;
+    bool resume_requested_ = false;
+    bool exit_requested_ = false;
+
+    // The burst process_frames() is working through (capture thread only)
+    PacketBatch batch_;
+
+    // Producer-side counters (capture thread only)
+    uint64_t record_seq_ = 0;
+    uint64_t payload_seq_ = 0;
+    uint32_t unpublished_ = 0;
+    uint64_t woken_at_ = 0;   // record_seq_ + flows published at the last wake_consumer()
+
+    struct CaptureCounters {
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+        uint64_t kernel_drops = 0;
+        uint64_t polls = 0;
+        uint64_t batches = 0;
+        uint64_t batch_sizes[SNIFFER_BATCH_BUCKETS] = {};
+    } counters_;
+
+    // Capture counters as last published by the capture thread (plain
+    // stores; the reader never writes here)
+    struct alignas(CACHE_LINE_SIZE) PublishedCaptureStats {
+        std::atomic<uint64_t> packets{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> kernel_drops{0};
+        std::atomic<uint64_t> polls{0};
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> batch_sizes[SNIFFER_BATCH_BUCKETS] = {};
+    } capture_stats_;
+
+    // The dataplane config in force on this thread (refreshed once per poll)
+    // and its generation, published for get_dataplane_status()
+    std::shared_ptr<const DataplaneConfig> dataplane_;
+    uint64_t dataplane_generation_ = 0;
+    std::atomic<uint64_t> config_generation_{0};
+    FlowTimeouts flow_timeouts_;
+
+    // Shedding: the filter in force (null if none or empty), the one whose
+    // BPF program the kernel runs for this worker, whether this worker runs
+    // it itself, and what it shed (published like the counters above; the
+    // rule hits restart with every new rule set)
+    const CaptureFilter* filter_ = nullptr;
+    std::shared_ptr<const CaptureFilter> kernel_program_;
+    bool user_bpf_ = false;
+    std::atomic<bool> kernel_filter_{false};
+    ShedCounters shed_counters_;
+    struct alignas(CACHE_LINE_SIZE) PublishedShedStats {
+        std::atomic<uint64_t> filter_packets{0};
+        std::atomic<uint64_t> filter_bytes{0};
+        std::atomic<uint64_t> rule_packets{0};
+        std::atomic<uint64_t> rule_bytes{0};
+        std::atomic<uint64_t> rule_hits[SNIFFER_MAX_SHED_RULES] = {};
+        std::atomic<uint32_t> rule_count{0};
+    } shed_stats_;
+
+    // Traffic sketches: this thread's summaries and their settings in force,
+    // the alert count (published like the counters above), and the
+    // last finished window for readers, copied under window_mutex_ once
+    // per window
+    TrafficSketch* sketch_ = nullptr;
+    SketchSettings sketch_settings_;
+    uint64_t sketch_alerts_ = 0;
+    struct alignas(CACHE_LINE_SIZE) PublishedSketchStats {
+        std::atomic<uint64_t> packets{0};
+        std::atomic<uint64_t> windows{0};
+        std::atomic<uint64_t> alerts{0};
+    } sketch_stats_;
+    mutable std::mutex window_mutex_;
+    std::unique_ptr<SketchWindow> published_window_;  // Null until a window finished
+
+    // Flow model: the one this thread scores with and its generation, the
+    // finished flows waiting for the next scoring pass, and the counters
+    // (published like the ones above)
+    std::shared_ptr<const FlowModel> model_;
+    uint64_t model_generation_ = 0;
+    C_FlowRecord model_pending_[FlowModel::BATCH_MAX];
+    uint32_t model_pending_count_ = 0;
+    struct ModelCounters {
+        uint64_t flows = 0;
+        uint64_t flagged = 0;
+        uint64_t batches = 0;
+        uint64_t score_ns = 0;
+        uint64_t class_counts[SNIFFER_MODEL_MAX_CLASSES] = {};
+    } model_counters_;
+    struct alignas(CACHE_LINE_SIZE) PublishedModelStats {
+        std::atomic<uint64_t> flows{0};
+        std::atomic<uint64_t> flagged{0};
+        std::atomic<uint64_t> batches{0};
+        std::atomic<uint64_t> score_ns{0};
+        std::atomic<uint64_t> class_counts[SNIFFER_MODEL_MAX_CLASSES] = {};
+    } model_stats_;
+
+    // Latency stages recorded on this thread (single writer). Capture
+    // timestamps of the records awaiting their publish, so one clock read
+    // per flush times all of them; flow updates are timed 1 in
+    // FLOW_UPDATE_SAMPLE.
+    uint64_t unpublished_ts_[PUBLISH_BATCH_MAX];
+    uint64_t flow_updates_ = 0;
+    LatencyHistogram publish_latency_;
+    LatencyHistogram flow_update_latency_;
+
+    // Flow table stats as last published by the capture thread
+    struct alignas(CACHE_LINE_SIZE) PublishedFlowStats {
+        std::atomic<uint64_t> active{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> expired_active{0};
+        std::atomic<uint64_t> expired_idle{0};
+        std::atomic<uint64_t> closed{0};
+        std::atomic<uint64_t> evicted{0};
+    } flow_stats_;
+};
+
+#endif // CAPTURE_WORKER_H
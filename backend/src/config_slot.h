@@ -0,0 +1,81 @@
+#ifndef CONFIG_SLOT_H
+#define CONFIG_SLOT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "ring_buffer.h"
+
+/**
+ * @brief An immutable T handed from the control plane to the capture
+ * workers, double-buffered so that picking it up never blocks.
+ *
+ * set() writes the buffer that is not in force and then publishes it by
+ * bumping the generation; the generation's low bit says which buffer is
+ * current. A worker compares generation() against the one it holds once per
+ * poll (one atomic load) and only calls get() when it moved. get() pins the
+ * current buffer with a reader count and checks the generation did not move
+ * meanwhile, so it never waits: at worst it retries after two set() calls
+ * raced it. set() is the side that waits, for readers still copying out of
+ * the buffer it is about to overwrite (a shared_ptr copy, nanoseconds).
+ *
+ * Each reader keeps its own shared_ptr, so the T it switched from stays
+ * alive until its last reader moves on.
+ */
+template <typename T>
+class ConfigSlot {
+public:
+    /**
+     * @brief Publishes value (null is allowed) as the next generation.
+     * Control plane only; concurrent set() calls are serialized.
+     */
+    void set(std::shared_ptr<const T> value) {
+        std::lock_guard<std::mutex> lock(writer_);
+        const uint64_t next = generation_.load(std::memory_order_relaxed) + 1;
+        Buffer& spare = buffers_[next & 1];
+        // Readers that pinned the spare buffer before the last set() saw
+        // the generation move and are leaving it; wait until they have.
+        while (spare.readers.load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+        spare.value = std::move(value);
+        generation_.store(next, std::memory_order_seq_cst);
+    }
+
+    uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief The current value and, in *generation, its generation.
+     */
+    std::shared_ptr<const T> get(uint64_t* generation) const {
+        for (;;) {
+            const uint64_t current = generation_.load(std::memory_order_seq_cst);
+            const Buffer& buffer = buffers_[current & 1];
+            buffer.readers.fetch_add(1, std::memory_order_seq_cst);
+            if (generation_.load(std::memory_order_seq_cst) == current) {
+                std::shared_ptr<const T> value = buffer.value;
+                buffer.readers.fetch_sub(1, std::memory_order_release);
+                if (generation != nullptr) {
+                    *generation = current;
+                }
+                return value;
+            }
+            buffer.readers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) Buffer {
+        mutable std::atomic<uint32_t> readers{0};   // get() calls copying value
+        std::shared_ptr<const T> value;
+    };
+
+    std::mutex writer_;
+    std::atomic<uint64_t> generation_{0};
+    Buffer buffers_[2];
+};
+
+#endif // CONFIG_SLOT_H
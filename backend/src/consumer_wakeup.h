@@ -0,0 +1,103 @@
+#ifndef CONSUMER_WAKEUP_H
+#define CONSUMER_WAKEUP_H
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Wakes the engine's reader (read_batch & co.) when it sleeps.
+ *
+ * The reader parks by setting a flag and then re-checking the rings; a
+ * producer checks the flag after it published. A full fence on each side
+ * (store flag / fence / load tail, and store tail / fence / load flag)
+ * means at least one of them sees the other, so no wakeup is lost. The
+ * producer writes the eventfd only when it is the one to clear the flag:
+ * while the reader is busy, publishing costs one fence and one load.
+ *
+ * The eventfd is readable while a wakeup is pending, so it also works with
+ * select/poll/epoll (asyncio add_reader) in place of wait().
+ */
+class ConsumerWakeup {
+public:
+    ConsumerWakeup() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+    ~ConsumerWakeup() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+
+    ConsumerWakeup(const ConsumerWakeup&) = delete;
+    ConsumerWakeup& operator=(const ConsumerWakeup&) = delete;
+
+    int fd() const { return fd_; }
+
+    // ---------------------------------------------------------------
+    // Producer side (any capture worker)
+    // ---------------------------------------------------------------
+
+    /**
+     * @brief Call after publishing: signals the reader if it is parked.
+     */
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked_.load(std::memory_order_relaxed) && parked_.exchange(false, std::memory_order_acq_rel)) {
+            signal();
+        }
+    }
+
+    /**
+     * @brief Signals unconditionally (stop, or a reader that wants to leave its wait).
+     */
+    void signal() {
+        const uint64_t one = 1;
+        const ssize_t written = ::write(fd_, &one, sizeof(one));
+        (void)written;  // EAGAIN only if the counter is saturated: a wakeup is pending anyway
+    }
+
+    // ---------------------------------------------------------------
+    // Consumer side (the single reader)
+    // ---------------------------------------------------------------
+
+    /**
+     * @brief Declares the reader parked. The caller must check the rings
+     * again afterwards and only wait if they are still empty.
+     */
+    void arm() {
+        consume();
+        parked_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void disarm() {
+        parked_.store(false, std::memory_order_relaxed);
+        consume();
+    }
+
+    /**
+     * @brief Blocks until signalled or timeout_ms (-1: forever).
+     * @return 1 if signalled, 0 on timeout, -1 on error.
+     */
+    int wait(int timeout_ms) {
+        struct pollfd pfd = {fd_, POLLIN, 0};
+        const int rc = ::poll(&pfd, 1, timeout_ms);
+        return rc < 0 ? -1 : rc;
+    }
+
+private:
+    // Clears a pending wakeup (a stale one from a producer that lost the race).
+    void consume() {
+        uint64_t count;
+        const ssize_t got = ::read(fd_, &count, sizeof(count));
+        (void)got;
+    }
+
+    std::atomic<bool> parked_{false};
+    const int fd_;
+};
+
+#endif // CONSUMER_WAKEUP_H
@@ -0,0 +1,33 @@
+#ifndef FLOW_FEATURES_H
+#define FLOW_FEATURES_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "packet_schema.h"
+
+/**
+ * @brief Turns finished flow records into model input: row i of `features`
+ * ([n x C_FLOW_FEATURE_COUNT] float32, row-major) and flow_ids[i] describe
+ * records[i]. Same features as FlowAnalyzer._extract_and_normalize_features.
+ * flow_ids may be null.
+ */
+inline void compute_flow_features(const C_FlowRecord* records, size_t n, float* features,
+                                  uint64_t* flow_ids) {
+    for (size_t i = 0; i < n; ++i) {
+        const C_FlowRecord& r = records[i];
+        float* row = features + i * C_FLOW_FEATURE_COUNT;
+        const double packets = r.packet_count;
+        row[C_FEAT_PACKET_COUNT] = static_cast<float>(packets);
+        row[C_FEAT_BYTE_COUNT] = static_cast<float>(r.byte_count);
+        row[C_FEAT_DURATION] = static_cast<float>(r.last_time - r.start_time);
+        row[C_FEAT_MAX_PKT_SIZE] = static_cast<float>(r.max_pkt_size);
+        row[C_FEAT_AVG_PKT_SIZE] = packets > 0 ? static_cast<float>(r.byte_count / packets) : 0.0f;
+        row[C_FEAT_TCP_FIN] = (r.flags & C_FLOW_FLAG_FIN) ? 1.0f : 0.0f;
+        if (flow_ids) {
+            flow_ids[i] = r.flow_id;
+        }
+    }
+}
+
+#endif // FLOW_FEATURES_H
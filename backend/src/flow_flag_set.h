@@ -0,0 +1,151 @@
+#ifndef FLOW_FLAG_SET_H
+#define FLOW_FLAG_SET_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "packet_parser.h"
+
+/**
+ * @brief A bounded set of flow IDs that the control plane flags and every
+ * capture worker checks without taking a lock (SNIFFER_PAYLOAD_FLAGGED).
+ *
+ * Open addressing over FlowKeys, which are hashes already, so the low bits
+ * pick the home slot. Writers (add/remove/clear) serialise on a mutex and
+ * only ever store whole keys; readers probe with relaxed loads. A reader
+ * racing a writer may miss a flow for one packet, which only costs a sample.
+ * Removal leaves a tombstone; the table is rebuilt once those would make it
+ * too full.
+ */
+class FlowFlagSet {
+public:
+    static constexpr size_t SLOTS = 4096;
+    static constexpr size_t MAX_FLOWS = SLOTS / 2;
+
+    FlowFlagSet() {
+        for (auto& slot : slots_) {
+            slot.store(EMPTY, std::memory_order_relaxed);
+        }
+    }
+
+    FlowFlagSet(const FlowFlagSet&) = delete;
+    FlowFlagSet& operator=(const FlowFlagSet&) = delete;
+
+    bool contains(FlowKey key) const {
+        key = stored(key);
+        for (size_t i = key & MASK, probes = 0; probes < SLOTS; i = (i + 1) & MASK, ++probes) {
+            const uint64_t slot = slots_[i].load(std::memory_order_relaxed);
+            if (slot == key) {
+                return true;
+            }
+            if (slot == EMPTY) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @return false if MAX_FLOWS flows are flagged already.
+     */
+    bool add(FlowKey key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        key = stored(key);
+        if (find(key) != SLOTS) {
+            return true;
+        }
+        if (live_ >= MAX_FLOWS) {
+            return false;
+        }
+        if (live_ + tombstones_ >= MAX_FLOWS) {
+            rebuild();
+        }
+        size_t i = key & MASK;
+        while (slots_[i].load(std::memory_order_relaxed) > TOMBSTONE) {
+            i = (i + 1) & MASK;
+        }
+        if (slots_[i].load(std::memory_order_relaxed) == TOMBSTONE) {
+            --tombstones_;
+        }
+        slots_[i].store(key, std::memory_order_relaxed);
+        ++live_;
+        return true;
+    }
+
+    void remove(FlowKey key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const size_t i = find(stored(key));
+        if (i != SLOTS) {
+            slots_[i].store(TOMBSTONE, std::memory_order_relaxed);
+            --live_;
+            ++tombstones_;
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& slot : slots_) {
+            slot.store(EMPTY, std::memory_order_relaxed);
+        }
+        live_ = 0;
+        tombstones_ = 0;
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return live_;
+    }
+
+private:
+    static constexpr size_t MASK = SLOTS - 1;
+    static constexpr uint64_t EMPTY = 0;
+    static constexpr uint64_t TOMBSTONE = 1;
+
+    // Keys 0 and 1 are the markers; they share slots with 2 and 3.
+    static uint64_t stored(FlowKey key) { return key > TOMBSTONE ? key : key + 2; }
+
+    // Slot holding key, or SLOTS (caller holds the mutex).
+    size_t find(uint64_t key) const {
+        for (size_t i = key & MASK, probes = 0; probes < SLOTS; i = (i + 1) & MASK, ++probes) {
+            const uint64_t slot = slots_[i].load(std::memory_order_relaxed);
+            if (slot == key) {
+                return i;
+            }
+            if (slot == EMPTY) {
+                break;
+            }
+        }
+        return SLOTS;
+    }
+
+    // Drops the tombstones by reinserting the live keys (caller holds the mutex).
+    void rebuild() {
+        std::vector<uint64_t> keys;
+        keys.reserve(live_);
+        for (auto& slot : slots_) {
+            const uint64_t key = slot.load(std::memory_order_relaxed);
+            if (key > TOMBSTONE) {
+                keys.push_back(key);
+            }
+            slot.store(EMPTY, std::memory_order_relaxed);
+        }
+        for (const uint64_t key : keys) {
+            size_t i = key & MASK;
+            while (slots_[i].load(std::memory_order_relaxed) != EMPTY) {
+                i = (i + 1) & MASK;
+            }
+            slots_[i].store(key, std::memory_order_relaxed);
+        }
+        tombstones_ = 0;
+    }
+
+    std::atomic<uint64_t> slots_[SLOTS];
+    mutable std::mutex mutex_;
+    size_t live_ = 0;
+    size_t tombstones_ = 0;
+};
+
+#endif // FLOW_FLAG_SET_H
@@ -0,0 +1,379 @@
+// src/flow_log.cpp
+
+#include "flow_log.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief The columns of one kind of stream: where each comes from in the
+ * row the writer is handed, and which ones the index is built over.
+ */
+struct FlowLogWriter::Layout {
+    struct Column {
+        const char* name;
+        uint32_t source;   // Offset in the row
+        uint32_t width;
+        uint32_t type;
+    };
+
+    const char* stream;    // File name prefix
+    const Column* columns;
+    uint32_t column_count;
+    uint32_t time_column;
+    uint32_t hash_column;
+};
+
+namespace {
+
+constexpr size_t HEADER_BYTES = 4096;
+constexpr const char* SEGMENT_SUFFIX = ".slog";
+constexpr uint64_t RETRY_ROWS = 4096;  // Rows dropped between attempts after a failed segment
+constexpr uint32_t BLOOM_BITS = 64 * SNIFFER_LOG_BLOOM_WORDS;
+
+static_assert(sizeof(C_FlowLogHeader) <= HEADER_BYTES, "C_FlowLogHeader must fit in the header page");
+
+// Decisions are appended from this row: the alert as raised, then its reason.
+struct DecisionRow {
+    C_SketchAlert alert;
+    char reason[16];
+};
+
+#define FLOW_COLUMN(field, type) \
+    { #field, offsetof(C_FlowRecord, field), sizeof(C_FlowRecord::field), type }
+#define DECISION_COLUMN(field, type) \
+    { #field, offsetof(DecisionRow, alert) + offsetof(C_SketchAlert, field), sizeof(C_SketchAlert::field), type }
+
+const FlowLogWriter::Layout::Column FLOW_COLUMNS[] = {
+    FLOW_COLUMN(flow_id, SNIFFER_LOG_U64),
+    FLOW_COLUMN(start_time, SNIFFER_LOG_F64),
+    FLOW_COLUMN(last_time, SNIFFER_LOG_F64),
+    FLOW_COLUMN(byte_count, SNIFFER_LOG_U64),
+    FLOW_COLUMN(packet_count, SNIFFER_LOG_U32),
+    FLOW_COLUMN(max_pkt_size, SNIFFER_LOG_U32),
+    FLOW_COLUMN(src_port, SNIFFER_LOG_U16),
+    FLOW_COLUMN(dst_port, SNIFFER_LOG_U16),
+    FLOW_COLUMN(protocol, SNIFFER_LOG_U8),
+    FLOW_COLUMN(flags, SNIFFER_LOG_U8),
+    FLOW_COLUMN(queue_id, SNIFFER_LOG_U16),
+    FLOW_COLUMN(src_addr, SNIFFER_LOG_BYTES),
+    FLOW_COLUMN(dst_addr, SNIFFER_LOG_BYTES),
+};
+
+const FlowLogWriter::Layout::Column DECISION_COLUMNS[] = {
+    DECISION_COLUMN(timestamp, SNIFFER_LOG_F64),
+    DECISION_COLUMN(flow_id, SNIFFER_LOG_U64),
+    DECISION_COLUMN(estimate, SNIFFER_LOG_U64),
+    DECISION_COLUMN(threshold, SNIFFER_LOG_U64),
+    DECISION_COLUMN(kind, SNIFFER_LOG_U8),
+    DECISION_COLUMN(action, SNIFFER_LOG_U8),
+    DECISION_COLUMN(flags, SNIFFER_LOG_U8),
+    DECISION_COLUMN(protocol, SNIFFER_LOG_U8),
+    DECISION_COLUMN(port, SNIFFER_LOG_U16),
+    DECISION_COLUMN(queue_id, SNIFFER_LOG_U16),
+    DECISION_COLUMN(addr, SNIFFER_LOG_BYTES),
+    { "reason", offsetof(DecisionRow, reason), sizeof(DecisionRow::reason), SNIFFER_LOG_BYTES },
+};
+
+#undef FLOW_COLUMN
+#undef DECISION_COLUMN
+
+constexpr uint32_t count_of(const FlowLogWriter::Layout::Column* begin, const FlowLogWriter::Layout::Column* end) {
+    return static_cast<uint32_t>(end - begin);
+}
+
+const FlowLogWriter::Layout FLOW_LAYOUT = {
+    "flows", FLOW_COLUMNS, count_of(std::begin(FLOW_COLUMNS), std::end(FLOW_COLUMNS)), 2, 0,
+};
+const FlowLogWriter::Layout DECISION_LAYOUT = {
+    "decisions", DECISION_COLUMNS, count_of(std::begin(DECISION_COLUMNS), std::end(DECISION_COLUMNS)), 0, 1,
+};
+
+static_assert(sizeof(FLOW_COLUMNS) / sizeof(FLOW_COLUMNS[0]) <= SNIFFER_LOG_MAX_COLUMNS &&
+                  sizeof(DECISION_COLUMNS) / sizeof(DECISION_COLUMNS[0]) <= SNIFFER_LOG_MAX_COLUMNS,
+              "too many flow log columns");
+
+const FlowLogWriter::Layout& layout_of(uint32_t kind) {
+    return kind == SNIFFER_LOG_FLOWS ? FLOW_LAYOUT : DECISION_LAYOUT;
+}
+
+size_t round_up(size_t value, size_t unit) {
+    return (value + unit - 1) / unit * unit;
+}
+
+uint32_t rows_per_segment(uint32_t rows) {
+    const uint32_t wanted = rows != 0 ? rows : SNIFFER_LOG_DEFAULT_ROWS;
+    return static_cast<uint32_t>(round_up(wanted, SNIFFER_LOG_BLOCK_ROWS));
+}
+
+// Column offsets (and the index offset after them) of a segment of `rows` rows.
+size_t place_columns(const FlowLogWriter::Layout& layout, uint32_t rows, uint64_t* offsets) {
+    size_t offset = HEADER_BYTES;
+    for (uint32_t c = 0; c < layout.column_count; ++c) {
+        offsets[c] = offset;
+        offset = round_up(offset + static_cast<size_t>(rows) * layout.columns[c].width, CACHE_LINE_SIZE);
+    }
+    return offset;
+}
+
+int fail(const std::string& what, const char* step, int err) {
+    std::cerr << "[C++ Engine ERROR] Flow log " << what << ": " << step << " failed: " << std::strerror(err)
+              << std::endl;
+    return -err;
+}
+
+// mkdir -p
+int make_directory(const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        const std::string prefix = path.substr(0, slash);
+        if (!prefix.empty() && mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            return errno;
+        }
+        if (slash == std::string::npos) {
+            return 0;
+        }
+    }
+}
+
+inline void copy_value(uint8_t* dst, const uint8_t* src, uint32_t width) {
+    switch (width) {
+    case 1: *dst = *src; break;
+    case 2: std::memcpy(dst, src, 2); break;
+    case 4: std::memcpy(dst, src, 4); break;
+    case 8: std::memcpy(dst, src, 8); break;
+    case 16: std::memcpy(dst, src, 16); break;
+    default: std::memcpy(dst, src, width); break;
+    }
+}
+
+inline void bump(std::atomic<uint64_t>& counter, uint64_t by = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+}
+
+} // namespace
+
+// =================================================================
+// A) OPEN / CLOSE
+// =================================================================
+
+FlowLogWriter::FlowLogWriter(const FlowLogSettings& settings, uint32_t kind, uint32_t lane) :
+    settings_(settings), kind_(kind), lane_(lane), layout_(layout_of(kind)),
+    capacity_(rows_per_segment(settings.segment_rows)) {
+    index_offset_ = place_columns(layout_, capacity_, column_offsets_);
+    size_ = segment_bytes(kind, capacity_);
+}
+
+FlowLogWriter::~FlowLogWriter() {
+    close();
+}
+
+size_t FlowLogWriter::segment_bytes(uint32_t kind, uint32_t rows) {
+    uint64_t offsets[SNIFFER_LOG_MAX_COLUMNS];
+    const uint32_t capacity = rows_per_segment(rows);
+    const size_t index = place_columns(layout_of(kind), capacity, offsets);
+    return round_up(index + capacity / SNIFFER_LOG_BLOCK_ROWS * sizeof(C_FlowLogBlock), HEADER_BYTES);
+}
+
+// "flows-q3-", "decisions-ctl-", ...
+std::string FlowLogWriter::stream_prefix() const {
+    const std::string lane = lane_ == SNIFFER_LOG_CONTROL_LANE ? "ctl" : "q" + std::to_string(lane_);
+    return std::string(layout_.stream) + "-" + lane + "-";
+}
+
+std::string FlowLogWriter::segment_path(uint64_t sequence) const {
+    char number[24];
+    std::snprintf(number, sizeof(number), "%010llu", static_cast<unsigned long long>(sequence));
+    return settings_.directory + "/" + stream_prefix() + number + SEGMENT_SUFFIX;
+}
+
+/**
+ * Carries on after the stream's existing segments (from earlier runs), so
+ * sequence order stays time order and retention counts them too.
+ */
+int FlowLogWriter::open() {
+    if (const int err = make_directory(settings_.directory)) {
+        return fail(settings_.directory, "mkdir", err);
+    }
+    DIR* dir = opendir(settings_.directory.c_str());
+    if (dir == nullptr) {
+        return fail(settings_.directory, "opendir", errno);
+    }
+    const std::string prefix = stream_prefix();
+    const size_t suffix = std::strlen(SEGMENT_SUFFIX);
+    std::vector<uint64_t> existing;
+    while (const dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name.size() > prefix.size() + suffix && name.compare(0, prefix.size(), prefix) == 0 &&
+            name.compare(name.size() - suffix, suffix, SEGMENT_SUFFIX) == 0 &&
+            std::isdigit(static_cast<unsigned char>(name[prefix.size()]))) {
+            existing.push_back(std::strtoull(name.c_str() + prefix.size(), nullptr, 10));
+        }
+    }
+    closedir(dir);
+    std::sort(existing.begin(), existing.end());
+    retained_.assign(existing.begin(), existing.end());
+    next_sequence_ = existing.empty() ? 0 : existing.back() + 1;
+    return create_segment();
+}
+
+int FlowLogWriter::create_segment() {
+    const uint64_t sequence = next_sequence_;
+    const std::string path = segment_path(sequence);
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return fail(path, "open", errno);
+    }
+    // Blocks are allocated now: running out of disk fails here, not as a
+    // SIGBUS on a capture thread's store.
+    if (const int err = posix_fallocate(fd, 0, static_cast<off_t>(size_))) {
+        ::close(fd);
+        unlink(path.c_str());
+        return fail(path, "fallocate", err);
+    }
+    void* map = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    const int err = errno;
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        unlink(path.c_str());
+        return fail(path, "mmap", err);
+    }
+
+    base_ = static_cast<uint8_t*>(map);
+    header_ = reinterpret_cast<C_FlowLogHeader*>(base_);
+    blocks_ = reinterpret_cast<C_FlowLogBlock*>(base_ + index_offset_);
+    rows_ = 0;
+    ++next_sequence_;
+
+    // A new file reads as zeros: only the non-zero fields are written.
+    header_->version = SNIFFER_LOG_VERSION;
+    header_->kind = kind_;
+    header_->lane = lane_;
+    header_->sequence = sequence;
+    header_->capacity = capacity_;
+    header_->column_count = layout_.column_count;
+    header_->min_time = std::numeric_limits<double>::infinity();
+    header_->max_time = -std::numeric_limits<double>::infinity();
+    header_->index_offset = index_offset_;
+    header_->segment_size = size_;
+    header_->pid = static_cast<uint32_t>(getpid());
+    header_->time_column = layout_.time_column;
+    header_->hash_column = layout_.hash_column;
+    for (uint32_t c = 0; c < layout_.column_count; ++c) {
+        C_FlowLogColumn& column = header_->columns[c];
+        std::strncpy(column.name, layout_.columns[c].name, sizeof(column.name) - 1);
+        column.offset = column_offsets_[c];
+        column.width = layout_.columns[c].width;
+        column.type = layout_.columns[c].type;
+    }
+    __atomic_store_n(&header_->magic, SNIFFER_LOG_MAGIC, __ATOMIC_RELEASE);
+
+    bump(counters_.segments);
+    bump(counters_.bytes, size_);
+    retained_.push_back(sequence);
+    while (settings_.retain_segments != 0 && retained_.size() > settings_.retain_segments) {
+        unlink(segment_path(retained_.front()).c_str());
+        retained_.pop_front();
+    }
+    return 0;
+}
+
+void FlowLogWriter::close() {
+    if (header_ == nullptr) {
+        return;
+    }
+    __atomic_store_n(&header_->sealed, 1u, __ATOMIC_RELEASE);
+    munmap(base_, size_);
+    base_ = nullptr;
+    header_ = nullptr;
+    blocks_ = nullptr;
+}
+
+void FlowLogWriter::add_stats(C_FlowLogStats& stats) const {
+    const uint64_t rows = counters_.rows.load(std::memory_order_relaxed);
+    (kind_ == SNIFFER_LOG_FLOWS ? stats.flow_rows : stats.decision_rows) += rows;
+    stats.segments += counters_.segments.load(std::memory_order_relaxed);
+    stats.bytes += counters_.bytes.load(std::memory_order_relaxed);
+    stats.rows_lost += counters_.rows_lost.load(std::memory_order_relaxed);
+    stats.streams |= kind_;
+}
+
+// =================================================================
+// B) APPEND
+// =================================================================
+
+void FlowLogWriter::append_flow(const C_FlowRecord& record) {
+    append(reinterpret_cast<const uint8_t*>(&record), record.last_time, record.flow_id);
+}
+
+void FlowLogWriter::append_decision(const C_SketchAlert& decision, const char* reason) {
+    DecisionRow row;
+    row.alert = decision;
+    std::memset(row.reason, 0, sizeof(row.reason));
+    if (reason != nullptr) {
+        std::strncpy(row.reason, reason, sizeof(row.reason) - 1);
+    }
+    append(reinterpret_cast<const uint8_t*>(&row), decision.timestamp, decision.flow_id);
+}
+
+void FlowLogWriter::append(const uint8_t* row, double time, uint64_t hash) {
+    // first_time_ is only this segment's once it has a row (open() creates an empty one).
+    if (header_ != nullptr && (rows_ == capacity_ || (settings_.segment_seconds != 0 && rows_ != 0 &&
+                                                      time - first_time_ >= settings_.segment_seconds))) {
+        close();
+    }
+    if (header_ == nullptr) {
+        if (retry_in_ != 0) {
+            --retry_in_;
+            bump(counters_.rows_lost);
+            return;
+        }
+        if (create_segment() != 0) {
+            retry_in_ = RETRY_ROWS;
+            bump(counters_.rows_lost);
+            return;
+        }
+    }
+
+    for (uint32_t c = 0; c < layout_.column_count; ++c) {
+        const Layout::Column& column = layout_.columns[c];
+        copy_value(base_ + column_offsets_[c] + rows_ * column.width, row + column.source, column.width);
+    }
+
+    // Index: the block's time range and the flow id's Bloom bits.
+    C_FlowLogBlock& block = blocks_[rows_ / SNIFFER_LOG_BLOCK_ROWS];
+    if (rows_ % SNIFFER_LOG_BLOCK_ROWS == 0) {
+        block.min_time = block.max_time = time;
+    } else {
+        block.min_time = std::min(block.min_time, time);
+        block.max_time = std::max(block.max_time, time);
+    }
+    const uint64_t low = hash & 0xFFFFFFFFu;
+    const uint64_t high = hash >> 32;
+    for (uint64_t probe = 0; probe < SNIFFER_LOG_BLOOM_PROBES; ++probe) {
+        const uint32_t bit = static_cast<uint32_t>((low + probe * high) % BLOOM_BITS);
+        block.bloom[bit >> 6] |= 1ull << (bit & 63);
+    }
+    if (rows_ == 0) {
+        first_time_ = time;
+    }
+    header_->min_time = std::min(header_->min_time, time);
+    header_->max_time = std::max(header_->max_time, time);
+
+    ++rows_;
+    __atomic_store_n(&header_->rows, rows_, __ATOMIC_RELEASE);
+    bump(counters_.rows);
+}
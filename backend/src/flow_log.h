@@ -0,0 +1,148 @@
+#ifndef FLOW_LOG_H
+#define FLOW_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "packet_schema.h"
+#include "ring_buffer.h"
+#include "sniffer_engine.h"
+
+/**
+ * @brief What set_flow_log() asked for; the next cold start opens it.
+ */
+struct FlowLogSettings {
+    std::string directory;
+    uint32_t streams = 0;          // SNIFFER_LOG_FLOWS | SNIFFER_LOG_DECISIONS
+    uint32_t segment_rows = SNIFFER_LOG_DEFAULT_ROWS;
+    uint32_t segment_seconds = 0;
+    uint32_t retain_segments = 0;
+
+    bool enabled() const { return !directory.empty() && streams != 0; }
+
+    bool operator==(const FlowLogSettings& other) const {
+        return directory == other.directory && streams == other.streams && segment_rows == other.segment_rows &&
+               segment_seconds == other.segment_seconds && retain_segments == other.retain_segments;
+    }
+    bool operator!=(const FlowLogSettings& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Appends rows of one stream (one kind, one lane) to its segment
+ * files, in the format sniffer_engine.h documents.
+ *
+ * Each column of a row is a copy into the segment mapping, plus a time
+ * range and three Bloom bits for its index block; no syscall until the
+ * segment is full (or spans segment_seconds), when the writer seals it and
+ * creates the next one (open + fallocate + mmap, once per segment_rows
+ * rows). Files are preallocated, so a full disk fails that step instead of
+ * faulting a capture thread on a write; the rows that find no segment are
+ * counted as lost and the writer tries again a few thousand rows later.
+ *
+ * Not thread-safe: one writer per capture worker stream, only ever used by
+ * that worker's thread (or under a lock, for the control-plane stream).
+ * The counters may be read from anywhere.
+ */
+class FlowLogWriter {
+public:
+    FlowLogWriter(const FlowLogSettings& settings, uint32_t kind, uint32_t lane);
+    ~FlowLogWriter();
+
+    FlowLogWriter(const FlowLogWriter&) = delete;
+    FlowLogWriter& operator=(const FlowLogWriter&) = delete;
+
+    /**
+     * @brief Creates the directory if needed and the stream's first segment,
+     * numbered after the ones already there.
+     * @return 0, or -errno of the step that failed (logged).
+     */
+    int open();
+
+    void append_flow(const C_FlowRecord& record);
+    void append_decision(const C_SketchAlert& decision, const char* reason);
+
+    /**
+     * @brief Seals the current segment; the next append starts a new one.
+     */
+    void close();
+
+    uint32_t kind() const { return kind_; }
+
+    /**
+     * @brief Adds this writer's rows, segments, bytes and losses to *stats.
+     */
+    void add_stats(C_FlowLogStats& stats) const;
+
+    /**
+     * @brief Bytes of one segment of `rows` rows of this kind (header, columns, index).
+     */
+    static size_t segment_bytes(uint32_t kind, uint32_t rows);
+
+    struct Layout;  // A stream kind's columns (flow_log.cpp)
+
+private:
+    void append(const uint8_t* row, double time, uint64_t hash);
+    int create_segment();   // Numbered next_sequence_; also applies retention
+    std::string stream_prefix() const;
+    std::string segment_path(uint64_t sequence) const;
+
+    const FlowLogSettings settings_;
+    const uint32_t kind_;
+    const uint32_t lane_;
+    const Layout& layout_;
+    const uint32_t capacity_;         // Rows per segment
+
+    // Every segment of the stream has the same layout.
+    uint64_t column_offsets_[SNIFFER_LOG_MAX_COLUMNS];
+    size_t index_offset_ = 0;
+    size_t size_ = 0;
+
+    // Current segment (null between a seal and the next append)
+    uint8_t* base_ = nullptr;
+    C_FlowLogHeader* header_ = nullptr;
+    C_FlowLogBlock* blocks_ = nullptr;
+    uint64_t rows_ = 0;
+    double first_time_ = 0.0;
+    uint64_t next_sequence_ = 0;
+    uint64_t retry_in_ = 0;           // Rows to drop before the next attempt after a failure
+    std::deque<uint64_t> retained_;   // Sequences on disk, oldest first
+
+    struct alignas(CACHE_LINE_SIZE) Counters {
+        std::atomic<uint64_t> rows{0};
+        std::atomic<uint64_t> segments{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> rows_lost{0};
+    } counters_;
+};
+
+/**
+ * @brief A capture worker's writers, one per stream it logs (null if not).
+ */
+struct FlowLogLanes {
+    std::unique_ptr<FlowLogWriter> flows;
+    std::unique_ptr<FlowLogWriter> decisions;
+
+    void close() {
+        if (flows) {
+            flows->close();
+        }
+        if (decisions) {
+            decisions->close();
+        }
+    }
+
+    void add_stats(C_FlowLogStats& stats) const {
+        if (flows) {
+            flows->add_stats(stats);
+        }
+        if (decisions) {
+            decisions->add_stats(stats);
+        }
+    }
+};
+
+#endif // FLOW_LOG_H
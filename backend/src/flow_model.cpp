@@ -0,0 +1,266 @@
+// src/flow_model.cpp
+
+#include "flow_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr size_t F = C_FLOW_FEATURE_COUNT;
+constexpr size_t B = FlowModel::BATCH_MAX;
+constexpr size_t LANES = 8;  // Rows walking one tree at a time
+constexpr uint8_t MAX_ACTION = 3;  // FirewallAction::RATE_LIMIT
+
+// Moves a cursor over the image; false once a read would run past its end.
+class ImageReader {
+public:
+    ImageReader(const void* image, size_t size) : data_(static_cast<const uint8_t*>(image)), left_(size) {}
+
+    template <typename T>
+    bool read(std::vector<T>& out, size_t count) {
+        if (count > left_ / sizeof(T)) {
+            return false;
+        }
+        out.resize(count);
+        if (count != 0) {
+            std::memcpy(out.data(), data_, count * sizeof(T));
+        }
+        data_ += count * sizeof(T);
+        left_ -= count * sizeof(T);
+        return true;
+    }
+
+    bool read(C_FlowModelHeader& header) {
+        if (left_ < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data_, sizeof(header));
+        data_ += sizeof(header);
+        left_ -= sizeof(header);
+        return true;
+    }
+
+    size_t left() const { return left_; }
+
+private:
+    const uint8_t* data_;
+    size_t left_;
+};
+
+bool all_finite(const float* values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (!std::isfinite(values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+// ====================================================================
+// A) PARSE
+// ====================================================================
+
+std::shared_ptr<const FlowModel> FlowModel::parse(const void* image, size_t size, std::string& error) {
+    ImageReader reader(image, size);
+    C_FlowModelHeader header;
+    if (image == nullptr || !reader.read(header)) {
+        error = "image is shorter than its header";
+        return nullptr;
+    }
+    if (header.magic != SNIFFER_MODEL_MAGIC || header.version != SNIFFER_MODEL_VERSION) {
+        error = "not a version " + std::to_string(SNIFFER_MODEL_VERSION) + " flow model";
+        return nullptr;
+    }
+    if (header.feature_count != F) {
+        error = "model takes " + std::to_string(header.feature_count) + " features, flows have " +
+                std::to_string(F);
+        return nullptr;
+    }
+    if (header.class_count < 2 || header.class_count > SNIFFER_MODEL_MAX_CLASSES) {
+        error = "unsupported class count " + std::to_string(header.class_count);
+        return nullptr;
+    }
+    if (!all_finite(header.feature_offset, F) || !all_finite(header.feature_scale, F) ||
+        !(header.min_confidence >= 0.0f && header.min_confidence <= 1.0f)) {
+        error = "invalid standardization or min_confidence";
+        return nullptr;
+    }
+    for (uint32_t c = 0; c < header.class_count; ++c) {
+        if (header.class_actions[c] > MAX_ACTION) {
+            error = "invalid action for class " + std::to_string(c);
+            return nullptr;
+        }
+    }
+
+    std::shared_ptr<FlowModel> model(new FlowModel());
+    model->kind_ = header.kind;
+    model->class_count_ = header.class_count;
+    std::memcpy(model->offset_, header.feature_offset, sizeof(model->offset_));
+    std::memcpy(model->scale_, header.feature_scale, sizeof(model->scale_));
+    std::memcpy(model->actions_, header.class_actions, sizeof(model->actions_));
+    model->min_confidence_ = header.min_confidence;
+    const uint32_t classes = header.class_count;
+
+    if (header.kind == SNIFFER_MODEL_TREES) {
+        std::vector<C_FlowModelNode> nodes;
+        if (header.tree_count == 0 || header.node_count > MAX_NODES || header.value_count % classes != 0 ||
+            !reader.read(model->roots_, header.tree_count) || !reader.read(nodes, header.node_count) ||
+            !reader.read(model->values_, header.value_count)) {
+            error = "tree counts do not match the image";
+            return nullptr;
+        }
+        // A reference is a later node or a whole leaf inside values[], so
+        // every walk ends at a leaf within bounds.
+        const auto valid = [&](uint32_t ref, int64_t after) {
+            if (ref & SNIFFER_MODEL_LEAF) {
+                const uint32_t offset = ref & ~SNIFFER_MODEL_LEAF;
+                return offset % classes == 0 && offset + classes <= header.value_count;
+            }
+            return static_cast<int64_t>(ref) > after && ref < header.node_count;
+        };
+        for (uint32_t root : model->roots_) {
+            if (!valid(root, -1)) {
+                error = "tree root out of range";
+                return nullptr;
+            }
+        }
+        model->nodes_.resize(header.node_count);
+        for (uint32_t n = 0; n < header.node_count; ++n) {
+            const C_FlowModelNode& node = nodes[n];
+            if (node.feature >= F || std::isnan(node.threshold) || !valid(node.left, n) ||
+                !valid(node.right, n)) {
+                error = "node " + std::to_string(n) + " is invalid";
+                return nullptr;
+            }
+            model->nodes_[n] = Node{node.threshold, node.feature, {node.left, node.right}};
+        }
+    } else if (header.kind == SNIFFER_MODEL_LINEAR) {
+        if (header.tree_count != 0 || header.node_count != 0 || header.value_count != classes * (F + 1) ||
+            !reader.read(model->values_, header.value_count)) {
+            error = "linear model counts do not match the image";
+            return nullptr;
+        }
+    } else {
+        error = "unknown model kind " + std::to_string(header.kind);
+        return nullptr;
+    }
+    if (reader.left() != 0) {
+        error = "image has " + std::to_string(reader.left()) + " trailing bytes";
+        return nullptr;
+    }
+    if (!all_finite(model->values_.data(), model->values_.size())) {
+        error = "model has non-finite values";
+        return nullptr;
+    }
+    return model;
+}
+
+// ====================================================================
+// B) SCORE
+// ====================================================================
+
+void FlowModel::score(const float* features, size_t n, uint8_t* classes, float* confidence) const {
+    n = std::min(n, B);
+    // x[f * B + i]: feature f of row i, standardized
+    alignas(64) float x[F * B];
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t f = 0; f < F; ++f) {
+            x[f * B + i] = (features[i * F + f] - offset_[f]) * scale_[f];
+        }
+    }
+    // scores[c * B + i]: class c of row i
+    alignas(64) float scores[SNIFFER_MODEL_MAX_CLASSES * B];
+    if (kind_ == SNIFFER_MODEL_TREES) {
+        score_trees(x, n, scores);
+    } else {
+        score_linear(x, n, scores);
+    }
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t best = 0;
+        for (uint32_t c = 1; c < class_count_; ++c) {
+            if (scores[c * B + i] > scores[best * B + i]) {
+                best = static_cast<uint8_t>(c);
+            }
+        }
+        classes[i] = best;
+        confidence[i] = scores[best * B + i];
+    }
+}
+
+void FlowModel::score_trees(const float* x, size_t n, float* scores) const {
+    std::fill(scores, scores + class_count_ * B, 0.0f);
+    const Node* nodes = nodes_.data();
+    for (uint32_t root : roots_) {
+        // LANES rows go down the tree together, one level per round, and a
+        // step indexes the children with the split's outcome instead of
+        // branching on it: the walks' loads overlap, nothing mispredicts.
+        for (size_t first = 0; first < n; first += LANES) {
+            const size_t lanes = std::min(LANES, n - first);
+            uint32_t ref[LANES];
+            size_t row[LANES];
+            for (size_t l = 0; l < LANES; ++l) {
+                ref[l] = root;
+                row[l] = first + std::min(l, lanes - 1);  // Spare lanes repeat the last row
+            }
+            bool walking = (root & SNIFFER_MODEL_LEAF) == 0;
+            while (walking) {
+                walking = false;
+                for (size_t l = 0; l < LANES; ++l) {
+                    const bool leaf = (ref[l] & SNIFFER_MODEL_LEAF) != 0;
+                    const Node& node = nodes[leaf ? 0 : ref[l]];
+                    const uint32_t next = node.child[!(x[node.feature * B + row[l]] <= node.threshold)];
+                    ref[l] = leaf ? ref[l] : next;
+                    walking |= (ref[l] & SNIFFER_MODEL_LEAF) == 0;
+                }
+            }
+            for (size_t l = 0; l < lanes; ++l) {
+                const float* leaf = values_.data() + (ref[l] & ~SNIFFER_MODEL_LEAF);
+                for (uint32_t c = 0; c < class_count_; ++c) {
+                    scores[c * B + first + l] += leaf[c];
+                }
+            }
+        }
+    }
+    const float scale = 1.0f / static_cast<float>(roots_.size());
+    for (size_t k = 0; k < class_count_ * B; ++k) {
+        scores[k] *= scale;
+    }
+}
+
+void FlowModel::score_linear(const float* x, size_t n, float* scores) const {
+    const float* weights = values_.data();
+    const float* bias = weights + class_count_ * F;
+    for (uint32_t c = 0; c < class_count_; ++c) {
+        float* out = scores + c * B;
+        for (size_t i = 0; i < B; ++i) {
+            out[i] = bias[c];
+        }
+        for (size_t f = 0; f < F; ++f) {
+            const float w = weights[c * F + f];
+            const float* column = x + f * B;
+            for (size_t i = 0; i < n; ++i) {
+                out[i] += w * column[i];
+            }
+        }
+    }
+    // Softmax over the classes of each row
+    for (size_t i = 0; i < n; ++i) {
+        float top = scores[i];
+        for (uint32_t c = 1; c < class_count_; ++c) {
+            top = std::max(top, scores[c * B + i]);
+        }
+        float sum = 0.0f;
+        for (uint32_t c = 0; c < class_count_; ++c) {
+            const float e = std::exp(scores[c * B + i] - top);
+            scores[c * B + i] = e;
+            sum += e;
+        }
+        for (uint32_t c = 0; c < class_count_; ++c) {
+            scores[c * B + i] /= sum;
+        }
+    }
+}
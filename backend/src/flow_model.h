@@ -0,0 +1,78 @@
+#ifndef FLOW_MODEL_H
+#define FLOW_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "config_slot.h"
+#include "packet_schema.h"
+#include "sniffer_engine.h"
+
+/**
+ * @brief A set_flow_model() image, parsed and checked once, then shared
+ * read-only by every capture worker.
+ *
+ * score() works a batch at a time. The features are standardized into a
+ * column-per-feature block first. A linear model is then a few
+ * multiply-adds per class over contiguous rows, which the compiler
+ * vectorizes. A tree ensemble is walked tree by tree: every row of the
+ * batch goes down one tree before the next tree is loaded, so the nodes in
+ * use stay in L1 however large the forest is, and eight rows walk it side
+ * by side with branch-free steps (random splits defeat branch prediction).
+ */
+class FlowModel {
+public:
+    static constexpr size_t BATCH_MAX = 64;  // Rows per score() call
+    static constexpr uint32_t MAX_NODES = 1u << 24;
+
+    /**
+     * @brief Parses an image; every index is range-checked here, so score()
+     * never has to.
+     * @return The model, or null with the reason in *error.
+     */
+    static std::shared_ptr<const FlowModel> parse(const void* image, size_t size, std::string& error);
+
+    /**
+     * @brief Classifies n (<= BATCH_MAX) rows of C_FLOW_FEATURE_COUNT
+     * features: classes[i] is row i's most likely class, confidence[i] its score.
+     */
+    void score(const float* features, size_t n, uint8_t* classes, float* confidence) const;
+
+    uint32_t kind() const { return kind_; }
+    uint32_t class_count() const { return class_count_; }
+    uint8_t action(uint8_t cls) const { return actions_[cls]; }
+    float min_confidence() const { return min_confidence_; }
+
+private:
+    FlowModel() = default;
+
+    // A C_FlowModelNode with its children indexable by the split's outcome
+    struct Node {
+        float threshold;
+        uint32_t feature;
+        uint32_t child[2];   // [x[feature] > threshold]
+    };
+
+    void score_trees(const float* x, size_t n, float* scores) const;
+    void score_linear(const float* x, size_t n, float* scores) const;
+
+    uint32_t kind_ = 0;
+    uint32_t class_count_ = 0;
+    float offset_[C_FLOW_FEATURE_COUNT] = {};
+    float scale_[C_FLOW_FEATURE_COUNT] = {};
+    uint8_t actions_[SNIFFER_MODEL_MAX_CLASSES] = {};
+    float min_confidence_ = 0.0f;
+
+    std::vector<uint32_t> roots_;
+    std::vector<Node> nodes_;
+    std::vector<float> values_;   // Leaf scores, or the weights then the biases
+};
+
+// The model in force, handed from the control plane to the workers (null
+// when none); a worker switches at its next poll.
+using FlowModelSlot = ConfigSlot<FlowModel>;
+
+#endif // FLOW_MODEL_H
@@ -0,0 +1,179 @@
+// src/flow_table.cpp
+
+#include "flow_table.h"
+#include "ring_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace {
+
+size_t table_capacity(size_t slots) {
+    return ring_capacity_for(slots);
+}
+
+size_t pool_capacity(size_t slots) {
+    return table_capacity(slots) / 4 * 3;
+}
+
+std::unique_ptr<MemoryArena> reserved_arena(size_t bytes) {
+    std::unique_ptr<MemoryArena> arena(new MemoryArena);
+    if (!arena->reserve(bytes)) {
+        throw std::bad_alloc();
+    }
+    return arena;
+}
+
+} // namespace
+
+size_t FlowTable::bytes_for(size_t slots) {
+    return MemoryArena::bytes_for<Bucket>(table_capacity(slots)) +
+           MemoryArena::bytes_for<FlowEntry>(pool_capacity(slots)) +
+           MemoryArena::bytes_for<uint32_t>(pool_capacity(slots)) + TimerWheel::bytes_for(pool_capacity(slots));
+}
+
+FlowTable::FlowTable(size_t slots) : FlowTable(slots, reserved_arena(bytes_for(slots))) {}
+
+FlowTable::FlowTable(size_t slots, MemoryArena& arena) : FlowTable(slots, arena, nullptr) {}
+
+FlowTable::FlowTable(size_t slots, std::unique_ptr<MemoryArena>&& own_arena) :
+    FlowTable(slots, *own_arena, std::move(own_arena)) {}
+
+FlowTable::FlowTable(size_t slots, MemoryArena& arena, std::unique_ptr<MemoryArena>&& own_arena) :
+    own_arena_(std::move(own_arena)),
+    mask_(table_capacity(slots) - 1),
+    max_flows_(pool_capacity(slots)),
+    buckets_(arena.allocate<Bucket>(mask_ + 1)),
+    entries_(arena.allocate<FlowEntry>(max_flows_)),
+    free_(arena.allocate<uint32_t>(max_flows_)),
+    wheel_(max_flows_, arena) {
+    for (size_t i = 0; i <= mask_; ++i) {
+        buckets_[i].ref = TimerWheel::NONE;
+    }
+    // Hand out low indices first so a lightly loaded table stays compact.
+    for (size_t i = max_flows_; i > 0; --i) {
+        free_[free_count_++] = static_cast<uint32_t>(i - 1);
+    }
+}
+
+uint64_t FlowTable::deadline_ns(const FlowEntry& entry, const FlowTimeouts& timeouts) {
+    uint64_t deadline = std::min(entry.first_ns + timeouts.active_ns, entry.last_ns + timeouts.idle_ns);
+    if (entry.flags & C_FLOW_FLAG_RST) {
+        deadline = std::min(deadline, entry.close_ns);
+    } else if (entry.flags & C_FLOW_FLAG_FIN) {
+        deadline = std::min(deadline, entry.close_ns + timeouts.close_ns);
+    }
+    return deadline;
+}
+
+size_t FlowTable::find_bucket(FlowKey key, const FlowTuple& tuple, bool& found) const {
+    const uint32_t tag = tag_of(key);
+    size_t bucket = tag & mask_;
+    while (buckets_[bucket].ref != TimerWheel::NONE) {
+        // The pool entry is only touched on a tag match.
+        if (buckets_[bucket].tag == tag && entries_[buckets_[bucket].ref].tuple == tuple) {
+            found = true;
+            return bucket;
+        }
+        bucket = (bucket + 1) & mask_;
+    }
+    found = false;
+    return bucket;
+}
+
+uint32_t FlowTable::insert(FlowKey key, const FlowTuple& tuple, uint64_t ts_ns, size_t bucket) {
+    const uint32_t ref = free_[--free_count_];
+    buckets_[bucket].tag = tag_of(key);
+    buckets_[bucket].ref = ref;
+    ++size_;
+
+    FlowEntry& entry = entries_[ref];
+    entry.tuple = tuple;
+    entry.key = key;
+    entry.first_ns = ts_ns;
+    entry.last_ns = ts_ns;
+    entry.bytes = 0;
+    entry.close_ns = 0;
+    entry.packets = 0;
+    entry.max_size = 0;
+    entry.flags = tuple.ip_version == 6 ? C_FLOW_FLAG_IPV6 : 0;
+    entry.sketch_alerts = 0;
+    entry.payload_snaps = 0;
+    return ref;
+}
+
+void FlowTable::account(uint32_t ref, uint8_t tcp_flags, uint32_t length, uint64_t ts_ns,
+                        const FlowTimeouts& timeouts) {
+    FlowEntry& entry = entries_[ref];
+    entry.last_ns = std::max(entry.last_ns, ts_ns);
+    ++entry.packets;
+    entry.bytes += length;
+    entry.max_size = std::max(entry.max_size, length);
+
+    if (tcp_flags == 0) {
+        return;
+    }
+    if (tcp_flags & TCP_FLAG_SYN) {
+        entry.flags |= C_FLOW_FLAG_SYN;
+    }
+    const uint8_t closing = ((tcp_flags & TCP_FLAG_FIN) ? C_FLOW_FLAG_FIN : 0) |
+                            ((tcp_flags & TCP_FLAG_RST) ? C_FLOW_FLAG_RST : 0);
+    if (closing & ~entry.flags) {
+        // close_ns is the first FIN, or the RST that ended the flow.
+        if (entry.close_ns == 0 || (closing & ~entry.flags & C_FLOW_FLAG_RST)) {
+            entry.close_ns = ts_ns;
+        }
+        entry.flags |= closing;
+        // The only case where a packet moves the deadline earlier: rearm now.
+        const uint64_t tick = tick_ceil(deadline_ns(entry, timeouts));
+        if (!wheel_.scheduled(ref) || tick < wheel_.expires(ref)) {
+            wheel_.reschedule(ref, tick);
+        }
+    }
+}
+
+void FlowTable::remove(uint32_t ref) {
+    const FlowEntry& entry = entries_[ref];
+    bool found = false;
+    const size_t bucket = find_bucket(entry.key, entry.tuple, found);
+    if (found) {
+        erase_bucket(bucket);
+    }
+    wheel_.cancel(ref);
+    free_[free_count_++] = ref;
+    --size_;
+}
+
+void FlowTable::erase_bucket(size_t bucket) {
+    // Backward-shift deletion: pull later members of the probe chain into the
+    // hole until an empty bucket or an entry already at its home is found.
+    size_t hole = bucket;
+    size_t next = (hole + 1) & mask_;
+    while (buckets_[next].ref != TimerWheel::NONE) {
+        const size_t home = buckets_[next].tag & mask_;
+        // Distance from home to `next` vs. from the hole to `next` (cyclic).
+        if (((next - home) & mask_) >= ((next - hole) & mask_)) {
+            buckets_[hole] = buckets_[next];
+            hole = next;
+        }
+        next = (next + 1) & mask_;
+    }
+    buckets_[hole].ref = TimerWheel::NONE;
+}
+
+void fill_flow_record(C_FlowRecord& record, const FlowEntry& entry, uint16_t queue_id) {
+    record.flow_id = entry.key;
+    record.start_time = entry.first_ns / 1e9;
+    record.last_time = entry.last_ns / 1e9;
+    record.byte_count = entry.bytes;
+    record.packet_count = entry.packets;
+    record.max_pkt_size = entry.max_size;
+    record.src_port = entry.tuple.src_port;
+    record.dst_port = entry.tuple.dst_port;
+    record.protocol = entry.tuple.protocol;
+    record.flags = entry.flags;
+    record.queue_id = queue_id;
+    std::memcpy(record.src_addr, entry.tuple.src_addr, sizeof(record.src_addr));
+    std::memcpy(record.dst_addr, entry.tuple.dst_addr, sizeof(record.dst_addr));
+}
@@ -0,0 +1,239 @@
+#ifndef FLOW_TABLE_H
+#define FLOW_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "memory_arena.h"
+#include "packet_parser.h"
+#include "packet_schema.h"
+#include "timer_wheel.h"
+
+/**
+ * @brief Per-flow counters (the native equivalent of FlowAnalyzer's stats dict).
+ * The byte total doubles as the packet-size sum; avg = bytes / packets.
+ */
+struct FlowEntry {
+    FlowTuple tuple;
+    FlowKey key;
+    uint64_t first_ns;     // Timestamp of the first packet
+    uint64_t last_ns;      // Timestamp of the latest packet
+    uint64_t bytes;        // Sum of packet sizes
+    uint64_t close_ns;     // Timestamp of the first FIN, or of the RST (0 if neither)
+    uint32_t packets;
+    uint32_t max_size;
+    uint8_t flags;         // C_FLOW_FLAG_*
+    uint8_t sketch_alerts;   // SKETCH_FLOW_* enforcement alerts raised for it (traffic_sketch.h)
+    uint16_t payload_snaps;  // Payload snapshots taken of this flow (saturating)
+    uint8_t reserved2[4];
+};
+
+/**
+ * @brief When a flow is finished. Same rules as FlowAnalyzer (active =
+ * time_window, idle = 2 * time_window), plus a short linger after FIN so the
+ * closing ACKs still count to the flow. A RST ends the flow at once.
+ */
+struct FlowTimeouts {
+    uint64_t active_ns;
+    uint64_t idle_ns;
+    uint64_t close_ns;
+};
+
+/**
+ * @brief Why flows left the table (monotonic, owned by the table).
+ */
+struct FlowTableCounters {
+    uint64_t expired_active = 0;  // Reached the active timeout
+    uint64_t expired_idle = 0;    // Reached the idle timeout
+    uint64_t closed = 0;          // Ended by FIN (after the linger) or RST
+    uint64_t evicted = 0;         // Pushed out early because the table was full
+    uint64_t rejected = 0;        // New flows that could not be tracked at all
+};
+
+/**
+ * @brief Bounded flow table, owned and used by one capture worker.
+ *
+ * - Flows live in a fixed pool; the hash index is a separate open-addressing
+ *   array of (32-bit key tag, pool index) buckets, eight per cache line,
+ *   with linear probing and backward-shift deletion (no tombstones).
+ * - Expiry runs on a hierarchical TimerWheel: advance() only touches flows
+ *   that are due, so its cost is O(expired), not O(table). Packets never
+ *   touch the wheel unless they end the flow (FIN/RST).
+ * - When the pool is full, the flow closest to expiring is exported early
+ *   (C_FLOW_FLAG_EVICTED) to make room: pressure eviction that approximates
+ *   LRU without a per-packet list update.
+ * - Index, pool, free list and wheel are carved out of a MemoryArena once;
+ *   after construction the table never allocates, so its size is fixed
+ *   however many flows an attack opens.
+ *
+ * Not thread-safe: the worker that owns it is its only user.
+ */
+class FlowTable {
+public:
+    // Timer resolution: 2^24 ns (~16.8 ms) per wheel tick.
+    static constexpr unsigned TICK_SHIFT = 24;
+
+    /**
+     * @param slots Size of the hash index; the table tracks up to 3/4 of it.
+     * @param arena Must have bytes_for(slots) left.
+     */
+    FlowTable(size_t slots, MemoryArena& arena);
+
+    /**
+     * @brief A table with an arena of its own (e.g. for benchmarks).
+     */
+    explicit FlowTable(size_t slots);
+
+    /**
+     * @brief Arena bytes a table with `slots` index slots takes.
+     */
+    static size_t bytes_for(size_t slots);
+
+    /**
+     * @brief Accounts one packet to its flow, creating the flow if needed.
+     * If the table is full, one flow is evicted and passed to emit first.
+     * @return The flow's entry, or nullptr if it could not be tracked.
+     */
+    template <typename Emit>
+    FlowEntry* update(FlowKey key, const FlowTuple& tuple, uint8_t tcp_flags, uint32_t length,
+                      uint64_t ts_ns, const FlowTimeouts& timeouts, Emit&& emit);
+
+    template <typename Emit>
+    FlowEntry* update(FlowKey key, const ParsedPacket& packet, uint32_t length, uint64_t ts_ns,
+                      const FlowTimeouts& timeouts, Emit&& emit) {
+        return update(key, packet.tuple, packet.tcp_flags, length, ts_ns, timeouts, emit);
+    }
+
+    /**
+     * @brief Starts loading the home bucket of key, so an update() issued a
+     * few packets later does not wait on the miss (see PacketBatch).
+     */
+    void prefetch(FlowKey key) const {
+        __builtin_prefetch(&buckets_[tag_of(key) & mask_], 0, 3);
+    }
+
+    /**
+     * @brief Starts loading the entry the home bucket of key points at; call
+     * it once that bucket has had time to arrive (after prefetch()).
+     */
+    void prefetch_entry(FlowKey key) const {
+        const Bucket& bucket = buckets_[tag_of(key) & mask_];
+        if (bucket.ref != TimerWheel::NONE) {
+            __builtin_prefetch(&entries_[bucket.ref], 1, 3);
+        }
+    }
+
+    /**
+     * @brief Calls emit(entry) for every flow finished by now_ns and removes it.
+     * @return Number of flows removed.
+     */
+    template <typename Emit>
+    size_t advance(uint64_t now_ns, const FlowTimeouts& timeouts, Emit&& emit);
+
+    size_t size() const { return size_; }
+    size_t max_flows() const { return max_flows_; }
+    const FlowTableCounters& counters() const { return counters_; }
+
+private:
+    struct Bucket {
+        uint32_t tag;  // High 32 bits of the FlowKey; the low bits of the tag pick the home bucket
+        uint32_t ref;  // Pool index, or TimerWheel::NONE when empty
+    };
+
+    static uint32_t tag_of(FlowKey key) { return static_cast<uint32_t>(key >> 32); }
+    static uint64_t tick_ceil(uint64_t ns) { return (ns + (1ull << TICK_SHIFT) - 1) >> TICK_SHIFT; }
+    static uint64_t deadline_ns(const FlowEntry& entry, const FlowTimeouts& timeouts);
+
+    FlowTable(size_t slots, std::unique_ptr<MemoryArena>&& own_arena);
+    FlowTable(size_t slots, MemoryArena& arena, std::unique_ptr<MemoryArena>&& own_arena);
+
+    size_t find_bucket(FlowKey key, const FlowTuple& tuple, bool& found) const;
+    uint32_t insert(FlowKey key, const FlowTuple& tuple, uint64_t ts_ns, size_t bucket);
+    void account(uint32_t ref, uint8_t tcp_flags, uint32_t length, uint64_t ts_ns,
+                 const FlowTimeouts& timeouts);
+    void remove(uint32_t ref);
+    void erase_bucket(size_t bucket);
+
+    std::unique_ptr<MemoryArena> own_arena_;  // Only without a caller's arena
+    const size_t mask_;
+    const size_t max_flows_;
+    Bucket* const buckets_;
+    FlowEntry* const entries_;
+    uint32_t* const free_;         // Stack of unused pool indices
+    size_t free_count_ = 0;
+    TimerWheel wheel_;             // One timer per pool index
+    size_t size_ = 0;
+    FlowTableCounters counters_;
+};
+
+/**
+ * @brief Fills the exported record for a finished flow.
+ */
+void fill_flow_record(C_FlowRecord& record, const FlowEntry& entry, uint16_t queue_id);
+
+template <typename Emit>
+FlowEntry* FlowTable::update(FlowKey key, const FlowTuple& tuple, uint8_t tcp_flags, uint32_t length,
+                             uint64_t ts_ns, const FlowTimeouts& timeouts, Emit&& emit) {
+    if (!wheel_.started()) {
+        wheel_.start(ts_ns >> TICK_SHIFT);
+    }
+
+    bool found = false;
+    size_t bucket = find_bucket(key, tuple, found);
+    uint32_t ref;
+    if (found) {
+        ref = buckets_[bucket].ref;
+    } else {
+        if (free_count_ == 0) {
+            const uint32_t victim = wheel_.earliest();
+            if (victim == TimerWheel::NONE) {
+                ++counters_.rejected;
+                return nullptr;
+            }
+            entries_[victim].flags |= C_FLOW_FLAG_EVICTED;
+            emit(entries_[victim]);
+            remove(victim);
+            ++counters_.evicted;
+            // Removal shifts buckets; find the insertion point again.
+            bucket = find_bucket(key, tuple, found);
+        }
+        ref = insert(key, tuple, ts_ns, bucket);
+        wheel_.schedule(ref, tick_ceil(deadline_ns(entries_[ref], timeouts)));
+    }
+    account(ref, tcp_flags, length, ts_ns, timeouts);
+    return &entries_[ref];
+}
+
+template <typename Emit>
+size_t FlowTable::advance(uint64_t now_ns, const FlowTimeouts& timeouts, Emit&& emit) {
+    if (!wheel_.started()) {
+        wheel_.start(now_ns >> TICK_SHIFT);
+        return 0;
+    }
+
+    size_t removed = 0;
+    wheel_.advance(now_ns >> TICK_SHIFT, [&](uint32_t ref) {
+        FlowEntry& entry = entries_[ref];
+        const uint64_t deadline = deadline_ns(entry, timeouts);
+        if (deadline > now_ns) {
+            // Packets arrived since it was scheduled: just move the timer.
+            wheel_.schedule(ref, tick_ceil(deadline));
+            return;
+        }
+
+        if (entry.flags & (C_FLOW_FLAG_FIN | C_FLOW_FLAG_RST)) {
+            ++counters_.closed;
+        } else if (entry.first_ns + timeouts.active_ns <= now_ns) {
+            ++counters_.expired_active;
+        } else {
+            ++counters_.expired_idle;
+        }
+        emit(entry);
+        remove(ref);
+        ++removed;
+    });
+    return removed;
+}
+
+#endif // FLOW_TABLE_H
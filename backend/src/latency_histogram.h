@@ -0,0 +1,173 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+// =================================================================
+// A) Bucket layout (shared with Python: see traffic_sniffer.py)
+//    Log-linear, HDR-style: values below 2 * LATENCY_SUB_BUCKETS ns are
+//    exact, every power of two above is split into LATENCY_SUB_BUCKETS
+//    equal buckets (12.5% worst-case relative error). Values at or above
+//    2^(LATENCY_MAX_MSB + 1) ns (~73 minutes) land in the last bucket.
+// =================================================================
+
+#define LATENCY_SUB_BITS    3
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_MAX_MSB     42
+#define LATENCY_BUCKETS     ((LATENCY_MAX_MSB - LATENCY_SUB_BITS + 2) * LATENCY_SUB_BUCKETS)
+
+/**
+ * Snapshot of one latency histogram (nanoseconds). Snapshots of the same
+ * stage merge by adding count, sum_ns and buckets (min/max of both); two
+ * snapshots subtract the same way, which gives the histogram of a window.
+ * The percentiles are computed at snapshot time and report the upper end
+ * of the bucket they fall in.
+ */
+typedef struct C_LatencyHistogram {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t min_ns;     // 0 when count is 0
+    uint64_t max_ns;
+    uint64_t p50_ns;
+    uint64_t p90_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t buckets[LATENCY_BUCKETS];
+} C_LatencyHistogram;
+
+inline uint32_t latency_bucket_of(uint64_t ns) {
+    if (ns < 2 * LATENCY_SUB_BUCKETS) {
+        return static_cast<uint32_t>(ns);
+    }
+    const int msb = 63 - __builtin_clzll(ns);
+    if (msb > LATENCY_MAX_MSB) {
+        return LATENCY_BUCKETS - 1;
+    }
+    const uint32_t sub = static_cast<uint32_t>(ns >> (msb - LATENCY_SUB_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+    return static_cast<uint32_t>(msb - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+/**
+ * @brief Largest value that falls in bucket `index`.
+ */
+inline uint64_t latency_bucket_upper(uint32_t index) {
+    if (index < 2 * LATENCY_SUB_BUCKETS) {
+        return index;
+    }
+    const uint32_t octave = index >> LATENCY_SUB_BITS;
+    const uint64_t sub = index & (LATENCY_SUB_BUCKETS - 1);
+    const uint64_t lower = (LATENCY_SUB_BUCKETS + sub) << (octave - 1);
+    return lower + (uint64_t(1) << (octave - 1)) - 1;
+}
+
+/**
+ * @brief Value at quantile q (0..1) of a snapshot's buckets, clamped to its max.
+ */
+inline uint64_t latency_quantile(const C_LatencyHistogram& histogram, double q) {
+    if (histogram.count == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(histogram.count) + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, histogram.count));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += histogram.buckets[i];
+        if (seen >= rank) {
+            return std::min(latency_bucket_upper(i), histogram.max_ns);
+        }
+    }
+    return histogram.max_ns;
+}
+
+/**
+ * @brief Fills the percentile fields once the buckets of a snapshot are summed.
+ */
+inline void finish_latency_snapshot(C_LatencyHistogram& histogram) {
+    histogram.p50_ns = latency_quantile(histogram, 0.50);
+    histogram.p90_ns = latency_quantile(histogram, 0.90);
+    histogram.p99_ns = latency_quantile(histogram, 0.99);
+    histogram.p999_ns = latency_quantile(histogram, 0.999);
+}
+
+/**
+ * @brief The clock capture timestamps use (CLOCK_REALTIME, via the vDSO),
+ * so stages that start at a packet's timestamp can be measured against it.
+ */
+inline uint64_t latency_clock_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// =================================================================
+// B) Recorder
+// =================================================================
+
+/**
+ * @brief Single-writer latency histogram.
+ *
+ * One thread records (a capture worker, the reader thread, a data-path
+ * thread); recording is a few plain relaxed stores to memory only that
+ * thread writes, never a locked add. Any thread may merge a snapshot
+ * concurrently; it sees every value recorded before the loads, and
+ * count/sum/buckets may be a few values apart while recording goes on.
+ */
+class LatencyHistogram {
+public:
+    /**
+     * @brief Records end - start; a start after end (clock step) counts as 0.
+     */
+    void record_span(uint64_t start_ns, uint64_t end_ns) {
+        record(end_ns > start_ns ? end_ns - start_ns : 0);
+    }
+
+    void record(uint64_t ns) {
+        bump(buckets_[latency_bucket_of(ns)], 1);
+        bump(count_, 1);
+        bump(sum_ns_, ns);
+        if (ns > max_ns_.load(std::memory_order_relaxed)) {
+            max_ns_.store(ns, std::memory_order_relaxed);
+        }
+        if (ns < min_ns_.load(std::memory_order_relaxed)) {
+            min_ns_.store(ns, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Adds this histogram to `into` (call finish_latency_snapshot()
+     * when every source is merged). `into` starts zeroed.
+     */
+    void merge_into(C_LatencyHistogram& into) const {
+        if (count_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        const uint64_t min_ns = min_ns_.load(std::memory_order_relaxed);
+        into.min_ns = into.count == 0 ? min_ns : std::min(into.min_ns, min_ns);
+        into.max_ns = std::max(into.max_ns, max_ns_.load(std::memory_order_relaxed));
+        into.sum_ns += sum_ns_.load(std::memory_order_relaxed);
+        // Count what the buckets hold, so the percentiles add up even while
+        // the writer records.
+        for (uint32_t i = 0; i < LATENCY_BUCKETS; ++i) {
+            const uint64_t n = buckets_[i].load(std::memory_order_relaxed);
+            into.buckets[i] += n;
+            into.count += n;
+        }
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_ns_{0};
+    std::atomic<uint64_t> min_ns_{UINT64_MAX};
+    std::atomic<uint64_t> max_ns_{0};
+    std::atomic<uint64_t> buckets_[LATENCY_BUCKETS] = {};
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,88 @@
+#ifndef MEMORY_ARENA_H
+#define MEMORY_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Fixed-size bump allocator over one private mapping.
+ *
+ * A capture worker reserves its whole memory budget once, on its own
+ * thread, and carves every ring, table and sketch it owns out of it: the
+ * packet path never reaches malloc (or its locks), and the worker cannot
+ * grow past the reservation however many packets or flows arrive. Pieces
+ * are never freed individually; the structures built on top recycle their
+ * own slots (free lists, ring slots) and everything goes with the arena.
+ *
+ * reserve() faults every page in from the calling thread, so a pinned
+ * worker gets node-local memory and no page fault lands on the data path;
+ * the mapping is advised for transparent huge pages.
+ *
+ * Not thread-safe: allocation is a start-up step of the owning thread.
+ */
+class MemoryArena {
+public:
+    static constexpr size_t ALIGNMENT = 64;  // Every piece starts on its own cache line
+
+    MemoryArena() = default;
+    ~MemoryArena() { release(); }
+
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+
+    /**
+     * @brief Maps and pre-faults `bytes` (rounded up to pages), replacing
+     * any previous mapping. Returns false if the memory is not available.
+     */
+    bool reserve(size_t bytes);
+
+    void release();
+
+    /**
+     * @brief Uninitialised storage for count T's.
+     * @return nullptr if the rest of the budget is too small.
+     */
+    template <typename T>
+    T* allocate(size_t count) {
+        static_assert(alignof(T) <= ALIGNMENT, "type is over-aligned for the arena");
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        const size_t bytes = bytes_for<T>(count);
+        if (bytes > capacity_ - used_) {
+            return nullptr;
+        }
+        T* storage = reinterpret_cast<T*>(base_ + used_);
+        used_ += bytes;
+        return storage;
+    }
+
+    /**
+     * @brief One T constructed in the arena, or nullptr if it does not fit.
+     */
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        T* storage = allocate<T>(1);
+        return storage != nullptr ? new (storage) T(std::forward<Args>(args)...) : nullptr;
+    }
+
+    /**
+     * @brief What allocate<T>(count) takes out of an arena; budgets are sums of these.
+     */
+    template <typename T>
+    static constexpr size_t bytes_for(size_t count) {
+        return (count * sizeof(T) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    }
+
+    size_t capacity() const { return capacity_; }
+    size_t used() const { return used_; }
+
+private:
+    uint8_t* base_ = nullptr;
+    size_t capacity_ = 0;
+    size_t mapped_ = 0;
+    size_t used_ = 0;
+};
+
+#endif // MEMORY_ARENA_H
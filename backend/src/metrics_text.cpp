@@ -0,0 +1,84 @@
+// src/metrics_text.cpp
+
+#include "metrics_text.h"
+
+#include <cinttypes>
+#include <cstdio>
+
+void MetricsText::family(const char* name, const char* type, const char* help, const char* unit) {
+    text_ += "# TYPE ";
+    text_ += name;
+    text_ += ' ';
+    text_ += type;
+    text_ += '\n';
+    if (unit != nullptr) {
+        text_ += "# UNIT ";
+        text_ += name;
+        text_ += ' ';
+        text_ += unit;
+        text_ += '\n';
+    }
+    text_ += "# HELP ";
+    text_ += name;
+    text_ += ' ';
+    text_ += help;
+    text_ += '\n';
+}
+
+void MetricsText::start_sample(const char* name, const char* suffix, const char* labels, const char* extra) {
+    text_ += name;
+    text_ += suffix;
+    const bool has_labels = labels != nullptr && labels[0] != '\0';
+    if (has_labels || extra != nullptr) {
+        text_ += '{';
+        if (has_labels) {
+            text_ += labels;
+        }
+        if (extra != nullptr) {
+            if (has_labels) {
+                text_ += ',';
+            }
+            text_ += extra;
+        }
+        text_ += '}';
+    }
+    text_ += ' ';
+}
+
+void MetricsText::sample(const char* name, const char* suffix, const char* labels, uint64_t value) {
+    start_sample(name, suffix, labels, nullptr);
+    char number[24];
+    std::snprintf(number, sizeof(number), "%" PRIu64 "\n", value);
+    text_ += number;
+}
+
+void MetricsText::sample(const char* name, const char* suffix, const char* labels, double value) {
+    start_sample(name, suffix, labels, nullptr);
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.12g\n", value);
+    text_ += number;
+}
+
+void MetricsText::histogram(const char* name, const char* labels, const C_LatencyHistogram& histogram) {
+    // Bucket uppers grow with the index, and an octave ends at 2^n - 1, so
+    // one pass accumulates every bound.
+    uint64_t cumulative = 0;
+    uint32_t index = 0;
+    char le[48];
+    char number[24];
+    for (int bits = HISTOGRAM_MIN_BITS; bits <= HISTOGRAM_MAX_BITS; ++bits) {
+        const uint64_t bound = (uint64_t(1) << bits) - 1;
+        while (index < LATENCY_BUCKETS && latency_bucket_upper(index) <= bound) {
+            cumulative += histogram.buckets[index++];
+        }
+        std::snprintf(le, sizeof(le), "le=\"%.9g\"", static_cast<double>(bound) / 1e9);
+        start_sample(name, "_bucket", labels, le);
+        std::snprintf(number, sizeof(number), "%" PRIu64 "\n", cumulative);
+        text_ += number;
+    }
+    start_sample(name, "_bucket", labels, "le=\"+Inf\"");
+    std::snprintf(number, sizeof(number), "%" PRIu64 "\n", histogram.count);
+    text_ += number;
+    sample(name, "_count", labels, histogram.count);
+    sample(name, "_sum", labels, static_cast<double>(histogram.sum_ns) / 1e9);
+}
@@ -0,0 +1,52 @@
+#ifndef METRICS_TEXT_H
+#define METRICS_TEXT_H
+
+#include <cstdint>
+#include <string>
+
+#include "latency_histogram.h"
+
+/**
+ * @brief Builds an OpenMetrics text exposition (get_metrics_text()) one
+ * family at a time.
+ *
+ * The text goes into one string that is cleared, not freed, between
+ * scrapes, so once it has grown to a scrape's size rendering allocates
+ * nothing. Labels are passed preformatted (`queue="0"`, or empty).
+ */
+class MetricsText {
+public:
+    // A latency histogram's bucket bounds: le = 2^n - 1 ns, the largest
+    // value a LatencyHistogram octave holds, for n in this range (+Inf above).
+    static constexpr int HISTOGRAM_MIN_BITS = 8;    // 255 ns
+    static constexpr int HISTOGRAM_MAX_BITS = 34;   // ~17 s
+
+    void clear() { text_.clear(); }
+    const std::string& text() const { return text_; }
+
+    /**
+     * @brief Starts family `name`: its TYPE ("counter", "gauge",
+     * "histogram"), HELP and, if given, UNIT (the name's last word).
+     */
+    void family(const char* name, const char* type, const char* help, const char* unit = nullptr);
+
+    /**
+     * @brief One sample of the current family: name + suffix ("_total",
+     * "_bucket", ...; may be empty) {labels} value.
+     */
+    void sample(const char* name, const char* suffix, const char* labels, uint64_t value);
+    void sample(const char* name, const char* suffix, const char* labels, double value);
+
+    /**
+     * @brief The samples of a histogram family in seconds, from a
+     * C_LatencyHistogram (nanoseconds): cumulative buckets, _count, _sum.
+     */
+    void histogram(const char* name, const char* labels, const C_LatencyHistogram& histogram);
+
+private:
+    void start_sample(const char* name, const char* suffix, const char* labels, const char* extra);
+
+    std::string text_;
+};
+
+#endif // METRICS_TEXT_H
@@ -0,0 +1,163 @@
+// src/packet_batch.cpp
+
+#include "packet_batch.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// =================================================================
+// A) PARSING
+// =================================================================
+
+void parse_batch(const CapturedPacket* const* frames, size_t n, PacketBatch& batch) {
+    for (size_t i = 0; i < n; ++i) {
+        const CapturedPacket& frame = *frames[i];
+        const ParsedPacket parsed = parse_packet(frame.data, frame.header.caplen);
+        batch.set_tuple(i, parsed.tuple);
+        batch.lengths[i] = frame.header.len;
+        batch.tcp_flags[i] = parsed.tcp_flags;
+        batch.state[i] = parsed.valid ? PacketBatch::IP : PacketBatch::NOT_IP;
+    }
+    batch.count = n;
+}
+
+// =================================================================
+// B) FLOW KEYS
+//    flow_key_of() per lane: five (w[i] + K[i]) * (w[i+1] + K[i+1])
+//    products summed, then fmix64. Column q of the batch holds 32-bit words
+//    2q (low half) and 2q + 1 (high half), so a lane adds
+//    (K[2q+1] << 32 | K[2q]) with 32-bit adds and multiplies its two halves
+//    with one mul_epu32.
+// =================================================================
+
+namespace {
+
+constexpr uint64_t FMIX_C1 = 0xFF51AFD7ED558CCDull;
+constexpr uint64_t FMIX_C2 = 0xC4CEB9FE1A85EC53ull;
+
+constexpr long long key_pair(size_t column) {
+    return static_cast<long long>((static_cast<uint64_t>(FLOW_HASH_KEYS[2 * column + 1]) << 32) |
+                                  FLOW_HASH_KEYS[2 * column]);
+}
+
+void flow_keys_scalar(PacketBatch& batch, size_t from) {
+    for (size_t i = from; i < batch.count; ++i) {
+        batch.keys[i] = flow_key_of(batch.tuples[i]);
+    }
+}
+
+#if defined(__x86_64__)
+
+// Low 64 bits of a * c per lane; AVX2 has no 64-bit multiply, so three
+// 32x32 products: lo*lo + ((hi*lo + lo*hi) << 32).
+__attribute__((target("avx2"))) inline __m256i mul64_avx2(__m256i a, uint64_t c) {
+    const __m256i c_lo = _mm256_set1_epi64x(static_cast<long long>(c & 0xFFFFFFFFu));
+    const __m256i c_hi = _mm256_set1_epi64x(static_cast<long long>(c >> 32));
+    const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), c_lo),
+                                           _mm256_mul_epu32(a, c_hi));
+    return _mm256_add_epi64(_mm256_mul_epu32(a, c_lo), _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2"))) void flow_keys_avx2(PacketBatch& batch) {
+    const __m256i one = _mm256_set1_epi64x(1);
+    size_t i = 0;
+    for (; i + 4 <= batch.count; i += 4) {
+        __m256i acc = _mm256_setzero_si256();
+        for (size_t column = 0; column < PacketBatch::TUPLE_WORDS; ++column) {
+            __m256i v = _mm256_load_si256(reinterpret_cast<const __m256i*>(&batch.tuple_words[column][i]));
+            v = _mm256_add_epi32(v, _mm256_set1_epi64x(key_pair(column)));
+            acc = _mm256_add_epi64(acc, _mm256_mul_epu32(v, _mm256_srli_epi64(v, 32)));
+        }
+        acc = _mm256_xor_si256(acc, _mm256_srli_epi64(acc, 33));
+        acc = mul64_avx2(acc, FMIX_C1);
+        acc = _mm256_xor_si256(acc, _mm256_srli_epi64(acc, 33));
+        acc = mul64_avx2(acc, FMIX_C2);
+        acc = _mm256_xor_si256(acc, _mm256_srli_epi64(acc, 33));
+        // Key 0 is reserved for empty slots
+        const __m256i zero = _mm256_cmpeq_epi64(acc, _mm256_setzero_si256());
+        acc = _mm256_or_si256(acc, _mm256_and_si256(zero, one));
+        _mm256_store_si256(reinterpret_cast<__m256i*>(&batch.keys[i]), acc);
+    }
+    flow_keys_scalar(batch, i);
+}
+
+__attribute__((target("avx512f,avx512dq"))) void flow_keys_avx512(PacketBatch& batch) {
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512i c1 = _mm512_set1_epi64(static_cast<long long>(FMIX_C1));
+    const __m512i c2 = _mm512_set1_epi64(static_cast<long long>(FMIX_C2));
+    size_t i = 0;
+    for (; i + 8 <= batch.count; i += 8) {
+        __m512i acc = _mm512_setzero_si512();
+        for (size_t column = 0; column < PacketBatch::TUPLE_WORDS; ++column) {
+            __m512i v = _mm512_load_si512(&batch.tuple_words[column][i]);
+            v = _mm512_add_epi32(v, _mm512_set1_epi64(key_pair(column)));
+            acc = _mm512_add_epi64(acc, _mm512_mul_epu32(v, _mm512_srli_epi64(v, 32)));
+        }
+        acc = _mm512_xor_si512(acc, _mm512_srli_epi64(acc, 33));
+        acc = _mm512_mullo_epi64(acc, c1);
+        acc = _mm512_xor_si512(acc, _mm512_srli_epi64(acc, 33));
+        acc = _mm512_mullo_epi64(acc, c2);
+        acc = _mm512_xor_si512(acc, _mm512_srli_epi64(acc, 33));
+        const __mmask8 zero = _mm512_cmpeq_epi64_mask(acc, _mm512_setzero_si512());
+        acc = _mm512_mask_mov_epi64(acc, zero, one);
+        _mm512_store_si512(&batch.keys[i], acc);
+    }
+    flow_keys_scalar(batch, i);
+}
+
+FlowKeyKernel detect_kernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+        return FlowKeyKernel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        return FlowKeyKernel::AVX2;
+    }
+    return FlowKeyKernel::SCALAR;
+}
+
+#else
+
+FlowKeyKernel detect_kernel() {
+    return FlowKeyKernel::SCALAR;
+}
+
+#endif
+
+const FlowKeyKernel g_best_kernel = detect_kernel();
+
+} // namespace
+
+FlowKeyKernel flow_key_kernel() {
+    return g_best_kernel;
+}
+
+const char* flow_key_kernel_name(FlowKeyKernel kernel) {
+    switch (kernel) {
+    case FlowKeyKernel::AVX512: return "avx512";
+    case FlowKeyKernel::AVX2: return "avx2";
+    default: return "scalar";
+    }
+}
+
+void flow_keys_batch(PacketBatch& batch) {
+    flow_keys_batch(batch, g_best_kernel);
+}
+
+void flow_keys_batch(PacketBatch& batch, FlowKeyKernel kernel) {
+    if (kernel > g_best_kernel) {
+        kernel = g_best_kernel;
+    }
+#if defined(__x86_64__)
+    if (kernel == FlowKeyKernel::AVX512) {
+        flow_keys_avx512(batch);
+        return;
+    }
+    if (kernel == FlowKeyKernel::AVX2) {
+        flow_keys_avx2(batch);
+        return;
+    }
+#endif
+    flow_keys_scalar(batch, 0);
+}
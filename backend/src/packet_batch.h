@@ -0,0 +1,79 @@
+#ifndef PACKET_BATCH_H
+#define PACKET_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "packet_parser.h"
+#include "sniffer_engine.h"
+
+/**
+ * @brief One burst of frames from a worker's frame ring, parsed into
+ * structure-of-arrays form so each pass over it (shedding, hashing,
+ * prefetching, flow updates) streams through one array.
+ *
+ * Tuples are kept twice: as rows for the flow table and the shed rules,
+ * which compare whole tuples, and as five columns of 64-bit words for the
+ * SIMD key kernels, which then load a word of 4 or 8 tuples at once
+ * instead of gathering it. Only the entries whose state is IP have a
+ * meaningful tuple, key and tcp_flags.
+ */
+struct PacketBatch {
+    static constexpr size_t MAX = 64;
+    static constexpr size_t TUPLE_WORDS = sizeof(FlowTuple) / sizeof(uint64_t);
+
+    enum State : uint8_t {
+        NOT_IP = 0,   // No IPv4/IPv6 header; the record keeps the source's rxhash
+        IP = 1,
+        SHED = 2,     // Dropped by the BPF program or a shed rule
+    };
+
+    alignas(64) FlowTuple tuples[MAX];
+    alignas(64) uint64_t tuple_words[TUPLE_WORDS][MAX];  // [w][i]: word w of tuples[i]
+    alignas(64) FlowKey keys[MAX];
+    uint32_t lengths[MAX];     // Original length on the wire
+    uint8_t tcp_flags[MAX];
+    uint8_t state[MAX];
+    size_t count = 0;
+
+    void set_tuple(size_t i, const FlowTuple& tuple) {
+        tuples[i] = tuple;
+        uint64_t words[TUPLE_WORDS];
+        std::memcpy(words, &tuple, sizeof(words));
+        for (size_t w = 0; w < TUPLE_WORDS; ++w) {
+            tuple_words[w][i] = words[w];
+        }
+    }
+};
+static_assert(sizeof(FlowTuple) == PacketBatch::TUPLE_WORDS * sizeof(uint64_t),
+              "FlowTuple must be whole 64-bit words");
+
+/**
+ * @brief Parses frames[0..n) (n <= PacketBatch::MAX) into batch, header by
+ * header as parse_packet() does. Keys are left to flow_keys_batch().
+ */
+void parse_batch(const CapturedPacket* const* frames, size_t n, PacketBatch& batch);
+
+/**
+ * @brief Instruction sets flow_keys_batch() can run on.
+ */
+enum class FlowKeyKernel { SCALAR, AVX2, AVX512 };
+
+/**
+ * @brief The widest kernel this CPU supports (resolved once, at load).
+ */
+FlowKeyKernel flow_key_kernel();
+
+const char* flow_key_kernel_name(FlowKeyKernel kernel);
+
+/**
+ * @brief batch.keys[i] = flow_key_of(batch.tuples[i]) for i < batch.count,
+ * from the tuple columns, 4 (AVX2) or 8 (AVX-512) keys per step;
+ * bit-identical to flow_key_of(). Asking for a kernel the CPU lacks runs
+ * the widest one it has.
+ */
+void flow_keys_batch(PacketBatch& batch);
+void flow_keys_batch(PacketBatch& batch, FlowKeyKernel kernel);
+
+#endif // PACKET_BATCH_H
@@ -0,0 +1,217 @@
+#ifndef PACKET_PARSER_H
+#define PACKET_PARSER_H
+
+#include <cstdint>
+#include <cstring>
+
+// Same definition as firewall_enforce.h: the 64-bit hash of a flow's 5-tuple.
+using FlowKey = uint64_t;
+
+// ====================================================================
+// A) 5-tuple
+// ====================================================================
+
+/**
+ * @brief Directional 5-tuple (src IP, dst IP, src port, dst port, protocol).
+ * IPv4 addresses are stored IPv4-mapped (::ffff:a.b.c.d) so both families
+ * share one layout. Ports are in host byte order; 0 when the protocol has
+ * none (or for non-first fragments).
+ */
+struct FlowTuple {
+    uint8_t src_addr[16];
+    uint8_t dst_addr[16];
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t protocol;
+    uint8_t ip_version;  // 4 or 6
+    uint16_t reserved;   // Always 0, so the tuple can be hashed/compared as raw words
+
+    bool operator==(const FlowTuple& other) const {
+        return std::memcmp(this, &other, sizeof(FlowTuple)) == 0;
+    }
+};
+static_assert(sizeof(FlowTuple) == 40, "FlowTuple is hashed as ten 32-bit words");
+
+// Key constants for flow_key_of(): NH-style pair products of (word + K).
+// Kept here so scalar and batched implementations agree bit for bit.
+constexpr uint32_t FLOW_HASH_KEYS[10] = {
+    0x9E3779B9u, 0x85EBCA6Bu, 0xC2B2AE35u, 0x27D4EB2Fu, 0x165667B1u,
+    0xD3A2646Cu, 0xFD7046C5u, 0xB55A4F09u, 0x68E31DA4u, 0x1B873593u,
+};
+
+/**
+ * @brief Final 64-bit avalanche (MurmurHash3 fmix64).
+ */
+inline uint64_t flow_hash_finalize(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief The FlowKey of a tuple. Never 0 (0 marks an empty flow-table slot).
+ */
+inline FlowKey flow_key_of(const FlowTuple& tuple) {
+    uint32_t words[10];
+    std::memcpy(words, &tuple, sizeof(words));
+    uint64_t acc = 0;
+    for (int i = 0; i < 10; i += 2) {
+        acc += static_cast<uint64_t>(words[i] + FLOW_HASH_KEYS[i]) *
+               static_cast<uint64_t>(words[i + 1] + FLOW_HASH_KEYS[i + 1]);
+    }
+    const FlowKey key = flow_hash_finalize(acc);
+    return key != 0 ? key : 1;
+}
+
+// ====================================================================
+// B) Header parsing straight from a captured frame
+// ====================================================================
+
+// TCP flag bits as they appear in byte 13 of the TCP header
+constexpr uint8_t TCP_FLAG_FIN = 0x01;
+constexpr uint8_t TCP_FLAG_SYN = 0x02;
+constexpr uint8_t TCP_FLAG_RST = 0x04;
+constexpr uint8_t TCP_FLAG_ACK = 0x10;
+
+constexpr uint8_t IPPROTO_TCP_NUM = 6;
+constexpr uint8_t IPPROTO_UDP_NUM = 17;
+
+/**
+ * @brief What the parser extracted from one frame.
+ */
+struct ParsedPacket {
+    FlowTuple tuple;
+    uint8_t tcp_flags;   // 0 unless TCP
+    bool valid;          // An IPv4/IPv6 packet was found
+};
+
+namespace packet_parser_detail {
+
+inline uint16_t load_be16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+inline void parse_ports(ParsedPacket& out, const uint8_t* l4, const uint8_t* end) {
+    const uint8_t proto = out.tuple.protocol;
+    if ((proto == IPPROTO_TCP_NUM || proto == IPPROTO_UDP_NUM) && l4 + 4 <= end) {
+        out.tuple.src_port = load_be16(l4);
+        out.tuple.dst_port = load_be16(l4 + 2);
+    }
+    if (proto == IPPROTO_TCP_NUM && l4 + 14 <= end) {
+        out.tcp_flags = l4[13];
+    }
+}
+
+} // namespace packet_parser_detail
+
+/**
+ * @brief parse_packet() from the network header on: an IPv4 or IPv6 packet
+ * (as `ethertype` says) of `length` captured bytes at p, e.g. a frame of a
+ * link type without Ethernet header. Never reads past p + length.
+ */
+inline ParsedPacket parse_network(uint16_t ethertype, const uint8_t* p, uint32_t length) {
+    using namespace packet_parser_detail;
+
+    ParsedPacket out;
+    std::memset(&out, 0, sizeof(out));
+    const uint8_t* const end = p + length;
+
+    if (ethertype == 0x0800) {
+        if (p + 20 > end || (p[0] >> 4) != 4) {
+            return out;
+        }
+        const uint32_t ihl = (p[0] & 0x0F) * 4u;
+        if (ihl < 20 || p + ihl > end) {
+            return out;
+        }
+        out.tuple.ip_version = 4;
+        out.tuple.protocol = p[9];
+        out.tuple.src_addr[10] = out.tuple.src_addr[11] = 0xFF;
+        out.tuple.dst_addr[10] = out.tuple.dst_addr[11] = 0xFF;
+        std::memcpy(out.tuple.src_addr + 12, p + 12, 4);
+        std::memcpy(out.tuple.dst_addr + 12, p + 16, 4);
+        out.valid = true;
+
+        // Only the first fragment carries the L4 header.
+        const bool later_fragment = (load_be16(p + 6) & 0x1FFF) != 0;
+        if (!later_fragment) {
+            parse_ports(out, p + ihl, end);
+        }
+        return out;
+    }
+
+    if (ethertype == 0x86DD) {
+        if (p + 40 > end || (p[0] >> 4) != 6) {
+            return out;
+        }
+        out.tuple.ip_version = 6;
+        std::memcpy(out.tuple.src_addr, p + 8, 16);
+        std::memcpy(out.tuple.dst_addr, p + 24, 16);
+        out.valid = true;
+
+        uint8_t next = p[6];
+        const uint8_t* l4 = p + 40;
+        // Hop-by-hop, routing, destination options and fragment headers.
+        for (int hops = 0; hops < 4; ++hops) {
+            if (next == 0 || next == 43 || next == 60) {
+                if (l4 + 8 > end) {
+                    break;
+                }
+                next = l4[0];
+                l4 += (l4[1] + 1u) * 8u;
+            } else if (next == 44) {
+                if (l4 + 8 > end) {
+                    break;
+                }
+                const bool later_fragment = (load_be16(l4 + 2) & 0xFFF8) != 0;
+                next = l4[0];
+                l4 += 8;
+                if (later_fragment) {
+                    out.tuple.protocol = next;
+                    return out;
+                }
+            } else {
+                break;
+            }
+        }
+        out.tuple.protocol = next;
+        parse_ports(out, l4, end);
+        return out;
+    }
+
+    return out;
+}
+
+/**
+ * @brief Parses Ethernet (with up to two VLAN tags), IPv4 or IPv6 (skipping
+ * the common extension headers) and TCP/UDP ports and flags.
+ * Never reads past data + caplen. Truncated or non-IP frames come back
+ * with valid == false.
+ */
+inline ParsedPacket parse_packet(const uint8_t* data, uint32_t caplen) {
+    using namespace packet_parser_detail;
+
+    if (caplen < 14) {
+        ParsedPacket out;
+        std::memset(&out, 0, sizeof(out));
+        return out;
+    }
+    const uint8_t* const end = data + caplen;
+    uint16_t ethertype = load_be16(data + 12);
+    const uint8_t* p = data + 14;
+    for (int tags = 0; tags < 2 && (ethertype == 0x8100 || ethertype == 0x88A8); ++tags) {
+        if (p + 4 > end) {
+            ParsedPacket out;
+            std::memset(&out, 0, sizeof(out));
+            return out;
+        }
+        ethertype = load_be16(p + 2);
+        p += 4;
+    }
+    return parse_network(ethertype, p, static_cast<uint32_t>(end - p));
+}
+
+#endif // PACKET_PARSER_H
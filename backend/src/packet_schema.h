@@ -0,0 +1,175 @@
+#ifndef PACKET_SCHEMA_H
+#define PACKET_SCHEMA_H
+
+// Record layouts shared by the C++ engine and every consumer (the ctypes
+// mirror in traffic_sniffer.py, future shared-memory readers).
+// This header is the single source of truth: bump SNIFFER_ABI_VERSION on
+// any layout change. Consumers check it at load time through get_abi_info()
+// and get_abi_field() instead of trusting their own copy.
+//
+// Plain C so it can be included from C, C++ and used by binding generators.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNIFFER_ABI_VERSION 5
+
+// =================================================================
+// A) Per-packet metadata record (the hot ring)
+//    32 bytes, 32-byte aligned: two records per cache line, never split.
+// =================================================================
+
+#define C_PKT_FLAG_ALERT   0x01u  // Pre-classified as suspicious
+#define C_PKT_FLAG_PAYLOAD 0x02u  // payload_ref points at a C_PayloadSnapshot
+
+#define C_PAYLOAD_NONE 0xFFFFFFFFu
+
+typedef struct __attribute__((aligned(32))) C_PacketData {
+    double   timestamp;    // 0   Capture time, seconds since the epoch
+    uint64_t flow_hash;    // 8   Hash of the packet's flow
+    uint32_t length;       // 16  Original length on the wire
+    uint16_t caplen;       // 20  Bytes captured
+    uint8_t  protocol;     // 22  IP protocol number (0 if not parsed)
+    uint8_t  flags;        // 23  C_PKT_FLAG_*
+    uint32_t payload_ref;  // 24  Low 32 bits of the payload ring sequence, or C_PAYLOAD_NONE
+    uint16_t queue_id;     // 28  Capture queue / worker that saw the packet
+    uint16_t reserved;     // 30
+} C_PacketData;
+
+// =================================================================
+// B) Optional payload snapshot record (the cold ring)
+//    Only written for the frames the payload policy samples
+//    (set_payload_policy()).
+// =================================================================
+
+#define C_PAYLOAD_SNAPSHOT_BYTES 224
+
+typedef struct __attribute__((aligned(64))) C_PayloadSnapshot {
+    uint64_t record_seq;   // 0   Sequence of the metadata record it belongs to (per queue)
+    uint64_t flow_hash;    // 8   The record's flow_hash; C_FlowRecord.flow_id of its flow
+    double   timestamp;    // 16
+    uint32_t length;       // 24  Original length on the wire
+    uint16_t caplen;       // 28  Valid bytes in data
+    uint16_t queue_id;     // 30  Capture queue; (queue_id, record_seq) names the record
+    uint8_t  data[C_PAYLOAD_SNAPSHOT_BYTES]; // 32  First caplen bytes of the frame
+} C_PayloadSnapshot;
+
+// =================================================================
+// C) Finished flow record (the flow ring)
+//    One per flow, written when the engine's flow table expires or evicts it.
+// =================================================================
+
+#define C_FLOW_FLAG_FIN  0x01u  // A TCP FIN was seen
+#define C_FLOW_FLAG_RST  0x02u  // A TCP RST was seen
+#define C_FLOW_FLAG_SYN  0x04u  // A TCP SYN was seen
+#define C_FLOW_FLAG_IPV6 0x08u  // Addresses are IPv6 (otherwise IPv4-mapped)
+#define C_FLOW_FLAG_EVICTED 0x10u  // Exported early because the flow table was full
+
+typedef struct __attribute__((aligned(16))) C_FlowRecord {
+    uint64_t flow_id;        // 0   FlowKey: 64-bit hash of the directional 5-tuple
+    double   start_time;     // 8   First packet, seconds since the epoch
+    double   last_time;      // 16  Last packet
+    uint64_t byte_count;     // 24  Sum of packet sizes
+    uint32_t packet_count;   // 32
+    uint32_t max_pkt_size;   // 36
+    uint16_t src_port;       // 40  Host byte order; 0 if the protocol has no ports
+    uint16_t dst_port;       // 42
+    uint8_t  protocol;       // 44  IP protocol number
+    uint8_t  flags;          // 45  C_FLOW_FLAG_*
+    uint16_t queue_id;       // 46  Capture worker that owned the flow
+    uint8_t  src_addr[16];   // 48  Network byte order; IPv4 as ::ffff:a.b.c.d
+    uint8_t  dst_addr[16];   // 64
+} C_FlowRecord;
+
+// =================================================================
+// D) Flow feature matrix (read_flow_features)
+//    float32, row-major [N x C_FLOW_FEATURE_COUNT], one row per finished
+//    flow, columns in the order the detection models were trained on.
+// =================================================================
+
+#define C_FEAT_PACKET_COUNT  0
+#define C_FEAT_BYTE_COUNT    1
+#define C_FEAT_DURATION      2  // Seconds, last - first packet
+#define C_FEAT_MAX_PKT_SIZE  3
+#define C_FEAT_AVG_PKT_SIZE  4
+#define C_FEAT_TCP_FIN       5  // 1.0 if a FIN was seen
+#define C_FLOW_FEATURE_COUNT 6
+
+// =================================================================
+// E) Alert record (the alert ring, the alert callback, decision log rows)
+//    Raised by a capture worker the moment a packet takes a source or a
+//    destination over a set_sketch_config() threshold (kinds 1-5), or the
+//    flow model flags a flow (C_ALERT_MODEL). The control plane writes the
+//    same record to the flow log through log_decision() (C_ALERT_DECISION).
+//
+//    estimate and threshold mean different things per kind:
+//      C_ALERT_SRC_* / C_ALERT_DST_*  estimate = packets (DST_SOURCES:
+//                                     distinct sources) counted this window,
+//                                     at least; threshold = the one crossed
+//      C_ALERT_MODEL                  estimate = the class index; threshold =
+//                                     its confidence in millionths
+//      C_ALERT_DECISION               both as the caller set them (0 unless
+//                                     it copies them from the alert it acts on)
+// =================================================================
+
+#define C_ALERT_SRC_VOLUME  1  // addr sent sketch threshold packets this window (once per source)
+#define C_ALERT_SRC_FLOW    2  // Another flow of a source already over its threshold
+#define C_ALERT_DST_VOLUME  3  // addr received threshold packets this window (once per destination)
+#define C_ALERT_DST_SOURCES 4  // addr was reached by threshold distinct sources this window
+#define C_ALERT_DST_FLOW    5  // Another flow to a destination already over a threshold
+#define C_ALERT_DECISION    6  // A log_decision() entry (the capture workers never raise it)
+#define C_ALERT_MODEL       7  // The flow model put flow_id in a class that has an action
+
+#define C_ALERT_FLAG_ENFORCE 0x01u  // Apply `action` to flow_id (enforce_flow_policy)
+
+typedef struct __attribute__((aligned(16))) C_SketchAlert {
+    uint64_t flow_id;      // 0   FlowKey of the packet or flow that raised it (its C_PacketData.flow_hash)
+    double   timestamp;    // 8   That packet's capture time
+    uint64_t estimate;     // 16  Per kind, see above (sketches: the count; MODEL: the class index)
+    uint64_t threshold;    // 24  Per kind, see above (sketches: the threshold; MODEL: confidence * 1e6)
+    uint8_t  kind;         // 32  C_ALERT_*
+    uint8_t  action;       // 33  FirewallAction to enforce (C_ALERT_FLAG_ENFORCE only)
+    uint8_t  flags;        // 34  C_ALERT_FLAG_*
+    uint8_t  protocol;     // 35  The packet's IP protocol
+    uint16_t port;         // 36  Its destination port (0 if none)
+    uint16_t queue_id;     // 38  Capture worker that raised it (SNIFFER_LOG_CONTROL_LANE for DECISION)
+    uint8_t  addr[16];     // 40  The source (SRC_*, MODEL) or destination (DST_*); IPv4 as ::ffff:a.b.c.d
+    uint64_t reserved;     // 56
+} C_SketchAlert;
+
+// =================================================================
+// F) ABI description exported by the engine
+// =================================================================
+
+typedef struct C_SnifferAbiInfo {
+    uint32_t abi_version;          // SNIFFER_ABI_VERSION the library was built with
+    uint32_t record_size;          // sizeof(C_PacketData)
+    uint32_t record_stride;        // Distance between consecutive ring slots
+    uint32_t record_align;
+    uint32_t ring_slots;           // MAX_BUFFER_SLOTS
+    uint32_t payload_record_size;  // sizeof(C_PayloadSnapshot)
+    uint32_t payload_bytes;        // C_PAYLOAD_SNAPSHOT_BYTES
+    uint32_t payload_ring_slots;
+    uint32_t field_count;          // Entries available through get_abi_field()
+    uint32_t flow_record_size;     // sizeof(C_FlowRecord)
+    uint32_t flow_ring_slots;      // Per capture worker
+    uint32_t flow_feature_count;   // C_FLOW_FEATURE_COUNT
+} C_SnifferAbiInfo;
+
+typedef struct C_AbiField {
+    const char* name;
+    uint32_t offset;
+    uint32_t size;
+} C_AbiField;
+
+#ifdef __cplusplus
+static_assert(sizeof(C_PacketData) == 32, "C_PacketData must stay 32 bytes");
+static_assert(alignof(C_PacketData) == 32, "C_PacketData must stay 32-byte aligned");
+static_assert(offsetof(C_PacketData, payload_ref) == 24, "C_PacketData layout changed; bump SNIFFER_ABI_VERSION");
+static_assert(sizeof(C_PayloadSnapshot) == 256, "C_PayloadSnapshot must stay 256 bytes");
+static_assert(sizeof(C_FlowRecord) == 80, "C_FlowRecord must stay 80 bytes");
+static_assert(offsetof(C_FlowRecord, src_addr) == 48, "C_FlowRecord layout changed; bump SNIFFER_ABI_VERSION");
+static_assert(sizeof(C_SketchAlert) == 64, "C_SketchAlert must stay 64 bytes");
+#endif
+
+#endif // PACKET_SCHEMA_H
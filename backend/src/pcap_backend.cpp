@@ -0,0 +1,565 @@
+// src/pcap_backend.cpp
+//
+// Offline replay of a pcap or pcapng file through the live capture path.
+// The file is mmap'd (and pre-faulted) once at open(); poll() walks its
+// records in place and builds each frame straight into a capture-ring slot,
+// so replay costs no per-packet file I/O or syscalls.
+//
+// Source: "<path>[@<speed>]". Speed 1 (the default) keeps the recorded
+// timing, 10 replays ten times faster, 0 replays as fast as the engine
+// takes frames. Timestamps keep the recorded spacing, rebased so the first
+// packet is "now": flow durations and rates match the capture at any speed.
+
+#include "capture_backend.h"
+#include "packet_parser.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace {
+
+// ====================================================================
+// A) pcap / pcapng record walker
+// ====================================================================
+
+// Link types the engine can parse (directly, or behind a synthetic Ethernet header).
+constexpr uint32_t LINKTYPE_ETHERNET = 1;
+constexpr uint32_t LINKTYPE_RAW_OPENBSD = 14;
+constexpr uint32_t LINKTYPE_RAW = 101;
+constexpr uint32_t LINKTYPE_LINUX_SLL = 113;
+constexpr uint32_t LINKTYPE_IPV4 = 228;
+constexpr uint32_t LINKTYPE_IPV6 = 229;
+constexpr uint32_t LINKTYPE_LINUX_SLL2 = 276;
+
+constexpr uint32_t PCAP_MAGIC_US = 0xA1B2C3D4u;
+constexpr uint32_t PCAP_MAGIC_NS = 0xA1B23C4Du;
+constexpr uint32_t PCAPNG_SHB = 0x0A0D0D0Au;
+constexpr uint32_t PCAPNG_BYTE_ORDER = 0x1A2B3C4Du;
+constexpr uint32_t PCAPNG_IDB = 1;
+constexpr uint32_t PCAPNG_PB = 2;   // Obsolete Packet Block
+constexpr uint32_t PCAPNG_SPB = 3;
+constexpr uint32_t PCAPNG_EPB = 6;
+constexpr uint16_t PCAPNG_OPT_TSRESOL = 9;
+constexpr uint16_t PCAPNG_OPT_TSOFFSET = 14;
+
+constexpr size_t MAX_INTERFACES = 64;
+
+/**
+ * @brief One packet record, pointing into the mapping.
+ */
+struct TraceRecord {
+    const uint8_t* data;
+    uint32_t caplen;
+    uint32_t len;
+    uint64_t ts_ns;
+    uint32_t linktype;
+};
+
+/**
+ * @brief Sequential reader over a mapped capture file. Understands classic
+ * pcap (us/ns, either byte order) and pcapng (any number of sections and
+ * interfaces, if_tsresol/if_tsoffset). Truncated trailing records end the file.
+ */
+class TraceReader {
+public:
+    /**
+     * @return 0, or -EINVAL if the data is neither pcap nor pcapng.
+     */
+    int reset(const uint8_t* data, size_t size) {
+        data_ = data;
+        size_ = size;
+        offset_ = 0;
+        last_ts_ns_ = 0;
+        interfaces_ = 0;
+        if (size < 24) {
+            return -EINVAL;
+        }
+        const uint32_t magic = load32_le(data);
+        if (magic == PCAPNG_SHB) {
+            pcapng_ = true;
+            return 0;
+        }
+        pcapng_ = false;
+        for (const bool swapped : {false, true}) {
+            swapped_ = swapped;
+            const uint32_t value = load32(data);
+            if (value == PCAP_MAGIC_US || value == PCAP_MAGIC_NS) {
+                pcap_nanos_ = value == PCAP_MAGIC_NS;
+                pcap_linktype_ = load32(data + 20) & 0x0FFFFFFFu;  // Upper bits: FCS length
+                offset_ = 24;
+                return 0;
+            }
+        }
+        return -EINVAL;
+    }
+
+    /**
+     * @brief Next packet record; false at the end of the file.
+     */
+    bool next(TraceRecord& record) {
+        return pcapng_ ? next_pcapng(record) : next_pcap(record);
+    }
+
+    size_t offset() const { return offset_; }
+
+private:
+    uint32_t load32_le(const uint8_t* p) const {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    uint32_t load32(const uint8_t* p) const {
+        const uint32_t value = load32_le(p);
+        return swapped_ ? __builtin_bswap32(value) : value;
+    }
+    uint16_t load16(const uint8_t* p) const {
+        uint16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return swapped_ ? __builtin_bswap16(value) : value;
+    }
+    uint64_t load64(const uint8_t* p) const {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return swapped_ ? __builtin_bswap64(value) : value;
+    }
+
+    bool next_pcap(TraceRecord& record) {
+        if (offset_ + 16 > size_) {
+            return false;
+        }
+        const uint8_t* header = data_ + offset_;
+        const uint32_t caplen = load32(header + 8);
+        if (offset_ + 16 + caplen > size_) {
+            offset_ = size_;
+            return false;
+        }
+        record.data = header + 16;
+        record.caplen = caplen;
+        record.len = load32(header + 12);
+        record.ts_ns = load32(header) * 1000000000ull + load32(header + 4) * (pcap_nanos_ ? 1ull : 1000ull);
+        record.linktype = pcap_linktype_;
+        offset_ += 16 + caplen;
+        return true;
+    }
+
+    bool next_pcapng(TraceRecord& record) {
+        while (offset_ + 12 <= size_) {
+            const uint8_t* block = data_ + offset_;
+            uint32_t type = load32_le(block);
+            if (type == PCAPNG_SHB) {
+                // New section: byte order and interfaces start over.
+                swapped_ = load32_le(block + 8) != PCAPNG_BYTE_ORDER;
+                interfaces_ = 0;
+            }
+            type = load32(block);
+            const uint32_t length = load32(block + 4);
+            if (length < 12 || (length & 3) != 0 || offset_ + length > size_) {
+                offset_ = size_;
+                return false;
+            }
+            offset_ += length;
+            const uint8_t* body = block + 8;
+            const uint32_t body_len = length - 12;
+
+            if (type == PCAPNG_IDB && body_len >= 8) {
+                add_interface(body, body_len);
+            } else if (type == PCAPNG_EPB && body_len >= 20) {
+                if (packet(record, load32(body), load32(body + 4), load32(body + 8), load32(body + 12),
+                           load32(body + 16), body + 20, body_len - 20)) {
+                    return true;
+                }
+            } else if (type == PCAPNG_PB && body_len >= 20) {
+                if (packet(record, load16(body), load32(body + 4), load32(body + 8), load32(body + 12),
+                           load32(body + 16), body + 20, body_len - 20)) {
+                    return true;
+                }
+            } else if (type == PCAPNG_SPB && body_len >= 4 && interfaces_ > 0) {
+                // No timestamp: it goes out with the previous packet's.
+                const uint32_t len = load32(body);
+                record.data = body + 4;
+                record.caplen = std::min(len, body_len - 4);
+                record.len = len;
+                record.ts_ns = last_ts_ns_;
+                record.linktype = linktypes_[0];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add_interface(const uint8_t* body, uint32_t body_len) {
+        if (interfaces_ == MAX_INTERFACES) {
+            return;
+        }
+        const size_t index = interfaces_++;
+        linktypes_[index] = load16(body);
+        ts_units_per_sec_[index] = 1000000;
+        ts_binary_[index] = false;
+        ts_offset_sec_[index] = 0;
+        uint32_t at = 8;
+        while (at + 4 <= body_len) {
+            const uint16_t code = load16(body + at);
+            const uint16_t len = load16(body + at + 2);
+            const uint8_t* value = body + at + 4;
+            if (code == 0 || at + 4 + len > body_len) {
+                break;
+            }
+            if (code == PCAPNG_OPT_TSRESOL && len >= 1) {
+                // MSB clear: 10^-n seconds; set: 2^-n seconds.
+                const uint8_t exponent = value[0] & 0x7F;
+                ts_binary_[index] = (value[0] & 0x80) != 0;
+                uint64_t units = 1;
+                for (uint8_t i = 0; i < exponent && !ts_binary_[index] && i < 19; ++i) {
+                    units *= 10;
+                }
+                ts_units_per_sec_[index] = ts_binary_[index] ? std::min<uint8_t>(exponent, 63) : units;
+            } else if (code == PCAPNG_OPT_TSOFFSET && len >= 8) {
+                ts_offset_sec_[index] = load64(value);
+            }
+            at += 4 + ((len + 3u) & ~3u);
+        }
+    }
+
+    bool packet(TraceRecord& record, uint32_t interface, uint32_t ts_high, uint32_t ts_low,
+                uint32_t caplen, uint32_t len, const uint8_t* data, uint32_t available) {
+        if (interface >= interfaces_ || caplen > available) {
+            return false;
+        }
+        const uint64_t units = (static_cast<uint64_t>(ts_high) << 32) | ts_low;
+        uint64_t ns;
+        if (ts_binary_[interface]) {
+            const unsigned shift = static_cast<unsigned>(ts_units_per_sec_[interface]);
+            const uint64_t fraction = units & ((1ull << shift) - 1);
+            ns = (units >> shift) * 1000000000ull +
+                 static_cast<uint64_t>((static_cast<unsigned __int128>(fraction) * 1000000000ull) >> shift);
+        } else {
+            const uint64_t per_sec = ts_units_per_sec_[interface];
+            ns = (units / per_sec) * 1000000000ull +
+                 static_cast<uint64_t>(static_cast<unsigned __int128>(units % per_sec) * 1000000000ull / per_sec);
+        }
+        record.data = data;
+        record.caplen = caplen;
+        record.len = len;
+        record.ts_ns = ns + static_cast<uint64_t>(ts_offset_sec_[interface]) * 1000000000ull;
+        record.linktype = linktypes_[interface];
+        last_ts_ns_ = record.ts_ns;
+        return true;
+    }
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t offset_ = 0;
+    bool pcapng_ = false;
+    bool swapped_ = false;
+    bool pcap_nanos_ = false;
+    uint32_t pcap_linktype_ = LINKTYPE_ETHERNET;
+    uint64_t last_ts_ns_ = 0;
+
+    // pcapng interfaces of the current section
+    size_t interfaces_ = 0;
+    uint32_t linktypes_[MAX_INTERFACES] = {};
+    uint64_t ts_units_per_sec_[MAX_INTERFACES] = {};  // Or the binary exponent, if ts_binary_
+    bool ts_binary_[MAX_INTERFACES] = {};
+    int64_t ts_offset_sec_[MAX_INTERFACES] = {};
+};
+
+// ====================================================================
+// B) Replay backend
+// ====================================================================
+
+class PcapBackend : public CaptureBackend {
+public:
+    // Frames per poll when replaying flat out (one AF_PACKET block's worth).
+    static constexpr int FLAT_OUT_BURST = 256;
+    // At the end of the file the trace clock jumps this far ahead so every
+    // flow still in the table expires and is exported.
+    static constexpr uint64_t END_OF_FILE_FLUSH_NS = 3600ull * 1000000000ull;
+
+    ~PcapBackend() override { close(); }
+
+    const char* name() const override { return "pcap"; }
+
+    int open(const std::string& source, const CaptureOptions& options) override {
+        std::string path = source;
+        speed_ = 1.0;
+        const size_t at = source.rfind('@');
+        if (at != std::string::npos) {
+            char* end = nullptr;
+            const double speed = std::strtod(source.c_str() + at + 1, &end);
+            if (end != source.c_str() + at + 1 && *end == '\0' && speed >= 0) {
+                path = source.substr(0, at);
+                speed_ = speed;
+            }
+        }
+        queue_index_ = options.queue_index;
+        queue_count_ = options.queue_count;
+
+        fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            return fail(path, "open", errno);
+        }
+        struct stat st;
+        if (fstat(fd_, &st) < 0) {
+            return fail(path, "fstat", errno);
+        }
+        map_size_ = static_cast<size_t>(st.st_size);
+        if (map_size_ == 0) {
+            return fail(path, "empty file", EINVAL);
+        }
+        // Pre-fault the whole file now so replay never waits on the disk.
+        void* map = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd_, 0);
+        if (map == MAP_FAILED) {
+            map_size_ = 0;
+            return fail(path, "mmap", errno);
+        }
+        map_ = static_cast<const uint8_t*>(map);
+        madvise(const_cast<uint8_t*>(map_), map_size_, MADV_SEQUENTIAL);
+        if (reader_.reset(map_, map_size_) != 0) {
+            return fail(path, "not a pcap or pcapng file", EINVAL);
+        }
+
+        path_ = path;
+        have_pending_ = false;
+        first_ts_ns_ = 0;
+        base_wall_ns_ = 0;
+        last_rebased_ns_ = 0;
+        frames_ = bytes_ = skipped_ = 0;
+        publish_progress(0);
+        started_ns_.store(0, std::memory_order_relaxed);
+        finished_ns_.store(0, std::memory_order_relaxed);
+        return 0;
+    }
+
+    int poll(FrameSink& sink, int timeout_ms) override {
+        if (finished_ns_.load(std::memory_order_relaxed) != 0) {
+            // Nothing left; idle like a quiet interface.
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+            return 0;
+        }
+        const uint64_t wall = latency_clock_ns();
+        if (base_wall_ns_ == 0) {
+            base_wall_ns_ = wall;
+            started_ns_.store(wall, std::memory_order_relaxed);
+        }
+
+        int delivered = 0;
+        while (delivered < FLAT_OUT_BURST) {
+            if (!have_pending_ && !(have_pending_ = reader_.next(pending_))) {
+                finish(wall);
+                break;
+            }
+            if (first_ts_ns_ == 0) {
+                first_ts_ns_ = pending_.ts_ns;
+            }
+            const uint64_t offset = pending_.ts_ns > first_ts_ns_ ? pending_.ts_ns - first_ts_ns_ : 0;
+            if (speed_ > 0) {
+                const uint64_t due = base_wall_ns_ + static_cast<uint64_t>(static_cast<double>(offset) / speed_);
+                if (due > wall) {
+                    if (delivered == 0) {
+                        const uint64_t wait = std::min<uint64_t>(due - wall, timeout_ms * 1000000ull);
+                        std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+                    }
+                    break;
+                }
+            }
+            const int placed = place(sink, pending_, base_wall_ns_ + offset);
+            if (placed < 0) {
+                break;  // Capture ring full: keep the frame for the next poll instead of losing it
+            }
+            have_pending_ = false;
+            delivered += placed;
+        }
+        publish_progress(reader_.offset());
+        return delivered;
+    }
+
+    uint64_t clock_ns(uint64_t wall_ns) const override {
+        if (finished_ns_.load(std::memory_order_relaxed) != 0) {
+            return last_rebased_ns_ + END_OF_FILE_FLUSH_NS;
+        }
+        if (speed_ == 0 || base_wall_ns_ == 0 || wall_ns < base_wall_ns_) {
+            return last_rebased_ns_;
+        }
+        // Trace time runs `speed` times faster than the wall clock.
+        return base_wall_ns_ + static_cast<uint64_t>(static_cast<double>(wall_ns - base_wall_ns_) * speed_);
+    }
+
+    bool replay_progress(ReplayProgress& progress) const override {
+        progress.frames = frames_out_.load(std::memory_order_relaxed);
+        progress.bytes = bytes_out_.load(std::memory_order_relaxed);
+        progress.skipped = skipped_out_.load(std::memory_order_relaxed);
+        progress.file_bytes = map_size_;
+        progress.file_offset = offset_out_.load(std::memory_order_relaxed);
+        progress.started_ns = started_ns_.load(std::memory_order_relaxed);
+        progress.finished_ns = finished_ns_.load(std::memory_order_relaxed);
+        progress.speed = speed_;
+        return true;
+    }
+
+    void close() override {
+        if (map_ != nullptr) {
+            munmap(const_cast<uint8_t*>(map_), map_size_);
+            map_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+private:
+    /**
+     * @brief Builds the frame in the next ring slot, behind a synthetic
+     * Ethernet header if the file's link type has none.
+     * @return 1 if placed, 0 if skipped (unsupported, or another queue's
+     * flow), -1 if the ring is full.
+     */
+    int place(FrameSink& sink, const TraceRecord& record, uint64_t ts_ns) {
+        const uint8_t* l3 = record.data;
+        uint32_t l3_len = record.caplen;
+        uint32_t wire_overhead = 0;
+        uint16_t ethertype = 0;
+        switch (record.linktype) {
+            case LINKTYPE_ETHERNET:
+                break;
+            case LINKTYPE_RAW:
+            case LINKTYPE_RAW_OPENBSD:
+            case LINKTYPE_IPV4:
+            case LINKTYPE_IPV6:
+                ethertype = l3_len > 0 && (l3[0] >> 4) == 6 ? 0x86DD : 0x0800;
+                wire_overhead = 14;
+                break;
+            case LINKTYPE_LINUX_SLL:
+            case LINKTYPE_LINUX_SLL2: {
+                const uint32_t header = record.linktype == LINKTYPE_LINUX_SLL ? 16 : 20;
+                const uint32_t proto_at = record.linktype == LINKTYPE_LINUX_SLL ? 14 : 0;
+                if (l3_len < header) {
+                    return skip();
+                }
+                ethertype = static_cast<uint16_t>((l3[proto_at] << 8) | l3[proto_at + 1]);
+                l3 += header;
+                l3_len -= header;
+                wire_overhead = 14 - header;
+                break;
+            }
+            default:
+                return skip();
+        }
+
+        // With several workers on one file each takes its share of the flows,
+        // decided from the mapped record, so other queues' frames are never
+        // copied. Parsed as far as the worker will see them (the snap length).
+        if (queue_count_ > 1) {
+            const ParsedPacket parsed =
+                record.linktype == LINKTYPE_ETHERNET
+                    ? parse_packet(record.data, std::min<uint32_t>(record.caplen, CapturedPacket::MAX_SNAPLEN))
+                    : parse_network(ethertype, l3, std::min<uint32_t>(l3_len, CapturedPacket::MAX_SNAPLEN - 14));
+            const uint64_t owner = parsed.valid ? flow_key_of(parsed.tuple) % queue_count_ : 0;
+            if (owner != queue_index_) {
+                return 0;
+            }
+        }
+
+        CapturedPacket* slot = sink.claim();
+        if (slot == nullptr) {
+            return -1;
+        }
+        uint32_t caplen;
+        if (record.linktype == LINKTYPE_ETHERNET) {
+            caplen = std::min<uint32_t>(record.caplen, CapturedPacket::MAX_SNAPLEN);
+            std::memcpy(slot->data, record.data, caplen);
+        } else {
+            std::memset(slot->data, 0, 12);
+            slot->data[12] = static_cast<uint8_t>(ethertype >> 8);
+            slot->data[13] = static_cast<uint8_t>(ethertype);
+            caplen = std::min<uint32_t>(l3_len, CapturedPacket::MAX_SNAPLEN - 14);
+            std::memcpy(slot->data + 14, l3, caplen);
+            caplen += 14;
+        }
+        const uint32_t len = record.len + wire_overhead;
+        slot->header.caplen = caplen;
+        slot->header.len = len;
+        slot->header.ts_sec = static_cast<uint32_t>(ts_ns / 1000000000ull);
+        slot->header.ts_nsec = static_cast<uint32_t>(ts_ns % 1000000000ull);
+        slot->rxhash = 0;
+        slot->flags = 0;
+        sink.commit();
+        last_rebased_ns_ = ts_ns;
+        ++frames_;
+        bytes_ += len;
+        return 1;
+    }
+
+    int skip() {
+        ++skipped_;
+        return 0;
+    }
+
+    void finish(uint64_t wall_ns) {
+        const uint64_t started = started_ns_.load(std::memory_order_relaxed);
+        const double seconds = static_cast<double>(wall_ns - started) / 1e9;
+        std::cout << "[C++ pcap] Replay of " << path_ << " finished (queue " << queue_index_ << "): "
+                  << frames_ << " packets in " << seconds << " s ("
+                  << (seconds > 0 ? static_cast<uint64_t>(static_cast<double>(frames_) / seconds) : 0)
+                  << " pps)." << std::endl;
+        finished_ns_.store(std::max<uint64_t>(wall_ns, 1), std::memory_order_relaxed);
+    }
+
+    // Single writer (the capture thread): plain stores, once per poll.
+    void publish_progress(uint64_t offset) {
+        frames_out_.store(frames_, std::memory_order_relaxed);
+        bytes_out_.store(bytes_, std::memory_order_relaxed);
+        skipped_out_.store(skipped_, std::memory_order_relaxed);
+        offset_out_.store(offset, std::memory_order_relaxed);
+    }
+
+    int fail(const std::string& path, const char* step, int err) {
+        std::cerr << "[C++ pcap ERROR] " << path << ": " << step << " failed: " << std::strerror(err) << std::endl;
+        close();
+        return -err;
+    }
+
+    int fd_ = -1;
+    const uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+    std::string path_;
+    TraceReader reader_;
+    double speed_ = 1.0;
+    unsigned queue_index_ = 0;
+    unsigned queue_count_ = 1;
+
+    // Capture thread only
+    TraceRecord pending_{};
+    bool have_pending_ = false;
+    uint64_t first_ts_ns_ = 0;     // Recorded timestamp of the first packet
+    uint64_t base_wall_ns_ = 0;    // Wall clock the first packet is rebased to
+    uint64_t last_rebased_ns_ = 0;
+    uint64_t frames_ = 0;
+    uint64_t bytes_ = 0;
+    uint64_t skipped_ = 0;
+
+    // Published for replay_progress()
+    std::atomic<uint64_t> frames_out_{0};
+    std::atomic<uint64_t> bytes_out_{0};
+    std::atomic<uint64_t> skipped_out_{0};
+    std::atomic<uint64_t> offset_out_{0};
+    std::atomic<uint64_t> started_ns_{0};
+    std::atomic<uint64_t> finished_ns_{0};
+};
+
+} // namespace
+
+std::unique_ptr<CaptureBackend> make_pcap_backend() {
+    return std::unique_ptr<CaptureBackend>(new PcapBackend());
+}
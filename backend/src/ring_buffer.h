@@ -0,0 +1,296 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Size of a destructive-interference unit on every x86-64 / ARMv8 part we target.
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * @brief Rounds up to the next power of two (minimum 2).
+ */
+inline size_t ring_capacity_for(size_t requested) {
+    size_t capacity = 2;
+    while (capacity < requested) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+/**
+ * @brief Largest power of two that fits in `available` slots (minimum 1):
+ * the capacity a ring can use in caller-supplied storage.
+ */
+constexpr size_t ring_capacity_within(size_t available) {
+    size_t capacity = 1;
+    while (capacity <= available / 2) {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+constexpr bool is_ring_capacity(size_t capacity) {
+    return capacity >= 1 && (capacity & (capacity - 1)) == 0;
+}
+
+/**
+ * @brief Lossless single-producer / single-consumer ring.
+ *
+ * - Capacity is a power of two; indices are free-running counters masked on use,
+ *   so every slot is usable and there is no '%' on the hot path.
+ * - The producer's and the consumer's state live on separate cache lines.
+ *   Each side keeps a private copy of the other side's index and only reloads
+ *   the shared atomic when that copy says the ring is full (or empty).
+ * - A full ring never overwrites unread slots: the new item is dropped and
+ *   counted in dropped(), so overruns are visible instead of silent.
+ * - Producer writes can be batched: enqueue() fills slots privately and a
+ *   single flush() publishes all of them with one release store.
+ * - Large items can be built and parsed in place: claim()/commit() on the
+ *   producer side and peek()/release() on the consumer side never copy T.
+ *
+ * Storage is either owned or supplied by the caller (e.g. a buffer shared
+ * with Python). The capacity is always a power of two: an owned ring rounds
+ * the request up, a ring in supplied storage uses the largest power of two
+ * that fits (callers whose layout is shared check is_ring_capacity()).
+ */
+template <typename T>
+class alignas(CACHE_LINE_SIZE) ConcurrentRingBuffer {
+public:
+    explicit ConcurrentRingBuffer(size_t capacity) :
+        owned_(new T[ring_capacity_for(capacity)]),
+        buffer_(owned_.get()), mask_(ring_capacity_for(capacity) - 1) {}
+
+    // `capacity` >= 1 slots of storage; the ring never indexes past them.
+    ConcurrentRingBuffer(T* storage, size_t capacity) :
+        buffer_(storage), mask_(ring_capacity_within(capacity) - 1) {}
+
+    ConcurrentRingBuffer(const ConcurrentRingBuffer&) = delete;
+    ConcurrentRingBuffer& operator=(const ConcurrentRingBuffer&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // ---------------------------------------------------------------
+    // Producer side
+    // ---------------------------------------------------------------
+
+    /**
+     * @brief Writes and immediately publishes one item.
+     * @return false (and counts a drop) if the ring is full.
+     */
+    bool push(const T& item) {
+        if (!enqueue(item)) {
+            return false;
+        }
+        flush();
+        return true;
+    }
+
+    /**
+     * @brief Writes one item without publishing it; see flush().
+     * @return false (and counts a drop) if the ring is full.
+     */
+    bool enqueue(const T& item) {
+        if (!has_room()) {
+            return false;
+        }
+        buffer_[pending_tail_ & mask_] = item;
+        ++pending_tail_;
+        return true;
+    }
+
+    /**
+     * @brief Publishes every enqueued item to the consumer.
+     */
+    void flush() {
+        tail_.store(pending_tail_, std::memory_order_release);
+    }
+
+    /**
+     * @brief Zero-copy write: returns the next free slot to fill in place,
+     * or nullptr (and counts a drop) if the ring is full. The slot becomes
+     * part of the ring only on commit(); calling claim() again without a
+     * commit() returns the same slot.
+     */
+    T* claim() {
+        if (!has_room()) {
+            return nullptr;
+        }
+        return &buffer_[pending_tail_ & mask_];
+    }
+
+    /**
+     * @brief Adds the slot returned by claim(); it is published by the next flush().
+     */
+    void commit() { ++pending_tail_; }
+
+    /**
+     * @brief Items enqueued but not yet published by flush().
+     */
+    size_t pending() const { return pending_tail_ - tail_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Total items rejected because the ring was full. Safe from any thread.
+     */
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Published write position (free-running). Safe from any thread.
+     */
+    size_t tail_position() const { return tail_.load(std::memory_order_acquire); }
+
+    // ---------------------------------------------------------------
+    // Consumer side
+    // ---------------------------------------------------------------
+
+    bool pop(T& item) {
+        const size_t current_head = head_.load(std::memory_order_relaxed);
+        if (current_head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (current_head == cached_tail_) {
+                // Buffer is empty
+                return false;
+            }
+        }
+
+        item = buffer_[current_head & mask_];
+        head_.store(current_head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Zero-copy read: returns the oldest published item in place, or
+     * nullptr if the ring is empty. The slot stays owned by the consumer
+     * (and untouched by the producer) until release().
+     */
+    const T* peek() {
+        const size_t current_head = head_.load(std::memory_order_relaxed);
+        if (current_head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (current_head == cached_tail_) {
+                return nullptr;
+            }
+        }
+        return &buffer_[current_head & mask_];
+    }
+
+    /**
+     * @brief Hands the slot returned by peek() back to the producer.
+     */
+    void release() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief peek() for up to max_items at once: fills items with the oldest
+     * published slots, in order. They stay the consumer's until release(count).
+     * @return Number of slots returned.
+     */
+    size_t peek_bulk(const T** items, size_t max_items) {
+        const size_t current_head = head_.load(std::memory_order_relaxed);
+        if (cached_tail_ - current_head < max_items) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+        }
+        size_t count = cached_tail_ - current_head;
+        if (count > max_items) {
+            count = max_items;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            items[i] = &buffer_[(current_head + i) & mask_];
+        }
+        return count;
+    }
+
+    /**
+     * @brief Hands the oldest count slots (from peek()/peek_bulk()) back to the producer.
+     */
+    void release(size_t count) {
+        head_.store(head_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    /**
+     * @brief Copies up to max_items published items into dst in at most two
+     * contiguous pieces (before and after the wrap) and frees their slots.
+     * @return Number of items copied.
+     */
+    size_t pop_bulk(T* dst, size_t max_items) {
+        const size_t current_head = head_.load(std::memory_order_relaxed);
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+
+        size_t count = cached_tail_ - current_head;
+        if (count > max_items) {
+            count = max_items;
+        }
+
+        const size_t start = current_head & mask_;
+        const size_t first = count < capacity() - start ? count : capacity() - start;
+        std::copy(buffer_ + start, buffer_ + start + first, dst);
+        std::copy(buffer_, buffer_ + (count - first), dst + first);
+
+        head_.store(current_head + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * @brief pop_bulk() into a different type: convert(const T&, U&) fills
+     * each dst item from its slot, in order.
+     */
+    template <typename U, typename Convert>
+    size_t pop_bulk(U* dst, size_t max_items, Convert convert) {
+        const size_t current_head = head_.load(std::memory_order_relaxed);
+        cached_tail_ = tail_.load(std::memory_order_acquire);
+
+        size_t count = cached_tail_ - current_head;
+        if (count > max_items) {
+            count = max_items;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            convert(buffer_[(current_head + i) & mask_], dst[i]);
+        }
+
+        head_.store(current_head + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * @brief Approximate number of published, unread items. Safe from any thread.
+     */
+    size_t size_approx() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+private:
+    bool has_room() {
+        if (pending_tail_ - cached_head_ > mask_) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (pending_tail_ - cached_head_ > mask_) {
+                // Buffer is full: keep what the consumer hasn't read yet
+                // (Single writer, so a plain load/store avoids a locked RMW.)
+                dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Read-only after construction, shared by both sides.
+    std::unique_ptr<T[]> owned_;
+    T* const buffer_;
+    const size_t mask_;
+
+    // Producer cache line: published tail, private tail, cached head, drops.
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail_{0};
+    size_t pending_tail_ = 0;
+    size_t cached_head_ = 0;
+    std::atomic<uint64_t> dropped_{0};
+
+    // Consumer cache line: head and its cached view of the tail.
+    // (The class alignment pads it to a full line, away from what follows.)
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head_{0};
+    size_t cached_tail_ = 0;
+};
+
+#endif // RING_BUFFER_H
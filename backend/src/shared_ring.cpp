@@ -0,0 +1,214 @@
+// src/shared_ring.cpp
+
+#include "shared_ring.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr long HUGETLBFS_MAGIC_NUMBER = 0x958458f6;
+constexpr size_t DEFAULT_HUGE_PAGE = 2 * 1024 * 1024;
+
+size_t round_up(size_t value, size_t unit) {
+    return (value + unit - 1) / unit * unit;
+}
+
+int fail(const std::string& what, const char* step) {
+    const int err = errno;
+    std::cerr << "[C++ Engine ERROR] Shared ring " << what << ": " << step << " failed: " << std::strerror(err)
+              << std::endl;
+    return -err;
+}
+
+/**
+ * @brief Clears `path` for a fresh segment. Only a previous segment is ever
+ * removed: a regular file (not followed through a symlink) whose header
+ * carries SNIFFER_SHM_MAGIC and whose owner has closed it or exited.
+ * Anything else stays untouched and the create fails, so a path argument
+ * can never be used to delete an arbitrary file.
+ * @return 0 if the path is free now, or -errno (logged).
+ */
+int remove_stale_segment(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? 0 : fail(path, "open of the existing file");
+    }
+    struct stat st;
+    bool segment = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+                   static_cast<size_t>(st.st_size) >= sizeof(C_SharedRingHeader);
+    bool in_use = false;
+    if (segment) {
+        // Mapped, not read: hugetlbfs files do not support read().
+        void* map = mmap(nullptr, sizeof(C_SharedRingHeader), PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            segment = false;
+        } else {
+            const C_SharedRingHeader* header = static_cast<const C_SharedRingHeader*>(map);
+            segment = header->magic == SNIFFER_SHM_MAGIC;
+            const pid_t owner = static_cast<pid_t>(header->pid);
+            in_use = segment && header->closed == 0 && owner != getpid() && owner > 0 &&
+                     (kill(owner, 0) == 0 || errno == EPERM);
+            munmap(map, sizeof(C_SharedRingHeader));
+        }
+    }
+    ::close(fd);
+    if (!segment) {
+        errno = EEXIST;
+        return fail(path, "replacing a file that is not a shared ring segment");
+    }
+    if (in_use) {
+        errno = EBUSY;
+        return fail(path, "replacing a segment another running engine owns");
+    }
+    // Unlink only the inode that was checked.
+    struct stat now;
+    if (lstat(path.c_str(), &now) != 0 || now.st_dev != st.st_dev || now.st_ino != st.st_ino) {
+        errno = EEXIST;
+        return fail(path, "replacing a file that changed while it was checked");
+    }
+    if (unlink(path.c_str()) != 0 && errno != ENOENT) {
+        return fail(path, "unlink");
+    }
+    return 0;
+}
+
+} // namespace
+
+// =================================================================
+// A) CREATE
+// =================================================================
+
+int SharedRingSegment::create(const std::string& name, uint32_t lanes, uint32_t slots, uint32_t flags,
+                              std::unique_ptr<SharedRingSegment>& out) {
+    std::unique_ptr<SharedRingSegment> segment(new SharedRingSegment());
+    segment->name_ = name;
+    segment->requested_flags_ = flags;
+    const bool named = name.find('/') != std::string::npos;
+    const bool want_huge = (flags & SNIFFER_SHM_HUGETLB) != 0;
+
+    const size_t lane_slots = ring_capacity_for(slots);
+    const size_t stride = round_up(SNIFFER_SHM_LANE_RECORDS + lane_slots * sizeof(C_PacketData), CACHE_LINE_SIZE);
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t unit = page;
+
+    if (named) {
+        // A fresh inode every time: consumers still mapping the last one must
+        // not see it truncated under them.
+        const int cleared = remove_stale_segment(name);
+        if (cleared != 0) {
+            return cleared;
+        }
+        segment->fd_ = open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0644);
+        if (segment->fd_ < 0) {
+            return fail(name, "open");
+        }
+        segment->path_ = name;
+        segment->unlink_ = true;
+        struct statfs fs;
+        if (fstatfs(segment->fd_, &fs) == 0 && static_cast<long>(fs.f_type) == HUGETLBFS_MAGIC_NUMBER) {
+            segment->flags_ |= SNIFFER_SHM_HUGETLB;
+            unit = static_cast<size_t>(fs.f_bsize);
+        }
+    } else {
+        if (want_huge) {
+            segment->fd_ = memfd_create(name.c_str(), MFD_CLOEXEC | MFD_HUGETLB);
+            if (segment->fd_ >= 0) {
+                segment->flags_ |= SNIFFER_SHM_HUGETLB;
+                unit = DEFAULT_HUGE_PAGE;
+            }
+        }
+        if (segment->fd_ < 0) {
+            segment->fd_ = memfd_create(name.c_str(), MFD_CLOEXEC);
+        }
+        if (segment->fd_ < 0) {
+            return fail(name, "memfd_create");
+        }
+        segment->path_ = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(segment->fd_);
+    }
+
+    const size_t lane_offset = round_up(sizeof(C_SharedRingHeader), page);
+    segment->size_ = round_up(lane_offset + lanes * stride, unit);
+    if (ftruncate(segment->fd_, static_cast<off_t>(segment->size_)) != 0) {
+        return fail(name, "ftruncate");
+    }
+    void* map = mmap(nullptr, segment->size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, segment->fd_, 0);
+    if (map == MAP_FAILED && (segment->flags_ & SNIFFER_SHM_HUGETLB) && !named) {
+        // No huge pages reserved (vm.nr_hugepages): normal pages still work.
+        std::cerr << "[C++ Engine ERROR] Shared ring " << name << ": no huge pages ("
+                  << std::strerror(errno) << "); using normal pages." << std::endl;
+        ::close(segment->fd_);
+        segment->flags_ = 0;
+        segment->fd_ = memfd_create(name.c_str(), MFD_CLOEXEC);
+        if (segment->fd_ < 0) {
+            return fail(name, "memfd_create");
+        }
+        segment->path_ = "/proc/" + std::to_string(getpid()) + "/fd/" + std::to_string(segment->fd_);
+        segment->size_ = round_up(lane_offset + lanes * stride, page);
+        if (ftruncate(segment->fd_, static_cast<off_t>(segment->size_)) != 0) {
+            return fail(name, "ftruncate");
+        }
+        map = mmap(nullptr, segment->size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, segment->fd_, 0);
+    }
+    if (map == MAP_FAILED) {
+        return fail(name, "mmap");
+    }
+    segment->base_ = static_cast<uint8_t*>(map);
+
+    // Fresh pages are zero: every lane starts empty. The magic goes last so a
+    // consumer that maps it early never trusts a half-written header.
+    C_SharedRingHeader* header = reinterpret_cast<C_SharedRingHeader*>(segment->base_);
+    header->version = SNIFFER_SHM_VERSION;
+    header->abi_version = SNIFFER_ABI_VERSION;
+    header->record_size = sizeof(C_PacketData);
+    header->lane_count = lanes;
+    header->lane_slots = static_cast<uint32_t>(lane_slots);
+    header->lane_offset = lane_offset;
+    header->lane_stride = stride;
+    header->segment_size = segment->size_;
+    header->pid = static_cast<uint32_t>(getpid());
+    header->closed = 0;
+    segment->header_ = header;
+    reinterpret_cast<std::atomic<uint32_t>*>(&header->magic)->store(SNIFFER_SHM_MAGIC, std::memory_order_release);
+
+    std::cout << "[C++ Engine] Shared ring at " << segment->path_ << ": " << lanes << " lane(s) x " << lane_slots
+              << " records, " << segment->size_ / 1024 << " KiB"
+              << (segment->flags_ & SNIFFER_SHM_HUGETLB ? " (huge pages)." : ".") << std::endl;
+    out = std::move(segment);
+    return 0;
+}
+
+// =================================================================
+// B) DESCRIBE / RELEASE
+// =================================================================
+
+void SharedRingSegment::fill_info(C_SharedRingInfo& info) const {
+    std::memset(&info, 0, sizeof(info));
+    std::strncpy(info.path, path_.c_str(), sizeof(info.path) - 1);
+    info.segment_size = size_;
+    info.lane_count = header_->lane_count;
+    info.lane_slots = header_->lane_slots;
+    info.flags = flags_;
+}
+
+SharedRingSegment::~SharedRingSegment() {
+    if (base_ != nullptr) {
+        reinterpret_cast<std::atomic<uint32_t>*>(&header_->closed)->store(1, std::memory_order_release);
+        munmap(base_, size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    if (unlink_) {
+        unlink(path_.c_str());
+    }
+}
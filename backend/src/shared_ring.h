@@ -0,0 +1,139 @@
+#ifndef SHARED_RING_H
+#define SHARED_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "ring_buffer.h"
+#include "sniffer_engine.h"
+
+/**
+ * @brief One lane's indices, laid out as the segment format documents
+ * (write_pos at +0, reserve_pos at +64, records at +SNIFFER_SHM_LANE_RECORDS).
+ */
+struct SharedRingLane {
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> write_pos;
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> reserve_pos;
+};
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && std::atomic<uint64_t>::is_always_lock_free,
+              "the shared ring indices must be plain lock-free 64-bit words");
+static_assert(offsetof(SharedRingLane, reserve_pos) == 64 && sizeof(SharedRingLane) <= SNIFFER_SHM_LANE_RECORDS,
+              "SharedRingLane does not match the documented lane layout");
+
+/**
+ * @brief The shared-memory segment behind set_shared_ring(): a memfd (or a
+ * file on hugetlbfs / tmpfs) mapped shared, one lane per capture worker.
+ *
+ * Created by the control plane at a cold start; the capture threads only
+ * ever write through the SharedRingWriter of their lane. Destroying it marks
+ * the header closed, unmaps it and unlinks a named file; consumers that
+ * still have it mapped keep their copy of the pages.
+ */
+class SharedRingSegment {
+public:
+    /**
+     * @brief Creates and maps a segment, header filled in.
+     * @return 0, or -errno of the step that failed (logged).
+     */
+    static int create(const std::string& name, uint32_t lanes, uint32_t slots, uint32_t flags,
+                      std::unique_ptr<SharedRingSegment>& out);
+
+    ~SharedRingSegment();
+
+    SharedRingSegment(const SharedRingSegment&) = delete;
+    SharedRingSegment& operator=(const SharedRingSegment&) = delete;
+
+    /**
+     * @brief True if it was created with these settings (so a start can reuse it).
+     */
+    bool matches(const std::string& name, uint32_t lanes, uint32_t slots, uint32_t flags) const {
+        return name == name_ && lanes == header_->lane_count && ring_capacity_for(slots) == header_->lane_slots &&
+               flags == requested_flags_;
+    }
+
+    SharedRingLane* lane(uint32_t index) const {
+        return reinterpret_cast<SharedRingLane*>(base_ + header_->lane_offset + index * header_->lane_stride);
+    }
+
+    C_PacketData* lane_records(uint32_t index) const {
+        return reinterpret_cast<C_PacketData*>(reinterpret_cast<uint8_t*>(lane(index)) + SNIFFER_SHM_LANE_RECORDS);
+    }
+
+    uint32_t lane_slots() const { return header_->lane_slots; }
+
+    void fill_info(C_SharedRingInfo& info) const;
+
+private:
+    SharedRingSegment() = default;
+
+    std::string name_;
+    std::string path_;       // What consumers open
+    bool unlink_ = false;    // path_ is a file we created
+    int fd_ = -1;
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    uint32_t requested_flags_ = 0;
+    uint32_t flags_ = 0;     // What backs it (SNIFFER_SHM_HUGETLB or not)
+    C_SharedRingHeader* header_ = nullptr;
+};
+
+/**
+ * @brief Producer side of one lane (the capture thread only).
+ *
+ * stage() writes a record into its slot at once; publish() makes everything
+ * staged visible with one release store. Before a slot is overwritten,
+ * reserve_pos is raised past it (in steps of RESERVE_AHEAD, one store and
+ * a fence each) so a consumer can tell a torn copy from a good one; the
+ * records themselves are never locked.
+ *
+ * A writer attached to a reused segment continues from the lane's
+ * write_pos, so consumer cursors stay valid across engine restarts.
+ */
+class SharedRingWriter {
+public:
+    static constexpr uint64_t RESERVE_AHEAD = 64;
+
+    SharedRingWriter() = default;
+
+    SharedRingWriter(SharedRingSegment& segment, uint32_t index) :
+        lane_(segment.lane(index)), records_(segment.lane_records(index)), mask_(segment.lane_slots() - 1) {
+        pending_ = published_ = reserved_ = lane_->write_pos.load(std::memory_order_relaxed);
+    }
+
+    bool attached() const { return lane_ != nullptr; }
+
+    void stage(const C_PacketData& record) {
+        if (pending_ == reserved_) {
+            reserved_ = pending_ + RESERVE_AHEAD;
+            lane_->reserve_pos.store(reserved_, std::memory_order_relaxed);
+            // The reservation is visible before any of the slot writes it covers.
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+        std::memcpy(&records_[pending_ & mask_], &record, sizeof(record));
+        ++pending_;
+    }
+
+    void publish() {
+        if (pending_ == published_) {
+            return;
+        }
+        lane_->write_pos.store(pending_, std::memory_order_release);
+        // Nothing past pending_ is being written any more.
+        lane_->reserve_pos.store(pending_, std::memory_order_relaxed);
+        published_ = reserved_ = pending_;
+    }
+
+private:
+    SharedRingLane* lane_ = nullptr;
+    C_PacketData* records_ = nullptr;
+    uint64_t mask_ = 0;
+    uint64_t pending_ = 0;
+    uint64_t published_ = 0;
+    uint64_t reserved_ = 0;
+};
+
+#endif // SHARED_RING_H
@@ -1,229 +1,1139 @@
+// src/sniffer_engine.cpp
+
+#include "sniffer_engine.h"
+#include "capture_backend.h"
+#include "capture_filter.h"
+#include "capture_engine.h"
+#include "capture_worker.h"
+#include "flow_features.h"
+#include "metrics_text.h"
 #include <iostream>
-#include <thread>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
-// 1. Packet Structure (to be stored in the ring buffer)
-struct CapturedPacket {
-    // You should use a sensible max capture length for high speed.
-    // 1518 is standard Ethernet MTU + headers. 65535 is the max for snaplen.
-    static constexpr int MAX_SNAPLEN = 2048; 
-    
-    // #include <pcap.h> // Uncomment if using real libpcap
-    // Simulated pcap_pkthdr struct for demonstration (remove if using real pcap)
-    struct pcap_pkthdr {
-        uint32_t caplen;
-        uint32_t len;
-        uint32_t ts_sec;
-        uint32_t ts_usec;
-    };
-        pcap_pkthdr header;
-    uint8_t data[MAX_SNAPLEN];
+// =================================================================
+// GLOBAL STATE AND ATOMICS
+// =================================================================
+
+// The capture workers of the current (or last) run, their joinable threads
+// and the stop flag and other switches they share.
+CaptureEngine g_engine;
+
+// Reader-side state of read_batch()/read_payload_batch(): the worker to start
+// merging from, and drop totals already reported.
+size_t g_next_worker = 0;
+size_t g_next_payload_worker = 0;
+size_t g_next_flow_worker = 0;
+size_t g_next_alert_worker = 0;
+uint64_t g_reported_drops = 0;
+uint64_t g_reported_payload_drops = 0;
+uint64_t g_reported_flow_drops = 0;
+uint64_t g_reported_alert_drops = 0;
+
+// Reader-side wait: how long wait_for_data() spins before it parks. Grows
+// while data keeps arriving within the spin, shrinks while it does not.
+constexpr uint64_t WAIT_SPIN_MIN_NS = 1000;
+constexpr uint64_t WAIT_SPIN_MAX_NS = 100000;
+uint64_t g_wait_spin_ns = 10000;
+
+// Reader-side latency stages (single consumer, so single writer).
+LatencyHistogram g_read_latency;       // SNIFFER_LAT_CAPTURE_TO_READ
+LatencyHistogram g_flow_read_latency;  // SNIFFER_LAT_FLOW_EXPORT_TO_READ
+
+// Staging for read_flow_features() when the caller does not want the records.
+std::vector<C_FlowRecord> g_feature_scratch;
+
+// Field table exported through get_abi_field() so consumers can verify their mirror.
+#define ABI_FIELD(name) { #name, offsetof(C_PacketData, name), sizeof(C_PacketData::name) }
+const C_AbiField g_abi_fields[] = {
+    ABI_FIELD(timestamp),
+    ABI_FIELD(flow_hash),
+    ABI_FIELD(length),
+    ABI_FIELD(caplen),
+    ABI_FIELD(protocol),
+    ABI_FIELD(flags),
+    ABI_FIELD(payload_ref),
+    ABI_FIELD(queue_id),
+    ABI_FIELD(reserved),
 };
+#undef ABI_FIELD
+
+// get_metrics_text()'s exposition, reused from scrape to scrape (scrapes may
+// come from several server threads, so they take turns).
+std::mutex g_metrics_mutex;
+MetricsText g_metrics;
+
+// Pointer to the buffer provided by the Python side (shared memory)
+C_PacketData* g_shared_buffer = nullptr;
 
-// 2. Conceptual Concurrent Ring Buffer (simplified/placeholder)
-// In a real high-speed application, you'd use a dedicated lock-free queue
-// like moodycamel::ConcurrentQueue, or a custom one for maximum throughput.
+// =================================================================
+// BACKEND SELECTION
+// =================================================================
+
+std::unique_ptr<CaptureBackend> make_capture_backend(const std::string& spec, std::string& source) {
+    const size_t colon = spec.find(':');
+    const std::string prefix = spec.substr(0, colon);
+    const std::string rest = colon == std::string::npos ? std::string() : spec.substr(colon + 1);
+
+    if (prefix == "sim") {
+        source = rest;
+        return make_simulator_backend();
+    }
+    if (prefix == "pcap") {
+        source = rest;
+        return make_pcap_backend();
+    }
+    if (prefix == "afpacket") {
+        source = rest;
+        return make_af_packet_backend();
+    }
+    // No known prefix: a plain interface name.
+    source = spec;
+    return make_af_packet_backend();
+}
+
+// Copies records out of a worker ring as they are.
 template <typename T>
-class ConcurrentRingBuffer {
-public:
-    ConcurrentRingBuffer(size_t capacity) : 
-        capacity_(capacity), buffer_(capacity), head_(0), tail_(0) {}
+size_t pop_records(ConcurrentRingBuffer<T>& ring, T* dst, size_t max_records) {
+    return ring.pop_bulk(dst, max_records);
+}
 
-    bool push(const T& item) {
-        size_t current_tail = tail_.load(std::memory_order_relaxed);
-        size_t next_tail = (current_tail + 1) % capacity_;
+// The flow ring also carries each flow's export time: strip it, timing the hand-over.
+size_t pop_records(ConcurrentRingBuffer<ExportedFlow>& ring, C_FlowRecord* dst, size_t max_records) {
+    const uint64_t now = latency_clock_ns();
+    return ring.pop_bulk(dst, max_records, [now](const ExportedFlow& flow, C_FlowRecord& out) {
+        out = flow.record;
+        g_flow_read_latency.record_span(flow.export_ns, now);
+    });
+}
 
-        if (next_tail == head_.load(std::memory_order_acquire)) {
-            // Buffer is full
-            return false;
+/**
+ * Merges the per-worker rings selected by `ring_of` into dst, starting at a
+ * rotating worker so no queue is starved, and reports drops since last call.
+ */
+template <typename T, typename RingOf>
+int merge_worker_rings(T* dst, int max_records, uint64_t* dropped, size_t& next_worker,
+                       uint64_t& reported_drops, RingOf ring_of) {
+    size_t copied = 0;
+    uint64_t total_drops = 0;
+    const auto& all = g_engine.workers();
+    const size_t workers = all.size();
+
+    for (size_t i = 0; i < workers; ++i) {
+        CaptureWorker& worker = *all[(next_worker + i) % workers];
+        if (!worker.ready()) {
+            continue;
+        }
+        auto& ring = ring_of(worker);
+        if (copied < static_cast<size_t>(max_records)) {
+            copied += pop_records(ring, dst + copied, static_cast<size_t>(max_records) - copied);
         }
+        total_drops += ring.dropped();
+    }
+    if (workers > 0) {
+        next_worker = (next_worker + 1) % workers;
+    }
 
-        buffer_[current_tail] = item;
-        tail_.store(next_tail, std::memory_order_release);
-        return true;
+    if (dropped) {
+        *dropped = total_drops - reported_drops;
     }
+    reported_drops = total_drops;
+    return static_cast<int>(copied);
+}
 
-    bool pop(T& item) {
-        size_t current_head = head_.load(std::memory_order_relaxed);
-        if (current_head == tail_.load(std::memory_order_acquire)) {
-            // Buffer is empty
-            return false;
+// get_sketch_stats() merges top-K tables as plain hitters, and destinations
+// with the union of their distinct-source registers.
+struct MergedDestination {
+    C_HeavyHitter hitter;
+    HyperLogLog sources;
+};
+
+C_HeavyHitter& hitter_of(C_HeavyHitter& hitter) { return hitter; }
+C_HeavyHitter& hitter_of(MergedDestination& destination) { return destination.hitter; }
+
+/**
+ * Adds one worker's top-K entry into a merged table: into the entry `same`
+ * matches, or as a new one. Returns the merged entry.
+ */
+template <typename Entry, typename Same>
+Entry& merge_hitter(std::vector<Entry>& merged, const C_HeavyHitter& hitter, Same same) {
+    for (Entry& entry : merged) {
+        if (same(entry, hitter)) {
+            C_HeavyHitter& into = hitter_of(entry);
+            into.packets += hitter.packets;
+            into.bytes += hitter.bytes;
+            into.error += hitter.error;
+            return entry;
         }
+    }
+    merged.emplace_back();
+    hitter_of(merged.back()) = hitter;
+    return merged.back();
+}
 
-        item = buffer_[current_head];
-        head_.store((current_head + 1) % capacity_, std::memory_order_release);
-        return true;
+// The SNIFFER_SKETCH_TOP_K largest merged entries, by packets, into out.
+template <typename Entry>
+uint32_t top_hitters(std::vector<Entry>& merged, C_HeavyHitter* out) {
+    std::sort(merged.begin(), merged.end(), [](Entry& a, Entry& b) {
+        return hitter_of(a).packets > hitter_of(b).packets;
+    });
+    const size_t count = std::min<size_t>(merged.size(), SNIFFER_SKETCH_TOP_K);
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = hitter_of(merged[i]);
     }
+    return static_cast<uint32_t>(count);
+}
 
-private:
-    const size_t capacity_;
-    std::vector<T> buffer_;
-    std::atomic<size_t> head_;
-    std::atomic<size_t> tail_;
-};
+/**
+ * Copies a caller's config over the defaults. Older callers pass a shorter
+ * struct; only the fields they know about are taken from it.
+ */
+bool load_capture_config(const C_CaptureConfig* config, C_CaptureConfig& out) {
+    init_capture_config(&out);
+    constexpr size_t min_size = offsetof(C_CaptureConfig, flow_active_timeout_ms);
+    if (config == nullptr || config->struct_size < min_size) {
+        return false;
+    }
+    std::memcpy(&out, config, std::min<size_t>(config->struct_size, sizeof(C_CaptureConfig)));
+    out.struct_size = sizeof(C_CaptureConfig);
+    return out.queues <= SNIFFER_MAX_QUEUES && out.fanout_mode <= SNIFFER_FANOUT_QM &&
+           out.flow_active_timeout_ms > 0 && out.flow_idle_timeout_ms > 0 && out.flow_close_timeout_ms > 0 &&
+           (out.memory_budget_mb == 0 || CaptureWorker::flow_table_slots_for(uint64_t(out.memory_budget_mb) << 20) != 0);
+}
 
-// Global instance (or member of your application class)
-ConcurrentRingBuffer<CapturedPacket> packet_queue(1024 * 64); // 64K packet buffer
-std::atomic<bool> stop_capture(false);
-// Required signatures for the C++ library (libsniffer.so)
-
-// Define C_PacketData struct or include its header
-// Uncomment the next line if C_PacketData is defined in another header file
-// #include "C_PacketData.h"
-
-// Example definition (replace with actual definition if available)
-typedef struct {
-    // Add actual packet data fields here
-    char data[1500];
-    int length;
-    double timestamp; // Added timestamp field since c++ has no member of timestamp
-    int flow_hash;    // Add flow_hash to match usage below
-    bool is_alert;    // Add is_alert to match usage below
-} C_PacketData;
-
-// Define the buffer size (must match the Python/shared memory side)
-#define MAX_BUFFER_SLOTS 1024
-#define MAX_TIME_STAMP 1500
+// The checks of set_capture_filter() / set_shed_rules() / set_sketch_config(),
+// shared with reload_dataplane_config(). They log what they reject.
+bool load_bpf(const C_BpfInsn* program, uint32_t length, std::vector<C_BpfInsn>& out) {
+    out.clear();
+    if (program == nullptr || length == 0) {
+        return true;
+    }
+    if (!CaptureFilter::validate_bpf(program, length)) {
+        std::cerr << "[C++ Engine ERROR] Invalid BPF program (" << length << " instructions)." << std::endl;
+        return false;
+    }
+    out.assign(program, program + length);
+    return true;
+}
 
-// src/sniffer_engine.cpp
+bool load_shed_rules(const C_ShedRule* rules, uint32_t count, std::vector<CompiledShedRule>& out) {
+    if (count > SNIFFER_MAX_SHED_RULES || (count != 0 && rules == nullptr)) {
+        std::cerr << "[C++ Engine ERROR] Invalid shed rule count " << count << "." << std::endl;
+        return false;
+    }
+    out.assign(count, CompiledShedRule{});
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!CaptureFilter::compile_rule(rules[i], out[i])) {
+            std::cerr << "[C++ Engine ERROR] Invalid shed rule " << i << "." << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
 
-#include "sniffer_engine.h"
-#include <iostream>
-#include <thread>
-#include <atomic>
-#include <chrono>
-#include <mutex>
-#include <random> // For simulation
+bool load_sketch_settings(const C_SketchConfig& config, SketchSettings& out) {
+    constexpr uint32_t known_flags = SNIFFER_SKETCH_ENFORCE_SRC | SNIFFER_SKETCH_ENFORCE_DST;
+    if ((config.flags & ~known_flags) != 0) {
+        std::cerr << "[C++ Engine ERROR] Unknown sketch flags 0x" << std::hex << config.flags << std::dec << "."
+                  << std::endl;
+        return false;
+    }
+    out.window_ns = static_cast<uint64_t>(config.window_ms) * 1000000ull;
+    out.src_packets = config.src_packets;
+    out.dst_packets = config.dst_packets;
+    out.dst_sources = config.dst_sources;
+    out.flags = config.flags;
+    out.action = config.alert_action;
+    return true;
+}
 
-// NOTE: For a real system, you would include libpcap, PF_RING, or DPDK headers here.
-// #include <pcap.h> 
+// get_metrics_text(): the snapshots of the get_* calls, family by family.
+void render_metrics(MetricsText& out) {
+    C_EngineStats engine{};
+    engine.struct_size = sizeof(engine);
+    get_engine_stats(&engine);
+    out.family("sniffer_capture_state", "gauge", "SNIFFER_STATE_* of the engine (1 = running)");
+    out.sample("sniffer_capture_state", "", "", static_cast<uint64_t>(engine.state));
 
-// =================================================================
-// GLOBAL STATE AND ATOMICS
-// =================================================================
+    // Per capture worker
+    char labels[SNIFFER_MAX_QUEUES][24];
+    for (uint32_t w = 0; w < engine.worker_count; ++w) {
+        std::snprintf(labels[w], sizeof(labels[w]), "queue=\"%u\"", engine.workers[w].queue_id);
+    }
+    const auto per_worker = [&](const char* name, const char* type, const char* help, const char* suffix,
+                                uint64_t C_WorkerStats::*field) {
+        out.family(name, type, help);
+        for (uint32_t w = 0; w < engine.worker_count; ++w) {
+            out.sample(name, suffix, labels[w], engine.workers[w].*field);
+        }
+    };
+    per_worker("sniffer_packets", "counter", "Frames the capture workers parsed", "_total", &C_WorkerStats::packets);
+    per_worker("sniffer_wire_bytes", "counter", "Their length on the wire", "_total", &C_WorkerStats::bytes);
+    per_worker("sniffer_polls", "counter", "Backend polls", "_total", &C_WorkerStats::polls);
+    per_worker("sniffer_poll_batches", "counter", "Polls that delivered frames", "_total", &C_WorkerStats::batches);
+    per_worker("sniffer_flows_active", "gauge", "Flows the flow tables track", "", &C_WorkerStats::flows_active);
+    out.family("sniffer_drops", "counter", "Frames, records or flows lost, by where");
+    const struct {
+        const char* stage;
+        uint64_t C_WorkerStats::*field;
+    } drops[] = {
+        {"kernel", &C_WorkerStats::kernel_drops},
+        {"frame_ring", &C_WorkerStats::frame_ring_drops},
+        {"record_ring", &C_WorkerStats::record_ring_drops},
+        {"payload_ring", &C_WorkerStats::payload_ring_drops},
+        {"flow_ring", &C_WorkerStats::flow_ring_drops},
+    };
+    for (uint32_t w = 0; w < engine.worker_count; ++w) {
+        for (const auto& drop : drops) {
+            char both[64];
+            std::snprintf(both, sizeof(both), "%s,stage=\"%s\"", labels[w], drop.stage);
+            out.sample("sniffer_drops", "_total", both, engine.workers[w].*drop.field);
+        }
+    }
+    out.family("sniffer_memory_budget_bytes", "gauge", "Memory the workers reserved at start", "bytes");
+    out.sample("sniffer_memory_budget_bytes", "", "", engine.memory_budget);
+    out.family("sniffer_memory_used_bytes", "gauge", "... of which their rings, tables and sketches take", "bytes");
+    out.sample("sniffer_memory_used_bytes", "", "", engine.memory_used);
 
-// Flag to signal the capture thread to stop. Must be atomic.
-std::atomic<bool> g_stop_capture {false};
+    C_FlowTableStats flows{};
+    get_flow_table_stats(&flows);
+    out.family("sniffer_flow_table_capacity", "gauge", "Flows the flow tables can hold");
+    out.sample("sniffer_flow_table_capacity", "", "", flows.capacity);
+    out.family("sniffer_flows_rejected", "counter", "New flows that could not be tracked");
+    out.sample("sniffer_flows_rejected", "_total", "", flows.rejected);
+    out.family("sniffer_flows_finished", "counter", "Flows exported, by why they ended");
+    out.sample("sniffer_flows_finished", "_total", "reason=\"active\"", flows.expired_active);
+    out.sample("sniffer_flows_finished", "_total", "reason=\"idle\"", flows.expired_idle);
+    out.sample("sniffer_flows_finished", "_total", "reason=\"closed\"", flows.closed);
+    out.sample("sniffer_flows_finished", "_total", "reason=\"evicted\"", flows.evicted);
 
-// Index where the C++ thread will write the NEXT packet. Must be atomic.
-std::atomic<int> g_write_index {0};
+    C_ShedStats shed{};
+    get_shed_stats(&shed);
+    out.family("sniffer_shed_packets", "counter", "Frames shed, by the BPF program or the shed rules");
+    out.sample("sniffer_shed_packets", "_total", "by=\"filter\"", shed.filter_packets);
+    out.sample("sniffer_shed_packets", "_total", "by=\"rules\"", shed.rule_packets);
+    out.family("sniffer_shed_bytes", "counter", "Their length on the wire", "bytes");
+    out.sample("sniffer_shed_bytes", "_total", "by=\"filter\"", shed.filter_bytes);
+    out.sample("sniffer_shed_bytes", "_total", "by=\"rules\"", shed.rule_bytes);
 
-// Pointer to the buffer provided by the Python side (shared memory)
-C_PacketData* g_shared_buffer = nullptr;
+    C_SketchStats sketch{};
+    get_sketch_stats(&sketch);
+    out.family("sniffer_sketch_windows", "counter", "Sketch windows finished");
+    out.sample("sniffer_sketch_windows", "_total", "", sketch.windows);
+    out.family("sniffer_sketch_alerts", "counter", "Sketch alerts raised");
+    out.sample("sniffer_sketch_alerts", "_total", "", sketch.alerts);
+    out.family("sniffer_sketch_alerts_dropped", "counter", "... that found the alert ring full");
+    out.sample("sniffer_sketch_alerts_dropped", "_total", "", sketch.alerts_dropped);
+    out.family("sniffer_sketch_callback_dropped", "counter", "... that found the alert callback queue full");
+    out.sample("sniffer_sketch_callback_dropped", "_total", "", sketch.callback_dropped);
 
-// A local handle for the capture thread
-std::thread g_capture_thread;
+    C_FlowModelStats model{};
+    get_flow_model_stats(&model);
+    out.family("sniffer_model_flows", "counter", "Flows the flow model scored");
+    out.sample("sniffer_model_flows", "_total", "", model.flows);
+    out.family("sniffer_model_flagged", "counter", "... whose class has an action");
+    out.sample("sniffer_model_flagged", "_total", "", model.flagged);
+    out.family("sniffer_model_score_seconds", "counter", "Time spent scoring", "seconds");
+    out.sample("sniffer_model_score_seconds", "_total", "", static_cast<double>(model.score_ns) / 1e9);
 
-// =================================================================
-// INTERNAL CAPTURE FUNCTION (The worker thread)
-// =================================================================
+    C_FlowLogStats log{};
+    get_flow_log_stats(&log);
+    out.family("sniffer_flow_log_rows", "counter", "Rows appended to the flow log, by stream");
+    out.sample("sniffer_flow_log_rows", "_total", "stream=\"flows\"", log.flow_rows);
+    out.sample("sniffer_flow_log_rows", "_total", "stream=\"decisions\"", log.decision_rows);
+    out.family("sniffer_flow_log_rows_lost", "counter", "Rows that found no segment");
+    out.sample("sniffer_flow_log_rows_lost", "_total", "", log.rows_lost);
+    out.family("sniffer_flow_log_bytes", "counter", "Size of the segments created", "bytes");
+    out.sample("sniffer_flow_log_bytes", "_total", "", log.bytes);
 
-/**
- * The core function that runs the high-speed packet capture loop.
- * NOTE: This is where the libpcap/DPDK logic would reside.
- */
-void capture_loop(const std::string& interface_name) {
-    std::cout << "[C++ Worker] Capture thread started on " << interface_name << std::endl;
-
-    // --- REAL WORLD SETUP ---
-    // 1. Initialize libpcap handle (pcap_open_live)
-    // 2. Set filters (pcap_setfilter)
-    // ------------------------
-
-    // --- SIMULATION SETUP (for demonstration) ---
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> distrib(100, 1500); // Packet length simulation
-    // ------------------------------------------
-
-    int local_write_index = 0;
-    uint32_t flow_counter = 0;
-
-    while (!g_stop_capture.load(std::memory_order_acquire)) {
-        // --- REAL WORLD PACKET CAPTURE ---
-        // Capture a packet using pcap_next_ex() or equivalent.
-        // If capture successful:
-        //   1. Extract required features (length, timestamp, flow_hash).
-        //   2. Write features to g_shared_buffer[local_write_index].
-        // ---------------------------------
-        
-        // --- SIMULATED PACKET PROCESSING ---
-        if (g_shared_buffer) {
-            
-            // 1. Fill the current slot
-            C_PacketData& slot = g_shared_buffer[local_write_index];
-            slot.timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
-                                 std::chrono::system_clock::now().time_since_epoch()).count() / 1000000.0;
-            slot.length = distrib(gen);
-            slot.flow_hash = ++flow_counter;
-            slot.is_alert = (flow_counter % 50 == 0); // Simulate an alert every 50 packets
-
-            // 2. Atomically update the global index (Producer logic)
-            // This 'releases' the data to the Python reader thread.
-            int next_index = (local_write_index + 1) % MAX_BUFFER_SLOTS;
-            g_write_index.store(next_index, std::memory_order_release);
-            
-            // Update the local index for the next write operation
-            local_write_index = next_index;
-        }
-
-        // Add a small delay for simulation purposes. Remove in a real high-speed sniffer!
-        std::this_thread::sleep_for(std::chrono::milliseconds(5)); 
-    }
-
-    std::cout << "[C++ Worker] Capture thread shutting down." << std::endl;
-    // --- REAL WORLD CLEANUP ---
-    // Close the pcap handle (pcap_close).
-    // --------------------------
+    C_DataplaneStatus dataplane{};
+    get_dataplane_status(&dataplane);
+    out.family("sniffer_config_generation", "gauge", "Dataplane configs published");
+    out.sample("sniffer_config_generation", "", "", dataplane.generation);
+    out.family("sniffer_config_workers_behind", "gauge", "Capturing workers not on the last config yet");
+    out.sample("sniffer_config_workers_behind", "", "", static_cast<uint64_t>(dataplane.workers_behind));
+
+    static const char* const stages[SNIFFER_LAT_STAGES] = {
+        "stage=\"capture_to_publish\"", "stage=\"capture_to_read\"", "stage=\"flow_update\"",
+        "stage=\"flow_export_to_read\"",
+    };
+    out.family("sniffer_latency_seconds", "histogram", "Latency of each pipeline stage", "seconds");
+    C_LatencyHistogram histogram;
+    for (int stage = 0; stage < SNIFFER_LAT_STAGES; ++stage) {
+        get_latency_histogram(stage, &histogram);
+        out.histogram("sniffer_latency_seconds", stages[stage], histogram);
+    }
 }
 
 // =================================================================
 // C EXPOSED FUNCTION IMPLEMENTATIONS
 // =================================================================
 
-extern "C" int start_capture_engine(const char* interface_name, C_PacketData* buffer) {
-    if (g_capture_thread.joinable()) {
-        std::cerr << "[C++ Engine ERROR] Capture already running." << std::endl;
-        return 1; // Already running
+extern "C" void init_capture_config(C_CaptureConfig* config) {
+    if (config == nullptr) {
+        return;
+    }
+    std::memset(config, 0, sizeof(*config));
+    config->struct_size = sizeof(C_CaptureConfig);
+    config->queues = 1;
+    config->fanout_mode = SNIFFER_FANOUT_HASH;
+    for (int& cpu : config->cpus) {
+        cpu = -1;
     }
+    config->flow_active_timeout_ms = 5000;
+    config->flow_idle_timeout_ms = 10000;
+    config->flow_close_timeout_ms = 1000;
+}
 
-    // Reset state
-    g_stop_capture.store(false, std::memory_order_relaxed);
-    g_shared_buffer = buffer; // Set the global buffer pointer
+extern "C" int start_capture_engine(const char* interface_name, C_PacketData* buffer) {
+    C_CaptureConfig config;
+    init_capture_config(&config);
+    return start_capture_engine_ex(interface_name, buffer, &config);
+}
+
+extern "C" int start_capture_engine_ex(const char* interface_name, C_PacketData* buffer,
+                                       const C_CaptureConfig* requested) {
+    if (interface_name == nullptr || buffer == nullptr) {
+        std::cerr << "[C++ Engine ERROR] Missing interface name or buffer." << std::endl;
+        return 3;
+    }
 
-    // Create a new thread and detach it to run the capture loop in the background.
-    // The C++ thread is now NON-BLOCKING to the Python caller.
-    try {
-        g_capture_thread = std::thread(capture_loop, std::string(interface_name));
-        g_capture_thread.detach(); // Allow the thread to run independently
-        std::cout << "[C++ Engine] Started NON-BLOCKING capture loop." << std::endl;
-        return 0; // Success
-    } catch (const std::exception& e) {
-        std::cerr << "[C++ Engine ERROR] Failed to create thread: " << e.what() << std::endl;
-        return 2; // Thread creation failed
+    C_CaptureConfig config;
+    if (!load_capture_config(requested, config)) {
+        std::cerr << "[C++ Engine ERROR] Invalid capture config." << std::endl;
+        return 4;
     }
+    bool warm = false;
+    const int result = g_engine.start(interface_name, buffer, config, &warm);
+    if (result == 0 && !warm) {
+        // New workers and rings: reset the reader side.
+        g_shared_buffer = buffer;
+        g_next_worker = 0;
+        g_next_payload_worker = 0;
+        g_next_flow_worker = 0;
+        g_next_alert_worker = 0;
+        g_reported_drops = 0;
+        g_reported_payload_drops = 0;
+        g_reported_flow_drops = 0;
+        g_reported_alert_drops = 0;
+    }
+    return result;
 }
 
 extern "C" int stop_capture_engine() {
-    std::cout << "[C++ Engine] Signal received. Shutting down worker thread..." << std::endl;
-    // Atomically set the flag to true (Consumer logic)
-    g_stop_capture.store(true, std::memory_order_release); 
+    return stop_capture_engine_ex(CaptureEngine::DEFAULT_STOP_TIMEOUT_MS, 0);
+}
 
-    // NOTE: Because we detached the thread, we cannot use .join() here.
-    // The thread will naturally exit when it checks the flag in its loop.
-    return 0;
+extern "C" int stop_capture_engine_ex(uint32_t timeout_ms, uint32_t flags) {
+    std::cout << "[C++ Engine] Signal received. Shutting down worker threads..." << std::endl;
+    // One atomic store stops every capture loop; the engine then waits
+    // (bounded) for them to drain and joins them.
+    return g_engine.stop(timeout_ms, (flags & SNIFFER_STOP_KEEP_WARM) != 0);
+}
+
+extern "C" int get_capture_state() {
+    return g_engine.state();
 }
 
 extern "C" int get_write_index() {
     // Atomically read the index. This is used by the Python reader thread.
-    return g_write_index.load(std::memory_order_acquire);
+    // Only worker 0 writes into the caller's buffer.
+    const auto& workers = g_engine.workers();
+    if (workers.empty() || !workers[0]->ready()) {
+        return 0;
+    }
+    return static_cast<int>(workers[0]->records().tail_position() & (MAX_BUFFER_SLOTS - 1));
+}
+
+// Anything for the reader in a record, flow or alert ring (reader thread only).
+bool data_ready() {
+    for (auto& worker : g_engine.workers()) {
+        if (worker->ready() && (worker->records().size_approx() != 0 || worker->flows().size_approx() != 0 ||
+                                worker->alerts().size_approx() != 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+extern "C" int wait_for_data(int timeout_ms) {
+    if (data_ready()) {
+        return 1;
+    }
+
+    // A) Spin: a burst in progress is picked up within a microsecond.
+    const auto spin_until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(g_wait_spin_ns);
+    while (std::chrono::steady_clock::now() < spin_until) {
+        for (int i = 0; i < 64; ++i) {
+            cpu_relax();
+        }
+        if (data_ready()) {
+            g_wait_spin_ns = std::min(g_wait_spin_ns * 2, WAIT_SPIN_MAX_NS);
+            return 1;
+        }
+    }
+    g_wait_spin_ns = std::max(g_wait_spin_ns / 2, WAIT_SPIN_MIN_NS);
+
+    // B) Park: the next worker to publish signals the eventfd.
+    ConsumerWakeup& wakeup = g_engine.control().wakeup;
+    wakeup.arm();
+    int rc = 1;
+    if (!data_ready()) {
+        rc = wakeup.wait(timeout_ms);
+    }
+    wakeup.disarm();
+    if (rc < 0) {
+        return -1;
+    }
+    return data_ready() ? 1 : 0;
+}
+
+extern "C" int get_wakeup_fd() {
+    return g_engine.control().wakeup.fd();
+}
+
+extern "C" int arm_wakeup() {
+    ConsumerWakeup& wakeup = g_engine.control().wakeup;
+    wakeup.arm();
+    if (data_ready()) {
+        wakeup.disarm();
+        return 1;
+    }
+    return 0;
+}
+
+extern "C" int wake_consumer() {
+    g_engine.control().wakeup.signal();
+    return 0;
+}
+
+extern "C" int read_batch(C_PacketData* dst, int max_records, uint64_t* dropped) {
+    if (dropped) {
+        *dropped = 0;
+    }
+    if (dst == nullptr || max_records <= 0) {
+        return 0;
+    }
+    const int count = merge_worker_rings(dst, max_records, dropped, g_next_worker, g_reported_drops,
+                                         [](CaptureWorker& w) -> auto& { return w.records(); });
+    if (count > 0) {
+        const uint64_t now = latency_clock_ns();
+        for (int i = 0; i < count; ++i) {
+            g_read_latency.record_span(static_cast<uint64_t>(dst[i].timestamp * 1e9), now);
+        }
+    }
+    return count;
+}
+
+extern "C" int read_payload_batch(C_PayloadSnapshot* dst, int max_records, uint64_t* dropped) {
+    if (dropped) {
+        *dropped = 0;
+    }
+    if (dst == nullptr || max_records <= 0) {
+        return 0;
+    }
+    return merge_worker_rings(dst, max_records, dropped, g_next_payload_worker, g_reported_payload_drops,
+                              [](CaptureWorker& w) -> auto& { return w.payloads(); });
+}
+
+extern "C" int read_flows(C_FlowRecord* dst, int max_records, uint64_t* dropped) {
+    if (dropped) {
+        *dropped = 0;
+    }
+    if (dst == nullptr || max_records <= 0) {
+        return 0;
+    }
+    return merge_worker_rings(dst, max_records, dropped, g_next_flow_worker, g_reported_flow_drops,
+                              [](CaptureWorker& w) -> auto& { return w.flows(); });
+}
+
+extern "C" int read_flow_features(float* features, uint64_t* flow_ids, C_FlowRecord* records,
+                                  int max_flows, uint64_t* dropped) {
+    if (dropped) {
+        *dropped = 0;
+    }
+    if (features == nullptr || max_flows <= 0) {
+        return 0;
+    }
+    if (records == nullptr) {
+        if (g_feature_scratch.size() < static_cast<size_t>(max_flows)) {
+            g_feature_scratch.resize(static_cast<size_t>(max_flows));
+        }
+        records = g_feature_scratch.data();
+    }
+    const int count = read_flows(records, max_flows, dropped);
+    compute_flow_features(records, static_cast<size_t>(count), features, flow_ids);
+    return count;
+}
+
+extern "C" int get_flow_table_stats(C_FlowTableStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    *stats = C_FlowTableStats{};
+    for (auto& worker : g_engine.workers()) {
+        if (!worker->ready()) {
+            continue;
+        }
+        worker->add_flow_stats(*stats);
+    }
+    return 0;
+}
+
+extern "C" int get_engine_stats(C_EngineStats* stats) {
+    constexpr size_t min_size = offsetof(C_EngineStats, workers);
+    if (stats == nullptr || stats->struct_size < min_size) {
+        return -1;
+    }
+    // Older callers have room for fewer workers; they still get the totals.
+    const size_t room = std::min<size_t>(stats->struct_size, sizeof(C_EngineStats));
+    const size_t max_workers = std::min<size_t>((room - min_size) / sizeof(C_WorkerStats), SNIFFER_MAX_QUEUES);
+
+    // One worker list for the whole snapshot: a restart meanwhile does not
+    // mix two runs' workers (or free the ones being read).
+    const WorkerSnapshot workers = g_engine.workers();
+    C_EngineStats snapshot{};
+    snapshot.struct_size = static_cast<uint32_t>(room);
+    snapshot.state = g_engine.state(workers);
+    snapshot.totals.cpu = -1;
+    C_WorkerStats& totals = snapshot.totals;
+    for (auto& worker : workers) {
+        if (!worker->ready()) {
+            continue;
+        }
+        C_WorkerStats current;
+        worker->fill_stats(current);
+        totals.packets += current.packets;
+        totals.bytes += current.bytes;
+        totals.kernel_drops += current.kernel_drops;
+        totals.frame_ring_drops += current.frame_ring_drops;
+        totals.record_ring_drops += current.record_ring_drops;
+        totals.payload_ring_drops += current.payload_ring_drops;
+        totals.flow_ring_drops += current.flow_ring_drops;
+        totals.flows_active += current.flows_active;
+        totals.flows_evicted += current.flows_evicted;
+        totals.polls += current.polls;
+        totals.batches += current.batches;
+        for (int b = 0; b < SNIFFER_BATCH_BUCKETS; ++b) {
+            totals.batch_sizes[b] += current.batch_sizes[b];
+        }
+        if (snapshot.worker_count < max_workers) {
+            snapshot.workers[snapshot.worker_count++] = current;
+        }
+        snapshot.memory_budget += worker->memory_budget();
+        snapshot.memory_used += worker->memory_used();
+    }
+    std::memcpy(stats, &snapshot, room);
+    return 0;
+}
+
+extern "C" int get_latency_histogram(int stage, C_LatencyHistogram* histogram) {
+    if (histogram == nullptr || stage < 0 || stage >= SNIFFER_LAT_STAGES) {
+        return -1;
+    }
+    std::memset(histogram, 0, sizeof(*histogram));
+    if (stage == SNIFFER_LAT_CAPTURE_TO_READ) {
+        g_read_latency.merge_into(*histogram);
+    } else if (stage == SNIFFER_LAT_FLOW_EXPORT_TO_READ) {
+        g_flow_read_latency.merge_into(*histogram);
+    } else {
+        for (auto& worker : g_engine.workers()) {
+            if (worker->ready()) {
+                worker->merge_latency(stage, *histogram);
+            }
+        }
+    }
+    finish_latency_snapshot(*histogram);
+    return 0;
+}
+
+extern "C" int get_replay_stats(C_ReplayStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    C_ReplayStats snapshot{};
+    snapshot.finished = 1;
+    uint64_t started = UINT64_MAX;
+    uint64_t finished = 0;
+    size_t replaying = 0;
+    uint64_t file_bytes = 0;
+    uint64_t file_offset = 0;
+    for (auto& worker : g_engine.workers()) {
+        ReplayProgress progress;
+        if (!worker->ready() || !worker->replay_progress(progress)) {
+            continue;
+        }
+        ++replaying;
+        C_WorkerStats current;
+        worker->fill_stats(current);
+        snapshot.frames += progress.frames;
+        snapshot.bytes += progress.bytes;
+        snapshot.skipped = std::max(snapshot.skipped, progress.skipped);  // Each worker sees every record
+        snapshot.delivered += current.packets - std::min(current.packets, current.record_ring_drops);
+        snapshot.record_ring_drops += current.record_ring_drops;
+        snapshot.speed = progress.speed;
+        if (progress.finished_ns == 0) {
+            snapshot.finished = 0;
+        }
+        if (progress.started_ns != 0) {
+            started = std::min(started, progress.started_ns);
+        }
+        finished = std::max(finished, progress.finished_ns);
+        // Every worker walks the whole file; the slowest one is the progress.
+        file_bytes = progress.file_bytes;
+        file_offset = replaying == 1 ? progress.file_offset : std::min(file_offset, progress.file_offset);
+    }
+    if (replaying == 0) {
+        return -1;
+    }
+    if (started != UINT64_MAX) {
+        const uint64_t end = snapshot.finished ? finished : latency_clock_ns();
+        snapshot.elapsed_ns = end > started ? end - started : 0;
+    }
+    if (snapshot.elapsed_ns != 0) {
+        snapshot.pps = static_cast<double>(snapshot.delivered) * 1e9 / static_cast<double>(snapshot.elapsed_ns);
+    }
+    snapshot.progress = file_bytes ? static_cast<double>(file_offset) / static_cast<double>(file_bytes) : 0;
+    *stats = snapshot;
+    return 0;
+}
+
+extern "C" int get_ring_stats(int ring, C_RingStats* stats) {
+    if (stats == nullptr || ring < SNIFFER_RING_RECORDS || ring > SNIFFER_RING_FLOWS) {
+        return -1;
+    }
+    *stats = C_RingStats{};
+
+    auto add = [stats](const auto& r) {
+        stats->capacity += r.capacity();
+        stats->occupancy += r.size_approx();
+        stats->dropped += r.dropped();
+    };
+    for (auto& worker : g_engine.workers()) {
+        if (!worker->ready()) {
+            continue;
+        }
+        if (ring == SNIFFER_RING_RECORDS) {
+            add(worker->records());
+        } else if (ring == SNIFFER_RING_PAYLOAD) {
+            add(worker->payloads());
+        } else {
+            add(worker->flows());
+        }
+    }
+    return 0;
+}
+
+static_assert(FLOW_FLAG_MAX == FlowFlagSet::MAX_FLOWS, "FLOW_FLAG_MAX must match FlowFlagSet");
+
+extern "C" int set_payload_policy(int mode, uint32_t max_bytes, uint32_t packets_per_flow) {
+    if (mode < SNIFFER_PAYLOAD_OFF || mode > SNIFFER_PAYLOAD_FLAGGED || max_bytes > C_PAYLOAD_SNAPSHOT_BYTES ||
+        (mode == SNIFFER_PAYLOAD_FIRST && packets_per_flow == 0)) {
+        return -1;
+    }
+    EngineControl& control = g_engine.control();
+    control.payload_bytes.store(max_bytes != 0 ? max_bytes : C_PAYLOAD_SNAPSHOT_BYTES, std::memory_order_relaxed);
+    control.payload_packets.store(packets_per_flow, std::memory_order_relaxed);
+    control.payload_mode.store(mode, std::memory_order_relaxed);
+    return 0;
+}
+
+extern "C" int flag_flow_payload(uint64_t flow_id, int flagged) {
+    FlowFlagSet& flows = g_engine.control().payload_flows;
+    if (flagged == 0) {
+        flows.remove(flow_id);
+        return 0;
+    }
+    return flows.add(flow_id) ? 0 : -1;
+}
+
+extern "C" int clear_flagged_flows() {
+    g_engine.control().payload_flows.clear();
+    return 0;
+}
+
+extern "C" int set_payload_snapshots(int enabled) {
+    return set_payload_policy(enabled != 0 ? SNIFFER_PAYLOAD_ALL : SNIFFER_PAYLOAD_OFF, 0, 0);
+}
+
+extern "C" int set_shared_ring(const char* name, uint32_t slots_per_queue, uint32_t flags) {
+    if (name != nullptr && slots_per_queue != 0 && (name[0] == '\0' || (flags & ~SNIFFER_SHM_HUGETLB) != 0)) {
+        return -1;
+    }
+    g_engine.set_shared_ring(name ? name : "", name ? slots_per_queue : 0, flags);
+    return 0;
+}
+
+extern "C" int get_shared_ring_info(C_SharedRingInfo* info) {
+    if (info == nullptr) {
+        return -1;
+    }
+    return g_engine.shared_ring_info(*info) ? 0 : -1;
+}
+
+extern "C" int set_capture_filter(const C_BpfInsn* program, uint32_t length) {
+    std::vector<C_BpfInsn> loaded;
+    if (!load_bpf(program, length, loaded)) {
+        return -1;
+    }
+    g_engine.set_capture_filter(std::move(loaded));
+    return 0;
+}
+
+extern "C" int set_shed_rules(const C_ShedRule* rules, uint32_t count) {
+    std::vector<CompiledShedRule> compiled;
+    if (!load_shed_rules(rules, count, compiled)) {
+        return -1;
+    }
+    g_engine.set_shed_rules(std::move(compiled));
+    return 0;
+}
+
+extern "C" int get_shed_stats(C_ShedStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    C_ShedStats totals{};
+    for (auto& worker : g_engine.workers()) {
+        if (worker->ready()) {
+            worker->add_shed_stats(totals);
+        }
+    }
+    *stats = totals;
+    return 0;
+}
+
+extern "C" int set_sketch_config(const C_SketchConfig* config) {
+    SketchSettings settings;
+    if (config == nullptr || !load_sketch_settings(*config, settings)) {
+        return -1;
+    }
+    g_engine.update_dataplane([&settings](DataplaneConfig& dataplane) { dataplane.sketch = settings; });
+    return 0;
+}
+
+extern "C" int set_sketch_alert_callback(sniffer_alert_callback callback, void* context) {
+    g_engine.control().alert_sink.set(callback, context);
+    return 0;
+}
+
+extern "C" int read_sketch_alerts(C_SketchAlert* dst, int max_alerts, uint64_t* dropped) {
+    if (dropped) {
+        *dropped = 0;
+    }
+    if (dst == nullptr || max_alerts <= 0) {
+        return 0;
+    }
+    return merge_worker_rings(dst, max_alerts, dropped, g_next_alert_worker, g_reported_alert_drops,
+                              [](CaptureWorker& w) -> auto& { return w.alerts(); });
+}
+
+extern "C" int get_sketch_stats(C_SketchStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    C_SketchStats totals{};
+    totals.window_ns = g_engine.dataplane()->sketch.window_ns;
+    std::vector<C_HeavyHitter> sources;
+    std::vector<MergedDestination> destinations;
+    std::vector<C_HeavyHitter> ports;
+    SketchWindow window;
+    for (auto& worker : g_engine.workers()) {
+        if (!worker->ready() || !worker->sketch_snapshot(totals, window)) {
+            continue;
+        }
+        if (totals.window_start_ns == 0 || window.start_ns < totals.window_start_ns) {
+            totals.window_start_ns = window.start_ns;
+        }
+        totals.window_packets += window.packets;
+        for (uint32_t i = 0; i < window.src_count; ++i) {
+            merge_hitter(sources, window.top_src[i], [](const C_HeavyHitter& a, const C_HeavyHitter& b) {
+                return std::memcmp(a.addr, b.addr, sizeof(a.addr)) == 0;
+            });
+        }
+        for (uint32_t i = 0; i < window.dst_count; ++i) {
+            MergedDestination& merged = merge_hitter(
+                destinations, window.top_dst[i].hitter, [](const MergedDestination& a, const C_HeavyHitter& b) {
+                    return std::memcmp(a.hitter.addr, b.addr, sizeof(b.addr)) == 0;
+                });
+            merged.sources.merge(window.top_dst[i].registers);
+            merged.hitter.sources = static_cast<uint32_t>(std::lround(merged.sources.estimate()));
+        }
+        for (uint32_t i = 0; i < window.port_count; ++i) {
+            merge_hitter(ports, window.top_ports[i], [](const C_HeavyHitter& a, const C_HeavyHitter& b) {
+                return a.port == b.port && a.protocol == b.protocol;
+            });
+        }
+    }
+    totals.src_count = top_hitters(sources, totals.top_src);
+    totals.dst_count = top_hitters(destinations, totals.top_dst);
+    totals.port_count = top_hitters(ports, totals.top_ports);
+    *stats = totals;
+    return 0;
+}
+
+extern "C" int set_flow_log(const C_FlowLogConfig* config) {
+    FlowLogSettings settings;
+    if (config != nullptr) {
+        const size_t length = strnlen(config->directory, sizeof(config->directory));
+        if (length == sizeof(config->directory) ||
+            (config->streams & ~(SNIFFER_LOG_FLOWS | SNIFFER_LOG_DECISIONS)) != 0) {
+            return -1;
+        }
+        settings.directory.assign(config->directory, length);
+        while (settings.directory.size() > 1 && settings.directory.back() == '/') {
+            settings.directory.pop_back();
+        }
+        settings.streams = config->streams;
+        settings.segment_rows = config->segment_rows != 0 ? config->segment_rows : SNIFFER_LOG_DEFAULT_ROWS;
+        settings.segment_seconds = config->segment_seconds;
+        settings.retain_segments = config->retain_segments;
+    }
+    g_engine.set_flow_log(settings);
+    return 0;
+}
+
+extern "C" int log_decision(const C_SketchAlert* decision, const char* reason) {
+    if (decision == nullptr) {
+        return -1;
+    }
+    return g_engine.log_decision(*decision, reason) ? 0 : -1;
+}
+
+extern "C" int get_flow_log_stats(C_FlowLogStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    C_FlowLogStats totals{};
+    g_engine.flow_log_stats(totals);
+    *stats = totals;
+    return 0;
+}
+
+extern "C" int set_flow_model(const void* image, uint64_t size) {
+    if (image == nullptr || size == 0) {
+        g_engine.control().flow_model.set(nullptr);
+        return 0;
+    }
+    std::string error;
+    std::shared_ptr<const FlowModel> model = FlowModel::parse(image, static_cast<size_t>(size), error);
+    if (!model) {
+        std::cerr << "[C++ Engine ERROR] Invalid flow model: " << error << "." << std::endl;
+        return -1;
+    }
+    g_engine.control().flow_model.set(std::move(model));
+    return 0;
+}
+
+extern "C" int get_flow_model_stats(C_FlowModelStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    C_FlowModelStats totals{};
+    const FlowModelSlot& slot = g_engine.control().flow_model;
+    const std::shared_ptr<const FlowModel> model = slot.get(&totals.generation);
+    if (model) {
+        totals.kind = model->kind();
+        totals.class_count = model->class_count();
+    }
+    for (auto& worker : g_engine.workers()) {
+        if (worker->ready()) {
+            worker->add_model_stats(totals);
+        }
+    }
+    *stats = totals;
+    return 0;
+}
+
+extern "C" int reload_dataplane_config(const C_DataplaneConfig* config) {
+    constexpr uint32_t known_fields =
+        SNIFFER_RELOAD_TIMEOUTS | SNIFFER_RELOAD_SKETCH | SNIFFER_RELOAD_FILTER | SNIFFER_RELOAD_SHED_RULES;
+    if (config == nullptr || (config->fields & ~known_fields) != 0) {
+        return -1;
+    }
+    // Everything is checked before anything is published.
+    const uint32_t fields = config->fields;
+    if ((fields & SNIFFER_RELOAD_TIMEOUTS) && (config->flow_active_timeout_ms == 0 ||
+                                               config->flow_idle_timeout_ms == 0 ||
+                                               config->flow_close_timeout_ms == 0)) {
+        std::cerr << "[C++ Engine ERROR] Invalid flow timeouts." << std::endl;
+        return -1;
+    }
+    SketchSettings sketch;
+    std::vector<C_BpfInsn> program;
+    std::vector<CompiledShedRule> rules;
+    if (((fields & SNIFFER_RELOAD_SKETCH) && !load_sketch_settings(config->sketch, sketch)) ||
+        ((fields & SNIFFER_RELOAD_FILTER) && !load_bpf(config->filter, config->filter_length, program)) ||
+        ((fields & SNIFFER_RELOAD_SHED_RULES) &&
+         !load_shed_rules(config->shed_rules, config->shed_rule_count, rules))) {
+        return -1;
+    }
+    g_engine.update_dataplane([&](DataplaneConfig& dataplane) {
+        if (fields & SNIFFER_RELOAD_TIMEOUTS) {
+            dataplane.flow_timeouts.active_ns = config->flow_active_timeout_ms * 1000000ull;
+            dataplane.flow_timeouts.idle_ns = config->flow_idle_timeout_ms * 1000000ull;
+            dataplane.flow_timeouts.close_ns = config->flow_close_timeout_ms * 1000000ull;
+        }
+        if (fields & SNIFFER_RELOAD_SKETCH) {
+            dataplane.sketch = sketch;
+        }
+        if (fields & (SNIFFER_RELOAD_FILTER | SNIFFER_RELOAD_SHED_RULES)) {
+            if (!(fields & SNIFFER_RELOAD_FILTER) && dataplane.filter) {
+                program = dataplane.filter->bpf();
+            }
+            if (!(fields & SNIFFER_RELOAD_SHED_RULES) && dataplane.filter) {
+                rules = dataplane.filter->rules();
+            }
+            dataplane.filter = std::make_shared<const CaptureFilter>(std::move(program), std::move(rules));
+        }
+    });
+    return 0;
+}
+
+extern "C" int get_dataplane_status(C_DataplaneStatus* status) {
+    if (status == nullptr) {
+        return -1;
+    }
+    C_DataplaneStatus snapshot{};
+    std::shared_ptr<const DataplaneConfig> current = g_engine.control().dataplane.get(&snapshot.generation);
+    if (!current) {
+        current = g_engine.dataplane();
+    }
+    snapshot.applied = snapshot.generation;
+    for (auto& worker : g_engine.workers()) {
+        // Parked workers switch when they resume; they are not behind.
+        if (!worker->ready() || worker->phase() != CaptureWorker::CAPTURING) {
+            continue;
+        }
+        const uint64_t generation = worker->config_generation();
+        if (generation < snapshot.generation) {
+            ++snapshot.workers_behind;
+            snapshot.applied = std::min(snapshot.applied, generation);
+        }
+    }
+    snapshot.flow_active_timeout_ms = static_cast<uint32_t>(current->flow_timeouts.active_ns / 1000000);
+    snapshot.flow_idle_timeout_ms = static_cast<uint32_t>(current->flow_timeouts.idle_ns / 1000000);
+    snapshot.flow_close_timeout_ms = static_cast<uint32_t>(current->flow_timeouts.close_ns / 1000000);
+    snapshot.sketch_window_ms = static_cast<uint32_t>(current->sketch.window_ns / 1000000);
+    if (current->filter) {
+        snapshot.filter_length = static_cast<uint32_t>(current->filter->bpf().size());
+        snapshot.shed_rule_count = static_cast<uint32_t>(current->filter->rules().size());
+    }
+    *status = snapshot;
+    return 0;
+}
+
+extern "C" int get_metrics_text(char* buffer, uint64_t size) {
+    std::lock_guard<std::mutex> lock(g_metrics_mutex);
+    g_metrics.clear();
+    render_metrics(g_metrics);
+    const std::string& text = g_metrics.text();
+    if (buffer != nullptr && size != 0) {
+        const size_t copied = std::min<size_t>(text.size(), static_cast<size_t>(size - 1));
+        std::memcpy(buffer, text.data(), copied);
+        buffer[copied] = '\0';
+    }
+    return static_cast<int>(text.size());
+}
+
+extern "C" int get_abi_info(C_SnifferAbiInfo* info) {
+    if (info) {
+        info->abi_version = SNIFFER_ABI_VERSION;
+        info->record_size = sizeof(C_PacketData);
+        info->record_stride = sizeof(C_PacketData); // Array stride; alignment padding is included
+        info->record_align = alignof(C_PacketData);
+        info->ring_slots = MAX_BUFFER_SLOTS;
+        info->payload_record_size = sizeof(C_PayloadSnapshot);
+        info->payload_bytes = C_PAYLOAD_SNAPSHOT_BYTES;
+        info->payload_ring_slots = PAYLOAD_RING_SLOTS; // Per capture worker
+        info->field_count = sizeof(g_abi_fields) / sizeof(g_abi_fields[0]);
+        info->flow_record_size = sizeof(C_FlowRecord);
+        info->flow_ring_slots = FLOW_RING_SLOTS; // Per capture worker
+        info->flow_feature_count = C_FLOW_FEATURE_COUNT;
+    }
+    return SNIFFER_ABI_VERSION;
+}
+
+extern "C" int get_abi_field(uint32_t index, C_AbiField* field) {
+    if (field == nullptr || index >= sizeof(g_abi_fields) / sizeof(g_abi_fields[0])) {
+        return -1;
+    }
+    *field = g_abi_fields[index];
+    return 0;
 }
 
 // C++ Implementation Notes:
 // - start_capture_engine: Must create a new thread and return immediately (non-blocking). 
 //   The new thread handles the packet capture loop and writes to the 'buffer'.
+//   start_capture_engine_ex does the same with one pinned thread per capture queue.
 // - get_write_index: Must atomically return the index (0-1023) where the C++ thread 
 //   last wrote data, allowing the Python thread to track new entries.
-// - stop_capture_engine: Must atomically set a global C++ flag to break the capture loop.
\ No newline at end of file
+// - read_batch: Preferred over get_write_index polling. Copies up to max_records
+//   published records into dst (handling the wrap) and reports how many were
+//   dropped since the last call because the ring was full. The producer never
+//   overwrites unread slots.
+// - wait_for_data: Replaces sleep-polling: spins adaptively, then parks on an
+//   eventfd the workers signal only while the reader is parked
+//   (get_wakeup_fd/arm_wakeup integrate the same fd with select or asyncio).
+// - set_payload_policy: Payload snapshots for a sample only (the first packets
+//   of each flow, or flows the WAF flagged), so deep inspection gets bytes
+//   without every record paying for a copy.
+// - read_flows: Finished flows from the native flow tables (see flow_table.h);
+//   replaces per-packet flow aggregation in Python. read_flow_features
+//   returns the same flows as a float32 matrix ready for a batch predict.
+// - get_engine_stats: Per-worker packet, drop, flow and batch counters. Each
+//   worker publishes its own cache-line-aligned copy once per poll; the
+//   snapshot only reads them, so polling it never slows capture down. The
+//   worker list comes from the engine's published copy (see WorkerSnapshot
+//   in capture_engine.h), so a scrape during a restart never races it.
+// - get_latency_histogram: Log-bucketed latency per pipeline stage, recorded
+//   by the thread that owns the stage and merged at snapshot time.
+// - get_replay_stats: Progress of a "pcap:" replay, and the packet rate the
+//   whole pipeline (capture ring -> record ring) sustained while it ran.
+// - set_shared_ring: Every record also goes to a memfd/hugetlbfs segment that
+//   other processes map read-only, each with its own cursor (see shared_ring.h).
+// - set_capture_filter / set_shed_rules: Shed known-good bulk traffic before
+//   it is parsed into a record: in the kernel (AF_PACKET) or in the worker.
+// - reload_dataplane_config: Timeouts, sketches, BPF program and shed rules
+//   change while capturing, as one config published through a double
+//   buffer (see config_slot.h) that the workers pick up between polls.
+// - get_metrics_text: OpenMetrics text from the same snapshots, for a
+//   scrape endpoint (see api_gateway.py's /metrics).
+// - set_sketch_config / set_sketch_alert_callback: Count-Min, top-K and
+//   HyperLogLog summaries per worker (see traffic_sketch.h); a threshold
+//   crossing reaches read_sketch_alerts from the capture thread, before the
+//   packet's record is even published, and the callback through the
+//   worker's queue to the alert dispatcher thread.
+// - C_CaptureConfig.memory_budget_mb: Each worker reserves its rings, flow
+//   table and sketch as one pre-faulted arena at start (see memory_arena.h)
+//   and never allocates again, so a flood cannot grow the engine.
+// - set_flow_log / log_decision: Finished flows and enforcement decisions go
+//   to preallocated, mmap'd columnar segment files with a time / flow-id
+//   index per block (see flow_log.h), instead of JSON rewritten per event.
+// - set_flow_model: The trained flow classifier (a tree ensemble or a linear
+//   model exported from Python) scores finished flows on the capture
+//   threads, a batch per poll (see flow_model.h); its DROP / RATE_LIMIT
+//   verdicts reach the enforcer through the alert callback.
+// - get_abi_info / get_abi_field: Consumers must check these against their own
+//   record mirror before touching the buffer (see packet_schema.h).
+// - stop_capture_engine: Atomically sets the engine's stop flag to break the capture
+//   loops, then waits (bounded) for them to drain and joins their threads.
+//   stop_capture_engine_ex(SNIFFER_STOP_KEEP_WARM) parks them instead, so the
+//   next matching start resumes without reopening sockets or rings.
\ No newline at end of file
@@ -0,0 +1,925 @@
+#ifndef SNIFFER_ENGINE_H
+#define SNIFFER_ENGINE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// 1. Packet Structure (to be stored in the ring buffer)
+//    Backends fill it in place through FrameSink (see capture_backend.h) and
+//    the capture loop parses it in place; only header.caplen bytes of data
+//    are ever written or read.
+struct alignas(64) CapturedPacket {
+    // You should use a sensible max capture length for high speed.
+    // 1518 is standard Ethernet MTU + headers. 65535 is the max for snaplen.
+    static constexpr int MAX_SNAPLEN = 2048;
+
+    // pcap_pkthdr-like header (nanosecond timestamp precision)
+    struct pcap_pkthdr {
+        uint32_t caplen;
+        uint32_t len;
+        uint32_t ts_sec;
+        uint32_t ts_nsec;
+    };
+    pcap_pkthdr header;
+    uint32_t rxhash;   // Kernel/NIC flow hash (0 if the source has none)
+    uint32_t flags;    // C_PKT_FLAG_* hints set by the source (e.g. the simulator's alerts)
+    uint8_t data[MAX_SNAPLEN];
+
+    uint64_t timestamp_ns() const {
+        return static_cast<uint64_t>(header.ts_sec) * 1000000000ull + header.ts_nsec;
+    }
+};
+
+// 2. Lossless SPSC ring (power-of-two, cache-line separated indices, drop counter)
+#include "ring_buffer.h"
+
+// Required signatures for the C++ library (libsniffer.so)
+
+// C_PacketData and C_PayloadSnapshot are defined once, with versioning, in packet_schema.h
+#include "packet_schema.h"
+
+// C_LatencyHistogram and its bucket layout
+#include "latency_histogram.h"
+
+// Define the buffer size (must match the Python/shared memory side)
+#define MAX_BUFFER_SLOTS 1024
+#define MAX_TIME_STAMP 1500
+
+// Slots in the engine-owned payload snapshot ring (per capture worker)
+#define PAYLOAD_RING_SLOTS 1024
+
+// Slots in each capture worker's frame ring (CapturedPacket). One poll's
+// batch (a 1 MB TPACKET_V3 block of minimum-size frames) must fit.
+#define FRAME_RING_SLOTS (1024 * 16)
+
+// Slots in each capture worker's finished-flow ring (C_FlowRecord)
+#define FLOW_RING_SLOTS 4096
+
+// Slots in each capture worker's sketch alert ring (C_SketchAlert)
+#define SKETCH_ALERT_RING_SLOTS 1024
+
+// Slots in each capture worker's queue of alerts for the alert callback
+// (set_sketch_alert_callback); beyond that alerts skip the callback
+#define SKETCH_CALLBACK_RING_SLOTS 1024
+
+// Slots in each capture worker's flow table index; it tracks at most 3/4 of
+// this many flows and evicts beyond that. C_CaptureConfig.memory_budget_mb
+// sizes it instead when set.
+#define FLOW_TABLE_SLOTS (1024 * 256)
+
+// =================================================================
+// CAPTURE CONFIGURATION
+// =================================================================
+
+#define SNIFFER_MAX_QUEUES 64
+
+// How packets are spread across capture workers (AF_PACKET fanout)
+#define SNIFFER_FANOUT_HASH 0  // By flow hash: a flow always lands on the same worker
+#define SNIFFER_FANOUT_CPU  1  // By the CPU that received the packet
+#define SNIFFER_FANOUT_QM   2  // By NIC RX queue (use with RSS + IRQ affinity)
+
+typedef struct C_CaptureConfig {
+    uint32_t struct_size;               // sizeof(C_CaptureConfig); lets the struct grow
+    uint32_t queues;                    // Capture workers (0 is treated as 1)
+    uint32_t fanout_mode;               // SNIFFER_FANOUT_*
+    int32_t  cpus[SNIFFER_MAX_QUEUES];  // CPU to pin worker i to, or -1 to leave it unpinned
+    uint32_t flow_active_timeout_ms;    // A flow is exported after this long (FlowAnalyzer's time_window;
+                                        // reload_dataplane_config() changes the three live)
+    uint32_t flow_idle_timeout_ms;      // ... or after this long without a packet
+    uint32_t flow_close_timeout_ms;     // ... or this long after its first FIN (a RST ends it at once)
+    uint32_t memory_budget_mb;          // Per worker: rings + flow table + sketches, reserved at start;
+                                        // the flow table gets what the rest leaves. 0 = FLOW_TABLE_SLOTS
+} C_CaptureConfig;
+
+// =================================================================
+// C EXPOSED FUNCTIONS
+// =================================================================
+
+extern "C" {
+
+/**
+ * Starts the capture engine on a background thread (non-blocking).
+ *
+ * interface_name selects the capture backend:
+ *   "eth0" or "afpacket:eth0"  -> AF_PACKET TPACKET_V3 mmap ring on eth0
+ *   "sim" or "sim:<pps>"       -> synthetic traffic generator (for tests)
+ *   "pcap:<file>[@<speed>]"    -> replay of a pcap/pcapng file: speed 1 (default)
+ *                                 keeps the recorded timing, 0 is flat out
+ *
+ * Returns 0 on success, 1 if already running (or a previous run is still
+ * draining), 2 if the thread could not be created, 3 if the backend failed
+ * to open its source.
+ */
+int start_capture_engine(const char* interface_name, C_PacketData* buffer);
+
+/**
+ * Fills *config with the defaults start_capture_engine uses
+ * (one unpinned worker, flow-hash fanout, 5 s active / 10 s idle / 1 s
+ * after-FIN flow timeouts).
+ * Callers built against an older, shorter C_CaptureConfig are accepted;
+ * the fields they lack keep these defaults.
+ */
+void init_capture_config(C_CaptureConfig* config);
+
+/**
+ * start_capture_engine with explicit configuration. With queues > 1 the
+ * engine starts one pinned capture worker per queue; each opens its own
+ * socket in a shared PACKET_FANOUT group and owns NUMA-local rings.
+ * Worker 0 writes into `buffer`; read_batch() merges all workers.
+ * Same return codes as start_capture_engine, plus 4 for an invalid config
+ * (including a memory budget too small for one worker), 5 if the
+ * shared-memory ring (see set_shared_ring) could not be created, 6 if a
+ * worker could not reserve its memory budget and 7 if the flow log (see
+ * set_flow_log) could not be opened.
+ *
+ * Each worker reserves all of its memory up front and never allocates
+ * while capturing: under a flood its flow table evicts instead of growing.
+ */
+int start_capture_engine_ex(const char* interface_name, C_PacketData* buffer,
+                            const C_CaptureConfig* config);
+
+/**
+ * Stops capture: signals every worker, then waits (up to 2 s) while each one
+ * drains what its source had already captured, closes it and exits; the
+ * threads are joined. Records drained this way stay readable through
+ * read_batch()/read_flows() until the next start.
+ * Returns 0, or -1 if a worker was still draining at the deadline (the
+ * buffer is still in use; call again to finish).
+ */
+int stop_capture_engine();
+
+// Flags for stop_capture_engine_ex
+#define SNIFFER_STOP_KEEP_WARM 1  // Park the workers with sockets, rings and flow tables kept
+
+/**
+ * stop_capture_engine with an explicit deadline. With SNIFFER_STOP_KEEP_WARM
+ * the workers drain and park instead of exiting; a following start with the
+ * same interface, buffer, queues, CPUs and fanout resumes them in place
+ * (new flow timeouts apply) without reopening anything. Any other start, or
+ * a stop without the flag, shuts the parked workers down.
+ * Same return values as stop_capture_engine.
+ */
+int stop_capture_engine_ex(uint32_t timeout_ms, uint32_t flags);
+
+// Engine states reported by get_capture_state
+#define SNIFFER_STATE_STOPPED  0  // No capture threads
+#define SNIFFER_STATE_RUNNING  1
+#define SNIFFER_STATE_PARKED   2  // Stopped with SNIFFER_STOP_KEEP_WARM; a start resumes warm
+#define SNIFFER_STATE_STOPPING 3  // Stop signalled, workers still draining
+
+int get_capture_state();
+
+int get_write_index();
+
+/**
+ * Copies up to max_records newly published records into dst, handling the
+ * wrap at the end of the shared buffer. With several capture workers the
+ * per-worker rings are merged; order is preserved per flow, not globally. On return *dropped (if non-null)
+ * holds the number of records dropped because the ring was full, since the last call.
+ * Returns the number of records copied. Single consumer only.
+ */
+int read_batch(C_PacketData* dst, int max_records, uint64_t* dropped);
+
+/**
+ * Waits, as the single reader, until a record ring or flow ring has
+ * something to read, instead of polling on a sleep. It spins briefly
+ * (adaptively, for as long as spinning recently paid off), then blocks on
+ * an eventfd that the capture workers signal only while the reader is
+ * parked. Returns 1 when there is data, 0 on timeout (-1 waits forever),
+ * -1 on error. wake_consumer() makes it return early.
+ */
+int wait_for_data(int timeout_ms);
+
+/**
+ * The eventfd behind wait_for_data(), for select/poll/epoll or asyncio
+ * (loop.add_reader). It becomes readable only after arm_wakeup() returned 0.
+ */
+int get_wakeup_fd();
+
+/**
+ * Parks the reader for an external wait on get_wakeup_fd(). Returns 1 if
+ * data is already there (nothing armed: read it now), 0 once armed. The
+ * next arm_wakeup() or wait_for_data() clears the fd again.
+ */
+int arm_wakeup();
+
+/**
+ * Signals the wakeup fd, e.g. so a reader blocked in wait_for_data() sees a stop.
+ */
+int wake_consumer();
+
+/**
+ * Describes the record layout this library was built with.
+ * Returns SNIFFER_ABI_VERSION; fills *info when non-null.
+ */
+int get_abi_info(C_SnifferAbiInfo* info);
+
+/**
+ * Describes field `index` of C_PacketData (0 <= index < field_count).
+ * Returns 0 on success, -1 if index is out of range.
+ */
+int get_abi_field(uint32_t index, C_AbiField* field);
+
+// Which frames set_payload_policy() snapshots into the payload ring
+#define SNIFFER_PAYLOAD_OFF     0  // None (the default)
+#define SNIFFER_PAYLOAD_ALL     1  // Every frame
+#define SNIFFER_PAYLOAD_FIRST   2  // The first packets_per_flow packets of every flow
+#define SNIFFER_PAYLOAD_FLAGGED 3  // Flows flagged with flag_flow_payload(), and C_PKT_FLAG_ALERT frames
+
+// Flows flag_flow_payload() can hold at once
+#define FLOW_FLAG_MAX 2048
+
+/**
+ * Sets which frames get a payload snapshot. A snapshot holds the first
+ * max_bytes (1..C_PAYLOAD_SNAPSHOT_BYTES; 0 = all of them) of the frame; the
+ * metadata record's payload_ref points at it and its flow_hash is the
+ * flow_id of the flow's C_FlowRecord. packets_per_flow caps the snapshots
+ * per flow: the first N packets in FIRST mode (N >= 1), the first N after
+ * the flow was flagged in FLAGGED mode (0 = no cap). Takes effect at once.
+ * Returns 0, or -1 for invalid settings.
+ */
+int set_payload_policy(int mode, uint32_t max_bytes, uint32_t packets_per_flow);
+
+/**
+ * Flags (non-zero) or unflags a flow for SNIFFER_PAYLOAD_FLAGGED snapshots,
+ * by its flow_id / flow_hash. A flow that already started is sampled from its
+ * next packet. Returns 0, or -1 if FLOW_FLAG_MAX flows are flagged already.
+ */
+int flag_flow_payload(uint64_t flow_id, int flagged);
+
+/**
+ * Unflags every flow.
+ */
+int clear_flagged_flows();
+
+/**
+ * set_payload_policy(SNIFFER_PAYLOAD_ALL, 0, 0) when enabled is non-zero,
+ * SNIFFER_PAYLOAD_OFF otherwise (the original on/off switch).
+ */
+int set_payload_snapshots(int enabled);
+
+/**
+ * Same contract as read_batch(), for the payload snapshot ring.
+ */
+int read_payload_batch(C_PayloadSnapshot* dst, int max_records, uint64_t* dropped);
+
+/**
+ * Occupancy and overrun counters of one ring (summed over capture workers).
+ */
+typedef struct C_RingStats {
+    uint64_t capacity;   // Slots in the ring
+    uint64_t occupancy;  // Published, unread records
+    uint64_t dropped;    // Records rejected because the ring was full (since start)
+} C_RingStats;
+
+#define SNIFFER_RING_RECORDS 0  // The C_PacketData ring
+#define SNIFFER_RING_PAYLOAD 1  // The C_PayloadSnapshot ring
+#define SNIFFER_RING_FLOWS   2  // The C_FlowRecord ring
+
+/**
+ * Fills *stats for ring SNIFFER_RING_*. Returns 0, or -1 for an unknown ring.
+ */
+int get_ring_stats(int ring, C_RingStats* stats);
+
+/**
+ * Same contract as read_batch(), for finished flows. A flow is finished when
+ * it reaches the active, idle or after-FIN timeout or sees a TCP RST
+ * (timer resolution ~17 ms). When a worker's flow table is full, the flow
+ * closest to expiring is exported early with C_FLOW_FLAG_EVICTED.
+ */
+int read_flows(C_FlowRecord* dst, int max_records, uint64_t* dropped);
+
+/**
+ * read_flows() for the detector: writes up to max_flows finished flows as a
+ * float32 feature matrix features[max_flows][C_FLOW_FEATURE_COUNT]
+ * (row-major) plus the parallel flow_ids[max_flows]. Both are caller-owned
+ * buffers that Python can allocate once and view with np.frombuffer.
+ * records (may be null) receives the matching C_FlowRecords, e.g. to name
+ * the flows a prediction flags. Returns the number of rows written.
+ */
+int read_flow_features(float* features, uint64_t* flow_ids, C_FlowRecord* records,
+                       int max_flows, uint64_t* dropped);
+
+/**
+ * Occupancy and expiry counters of the per-worker flow tables (summed over
+ * capture workers; counters run since start).
+ */
+typedef struct C_FlowTableStats {
+    uint64_t capacity;        // Flows the tables can hold
+    uint64_t active_flows;    // Flows currently tracked
+    uint64_t rejected;        // New flows that could not be tracked at all
+    uint64_t expired_active;  // Flows ended by the active timeout
+    uint64_t expired_idle;    // Flows ended by the idle timeout
+    uint64_t closed;          // Flows ended by FIN or RST
+    uint64_t evicted;         // Flows exported early because a table was full
+} C_FlowTableStats;
+
+int get_flow_table_stats(C_FlowTableStats* stats);
+
+// Poll batch size histogram of C_WorkerStats: bucket 0 counts polls that
+// delivered 1 frame, bucket b (1..) those that delivered 2^b .. 2^(b+1)-1,
+// the last bucket everything above.
+#define SNIFFER_BATCH_BUCKETS 12
+
+/**
+ * Counters of one capture worker since the engine's last cold start. The
+ * worker publishes them once per poll, on a cache line of their own, so a
+ * snapshot only ever reads; values of different fields may be one poll apart.
+ */
+typedef struct C_WorkerStats {
+    uint32_t queue_id;
+    int32_t  cpu;                 // Pinned CPU, or -1
+    uint64_t packets;             // Frames the worker parsed
+    uint64_t bytes;               // Their length on the wire
+    uint64_t kernel_drops;        // Dropped by the kernel before the worker saw them (AF_PACKET)
+    uint64_t frame_ring_drops;    // Lost because the worker's frame ring was full
+    uint64_t record_ring_drops;   // Records lost because the reader fell behind
+    uint64_t payload_ring_drops;
+    uint64_t flow_ring_drops;
+    uint64_t flows_active;
+    uint64_t flows_evicted;       // Exported early because the flow table was full
+    uint64_t polls;               // Backend polls
+    uint64_t batches;             // ... that delivered frames
+    uint64_t batch_sizes[SNIFFER_BATCH_BUCKETS];
+} C_WorkerStats;
+
+typedef struct C_EngineStats {
+    uint32_t struct_size;         // Set by the caller: sizeof(C_EngineStats) it was built with
+    int32_t  state;               // SNIFFER_STATE_*
+    uint32_t worker_count;        // Entries of workers[] filled
+    uint32_t reserved;
+    C_WorkerStats totals;         // Sum over the workers (queue_id 0, cpu -1)
+    C_WorkerStats workers[SNIFFER_MAX_QUEUES];
+    uint64_t memory_budget;       // Bytes the workers reserved at start (summed)
+    uint64_t memory_used;         // ... of which their rings, tables and sketches take
+} C_EngineStats;
+
+/**
+ * Snapshots the engine's telemetry into *stats. Lock-free and read-only:
+ * it never stalls or writes to what the capture threads touch, and never
+ * waits for a start or stop. It reads the worker list the last start
+ * published; a concurrent restart cannot free the workers it is reading.
+ * The other get_* calls work the same way.
+ * Callers built against a shorter C_EngineStats get the fields they know.
+ * Returns 0, or -1 if stats is null or struct_size is too small.
+ */
+int get_engine_stats(C_EngineStats* stats);
+
+// Pipeline stages timed by get_latency_histogram (nanoseconds)
+#define SNIFFER_LAT_CAPTURE_TO_PUBLISH  0  // Capture timestamp -> record published to the ring
+#define SNIFFER_LAT_CAPTURE_TO_READ     1  // Capture timestamp -> read_batch() copy-out (+-0.25 us: the record keeps a double)
+#define SNIFFER_LAT_FLOW_UPDATE         2  // One flow table update (1 in 64 timed)
+#define SNIFFER_LAT_FLOW_EXPORT_TO_READ 3  // Flow exported by the table -> read_flows()/read_flow_features()
+#define SNIFFER_LAT_STAGES              4
+
+/**
+ * Snapshots the latency histogram of stage SNIFFER_LAT_* (merged over the
+ * capture workers; since the engine's last cold start, reader stages since
+ * load). Recording is per thread and never locks; neither does this.
+ * Subtract two snapshots' buckets to get a window (e.g. the last minute's p99).
+ * Returns 0, or -1 for an unknown stage.
+ */
+int get_latency_histogram(int stage, C_LatencyHistogram* histogram);
+
+typedef struct C_ReplayStats {
+    uint32_t finished;            // Every worker has reached the end of the file
+    uint32_t reserved;
+    uint64_t frames;              // Frames replayed into the engine (all workers)
+    uint64_t bytes;               // ... their length on the wire
+    uint64_t skipped;             // Records of link types the engine cannot parse
+    uint64_t delivered;           // Records that reached the record rings
+    uint64_t record_ring_drops;   // Records lost because the reader fell behind
+    uint64_t elapsed_ns;          // First frame out -> end of file (or now)
+    double   speed;               // Replay speed (0 = flat out)
+    double   pps;                 // delivered / elapsed: what the whole pipeline sustained
+    double   progress;            // Fraction of the file consumed (0..1)
+} C_ReplayStats;
+
+/**
+ * Progress of a "pcap:" replay started with start_capture_engine(_ex).
+ * Stays readable after the replay finished or the engine stopped, until
+ * the next cold start. Returns 0, or -1 if the source is not a replay.
+ */
+int get_replay_stats(C_ReplayStats* stats);
+
+// =================================================================
+// SHARED-MEMORY RECORD RING (for consumers in other processes)
+// =================================================================
+//
+// A segment of one header page plus one lane per capture worker:
+//
+//   C_SharedRingHeader at offset 0
+//   lane i at lane_offset + i * lane_stride:
+//     +0                       uint64_t write_pos    Records published (free-running)
+//     +64                      uint64_t reserve_pos  Records the producer may be writing, at most
+//     +SNIFFER_SHM_LANE_RECORDS C_PacketData[lane_slots], record p in slot p % lane_slots
+//
+// Every record the worker's record ring gets is also written here, whether
+// or not read_batch() keeps up. The producer never waits: consumers map the
+// segment read-only, keep their own cursor per lane and notice when they
+// fell more than lane_slots behind. A consumer reads w = write_pos, copies
+// records [max(cursor, w - lane_slots), w), then reads r = reserve_pos; the
+// copies of records below r - lane_slots may have been overwritten meanwhile
+// and are discarded (and counted as lost).
+
+#define SNIFFER_SHM_MAGIC        0x474E5253u  // "SRNG"
+#define SNIFFER_SHM_VERSION      1
+#define SNIFFER_SHM_LANE_RECORDS 128          // Offset of a lane's first record
+
+// Flags for set_shared_ring
+#define SNIFFER_SHM_HUGETLB 1  // Back it with huge pages (falls back to normal pages if none are free)
+
+typedef struct C_SharedRingHeader {
+    uint32_t magic;          // SNIFFER_SHM_MAGIC, written last
+    uint32_t version;        // SNIFFER_SHM_VERSION
+    uint32_t abi_version;    // SNIFFER_ABI_VERSION of the records
+    uint32_t record_size;    // sizeof(C_PacketData)
+    uint32_t lane_count;     // One lane per capture worker
+    uint32_t lane_slots;     // Records per lane (a power of two)
+    uint64_t lane_offset;    // Segment offset of lane 0
+    uint64_t lane_stride;    // Bytes from one lane to the next
+    uint64_t segment_size;   // Bytes to map
+    uint32_t pid;            // Process of the engine writing it
+    uint32_t closed;         // Set when the engine stops writing this segment for good
+} C_SharedRingHeader;
+
+typedef struct C_SharedRingInfo {
+    char     path[256];      // What a consumer opens (read-only) and maps
+    uint64_t segment_size;
+    uint32_t lane_count;
+    uint32_t lane_slots;
+    uint32_t flags;          // SNIFFER_SHM_HUGETLB if huge pages back it
+    uint32_t reserved;
+} C_SharedRingInfo;
+
+/**
+ * Has the next cold start publish every record into a shared-memory ring
+ * of slots_per_queue records (rounded up to a power of two) per worker.
+ * `name` without a '/' names an anonymous memfd that consumers open
+ * through /proc/<pid>/fd (see get_shared_ring_info); a path (e.g. on a
+ * hugetlbfs mount or /dev/shm) creates that file instead; an existing file
+ * there is only replaced if it is a segment whose engine has closed it or
+ * exited, otherwise the start fails. A null name or
+ * zero slots turns the ring off. The segment survives stops and is reused
+ * by starts with the same settings, so consumers stay attached.
+ * Returns 0, or -1 for invalid arguments.
+ */
+int set_shared_ring(const char* name, uint32_t slots_per_queue, uint32_t flags);
+
+/**
+ * Describes the current shared-memory ring. Returns 0, or -1 if there is none.
+ */
+int get_shared_ring_info(C_SharedRingInfo* info);
+
+// =================================================================
+// TRAFFIC SHEDDING (before a frame costs a record slot)
+// =================================================================
+//
+// Two optional stages run on every frame before it is parsed into a record:
+// a classic BPF program (frames it rejects are shed) and shed rules that
+// match known-good bulk traffic by protocol, port range and CIDR (frames a
+// rule matches are shed). Shed frames never reach the flow table, the
+// record ring or the analyzer. Both apply live: capture workers switch at
+// their next poll (AF_PACKET swaps the socket's program in place) and later
+// starts begin with them (see reload_dataplane_config()).
+
+// One classic BPF instruction: struct sock_filter, as `tcpdump -dd` prints it
+typedef struct C_BpfInsn {
+    uint16_t code;
+    uint8_t  jt;
+    uint8_t  jf;
+    uint32_t k;
+} C_BpfInsn;
+
+#define SNIFFER_MAX_SHED_RULES 32
+
+// C_ShedRule.flags: which side a rule's address / port must be on (neither or both bits: either side)
+#define SNIFFER_SHED_ADDR_SRC 0x01u
+#define SNIFFER_SHED_ADDR_DST 0x02u
+#define SNIFFER_SHED_PORT_SRC 0x04u
+#define SNIFFER_SHED_PORT_DST 0x08u
+
+typedef struct C_ShedRule {
+    uint8_t  protocol;    // IP protocol number, 0 = any
+    uint8_t  flags;       // SNIFFER_SHED_*
+    uint8_t  prefix_len;  // CIDR prefix over the 128-bit address (IPv4: 96 + n); 0 = any address
+    uint8_t  reserved;
+    uint16_t port_min;    // Port range, inclusive; 0..0 = any port
+    uint16_t port_max;
+    uint8_t  addr[16];    // Network byte order; IPv4 as ::ffff:a.b.c.d
+} C_ShedRule;
+
+/**
+ * Sets the BPF program (length instructions; a null program or 0 removes
+ * it), live. AF_PACKET attaches it to the socket, so the
+ * kernel sheds before anything is copied; other backends run it in the
+ * capture worker. Returns 0, or -1 if it is not a valid program.
+ */
+int set_capture_filter(const C_BpfInsn* program, uint32_t length);
+
+/**
+ * Sets the shed rules (count <= SNIFFER_MAX_SHED_RULES; 0 removes them), live. They apply to parsed IP frames; the first match sheds.
+ * Returns 0, or -1 for an invalid rule.
+ */
+int set_shed_rules(const C_ShedRule* rules, uint32_t count);
+
+/**
+ * What was shed since the last cold start (summed over capture workers).
+ */
+typedef struct C_ShedStats {
+    uint64_t filter_packets;  // Rejected by the BPF program in a capture worker
+    uint64_t filter_bytes;    // ... their length on the wire
+    uint64_t rule_packets;    // Matched by a shed rule
+    uint64_t rule_bytes;
+    uint64_t rule_hits[SNIFFER_MAX_SHED_RULES];  // Packets per rule, in set_shed_rules() order, since it was set
+    uint32_t kernel_filter;   // 1 if the kernel runs the BPF program (its rejects are not counted)
+    uint32_t rule_count;
+} C_ShedStats;
+
+int get_shed_stats(C_ShedStats* stats);
+
+// =================================================================
+// TRAFFIC SKETCHES (volumetric attack detection in the engine)
+// =================================================================
+//
+// Fixed-memory streaming summaries every capture worker updates on each IP
+// packet, over counting windows of window_ms (capture time):
+// - Count-Min sketches of packets per source and per destination address,
+// - space-saving top-K tables of sources, destinations and (protocol,
+//   destination port), the destinations with a HyperLogLog of their
+//   distinct sources.
+// A packet that takes a source or destination over a threshold raises a
+// C_SketchAlert at once, on the capture thread: into the worker's alert
+// ring (read_sketch_alerts) and, if an alert callback is set, onto the
+// worker's queue for the engine thread that runs it. With
+// the SNIFFER_SKETCH_ENFORCE_* flags, each flow of an offending source (or
+// to an attacked destination) is alerted once with C_ALERT_FLAG_ENFORCE,
+// so the callback can ban it (see enforcer_sketch_alert in enforcer_api.h).
+//
+// Thresholds are per capture worker: with several workers a source's flows
+// may spread over all of them.
+
+#define SNIFFER_SKETCH_TOP_K 32
+
+// C_SketchConfig.flags
+#define SNIFFER_SKETCH_ENFORCE_SRC 0x01u  // Alert every flow of a source over src_packets for enforcement
+#define SNIFFER_SKETCH_ENFORCE_DST 0x02u  // ... every flow to a destination over dst_packets / dst_sources
+
+typedef struct C_SketchConfig {
+    uint32_t window_ms;     // Counting window; 0 turns the sketches off (the default)
+    uint32_t flags;         // SNIFFER_SKETCH_*
+    uint64_t src_packets;   // Alert when a source sends this many packets in a window; 0 = never
+    uint64_t dst_packets;   // ... when a destination receives this many
+    uint64_t dst_sources;   // ... when this many distinct sources reach one destination
+    uint8_t  alert_action;  // FirewallAction carried by enforcement alerts (e.g. 1 = DROP, 3 = RATE_LIMIT)
+    uint8_t  reserved[7];
+} C_SketchConfig;
+
+/**
+ * One top-K entry. Counts are space-saving estimates: at most `error`
+ * packets too high; bytes only count since the entry took its slot.
+ */
+typedef struct C_HeavyHitter {
+    uint8_t  addr[16];   // Source or destination (zero in the port table)
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t error;
+    uint32_t sources;    // Distinct sources (HyperLogLog, ~6.5%), destination table only
+    uint16_t port;       // Port table only
+    uint8_t  protocol;   // Port table only
+    uint8_t  reserved;
+} C_HeavyHitter;
+
+typedef struct C_SketchStats {
+    uint64_t window_ns;        // Window length in force
+    uint64_t window_start_ns;  // Start of the reported window (0 until one has finished)
+    uint64_t windows;          // Windows finished, summed over workers
+    uint64_t packets;          // Packets counted into the sketches
+    uint64_t window_packets;   // ... in the reported window
+    uint64_t alerts;           // Alerts raised
+    uint64_t alerts_dropped;   // ... that found the alert ring full (the callback still got them)
+    uint64_t callback_dropped; // ... that found the callback queue full (the alert ring still got them)
+    uint32_t src_count;        // Valid entries in top_src / top_dst / top_ports
+    uint32_t dst_count;
+    uint32_t port_count;
+    uint32_t reserved;
+    C_HeavyHitter top_src[SNIFFER_SKETCH_TOP_K];    // By packets, descending
+    C_HeavyHitter top_dst[SNIFFER_SKETCH_TOP_K];
+    C_HeavyHitter top_ports[SNIFFER_SKETCH_TOP_K];
+} C_SketchStats;
+
+/**
+ * Sets the sketch windows and thresholds; applies to running workers from
+ * their next poll (a new window length from their next window). Returns 0,
+ * or -1 if config is null or has unknown flags.
+ */
+int set_sketch_config(const C_SketchConfig* config);
+
+/**
+ * Called for every alert on one engine thread that drains the workers'
+ * queues of them, never on a capture thread: calls never overlap, and a
+ * slow callback (e.g. enforcer_sketch_alert, which may update the XDP map
+ * or rebuild the ban table) only delays enforcement, while alerts that
+ * find a worker's queue full are counted in C_SketchStats.callback_dropped.
+ * A null callback removes it; once this returns no call of the old one is
+ * still running.
+ */
+typedef void (*sniffer_alert_callback)(const C_SketchAlert* alert, void* context);
+
+int set_sketch_alert_callback(sniffer_alert_callback callback, void* context);
+
+/**
+ * Copies up to max_alerts raised alerts into dst (merged over workers).
+ * Returns how many; *dropped (if non-null) gets the alerts lost to a full
+ * ring since the last call.
+ */
+int read_sketch_alerts(C_SketchAlert* dst, int max_alerts, uint64_t* dropped);
+
+/**
+ * The top-K tables of the last finished window, merged over workers (the
+ * destinations' distinct sources are merged register by register), and the
+ * running counters.
+ */
+int get_sketch_stats(C_SketchStats* stats);
+
+// =================================================================
+// FLOW LOG (columnar segment files, in place of per-event JSON)
+// =================================================================
+//
+// With set_flow_log(), each capture worker appends every flow it finishes
+// (whether or not read_flows() keeps up) and every sketch alert it raises
+// to its own streams of fixed-size segment files; log_decision() entries
+// from the control plane get a stream of their own:
+//
+//   <directory>/flows-q<queue>-<sequence>.slog
+//   <directory>/decisions-q<queue>-<sequence>.slog
+//   <directory>/decisions-ctl-<sequence>.slog
+//
+// A segment is a C_FlowLogHeader page, then one column per field (the
+// value of row r at columns[c].offset + r * columns[c].width), then its
+// index: one C_FlowLogBlock per SNIFFER_LOG_BLOCK_ROWS rows, with the
+// block's time range and a Bloom filter of its flow ids. A file is
+// preallocated when it is created and never changes size; `rows` grows
+// as the writer appends (a release store after the row and its index
+// entry) and `sealed` is set once the writer moved on to the next one.
+// Readers map segments read-only, skip the segments and blocks outside
+// their time range or without their flow id, and touch only the columns
+// they need.
+//
+// Bloom filter: probe i (of SNIFFER_LOG_BLOOM_PROBES) of flow id h is bit
+// ((h & 0xFFFFFFFF) + i * (h >> 32)) % (64 * SNIFFER_LOG_BLOOM_WORDS).
+
+#define SNIFFER_LOG_MAGIC        0x474F4C53u  // "SLOG", written last
+#define SNIFFER_LOG_VERSION      1
+#define SNIFFER_LOG_MAX_COLUMNS  16
+#define SNIFFER_LOG_BLOCK_ROWS   256
+#define SNIFFER_LOG_BLOOM_WORDS  64           // 4096 bits per block
+#define SNIFFER_LOG_BLOOM_PROBES 3
+#define SNIFFER_LOG_DEFAULT_ROWS (1u << 16)   // Rows per segment unless set
+#define SNIFFER_LOG_CONTROL_LANE 0xFFFFu      // C_FlowLogHeader.lane of log_decision() entries
+
+// Streams (C_FlowLogConfig.streams, C_FlowLogHeader.kind)
+#define SNIFFER_LOG_FLOWS     0x01u  // C_FlowRecord fields; time = last_time
+#define SNIFFER_LOG_DECISIONS 0x02u  // C_SketchAlert fields plus `reason`; time = timestamp
+
+// C_FlowLogColumn.type
+#define SNIFFER_LOG_U8    1
+#define SNIFFER_LOG_U16   2
+#define SNIFFER_LOG_U32   3
+#define SNIFFER_LOG_U64   4
+#define SNIFFER_LOG_F64   5
+#define SNIFFER_LOG_BYTES 6  // `width` raw bytes (addresses, NUL-padded text)
+
+typedef struct C_FlowLogColumn {
+    char     name[24];     // NUL-padded field name
+    uint64_t offset;       // Segment offset of row 0
+    uint32_t width;        // Bytes per row
+    uint32_t type;         // SNIFFER_LOG_*
+} C_FlowLogColumn;
+
+typedef struct C_FlowLogHeader {
+    uint32_t magic;          // SNIFFER_LOG_MAGIC
+    uint32_t version;        // SNIFFER_LOG_VERSION
+    uint32_t kind;           // SNIFFER_LOG_FLOWS or SNIFFER_LOG_DECISIONS
+    uint32_t lane;           // Capture queue, or SNIFFER_LOG_CONTROL_LANE
+    uint64_t sequence;       // Segment number within its stream
+    uint64_t capacity;       // Rows it has room for
+    uint64_t rows;           // Rows written; only rows below it are complete
+    uint32_t sealed;         // 1 once the writer moved on: rows is final
+    uint32_t column_count;
+    double   min_time;       // Time range of the rows (seconds since the epoch)
+    double   max_time;
+    uint64_t index_offset;   // C_FlowLogBlock[capacity / SNIFFER_LOG_BLOCK_ROWS]
+    uint64_t segment_size;   // Bytes to map
+    uint32_t pid;            // Process of the engine that wrote it
+    uint32_t time_column;    // Column the time ranges are over
+    uint32_t hash_column;    // Column the Bloom filters are built from (flow_id)
+    uint32_t reserved;
+    C_FlowLogColumn columns[SNIFFER_LOG_MAX_COLUMNS];
+} C_FlowLogHeader;
+
+typedef struct C_FlowLogBlock {
+    double   min_time;       // Over the block's rows written so far (blocks past `rows` are unset)
+    double   max_time;
+    uint64_t bloom[SNIFFER_LOG_BLOOM_WORDS];
+} C_FlowLogBlock;
+
+typedef struct C_FlowLogConfig {
+    char     directory[256];   // Created if missing
+    uint32_t streams;          // SNIFFER_LOG_FLOWS | SNIFFER_LOG_DECISIONS
+    uint32_t segment_rows;     // Rows per segment (0 = SNIFFER_LOG_DEFAULT_ROWS), rounded up to whole blocks
+    uint32_t segment_seconds;  // Also rotate once a segment spans this long; 0 = only when full
+    uint32_t retain_segments;  // Per stream: older segments are deleted; 0 = keep them all
+} C_FlowLogConfig;
+
+typedef struct C_FlowLogStats {
+    uint64_t flow_rows;        // Rows appended since the last cold start
+    uint64_t decision_rows;
+    uint64_t segments;         // Segment files created
+    uint64_t bytes;            // ... and their size on disk
+    uint64_t rows_lost;        // Rows that found no segment (one could not be created)
+    uint32_t streams;          // What the current workers log (0 = no log)
+    uint32_t reserved;
+} C_FlowLogStats;
+
+/**
+ * Has the next cold start log to `config->directory`. A null config, an
+ * empty directory or no streams turns the log off. Warm restarts keep the
+ * workers' open segments. Returns 0, or -1 for invalid settings.
+ * start_capture_engine_ex returns 7 if the directory or a first segment
+ * cannot be created.
+ */
+int set_flow_log(const C_FlowLogConfig* config);
+
+/**
+ * Appends a control-plane enforcement decision (timestamp, flow_id, addr,
+ * action, ...; kind is usually C_ALERT_DECISION) with a short `reason`
+ * (truncated to 15 bytes, may be null) to the decisions-ctl stream.
+ * Thread-safe. Returns 0, or -1 if no log with decisions is open.
+ */
+int log_decision(const C_SketchAlert* decision, const char* reason);
+
+int get_flow_log_stats(C_FlowLogStats* stats);
+
+// =================================================================
+// FLOW MODEL (the trained classifier, run in the capture workers)
+// =================================================================
+//
+// set_flow_model() installs a classifier over the C_FEAT_* features (the
+// read_flow_features() columns). Each capture worker scores the flows it
+// finishes in batches, after every poll, and raises a C_SketchAlert of
+// kind C_ALERT_MODEL for each flow whose most likely class has an action:
+// into the alert ring, to the alert callback (enforcer_sketch_alert
+// applies it to the flow, off the capture thread) and, with a flow log,
+// into the decisions stream. Python only reads the verdicts.
+//
+// The model is one image of little-endian records:
+//
+//   C_FlowModelHeader
+//   SNIFFER_MODEL_TREES:  uint32_t roots[tree_count]
+//                         C_FlowModelNode nodes[node_count]
+//                         float values[value_count]
+//   SNIFFER_MODEL_LINEAR: float weights[class_count][feature_count]
+//                         float bias[class_count]          (value_count = both)
+//
+// Inputs are standardized first: x = (feature - feature_offset) *
+// feature_scale. A tree ensemble averages its trees' class scores (the
+// leaf's class_count values); a linear model's class scores are the softmax
+// of weights . x + bias. The predicted class is the highest score and its
+// score is the confidence.
+//
+// A tree reference (roots[], left, right) is a node index or, with
+// SNIFFER_MODEL_LEAF set, the offset in values[] of a leaf's scores; a
+// child's index is always above its parent's (scikit-learn's node order).
+
+#define SNIFFER_MODEL_MAGIC       0x4C444D46u  // "FMDL"
+#define SNIFFER_MODEL_VERSION     1
+#define SNIFFER_MODEL_MAX_CLASSES 16
+#define SNIFFER_MODEL_LEAF        0x80000000u
+
+// C_FlowModelHeader.kind
+#define SNIFFER_MODEL_TREES  1  // Random forest / extra trees / one decision tree
+#define SNIFFER_MODEL_LINEAR 2  // Logistic regression (multinomial, or binary as two classes)
+
+typedef struct C_FlowModelHeader {
+    uint32_t magic;              // SNIFFER_MODEL_MAGIC
+    uint32_t version;            // SNIFFER_MODEL_VERSION
+    uint32_t kind;               // SNIFFER_MODEL_*
+    uint32_t feature_count;      // C_FLOW_FEATURE_COUNT
+    uint32_t class_count;        // 2..SNIFFER_MODEL_MAX_CLASSES
+    uint32_t tree_count;         // Trees only
+    uint32_t node_count;         // Trees only
+    uint32_t value_count;        // Floats after the nodes (trees) or the header (linear)
+    float    feature_offset[C_FLOW_FEATURE_COUNT];
+    float    feature_scale[C_FLOW_FEATURE_COUNT];
+    int32_t  class_labels[SNIFFER_MODEL_MAX_CLASSES];   // The trainer's label for each class
+    uint8_t  class_actions[SNIFFER_MODEL_MAX_CLASSES];  // FirewallAction; 0 (PASS) raises nothing
+    float    min_confidence;     // Verdicts below it raise nothing
+    uint32_t reserved;
+} C_FlowModelHeader;
+
+typedef struct C_FlowModelNode {
+    float    threshold;          // Go left if x[feature] <= threshold
+    uint32_t feature;            // C_FEAT_* column tested
+    uint32_t left;               // Node index, or SNIFFER_MODEL_LEAF | value offset
+    uint32_t right;
+} C_FlowModelNode;
+
+typedef struct C_FlowModelStats {
+    uint64_t generation;         // set_flow_model() calls that took effect (0 = never)
+    uint64_t flows;              // Flows scored, summed over workers
+    uint64_t flagged;            // ... whose class has an action (alerts raised)
+    uint64_t batches;            // Scoring passes
+    uint64_t score_ns;           // Time spent in them, features included
+    uint64_t class_counts[SNIFFER_MODEL_MAX_CLASSES];  // Flows per predicted class
+    uint32_t kind;               // SNIFFER_MODEL_* of the model in force; 0 = none
+    uint32_t class_count;
+} C_FlowModelStats;
+
+/**
+ * Validates a model image (see above) and hands it to the capture workers,
+ * which switch to it from their next poll (flows already waiting to be
+ * scored get the old one). A null image or size 0 removes the model.
+ * Returns 0, or -1 if the image is malformed (the reason is logged).
+ */
+int set_flow_model(const void* image, uint64_t size);
+
+int get_flow_model_stats(C_FlowModelStats* stats);
+
+// =================================================================
+// LIVE RECONFIGURATION AND METRICS
+// =================================================================
+//
+// reload_dataplane_config() replaces the flow timeouts, the sketch settings,
+// the BPF program and the shed rules of a running engine, any of them, as
+// one config: it is built and checked aside, then published into a double
+// buffer with one store, and each capture worker picks it up between two
+// polls without taking a lock. A worker never runs with part of a reload
+// and never waits for one. set_capture_filter(), set_shed_rules() and
+// set_sketch_config() are reloads of their own part.
+//
+// What is sized at start still needs a cold start: the record buffer
+// (MAX_BUFFER_SLOTS), the worker rings and the flow table (FRAME_RING_SLOTS
+// ..., memory_budget_mb), all carved out of the workers' arenas.
+//
+// get_metrics_text() renders the counters as OpenMetrics text, for a scrape
+// endpoint to serve.
+
+// C_DataplaneConfig.fields: the parts a reload replaces (the rest is kept)
+#define SNIFFER_RELOAD_TIMEOUTS   0x01u  // flow_*_timeout_ms
+#define SNIFFER_RELOAD_SKETCH     0x02u  // sketch
+#define SNIFFER_RELOAD_FILTER     0x04u  // filter / filter_length (null or 0 removes it)
+#define SNIFFER_RELOAD_SHED_RULES 0x08u  // shed_rules / shed_rule_count (0 removes them)
+
+typedef struct C_DataplaneConfig {
+    uint32_t fields;                  // SNIFFER_RELOAD_*
+    uint32_t flow_active_timeout_ms;  // As in C_CaptureConfig; all three > 0
+    uint32_t flow_idle_timeout_ms;
+    uint32_t flow_close_timeout_ms;
+    C_SketchConfig sketch;            // As for set_sketch_config()
+    const C_BpfInsn* filter;          // As for set_capture_filter()
+    uint32_t filter_length;
+    uint32_t shed_rule_count;         // As for set_shed_rules()
+    const C_ShedRule* shed_rules;
+} C_DataplaneConfig;
+
+/**
+ * Checks every part config->fields names and publishes them together: the
+ * capture workers switch at their next poll (within ~100 ms), later starts
+ * begin with them. Tracked flows meet new timeouts at their next packet or
+ * timer. Returns 0, or -1 if a part is invalid (the reason is logged and
+ * nothing changes).
+ */
+int reload_dataplane_config(const C_DataplaneConfig* config);
+
+typedef struct C_DataplaneStatus {
+    uint64_t generation;              // Configs published (reloads, the set_* calls above, starts)
+    uint64_t applied;                 // Oldest generation a capturing worker still runs (= generation once all switched)
+    uint32_t workers_behind;          // Capturing workers not on generation yet
+    uint32_t flow_active_timeout_ms;  // The config last published
+    uint32_t flow_idle_timeout_ms;
+    uint32_t flow_close_timeout_ms;
+    uint32_t sketch_window_ms;
+    uint32_t filter_length;
+    uint32_t shed_rule_count;
+    uint32_t reserved;
+} C_DataplaneStatus;
+
+int get_dataplane_status(C_DataplaneStatus* status);
+
+/**
+ * Writes the engine's telemetry as OpenMetrics text into buffer (size
+ * bytes, NUL-terminated): sniffer_* families, per capture worker with a
+ * "queue" label where the workers keep their own, and the latency stages as
+ * histograms in seconds. The closing "# EOF" is left to the server, so it
+ * can append families of its own. Read from the same lock-free snapshots
+ * as get_engine_stats() & co, so a scrape never slows capture down.
+ * Returns the text's length; if it is >= size the text was cut, and a
+ * buffer of the returned length + 1 bytes holds it.
+ */
+int get_metrics_text(char* buffer, uint64_t size);
+
+}
+
+#endif // SNIFFER_ENGINE_H
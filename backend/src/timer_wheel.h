@@ -0,0 +1,223 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "memory_arena.h"
+
+/**
+ * @brief Hierarchical timing wheel over a fixed set of timer ids [0, capacity).
+ *
+ * - LEVELS wheels of SLOTS buckets; level l covers SLOTS^(l+1) ticks.
+ *   Scheduling and cancelling are O(1) (intrusive doubly-linked buckets).
+ * - advance() costs O(ticks elapsed + timers fired + timers cascaded);
+ *   timers that are not due are never looked at, unlike a full scan.
+ * - Each level keeps an occupancy bitmap, so earliest() finds the next
+ *   timer to fire without walking empty buckets.
+ *
+ * A timer whose deadline moved later can simply be left in place and
+ * rescheduled from the fire callback (lazy rescheduling), so per-event
+ * updates never have to touch the wheel.
+ *
+ * Nodes live in the owner's MemoryArena (see bytes_for()).
+ *
+ * Not thread-safe; owned by one capture worker.
+ */
+class TimerWheel {
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr unsigned LEVEL_BITS = 6;
+    static constexpr unsigned SLOTS = 1u << LEVEL_BITS;
+    static constexpr unsigned LEVELS = 4;
+
+    /**
+     * @param arena Must have bytes_for(capacity) left.
+     */
+    TimerWheel(size_t capacity, MemoryArena& arena) : nodes_(arena.allocate<Node>(capacity)) {
+        for (size_t i = 0; i < capacity; ++i) {
+            nodes_[i].bucket = NONE;
+        }
+        for (uint32_t& head : heads_) {
+            head = NONE;
+        }
+    }
+
+    static size_t bytes_for(size_t capacity) { return MemoryArena::bytes_for<Node>(capacity); }
+
+    /**
+     * @brief Sets the wheel's notion of "now" (call once, before scheduling).
+     */
+    void start(uint64_t now_tick) {
+        current_ = now_tick;
+        started_ = true;
+    }
+
+    bool started() const { return started_; }
+    uint64_t current_tick() const { return current_; }
+    size_t size() const { return size_; }
+
+    bool scheduled(uint32_t id) const { return nodes_[id].bucket != NONE; }
+    uint64_t expires(uint32_t id) const { return nodes_[id].expires; }
+
+    /**
+     * @brief Arms timer `id` (which must not be scheduled) for expire_tick.
+     * Deadlines in the past fire on the next tick.
+     */
+    void schedule(uint32_t id, uint64_t expire_tick) {
+        nodes_[id].expires = expire_tick;
+        place(id);
+        ++size_;
+    }
+
+    void cancel(uint32_t id) {
+        if (nodes_[id].bucket == NONE) {
+            return;
+        }
+        unlink(id);
+        --size_;
+    }
+
+    void reschedule(uint32_t id, uint64_t expire_tick) {
+        cancel(id);
+        schedule(id, expire_tick);
+    }
+
+    /**
+     * @brief Advances to now_tick, calling fire(id) for every timer that
+     * comes due. The timer is no longer scheduled when fire() runs; the
+     * callback may schedule it again.
+     * @return Number of timers fired.
+     */
+    template <typename Fire>
+    size_t advance(uint64_t now_tick, Fire&& fire) {
+        size_t fired = 0;
+        while (current_ < now_tick) {
+            ++current_;
+            // Entering a new span of a higher level: move its timers down.
+            uint64_t tick = current_;
+            for (unsigned level = 1; level < LEVELS && (tick & (SLOTS - 1)) == 0; ++level) {
+                tick >>= LEVEL_BITS;
+                cascade(level * SLOTS + static_cast<uint32_t>(tick & (SLOTS - 1)));
+            }
+
+            uint32_t id = detach(static_cast<uint32_t>(current_ & (SLOTS - 1)));
+            while (id != NONE) {
+                const uint32_t next = nodes_[id].next;
+                nodes_[id].bucket = NONE;
+                --size_;
+                ++fired;
+                fire(id);
+                id = next;
+            }
+        }
+        return fired;
+    }
+
+    /**
+     * @brief A timer from the bucket that fires first, or NONE if the wheel
+     * is empty. Exact at level 0; within a higher-level bucket the pick is
+     * arbitrary (all of them are due in the same span).
+     */
+    uint32_t earliest() const {
+        for (unsigned level = 0; level < LEVELS; ++level) {
+            const uint64_t occupied = occupied_[level];
+            if (occupied == 0) {
+                continue;
+            }
+            // Buckets are visited in firing order starting after the current one.
+            const unsigned start = static_cast<unsigned>(((current_ >> (LEVEL_BITS * level)) + 1) & (SLOTS - 1));
+            const uint64_t rotated = (occupied >> start) | (start ? occupied << (SLOTS - start) : 0);
+            const unsigned slot = (start + static_cast<unsigned>(__builtin_ctzll(rotated))) & (SLOTS - 1);
+            return heads_[level * SLOTS + slot];
+        }
+        return NONE;
+    }
+
+private:
+    struct Node {
+        uint32_t next;
+        uint32_t prev;
+        uint32_t bucket;   // level * SLOTS + slot, or NONE when not scheduled
+        uint32_t reserved;
+        uint64_t expires;  // Tick the timer is due at
+    };
+
+    // Farthest a timer can be placed (the top level's span, minus one bucket
+    // so it never aliases the bucket currently being cascaded).
+    static constexpr uint64_t MAX_DELTA =
+        (1ull << (LEVEL_BITS * LEVELS)) - (1ull << (LEVEL_BITS * (LEVELS - 1)));
+
+    void place(uint32_t id) {
+        uint64_t expires = nodes_[id].expires;
+        if (expires <= current_) {
+            expires = current_ + 1;
+        }
+        uint64_t delta = expires - current_;
+        if (delta > MAX_DELTA) {
+            delta = MAX_DELTA;
+            expires = current_ + MAX_DELTA;
+        }
+
+        unsigned level = 0;
+        while (level + 1 < LEVELS && delta >= (1ull << (LEVEL_BITS * (level + 1)))) {
+            ++level;
+        }
+        const uint32_t slot = static_cast<uint32_t>((expires >> (LEVEL_BITS * level)) & (SLOTS - 1));
+        link(id, level * SLOTS + slot);
+    }
+
+    void link(uint32_t id, uint32_t bucket) {
+        Node& node = nodes_[id];
+        node.bucket = bucket;
+        node.prev = NONE;
+        node.next = heads_[bucket];
+        if (node.next != NONE) {
+            nodes_[node.next].prev = id;
+        }
+        heads_[bucket] = id;
+        occupied_[bucket / SLOTS] |= 1ull << (bucket % SLOTS);
+    }
+
+    void unlink(uint32_t id) {
+        Node& node = nodes_[id];
+        if (node.prev != NONE) {
+            nodes_[node.prev].next = node.next;
+        } else {
+            heads_[node.bucket] = node.next;
+            if (node.next == NONE) {
+                occupied_[node.bucket / SLOTS] &= ~(1ull << (node.bucket % SLOTS));
+            }
+        }
+        if (node.next != NONE) {
+            nodes_[node.next].prev = node.prev;
+        }
+        node.bucket = NONE;
+    }
+
+    // Empties a bucket and returns its list (linked through next).
+    uint32_t detach(uint32_t bucket) {
+        const uint32_t head = heads_[bucket];
+        heads_[bucket] = NONE;
+        occupied_[bucket / SLOTS] &= ~(1ull << (bucket % SLOTS));
+        return head;
+    }
+
+    void cascade(uint32_t bucket) {
+        uint32_t id = detach(bucket);
+        while (id != NONE) {
+            const uint32_t next = nodes_[id].next;
+            place(id);
+            id = next;
+        }
+    }
+
+    Node* const nodes_;
+    uint32_t heads_[LEVELS * SLOTS];
+    uint64_t occupied_[LEVELS] = {};
+    uint64_t current_ = 0;
+    size_t size_ = 0;
+    bool started_ = false;
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,97 @@
+// src/traffic_sketch.cpp
+
+#include "traffic_sketch.h"
+
+#include <algorithm>
+#include <cmath>
+
+double HyperLogLog::estimate() const {
+    constexpr double m = REGISTERS;
+    constexpr double alpha = 0.7213 / (1.0 + 1.079 / m);
+    const double raw = alpha * m * m / inverse_sum_;
+    if (raw <= 2.5 * m && zeros_ != 0) {
+        // Small range: linear counting over the empty registers
+        return m * std::log(m / zeros_);
+    }
+    return raw;
+}
+
+namespace {
+
+// Entry indices of a top-K table by packets, descending.
+template <typename Table>
+size_t ranked(const Table& table, uint8_t* order) {
+    const size_t count = table.size();
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = static_cast<uint8_t>(i);
+    }
+    std::sort(order, order + count, [&table](uint8_t a, uint8_t b) {
+        return table.entry(a).packets > table.entry(b).packets;
+    });
+    return count;
+}
+
+template <typename Entry>
+C_HeavyHitter hitter_of(const Entry& entry) {
+    C_HeavyHitter hitter{};
+    hitter.packets = entry.packets;
+    hitter.bytes = entry.bytes;
+    hitter.error = entry.error;
+    return hitter;
+}
+
+} // namespace
+
+void TrafficSketch::rotate(uint64_t ts_ns, uint64_t window_ns) {
+    uint8_t order[SNIFFER_SKETCH_TOP_K];
+    SketchWindow& window = last_window_;
+
+    window.start_ns = window_start_;
+    window.packets = window_packets_;
+    window.src_count = static_cast<uint32_t>(ranked(top_src_, order));
+    for (uint32_t i = 0; i < window.src_count; ++i) {
+        const auto& entry = top_src_.entry(order[i]);
+        window.top_src[i] = hitter_of(entry);
+        std::memcpy(window.top_src[i].addr, entry.extra.addr, 16);
+    }
+    window.dst_count = static_cast<uint32_t>(ranked(top_dst_, order));
+    for (uint32_t i = 0; i < window.dst_count; ++i) {
+        const auto& entry = top_dst_.entry(order[i]);
+        SketchWindow::Destination& out = window.top_dst[i];
+        out.hitter = hitter_of(entry);
+        std::memcpy(out.hitter.addr, entry.extra.addr, 16);
+        out.hitter.sources = static_cast<uint32_t>(std::lround(entry.extra.sources.estimate()));
+        std::memcpy(out.registers, entry.extra.sources.registers(), sizeof(out.registers));
+    }
+    window.port_count = static_cast<uint32_t>(ranked(top_ports_, order));
+    for (uint32_t i = 0; i < window.port_count; ++i) {
+        const auto& entry = top_ports_.entry(order[i]);
+        window.top_ports[i] = hitter_of(entry);
+        window.top_ports[i].port = entry.extra.port;
+        window.top_ports[i].protocol = entry.extra.protocol;
+    }
+    ++windows_;
+
+    src_counts_.clear();
+    dst_counts_.clear();
+    top_src_.clear();
+    top_dst_.clear();
+    top_ports_.clear();
+    window_packets_ = 0;
+    // Windows stay aligned to the first one; idle stretches are skipped.
+    window_start_ = ts_ns - (ts_ns - window_end_) % window_ns;
+    window_end_ = window_start_ + window_ns;
+}
+
+C_SketchAlert TrafficSketch::make_alert(uint8_t kind, const uint8_t* addr, uint64_t estimate,
+                                        uint64_t threshold, FlowKey key, const FlowTuple& tuple) {
+    C_SketchAlert alert{};
+    alert.flow_id = key;
+    alert.estimate = estimate;
+    alert.threshold = threshold;
+    alert.kind = kind;
+    alert.protocol = tuple.protocol;
+    alert.port = tuple.dst_port;
+    std::memcpy(alert.addr, addr, sizeof(alert.addr));
+    return alert;
+}
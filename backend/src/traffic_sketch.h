@@ -0,0 +1,428 @@
+#ifndef TRAFFIC_SKETCH_H
+#define TRAFFIC_SKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "packet_parser.h"
+#include "packet_schema.h"
+#include "sniffer_engine.h"
+
+// ====================================================================
+// A) Streaming summaries (fixed memory, single writer)
+// ====================================================================
+
+/**
+ * @brief 64-bit hash of a 16-byte address; distinct seeds give the
+ * sketches independent hashes of the same address.
+ */
+inline uint64_t address_hash(const uint8_t* addr, uint64_t seed) {
+    uint64_t words[2];
+    std::memcpy(words, addr, sizeof(words));
+    return flow_hash_finalize(words[0] ^ flow_hash_finalize(words[1] ^ seed));
+}
+
+/**
+ * @brief Count-Min sketch of packets per key with conservative update:
+ * only the counters at the current minimum grow, so a key's estimate never
+ * undercounts, overcounts by at most e / WIDTH of the packets added (with
+ * probability 1 - e^-DEPTH), and rises by exactly one per packet of the key.
+ */
+class CountMinSketch {
+public:
+    static constexpr unsigned DEPTH = 4;
+    static constexpr unsigned WIDTH = 4096;   // Per row, power of two
+
+    CountMinSketch() { clear(); }
+
+    /**
+     * @brief Counts one packet of the key with this hash.
+     * @return The key's new estimate.
+     */
+    uint32_t add(uint64_t hash) {
+        const uint32_t h1 = static_cast<uint32_t>(hash);
+        const uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1u;
+        uint32_t* cells[DEPTH];
+        uint32_t estimate = UINT32_MAX;
+        for (unsigned row = 0; row < DEPTH; ++row) {
+            cells[row] = &counters_[row][(h1 + row * h2) & (WIDTH - 1)];
+            estimate = *cells[row] < estimate ? *cells[row] : estimate;
+        }
+        ++estimate;
+        for (unsigned row = 0; row < DEPTH; ++row) {
+            if (*cells[row] < estimate) {
+                *cells[row] = estimate;
+            }
+        }
+        return estimate;
+    }
+
+    void clear() { std::memset(counters_, 0, sizeof(counters_)); }
+
+private:
+    uint32_t counters_[DEPTH][WIDTH];
+};
+
+/**
+ * @brief HyperLogLog distinct counter with 2^8 registers (~6.5% standard
+ * error). Keeps the harmonic sum up to date so estimate() is O(1).
+ */
+class HyperLogLog {
+public:
+    static constexpr unsigned P = 8;
+    static constexpr unsigned REGISTERS = 1u << P;
+
+    HyperLogLog() { clear(); }
+
+    /**
+     * @return true if the estimate changed (a register grew).
+     */
+    bool add(uint64_t hash) {
+        const unsigned index = static_cast<unsigned>(hash >> (64 - P));
+        const uint64_t rest = hash << P;
+        const uint8_t rank = rest != 0 ? static_cast<uint8_t>(__builtin_clzll(rest) + 1) : 64 - P + 1;
+        uint8_t& reg = registers_[index];
+        if (rank <= reg) {
+            return false;
+        }
+        inverse_sum_ += inverse_power(rank) - inverse_power(reg);
+        zeros_ -= reg == 0 ? 1 : 0;
+        reg = rank;
+        return true;
+    }
+
+    /**
+     * @brief Register-wise max: afterwards this counts the union.
+     */
+    void merge(const uint8_t* registers) {
+        for (unsigned i = 0; i < REGISTERS; ++i) {
+            if (registers[i] > registers_[i]) {
+                inverse_sum_ += inverse_power(registers[i]) - inverse_power(registers_[i]);
+                zeros_ -= registers_[i] == 0 ? 1 : 0;
+                registers_[i] = registers[i];
+            }
+        }
+    }
+
+    double estimate() const;
+
+    const uint8_t* registers() const { return registers_; }
+
+    void clear() {
+        std::memset(registers_, 0, sizeof(registers_));
+        inverse_sum_ = REGISTERS;
+        zeros_ = REGISTERS;
+    }
+
+private:
+    static double inverse_power(uint8_t rank) { return 1.0 / static_cast<double>(1ull << rank); }
+
+    uint8_t registers_[REGISTERS];
+    double inverse_sum_;   // Sum of 2^-register
+    unsigned zeros_;       // Registers still 0
+};
+
+/**
+ * @brief Space-saving top-K over keys given by their 64-bit hash (two keys
+ * with one hash count as one). A key not in the table takes over the
+ * entry with the fewest packets and inherits its count as its error.
+ * Lookups go through a small open-addressing index, so a hit is O(1) and
+ * only a miss scans the K counts for the minimum.
+ */
+template <typename Extra>
+class SpaceSaving {
+public:
+    static constexpr size_t K = SNIFFER_SKETCH_TOP_K;
+
+    struct Entry {
+        uint64_t hash;
+        uint64_t packets;
+        uint64_t bytes;
+        uint64_t error;
+        Extra extra;
+    };
+
+    SpaceSaving() { clear(); }
+
+    /**
+     * @brief Counts one packet of `length` bytes for the key.
+     * @param fresh Set if the key just took over its entry (the caller
+     * then fills in the key's fields of extra).
+     */
+    Entry& add(uint64_t hash, uint32_t length, bool& fresh) {
+        size_t slot = hash & (INDEX_SLOTS - 1);
+        for (; index_[slot] != EMPTY; slot = (slot + 1) & (INDEX_SLOTS - 1)) {
+            Entry& entry = entries_[index_[slot]];
+            if (entry.hash == hash) {
+                ++entry.packets;
+                entry.bytes += length;
+                fresh = false;
+                return entry;
+            }
+        }
+        fresh = true;
+        uint8_t victim;
+        uint64_t floor = 0;
+        if (size_ < K) {
+            victim = static_cast<uint8_t>(size_++);
+        } else {
+            victim = 0;
+            for (size_t i = 1; i < K; ++i) {
+                if (entries_[i].packets < entries_[victim].packets) {
+                    victim = static_cast<uint8_t>(i);
+                }
+            }
+            floor = entries_[victim].packets;
+            erase(entries_[victim].hash);
+            // The erase may have shifted the probe chain: find the free slot again.
+            for (slot = hash & (INDEX_SLOTS - 1); index_[slot] != EMPTY; slot = (slot + 1) & (INDEX_SLOTS - 1)) {
+            }
+        }
+        index_[slot] = victim;
+        Entry& entry = entries_[victim];
+        entry.hash = hash;
+        entry.packets = floor + 1;
+        entry.bytes = length;
+        entry.error = floor;
+        entry.extra = Extra();
+        return entry;
+    }
+
+    size_t size() const { return size_; }
+    const Entry& entry(size_t i) const { return entries_[i]; }
+
+    void clear() {
+        std::memset(index_, EMPTY, sizeof(index_));
+        size_ = 0;
+    }
+
+private:
+    static constexpr size_t INDEX_SLOTS = 4 * K;   // Power of two, at most 1/4 full
+    static constexpr uint8_t EMPTY = 0xFF;
+    static_assert(K < EMPTY && (INDEX_SLOTS & (INDEX_SLOTS - 1)) == 0, "index layout");
+
+    // Backward-shift deletion, so probe chains never hold tombstones.
+    void erase(uint64_t hash) {
+        size_t hole = hash & (INDEX_SLOTS - 1);
+        while (entries_[index_[hole]].hash != hash) {
+            hole = (hole + 1) & (INDEX_SLOTS - 1);
+        }
+        for (size_t next = (hole + 1) & (INDEX_SLOTS - 1); index_[next] != EMPTY;
+             next = (next + 1) & (INDEX_SLOTS - 1)) {
+            const size_t home = entries_[index_[next]].hash & (INDEX_SLOTS - 1);
+            if (((next - home) & (INDEX_SLOTS - 1)) >= ((next - hole) & (INDEX_SLOTS - 1))) {
+                index_[hole] = index_[next];
+                hole = next;
+            }
+        }
+        index_[hole] = EMPTY;
+    }
+
+    Entry entries_[K];
+    uint8_t index_[INDEX_SLOTS];
+    size_t size_ = 0;
+};
+
+// ====================================================================
+// B) Per-worker traffic sketch
+// ====================================================================
+
+/**
+ * @brief Thresholds and window of a TrafficSketch; a copy of the
+ * set_sketch_config() settings the worker takes once per poll.
+ */
+struct SketchSettings {
+    uint64_t window_ns = 0;   // 0 = off
+    uint64_t src_packets = 0;
+    uint64_t dst_packets = 0;
+    uint64_t dst_sources = 0;
+    uint32_t flags = 0;
+    uint8_t action = 0;
+};
+
+// FlowEntry::sketch_alerts bits: what the flow has been alerted for
+constexpr uint8_t SKETCH_FLOW_SRC = 0x01;
+constexpr uint8_t SKETCH_FLOW_DST = 0x02;
+
+/**
+ * @brief What one finished window looked like (see TrafficSketch::rotate()).
+ * The destination entries keep their HyperLogLog registers so windows of
+ * several workers merge into a distinct-source count of the union.
+ */
+struct SketchWindow {
+    struct Destination {
+        C_HeavyHitter hitter;
+        uint8_t registers[HyperLogLog::REGISTERS];
+    };
+    uint64_t start_ns = 0;
+    uint64_t packets = 0;
+    uint32_t src_count = 0;
+    uint32_t dst_count = 0;
+    uint32_t port_count = 0;
+    C_HeavyHitter top_src[SNIFFER_SKETCH_TOP_K];
+    Destination top_dst[SNIFFER_SKETCH_TOP_K];
+    C_HeavyHitter top_ports[SNIFFER_SKETCH_TOP_K];
+};
+
+/**
+ * @brief Count-Min sketches, top-K tables and distinct-source counters of
+ * one capture worker, over capture-time windows; owned and updated by the
+ * capture thread only (about 160 KB).
+ *
+ * add() reports every threshold a packet crosses through its alert
+ * callback, with the alert's kind, address, estimate and enforcement
+ * fields filled in (the worker adds the timestamp and queue).
+ */
+class TrafficSketch {
+public:
+    /**
+     * @brief Counts one IP packet. flow_marks is its flow's
+     * FlowEntry::sketch_alerts (null if the flow table could not track it),
+     * so each flow is alerted for enforcement once. A packet past the end
+     * of the window first finishes it into last_window().
+     * @return Alerts raised for this packet.
+     */
+    template <typename Alert>
+    unsigned add(const FlowTuple& tuple, FlowKey key, uint32_t length, uint64_t ts_ns, uint8_t* flow_marks,
+                 const SketchSettings& settings, Alert&& alert);
+
+    /**
+     * @brief The window finished last (valid once windows() > 0).
+     */
+    const SketchWindow& last_window() const { return last_window_; }
+
+    uint64_t packets() const { return packets_; }
+    uint64_t windows() const { return windows_; }
+
+private:
+    struct Address {
+        uint8_t addr[16];
+    };
+    struct Port {
+        uint16_t port;
+        uint8_t protocol;
+    };
+    struct Destination {
+        uint8_t addr[16];
+        bool alerted;          // DST_SOURCES already raised this window
+        HyperLogLog sources;   // Distinct sources since the entry took its slot
+    };
+
+    void rotate(uint64_t ts_ns, uint64_t window_ns);
+
+    static C_SketchAlert make_alert(uint8_t kind, const uint8_t* addr, uint64_t estimate,
+                                    uint64_t threshold, FlowKey key, const FlowTuple& tuple);
+
+    CountMinSketch src_counts_;
+    CountMinSketch dst_counts_;
+    SpaceSaving<Address> top_src_;
+    SpaceSaving<Destination> top_dst_;
+    SpaceSaving<Port> top_ports_;
+    uint64_t window_start_ = 0;
+    uint64_t window_end_ = 0;    // 0 until the first packet
+    uint64_t window_packets_ = 0;
+    uint64_t packets_ = 0;
+    uint64_t windows_ = 0;
+    SketchWindow last_window_;
+};
+
+// Independent hash seeds per summary
+constexpr uint64_t SKETCH_SEED_SRC = 0x5D1C6A7E3B2F9041ull;
+constexpr uint64_t SKETCH_SEED_DST = 0x2B7E151628AED2A6ull;
+constexpr uint64_t SKETCH_SEED_DISTINCT = 0x9E3779B97F4A7C15ull;
+
+template <typename Alert>
+unsigned TrafficSketch::add(const FlowTuple& tuple, FlowKey key, uint32_t length, uint64_t ts_ns,
+                            uint8_t* flow_marks, const SketchSettings& settings, Alert&& alert) {
+    if (ts_ns >= window_end_) {
+        if (window_end_ != 0) {
+            rotate(ts_ns, settings.window_ns);
+        } else {
+            window_start_ = ts_ns;
+            window_end_ = ts_ns + settings.window_ns;
+        }
+    }
+    ++packets_;
+    ++window_packets_;
+
+    unsigned raised = 0;
+    bool fresh;
+
+    // Sources: volume
+    const uint64_t src_hash = address_hash(tuple.src_addr, SKETCH_SEED_SRC);
+    const uint32_t src_estimate = src_counts_.add(src_hash);
+    auto& src = top_src_.add(src_hash, length, fresh);
+    if (fresh) {
+        std::memcpy(src.extra.addr, tuple.src_addr, 16);
+    }
+    if (settings.src_packets != 0 && src_estimate >= settings.src_packets) {
+        const bool crossing = src_estimate == settings.src_packets;
+        const bool enforce = (settings.flags & SNIFFER_SKETCH_ENFORCE_SRC) != 0 && flow_marks != nullptr &&
+                             !(*flow_marks & SKETCH_FLOW_SRC);
+        if (crossing || enforce) {
+            C_SketchAlert out = make_alert(crossing ? C_ALERT_SRC_VOLUME : C_ALERT_SRC_FLOW, tuple.src_addr,
+                                           src_estimate, settings.src_packets, key, tuple);
+            if (enforce) {
+                out.flags |= C_ALERT_FLAG_ENFORCE;
+                out.action = settings.action;
+                *flow_marks |= SKETCH_FLOW_SRC;
+            }
+            alert(out);
+            ++raised;
+        }
+    }
+
+    // Destinations: volume and distinct sources
+    const uint64_t dst_hash = address_hash(tuple.dst_addr, SKETCH_SEED_DST);
+    const uint32_t dst_estimate = dst_counts_.add(dst_hash);
+    auto& dst = top_dst_.add(dst_hash, length, fresh);
+    if (fresh) {
+        std::memcpy(dst.extra.addr, tuple.dst_addr, 16);
+    }
+    // The destination is hot once it is over either threshold; the estimate
+    // and threshold reported for its flows are those of the volume, if set.
+    uint64_t dst_count = 0;
+    uint64_t dst_threshold = 0;
+    if (settings.dst_packets != 0 && dst_estimate >= settings.dst_packets) {
+        dst_count = dst_estimate;
+        dst_threshold = settings.dst_packets;
+        if (dst_estimate == settings.dst_packets) {
+            alert(make_alert(C_ALERT_DST_VOLUME, tuple.dst_addr, dst_estimate, settings.dst_packets, key, tuple));
+            ++raised;
+        }
+    }
+    if (dst.extra.sources.add(address_hash(tuple.src_addr, SKETCH_SEED_DISTINCT)) && settings.dst_sources != 0 &&
+        !dst.extra.alerted) {
+        const uint64_t sources = static_cast<uint64_t>(dst.extra.sources.estimate());
+        if (sources >= settings.dst_sources) {
+            dst.extra.alerted = true;
+            alert(make_alert(C_ALERT_DST_SOURCES, tuple.dst_addr, sources, settings.dst_sources, key, tuple));
+            ++raised;
+        }
+    }
+    if (dst_threshold == 0 && dst.extra.alerted) {
+        dst_count = static_cast<uint64_t>(dst.extra.sources.estimate());
+        dst_threshold = settings.dst_sources;
+    }
+    if (dst_threshold != 0 && (settings.flags & SNIFFER_SKETCH_ENFORCE_DST) != 0 && flow_marks != nullptr &&
+        !(*flow_marks & SKETCH_FLOW_DST)) {
+        C_SketchAlert out = make_alert(C_ALERT_DST_FLOW, tuple.dst_addr, dst_count, dst_threshold, key, tuple);
+        out.flags |= C_ALERT_FLAG_ENFORCE;
+        out.action = settings.action;
+        *flow_marks |= SKETCH_FLOW_DST;
+        alert(out);
+        ++raised;
+    }
+
+    // Ports: reporting only
+    const uint64_t port_key = (static_cast<uint64_t>(tuple.protocol) << 16) | tuple.dst_port;
+    auto& port = top_ports_.add(flow_hash_finalize(port_key + 1), length, fresh);
+    if (fresh) {
+        port.extra.port = tuple.dst_port;
+        port.extra.protocol = tuple.protocol;
+    }
+    return raised;
+}
+
+#endif // TRAFFIC_SKETCH_H
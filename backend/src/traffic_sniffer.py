@@ -1,8 +1,14 @@
 # traffic_sniffer.py (Comprehensive Version)
 
+import asyncio
 import threading
 import ctypes
+import ipaddress
+import mmap
 import os
+import re
+import socket
+import struct
 import time
 from queue import Queue, Empty
 
@@ -10,18 +16,657 @@ from queue import Queue, Empty
 # CTYPE DEFINITIONS FOR C++ INTERFACE
 # ===================================================================
 
-# Define a simple C structure that the C++ engine will fill.
+# Mirrors of the records in backend/src/packet_schema.h (the single source of
+# truth). The layout is checked against the loaded library in _verify_abi().
+SNIFFER_ABI_VERSION = 5
+
+C_PKT_FLAG_ALERT = 0x01
+C_PKT_FLAG_PAYLOAD = 0x02
+C_PAYLOAD_NONE = 0xFFFFFFFF
+C_PAYLOAD_SNAPSHOT_BYTES = 224
+
 class C_PacketData(ctypes.Structure):
-    """Represents a structured data unit passed from C++ to Python."""
+    """Represents a structured data unit passed from C++ to Python (32 bytes)."""
+    _fields_ = [
+        ("timestamp", ctypes.c_double),
+        ("flow_hash", ctypes.c_uint64),
+        ("length", ctypes.c_uint32),
+        ("caplen", ctypes.c_uint16),
+        ("protocol", ctypes.c_uint8),
+        ("flags", ctypes.c_uint8),
+        ("payload_ref", ctypes.c_uint32),
+        ("queue_id", ctypes.c_uint16),
+        ("reserved", ctypes.c_uint16),
+    ]
+
+    @property
+    def is_alert(self) -> bool:
+        return bool(self.flags & C_PKT_FLAG_ALERT)
+
+class C_PayloadSnapshot(ctypes.Structure):
+    """Optional payload snapshot, joined to its record by (queue_id, record_seq) (256 bytes)."""
+    _fields_ = [
+        ("record_seq", ctypes.c_uint64),
+        ("flow_hash", ctypes.c_uint64),
+        ("timestamp", ctypes.c_double),
+        ("length", ctypes.c_uint32),
+        ("caplen", ctypes.c_uint16),
+        ("queue_id", ctypes.c_uint16),
+        ("data", ctypes.c_uint8 * C_PAYLOAD_SNAPSHOT_BYTES),
+    ]
+
+C_FLOW_FLAG_FIN = 0x01
+C_FLOW_FLAG_RST = 0x02
+C_FLOW_FLAG_SYN = 0x04
+C_FLOW_FLAG_IPV6 = 0x08
+C_FLOW_FLAG_EVICTED = 0x10
+
+class C_FlowRecord(ctypes.Structure):
+    """A finished flow exported by the C++ flow table (80 bytes)."""
+    _fields_ = [
+        ("flow_id", ctypes.c_uint64),
+        ("start_time", ctypes.c_double),
+        ("last_time", ctypes.c_double),
+        ("byte_count", ctypes.c_uint64),
+        ("packet_count", ctypes.c_uint32),
+        ("max_pkt_size", ctypes.c_uint32),
+        ("src_port", ctypes.c_uint16),
+        ("dst_port", ctypes.c_uint16),
+        ("protocol", ctypes.c_uint8),
+        ("flags", ctypes.c_uint8),
+        ("queue_id", ctypes.c_uint16),
+        ("src_addr", ctypes.c_uint8 * 16),
+        ("dst_addr", ctypes.c_uint8 * 16),
+    ]
+
+    @staticmethod
+    def _format_addr(raw, ipv6: bool) -> str:
+        packed = bytes(raw)
+        if ipv6:
+            return socket.inet_ntop(socket.AF_INET6, packed)
+        return socket.inet_ntop(socket.AF_INET, packed[12:])
+
+    @property
+    def src_ip(self) -> str:
+        return self._format_addr(self.src_addr, bool(self.flags & C_FLOW_FLAG_IPV6))
+
+    @property
+    def dst_ip(self) -> str:
+        return self._format_addr(self.dst_addr, bool(self.flags & C_FLOW_FLAG_IPV6))
+
+    @property
+    def is_tcp_fin_flag(self) -> bool:
+        return bool(self.flags & C_FLOW_FLAG_FIN)
+
+# Columns of the read_flow_features() matrix (C_FEAT_* order)
+FLOW_FEATURE_NAMES = [
+    'packet_count', 'byte_count', 'duration_sec', 'max_pkt_size', 'avg_pkt_size', 'is_tcp_fin_flag',
+]
+C_FLOW_FEATURE_COUNT = len(FLOW_FEATURE_NAMES)
+
+class C_SnifferAbiInfo(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint32) for name in (
+        "abi_version", "record_size", "record_stride", "record_align", "ring_slots",
+        "payload_record_size", "payload_bytes", "payload_ring_slots", "field_count",
+        "flow_record_size", "flow_ring_slots", "flow_feature_count",
+    )]
+
+class C_RingStats(ctypes.Structure):
+    _fields_ = [
+        ("capacity", ctypes.c_uint64),
+        ("occupancy", ctypes.c_uint64),
+        ("dropped", ctypes.c_uint64),
+    ]
+
+SNIFFER_RING_RECORDS = 0
+SNIFFER_RING_PAYLOAD = 1
+SNIFFER_RING_FLOWS = 2
+
+# Payload policies, see set_payload_policy()
+SNIFFER_PAYLOAD_OFF = 0
+SNIFFER_PAYLOAD_ALL = 1
+SNIFFER_PAYLOAD_FIRST = 2
+SNIFFER_PAYLOAD_FLAGGED = 3
+
+class C_FlowTableStats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "capacity", "active_flows", "rejected",
+        "expired_active", "expired_idle", "closed", "evicted",
+    )]
+
+SNIFFER_MAX_QUEUES = 64
+SNIFFER_FANOUT_MODES = {"hash": 0, "cpu": 1, "qm": 2}
+
+# stop_capture_engine_ex flags and get_capture_state values (sniffer_engine.h)
+SNIFFER_STOP_KEEP_WARM = 1
+SNIFFER_STATES = {0: "stopped", 1: "running", 2: "parked", 3: "stopping"}
+SNIFFER_STOP_TIMEOUT_MS = 2000
+SNIFFER_WAIT_TIMEOUT_MS = 100  # Longest wait_for_data() block before the reader re-checks its stop event
+
+SNIFFER_BATCH_BUCKETS = 12
+
+class C_WorkerStats(ctypes.Structure):
+    """Mirrors C_WorkerStats: one capture worker's telemetry."""
+    _fields_ = [
+        ("queue_id", ctypes.c_uint32),
+        ("cpu", ctypes.c_int32),
+    ] + [(name, ctypes.c_uint64) for name in (
+        "packets", "bytes", "kernel_drops", "frame_ring_drops", "record_ring_drops",
+        "payload_ring_drops", "flow_ring_drops", "flows_active", "flows_evicted",
+        "polls", "batches",
+    )] + [
+        ("batch_sizes", ctypes.c_uint64 * SNIFFER_BATCH_BUCKETS),
+    ]
+
+    def as_dict(self) -> dict:
+        stats = {name: getattr(self, name) for name, _ in self._fields_ if name != "batch_sizes"}
+        stats["batch_sizes"] = list(self.batch_sizes)
+        return stats
+
+class C_EngineStats(ctypes.Structure):
+    """Mirrors C_EngineStats: get_engine_stats() snapshot."""
+    _fields_ = [
+        ("struct_size", ctypes.c_uint32),
+        ("state", ctypes.c_int32),
+        ("worker_count", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint32),
+        ("totals", C_WorkerStats),
+        ("workers", C_WorkerStats * SNIFFER_MAX_QUEUES),
+        ("memory_budget", ctypes.c_uint64),
+        ("memory_used", ctypes.c_uint64),
+    ]
+
+# Latency histograms (latency_histogram.h): log-linear buckets, HDR-style
+LATENCY_SUB_BITS = 3
+LATENCY_MAX_MSB = 42
+LATENCY_BUCKETS = (LATENCY_MAX_MSB - LATENCY_SUB_BITS + 2) << LATENCY_SUB_BITS
+SNIFFER_LAT_STAGES = {
+    0: "capture_to_publish",   # Capture timestamp -> record in the ring
+    1: "capture_to_read",      # Capture timestamp -> read_batch() copy-out
+    2: "flow_update",          # One flow table update (sampled)
+    3: "flow_export_to_read",  # Flow exported -> read_flows()/read_flow_features()
+}
+
+class C_LatencyHistogram(ctypes.Structure):
+    """Mirrors C_LatencyHistogram: one stage's latencies in nanoseconds."""
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "count", "sum_ns", "min_ns", "max_ns", "p50_ns", "p90_ns", "p99_ns", "p999_ns",
+    )] + [
+        ("buckets", ctypes.c_uint64 * LATENCY_BUCKETS),
+    ]
+
+    def as_dict(self) -> dict:
+        stats = {name: getattr(self, name) for name, _ in self._fields_ if name != "buckets"}
+        stats["buckets"] = list(self.buckets)
+        return stats
+
+class C_ReplayStats(ctypes.Structure):
+    """Mirrors C_ReplayStats: progress and sustained rate of a "pcap:" replay."""
+    _fields_ = [
+        ("finished", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint32),
+    ] + [(name, ctypes.c_uint64) for name in (
+        "frames", "bytes", "skipped", "delivered", "record_ring_drops", "elapsed_ns",
+    )] + [(name, ctypes.c_double) for name in ("speed", "pps", "progress")]
+
+# Shared-memory record ring (sniffer_engine.h, set_shared_ring)
+SNIFFER_SHM_MAGIC = 0x474E5253
+SNIFFER_SHM_VERSION = 1
+SNIFFER_SHM_LANE_RECORDS = 128  # Lane offset of its first record; write_pos at +0, reserve_pos at +64
+SNIFFER_SHM_HUGETLB = 1
+
+class C_SharedRingHeader(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint32) for name in (
+        "magic", "version", "abi_version", "record_size", "lane_count", "lane_slots",
+    )] + [(name, ctypes.c_uint64) for name in ("lane_offset", "lane_stride", "segment_size")] + [
+        ("pid", ctypes.c_uint32),
+        ("closed", ctypes.c_uint32),
+    ]
+
+class C_SharedRingInfo(ctypes.Structure):
+    _fields_ = [
+        ("path", ctypes.c_char * 256),
+        ("segment_size", ctypes.c_uint64),
+        ("lane_count", ctypes.c_uint32),
+        ("lane_slots", ctypes.c_uint32),
+        ("flags", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint32),
+    ]
+
+# Traffic shedding (set_capture_filter / set_shed_rules)
+SNIFFER_MAX_SHED_RULES = 32
+SNIFFER_SHED_ADDR_SRC = 0x01
+SNIFFER_SHED_ADDR_DST = 0x02
+SNIFFER_SHED_PORT_SRC = 0x04
+SNIFFER_SHED_PORT_DST = 0x08
+SHED_PROTOCOLS = {"icmp": 1, "tcp": 6, "udp": 17, "icmpv6": 58}
+
+class C_BpfInsn(ctypes.Structure):
+    _fields_ = [
+        ("code", ctypes.c_uint16),
+        ("jt", ctypes.c_uint8),
+        ("jf", ctypes.c_uint8),
+        ("k", ctypes.c_uint32),
+    ]
+
+class C_ShedRule(ctypes.Structure):
     _fields_ = [
+        ("protocol", ctypes.c_uint8),
+        ("flags", ctypes.c_uint8),
+        ("prefix_len", ctypes.c_uint8),
+        ("reserved", ctypes.c_uint8),
+        ("port_min", ctypes.c_uint16),
+        ("port_max", ctypes.c_uint16),
+        ("addr", ctypes.c_uint8 * 16),
+    ]
+
+class C_ShedStats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "filter_packets", "filter_bytes", "rule_packets", "rule_bytes",
+    )] + [
+        ("rule_hits", ctypes.c_uint64 * SNIFFER_MAX_SHED_RULES),
+        ("kernel_filter", ctypes.c_uint32),
+        ("rule_count", ctypes.c_uint32),
+    ]
+
+def parse_bpf(program) -> list:
+    """
+    Classic BPF instructions as (code, jt, jf, k) tuples, from such a list or
+    from the text `tcpdump -dd` or `tcpdump -ddd` prints for an expression.
+    """
+    if not isinstance(program, str):
+        return [tuple(insn) for insn in program]
+    numbers = [int(n, 0) for n in re.findall(r"0x[0-9a-fA-F]+|\d+", program)]
+    if len(numbers) % 4 == 1:
+        numbers = numbers[1:]  # -ddd starts with the instruction count
+    return [tuple(numbers[i:i + 4]) for i in range(0, len(numbers), 4)]
+
+def make_shed_rule(protocol=0, port=None, cidr=None, addr_side=None, port_side=None) -> C_ShedRule:
+    """
+    One shed rule: protocol (number or name), port (int or (min, max)), cidr
+    ("10.0.0.0/8", "fd00::/8"); addr_side / port_side "src" or "dst" (None:
+    either side).
+    """
+    rule = C_ShedRule()
+    rule.protocol = SHED_PROTOCOLS[protocol] if isinstance(protocol, str) else protocol
+    if port is not None:
+        rule.port_min, rule.port_max = (port, port) if isinstance(port, int) else port
+    if cidr is not None:
+        network = ipaddress.ip_network(cidr, strict=False)
+        if network.version == 4:
+            rule.addr[:] = ipaddress.IPv6Address("::ffff:" + str(network.network_address)).packed
+            rule.prefix_len = 96 + network.prefixlen
+        else:
+            rule.addr[:] = network.network_address.packed
+            rule.prefix_len = network.prefixlen
+    sides = {"src": 1, "dst": 2, None: 0}
+    rule.flags = sides[addr_side] * SNIFFER_SHED_ADDR_SRC | sides[port_side] * SNIFFER_SHED_PORT_SRC
+    return rule
+
+# Traffic sketches (set_sketch_config / read_sketch_alerts / get_sketch_stats)
+SNIFFER_SKETCH_TOP_K = 32
+SNIFFER_SKETCH_ENFORCE_SRC = 0x01
+SNIFFER_SKETCH_ENFORCE_DST = 0x02
+# C_SketchAlert.kind (packet_schema.h). estimate/threshold per kind: the
+# sketch kinds 1-5 carry the count and the threshold it crossed, MODEL the
+# class index and its confidence in millionths, DECISION what log_decision set.
+C_ALERT_SRC_VOLUME = 1
+C_ALERT_SRC_FLOW = 2
+C_ALERT_DST_VOLUME = 3
+C_ALERT_DST_SOURCES = 4
+C_ALERT_DST_FLOW = 5
+C_ALERT_DECISION = 6
+C_ALERT_MODEL = 7
+C_ALERT_FLAG_ENFORCE = 0x01
+SKETCH_ALERT_KINDS = {C_ALERT_SRC_VOLUME: "src_volume", C_ALERT_SRC_FLOW: "src_flow",
+                      C_ALERT_DST_VOLUME: "dst_volume", C_ALERT_DST_SOURCES: "dst_sources",
+                      C_ALERT_DST_FLOW: "dst_flow", C_ALERT_DECISION: "decision", C_ALERT_MODEL: "model"}
+READ_ALERT_SLOTS = 1024  # Max alerts copied out per read_sketch_alerts() call
+
+def format_mapped_addr(raw) -> str:
+    """A FlowTuple address as text: IPv4-mapped addresses as a.b.c.d."""
+    packed = bytes(raw)
+    if packed[:12] == b"\0" * 10 + b"\xff\xff":
+        return socket.inet_ntop(socket.AF_INET, packed[12:])
+    return socket.inet_ntop(socket.AF_INET6, packed)
+
+class C_SketchAlert(ctypes.Structure):
+    """A threshold crossing raised by a worker's traffic sketch (64 bytes)."""
+    _fields_ = [
+        ("flow_id", ctypes.c_uint64),
         ("timestamp", ctypes.c_double),
-        ("length", ctypes.c_uint),
-        ("flow_hash", ctypes.c_uint),
-        ("is_alert", ctypes.c_bool),
+        ("estimate", ctypes.c_uint64),
+        ("threshold", ctypes.c_uint64),
+        ("kind", ctypes.c_uint8),
+        ("action", ctypes.c_uint8),
+        ("flags", ctypes.c_uint8),
+        ("protocol", ctypes.c_uint8),
+        ("port", ctypes.c_uint16),
+        ("queue_id", ctypes.c_uint16),
+        ("addr", ctypes.c_uint8 * 16),
+        ("reserved", ctypes.c_uint64),
+    ]
+
+    def as_dict(self) -> dict:
+        alert = {
+            "kind": SKETCH_ALERT_KINDS.get(self.kind, self.kind),
+            "addr": format_mapped_addr(self.addr),
+            "flow_id": self.flow_id,
+            "timestamp": self.timestamp,
+            "estimate": self.estimate,
+            "threshold": self.threshold,
+            "protocol": self.protocol,
+            "port": self.port,
+            "queue_id": self.queue_id,
+            "enforce": bool(self.flags & C_ALERT_FLAG_ENFORCE),
+            "action": self.action,
+        }
+        if self.kind == C_ALERT_MODEL:
+            # A verdict of the flow model: the class index and its confidence
+            alert["class"] = alert.pop("estimate")
+            alert["confidence"] = alert.pop("threshold") / 1e6
+        return alert
+
+class C_SketchConfig(ctypes.Structure):
+    _fields_ = [
+        ("window_ms", ctypes.c_uint32),
+        ("flags", ctypes.c_uint32),
+        ("src_packets", ctypes.c_uint64),
+        ("dst_packets", ctypes.c_uint64),
+        ("dst_sources", ctypes.c_uint64),
+        ("alert_action", ctypes.c_uint8),
+        ("reserved", ctypes.c_uint8 * 7),
+    ]
+
+class C_HeavyHitter(ctypes.Structure):
+    _fields_ = [
+        ("addr", ctypes.c_uint8 * 16),
+        ("packets", ctypes.c_uint64),
+        ("bytes", ctypes.c_uint64),
+        ("error", ctypes.c_uint64),
+        ("sources", ctypes.c_uint32),
+        ("port", ctypes.c_uint16),
+        ("protocol", ctypes.c_uint8),
+        ("reserved", ctypes.c_uint8),
+    ]
+
+class C_SketchStats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "window_ns", "window_start_ns", "windows", "packets", "window_packets", "alerts", "alerts_dropped",
+        "callback_dropped",
+    )] + [(name, ctypes.c_uint32) for name in ("src_count", "dst_count", "port_count", "reserved")] + [
+        ("top_src", C_HeavyHitter * SNIFFER_SKETCH_TOP_K),
+        ("top_dst", C_HeavyHitter * SNIFFER_SKETCH_TOP_K),
+        ("top_ports", C_HeavyHitter * SNIFFER_SKETCH_TOP_K),
+    ]
+
+# Columnar flow log (sniffer_engine.h, set_flow_log / log_decision)
+SNIFFER_LOG_MAGIC = 0x474F4C53
+SNIFFER_LOG_VERSION = 1
+SNIFFER_LOG_MAX_COLUMNS = 16
+SNIFFER_LOG_BLOCK_ROWS = 256
+SNIFFER_LOG_BLOOM_WORDS = 64
+SNIFFER_LOG_BLOOM_PROBES = 3
+SNIFFER_LOG_CONTROL_LANE = 0xFFFF
+SNIFFER_LOG_FLOWS = 0x01
+SNIFFER_LOG_DECISIONS = 0x02
+SNIFFER_LOG_STREAMS = {"flows": SNIFFER_LOG_FLOWS, "decisions": SNIFFER_LOG_DECISIONS}
+SNIFFER_LOG_BYTES = 6
+SNIFFER_LOG_DTYPES = {1: "<u1", 2: "<u2", 3: "<u4", 4: "<u8", 5: "<f8"}  # SNIFFER_LOG_BYTES: (u1, width)
+
+class C_FlowLogColumn(ctypes.Structure):
+    _fields_ = [
+        ("name", ctypes.c_char * 24),
+        ("offset", ctypes.c_uint64),
+        ("width", ctypes.c_uint32),
+        ("type", ctypes.c_uint32),
+    ]
+
+class C_FlowLogHeader(ctypes.Structure):
+    _fields_ = [
+        ("magic", ctypes.c_uint32),
+        ("version", ctypes.c_uint32),
+        ("kind", ctypes.c_uint32),
+        ("lane", ctypes.c_uint32),
+        ("sequence", ctypes.c_uint64),
+        ("capacity", ctypes.c_uint64),
+        ("rows", ctypes.c_uint64),
+        ("sealed", ctypes.c_uint32),
+        ("column_count", ctypes.c_uint32),
+        ("min_time", ctypes.c_double),
+        ("max_time", ctypes.c_double),
+        ("index_offset", ctypes.c_uint64),
+        ("segment_size", ctypes.c_uint64),
+        ("pid", ctypes.c_uint32),
+        ("time_column", ctypes.c_uint32),
+        ("hash_column", ctypes.c_uint32),
+        ("reserved", ctypes.c_uint32),
+        ("columns", C_FlowLogColumn * SNIFFER_LOG_MAX_COLUMNS),
+    ]
+
+class C_FlowLogConfig(ctypes.Structure):
+    _fields_ = [
+        ("directory", ctypes.c_char * 256),
+        ("streams", ctypes.c_uint32),
+        ("segment_rows", ctypes.c_uint32),
+        ("segment_seconds", ctypes.c_uint32),
+        ("retain_segments", ctypes.c_uint32),
+    ]
+
+class C_FlowLogStats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "flow_rows", "decision_rows", "segments", "bytes", "rows_lost",
+    )] + [("streams", ctypes.c_uint32), ("reserved", ctypes.c_uint32)]
+
+# In-engine flow model (sniffer_engine.h, set_flow_model / get_flow_model_stats)
+SNIFFER_MODEL_MAGIC = 0x4C444D46
+SNIFFER_MODEL_VERSION = 1
+SNIFFER_MODEL_MAX_CLASSES = 16
+SNIFFER_MODEL_LEAF = 0x80000000
+SNIFFER_MODEL_TREES = 1
+SNIFFER_MODEL_LINEAR = 2
+SNIFFER_MODEL_KINDS = {SNIFFER_MODEL_TREES: "trees", SNIFFER_MODEL_LINEAR: "linear"}
+FIREWALL_ACTIONS = {"PASS": 0, "DROP": 1, "REJECT": 2, "RATE_LIMIT": 3}  # FirewallAction
+
+class C_FlowModelHeader(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint32) for name in (
+        "magic", "version", "kind", "feature_count", "class_count", "tree_count", "node_count", "value_count",
+    )] + [
+        ("feature_offset", ctypes.c_float * C_FLOW_FEATURE_COUNT),
+        ("feature_scale", ctypes.c_float * C_FLOW_FEATURE_COUNT),
+        ("class_labels", ctypes.c_int32 * SNIFFER_MODEL_MAX_CLASSES),
+        ("class_actions", ctypes.c_uint8 * SNIFFER_MODEL_MAX_CLASSES),
+        ("min_confidence", ctypes.c_float),
+        ("reserved", ctypes.c_uint32),
+    ]
+
+class C_FlowModelStats(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        "generation", "flows", "flagged", "batches", "score_ns",
+    )] + [
+        ("class_counts", ctypes.c_uint64 * SNIFFER_MODEL_MAX_CLASSES),
+        ("kind", ctypes.c_uint32),
+        ("class_count", ctypes.c_uint32),
+    ]
+
+# Live reconfiguration (sniffer_engine.h, reload_dataplane_config / get_dataplane_status)
+SNIFFER_RELOAD_TIMEOUTS = 0x01
+SNIFFER_RELOAD_SKETCH = 0x02
+SNIFFER_RELOAD_FILTER = 0x04
+SNIFFER_RELOAD_SHED_RULES = 0x08
+METRICS_TEXT_BYTES = 64 * 1024  # Initial metrics_text() buffer; it grows to fit
+
+class C_DataplaneConfig(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint32) for name in (
+        "fields", "flow_active_timeout_ms", "flow_idle_timeout_ms", "flow_close_timeout_ms",
+    )] + [
+        ("sketch", C_SketchConfig),
+        ("filter", ctypes.POINTER(C_BpfInsn)),
+        ("filter_length", ctypes.c_uint32),
+        ("shed_rule_count", ctypes.c_uint32),
+        ("shed_rules", ctypes.POINTER(C_ShedRule)),
+    ]
+
+class C_DataplaneStatus(ctypes.Structure):
+    _fields_ = [("generation", ctypes.c_uint64), ("applied", ctypes.c_uint64)] + [
+        (name, ctypes.c_uint32) for name in (
+            "workers_behind", "flow_active_timeout_ms", "flow_idle_timeout_ms", "flow_close_timeout_ms",
+            "sketch_window_ms", "filter_length", "shed_rule_count", "reserved",
+        )]
+
+def flow_model_image(model, scaler=None, actions=None, min_confidence: float = 0.0) -> bytes:
+    """
+    Exports a fitted scikit-learn classifier over the FLOW_FEATURE_NAMES
+    columns as a set_flow_model() image: a RandomForestClassifier,
+    ExtraTreesClassifier or DecisionTreeClassifier, or a linear model with
+    coef_ / intercept_ (LogisticRegression; softmax scores). A Pipeline of
+    a scaler and one of those, or a separate fitted StandardScaler, becomes
+    the image's standardization.
+
+    `actions` maps class labels to FirewallActions (ints or FIREWALL_ACTIONS
+    names); by default the first class (normal traffic) is PASS and every
+    other one DROP. Verdicts under min_confidence raise nothing.
+    """
+    import numpy as np
+
+    if hasattr(model, "steps"):
+        if len(model.steps) > 1 and scaler is None:
+            scaler = model.steps[-2][1]
+        model = model.steps[-1][1]
+    labels = list(getattr(model, "classes_", []))
+    if getattr(model, "n_features_in_", C_FLOW_FEATURE_COUNT) != C_FLOW_FEATURE_COUNT:
+        raise ValueError(f"model takes {model.n_features_in_} features, flows have {C_FLOW_FEATURE_COUNT}")
+    if not 2 <= len(labels) <= SNIFFER_MODEL_MAX_CLASSES:
+        raise ValueError(f"unsupported class count {len(labels)}")
+    classes = len(labels)
+
+    header = C_FlowModelHeader()
+    header.magic = SNIFFER_MODEL_MAGIC
+    header.version = SNIFFER_MODEL_VERSION
+    header.feature_count = C_FLOW_FEATURE_COUNT
+    header.class_count = classes
+    header.min_confidence = min_confidence
+    header.feature_scale[:] = [1.0] * C_FLOW_FEATURE_COUNT
+    if scaler is not None:
+        if getattr(scaler, "mean_", None) is not None:
+            header.feature_offset[:] = [float(v) for v in scaler.mean_]
+        if getattr(scaler, "scale_", None) is not None:
+            header.feature_scale[:] = [1.0 / float(v) for v in scaler.scale_]
+    if actions is None:
+        actions = {label: "PASS" if index == 0 else "DROP" for index, label in enumerate(labels)}
+    for index, label in enumerate(labels):
+        action = actions.get(label, "PASS")
+        header.class_actions[index] = FIREWALL_ACTIONS[action] if isinstance(action, str) else int(action)
+        header.class_labels[index] = int(label) if isinstance(label, (int, np.integer)) else index
+
+    trees = getattr(model, "estimators_", None)
+    if trees is None and hasattr(model, "tree_"):
+        trees = [model]
+    if trees is not None:
+        roots, nodes, values = [], [], []
+        node_base = value_base = 0
+        for estimator in np.ravel(trees):
+            tree = estimator.tree_
+            left, right = tree.children_left, tree.children_right
+            leaf = left < 0
+            internal = np.flatnonzero(~leaf)
+            leaves = np.flatnonzero(leaf)
+            # A node's reference: its index among the internal nodes (the
+            # order is kept, so children stay after parents) or its leaf scores
+            refs = np.empty(tree.node_count, dtype=np.uint64)
+            refs[internal] = node_base + np.arange(len(internal))
+            refs[leaves] = SNIFFER_MODEL_LEAF | (value_base + classes * np.arange(len(leaves)))
+            scores = tree.value[leaves, 0, :].astype(np.float64)
+            totals = scores.sum(axis=1, keepdims=True)
+            scores = np.divide(scores, totals, out=np.full_like(scores, 1.0 / classes), where=totals > 0)
+            # The largest float32 <= each threshold, so float32 features split as they did in training
+            threshold = tree.threshold[internal].astype(np.float32)
+            above = threshold.astype(np.float64) > tree.threshold[internal]
+            threshold[above] = np.nextafter(threshold[above], np.float32(-np.inf))
+            block = np.zeros(len(internal), dtype=[("threshold", "<f4"), ("feature", "<u4"),
+                                                   ("left", "<u4"), ("right", "<u4")])
+            block["threshold"] = threshold
+            block["feature"] = tree.feature[internal]
+            block["left"] = refs[left[internal]]
+            block["right"] = refs[right[internal]]
+            roots.append(refs[0])
+            nodes.append(block)
+            values.append(scores.astype("<f4").ravel())
+            node_base += len(internal)
+            value_base += scores.size
+        header.kind = SNIFFER_MODEL_TREES
+        header.tree_count = len(roots)
+        header.node_count = node_base
+        header.value_count = value_base
+        body = (np.asarray(roots, dtype="<u4").tobytes() + b"".join(block.tobytes() for block in nodes) +
+                b"".join(block.tobytes() for block in values))
+    elif hasattr(model, "coef_") and hasattr(model, "intercept_"):
+        weights = np.asarray(model.coef_, dtype=np.float64).reshape(-1, C_FLOW_FEATURE_COUNT)
+        bias = np.ravel(np.asarray(model.intercept_, dtype=np.float64))
+        if len(weights) == 1 and classes == 2:
+            # Binary: softmax over (0, w.x + b) is the logistic of w.x + b
+            weights = np.vstack([np.zeros_like(weights), weights])
+            bias = np.concatenate([[0.0], bias])
+        if weights.shape != (classes, C_FLOW_FEATURE_COUNT) or len(bias) != classes:
+            raise ValueError("coef_ / intercept_ do not match the classes")
+        header.kind = SNIFFER_MODEL_LINEAR
+        header.value_count = classes * (C_FLOW_FEATURE_COUNT + 1)
+        body = weights.astype("<f4").tobytes() + bias.astype("<f4").tobytes()
+    else:
+        raise ValueError(f"cannot export a {type(model).__name__} as a flow model")
+    return bytes(header) + body
+
+def save_flow_model(path: str, model, scaler=None, actions=None, min_confidence: float = 0.0) -> int:
+    """
+    Writes flow_model_image() of `model` to `path` (e.g. data/trained_model.fmdl),
+    for PacketSniffer.set_flow_model(path) without scikit-learn. Returns its size.
+    """
+    image = flow_model_image(model, scaler, actions, min_confidence)
+    with open(path, "wb") as f:
+        f.write(image)
+    return len(image)
+
+def mapped_addr(text: str) -> bytes:
+    """An address as a FlowTuple stores it: IPv4 as ::ffff:a.b.c.d."""
+    address = ipaddress.ip_address(text)
+    if address.version == 4:
+        return b"\0" * 10 + b"\xff\xff" + address.packed
+    return address.packed
+
+class C_CaptureConfig(ctypes.Structure):
+    _fields_ = [
+        ("struct_size", ctypes.c_uint32),
+        ("queues", ctypes.c_uint32),
+        ("fanout_mode", ctypes.c_uint32),
+        ("cpus", ctypes.c_int32 * SNIFFER_MAX_QUEUES),
+        ("flow_active_timeout_ms", ctypes.c_uint32),
+        ("flow_idle_timeout_ms", ctypes.c_uint32),
+        ("flow_close_timeout_ms", ctypes.c_uint32),
+        ("memory_budget_mb", ctypes.c_uint32),
+    ]
+
+class C_AbiField(ctypes.Structure):
+    _fields_ = [
+        ("name", ctypes.c_char_p),
+        ("offset", ctypes.c_uint32),
+        ("size", ctypes.c_uint32),
     ]
 
 # Define the constants for the shared buffer size
 MAX_BUFFER_SLOTS = 1024  # Max number of C_PacketData structs in the buffer
+READ_BATCH_SLOTS = MAX_BUFFER_SLOTS  # Max records copied out per read_batch() call
+READ_FLOW_SLOTS = 4096  # Max flow records copied out per read_flows() call
+READ_PAYLOAD_SLOTS = 1024  # Max payload snapshots copied out per read_payloads() call
+
+def aligned_array(ctype, count: int, alignment: int = 64):
+    """
+    A zeroed ctypes array of `count` ctype records starting on an `alignment`
+    boundary. ctypes only guarantees malloc alignment (16 bytes), but the
+    library declares C_PacketData 32- and C_PayloadSnapshot 64-byte aligned
+    and may use aligned vector moves on them (Release builds with -march).
+    """
+    raw = (ctypes.c_char * (ctypes.sizeof(ctype) * count + alignment))()
+    return (ctype * count).from_buffer(raw, -ctypes.addressof(raw) % alignment)
 
 # Define the C function signatures for the full control logic
 _start_capture = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_char_p)
@@ -29,7 +674,7 @@ _stop_capture = ctypes.CFUNCTYPE(ctypes.c_int) # Function to signal C++ engine t
 _get_next_read_index = ctypes.CFUNCTYPE(ctypes.c_int) # Function to get index of new data
 
 # The expected path of the compiled shared library inside the Docker container
-LIB_PATH = "/usr/local/lib/libsniffer.so" 
+LIB_PATH = os.environ.get("SNIFFER_LIB_PATH", "/usr/local/lib/libsniffer.so")
 
 # ===================================================================
 # THE PYTHON WRAPPER CLASS
@@ -39,18 +684,66 @@ class PacketSniffer:
     """
     Python wrapper that uses ctypes to call a high-performance C++ library
     and manages the shared memory buffer for data transfer.
+
+    `interface` selects the C++ capture backend: a plain interface name
+    (or "afpacket:eth0") uses the AF_PACKET TPACKET_V3 ring, while
+    "sim" / "sim:<pps>" uses the synthetic traffic generator for tests, and
+    "pcap:<file>[@<speed>]" replays a pcap/pcapng file (speed 1 keeps the
+    recorded timing, 0 replays flat out; see replay_stats()).
+
+    `queues` > 1 starts one C++ capture worker per NIC queue (PACKET_FANOUT,
+    spread by `fanout`: "hash", "cpu" or "qm"), optionally pinned to `cpus`.
+
+    The engine also aggregates packets into flows natively; `flow_window`
+    has the meaning of FlowAnalyzer's time_window (a flow is exported after
+    flow_window seconds, or 2 * flow_window idle, or shortly after FIN/RST)
+    and finished flows are read with read_flows(). When the bounded flow
+    table fills up, the flows closest to expiring are exported early.
+
+    `memory_budget_mb` (per worker) fixes what each worker may use for its
+    rings, flow table and sketches; it is reserved at start and never grows,
+    and the flow table gets what the rest leaves. 0 keeps the default size.
     """
-    def __init__(self, interface: str, output_queue: Queue):
+    def __init__(self, interface: str, output_queue: Queue, queues: int = 1,
+                 cpus: list = None, fanout: str = "hash", flow_window: float = 5.0,
+                 memory_budget_mb: int = 0):
         self.interface = interface
+        self.memory_budget_mb = memory_budget_mb
         self.output_queue = output_queue
+        self.queues = queues
+        self.cpus = cpus or []
+        self.fanout = fanout
+        self.flow_window = flow_window
         self._stop_event = threading.Event()
         self.c_library = None
         self._load_c_library()
         
-        # Shared memory buffer and read index tracking
+        # Shared memory buffer written by the C++ engine
         # We use a C-style array here as the conceptual shared memory buffer
-        self.shared_buffer = (C_PacketData * MAX_BUFFER_SLOTS)()
-        self.last_read_index = 0
+        self.shared_buffer = aligned_array(C_PacketData, MAX_BUFFER_SLOTS)
+
+        # Caller-owned destination for read_batch(); reused for every call
+        self.batch_buffer = aligned_array(C_PacketData, READ_BATCH_SLOTS)
+        self._dropped = ctypes.c_uint64(0)
+        self.dropped_records = 0
+
+        # Destination for read_flows() / read_flow_features()
+        self.flow_buffer = aligned_array(C_FlowRecord, READ_FLOW_SLOTS)
+        self.feature_buffer = (ctypes.c_float * (READ_FLOW_SLOTS * C_FLOW_FEATURE_COUNT))()
+        self.flow_id_buffer = (ctypes.c_uint64 * READ_FLOW_SLOTS)()
+        self._feature_views = None
+        self.dropped_flows = 0
+
+        # Destination for read_payloads()
+        self.payload_buffer = aligned_array(C_PayloadSnapshot, READ_PAYLOAD_SLOTS)
+        self.dropped_payloads = 0
+
+        # Destination for read_sketch_alerts()
+        self.alert_buffer = aligned_array(C_SketchAlert, READ_ALERT_SLOTS)
+        self.dropped_alerts = 0
+
+        # Destination for metrics_text(); grown when a scrape outgrows it
+        self._metrics_buffer = None
         
         # Thread for reading data from the C++ shared memory buffer
         self.reading_thread = threading.Thread(target=self._read_and_process_buffer, daemon=True)
@@ -67,14 +760,108 @@ class PacketSniffer:
             # 1. Map start_capture_engine function
             self.c_library.start_capture_engine.argtypes = [ctypes.c_char_p, ctypes.POINTER(C_PacketData)]
             self.c_library.start_capture_engine.restype = ctypes.c_int
+            self.c_library.init_capture_config.argtypes = [ctypes.POINTER(C_CaptureConfig)]
+            self.c_library.init_capture_config.restype = None
+            self.c_library.start_capture_engine_ex.argtypes = [ctypes.c_char_p, ctypes.POINTER(C_PacketData),
+                                                               ctypes.POINTER(C_CaptureConfig)]
+            self.c_library.start_capture_engine_ex.restype = ctypes.c_int
             
             # 2. Map stop_capture_engine function
             self.c_library.stop_capture_engine.argtypes = []
             self.c_library.stop_capture_engine.restype = ctypes.c_int
+            self.c_library.stop_capture_engine_ex.argtypes = [ctypes.c_uint32, ctypes.c_uint32]
+            self.c_library.stop_capture_engine_ex.restype = ctypes.c_int
+            self.c_library.get_capture_state.argtypes = []
+            self.c_library.get_capture_state.restype = ctypes.c_int
             
             # 3. Map function to get the current write index from C++
             self.c_library.get_write_index.argtypes = []
             self.c_library.get_write_index.restype = ctypes.c_int
+
+            # 4. Map the bulk reader (copies a whole span of records per call)
+            self.c_library.read_batch.argtypes = [ctypes.POINTER(C_PacketData), ctypes.c_int,
+                                                  ctypes.POINTER(ctypes.c_uint64)]
+            self.c_library.read_batch.restype = ctypes.c_int
+            self.c_library.wait_for_data.argtypes = [ctypes.c_int]
+            self.c_library.wait_for_data.restype = ctypes.c_int
+            for name in ("get_wakeup_fd", "arm_wakeup", "wake_consumer"):
+                getattr(self.c_library, name).argtypes = []
+                getattr(self.c_library, name).restype = ctypes.c_int
+
+            # 5. Map the ABI description and the optional payload ring
+            self.c_library.get_abi_info.argtypes = [ctypes.POINTER(C_SnifferAbiInfo)]
+            self.c_library.get_abi_info.restype = ctypes.c_int
+            self.c_library.get_abi_field.argtypes = [ctypes.c_uint32, ctypes.POINTER(C_AbiField)]
+            self.c_library.get_abi_field.restype = ctypes.c_int
+            self.c_library.set_payload_snapshots.argtypes = [ctypes.c_int]
+            self.c_library.set_payload_snapshots.restype = ctypes.c_int
+            self.c_library.read_payload_batch.argtypes = [ctypes.POINTER(C_PayloadSnapshot), ctypes.c_int,
+                                                          ctypes.POINTER(ctypes.c_uint64)]
+            self.c_library.read_payload_batch.restype = ctypes.c_int
+            self.c_library.set_payload_policy.argtypes = [ctypes.c_int, ctypes.c_uint32, ctypes.c_uint32]
+            self.c_library.set_payload_policy.restype = ctypes.c_int
+            self.c_library.flag_flow_payload.argtypes = [ctypes.c_uint64, ctypes.c_int]
+            self.c_library.flag_flow_payload.restype = ctypes.c_int
+            self.c_library.clear_flagged_flows.argtypes = []
+            self.c_library.clear_flagged_flows.restype = ctypes.c_int
+
+            self.c_library.get_ring_stats.argtypes = [ctypes.c_int, ctypes.POINTER(C_RingStats)]
+            self.c_library.get_ring_stats.restype = ctypes.c_int
+
+            # 6. Map the native flow table output
+            self.c_library.read_flows.argtypes = [ctypes.POINTER(C_FlowRecord), ctypes.c_int,
+                                                  ctypes.POINTER(ctypes.c_uint64)]
+            self.c_library.read_flows.restype = ctypes.c_int
+            self.c_library.read_flow_features.argtypes = [ctypes.POINTER(ctypes.c_float),
+                                                          ctypes.POINTER(ctypes.c_uint64),
+                                                          ctypes.POINTER(C_FlowRecord), ctypes.c_int,
+                                                          ctypes.POINTER(ctypes.c_uint64)]
+            self.c_library.read_flow_features.restype = ctypes.c_int
+            self.c_library.get_flow_table_stats.argtypes = [ctypes.POINTER(C_FlowTableStats)]
+            self.c_library.get_flow_table_stats.restype = ctypes.c_int
+            self.c_library.get_engine_stats.argtypes = [ctypes.POINTER(C_EngineStats)]
+            self.c_library.get_engine_stats.restype = ctypes.c_int
+            self.c_library.get_latency_histogram.argtypes = [ctypes.c_int, ctypes.POINTER(C_LatencyHistogram)]
+            self.c_library.get_latency_histogram.restype = ctypes.c_int
+            self.c_library.get_replay_stats.argtypes = [ctypes.POINTER(C_ReplayStats)]
+            self.c_library.get_replay_stats.restype = ctypes.c_int
+            self.c_library.set_shared_ring.argtypes = [ctypes.c_char_p, ctypes.c_uint32, ctypes.c_uint32]
+            self.c_library.set_shared_ring.restype = ctypes.c_int
+            self.c_library.get_shared_ring_info.argtypes = [ctypes.POINTER(C_SharedRingInfo)]
+            self.c_library.get_shared_ring_info.restype = ctypes.c_int
+            self.c_library.set_capture_filter.argtypes = [ctypes.POINTER(C_BpfInsn), ctypes.c_uint32]
+            self.c_library.set_capture_filter.restype = ctypes.c_int
+            self.c_library.set_shed_rules.argtypes = [ctypes.POINTER(C_ShedRule), ctypes.c_uint32]
+            self.c_library.set_shed_rules.restype = ctypes.c_int
+            self.c_library.get_shed_stats.argtypes = [ctypes.POINTER(C_ShedStats)]
+            self.c_library.get_shed_stats.restype = ctypes.c_int
+            self.c_library.set_sketch_config.argtypes = [ctypes.POINTER(C_SketchConfig)]
+            self.c_library.set_sketch_config.restype = ctypes.c_int
+            self.c_library.set_sketch_alert_callback.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+            self.c_library.set_sketch_alert_callback.restype = ctypes.c_int
+            self.c_library.read_sketch_alerts.argtypes = [ctypes.POINTER(C_SketchAlert), ctypes.c_int,
+                                                          ctypes.POINTER(ctypes.c_uint64)]
+            self.c_library.read_sketch_alerts.restype = ctypes.c_int
+            self.c_library.get_sketch_stats.argtypes = [ctypes.POINTER(C_SketchStats)]
+            self.c_library.get_sketch_stats.restype = ctypes.c_int
+            self.c_library.set_flow_log.argtypes = [ctypes.POINTER(C_FlowLogConfig)]
+            self.c_library.set_flow_log.restype = ctypes.c_int
+            self.c_library.log_decision.argtypes = [ctypes.POINTER(C_SketchAlert), ctypes.c_char_p]
+            self.c_library.log_decision.restype = ctypes.c_int
+            self.c_library.get_flow_log_stats.argtypes = [ctypes.POINTER(C_FlowLogStats)]
+            self.c_library.get_flow_log_stats.restype = ctypes.c_int
+            self.c_library.set_flow_model.argtypes = [ctypes.c_char_p, ctypes.c_uint64]
+            self.c_library.set_flow_model.restype = ctypes.c_int
+            self.c_library.get_flow_model_stats.argtypes = [ctypes.POINTER(C_FlowModelStats)]
+            self.c_library.get_flow_model_stats.restype = ctypes.c_int
+            self.c_library.reload_dataplane_config.argtypes = [ctypes.POINTER(C_DataplaneConfig)]
+            self.c_library.reload_dataplane_config.restype = ctypes.c_int
+            self.c_library.get_dataplane_status.argtypes = [ctypes.POINTER(C_DataplaneStatus)]
+            self.c_library.get_dataplane_status.restype = ctypes.c_int
+            self.c_library.get_metrics_text.argtypes = [ctypes.c_char_p, ctypes.c_uint64]
+            self.c_library.get_metrics_text.restype = ctypes.c_int
+
+            self._verify_abi()
             
             print("[Sniffer] C++ library and functions loaded successfully.")
             
@@ -82,55 +869,594 @@ class PacketSniffer:
             print(f"[Sniffer ERROR] Could not load C++ library: {e}")
             raise
 
+    def _verify_abi(self):
+        """
+        Refuses to run against a library whose record layout differs from the
+        ctypes mirror above; a silent mismatch would read every slot at the
+        wrong offsets and stride.
+        """
+        info = C_SnifferAbiInfo()
+        self.c_library.get_abi_info(ctypes.byref(info))
+
+        if info.abi_version != SNIFFER_ABI_VERSION:
+            raise RuntimeError(f"libsniffer ABI v{info.abi_version}, expected v{SNIFFER_ABI_VERSION}")
+        if info.record_stride != ctypes.sizeof(C_PacketData) or info.ring_slots != MAX_BUFFER_SLOTS:
+            raise RuntimeError(f"libsniffer record stride {info.record_stride} x {info.ring_slots}, "
+                               f"expected {ctypes.sizeof(C_PacketData)} x {MAX_BUFFER_SLOTS}")
+        if info.payload_record_size != ctypes.sizeof(C_PayloadSnapshot):
+            raise RuntimeError(f"libsniffer payload record is {info.payload_record_size} bytes, "
+                               f"expected {ctypes.sizeof(C_PayloadSnapshot)}")
+        if info.flow_record_size != ctypes.sizeof(C_FlowRecord):
+            raise RuntimeError(f"libsniffer flow record is {info.flow_record_size} bytes, "
+                               f"expected {ctypes.sizeof(C_FlowRecord)}")
+        if info.flow_feature_count != C_FLOW_FEATURE_COUNT:
+            raise RuntimeError(f"libsniffer exports {info.flow_feature_count} flow features, "
+                               f"expected {C_FLOW_FEATURE_COUNT}")
+
+        field = C_AbiField()
+        for index in range(info.field_count):
+            self.c_library.get_abi_field(index, ctypes.byref(field))
+            name = field.name.decode()
+            mirror = getattr(C_PacketData, name, None)
+            if mirror is None or mirror.offset != field.offset or mirror.size != field.size:
+                raise RuntimeError(f"libsniffer field '{name}' at {field.offset}/{field.size} "
+                                   f"does not match the Python mirror")
+
+    def enable_payload_snapshots(self, enabled: bool = True):
+        """Turns the optional payload snapshot ring on (every frame) or off."""
+        self.c_library.set_payload_snapshots(1 if enabled else 0)
+
+    def set_payload_policy(self, mode: int, max_bytes: int = 0, packets_per_flow: int = 0):
+        """
+        Chooses which frames read_payloads() gets: SNIFFER_PAYLOAD_FIRST
+        snapshots the first packets_per_flow packets of every flow,
+        SNIFFER_PAYLOAD_FLAGGED only flows passed to flag_flow() (and frames
+        the engine pre-classified as alerts), at most packets_per_flow each
+        (0: no cap). max_bytes=0 keeps C_PAYLOAD_SNAPSHOT_BYTES.
+        """
+        if self.c_library.set_payload_policy(mode, max_bytes, packets_per_flow) != 0:
+            raise ValueError(f"invalid payload policy: mode {mode}, {max_bytes} bytes, "
+                             f"{packets_per_flow} packets per flow")
+
+    def flag_flow(self, flow_id: int, flagged: bool = True) -> bool:
+        """
+        Asks for payload snapshots of a flow (a C_FlowRecord.flow_id or
+        C_PacketData.flow_hash) under SNIFFER_PAYLOAD_FLAGGED. False if the
+        engine already holds as many flagged flows as it can.
+        """
+        return self.c_library.flag_flow_payload(flow_id, 1 if flagged else 0) == 0
+
+    def clear_flagged_flows(self):
+        self.c_library.clear_flagged_flows()
+
+    def read_payloads(self):
+        """
+        Copies the payload snapshots published since the last call into
+        payload_buffer. Returns the count; the snapshots are
+        payload_buffer[0:n], each with the flow_hash of its flow record.
+        """
+        count = self.c_library.read_payload_batch(self.payload_buffer, READ_PAYLOAD_SLOTS,
+                                                  ctypes.byref(self._dropped))
+        if self._dropped.value:
+            self.dropped_payloads += self._dropped.value
+        return count
+
+    def enable_shared_ring(self, slots_per_queue: int = 65536, name: str = "sniffer-records",
+                           hugepages: bool = False):
+        """
+        Has the next start publish every record into a shared-memory ring
+        that other processes attach to with SharedRingReader (see
+        shared_ring_info()). `name` with a '/' creates that file (e.g. on a
+        hugetlbfs mount); otherwise the ring is an anonymous memfd.
+        slots_per_queue=0 turns it off.
+        """
+        flags = SNIFFER_SHM_HUGETLB if hugepages else 0
+        if self.c_library.set_shared_ring(name.encode("utf-8"), slots_per_queue, flags) != 0:
+            raise ValueError(f"invalid shared ring settings: {name!r}, {slots_per_queue} slots")
+
+    @staticmethod
+    def _bpf_array(program):
+        insns = parse_bpf(program) if program else []
+        return (C_BpfInsn * max(len(insns), 1))(*insns), len(insns)
+
+    @staticmethod
+    def _shed_rule_array(rules):
+        rules = [rule if isinstance(rule, C_ShedRule) else make_shed_rule(**rule) for rule in rules]
+        return (C_ShedRule * max(len(rules), 1))(*rules), len(rules)
+
+    @staticmethod
+    def _sketch_config(window: float = 1.0, src_packets: int = 0, dst_packets: int = 0, dst_sources: int = 0,
+                       enforce_src: bool = False, enforce_dst: bool = False, action: int = 1):
+        config = C_SketchConfig()
+        config.window_ms = int(window * 1000)
+        config.flags = (SNIFFER_SKETCH_ENFORCE_SRC if enforce_src else 0) | \
+                       (SNIFFER_SKETCH_ENFORCE_DST if enforce_dst else 0)
+        config.src_packets = src_packets
+        config.dst_packets = dst_packets
+        config.dst_sources = dst_sources
+        config.alert_action = action
+        return config
+
+    def set_capture_filter(self, program):
+        """
+        Keeps only the frames a classic BPF program accepts (see parse_bpf()
+        for the forms taken; None removes it), from the running workers' next
+        poll on (in the kernel on AF_PACKET) and for later starts.
+        """
+        array, length = self._bpf_array(program)
+        if self.c_library.set_capture_filter(array, length) != 0:
+            raise ValueError("invalid BPF program")
+
+    def set_shed_rules(self, rules):
+        """
+        Drops known-good bulk traffic (backups, health checks) before it
+        costs a record, live like set_capture_filter(): each rule is a
+        C_ShedRule or the keyword arguments of make_shed_rule().
+        """
+        array, count = self._shed_rule_array(rules)
+        if self.c_library.set_shed_rules(array, count) != 0:
+            raise ValueError(f"invalid shed rules (at most {SNIFFER_MAX_SHED_RULES})")
+
+    def shed_stats(self) -> dict:
+        """What the BPF program and each shed rule dropped since the last cold start."""
+        stats = C_ShedStats()
+        self.c_library.get_shed_stats(ctypes.byref(stats))
+        return {
+            "filter_packets": stats.filter_packets,
+            "filter_bytes": stats.filter_bytes,
+            "kernel_filter": bool(stats.kernel_filter),
+            "rule_packets": stats.rule_packets,
+            "rule_bytes": stats.rule_bytes,
+            "rule_hits": list(stats.rule_hits[:stats.rule_count]),
+        }
+
+    def set_sketch_config(self, window: float = 1.0, src_packets: int = 0, dst_packets: int = 0,
+                          dst_sources: int = 0, enforce_src: bool = False, enforce_dst: bool = False,
+                          action: int = 1):
+        """
+        Turns on the engine's volumetric detection (window=0 turns it off):
+        per `window` seconds, alert when a source sends src_packets, a
+        destination receives dst_packets or is reached by dst_sources
+        distinct sources (0 = no such alert). enforce_src / enforce_dst also
+        alert each flow of such a source / to such a destination once, for
+        the enforcer to apply `action` (FirewallAction) to; see
+        connect_enforcer(). Thresholds apply per capture worker.
+        """
+        config = self._sketch_config(window, src_packets, dst_packets, dst_sources, enforce_src, enforce_dst,
+                                     action)
+        if self.c_library.set_sketch_config(ctypes.byref(config)) != 0:
+            raise ValueError("invalid sketch config")
+
+    def reload_config(self, flow_window: float = None, idle_timeout: float = None, close_timeout: float = None,
+                      sketch: dict = None, filter=None, shed_rules=None):
+        """
+        Changes the running engine's dataplane in one step, without a restart:
+        the workers switch at their next poll and later starts keep it. Only
+        the parts given change: flow_window (and idle_timeout, default 2 *
+        flow_window, and close_timeout, seconds), sketch (the keyword
+        arguments of set_sketch_config()), filter (as for
+        set_capture_filter(); "" removes it) and shed_rules (as for
+        set_shed_rules(); [] removes them). Nothing changes if a part is
+        invalid (ValueError). Ring and table sizes still need a cold start.
+        """
+        config = C_DataplaneConfig()
+        if flow_window is not None or idle_timeout is not None or close_timeout is not None:
+            current = self.dataplane_status()
+            active = flow_window if flow_window is not None else current["flow_active_timeout"]
+            idle = idle_timeout if idle_timeout is not None else \
+                (2 * flow_window if flow_window is not None else current["flow_idle_timeout"])
+            close = close_timeout if close_timeout is not None else current["flow_close_timeout"]
+            config.fields |= SNIFFER_RELOAD_TIMEOUTS
+            config.flow_active_timeout_ms = int(active * 1000)
+            config.flow_idle_timeout_ms = int(idle * 1000)
+            config.flow_close_timeout_ms = int(close * 1000)
+        if sketch is not None:
+            config.fields |= SNIFFER_RELOAD_SKETCH
+            config.sketch = self._sketch_config(**sketch)
+        if filter is not None:
+            config.fields |= SNIFFER_RELOAD_FILTER
+            program, config.filter_length = self._bpf_array(filter)
+            config.filter = ctypes.cast(program, ctypes.POINTER(C_BpfInsn))
+        if shed_rules is not None:
+            config.fields |= SNIFFER_RELOAD_SHED_RULES
+            rules, config.shed_rule_count = self._shed_rule_array(shed_rules)
+            config.shed_rules = ctypes.cast(rules, ctypes.POINTER(C_ShedRule))
+        if self.c_library.reload_dataplane_config(ctypes.byref(config)) != 0:
+            raise ValueError("invalid dataplane config")
+        if config.fields & SNIFFER_RELOAD_TIMEOUTS:
+            # start_sniffing() passes these again
+            self.flow_window = config.flow_active_timeout_ms / 1000
+
+    def dataplane_status(self) -> dict:
+        """The dataplane config last published, and whether every capturing worker runs it yet."""
+        status = C_DataplaneStatus()
+        self.c_library.get_dataplane_status(ctypes.byref(status))
+        return {
+            "generation": status.generation,
+            "applied": status.applied,
+            "workers_behind": status.workers_behind,
+            "flow_active_timeout": status.flow_active_timeout_ms / 1000,
+            "flow_idle_timeout": status.flow_idle_timeout_ms / 1000,
+            "flow_close_timeout": status.flow_close_timeout_ms / 1000,
+            "sketch_window": status.sketch_window_ms / 1000,
+            "filter_length": status.filter_length,
+            "shed_rules": status.shed_rule_count,
+        }
+
+    def metrics_text(self) -> str:
+        """The engine's counters as OpenMetrics text, without the closing "# EOF"."""
+        if self._metrics_buffer is None:
+            self._metrics_buffer = ctypes.create_string_buffer(METRICS_TEXT_BYTES)
+        while True:
+            size = len(self._metrics_buffer)
+            length = self.c_library.get_metrics_text(self._metrics_buffer, size)
+            if length < size:
+                return self._metrics_buffer.raw[:length].decode("utf-8")
+            self._metrics_buffer = ctypes.create_string_buffer(length + 1)
+
+    def connect_enforcer(self, enforcer_library, engine=None):
+        """
+        Hands every sketch alert to libenforcer's enforcer_sketch_alert on
+        the engine's alert dispatcher thread, so enforcement alerts ban their
+        flows without a round trip through Python and without stalling
+        capture; engine is an EnforcementEngine* (None: the library's own).
+        enforcer_library=None disconnects it.
+        """
+        sink = None
+        if enforcer_library is not None:
+            sink = ctypes.cast(enforcer_library.enforcer_sketch_alert, ctypes.c_void_p)
+        self.c_library.set_sketch_alert_callback(sink, engine)
+
+    def read_sketch_alerts(self):
+        """
+        Copies the alerts raised since the last call into alert_buffer.
+        Returns the count; the alerts are alert_buffer[0:n].
+        """
+        count = self.c_library.read_sketch_alerts(self.alert_buffer, READ_ALERT_SLOTS,
+                                                  ctypes.byref(self._dropped))
+        if self._dropped.value:
+            self.dropped_alerts += self._dropped.value
+        return count
+
+    def sketch_stats(self) -> dict:
+        """Counters and the top sources, destinations and ports of the last finished window."""
+        stats = C_SketchStats()
+        self.c_library.get_sketch_stats(ctypes.byref(stats))
+
+        def hitters(table, count, with_addr):
+            rows = []
+            for hitter in table[:count]:
+                row = {"packets": hitter.packets, "bytes": hitter.bytes, "error": hitter.error}
+                if with_addr:
+                    row["addr"] = format_mapped_addr(hitter.addr)
+                rows.append(row)
+            return rows
+
+        top_dst = hitters(stats.top_dst, stats.dst_count, True)
+        for row, hitter in zip(top_dst, stats.top_dst):
+            row["sources"] = hitter.sources
+        top_ports = hitters(stats.top_ports, stats.port_count, False)
+        for row, hitter in zip(top_ports, stats.top_ports):
+            row["port"], row["protocol"] = hitter.port, hitter.protocol
+        return {
+            "window": stats.window_ns / 1e9,
+            "window_start": stats.window_start_ns / 1e9,
+            "windows": stats.windows,
+            "packets": stats.packets,
+            "window_packets": stats.window_packets,
+            "alerts": stats.alerts,
+            "alerts_dropped": stats.alerts_dropped,
+            "callback_dropped": stats.callback_dropped,
+            "top_src": hitters(stats.top_src, stats.src_count, True),
+            "top_dst": top_dst,
+            "top_ports": top_ports,
+        }
+
+    def set_flow_log(self, directory: str, flows: bool = True, decisions: bool = True,
+                     segment_rows: int = 0, segment_seconds: int = 0, retain_segments: int = 0):
+        """
+        From the next (cold) start, appends every finished flow and every
+        sketch alert / log_decision() entry to columnar segment files in
+        `directory` (read them with FlowLogReader). Segments hold
+        segment_rows rows (0: 65536) and are also rotated once they span
+        segment_seconds; only the newest retain_segments per stream are kept
+        (0: all). directory=None turns the log off.
+        """
+        if directory is None:
+            self.c_library.set_flow_log(None)
+            return
+        config = C_FlowLogConfig()
+        config.directory = os.fsencode(directory)
+        config.streams = (SNIFFER_LOG_FLOWS if flows else 0) | (SNIFFER_LOG_DECISIONS if decisions else 0)
+        config.segment_rows = segment_rows
+        config.segment_seconds = segment_seconds
+        config.retain_segments = retain_segments
+        if self.c_library.set_flow_log(ctypes.byref(config)) != 0:
+            raise ValueError("invalid flow log settings")
+
+    def log_decision(self, addr: str, action: int, reason: str = "", flow_id: int = 0, port: int = 0,
+                     protocol: int = 0, timestamp: float = None) -> bool:
+        """
+        Appends an enforcement decision (`action` is a FirewallAction) to the
+        flow log's control-plane stream. False if no log with decisions is open.
+        """
+        decision = C_SketchAlert()
+        decision.kind = C_ALERT_DECISION
+        decision.timestamp = time.time() if timestamp is None else timestamp
+        decision.flow_id = flow_id
+        decision.action = action
+        decision.port = port
+        decision.protocol = protocol
+        decision.queue_id = SNIFFER_LOG_CONTROL_LANE
+        decision.addr[:] = mapped_addr(addr)
+        return self.c_library.log_decision(ctypes.byref(decision), reason.encode()[:15]) == 0
+
+    def flow_log_stats(self) -> dict:
+        """Rows, segments and bytes the flow log writers produced since the last cold start."""
+        stats = C_FlowLogStats()
+        self.c_library.get_flow_log_stats(ctypes.byref(stats))
+        return {
+            "flow_rows": stats.flow_rows,
+            "decision_rows": stats.decision_rows,
+            "segments": stats.segments,
+            "bytes": stats.bytes,
+            "rows_lost": stats.rows_lost,
+            "streams": [name for name, bit in SNIFFER_LOG_STREAMS.items() if stats.streams & bit],
+        }
+
+    def set_flow_model(self, model, scaler=None, actions=None, min_confidence: float = 0.0):
+        """
+        Has the capture workers classify every flow they finish (from their
+        next poll, running or not): `model` is a fitted classifier (exported
+        with flow_model_image(), which takes scaler / actions /
+        min_confidence), an image from it, or the path of a saved one; None
+        removes the model. Flows whose class has an action raise "model"
+        alerts (read_sketch_alerts(), the flow log) that connect_enforcer()
+        applies natively, so Python only sees the verdicts.
+        """
+        if model is None:
+            image = None
+        elif isinstance(model, (bytes, bytearray)):
+            image = bytes(model)
+        elif isinstance(model, (str, os.PathLike)):
+            with open(model, "rb") as f:
+                image = f.read()
+        else:
+            image = flow_model_image(model, scaler, actions, min_confidence)
+        if self.c_library.set_flow_model(image, len(image) if image else 0) != 0:
+            raise ValueError("invalid flow model image")
+
+    def flow_model_stats(self) -> dict:
+        """Flows the in-engine model scored, flagged and per class, and the time it took."""
+        stats = C_FlowModelStats()
+        self.c_library.get_flow_model_stats(ctypes.byref(stats))
+        return {
+            "generation": stats.generation,
+            "kind": SNIFFER_MODEL_KINDS.get(stats.kind),
+            "flows": stats.flows,
+            "flagged": stats.flagged,
+            "batches": stats.batches,
+            "score_ns": stats.score_ns,
+            "class_counts": list(stats.class_counts[:stats.class_count]),
+        }
+
+    def shared_ring_info(self):
+        """Path (to open read-only), size and lanes of the shared ring, or None if there is none."""
+        if self.c_library is None:
+            return None
+        info = C_SharedRingInfo()
+        if self.c_library.get_shared_ring_info(ctypes.byref(info)) != 0:
+            return None
+        return {
+            "path": info.path.decode("utf-8"),
+            "segment_size": info.segment_size,
+            "lane_count": info.lane_count,
+            "lane_slots": info.lane_slots,
+            "hugepages": bool(info.flags & SNIFFER_SHM_HUGETLB),
+        }
+
+    def read_batch(self):
+        """
+        Copies every record published since the last call into batch_buffer
+        with a single FFI call. Returns the number of records copied; the
+        records are batch_buffer[0:n]. Use as_numpy() for a vectorised view.
+        """
+        count = self.c_library.read_batch(self.batch_buffer, READ_BATCH_SLOTS, ctypes.byref(self._dropped))
+        if self._dropped.value:
+            self.dropped_records += self._dropped.value
+        return count
+
+    def wait_for_data(self, timeout: float = SNIFFER_WAIT_TIMEOUT_MS / 1000) -> bool:
+        """
+        Blocks (without the GIL) until read_batch()/read_flows() have
+        something, or timeout seconds pass. True if there is data.
+        """
+        return self.c_library.wait_for_data(int(timeout * 1000)) == 1
+
+    async def wait_for_data_async(self):
+        """
+        wait_for_data() for an asyncio service: parks the engine's reader and
+        awaits its wakeup fd on the running loop instead of blocking a thread.
+        The caller must be the only reader of this sniffer.
+        """
+        if self.c_library.arm_wakeup() != 0:
+            return
+        loop = asyncio.get_running_loop()
+        woken = loop.create_future()
+        fd = self.c_library.get_wakeup_fd()
+        loop.add_reader(fd, lambda: woken.done() or woken.set_result(None))
+        try:
+            await woken
+        finally:
+            loop.remove_reader(fd)
+
+    def read_flows(self):
+        """
+        Copies the flows the engine finished since the last call into
+        flow_buffer. Returns the count; the flows are flow_buffer[0:n].
+        """
+        count = self.c_library.read_flows(self.flow_buffer, READ_FLOW_SLOTS, ctypes.byref(self._dropped))
+        if self._dropped.value:
+            self.dropped_flows += self._dropped.value
+        return count
+
+    def read_flow_features(self):
+        """
+        Reads the finished flows as a model-ready batch with one FFI call.
+        Returns (features, flow_ids, count): a float32 [count x C_FLOW_FEATURE_COUNT]
+        matrix and a uint64 [count] array. Both are zero-copy numpy views of
+        buffers reused by the next call; flow_buffer[0:count] holds the
+        matching flow records.
+        """
+        import numpy as np
+        if self._feature_views is None:
+            features = np.frombuffer(self.feature_buffer, dtype=np.float32)
+            self._feature_views = (features.reshape(READ_FLOW_SLOTS, C_FLOW_FEATURE_COUNT),
+                                   np.frombuffer(self.flow_id_buffer, dtype=np.uint64))
+        count = self.c_library.read_flow_features(self.feature_buffer, self.flow_id_buffer, self.flow_buffer,
+                                                  READ_FLOW_SLOTS, ctypes.byref(self._dropped))
+        if self._dropped.value:
+            self.dropped_flows += self._dropped.value
+        features, flow_ids = self._feature_views
+        return features[:count], flow_ids[:count], count
+
+    def flow_table_stats(self) -> dict:
+        """Occupancy of the native flow tables and why flows left them (expired, closed, evicted)."""
+        stats = C_FlowTableStats()
+        self.c_library.get_flow_table_stats(ctypes.byref(stats))
+        return {name: getattr(stats, name) for name, _ in C_FlowTableStats._fields_}
+
+    def engine_stats(self) -> dict:
+        """
+        Dataplane telemetry: engine state, totals and per-worker counters
+        (packets, bytes, kernel/ring drops, flows, poll batch sizes), and the
+        bytes the workers reserved / use.
+        Cheap enough to poll from a dashboard; it never slows capture.
+        """
+        if self.c_library is None:
+            return {"state": "stopped", "totals": None, "workers": []}
+        stats = C_EngineStats()
+        stats.struct_size = ctypes.sizeof(C_EngineStats)
+        self.c_library.get_engine_stats(ctypes.byref(stats))
+        return {
+            "state": SNIFFER_STATES.get(stats.state, "stopped"),
+            "totals": stats.totals.as_dict(),
+            "workers": [stats.workers[i].as_dict() for i in range(stats.worker_count)],
+            "memory_budget": stats.memory_budget,
+            "memory_used": stats.memory_used,
+        }
+
+    def latency_stats(self) -> dict:
+        """
+        Latency histogram of every pipeline stage, by SNIFFER_LAT_STAGES name:
+        count, sum/min/max, p50/p90/p99/p99.9 (ns) and the raw buckets, which
+        subtract between two calls to give the percentiles of that window.
+        """
+        if self.c_library is None:
+            return {}
+        stages = {}
+        for stage, name in SNIFFER_LAT_STAGES.items():
+            histogram = C_LatencyHistogram()
+            if self.c_library.get_latency_histogram(stage, ctypes.byref(histogram)) == 0:
+                stages[name] = histogram.as_dict()
+        return stages
+
+    def replay_stats(self):
+        """
+        Progress of a "pcap:" replay: frames/bytes replayed, how many records
+        reached the rings, and the packet rate the pipeline sustained (pps).
+        None if the capture source is not a replay.
+        """
+        if self.c_library is None:
+            return None
+        stats = C_ReplayStats()
+        if self.c_library.get_replay_stats(ctypes.byref(stats)) != 0:
+            return None
+        replay = {name: getattr(stats, name) for name, _ in C_ReplayStats._fields_ if name != "reserved"}
+        replay["finished"] = bool(stats.finished)
+        return replay
+
+    def ring_stats(self, ring: int = SNIFFER_RING_RECORDS) -> dict:
+        """Capacity, occupancy and overrun (ring-full drop) count of an engine ring."""
+        stats = C_RingStats()
+        self.c_library.get_ring_stats(ring, ctypes.byref(stats))
+        return {"capacity": stats.capacity, "occupancy": stats.occupancy, "dropped": stats.dropped}
+
+    def as_numpy(self, count: int):
+        """Returns a zero-copy numpy structured view of the first `count` batch records."""
+        import numpy as np
+        return np.ctypeslib.as_array(self.batch_buffer)[:count]
+
+    def capture_state(self) -> str:
+        """The engine's state: "stopped", "running", "parked" or "stopping"."""
+        if self.c_library is None:
+            return "stopped"
+        return SNIFFER_STATES.get(self.c_library.get_capture_state(), "stopped")
+
+    def _forward_batch(self) -> int:
+        """Copies one batch out of the engine and pushes it to the Queue."""
+        # One FFI call copies everything published since the last read
+        count = self.read_batch()
+
+        for i in range(count):
+            data_slot = self.batch_buffer[i]
+
+            # Convert the C structure data into a Python dictionary or tuple
+            processed_data = (
+                data_slot.timestamp,
+                data_slot.length,
+                data_slot.flow_hash,
+                data_slot.is_alert
+            )
+
+            # Push the processed data to the Flow Analyzer queue
+            self.output_queue.put(processed_data)
+        return count
+
     def _read_and_process_buffer(self):
         """
         Runs in a separate Python thread. 
-        Continuously checks the C++ shared buffer for new data and pushes it to the Queue.
+        Drains the C++ shared buffer in batches and pushes each record to the Queue.
         """
         print("[Sniffer Reader] Started monitoring C++ shared buffer.")
         while not self._stop_event.is_set():
             try:
-                # Get the current write position from the C++ engine
                 if self.c_library is None:
                     print("[Sniffer Reader ERROR] C++ library not loaded.")
                     time.sleep(1)
                     continue
-                current_write_index = self.c_library.get_write_index()
-                
-                # Check for new data written since the last read
-                while self.last_read_index != current_write_index:
-                    # Read the new data slot
-                    data_slot = self.shared_buffer[self.last_read_index]
-                    
-                    # Convert the C structure data into a Python dictionary or tuple
-                    processed_data = (
-                        data_slot.timestamp,
-                        data_slot.length,
-                        data_slot.flow_hash,
-                        data_slot.is_alert
-                    )
-                    
-                    # Push the processed data to the Flow Analyzer queue
-                    self.output_queue.put(processed_data)
-                    
-                    # Move to the next slot (wrap around at the buffer end)
-                    self.last_read_index = (self.last_read_index + 1) % MAX_BUFFER_SLOTS
-                    
-                # Small pause to avoid busy-waiting and consuming excessive CPU
-                time.sleep(0.001) 
+
+                # Only wait when the engine had nothing for us; the wait
+                # releases the GIL and returns as soon as a worker publishes.
+                if self._forward_batch() == 0:
+                    self.c_library.wait_for_data(SNIFFER_WAIT_TIMEOUT_MS)
                 
             except Exception as e:
                 print(f"[Sniffer Reader ERROR] Failed to read buffer: {e}")
                 time.sleep(1) # Sleep longer on error
 
+        # The engine has stopped (and drained) by now: collect the rest.
+        try:
+            while self.c_library is not None and self._forward_batch() > 0:
+                pass
+        except Exception as e:
+            print(f"[Sniffer Reader ERROR] Failed to drain buffer: {e}")
+
         print("[Sniffer Reader] Stopped.")
 
 
     def start_sniffing(self):
         """
         Starts the Python buffer reader and the C++ capture engine in the background.
+        After stop_sniffing(keep_warm=True) with unchanged settings the engine
+        resumes its parked workers instead of reopening the interface.
         """
-        # Start the Python thread that reads the C++ buffer
+        # Start the Python thread that reads the C++ buffer (a new one after a stop)
+        if self.reading_thread.is_alive():
+            print("[Sniffer ERROR] Sniffer is already running.")
+            return
+        self._stop_event.clear()
+        self.reading_thread = threading.Thread(target=self._read_and_process_buffer, daemon=True)
         self.reading_thread.start()
         
         print("[Sniffer] Launching high-speed C++ capture engine...")
@@ -143,7 +1469,17 @@ class PacketSniffer:
             print("[Sniffer ERROR] C++ library is not loaded. Cannot start capture engine.")
             return
 
-        result = self.c_library.start_capture_engine(interface_bytes, self.shared_buffer)
+        config = C_CaptureConfig()
+        self.c_library.init_capture_config(ctypes.byref(config))
+        config.queues = self.queues
+        config.fanout_mode = SNIFFER_FANOUT_MODES[self.fanout]
+        for worker, cpu in enumerate(self.cpus[:SNIFFER_MAX_QUEUES]):
+            config.cpus[worker] = cpu
+        config.flow_active_timeout_ms = int(self.flow_window * 1000)
+        config.flow_idle_timeout_ms = int(self.flow_window * 2000)
+        config.memory_budget_mb = self.memory_budget_mb
+
+        result = self.c_library.start_capture_engine_ex(interface_bytes, self.shared_buffer, ctypes.byref(config))
         
         if result == 0:
             print("[Sniffer] C++ engine process terminated successfully.")
@@ -151,21 +1487,272 @@ class PacketSniffer:
             print(f"[Sniffer ERROR] C++ engine returned error code: {result}")
         
 
-    def stop_sniffing(self):
+    def stop_sniffing(self, keep_warm: bool = False, timeout: float = SNIFFER_STOP_TIMEOUT_MS / 1000):
         """
-        Signals the C++ engine to stop and waits for the reading thread to finish.
+        Stops the C++ engine and waits for the reading thread to finish.
+
+        The engine drains what it had already captured before it returns, and
+        the reader forwards that before it exits, so no accepted packet is lost.
+        With keep_warm the capture workers are parked with their sockets and
+        rings intact, so the next start_sniffing() resumes in place.
         """
         print("[Sniffer] Signal received to stop.")
         
-        # 1. Signal the C++ engine to terminate its internal loop
+        # 1. Stop the C++ engine; returns once its workers have drained
         if self.c_library:
-            self.c_library.stop_capture_engine() 
+            flags = SNIFFER_STOP_KEEP_WARM if keep_warm else 0
+            if self.c_library.stop_capture_engine_ex(int(timeout * 1000), flags) != 0:
+                print("[Sniffer ERROR] C++ engine did not stop in time; still draining.")
         
-        # 2. Set the event to stop the Python reading thread
+        # 2. Set the event to stop the Python reading thread (and wake it)
         self._stop_event.set()
+        if self.c_library:
+            self.c_library.wake_consumer()
         
         # 3. Wait for the reading thread to finish cleanly
         if self.reading_thread.is_alive():
             self.reading_thread.join(timeout=5)
             
-        print("[Sniffer] Worker shutdown complete.")
\ No newline at end of file
+        print("[Sniffer] Worker shutdown complete.")
+
+
+# ===================================================================
+# SHARED-MEMORY RING CONSUMER (any process)
+# ===================================================================
+
+class SharedRingReader:
+    """
+    Follows the engine's shared-memory record ring from another process,
+    without libsniffer or the GIL of the capturing process:
+
+        reader = SharedRingReader(sniffer.shared_ring_info()["path"])
+        n = reader.read()        # records are reader.buffer[0:n]
+
+    The segment is mapped read-only and the reader keeps its own cursor per
+    capture lane, so any number of readers (analyzer, WAF, recorder) follow
+    the engine independently. It never slows the engine down: a reader
+    that falls more than lane_slots records behind skips ahead, and counts
+    what it missed in `lost`. Readers start at the newest record unless
+    from_start is set.
+    """
+    def __init__(self, path: str, max_records: int = READ_BATCH_SLOTS, from_start: bool = False):
+        fd = os.open(path, os.O_RDONLY)
+        try:
+            self._map = mmap.mmap(fd, 0, mmap.MAP_SHARED, mmap.PROT_READ)
+        finally:
+            os.close(fd)
+        header = C_SharedRingHeader.from_buffer_copy(self._map[:ctypes.sizeof(C_SharedRingHeader)])
+        if header.magic != SNIFFER_SHM_MAGIC or header.version != SNIFFER_SHM_VERSION:
+            raise RuntimeError(f"{path} is not a v{SNIFFER_SHM_VERSION} shared record ring")
+        if header.abi_version != SNIFFER_ABI_VERSION or header.record_size != ctypes.sizeof(C_PacketData):
+            raise RuntimeError(f"shared ring records are ABI v{header.abi_version} ({header.record_size} bytes), "
+                               f"expected v{SNIFFER_ABI_VERSION} ({ctypes.sizeof(C_PacketData)} bytes)")
+        self.path = path
+        self.pid = header.pid
+        self.lane_count = header.lane_count
+        self.lane_slots = header.lane_slots
+        self._lanes = [header.lane_offset + i * header.lane_stride for i in range(header.lane_count)]
+        self._view = memoryview(self._map)
+        self.max_records = max_records
+        self.buffer = aligned_array(C_PacketData, max_records)
+        self._out = memoryview(self.buffer).cast("B")
+        self._cursors = [self._position(lane, 0) for lane in self._lanes]
+        if from_start:
+            self._cursors = [max(0, cursor - self.lane_slots) for cursor in self._cursors]
+        self._next_lane = 0
+        self.lost = 0
+
+    def _position(self, lane: int, offset: int) -> int:
+        return struct.unpack_from("<Q", self._map, lane + offset)[0]
+
+    @property
+    def closed(self) -> bool:
+        """True once the engine has stopped writing this segment for good (reopen its new path)."""
+        return struct.unpack_from("<I", self._map, C_SharedRingHeader.closed.offset)[0] != 0
+
+    def read(self) -> int:
+        """
+        Copies the records published since the last call into buffer, taking
+        each lane in turn (rotating the first). Returns the number copied.
+        """
+        copied = 0
+        for i in range(self.lane_count):
+            lane = (self._next_lane + i) % self.lane_count
+            copied += self._read_lane(lane, copied)
+            if copied == self.max_records:
+                break
+        self._next_lane = (self._next_lane + 1) % max(self.lane_count, 1)
+        return copied
+
+    def _read_lane(self, lane: int, at: int) -> int:
+        base = self._lanes[lane]
+        size = ctypes.sizeof(C_PacketData)
+        slots = self.lane_slots
+        write = self._position(base, 0)
+        cursor = min(self._cursors[lane], write)
+        start = max(cursor, write - slots)
+        count = min(write - start, self.max_records - at)
+        records = base + SNIFFER_SHM_LANE_RECORDS
+        first = min(count, slots - start % slots)
+        out = at * size
+        self._out[out:out + first * size] = self._view[records + (start % slots) * size:
+                                                       records + (start % slots + first) * size]
+        self._out[out + first * size:out + count * size] = self._view[records:records + (count - first) * size]
+
+        # Copies of records the producer may have reached meanwhile are torn.
+        torn = min(max(0, self._position(base, 64) - slots - start), count)
+        if torn:
+            kept = bytes(self._out[out + torn * size:out + count * size])
+            self._out[out:out + len(kept)] = kept
+        self.lost += (start - cursor) + torn
+        self._cursors[lane] = start + count
+        return count - torn
+
+    def close(self):
+        self._out.release()
+        self._view.release()
+        self._map.close()
+
+# ===================================================================
+# COLUMNAR FLOW LOG READER (any process)
+# ===================================================================
+
+class FlowLogReader:
+    """
+    Scans the segments set_flow_log() writes, without libsniffer and
+    without parsing a line of JSON:
+
+        reader = FlowLogReader("data/flow_log")
+        columns = reader.scan("flows", start=t0, end=t1, columns=["flow_id", "byte_count"])
+        rows = reader.rows("decisions", where={"addr": "10.0.0.7"}, limit=100)
+
+    Segments are mapped read-only; a segment whose time range misses
+    [start, end] is never read past its header, and within one only the
+    index blocks whose time range (and Bloom filter, for flow_id) match
+    are, and only the requested columns. Segments still being written are
+    read up to the rows committed so far.
+    """
+    def __init__(self, directory: str):
+        self.directory = directory
+
+    def segments(self, stream: str = "flows") -> list:
+        """Paths of the stream's segments (all lanes), oldest first per lane."""
+        try:
+            names = os.listdir(self.directory)
+        except FileNotFoundError:
+            return []
+        return sorted(os.path.join(self.directory, name) for name in names
+                      if name.startswith(stream + "-") and name.endswith(".slog"))
+
+    def scan(self, stream: str = "flows", start: float = None, end: float = None, flow_id: int = None,
+             columns: list = None, where: dict = None) -> dict:
+        """
+        Column name -> numpy array over the rows with a time in [start, end]
+        (flows: last_time; decisions: timestamp), the given flow_id, and
+        `where` column == value (addresses may be given as text). Address
+        and reason columns are [n, width] uint8 arrays.
+        """
+        import numpy as np
+        parts = []
+        for path in self.segments(stream):
+            part = self._scan_segment(np, path, start, end, flow_id, columns, where or {})
+            if part:
+                parts.append(part)
+        if not parts:
+            return {}
+        return {name: np.concatenate([part[name] for part in parts]) for name in parts[0]}
+
+    def rows(self, stream: str = "flows", start: float = None, end: float = None, flow_id: int = None,
+             where: dict = None, limit: int = 100) -> list:
+        """scan() as a list of dicts in time order (the first `limit`), for JSON endpoints."""
+        columns = self.scan(stream, start, end, flow_id, where=where)
+        if not columns:
+            return []
+        time_name = "last_time" if stream == "flows" else "timestamp"
+        order = columns[time_name].argsort(kind="stable")[:limit]
+        rows = []
+        for i in order:
+            row = {}
+            for name, values in columns.items():
+                value = values[i]
+                if values.ndim == 2:
+                    row[name] = bytes(value).rstrip(b"\0").decode("utf-8", "replace") if name == "reason" \
+                        else format_mapped_addr(value)
+                else:
+                    row[name] = value.item()
+            if "kind" in row:
+                row["kind"] = SKETCH_ALERT_KINDS.get(row["kind"], row["kind"])
+            rows.append(row)
+        return rows
+
+    @staticmethod
+    def _bloom_words(flow_id: int) -> list:
+        bits = 64 * SNIFFER_LOG_BLOOM_WORDS
+        low, high = flow_id & 0xFFFFFFFF, flow_id >> 32
+        words = {}
+        for probe in range(SNIFFER_LOG_BLOOM_PROBES):
+            bit = (low + probe * high) % bits
+            words[bit >> 6] = words.get(bit >> 6, 0) | (1 << (bit & 63))
+        return list(words.items())
+
+    def _scan_segment(self, np, path, start, end, flow_id, wanted, where):
+        with open(path, "rb") as f:
+            if os.fstat(f.fileno()).st_size < ctypes.sizeof(C_FlowLogHeader):
+                return None
+            data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        header = C_FlowLogHeader.from_buffer_copy(data[:ctypes.sizeof(C_FlowLogHeader)])
+        if header.magic != SNIFFER_LOG_MAGIC or header.version != SNIFFER_LOG_VERSION or header.rows == 0:
+            return None
+        if (start is not None and header.max_time < start) or (end is not None and header.min_time > end):
+            return None
+        rows = header.rows
+        columns = {header.columns[c].name.decode(): header.columns[c] for c in range(header.column_count)}
+
+        def column(name, count=rows):
+            spec = columns[name]
+            dtype = SNIFFER_LOG_DTYPES.get(spec.type) or np.dtype(("u1", (spec.width,)))
+            return np.frombuffer(data, dtype=dtype, count=count, offset=spec.offset)
+
+        # Index: blocks whose time range and Bloom filter can match
+        block_dtype = np.dtype([("min_time", "<f8"), ("max_time", "<f8"),
+                                ("bloom", "<u8", (SNIFFER_LOG_BLOOM_WORDS,))])
+        blocks = np.frombuffer(data, dtype=block_dtype, offset=header.index_offset,
+                               count=-(-rows // SNIFFER_LOG_BLOCK_ROWS))
+        keep = np.ones(len(blocks), dtype=bool)
+        if start is not None:
+            keep &= blocks["max_time"] >= start
+        if end is not None:
+            keep &= blocks["min_time"] <= end
+        if flow_id is not None:
+            for word, mask in self._bloom_words(flow_id):
+                keep &= (blocks["bloom"][:, word] & np.uint64(mask)) == np.uint64(mask)
+        if not keep.any():
+            return None
+        selected = np.repeat(keep, SNIFFER_LOG_BLOCK_ROWS)[:rows]
+
+        time_name = header.columns[header.time_column].name.decode()
+        if start is not None or end is not None:
+            times = column(time_name)
+            if start is not None:
+                selected &= times >= start
+            if end is not None:
+                selected &= times <= end
+        if flow_id is not None:
+            selected &= column(header.columns[header.hash_column].name.decode()) == np.uint64(flow_id)
+        for name, value in where.items():
+            if name not in columns:
+                return None
+            values = column(name)
+            if values.ndim == 2:
+                if name == "reason":
+                    raw = value.encode()[:values.shape[1]].ljust(values.shape[1], b"\0")
+                else:
+                    raw = mapped_addr(value) if isinstance(value, str) else bytes(value)
+                target = np.frombuffer(raw, dtype="u1")
+                selected &= (values == target).all(axis=1)
+            else:
+                selected &= values == value
+        if not selected.any():
+            return None
+        return {name: column(name)[selected] for name in (wanted or columns)}
+
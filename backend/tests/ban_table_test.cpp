@@ -0,0 +1,119 @@
+// tests/ban_table_test.cpp
+//
+// ConcurrentBanTable: insert / replace / erase, key 0, growth without a
+// limit, and under set_limit(): new keys refused at the limit, while the
+// tombstones left by erases are compacted by rebuilds that never grow the
+// table and keep every live entry (with its state word).
+
+#include <cstdint>
+
+#include "ban_table.h"
+#include "test_check.h"
+
+namespace {
+
+using Table = ConcurrentBanTable<uint8_t>;
+
+uint64_t key_of(uint64_t i) {
+    return (i + 1) * 0x9E3779B97F4A7C15ull;
+}
+
+void test_insert_replace_erase() {
+    Table table(16);
+    uint8_t action = 0;
+    CHECK(!table.lookup(key_of(1), &action));
+    CHECK(table.insert(key_of(1), 1));
+    CHECK(table.lookup(key_of(1), &action) && action == 1);
+    CHECK(table.insert(key_of(1), 3));  // Replaces
+    CHECK(table.lookup(key_of(1), &action) && action == 3);
+    CHECK_EQ(table.size(), 1u);
+
+    CHECK(table.erase(key_of(1)));
+    CHECK(!table.erase(key_of(1)));
+    CHECK(!table.lookup(key_of(1), &action));
+    CHECK_EQ(table.size(), 0u);
+    CHECK(table.insert(key_of(1), 2));  // Revives the tombstone
+    CHECK(table.lookup(key_of(1), &action) && action == 2);
+
+    // Key 0 is stored as key 1 (the same convention as flow_key_of()).
+    CHECK(table.insert(0, 1));
+    CHECK(table.lookup(1, &action) && action == 1);
+}
+
+void test_grows_without_limit() {
+    Table table(16);
+    const size_t initial = table.capacity();
+    for (uint64_t i = 0; i < 5000; ++i) {
+        CHECK(table.insert(key_of(i), static_cast<uint8_t>(i % 4)));
+    }
+    CHECK_EQ(table.size(), 5000u);
+    CHECK(table.capacity() > initial);
+    CHECK(table.capacity() * 3 >= table.size() * 4);
+    for (uint64_t i = 0; i < 5000; ++i) {
+        uint8_t action = 0xFF;
+        CHECK(table.lookup(key_of(i), &action) && action == i % 4);
+    }
+    CHECK_EQ(table.rejected(), 0u);
+}
+
+void test_rebuild_under_limit() {
+    constexpr size_t LIMIT = 100;
+    Table table(16);
+    table.set_limit(LIMIT);
+    const size_t capacity = table.capacity();
+    CHECK(capacity * 3 >= LIMIT * 4);
+
+    for (uint64_t i = 0; i < LIMIT; ++i) {
+        CHECK(table.insert(key_of(i), 1));
+    }
+    CHECK(!table.insert(key_of(LIMIT), 1));
+    CHECK_EQ(table.rejected(), 1u);
+    CHECK(table.insert(key_of(5), 2));  // Existing keys can still be updated at the limit
+
+    // Mark the survivors' state words to see that rebuilds carry them over.
+    std::atomic<uint64_t>* state = nullptr;
+    uint8_t action = 0;
+    {
+        EpochDomain::ReadGuard guard(table.domain());
+        CHECK(table.lookup_unguarded(key_of(LIMIT - 1), &action, &state));
+        state->store(77);
+    }
+
+    // Churn far more keys through the table than it has slots: every
+    // insert after an erase reuses the room, tombstones force rebuilds, and
+    // the table never grows past what the limit needs.
+    uint64_t next = LIMIT + 1;
+    for (uint64_t i = 0; i < 50 * capacity; ++i) {
+        const uint64_t victim = i < LIMIT - 1 ? i : next - (LIMIT - 1);
+        CHECK(table.erase(key_of(victim)));
+        CHECK(table.insert(key_of(next), 1));
+        ++next;
+    }
+    CHECK_EQ(table.size(), LIMIT);
+    CHECK_EQ(table.capacity(), capacity);
+    CHECK_EQ(table.rejected(), 1u);
+
+    CHECK(table.lookup(key_of(LIMIT - 1), &action) && action == 1);
+    {
+        EpochDomain::ReadGuard guard(table.domain());
+        CHECK(table.lookup_unguarded(key_of(LIMIT - 1), &action, &state));
+        CHECK_EQ(state->load(), 77u);
+    }
+    for (uint64_t k = next - (LIMIT - 1); k < next; ++k) {
+        CHECK(table.lookup(key_of(k), &action));
+    }
+    CHECK(!table.lookup(key_of(0), &action));
+
+    table.clear();
+    CHECK_EQ(table.size(), 0u);
+    CHECK_EQ(table.capacity(), capacity);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_insert_replace_erase);
+    RUN_TEST(test_grows_without_limit);
+    RUN_TEST(test_rebuild_under_limit);
+    return test_exit_code();
+}
@@ -0,0 +1,231 @@
+// tests/capture_filter_test.cpp
+//
+// CaptureFilter::shed() on a batch from parse_batch(): CIDR, port-range and
+// protocol rules with their side flags, first match wins, only IP entries
+// are matched; the BPF program (when the worker runs it) also sheds non-IP
+// frames; and the shed counters by cause, with bytes on the wire and hits
+// per rule. Also compile_rule() refusing malformed rules.
+
+#include <arpa/inet.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "capture_filter.h"
+#include "packet_batch.h"
+#include "test_check.h"
+
+namespace {
+
+void put16(uint8_t* p, uint16_t value) {
+    p[0] = static_cast<uint8_t>(value >> 8);
+    p[1] = static_cast<uint8_t>(value);
+}
+
+// An Ethernet frame of `len` bytes on the wire (the first 64 captured).
+void ethernet(CapturedPacket& frame, uint16_t ethertype, uint32_t len) {
+    std::memset(&frame, 0, sizeof(frame));
+    frame.header.caplen = 64;
+    frame.header.len = len;
+    put16(frame.data + 12, ethertype);
+}
+
+void ipv4(CapturedPacket& frame, uint8_t protocol, const char* src, uint16_t sport, const char* dst,
+          uint16_t dport, uint32_t len) {
+    ethernet(frame, 0x0800, len);
+    uint8_t* ip = frame.data + 14;
+    ip[0] = 0x45;
+    ip[9] = protocol;
+    inet_pton(AF_INET, src, ip + 12);
+    inet_pton(AF_INET, dst, ip + 16);
+    put16(ip + 20, sport);
+    put16(ip + 22, dport);
+}
+
+void ipv6(CapturedPacket& frame, uint8_t protocol, const char* src, uint16_t sport, const char* dst,
+          uint16_t dport, uint32_t len) {
+    ethernet(frame, 0x86DD, len);
+    frame.header.caplen = 14 + 40 + 20;
+    uint8_t* ip = frame.data + 14;
+    ip[0] = 0x60;
+    ip[6] = protocol;
+    inet_pton(AF_INET6, src, ip + 8);
+    inet_pton(AF_INET6, dst, ip + 24);
+    put16(ip + 40, sport);
+    put16(ip + 42, dport);
+}
+
+C_ShedRule rule(uint8_t protocol, uint8_t flags, int family, const char* addr, uint8_t prefix_len,
+                uint16_t port_min, uint16_t port_max) {
+    C_ShedRule out;
+    std::memset(&out, 0, sizeof(out));
+    out.protocol = protocol;
+    out.flags = flags;
+    out.port_min = port_min;
+    out.port_max = port_max;
+    if (family == AF_INET) {
+        out.addr[10] = out.addr[11] = 0xFF;
+        inet_pton(AF_INET, addr, out.addr + 12);
+        out.prefix_len = static_cast<uint8_t>(96 + prefix_len);
+    } else if (family == AF_INET6) {
+        inet_pton(AF_INET6, addr, out.addr);
+        out.prefix_len = prefix_len;
+    }
+    return out;
+}
+
+std::vector<CompiledShedRule> compile(const std::vector<C_ShedRule>& rules) {
+    std::vector<CompiledShedRule> out(rules.size());
+    for (size_t i = 0; i < rules.size(); ++i) {
+        CHECK(CaptureFilter::compile_rule(rules[i], out[i]));
+    }
+    return out;
+}
+
+// Frames and what the rules below make of them.
+enum Frame {
+    TCP_FROM_LAN,     // 10.0.7.5:40000 -> 192.168.1.10:443/tcp: rule 0 (and 3, which is later)
+    TCP_OTHER_LAN,    // 10.1.0.5 -> 192.168.1.10:22/tcp: outside rule 0's /16, kept
+    UDP_TO_LAN,       // 172.16.0.1:53 -> 10.0.0.9:5555/udp: rule 0 is source-only, kept
+    UDP_BULK,         // 8.8.8.8:1234 -> 1.2.3.4:8050/udp: rule 1
+    UDP_BULK_SPORT,   // 8.8.8.8:8050 -> 1.2.3.4:1234/udp: rule 1 is destination-only, kept
+    TCP_BULK_PORT,    // 8.8.8.8:1234 -> 1.2.3.4:8050/tcp: rule 1 is UDP only, kept
+    V6_TO_STORAGE,    // 2001:db8::1 -> 2001:db8:5::2:443/tcp: rule 2
+    V6_FROM_STORAGE,  // 2001:db8:5::2:443 -> 2001:db8::1/tcp: rule 3 (either side of port 443)
+    ARP,              // Not IP: no rule applies, only the BPF program
+    FRAME_COUNT
+};
+
+constexpr uint32_t LEN[FRAME_COUNT] = {100, 200, 300, 1000, 1100, 1200, 1300, 1400, 64};
+
+struct Frames {
+    std::unique_ptr<CapturedPacket[]> storage{new CapturedPacket[FRAME_COUNT]};
+    const CapturedPacket* frames[FRAME_COUNT];
+
+    Frames() {
+        CapturedPacket* f = storage.get();
+        ipv4(f[TCP_FROM_LAN], 6, "10.0.7.5", 40000, "192.168.1.10", 443, LEN[TCP_FROM_LAN]);
+        ipv4(f[TCP_OTHER_LAN], 6, "10.1.0.5", 40001, "192.168.1.10", 22, LEN[TCP_OTHER_LAN]);
+        ipv4(f[UDP_TO_LAN], 17, "172.16.0.1", 53, "10.0.0.9", 5555, LEN[UDP_TO_LAN]);
+        ipv4(f[UDP_BULK], 17, "8.8.8.8", 1234, "1.2.3.4", 8050, LEN[UDP_BULK]);
+        ipv4(f[UDP_BULK_SPORT], 17, "8.8.8.8", 8050, "1.2.3.4", 1234, LEN[UDP_BULK_SPORT]);
+        ipv4(f[TCP_BULK_PORT], 6, "8.8.8.8", 1234, "1.2.3.4", 8050, LEN[TCP_BULK_PORT]);
+        ipv6(f[V6_TO_STORAGE], 6, "2001:db8::1", 50000, "2001:db8:5::2", 443, LEN[V6_TO_STORAGE]);
+        ipv6(f[V6_FROM_STORAGE], 6, "2001:db8:5::2", 443, "2001:db8::1", 50000, LEN[V6_FROM_STORAGE]);
+        ethernet(f[ARP], 0x0806, LEN[ARP]);
+        for (size_t i = 0; i < FRAME_COUNT; ++i) {
+            frames[i] = &f[i];
+        }
+    }
+};
+
+std::vector<CompiledShedRule> rule_set() {
+    return compile({
+        rule(6, SNIFFER_SHED_ADDR_SRC, AF_INET, "10.0.0.0", 16, 0, 0),
+        rule(17, SNIFFER_SHED_PORT_DST, 0, nullptr, 0, 8000, 8100),
+        rule(6, SNIFFER_SHED_ADDR_DST, AF_INET6, "2001:db8:5::", 48, 443, 443),
+        rule(0, 0, 0, nullptr, 0, 443, 443),
+    });
+}
+
+// ldh [12]; jeq #0x0806, reject; ret #0xffff: drops ARP, keeps the rest.
+std::vector<C_BpfInsn> drop_arp() {
+    return {
+        {0x28, 0, 0, 12},
+        {0x15, 0, 1, 0x0806},
+        {0x06, 0, 0, 0},
+        {0x06, 0, 0, 0xFFFF},
+    };
+}
+
+void test_rules_shed_parsed_batch() {
+    Frames input;
+    PacketBatch batch;
+    parse_batch(input.frames, FRAME_COUNT, batch);
+    CHECK_EQ(batch.state[ARP], PacketBatch::NOT_IP);
+
+    const CaptureFilter filter({}, rule_set());
+    ShedCounters counters;
+    filter.shed(input.frames, batch, false, counters);
+
+    const bool shed[FRAME_COUNT] = {true, false, false, true, false, false, true, true, false};
+    uint64_t shed_bytes = 0;
+    for (size_t i = 0; i < FRAME_COUNT; ++i) {
+        const PacketBatch::State kept = i == ARP ? PacketBatch::NOT_IP : PacketBatch::IP;
+        CHECK_EQ(batch.state[i], shed[i] ? PacketBatch::SHED : kept);
+        shed_bytes += shed[i] ? LEN[i] : 0;
+    }
+    CHECK_EQ(counters.rule_packets, 4u);
+    CHECK_EQ(counters.rule_bytes, shed_bytes);
+    CHECK_EQ(counters.rule_hits[0], 1u);
+    CHECK_EQ(counters.rule_hits[1], 1u);
+    CHECK_EQ(counters.rule_hits[2], 1u);
+    CHECK_EQ(counters.rule_hits[3], 1u);  // Only V6_FROM_STORAGE: earlier rules took the other 443s
+    CHECK_EQ(counters.filter_packets, 0u);
+    CHECK_EQ(counters.filter_bytes, 0u);
+
+    // The counters add up over batches; entries already shed stay shed.
+    parse_batch(input.frames, FRAME_COUNT, batch);
+    filter.shed(input.frames, batch, false, counters);
+    CHECK_EQ(counters.rule_packets, 8u);
+    CHECK_EQ(counters.rule_bytes, 2 * shed_bytes);
+    CHECK_EQ(counters.rule_hits[2], 2u);
+}
+
+void test_bpf_sheds_before_rules() {
+    Frames input;
+    PacketBatch batch;
+    parse_batch(input.frames, FRAME_COUNT, batch);
+
+    const CaptureFilter filter(drop_arp(), rule_set());
+    CHECK(CaptureFilter::validate_bpf(filter.bpf().data(), static_cast<uint32_t>(filter.bpf().size())));
+    ShedCounters counters;
+    filter.shed(input.frames, batch, true, counters);
+    CHECK_EQ(batch.state[ARP], PacketBatch::SHED);
+    CHECK_EQ(batch.state[TCP_OTHER_LAN], PacketBatch::IP);
+    CHECK_EQ(batch.state[UDP_BULK], PacketBatch::SHED);
+    CHECK_EQ(counters.filter_packets, 1u);
+    CHECK_EQ(counters.filter_bytes, LEN[ARP]);
+    CHECK_EQ(counters.rule_packets, 4u);
+
+    // With the kernel running the program (AF_PACKET) the worker does not.
+    parse_batch(input.frames, FRAME_COUNT, batch);
+    ShedCounters kernel;
+    filter.shed(input.frames, batch, false, kernel);
+    CHECK_EQ(batch.state[ARP], PacketBatch::NOT_IP);
+    CHECK_EQ(kernel.filter_packets, 0u);
+    CHECK_EQ(kernel.rule_packets, 4u);
+}
+
+void test_compile_rejects_bad_rules() {
+    CompiledShedRule out;
+    C_ShedRule bad = rule(6, 0, AF_INET6, "2001:db8::", 64, 0, 0);
+    bad.prefix_len = 129;
+    CHECK(!CaptureFilter::compile_rule(bad, out));
+    CHECK(!CaptureFilter::compile_rule(rule(17, 0, 0, nullptr, 0, 9000, 8000), out));
+    CHECK(!CaptureFilter::compile_rule(rule(17, 0x10, 0, nullptr, 0, 53, 53), out));
+
+    // Host bits past the prefix are ignored: 10.0.9.9/16 is 10.0.0.0/16.
+    CHECK(CaptureFilter::compile_rule(rule(0, SNIFFER_SHED_ADDR_SRC, AF_INET, "10.0.9.9", 16, 0, 0), out));
+    FlowTuple tuple;
+    std::memset(&tuple, 0, sizeof(tuple));
+    tuple.ip_version = 4;
+    tuple.protocol = 17;
+    tuple.src_addr[10] = tuple.src_addr[11] = 0xFF;
+    inet_pton(AF_INET, "10.0.200.1", tuple.src_addr + 12);
+    const CaptureFilter filter({}, {out});
+    CHECK_EQ(filter.shed_rule(tuple), 0u);
+    inet_pton(AF_INET, "10.1.0.1", tuple.src_addr + 12);
+    CHECK(filter.shed_rule(tuple) == -1);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_rules_shed_parsed_batch);
+    RUN_TEST(test_bpf_sheds_before_rules);
+    RUN_TEST(test_compile_rejects_bad_rules);
+    return test_exit_code();
+}
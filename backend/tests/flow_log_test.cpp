@@ -0,0 +1,350 @@
+// tests/flow_log_test.cpp
+//
+// FlowLogWriter: flows and decisions appended across segment rotations (by
+// rows and by segment_seconds) land in numbered, sealed segments of the
+// documented layout, and a reader that follows sniffer_engine.h (skip
+// segments and index blocks by time range and Bloom filter, then compare
+// the time / flow_id columns) finds exactly the rows appended, field for
+// field. A writer reopened on the directory numbers after what is there.
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "flow_log.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr double T0 = 1700000000.0;
+constexpr uint32_t SEGMENT_ROWS = 2 * SNIFFER_LOG_BLOCK_ROWS;
+
+std::string log_directory() {
+    char cwd[4096];
+    return std::string(getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : ".") + "/flow_log_test.d";
+}
+
+std::vector<std::string> segment_files(const std::string& directory, const std::string& prefix) {
+    std::vector<std::string> paths;
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (const dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.compare(0, prefix.size(), prefix) == 0) {
+                paths.push_back(directory + "/" + name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+void clear_directory(const std::string& directory) {
+    for (const std::string& path : segment_files(directory, "")) {
+        std::remove(path.c_str());
+    }
+}
+
+// One segment file, read whole.
+struct Segment {
+    std::vector<uint8_t> data;
+
+    const C_FlowLogHeader& header() const { return *reinterpret_cast<const C_FlowLogHeader*>(data.data()); }
+
+    const C_FlowLogColumn* column(const char* name) const {
+        for (uint32_t c = 0; c < header().column_count; ++c) {
+            if (std::strncmp(header().columns[c].name, name, sizeof(header().columns[c].name)) == 0) {
+                return &header().columns[c];
+            }
+        }
+        return nullptr;
+    }
+
+    template <typename T>
+    T value(const C_FlowLogColumn& column, uint64_t row) const {
+        T out;
+        std::memcpy(&out, data.data() + column.offset + row * column.width, sizeof(out));
+        return out;
+    }
+
+    template <typename T>
+    T value(const char* name, uint64_t row) const {
+        const C_FlowLogColumn* spec = column(name);
+        CHECK(spec != nullptr && spec->width == sizeof(T));
+        return spec != nullptr ? value<T>(*spec, row) : T();
+    }
+
+    const C_FlowLogBlock& block(uint64_t b) const {
+        return reinterpret_cast<const C_FlowLogBlock*>(data.data() + header().index_offset)[b];
+    }
+};
+
+std::vector<Segment> load(const std::string& directory, const std::string& prefix) {
+    std::vector<Segment> segments;
+    for (const std::string& path : segment_files(directory, prefix)) {
+        Segment segment;
+        if (FILE* file = std::fopen(path.c_str(), "rb")) {
+            std::fseek(file, 0, SEEK_END);
+            segment.data.resize(static_cast<size_t>(std::ftell(file)));
+            std::fseek(file, 0, SEEK_SET);
+            CHECK_EQ(std::fread(segment.data.data(), 1, segment.data.size(), file), segment.data.size());
+            std::fclose(file);
+        }
+        CHECK(segment.data.size() >= sizeof(C_FlowLogHeader));
+        CHECK_EQ(segment.header().magic, SNIFFER_LOG_MAGIC);
+        CHECK_EQ(segment.header().segment_size, segment.data.size());
+        segments.push_back(std::move(segment));
+    }
+    return segments;
+}
+
+bool bloom_may_contain(const C_FlowLogBlock& block, uint64_t flow_id) {
+    const uint64_t low = flow_id & 0xFFFFFFFFu;
+    const uint64_t high = flow_id >> 32;
+    for (uint64_t probe = 0; probe < SNIFFER_LOG_BLOOM_PROBES; ++probe) {
+        const uint64_t bit = (low + probe * high) % (64 * SNIFFER_LOG_BLOOM_WORDS);
+        if ((block.bloom[bit >> 6] & (1ull << (bit & 63))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Hit {
+    const Segment* segment;
+    uint64_t row;
+};
+
+// The rows with a time in [start, end] (and the flow id, if non-zero), as
+// FlowLogReader.scan() finds them: through the header and block index
+// first, then the columns. *blocks_read counts the index blocks not skipped.
+std::vector<Hit> search(const std::vector<Segment>& segments, double start, double end, uint64_t flow_id,
+                        size_t* blocks_read) {
+    std::vector<Hit> hits;
+    *blocks_read = 0;
+    for (const Segment& segment : segments) {
+        const C_FlowLogHeader& header = segment.header();
+        if (header.rows == 0 || header.max_time < start || header.min_time > end) {
+            continue;
+        }
+        const C_FlowLogColumn& time = header.columns[header.time_column];
+        const C_FlowLogColumn& hash = header.columns[header.hash_column];
+        for (uint64_t b = 0; b * SNIFFER_LOG_BLOCK_ROWS < header.rows; ++b) {
+            const C_FlowLogBlock& block = segment.block(b);
+            if (block.max_time < start || block.min_time > end ||
+                (flow_id != 0 && !bloom_may_contain(block, flow_id))) {
+                continue;
+            }
+            ++*blocks_read;
+            const uint64_t last = std::min<uint64_t>((b + 1) * SNIFFER_LOG_BLOCK_ROWS, header.rows);
+            for (uint64_t row = b * SNIFFER_LOG_BLOCK_ROWS; row < last; ++row) {
+                const double t = segment.value<double>(time, row);
+                if (t >= start && t <= end && (flow_id == 0 || segment.value<uint64_t>(hash, row) == flow_id)) {
+                    hits.push_back({&segment, row});
+                }
+            }
+        }
+    }
+    return hits;
+}
+
+uint64_t flow_id_of(uint64_t i) {
+    return (i + 1) * 0x9E3779B97F4A7C15ull;
+}
+
+double flow_time(uint64_t i) {
+    return T0 + static_cast<double>(i) * 0.01;
+}
+
+C_FlowRecord flow(uint64_t i) {
+    C_FlowRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.flow_id = flow_id_of(i);
+    record.start_time = flow_time(i) - 1.0;
+    record.last_time = flow_time(i);
+    record.byte_count = i * 100;
+    record.packet_count = static_cast<uint32_t>(i + 1);
+    record.src_port = static_cast<uint16_t>(1024 + i);
+    record.dst_port = 443;
+    record.protocol = 6;
+    record.src_addr[10] = record.src_addr[11] = 0xFF;
+    record.src_addr[12] = 10;
+    record.src_addr[15] = static_cast<uint8_t>(i);
+    return record;
+}
+
+C_SketchAlert decision(uint64_t i) {
+    C_SketchAlert alert;
+    std::memset(&alert, 0, sizeof(alert));
+    alert.flow_id = flow_id_of(2 * i);
+    alert.timestamp = T0 + static_cast<double>(i) * 0.02;
+    alert.estimate = i;
+    alert.kind = C_ALERT_DECISION;
+    alert.action = static_cast<uint8_t>(i % 4);
+    alert.queue_id = SNIFFER_LOG_CONTROL_LANE;
+    return alert;
+}
+
+void check_flow_row(const Hit& hit, uint64_t i) {
+    const Segment& s = *hit.segment;
+    const C_FlowRecord want = flow(i);
+    CHECK_EQ(s.value<uint64_t>("flow_id", hit.row), want.flow_id);
+    CHECK(s.value<double>("start_time", hit.row) == want.start_time);
+    CHECK(s.value<double>("last_time", hit.row) == want.last_time);
+    CHECK_EQ(s.value<uint64_t>("byte_count", hit.row), want.byte_count);
+    CHECK_EQ(s.value<uint32_t>("packet_count", hit.row), want.packet_count);
+    CHECK_EQ(s.value<uint16_t>("src_port", hit.row), want.src_port);
+    CHECK_EQ(s.value<uint8_t>("protocol", hit.row), want.protocol);
+    const C_FlowLogColumn* addr = s.column("src_addr");
+    CHECK(addr != nullptr && addr->width == 16 &&
+          std::memcmp(s.data.data() + addr->offset + hit.row * 16, want.src_addr, 16) == 0);
+}
+
+void test_flows_across_rotation() {
+    const std::string directory = log_directory();
+    clear_directory(directory);
+    FlowLogSettings settings;
+    settings.directory = directory;
+    settings.streams = SNIFFER_LOG_FLOWS;
+    settings.segment_rows = SEGMENT_ROWS;
+
+    constexpr uint64_t N = 1300;  // Two full segments and part of a third
+    FlowLogWriter writer(settings, SNIFFER_LOG_FLOWS, 0);
+    CHECK_EQ(writer.open(), 0);
+    for (uint64_t i = 0; i < N; ++i) {
+        writer.append_flow(flow(i));
+    }
+
+    // The open segment is readable up to its committed rows.
+    std::vector<Segment> segments = load(directory, "flows-q0-");
+    CHECK_EQ(segments.size(), 3u);
+    CHECK_EQ(segments.back().header().sealed, 0u);
+    writer.close();
+    segments = load(directory, "flows-q0-");
+    CHECK_EQ(segments.size(), 3u);
+    uint64_t rows = 0;
+    for (size_t s = 0; s < segments.size(); ++s) {
+        const C_FlowLogHeader& header = segments[s].header();
+        CHECK_EQ(header.sequence, s);
+        CHECK_EQ(header.kind, SNIFFER_LOG_FLOWS);
+        CHECK_EQ(header.capacity, SEGMENT_ROWS);
+        CHECK_EQ(header.sealed, 1u);
+        CHECK(header.min_time == flow_time(rows));
+        rows += header.rows;
+        CHECK(header.max_time == flow_time(rows - 1));
+        CHECK_EQ(segments[s].data.size(), FlowLogWriter::segment_bytes(SNIFFER_LOG_FLOWS, SEGMENT_ROWS));
+    }
+    CHECK_EQ(rows, N);
+
+    C_FlowLogStats stats{};
+    writer.add_stats(stats);
+    CHECK_EQ(stats.flow_rows, N);
+    CHECK_EQ(stats.segments, 3u);
+    CHECK_EQ(stats.rows_lost, 0u);
+
+    // A time range across the first rotation: rows 400..700, in order,
+    // from the blocks that hold them only.
+    size_t blocks = 0;
+    std::vector<Hit> hits = search(segments, flow_time(400), flow_time(700), 0, &blocks);
+    CHECK_EQ(hits.size(), 301u);
+    CHECK_EQ(blocks, 2u);
+    for (size_t k = 0; k < hits.size(); ++k) {
+        check_flow_row(hits[k], 400 + k);
+    }
+    CHECK(search(segments, flow_time(N) + 1.0, flow_time(N) + 2.0, 0, &blocks).empty());
+    CHECK_EQ(blocks, 0u);
+
+    // By flow id, in each segment, and one that was never appended.
+    for (uint64_t i : {uint64_t(0), uint64_t(511), uint64_t(512), uint64_t(1299)}) {
+        hits = search(segments, flow_time(0), flow_time(N), flow_id_of(i), &blocks);
+        CHECK_EQ(hits.size(), 1u);
+        CHECK(blocks >= 1 && blocks < 3);
+        if (hits.size() == 1) {
+            check_flow_row(hits[0], i);
+        }
+    }
+    CHECK(search(segments, flow_time(0), flow_time(N), flow_id_of(N + 5), &blocks).empty());
+
+    // Reopened on the same directory: numbered after the existing segments.
+    FlowLogWriter again(settings, SNIFFER_LOG_FLOWS, 0);
+    CHECK_EQ(again.open(), 0);
+    again.append_flow(flow(N));
+    again.close();
+    segments = load(directory, "flows-q0-");
+    CHECK_EQ(segments.size(), 4u);
+    CHECK_EQ(segments.back().header().sequence, 3u);
+    hits = search(segments, flow_time(N), flow_time(N), flow_id_of(N), &blocks);
+    CHECK_EQ(hits.size(), 1u);
+    clear_directory(directory);
+}
+
+void test_decisions_rotate_by_time() {
+    const std::string directory = log_directory();
+    clear_directory(directory);
+    FlowLogSettings settings;
+    settings.directory = directory;
+    settings.streams = SNIFFER_LOG_DECISIONS;
+    settings.segment_rows = SEGMENT_ROWS;
+    settings.segment_seconds = 4;  // 200 rows at 20 ms apart
+
+    constexpr uint64_t N = 600;
+    FlowLogWriter writer(settings, SNIFFER_LOG_DECISIONS, SNIFFER_LOG_CONTROL_LANE);
+    CHECK_EQ(writer.open(), 0);
+    for (uint64_t i = 0; i < N; ++i) {
+        writer.append_decision(decision(i), i % 2 ? "model" : "very-long-reason-truncated");
+    }
+    writer.close();
+
+    std::vector<Segment> segments = load(directory, "decisions-ctl-");
+    CHECK_EQ(segments.size(), 3u);
+    for (const Segment& segment : segments) {
+        CHECK_EQ(segment.header().rows, 200u);
+        CHECK_EQ(segment.header().lane, SNIFFER_LOG_CONTROL_LANE);
+    }
+
+    size_t blocks = 0;
+    const double start = decision(150).timestamp;
+    const double end = decision(449).timestamp;
+    std::vector<Hit> hits = search(segments, start, end, 0, &blocks);
+    CHECK_EQ(hits.size(), 300u);
+    for (size_t k = 0; k < hits.size(); ++k) {
+        const uint64_t i = 150 + k;
+        const Segment& s = *hits[k].segment;
+        const C_SketchAlert want = decision(i);
+        CHECK_EQ(s.value<uint64_t>("flow_id", hits[k].row), want.flow_id);
+        CHECK(s.value<double>("timestamp", hits[k].row) == want.timestamp);
+        CHECK_EQ(s.value<uint64_t>("estimate", hits[k].row), want.estimate);
+        CHECK_EQ(s.value<uint8_t>("kind", hits[k].row), want.kind);
+        CHECK_EQ(s.value<uint8_t>("action", hits[k].row), want.action);
+        const C_FlowLogColumn* reason = s.column("reason");
+        CHECK(reason != nullptr && reason->width == 16);
+        if (reason != nullptr) {
+            const char* text = reinterpret_cast<const char*>(s.data.data() + reason->offset + hits[k].row * 16);
+            CHECK(std::strncmp(text, i % 2 ? "model" : "very-long-reaso", 16) == 0);
+            CHECK_EQ(text[15], 0);
+        }
+    }
+
+    hits = search(segments, decision(0).timestamp, decision(N - 1).timestamp, flow_id_of(2 * 333), &blocks);
+    CHECK_EQ(hits.size(), 1u);
+    if (hits.size() == 1) {
+        CHECK_EQ(hits[0].segment->value<uint64_t>("estimate", hits[0].row), 333u);
+    }
+    CHECK(search(segments, decision(0).timestamp, decision(N - 1).timestamp, flow_id_of(1), &blocks).empty());
+    clear_directory(directory);
+    rmdir(directory.c_str());
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_flows_across_rotation);
+    RUN_TEST(test_decisions_rotate_by_time);
+    return test_exit_code();
+}
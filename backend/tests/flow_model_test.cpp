@@ -0,0 +1,234 @@
+// tests/flow_model_test.cpp
+//
+// FlowModel: a two-tree ensemble and a logistic regression scored on known
+// rows (standardization, tree averaging across the eight-row lanes,
+// softmax), and parse() refusing images a walk could run off: truncated or
+// padded images, child references out of range or pointing back up the
+// tree, leaf offsets that split a leaf or run past values[], NaN thresholds.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "flow_model.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr size_t F = C_FLOW_FEATURE_COUNT;
+
+struct Image {
+    C_FlowModelHeader header;
+    std::vector<uint32_t> roots;
+    std::vector<C_FlowModelNode> nodes;
+    std::vector<float> values;
+
+    explicit Image(uint32_t kind) {
+        std::memset(&header, 0, sizeof(header));
+        header.magic = SNIFFER_MODEL_MAGIC;
+        header.version = SNIFFER_MODEL_VERSION;
+        header.kind = kind;
+        header.feature_count = F;
+        header.class_count = 2;
+        for (size_t f = 0; f < F; ++f) {
+            header.feature_scale[f] = 1.0f;
+        }
+        header.class_actions[1] = 1;  // DROP
+    }
+
+    std::vector<uint8_t> bytes() {
+        header.tree_count = static_cast<uint32_t>(roots.size());
+        header.node_count = static_cast<uint32_t>(nodes.size());
+        header.value_count = static_cast<uint32_t>(values.size());
+        std::vector<uint8_t> out;
+        append(out, &header, sizeof(header));
+        append(out, roots.data(), roots.size() * sizeof(uint32_t));
+        append(out, nodes.data(), nodes.size() * sizeof(C_FlowModelNode));
+        append(out, values.data(), values.size() * sizeof(float));
+        return out;
+    }
+
+    static void append(std::vector<uint8_t>& out, const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+};
+
+uint32_t leaf(uint32_t offset) {
+    return SNIFFER_MODEL_LEAF | offset;
+}
+
+// Tree 0 splits on feature 0 (standardized: (x - 10) * 0.5 <= 0), then on
+// feature 1; tree 1 is a single leaf. Scores are the average of the two.
+Image forest() {
+    Image image(SNIFFER_MODEL_TREES);
+    image.header.feature_offset[0] = 10.0f;
+    image.header.feature_scale[0] = 0.5f;
+    image.roots = {0, leaf(6)};
+    image.nodes = {
+        {0.0f, 0, leaf(0), 1},        // x0 <= 10: [1, 0]
+        {0.5f, 1, leaf(2), leaf(4)},  // x1 <= 0.5: [0, 1], else [0.5, 0.5]
+    };
+    image.values = {1.0f, 0.0f, 0.0f, 1.0f, 0.5f, 0.5f, 0.2f, 0.8f};
+    return image;
+}
+
+std::shared_ptr<const FlowModel> parse(Image image, std::string* reason = nullptr) {
+    const std::vector<uint8_t> bytes = image.bytes();
+    std::string error;
+    std::shared_ptr<const FlowModel> model = FlowModel::parse(bytes.data(), bytes.size(), error);
+    CHECK(model != nullptr || !error.empty());
+    if (reason != nullptr) {
+        *reason = error;
+    }
+    return model;
+}
+
+bool near(float a, float b) {
+    return std::fabs(a - b) < 1e-5f;
+}
+
+void test_trees_score_known_rows() {
+    std::shared_ptr<const FlowModel> model = parse(forest());
+    CHECK(model != nullptr);
+    if (model == nullptr) {
+        return;
+    }
+    CHECK_EQ(model->kind(), SNIFFER_MODEL_TREES);
+    CHECK_EQ(model->class_count(), 2u);
+    CHECK_EQ(model->action(1), 1u);
+
+    // 19 rows cycling three paths: more than two lanes of eight and a partial one.
+    const float x0[3] = {5.0f, 20.0f, 20.0f};
+    const float x1[3] = {0.0f, 0.0f, 1.0f};
+    const uint8_t want_class[3] = {0, 1, 1};
+    const float want_confidence[3] = {0.6f, 0.9f, 0.65f};
+    constexpr size_t N = 19;
+    std::vector<float> rows(N * F, 0.0f);
+    for (size_t i = 0; i < N; ++i) {
+        rows[i * F + 0] = x0[i % 3];
+        rows[i * F + 1] = x1[i % 3];
+    }
+    uint8_t classes[N];
+    float confidence[N];
+    model->score(rows.data(), N, classes, confidence);
+    for (size_t i = 0; i < N; ++i) {
+        CHECK_EQ(classes[i], want_class[i % 3]);
+        CHECK(near(confidence[i], want_confidence[i % 3]));
+    }
+}
+
+void test_linear_scores_known_rows() {
+    // Class 1's logit is x0, class 0's is 0: p1 = sigmoid(x0).
+    Image image(SNIFFER_MODEL_LINEAR);
+    image.values.assign(2 * (F + 1), 0.0f);
+    image.values[F + 0] = 1.0f;
+    std::shared_ptr<const FlowModel> model = parse(image);
+    CHECK(model != nullptr);
+    if (model == nullptr) {
+        return;
+    }
+    CHECK_EQ(model->kind(), SNIFFER_MODEL_LINEAR);
+
+    std::vector<float> rows(3 * F, 0.0f);
+    rows[0 * F] = std::log(3.0f);
+    rows[1 * F] = -std::log(3.0f);
+    rows[2 * F] = 0.0f;
+    uint8_t classes[3];
+    float confidence[3];
+    model->score(rows.data(), 3, classes, confidence);
+    CHECK_EQ(classes[0], 1u);
+    CHECK(near(confidence[0], 0.75f));
+    CHECK_EQ(classes[1], 0u);
+    CHECK(near(confidence[1], 0.75f));
+    CHECK_EQ(classes[2], 0u);  // A tie goes to the lower class
+    CHECK(near(confidence[2], 0.5f));
+
+    image.values.pop_back();
+    CHECK(parse(image) == nullptr);
+}
+
+void test_rejects_truncated_images() {
+    const std::vector<uint8_t> bytes = forest().bytes();
+    std::string error;
+    CHECK(FlowModel::parse(bytes.data(), sizeof(C_FlowModelHeader) - 1, error) == nullptr);
+    CHECK(FlowModel::parse(nullptr, 0, error) == nullptr);
+    for (size_t cut : {size_t(1), size_t(4), sizeof(C_FlowModelNode) + 4}) {
+        error.clear();
+        CHECK(FlowModel::parse(bytes.data(), bytes.size() - cut, error) == nullptr);
+        CHECK(!error.empty());
+    }
+    std::vector<uint8_t> padded = bytes;
+    padded.resize(bytes.size() + 4);
+    CHECK(FlowModel::parse(padded.data(), padded.size(), error) == nullptr);
+    CHECK(FlowModel::parse(bytes.data(), bytes.size(), error) != nullptr);
+}
+
+void test_rejects_bad_references() {
+    std::string error;
+    Image image = forest();
+    image.nodes[1].right = 2;  // Past node_count
+    CHECK(parse(image, &error) == nullptr);
+    CHECK(error.find("node 1") != std::string::npos);
+
+    image = forest();
+    image.nodes[1].left = 0;  // Back up to its parent: a walk that never ends
+    CHECK(parse(image) == nullptr);
+
+    image = forest();
+    image.nodes[1].left = 1;  // Itself
+    CHECK(parse(image) == nullptr);
+
+    image = forest();
+    image.roots[0] = 5;
+    CHECK(parse(image) == nullptr);
+
+    image = forest();
+    image.nodes[0].feature = F;
+    CHECK(parse(image) == nullptr);
+}
+
+void test_rejects_bad_leaves() {
+    Image image = forest();
+    image.nodes[1].right = leaf(3);  // Splits two leaves
+    CHECK(parse(image) == nullptr);
+
+    image = forest();
+    image.roots[1] = leaf(8);  // Past values[]
+    CHECK(parse(image) == nullptr);
+
+    image = forest();
+    image.values.push_back(0.0f);  // Not a whole number of leaves
+    CHECK(parse(image) == nullptr);
+
+    image = forest();
+    image.values[3] = std::nanf("");
+    CHECK(parse(image) == nullptr);
+}
+
+void test_rejects_nan_thresholds() {
+    Image image = forest();
+    image.nodes[1].threshold = std::nanf("");
+    std::string error;
+    CHECK(parse(image, &error) == nullptr);
+    CHECK(error.find("node 1") != std::string::npos);
+
+    image = forest();
+    image.header.feature_scale[2] = std::nanf("");
+    CHECK(parse(image) == nullptr);
+    CHECK(parse(forest()) != nullptr);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_trees_score_known_rows);
+    RUN_TEST(test_linear_scores_known_rows);
+    RUN_TEST(test_rejects_truncated_images);
+    RUN_TEST(test_rejects_bad_references);
+    RUN_TEST(test_rejects_bad_leaves);
+    RUN_TEST(test_rejects_nan_thresholds);
+    return test_exit_code();
+}
@@ -0,0 +1,160 @@
+// tests/flow_table_test.cpp
+//
+// FlowTable: new flows are inserted and later packets counted to them,
+// flows leave on the idle / active timeouts, after a FIN's linger or at
+// once on a RST, and a full table evicts the flow closest to expiring.
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "flow_table.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr uint64_t MS = 1000000ull;
+constexpr uint64_t T0 = 1700000000ull * 1000000000ull;
+
+const FlowTimeouts TIMEOUTS = {10000 * MS, 2000 * MS, 100 * MS};  // active, idle, FIN linger
+
+FlowTuple tuple_for(uint32_t host) {
+    FlowTuple tuple;
+    std::memset(&tuple, 0, sizeof(tuple));
+    tuple.src_addr[10] = tuple.src_addr[11] = 0xFF;
+    std::memcpy(&tuple.src_addr[12], &host, sizeof(host));
+    tuple.dst_addr[10] = tuple.dst_addr[11] = 0xFF;
+    tuple.dst_addr[12] = 10;
+    tuple.dst_addr[15] = 1;
+    tuple.src_port = 40000;
+    tuple.dst_port = 443;
+    tuple.protocol = IPPROTO_TCP_NUM;
+    tuple.ip_version = 4;
+    return tuple;
+}
+
+struct Exported {
+    std::vector<FlowEntry> flows;
+    void operator()(const FlowEntry& entry) { flows.push_back(entry); }
+};
+
+FlowEntry* packet(FlowTable& table, uint32_t host, uint64_t ts_ns, Exported& out,
+                  uint8_t tcp_flags = TCP_FLAG_ACK, uint32_t length = 100,
+                  const FlowTimeouts& timeouts = TIMEOUTS) {
+    const FlowTuple tuple = tuple_for(host);
+    return table.update(flow_key_of(tuple), tuple, tcp_flags, length, ts_ns, timeouts, out);
+}
+
+void test_insert_and_update() {
+    FlowTable table(64);
+    Exported out;
+    FlowEntry* first = packet(table, 1, T0, out, TCP_FLAG_SYN, 60);
+    CHECK(first != nullptr);
+    CHECK_EQ(table.size(), 1u);
+    FlowEntry* again = packet(table, 1, T0 + 5 * MS, out, TCP_FLAG_ACK, 1500);
+    CHECK(again == first);
+    CHECK_EQ(table.size(), 1u);
+    CHECK_EQ(first->packets, 2u);
+    CHECK_EQ(first->bytes, 1560u);
+    CHECK_EQ(first->max_size, 1500u);
+    CHECK_EQ(first->first_ns, T0);
+    CHECK_EQ(first->last_ns, T0 + 5 * MS);
+    CHECK(first->flags & C_FLOW_FLAG_SYN);
+    CHECK(first->tuple == tuple_for(1));
+
+    CHECK(packet(table, 2, T0 + 6 * MS, out) != first);
+    CHECK_EQ(table.size(), 2u);
+    CHECK(out.flows.empty());
+}
+
+void test_idle_and_active_expiry() {
+    FlowTable table(64);
+    Exported out;
+    packet(table, 1, T0, out);                    // Goes idle
+    for (uint64_t t = 0; t <= 12000; t += 500) {  // Busy past the active timeout
+        packet(table, 2, T0 + t * MS, out);
+    }
+    CHECK_EQ(table.size(), 2u);
+
+    table.advance(T0 + 1900 * MS, TIMEOUTS, out);
+    CHECK(out.flows.empty());
+    table.advance(T0 + 2100 * MS, TIMEOUTS, out);
+    CHECK_EQ(out.flows.size(), 1u);
+    CHECK(out.flows[0].tuple == tuple_for(1));
+    CHECK_EQ(table.counters().expired_idle, 1u);
+
+    table.advance(T0 + 10100 * MS, TIMEOUTS, out);
+    CHECK_EQ(out.flows.size(), 2u);
+    CHECK(out.flows[1].tuple == tuple_for(2));
+    CHECK_EQ(table.counters().expired_active, 1u);
+    CHECK_EQ(table.size(), 0u);
+
+    // A flow that comes back after expiring starts over.
+    FlowEntry* fresh = packet(table, 1, T0 + 10200 * MS, out);
+    CHECK(fresh != nullptr && fresh->packets == 1);
+}
+
+void test_fin_linger_and_rst() {
+    FlowTable table(64);
+    Exported out;
+    packet(table, 1, T0, out);
+    packet(table, 1, T0 + 10 * MS, out, TCP_FLAG_FIN | TCP_FLAG_ACK);
+    packet(table, 1, T0 + 50 * MS, out);  // The closing ACK still counts to it
+    packet(table, 2, T0, out);
+    packet(table, 2, T0 + 20 * MS, out, TCP_FLAG_RST);
+
+    table.advance(T0 + 60 * MS, TIMEOUTS, out);
+    CHECK_EQ(out.flows.size(), 1u);
+    CHECK(out.flows[0].tuple == tuple_for(2));
+    CHECK(out.flows[0].flags & C_FLOW_FLAG_RST);
+
+    table.advance(T0 + 150 * MS, TIMEOUTS, out);
+    CHECK_EQ(out.flows.size(), 2u);
+    CHECK(out.flows[1].tuple == tuple_for(1));
+    CHECK_EQ(out.flows[1].packets, 3u);
+    CHECK_EQ(out.flows[1].close_ns, T0 + 10 * MS);
+    CHECK_EQ(table.counters().closed, 2u);
+    CHECK_EQ(table.size(), 0u);
+}
+
+void test_evicts_when_full() {
+    FlowTable table(16);
+    const size_t capacity = table.max_flows();
+    CHECK_EQ(capacity, 12u);  // 3/4 of the index
+    Exported out;
+    // Deadlines within the wheel's first level, where earliest() is exact:
+    // flow 0 is the one closest to its idle deadline.
+    const FlowTimeouts short_idle = {10000 * MS, 500 * MS, 100 * MS};
+    for (uint32_t host = 0; host < capacity; ++host) {
+        CHECK(packet(table, host, T0 + host * 40 * MS, out, TCP_FLAG_ACK, 100, short_idle) != nullptr);
+    }
+    CHECK_EQ(table.size(), capacity);
+    CHECK(out.flows.empty());
+
+    FlowEntry* newcomer = packet(table, 1000, T0 + 480 * MS, out, TCP_FLAG_ACK, 100, short_idle);
+    CHECK(newcomer != nullptr);
+    CHECK_EQ(table.size(), capacity);
+    CHECK_EQ(out.flows.size(), 1u);
+    CHECK(out.flows[0].tuple == tuple_for(0));
+    CHECK(out.flows[0].flags & C_FLOW_FLAG_EVICTED);
+    CHECK_EQ(table.counters().evicted, 1u);
+
+    // The survivors are all still found (backward-shift deletion kept the probes intact).
+    const size_t before = out.flows.size();
+    for (uint32_t host = 1; host < capacity; ++host) {
+        FlowEntry* entry = packet(table, host, T0 + 490 * MS, out, TCP_FLAG_ACK, 100, short_idle);
+        CHECK(entry != nullptr && entry->packets == 2);
+    }
+    CHECK_EQ(out.flows.size(), before);
+    CHECK_EQ(table.counters().rejected, 0u);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_insert_and_update);
+    RUN_TEST(test_idle_and_active_expiry);
+    RUN_TEST(test_fin_linger_and_rst);
+    RUN_TEST(test_evicts_when_full);
+    return test_exit_code();
+}
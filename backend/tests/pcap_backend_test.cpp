@@ -0,0 +1,386 @@
+// tests/pcap_backend_test.cpp
+//
+// The "pcap:" replay backend on files written here: classic pcap in both
+// byte orders and timestamp resolutions, raw-IP link types behind a
+// synthetic Ethernet header, truncated trailing records, pcapng with
+// several interfaces (if_tsresol, if_tsoffset, an unsupported link type,
+// Simple Packet Blocks) and sections of either byte order, and a file
+// shared by two queues.
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "capture_backend.h"
+#include "packet_parser.h"
+#include "ring_buffer.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr uint32_t FRAME_BYTES = 60;
+
+// ====================================================================
+// A) Writing capture files
+// ====================================================================
+
+class FileWriter {
+public:
+    explicit FileWriter(bool big_endian = false) : big_endian_(big_endian) {}
+
+    void set_big_endian(bool big_endian) { big_endian_ = big_endian; }
+
+    void u16(uint16_t v) {
+        put(big_endian_ ? __builtin_bswap16(v) : v);
+    }
+    void u32(uint32_t v) {
+        put(big_endian_ ? __builtin_bswap32(v) : v);
+    }
+    void u64(uint64_t v) {
+        put(big_endian_ ? __builtin_bswap64(v) : v);
+    }
+    void bytes(const std::vector<uint8_t>& data) {
+        this->data.insert(this->data.end(), data.begin(), data.end());
+    }
+    void pad4() {
+        while (data.size() % 4 != 0) {
+            data.push_back(0);
+        }
+    }
+    void patch32(size_t at, uint32_t v) {
+        v = big_endian_ ? __builtin_bswap32(v) : v;
+        std::memcpy(&data[at], &v, sizeof(v));
+    }
+
+    std::vector<uint8_t> data;
+
+private:
+    template <typename T>
+    void put(T v) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+        data.insert(data.end(), p, p + sizeof(v));
+    }
+
+    bool big_endian_;
+};
+
+// IPv4/UDP from 10.0.x.y (x.y = source) to 192.168.0.1:53, without and with Ethernet.
+std::vector<uint8_t> ipv4_udp(uint16_t source) {
+    std::vector<uint8_t> ip(FRAME_BYTES - 14, 0);
+    ip[0] = 0x45;
+    ip[2] = 0;
+    ip[3] = static_cast<uint8_t>(ip.size());
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP_NUM;
+    ip[12] = 10;
+    ip[14] = static_cast<uint8_t>(source >> 8);
+    ip[15] = static_cast<uint8_t>(source);
+    ip[16] = 192;
+    ip[17] = 168;
+    ip[19] = 1;
+    ip[20] = 0x9C;  // Source port 40000
+    ip[21] = 0x40;
+    ip[23] = 53;
+    ip[25] = static_cast<uint8_t>(ip.size() - 20);
+    return ip;
+}
+
+std::vector<uint8_t> ethernet_udp(uint16_t source) {
+    std::vector<uint8_t> frame(14, 0);
+    frame[0] = 0x02;
+    frame[6] = 0x02;
+    frame[12] = 0x08;
+    const std::vector<uint8_t> ip = ipv4_udp(source);
+    frame.insert(frame.end(), ip.begin(), ip.end());
+    return frame;
+}
+
+void pcap_header(FileWriter& out, bool nanos, uint32_t linktype) {
+    out.u32(nanos ? 0xA1B23C4Du : 0xA1B2C3D4u);
+    out.u16(2);
+    out.u16(4);
+    out.u32(0);
+    out.u32(0);
+    out.u32(65535);
+    out.u32(linktype);
+}
+
+void pcap_record(FileWriter& out, uint32_t sec, uint32_t frac, const std::vector<uint8_t>& data,
+                 uint32_t wire_len) {
+    out.u32(sec);
+    out.u32(frac);
+    out.u32(static_cast<uint32_t>(data.size()));
+    out.u32(wire_len);
+    out.bytes(data);
+}
+
+// pcapng block: type, total length, body (padded), total length.
+template <typename Body>
+void pcapng_block(FileWriter& out, uint32_t type, Body&& body) {
+    const size_t start = out.data.size();
+    out.u32(type);
+    out.u32(0);
+    body();
+    out.pad4();
+    const uint32_t length = static_cast<uint32_t>(out.data.size() - start + 4);
+    out.u32(length);
+    out.patch32(start + 4, length);
+}
+
+void pcapng_section(FileWriter& out) {
+    pcapng_block(out, 0x0A0D0D0Au, [&] {
+        out.u32(0x1A2B3C4Du);
+        out.u16(1);
+        out.u16(0);
+        out.u64(~0ull);
+    });
+}
+
+// tsresol < 0: no option (microseconds).
+void pcapng_interface(FileWriter& out, uint16_t linktype, int tsresol, uint64_t tsoffset) {
+    pcapng_block(out, 1, [&] {
+        out.u16(linktype);
+        out.u16(0);
+        out.u32(65535);
+        if (tsresol >= 0) {
+            out.u16(9);
+            out.u16(1);
+            out.data.push_back(static_cast<uint8_t>(tsresol));
+            out.pad4();
+        }
+        if (tsoffset != 0) {
+            out.u16(14);
+            out.u16(8);
+            out.u64(tsoffset);
+        }
+        out.u16(0);
+        out.u16(0);
+    });
+}
+
+void pcapng_packet(FileWriter& out, uint32_t interface, uint64_t ts_units, const std::vector<uint8_t>& data) {
+    pcapng_block(out, 6, [&] {
+        out.u32(interface);
+        out.u32(static_cast<uint32_t>(ts_units >> 32));
+        out.u32(static_cast<uint32_t>(ts_units));
+        out.u32(static_cast<uint32_t>(data.size()));
+        out.u32(static_cast<uint32_t>(data.size()));
+        out.bytes(data);
+    });
+}
+
+void pcapng_simple_packet(FileWriter& out, const std::vector<uint8_t>& data) {
+    pcapng_block(out, 3, [&] {
+        out.u32(static_cast<uint32_t>(data.size()));
+        out.bytes(data);
+    });
+}
+
+bool write_file(const std::string& path, const std::vector<uint8_t>& data) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    const bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+// ====================================================================
+// B) Replaying them
+// ====================================================================
+
+struct Frame {
+    uint32_t caplen;
+    uint32_t len;
+    uint64_t ts_ns;
+    std::vector<uint8_t> data;
+};
+
+struct Replay {
+    int open_result = 0;
+    std::vector<Frame> frames;
+    ReplayProgress progress;
+};
+
+// Replays path flat out as queue `queue` of `queues` and collects every frame.
+Replay replay(const std::string& path, unsigned queue = 0, unsigned queues = 1) {
+    Replay result;
+    std::unique_ptr<CaptureBackend> backend = make_pcap_backend();
+    CaptureOptions options;
+    options.queue_index = queue;
+    options.queue_count = queues;
+    result.open_result = backend->open(path + "@0", options);
+    if (result.open_result != 0) {
+        return result;
+    }
+    // Smaller than some of the files, so a full ring is exercised too.
+    ConcurrentRingBuffer<CapturedPacket> ring(4);
+    FrameSink sink(ring);
+    for (int polls = 0; polls < 10000; ++polls) {
+        backend->poll(sink, 0);
+        ring.flush();
+        const CapturedPacket* packet;
+        while ((packet = ring.peek()) != nullptr) {
+            Frame frame;
+            frame.caplen = packet->header.caplen;
+            frame.len = packet->header.len;
+            frame.ts_ns = packet->timestamp_ns();
+            frame.data.assign(packet->data, packet->data + packet->header.caplen);
+            result.frames.push_back(std::move(frame));
+            ring.release();
+        }
+        backend->replay_progress(result.progress);
+        if (result.progress.finished_ns != 0) {
+            break;
+        }
+    }
+    backend->close();
+    std::remove(path.c_str());
+    return result;
+}
+
+uint16_t source_of(const Frame& frame) {
+    return static_cast<uint16_t>((frame.data[14 + 14] << 8) | frame.data[14 + 15]);
+}
+
+void test_classic_pcap_little_endian_us() {
+    FileWriter out;
+    pcap_header(out, false, 1);
+    pcap_record(out, 100, 1, ethernet_udp(1), 1500);  // Snapped: shorter than on the wire
+    pcap_record(out, 100, 250000, ethernet_udp(2), FRAME_BYTES);
+    pcap_record(out, 101, 1, ethernet_udp(3), FRAME_BYTES);
+    for (int i = 4; i < 20; ++i) {
+        pcap_record(out, 102, static_cast<uint32_t>(i), ethernet_udp(static_cast<uint16_t>(i)), FRAME_BYTES);
+    }
+    // A trailing record cut short by the end of the file is not delivered.
+    pcap_record(out, 103, 0, ethernet_udp(99), FRAME_BYTES);
+    out.data.resize(out.data.size() - 20);
+    CHECK(write_file("le_us.pcap", out.data));
+
+    const Replay result = replay("le_us.pcap");
+    CHECK_EQ(result.open_result, 0);
+    CHECK_EQ(result.frames.size(), 19u);
+    CHECK_EQ(result.progress.frames, 19u);
+    CHECK_EQ(result.progress.file_offset, result.progress.file_bytes);
+    if (result.frames.size() != 19) {
+        return;
+    }
+    CHECK_EQ(result.frames[0].caplen, FRAME_BYTES);
+    CHECK_EQ(result.frames[0].len, 1500u);
+    CHECK(result.frames[0].data == ethernet_udp(1));
+    // Rebased to now, with the recorded spacing.
+    CHECK_EQ(result.frames[1].ts_ns - result.frames[0].ts_ns, 249999000u);
+    CHECK_EQ(result.frames[2].ts_ns - result.frames[0].ts_ns, 1000000000u);
+    for (size_t i = 0; i < result.frames.size(); ++i) {
+        CHECK_EQ(source_of(result.frames[i]), i + 1);  // In file order, none lost to the full ring
+    }
+}
+
+void test_classic_pcap_big_endian_ns_raw_ip() {
+    FileWriter out(true);
+    pcap_header(out, true, 101);  // LINKTYPE_RAW
+    pcap_record(out, 5, 999999999, ipv4_udp(1), FRAME_BYTES - 14);
+    pcap_record(out, 6, 0, ipv4_udp(2), FRAME_BYTES - 14);
+    CHECK(write_file("be_ns.pcap", out.data));
+
+    const Replay result = replay("be_ns.pcap");
+    CHECK_EQ(result.open_result, 0);
+    CHECK_EQ(result.frames.size(), 2u);
+    if (result.frames.size() != 2) {
+        return;
+    }
+    CHECK_EQ(result.frames[1].ts_ns - result.frames[0].ts_ns, 1u);
+    // Behind a synthetic Ethernet header, which also counts on the wire.
+    CHECK_EQ(result.frames[0].caplen, FRAME_BYTES);
+    CHECK_EQ(result.frames[0].len, FRAME_BYTES);
+    CHECK_EQ(result.frames[0].data[12], 0x08);
+    CHECK_EQ(result.frames[0].data[13], 0x00);
+    const ParsedPacket parsed = parse_packet(result.frames[1].data.data(), result.frames[1].caplen);
+    CHECK(parsed.valid);
+    CHECK_EQ(parsed.tuple.dst_port, 53u);
+    CHECK_EQ(source_of(result.frames[1]), 2u);
+}
+
+void test_pcapng_interfaces_and_sections() {
+    FileWriter out;
+    pcapng_section(out);
+    pcapng_interface(out, 1, 9, 0);          // 0: Ethernet, nanoseconds
+    pcapng_interface(out, 147, 9, 0);        // 1: a link type the engine cannot parse
+    pcapng_interface(out, 1, 0x80 | 10, 5);  // 2: Ethernet, 2^-10 s, +5 s
+    pcapng_packet(out, 0, 1000ull * 1000000000ull + 5, ethernet_udp(1));
+    pcapng_packet(out, 1, 1000ull * 1000000000ull + 6, ethernet_udp(50));
+    pcapng_simple_packet(out, ethernet_udp(2));
+    pcapng_packet(out, 2, 2000ull * 1024 + 512, ethernet_udp(3));
+    pcapng_packet(out, 7, 0, ethernet_udp(51));  // No such interface
+    // A second section in the other byte order starts its interfaces over.
+    out.set_big_endian(true);
+    pcapng_section(out);
+    pcapng_interface(out, 1, -1, 0);         // 0: Ethernet, microseconds
+    pcapng_packet(out, 0, 3000ull * 1000000 + 1, ethernet_udp(4));
+    CHECK(write_file("multi.pcapng", out.data));
+
+    const Replay result = replay("multi.pcapng");
+    CHECK_EQ(result.open_result, 0);
+    CHECK_EQ(result.frames.size(), 4u);
+    CHECK_EQ(result.progress.skipped, 1u);
+    if (result.frames.size() != 4) {
+        return;
+    }
+    for (size_t i = 0; i < 4; ++i) {
+        CHECK_EQ(source_of(result.frames[i]), i + 1);
+        CHECK_EQ(result.frames[i].caplen, FRAME_BYTES);
+    }
+    const uint64_t base = result.frames[0].ts_ns;
+    // A Simple Packet Block has no timestamp: it takes the previous record's
+    // (here the skipped one).
+    CHECK_EQ(result.frames[1].ts_ns - base, 1u);
+    CHECK_EQ(result.frames[2].ts_ns - base, 1005500000000ull - 5);
+    CHECK_EQ(result.frames[3].ts_ns - base, 2000000001000ull - 5);
+}
+
+void test_not_a_capture_file() {
+    CHECK(write_file("junk.pcap", std::vector<uint8_t>(64, 0x42)));
+    CHECK_EQ(replay("junk.pcap").open_result, -EINVAL);
+    std::remove("junk.pcap");
+    CHECK(replay("does-not-exist.pcap").open_result < 0);
+}
+
+void test_queues_split_the_flows() {
+    constexpr uint16_t FLOWS = 200;
+    FileWriter out;
+    pcap_header(out, false, 1);
+    for (uint16_t source = 0; source < FLOWS; ++source) {
+        pcap_record(out, 100, source, ethernet_udp(source), FRAME_BYTES);
+    }
+    std::set<uint16_t> seen;
+    size_t total = 0;
+    for (unsigned queue = 0; queue < 2; ++queue) {
+        CHECK(write_file("queues.pcap", out.data));
+        const Replay result = replay("queues.pcap", queue, 2);
+        CHECK(!result.frames.empty());
+        total += result.frames.size();
+        for (const Frame& frame : result.frames) {
+            seen.insert(source_of(frame));
+            const ParsedPacket parsed = parse_packet(frame.data.data(), frame.caplen);
+            CHECK(parsed.valid && flow_key_of(parsed.tuple) % 2 == queue);
+        }
+    }
+    // Every flow went to exactly one queue.
+    CHECK_EQ(total, FLOWS);
+    CHECK_EQ(seen.size(), FLOWS);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_classic_pcap_little_endian_us);
+    RUN_TEST(test_classic_pcap_big_endian_ns_raw_ip);
+    RUN_TEST(test_pcapng_interfaces_and_sections);
+    RUN_TEST(test_not_a_capture_file);
+    RUN_TEST(test_queues_split_the_flows);
+    return test_exit_code();
+}
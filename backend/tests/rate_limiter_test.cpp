@@ -0,0 +1,115 @@
+// tests/rate_limiter_test.cpp
+//
+// token_bucket: a new bucket starts full, over-limit packets are refused,
+// tokens refill at the rate up to the burst with fractions carried, and a
+// packet timestamped before the bucket (reordered across workers) refills
+// nothing. SourceRateLimiter keeps one bucket per source.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "rate_limiter.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr uint64_t MS = 1000000ull;
+constexpr uint64_t T0 = 1700000000ull * 1000000000ull;
+
+// How many of `count` back-to-back packets at ts_ns conform.
+int conforming(std::atomic<uint64_t>& bucket, uint64_t ts_ns, const RateLimit& limit, int count) {
+    int passed = 0;
+    for (int i = 0; i < count; ++i) {
+        passed += token_bucket::consume(bucket, ts_ns, limit) ? 1 : 0;
+    }
+    return passed;
+}
+
+void test_burst_then_limit() {
+    const RateLimit limit{100, 10};  // 100 pps, bursts of 10
+    std::atomic<uint64_t> bucket{0};
+    CHECK_EQ(conforming(bucket, T0, limit, 25), 10);
+    CHECK(bucket.load() != 0);  // Used, even though empty
+
+    // 100 pps: one token per 10 ms. Times are a little past whole tokens,
+    // as the bucket counts time in 1024 ns units.
+    CHECK_EQ(conforming(bucket, T0 + 51 * MS, limit, 10), 5);
+    CHECK_EQ(conforming(bucket, T0 + 51 * MS, limit, 10), 0);
+
+    // A long pause refills to the burst, never beyond it.
+    CHECK_EQ(conforming(bucket, T0 + 60000 * MS, limit, 25), 10);
+}
+
+void test_fractions_are_carried() {
+    const RateLimit limit{100, 10};
+    std::atomic<uint64_t> bucket{0};
+    conforming(bucket, T0, limit, 10);
+    // A packet every 4 ms is 250 pps offered; over a second, 100 get through
+    // (give or take one for the bucket's time granularity), not zero as
+    // they would if each 0.4-token refill were rounded away.
+    int passed = 0;
+    for (uint64_t t = 4; t <= 1000; t += 4) {
+        passed += token_bucket::consume(bucket, T0 + t * MS, limit) ? 1 : 0;
+    }
+    CHECK(passed >= 99 && passed <= 101);
+}
+
+void test_reordered_timestamps() {
+    const RateLimit limit{1000, 5};
+    std::atomic<uint64_t> bucket{0};
+    CHECK_EQ(conforming(bucket, T0 + 1000 * MS, limit, 5), 5);
+    // An older packet must not look like a ~13-day gap (full refill).
+    CHECK_EQ(conforming(bucket, T0 + 999 * MS, limit, 5), 0);
+    CHECK_EQ(conforming(bucket, T0, limit, 5), 0);
+    // Time moving forward again refills from the newest stamp.
+    CHECK_EQ(conforming(bucket, T0 + 1002 * MS + MS / 10, limit, 5), 2);
+}
+
+void test_unlimited_and_take() {
+    std::atomic<uint64_t> bucket{0};
+    CHECK_EQ(conforming(bucket, T0, RateLimit{0, 0}, 1000), 1000);
+    CHECK_EQ(bucket.load(), 0u);  // Never touched
+
+    // take() is the pure state transition consume() retries.
+    const RateLimit limit{10, 1};
+    uint64_t next = 0;
+    CHECK(token_bucket::take(0, T0, limit, &next));
+    const uint64_t empty = next;
+    CHECK(!token_bucket::take(empty, T0, limit, &next));
+    CHECK(token_bucket::take(empty, T0 + 110 * MS, limit, &next));
+}
+
+void test_per_source() {
+    SourceRateLimiter limiter(1024);
+    CHECK_EQ(limiter.slots(), 1024u);
+    const RateLimit limit{10, 3};
+    uint8_t a[16] = {};
+    uint8_t b[16] = {};
+    a[10] = a[11] = b[10] = b[11] = 0xFF;
+    a[15] = 1;
+    b[15] = 2;
+    int passed_a = 0;
+    int passed_b = 0;
+    for (int i = 0; i < 10; ++i) {
+        passed_a += limiter.consume(a, T0, limit) ? 1 : 0;
+    }
+    for (int i = 0; i < 10; ++i) {
+        passed_b += limiter.consume(b, T0, limit) ? 1 : 0;
+    }
+    CHECK_EQ(passed_a, 3);
+    CHECK_EQ(passed_b, 3);  // A's flood did not use up B's bucket
+    CHECK(limiter.consume(a, T0 + 110 * MS, limit));
+    CHECK(!limiter.consume(a, T0 + 110 * MS, limit));
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_burst_then_limit);
+    RUN_TEST(test_fractions_are_carried);
+    RUN_TEST(test_reordered_timestamps);
+    RUN_TEST(test_unlimited_and_take);
+    RUN_TEST(test_per_source);
+    return test_exit_code();
+}
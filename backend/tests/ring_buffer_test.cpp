@@ -0,0 +1,142 @@
+// tests/ring_buffer_test.cpp
+//
+// ConcurrentRingBuffer on one thread: capacity rounding, full and empty,
+// drops, index wrap-around, batched publication and the zero-copy
+// claim()/commit() and peek()/release() paths.
+
+#include <cstdint>
+
+#include "ring_buffer.h"
+#include "test_check.h"
+
+namespace {
+
+void test_capacity_rounding() {
+    CHECK_EQ(ring_capacity_for(0), 2u);
+    CHECK_EQ(ring_capacity_for(5), 8u);
+    CHECK_EQ(ring_capacity_for(8), 8u);
+    CHECK_EQ(ring_capacity_within(1), 1u);
+    CHECK_EQ(ring_capacity_within(7), 4u);
+    CHECK_EQ(ring_capacity_within(8), 8u);
+    CHECK(is_ring_capacity(64));
+    CHECK(!is_ring_capacity(0));
+    CHECK(!is_ring_capacity(96));
+
+    ConcurrentRingBuffer<int> owned(100);
+    CHECK_EQ(owned.capacity(), 128u);
+
+    // Caller storage is never indexed past its end: 6 slots give a ring of 4.
+    int storage[6] = {};
+    ConcurrentRingBuffer<int> supplied(storage, 6);
+    CHECK_EQ(supplied.capacity(), 4u);
+    for (int i = 0; i < 10; ++i) {
+        supplied.push(i);
+        int out = -1;
+        CHECK(supplied.pop(out));
+        CHECK_EQ(out, i);
+    }
+    CHECK_EQ(storage[4], 0);
+    CHECK_EQ(storage[5], 0);
+}
+
+void test_full_and_empty() {
+    ConcurrentRingBuffer<int> ring(4);
+    int out = -1;
+    CHECK(!ring.pop(out));
+    CHECK(ring.peek() == nullptr);
+
+    for (int i = 0; i < 4; ++i) {
+        CHECK(ring.push(i));
+    }
+    CHECK_EQ(ring.size_approx(), 4u);
+    CHECK(!ring.push(99));
+    CHECK(ring.claim() == nullptr);
+    CHECK_EQ(ring.dropped(), 2u);
+
+    // Nothing was overwritten by the rejected pushes.
+    for (int i = 0; i < 4; ++i) {
+        CHECK(ring.pop(out));
+        CHECK_EQ(out, i);
+    }
+    CHECK(!ring.pop(out));
+    CHECK_EQ(ring.size_approx(), 0u);
+}
+
+void test_wrap_around() {
+    ConcurrentRingBuffer<uint32_t> ring(8);
+    uint32_t next_in = 0;
+    uint32_t next_out = 0;
+    // Indices run far past the capacity; every item comes out once, in order.
+    for (int round = 0; round < 1000; ++round) {
+        for (int i = 0; i < 5; ++i) {
+            CHECK(ring.push(next_in++));
+        }
+        uint32_t out[8];
+        const size_t count = ring.pop_bulk(out, 8);
+        CHECK_EQ(count, 5u);
+        for (size_t i = 0; i < count; ++i) {
+            CHECK_EQ(out[i], next_out++);
+        }
+    }
+    CHECK_EQ(ring.dropped(), 0u);
+    CHECK_EQ(ring.tail_position(), 5000u);
+}
+
+void test_batched_publication() {
+    ConcurrentRingBuffer<int> ring(8);
+    CHECK(ring.enqueue(1));
+    CHECK(ring.enqueue(2));
+    CHECK_EQ(ring.pending(), 2u);
+    int out = -1;
+    CHECK(!ring.pop(out));  // Not visible before flush()
+
+    ring.flush();
+    CHECK_EQ(ring.pending(), 0u);
+    CHECK(ring.pop(out));
+    CHECK_EQ(out, 1);
+    CHECK(ring.pop(out));
+    CHECK_EQ(out, 2);
+}
+
+void test_claim_and_peek() {
+    ConcurrentRingBuffer<int> ring(4);
+    int* slot = ring.claim();
+    CHECK(slot != nullptr);
+    *slot = 7;
+    // Without a commit the same slot comes back and nothing is added.
+    CHECK(ring.claim() == slot);
+    ring.flush();
+    CHECK(ring.peek() == nullptr);
+
+    *ring.claim() = 8;
+    ring.commit();
+    ring.flush();
+    const int* item = ring.peek();
+    CHECK(item != nullptr && *item == 8);
+    CHECK(ring.peek() == item);  // Still the consumer's until release()
+    ring.release();
+    CHECK(ring.peek() == nullptr);
+
+    for (int i = 0; i < 3; ++i) {
+        *ring.claim() = i;
+        ring.commit();
+    }
+    ring.flush();
+    const int* items[4];
+    CHECK_EQ(ring.peek_bulk(items, 4), 3u);
+    CHECK_EQ(*items[0], 0);
+    CHECK_EQ(*items[2], 2);
+    ring.release(3);
+    CHECK_EQ(ring.size_approx(), 0u);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_capacity_rounding);
+    RUN_TEST(test_full_and_empty);
+    RUN_TEST(test_wrap_around);
+    RUN_TEST(test_batched_publication);
+    RUN_TEST(test_claim_and_peek);
+    return test_exit_code();
+}
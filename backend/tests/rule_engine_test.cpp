@@ -0,0 +1,177 @@
+// tests/rule_engine_test.cpp
+//
+// Longest-prefix matching in LpmTrie (against its builder), and
+// CompiledRuleEngine's choice of rule: priority first, then the rule added
+// first, across the prefix fast path and bitset classification; flow bans
+// ahead of rules; the default policy when nothing matches.
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+#include "lpm_trie.h"
+#include "rule_engine.h"
+#include "test_check.h"
+
+namespace {
+
+void set_v4(uint8_t addr[16], uint32_t host_order) {
+    std::memset(addr, 0, 16);
+    addr[10] = addr[11] = 0xFF;
+    addr[12] = static_cast<uint8_t>(host_order >> 24);
+    addr[13] = static_cast<uint8_t>(host_order >> 16);
+    addr[14] = static_cast<uint8_t>(host_order >> 8);
+    addr[15] = static_cast<uint8_t>(host_order);
+}
+
+LpmKey key_v4(uint32_t host_order) {
+    return LpmKey(host_order) << 96;
+}
+
+FlowTuple udp_v4(uint32_t src, uint32_t dst, uint16_t dst_port) {
+    FlowTuple tuple;
+    std::memset(&tuple, 0, sizeof(tuple));
+    set_v4(tuple.src_addr, src);
+    set_v4(tuple.dst_addr, dst);
+    tuple.src_port = 50000;
+    tuple.dst_port = dst_port;
+    tuple.protocol = IPPROTO_UDP_NUM;
+    tuple.ip_version = 4;
+    return tuple;
+}
+
+void test_lpm_longest_prefix() {
+    LpmTrieBuilder builder;
+    // Increasing length, as the builder requires.
+    builder.insert(lpm_prefix_of(key_v4(0x0A000000u), 8), 8, 1);     // 10/8
+    builder.insert(lpm_prefix_of(key_v4(0x0A010000u), 16), 16, 2);   // 10.1/16
+    builder.insert(lpm_prefix_of(key_v4(0x0A010200u), 23), 23, 3);   // 10.1.2/23
+    builder.insert(lpm_prefix_of(key_v4(0x0A010203u), 32), 32, 4);   // 10.1.2.3/32
+    const LpmTrie trie(builder);
+
+    CHECK_EQ(trie.lookup(key_v4(0x0B000001u)), LpmTrie::NO_MATCH);
+    CHECK_EQ(trie.lookup(key_v4(0x0A090909u)), 1u);
+    CHECK_EQ(trie.lookup(key_v4(0x0A01FF01u)), 2u);
+    CHECK_EQ(trie.lookup(key_v4(0x0A010301u)), 3u);  // Still inside the /23
+    CHECK_EQ(trie.lookup(key_v4(0x0A010203u)), 4u);
+    CHECK_EQ(trie.lookup(key_v4(0x0A010204u)), 3u);
+
+    // The compressed trie agrees with the builder on random addresses near the prefixes.
+    std::mt19937 rng(7);
+    for (int i = 0; i < 20000; ++i) {
+        const LpmKey key = key_v4(0x0A000000u | (rng() & (i % 2 ? 0x0001FFFFu : 0x00FFFFFFu)));
+        CHECK_EQ(trie.lookup(key), builder.lookup(key));
+    }
+
+    uint8_t v6[16] = {0x20, 0x01, 0x0d, 0xb8};
+    LpmTrieBuilder builder6;
+    builder6.insert(lpm_prefix_of(lpm_key_v6(v6), 32), 32, 9);
+    const LpmTrie trie6(builder6);
+    v6[15] = 0x42;
+    CHECK_EQ(trie6.lookup(lpm_key_v6(v6)), 9u);
+    v6[3] = 0xb9;
+    CHECK_EQ(trie6.lookup(lpm_key_v6(v6)), LpmTrie::NO_MATCH);
+}
+
+void test_rule_priority() {
+    CompiledRuleEngine engine;
+    engine.set_default_action(FirewallAction::PASS);
+    RuleRegistry& names = RuleRegistry::instance();
+
+    // Prefix rules: the /16 has the better priority than the /24 inside it.
+    FirewallRule wide;
+    wide.priority = 10;
+    wide.ip_version = 4;
+    set_v4(wide.src_addr, 0xC0A80000u);
+    wide.src_prefix = 16;
+    wide.action = FirewallAction::REJECT;
+    wide.rule_id = names.intern("test-wide");
+    FirewallRule narrow = wide;
+    narrow.priority = 20;
+    set_v4(narrow.src_addr, 0xC0A80100u);
+    narrow.src_prefix = 24;
+    narrow.action = FirewallAction::DROP;
+    narrow.rule_id = names.intern("test-narrow");
+    // A general rule (ports) that beats both for DNS.
+    FirewallRule dns;
+    dns.priority = 5;
+    dns.ip_version = 4;
+    set_v4(dns.src_addr, 0xC0A80000u);
+    dns.src_prefix = 16;
+    dns.protocol = IPPROTO_UDP_NUM;
+    dns.dst_port_lo = dns.dst_port_hi = 53;
+    dns.action = FirewallAction::PASS;
+    dns.rule_id = names.intern("test-dns");
+    // Same priority as `narrow`, added later: loses the tie.
+    FirewallRule tie = narrow;
+    tie.action = FirewallAction::REJECT;
+    tie.rule_id = names.intern("test-tie");
+
+    CHECK(engine.add_rule(narrow) != UINT32_MAX);
+    CHECK(engine.add_rule(wide) != UINT32_MAX);
+    CHECK(engine.add_rule(dns) != UINT32_MAX);
+    CHECK(engine.add_rule(tie) != UINT32_MAX);
+    CHECK_EQ(engine.compile(), 0);
+
+    FirewallAction action;
+    RuleId rule;
+    CHECK(engine.match(udp_v4(0xC0A80105u, 0x08080808u, 443), 0, &action, &rule));
+    CHECK(action == FirewallAction::REJECT && rule == wide.rule_id);
+    CHECK(engine.match(udp_v4(0xC0A80105u, 0x08080808u, 53), 0, &action, &rule));
+    CHECK(action == FirewallAction::PASS && rule == dns.rule_id);
+    CHECK(!engine.match(udp_v4(0xC0A90105u, 0x08080808u, 443), 0, &action, &rule));
+
+    // Without the /16 the /24 decides, and the earlier of the tied rules wins.
+    FirewallRule malformed;
+    malformed.src_prefix = 8;  // A prefix needs an address family
+    CHECK_EQ(engine.add_rule(malformed), UINT32_MAX);
+    CHECK(engine.remove_rule(1));
+    CHECK(!engine.remove_rule(1));
+    CHECK_EQ(engine.compile(), 0);
+    CHECK(engine.match(udp_v4(0xC0A80105u, 0x08080808u, 443), 0, &action, &rule));
+    CHECK(action == FirewallAction::DROP && rule == narrow.rule_id);
+    CHECK(!engine.match(udp_v4(0xC0A80205u, 0x08080808u, 443), 0, &action, &rule));
+
+    const RuleEngineStats stats = engine.stats();
+    CHECK_EQ(stats.rules, 3u);
+    CHECK_EQ(stats.prefix_rules, 2u);
+    CHECK_EQ(stats.general_rules, 1u);
+}
+
+void test_flow_ban_and_default() {
+    CompiledRuleEngine engine;
+    FirewallRule rule;
+    rule.ip_version = 4;
+    set_v4(rule.dst_addr, 0x0A000001u);
+    rule.dst_prefix = 32;
+    rule.action = FirewallAction::DROP;
+    engine.add_rule(rule);
+    engine.compile();
+
+    const FlowTuple flow = udp_v4(0x0B000001u, 0x0A000001u, 80);
+    FirewallAction action;
+    RuleId id;
+    CHECK(engine.match(flow, 0, &action, &id));
+    CHECK(action == FirewallAction::DROP);
+
+    // A flow policy is checked before the rules.
+    engine.enforce_flow_policy(flow_key_of(flow), FirewallAction::PASS);
+    CHECK(engine.match(flow, 0, &action, &id));
+    CHECK(action == FirewallAction::PASS && id == RULE_FLOW_POLICY);
+    CHECK(engine.remove_flow_policy(flow_key_of(flow)));
+    CHECK(engine.match(flow, 0, &action, &id));
+    CHECK(action == FirewallAction::DROP);
+
+    engine.set_default_action(FirewallAction::REJECT);
+    CHECK(engine.get_default_action() == FirewallAction::REJECT);
+    CHECK(!engine.match(udp_v4(0x0B000001u, 0x0A000002u, 80), 0, &action, &id));
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_lpm_longest_prefix);
+    RUN_TEST(test_rule_priority);
+    RUN_TEST(test_flow_ban_and_default);
+    return test_exit_code();
+}
@@ -0,0 +1,88 @@
+// tests/shared_ring_test.cpp
+//
+// Named SharedRingSegments: a segment left at the path is replaced by a
+// fresh one, and anything else there (a plain file, a symlink to one) is
+// refused and left untouched.
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "shared_ring.h"
+#include "test_check.h"
+
+namespace {
+
+std::string scratch_path(const char* name) {
+    char cwd[4096];
+    return std::string(getcwd(cwd, sizeof(cwd)) != nullptr ? cwd : ".") + "/" + name;
+}
+
+bool write_text(const std::string& path, const char* text) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fputs(text, file);
+    return std::fclose(file) == 0;
+}
+
+bool exists(const std::string& path) {
+    struct stat st;
+    return lstat(path.c_str(), &st) == 0;
+}
+
+void test_replaces_previous_segment() {
+    const std::string path = scratch_path("ring_test.shm");
+    std::remove(path.c_str());
+    std::unique_ptr<SharedRingSegment> first;
+    CHECK_EQ(SharedRingSegment::create(path, 2, 64, 0, first), 0);
+    struct stat before;
+    CHECK(stat(path.c_str(), &before) == 0);
+
+    // Ours (same pid, still open): a cold start with new settings replaces it.
+    std::unique_ptr<SharedRingSegment> second;
+    CHECK_EQ(SharedRingSegment::create(path, 4, 128, 0, second), 0);
+    struct stat after;
+    CHECK(stat(path.c_str(), &after) == 0);
+    CHECK(after.st_ino != before.st_ino);
+    CHECK(second != nullptr && second->lane_slots() == 128);
+
+    // The destructor removes the file of the segment it created.
+    first.reset();
+    second.reset();
+    CHECK(!exists(path));
+}
+
+void test_refuses_other_files() {
+    const std::string path = scratch_path("ring_test_victim.txt");
+    CHECK(write_text(path, "not a shared ring segment, but long enough to hold a header of one. "
+                           "The engine must leave this file exactly as it found it....................."));
+    std::unique_ptr<SharedRingSegment> segment;
+    CHECK_EQ(SharedRingSegment::create(path, 1, 64, 0, segment), -EEXIST);
+    CHECK(segment == nullptr);
+    CHECK(exists(path));
+
+    // A symlink is not followed, and neither it nor its target is removed.
+    const std::string link = scratch_path("ring_test_link.shm");
+    std::remove(link.c_str());
+    CHECK(symlink(path.c_str(), link.c_str()) == 0);
+    CHECK(SharedRingSegment::create(link, 1, 64, 0, segment) < 0);
+    CHECK(exists(link));
+    CHECK(exists(path));
+
+    std::remove(link.c_str());
+    std::remove(path.c_str());
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_replaces_previous_segment);
+    RUN_TEST(test_refuses_other_files);
+    return test_exit_code();
+}
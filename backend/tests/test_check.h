@@ -0,0 +1,55 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+// Minimal checks for the ctest suites in tests/. Unlike assert() they stay
+// on in Release builds (-DNDEBUG), report every failure instead of stopping
+// at the first, and make the test exit non-zero.
+
+#include <cstdio>
+
+inline int& test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                \
+    do {                                                                           \
+        if (!(cond)) {                                                             \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__,  \
+                         #cond);                                                   \
+            ++test_failures();                                                     \
+        }                                                                          \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                             \
+    do {                                                                           \
+        const auto check_a_ = (a);                                                 \
+        const auto check_b_ = (b);                                                 \
+        if (!(check_a_ == check_b_)) {                                             \
+            std::fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %s (%llu vs %llu)\n", \
+                         __FILE__, __LINE__, #a, #b,                               \
+                         static_cast<unsigned long long>(check_a_),                \
+                         static_cast<unsigned long long>(check_b_));               \
+            ++test_failures();                                                     \
+        }                                                                          \
+    } while (0)
+
+/**
+ * @brief Runs one test function and names it in the output.
+ */
+#define RUN_TEST(fn)                                                               \
+    do {                                                                           \
+        const int before_ = test_failures();                                       \
+        fn();                                                                      \
+        std::printf("%s %s\n", test_failures() == before_ ? "ok  " : "FAIL", #fn); \
+    } while (0)
+
+inline int test_exit_code() {
+    if (test_failures() != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", test_failures());
+        return 1;
+    }
+    return 0;
+}
+
+#endif // TEST_CHECK_H
@@ -0,0 +1,139 @@
+// tests/timer_wheel_test.cpp
+//
+// TimerWheel: timers on every level fire on their own tick after being
+// cascaded down, past deadlines fire on the next tick, cancel and
+// reschedule, earliest(), and rescheduling from the fire callback.
+
+#include <cstdint>
+#include <vector>
+
+#include "memory_arena.h"
+#include "test_check.h"
+#include "timer_wheel.h"
+
+namespace {
+
+constexpr size_t TIMERS = 64;
+
+struct Wheel {
+    MemoryArena arena;
+    TimerWheel* wheel = nullptr;
+
+    Wheel() {
+        arena.reserve(TimerWheel::bytes_for(TIMERS));
+        wheel = new TimerWheel(TIMERS, arena);
+    }
+    ~Wheel() { delete wheel; }
+};
+
+void test_cascade_fires_on_time() {
+    Wheel w;
+    TimerWheel& wheel = *w.wheel;
+    // Not aligned to any level's span, so every cascade boundary is crossed.
+    const uint64_t start = 1000;
+    wheel.start(start);
+    const uint64_t deltas[] = {1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 5000, 262143, 262144, 300001};
+    const size_t count = sizeof(deltas) / sizeof(deltas[0]);
+    for (size_t i = 0; i < count; ++i) {
+        wheel.schedule(static_cast<uint32_t>(i), start + deltas[i]);
+    }
+    CHECK_EQ(wheel.size(), count);
+
+    std::vector<uint64_t> fired_at(count, 0);
+    for (uint64_t tick = start + 1; tick <= start + 300001; ++tick) {
+        wheel.advance(tick, [&](uint32_t id) { fired_at[id] = tick; });
+    }
+    for (size_t i = 0; i < count; ++i) {
+        CHECK_EQ(fired_at[i], start + deltas[i]);
+    }
+    CHECK_EQ(wheel.size(), 0u);
+}
+
+void test_jump_fires_everything_due() {
+    Wheel w;
+    TimerWheel& wheel = *w.wheel;
+    wheel.start(0);
+    for (uint32_t id = 0; id < 10; ++id) {
+        wheel.schedule(id, 100 + id * 1000);
+    }
+    std::vector<uint32_t> fired;
+    CHECK_EQ(wheel.advance(5100, [&](uint32_t id) { fired.push_back(id); }), 6u);
+    CHECK_EQ(fired.size(), 6u);
+    // In deadline order even across levels.
+    for (size_t i = 0; i < fired.size(); ++i) {
+        CHECK_EQ(fired[i], i);
+    }
+    CHECK(!wheel.scheduled(5));
+    CHECK(wheel.scheduled(6));
+    CHECK_EQ(wheel.current_tick(), 5100u);
+}
+
+void test_past_deadline_and_cancel() {
+    Wheel w;
+    TimerWheel& wheel = *w.wheel;
+    wheel.start(500);
+    wheel.schedule(0, 10);   // Already overdue
+    wheel.schedule(1, 502);
+    wheel.schedule(2, 502);
+    wheel.cancel(1);
+    wheel.cancel(1);         // Cancelling twice is harmless
+    CHECK_EQ(wheel.size(), 2u);
+
+    std::vector<uint32_t> fired;
+    wheel.advance(501, [&](uint32_t id) { fired.push_back(id); });
+    CHECK(fired.size() == 1 && fired[0] == 0);
+    wheel.advance(502, [&](uint32_t id) { fired.push_back(id); });
+    CHECK(fired.size() == 2 && fired[1] == 2);
+
+    wheel.schedule(3, 600);
+    wheel.reschedule(3, 520);
+    CHECK_EQ(wheel.expires(3), 520u);
+    size_t count = wheel.advance(519, [](uint32_t) {});
+    CHECK_EQ(count, 0u);
+    count = wheel.advance(520, [](uint32_t) {});
+    CHECK_EQ(count, 1u);
+}
+
+void test_earliest() {
+    Wheel w;
+    TimerWheel& wheel = *w.wheel;
+    wheel.start(0);
+    CHECK_EQ(wheel.earliest(), TimerWheel::NONE);
+    wheel.schedule(7, 90000);
+    wheel.schedule(8, 3000);
+    CHECK_EQ(wheel.earliest(), 8u);
+    wheel.schedule(9, 40);
+    CHECK_EQ(wheel.earliest(), 9u);
+    wheel.cancel(9);
+    CHECK_EQ(wheel.earliest(), 8u);
+}
+
+void test_reschedule_from_fire() {
+    Wheel w;
+    TimerWheel& wheel = *w.wheel;
+    wheel.start(0);
+    wheel.schedule(0, 10);
+    int fires = 0;
+    // A periodic timer: every firing arms the next one, 10 ticks later.
+    for (uint64_t tick = 1; tick <= 100; ++tick) {
+        wheel.advance(tick, [&](uint32_t id) {
+            ++fires;
+            CHECK_EQ(tick % 10, 0u);
+            wheel.schedule(id, tick + 10);
+        });
+    }
+    CHECK_EQ(fires, 10);
+    CHECK(wheel.scheduled(0));
+    CHECK_EQ(wheel.expires(0), 110u);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_cascade_fires_on_time);
+    RUN_TEST(test_jump_fires_everything_due);
+    RUN_TEST(test_past_deadline_and_cancel);
+    RUN_TEST(test_earliest);
+    RUN_TEST(test_reschedule_from_fire);
+    return test_exit_code();
+}
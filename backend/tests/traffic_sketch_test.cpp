@@ -0,0 +1,252 @@
+// tests/traffic_sketch_test.cpp
+//
+// TrafficSketch on a known packet mix: one source flooding one destination,
+// a scan of one destination from many sources, and background traffic under
+// every threshold. Each threshold kind fires exactly once per window (for
+// the right address, at the threshold), the finished window reports the
+// heavy hitters in order, and with the enforce flags every flow of the
+// offending source / to a hot destination is alerted for enforcement once.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "traffic_sketch.h"
+#include "test_check.h"
+
+namespace {
+
+constexpr uint64_t SECOND = 1000000000ull;
+constexpr uint64_t T0 = 1700000000ull * SECOND;
+
+// Thresholds, and the mix around them
+constexpr uint64_t SRC_PACKETS = 100;
+constexpr uint64_t DST_PACKETS = 120;
+constexpr uint64_t DST_SOURCES = 50;
+constexpr uint32_t FLOOD_FLOWS = 30;     // Attacker -> victim:443, 5 packets each (150)
+constexpr uint32_t SCANNERS = 60;        // One packet each -> scanned:22
+constexpr uint32_t BACKGROUND = 20;      // 5 packets each -> server:80/udp (100)
+
+constexpr uint32_t ATTACKER = 0x0A000001u;
+constexpr uint32_t VICTIM = 0x0A090909u;
+constexpr uint32_t SCANNED = 0x0A080808u;
+constexpr uint32_t SERVER = 0x0A070707u;
+
+void set_v4(uint8_t addr[16], uint32_t host_order) {
+    std::memset(addr, 0, 16);
+    addr[10] = addr[11] = 0xFF;
+    addr[12] = static_cast<uint8_t>(host_order >> 24);
+    addr[13] = static_cast<uint8_t>(host_order >> 16);
+    addr[14] = static_cast<uint8_t>(host_order >> 8);
+    addr[15] = static_cast<uint8_t>(host_order);
+}
+
+bool is_v4(const uint8_t addr[16], uint32_t host_order) {
+    uint8_t want[16];
+    set_v4(want, host_order);
+    return std::memcmp(addr, want, 16) == 0;
+}
+
+FlowTuple tuple(uint32_t src, uint16_t src_port, uint32_t dst, uint16_t dst_port, uint8_t protocol) {
+    FlowTuple t;
+    std::memset(&t, 0, sizeof(t));
+    set_v4(t.src_addr, src);
+    set_v4(t.dst_addr, dst);
+    t.src_port = src_port;
+    t.dst_port = dst_port;
+    t.protocol = protocol;
+    t.ip_version = 4;
+    return t;
+}
+
+// One window's packets. The flood goes round-robin over its flows (all of
+// them are seen before the source crosses), the rest is shuffled into it.
+std::vector<FlowTuple> window_mix(uint32_t seed) {
+    std::vector<FlowTuple> flood;
+    for (uint32_t round = 0; round < 5; ++round) {
+        for (uint32_t f = 0; f < FLOOD_FLOWS; ++f) {
+            flood.push_back(tuple(ATTACKER, static_cast<uint16_t>(40000 + f), VICTIM, 443, 6));
+        }
+    }
+    std::vector<FlowTuple> rest;
+    for (uint32_t s = 0; s < SCANNERS; ++s) {
+        rest.push_back(tuple(0x0B000000u + s, 50000, SCANNED, 22, 6));
+    }
+    for (uint32_t s = 0; s < BACKGROUND; ++s) {
+        for (int p = 0; p < 5; ++p) {
+            rest.push_back(tuple(0x0C000000u + s, 53000, SERVER, 80, 17));
+        }
+    }
+    std::mt19937 rng(seed);
+    std::shuffle(rest.begin(), rest.end(), rng);
+
+    // Merge keeping the flood's own order.
+    std::vector<FlowTuple> mix;
+    size_t a = 0;
+    size_t b = 0;
+    while (a < flood.size() || b < rest.size()) {
+        const bool take_flood = b == rest.size() || (a < flood.size() && rng() % 2 == 0);
+        mix.push_back(take_flood ? flood[a++] : rest[b++]);
+    }
+    return mix;
+}
+
+SketchSettings settings(uint32_t flags) {
+    SketchSettings s;
+    s.window_ns = SECOND;
+    s.src_packets = SRC_PACKETS;
+    s.dst_packets = DST_PACKETS;
+    s.dst_sources = DST_SOURCES;
+    s.flags = flags;
+    s.action = 1;
+    return s;
+}
+
+void test_alerts_once_per_window() {
+    TrafficSketch sketch;
+    const SketchSettings config = settings(0);
+    for (uint32_t w = 0; w < 3; ++w) {
+        const std::vector<FlowTuple> mix = window_mix(w + 1);
+        std::vector<C_SketchAlert> alerts;
+        for (size_t i = 0; i < mix.size(); ++i) {
+            sketch.add(mix[i], flow_key_of(mix[i]), 100, T0 + w * SECOND + i * 1000, nullptr, config,
+                       [&alerts](const C_SketchAlert& alert) { alerts.push_back(alert); });
+        }
+        CHECK_EQ(alerts.size(), 3u);
+        std::map<uint8_t, C_SketchAlert> by_kind;
+        for (const C_SketchAlert& alert : alerts) {
+            CHECK(by_kind.emplace(alert.kind, alert).second);
+            CHECK_EQ(alert.flags, 0u);  // No enforce flags set: reporting only
+        }
+        CHECK(by_kind.count(C_ALERT_SRC_VOLUME) == 1 && is_v4(by_kind[C_ALERT_SRC_VOLUME].addr, ATTACKER));
+        CHECK_EQ(by_kind[C_ALERT_SRC_VOLUME].estimate, SRC_PACKETS);
+        CHECK_EQ(by_kind[C_ALERT_SRC_VOLUME].threshold, SRC_PACKETS);
+        CHECK(by_kind.count(C_ALERT_DST_VOLUME) == 1 && is_v4(by_kind[C_ALERT_DST_VOLUME].addr, VICTIM));
+        CHECK_EQ(by_kind[C_ALERT_DST_VOLUME].estimate, DST_PACKETS);
+        CHECK_EQ(by_kind[C_ALERT_DST_VOLUME].port, 443u);
+        CHECK(by_kind.count(C_ALERT_DST_SOURCES) == 1 && is_v4(by_kind[C_ALERT_DST_SOURCES].addr, SCANNED));
+        CHECK(by_kind[C_ALERT_DST_SOURCES].estimate >= DST_SOURCES);
+        CHECK_EQ(by_kind[C_ALERT_DST_SOURCES].threshold, DST_SOURCES);
+        CHECK_EQ(sketch.windows(), w);
+    }
+}
+
+void test_heavy_hitters() {
+    TrafficSketch sketch;
+    const SketchSettings config = settings(0);
+    const std::vector<FlowTuple> mix = window_mix(7);
+    const auto ignore = [](const C_SketchAlert&) {};
+    for (size_t i = 0; i < mix.size(); ++i) {
+        sketch.add(mix[i], flow_key_of(mix[i]), i % 2 ? 1500 : 60, T0 + i * 1000, nullptr, config, ignore);
+    }
+    CHECK_EQ(sketch.windows(), 0u);
+    // The next window's first packet finishes this one.
+    const FlowTuple next = tuple(0x0D000001u, 1, SERVER, 80, 17);
+    sketch.add(next, flow_key_of(next), 60, T0 + SECOND + 5, nullptr, config, ignore);
+    CHECK_EQ(sketch.windows(), 1u);
+
+    const SketchWindow& window = sketch.last_window();
+    CHECK_EQ(window.start_ns, T0);
+    CHECK_EQ(window.packets, mix.size());
+    CHECK_EQ(sketch.packets(), mix.size() + 1);
+
+    // Sources: 81 of them through 32 slots, the attacker on top, its count
+    // within the space-saving bound (never under, over by at most error).
+    CHECK_EQ(window.src_count, uint32_t(SNIFFER_SKETCH_TOP_K));
+    CHECK(is_v4(window.top_src[0].addr, ATTACKER));
+    CHECK(window.top_src[0].packets >= 5 * FLOOD_FLOWS);
+    CHECK(window.top_src[0].packets - window.top_src[0].error <= 5 * FLOOD_FLOWS);
+    CHECK(window.top_src[1].packets < window.top_src[0].packets);
+
+    CHECK_EQ(window.dst_count, 3u);
+    CHECK(is_v4(window.top_dst[0].hitter.addr, VICTIM));
+    CHECK_EQ(window.top_dst[0].hitter.packets, uint64_t(5 * FLOOD_FLOWS));
+    CHECK_EQ(window.top_dst[0].hitter.sources, 1u);
+    CHECK(is_v4(window.top_dst[1].hitter.addr, SERVER));
+    CHECK_EQ(window.top_dst[1].hitter.packets, uint64_t(5 * BACKGROUND));
+    CHECK(is_v4(window.top_dst[2].hitter.addr, SCANNED));
+    CHECK_EQ(window.top_dst[2].hitter.packets, uint64_t(SCANNERS));
+    const uint32_t scanned_sources = window.top_dst[2].hitter.sources;
+    CHECK(scanned_sources >= SCANNERS * 9 / 10 && scanned_sources <= SCANNERS * 11 / 10);
+
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < mix.size(); ++i) {
+        bytes += std::memcmp(mix[i].dst_addr, window.top_dst[0].hitter.addr, 16) == 0 ? (i % 2 ? 1500 : 60) : 0;
+    }
+    CHECK_EQ(window.top_dst[0].hitter.bytes, bytes);
+
+    CHECK_EQ(window.port_count, 3u);
+    CHECK(window.top_ports[0].port == 443 && window.top_ports[0].protocol == 6);
+    CHECK(window.top_ports[1].port == 80 && window.top_ports[1].protocol == 17);
+    CHECK(window.top_ports[2].port == 22 && window.top_ports[2].protocol == 6);
+    CHECK_EQ(window.top_ports[2].packets, uint64_t(SCANNERS));
+}
+
+void test_enforce_each_flow_once() {
+    TrafficSketch sketch;
+    const SketchSettings config = settings(SNIFFER_SKETCH_ENFORCE_SRC | SNIFFER_SKETCH_ENFORCE_DST);
+    const std::vector<FlowTuple> mix = window_mix(3);
+    std::map<FlowKey, uint8_t> marks;       // FlowEntry::sketch_alerts per flow
+    std::map<FlowKey, int> src_enforced;    // Enforcement alerts per flow, by mark
+    std::map<FlowKey, int> dst_enforced;
+    size_t scanned_after_hot = 0;
+    bool scanned_hot = false;
+    for (size_t i = 0; i < mix.size(); ++i) {
+        const FlowKey key = flow_key_of(mix[i]);
+        std::vector<C_SketchAlert> alerts;
+        sketch.add(mix[i], key, 100, T0 + i * 1000, &marks[key], config,
+                   [&alerts](const C_SketchAlert& alert) { alerts.push_back(alert); });
+        for (const C_SketchAlert& alert : alerts) {
+            CHECK_EQ(alert.flow_id, key);
+            if (alert.kind == C_ALERT_DST_SOURCES) {
+                scanned_hot = true;
+            }
+            if ((alert.flags & C_ALERT_FLAG_ENFORCE) == 0) {
+                continue;
+            }
+            CHECK_EQ(alert.action, 1u);
+            if (alert.kind == C_ALERT_SRC_VOLUME || alert.kind == C_ALERT_SRC_FLOW) {
+                CHECK(is_v4(alert.addr, ATTACKER));
+                ++src_enforced[key];
+            } else {
+                CHECK_EQ(alert.kind, uint8_t(C_ALERT_DST_FLOW));
+                ++dst_enforced[key];
+            }
+        }
+        scanned_after_hot += scanned_hot && is_v4(mix[i].dst_addr, SCANNED) ? 1 : 0;
+    }
+
+    // Every attacker flow once for the source; every victim flow (the same
+    // 30) and every scan packet from the crossing on once for the destination.
+    CHECK_EQ(src_enforced.size(), size_t(FLOOD_FLOWS));
+    for (const auto& flow : src_enforced) {
+        CHECK_EQ(flow.second, 1);
+        CHECK_EQ(marks[flow.first] & SKETCH_FLOW_SRC, SKETCH_FLOW_SRC);
+    }
+    CHECK(scanned_after_hot > 0);
+    CHECK_EQ(dst_enforced.size(), FLOOD_FLOWS + scanned_after_hot);
+    for (const auto& flow : dst_enforced) {
+        CHECK_EQ(flow.second, 1);
+    }
+
+    // An untracked flow (no marks) is never enforced.
+    TrafficSketch untracked;
+    int enforce = 0;
+    for (size_t i = 0; i < mix.size(); ++i) {
+        untracked.add(mix[i], flow_key_of(mix[i]), 100, T0 + i * 1000, nullptr, config,
+                      [&enforce](const C_SketchAlert& alert) { enforce += alert.flags & C_ALERT_FLAG_ENFORCE; });
+    }
+    CHECK_EQ(enforce, 0);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(test_alerts_once_per_window);
+    RUN_TEST(test_heavy_hitters);
+    RUN_TEST(test_enforce_each_flow_once);
+    return test_exit_code();
+}